@@ -15,6 +15,9 @@
 
 package edu.stanford.ramcloud;
 
+import java.nio.BufferOverflowException;
+import java.nio.ByteBuffer;
+
 /*
  * This class provides Java bindings for RAMCloud. Right now it is a rather
  * simple subset of what RamCloud.h defines.
@@ -37,6 +40,15 @@ public class JRamCloud {
     /// object.
     private long ramcloudObjectPointer = 0;
 
+    /// Used to return the length of an object from readDirect.
+    private final int[] readLength = new int[1];
+
+    /**
+     * Values found in MultiOp.statuses; see src/Status.h for the others.
+     */
+    public static final int STATUS_OK = 0;
+    public static final int STATUS_OBJECT_DOESNT_EXIST = 3;
+
     /**
      * See src/RejectRules.h.
      */
@@ -81,6 +93,79 @@ public class JRamCloud {
         final public long version;
     }
 
+    /**
+     * An outstanding batch of reads or writes, returned by multiReadAsync
+     * and multiWriteAsync (or, already completed, by multiRead and
+     * multiWrite). The keys and values must not be modified until
+     * waitFor() returns.
+     */
+    public class MultiOp {
+        MultiOp(boolean isRead, ByteBuffer[] keys, ByteBuffer[] values)
+        {
+            this.isRead = isRead;
+            this.keys = keys;
+            this.values = values;
+            lengths = new int[keys.length];
+            versions = new long[keys.length];
+            statuses = new int[keys.length];
+        }
+
+        /**
+         * Make progress on the operation without blocking. Returns true
+         * once it has completed, in which case waitFor() won't block.
+         */
+        public boolean
+        isReady()
+        {
+            return handle == 0 || multiOpIsReady(handle);
+        }
+
+        /**
+         * Wait for the operation to complete and fill in lengths, versions,
+         * and statuses. For reads, the limit of each value buffer that was
+         * read successfully is set to the end of the object (if the object
+         * didn't fit, only the part that did was copied; compare with
+         * lengths to detect this).
+         */
+        public void
+        waitFor()
+        {
+            if (handle == 0)
+                return;
+            long h = handle;
+            handle = 0;
+            multiOpFinish(h, lengths, versions, statuses);
+            if (!isRead)
+                return;
+            for (int i = 0; i < values.length; i++) {
+                if (statuses[i] == STATUS_OK) {
+                    values[i].limit(values[i].position() +
+                                    Math.min(lengths[i],
+                                             values[i].remaining()));
+                }
+            }
+        }
+
+        /// For reads, the total length of each object.
+        final public int[] lengths;
+
+        /// The version of each object read or written.
+        final public long[] versions;
+
+        /// The outcome for each object (STATUS_OK or the error).
+        final public int[] statuses;
+
+        /// Handle for the C++ operation, or 0 once waitFor has been called.
+        long handle = 0;
+
+        final boolean isRead;
+
+        /// Kept here so they aren't garbage collected while the C++ code
+        /// is using their memory.
+        final ByteBuffer[] keys;
+        final ByteBuffer[] values;
+    }
+
     /**
      * Connect to the RAMCloud cluster specified by the given coordinator's
      * service locator string. This causes the JNI code to instantiate the
@@ -193,6 +278,117 @@ public class JRamCloud {
         return write(tableId, key.getBytes(), value, rules);
     }
 
+    /**
+     * Read an object without copying its key or value through Java arrays.
+     * The key is the contents of the direct buffer between its position and
+     * limit. The value is stored in a direct buffer starting at its
+     * position, and the buffer's limit is set to the end of the value.
+     *
+     * @return
+     *      The version of the object.
+     * @throws BufferOverflowException
+     *      The object didn't fit in value (value's contents are undefined).
+     */
+    public long
+    read(long tableId, ByteBuffer key, ByteBuffer value)
+    {
+        long version = readDirect(tableId, key, key.position(),
+                                  key.remaining(), value, value.position(),
+                                  value.remaining(), readLength);
+        if (readLength[0] > value.remaining())
+            throw new BufferOverflowException();
+        value.limit(value.position() + readLength[0]);
+        return version;
+    }
+
+    /**
+     * Write an object without copying its key or value through Java arrays.
+     * The key and value are the contents of the direct buffers between
+     * their positions and limits.
+     *
+     * @return
+     *      The version of the new object.
+     */
+    public long
+    write(long tableId, ByteBuffer key, ByteBuffer value)
+    {
+        return writeDirect(tableId, key, key.position(), key.remaining(),
+                           value, value.position(), value.remaining());
+    }
+
+    /**
+     * Read many objects from a table at once, using the fewest possible
+     * RPCs (see RamCloud::multiRead). Keys and values are direct buffers
+     * handled as in read(long, ByteBuffer, ByteBuffer), except that errors
+     * are reported in the result's statuses rather than by exceptions.
+     */
+    public MultiOp
+    multiRead(long tableId, ByteBuffer[] keys, ByteBuffer[] values)
+    {
+        MultiOp op = multiReadAsync(tableId, keys, values);
+        op.waitFor();
+        return op;
+    }
+
+    /**
+     * Start a multiRead without waiting for it to complete; call waitFor()
+     * on the result to collect the objects.
+     */
+    public MultiOp
+    multiReadAsync(long tableId, ByteBuffer[] keys, ByteBuffer[] values)
+    {
+        MultiOp op = new MultiOp(true, keys, values);
+        int[] keyOffsets = new int[keys.length];
+        int[] keyLengths = new int[keys.length];
+        int[] valueOffsets = new int[keys.length];
+        int[] valueSpace = new int[keys.length];
+        for (int i = 0; i < keys.length; i++) {
+            keyOffsets[i] = keys[i].position();
+            keyLengths[i] = keys[i].remaining();
+            valueOffsets[i] = values[i].position();
+            valueSpace[i] = values[i].remaining();
+        }
+        op.handle = multiReadStart(tableId, keys, keyOffsets, keyLengths,
+                                   values, valueOffsets, valueSpace);
+        return op;
+    }
+
+    /**
+     * Write many objects to a table at once, using the fewest possible
+     * RPCs (see RamCloud::multiWrite). Keys and values are direct buffers
+     * handled as in write(long, ByteBuffer, ByteBuffer).
+     */
+    public MultiOp
+    multiWrite(long tableId, ByteBuffer[] keys, ByteBuffer[] values)
+    {
+        MultiOp op = multiWriteAsync(tableId, keys, values);
+        op.waitFor();
+        return op;
+    }
+
+    /**
+     * Start a multiWrite without waiting for it to complete; call waitFor()
+     * on the result to collect the new versions.
+     */
+    public MultiOp
+    multiWriteAsync(long tableId, ByteBuffer[] keys, ByteBuffer[] values)
+    {
+        MultiOp op = new MultiOp(false, keys, values);
+        int[] keyOffsets = new int[keys.length];
+        int[] keyLengths = new int[keys.length];
+        int[] valueOffsets = new int[keys.length];
+        int[] valueLengths = new int[keys.length];
+        for (int i = 0; i < keys.length; i++) {
+            keyOffsets[i] = keys[i].position();
+            keyLengths[i] = keys[i].remaining();
+            valueOffsets[i] = values[i].position();
+            valueLengths[i] = values[i].remaining();
+        }
+        op.handle = multiWriteStart(tableId, keys, keyOffsets, keyLengths,
+                                    values, valueOffsets, valueLengths);
+        return op;
+    }
+
     private static native long connect(String coordinatorLocator);
     private static native void disconnect(long ramcloudObjectPointer);
 
@@ -207,6 +403,27 @@ public class JRamCloud {
     public native long write(long tableId, byte[] key, byte[] value);
     public native long write(long tableId, byte[] key, byte[] value, RejectRules rules);
 
+    private native long readDirect(long tableId, ByteBuffer key, int keyOffset,
+                                   int keyLength, ByteBuffer value,
+                                   int valueOffset, int valueSpace,
+                                   int[] length);
+    private native long writeDirect(long tableId, ByteBuffer key,
+                                    int keyOffset, int keyLength,
+                                    ByteBuffer value, int valueOffset,
+                                    int valueLength);
+    private native long multiReadStart(long tableId, ByteBuffer[] keys,
+                                       int[] keyOffsets, int[] keyLengths,
+                                       ByteBuffer[] values,
+                                       int[] valueOffsets, int[] valueSpace);
+    private native long multiWriteStart(long tableId, ByteBuffer[] keys,
+                                        int[] keyOffsets, int[] keyLengths,
+                                        ByteBuffer[] values,
+                                        int[] valueOffsets,
+                                        int[] valueLengths);
+    private native boolean multiOpIsReady(long handle);
+    private native void multiOpFinish(long handle, int[] lengths,
+                                      long[] versions, int[] statuses);
+
     /*
      * The following exceptions may be thrown by the JNI functions:
      */
@@ -275,5 +492,88 @@ public class JRamCloud {
         long after = System.nanoTime();
         System.out.println("Avg read latency: " +
             ((double)(after - before) / 100000 / 1000) + " usec");
+
+        benchmark(ramcloud, tableId);
+        ramcloud.dropTable("hi");
+        ramcloud.disconnect();
+    }
+
+    /**
+     * Print the throughput of the byte[] interface (which copies keys and
+     * values through Java arrays), the direct ByteBuffer interface, and
+     * multiRead (synchronous, and with two batches outstanding at once).
+     */
+    private static void
+    benchmark(JRamCloud ramcloud, long tableId)
+    {
+        final int batchSize = 100;
+        final int batches = 1000;
+        final int count = batchSize * batches;
+        final int valueSize = 100;
+
+        ByteBuffer[][] keys = new ByteBuffer[batches][batchSize];
+        ByteBuffer[] values = new ByteBuffer[batchSize];
+        ByteBuffer[] spare = new ByteBuffer[batchSize];
+        for (int b = 0; b < batches; b++) {
+            for (int i = 0; i < batchSize; i++) {
+                byte[] key = ("key" + (b * batchSize + i)).getBytes();
+                keys[b][i] = ByteBuffer.allocateDirect(key.length);
+                keys[b][i].put(key).flip();
+            }
+        }
+        for (int i = 0; i < batchSize; i++) {
+            values[i] = ByteBuffer.allocateDirect(valueSize);
+            spare[i] = ByteBuffer.allocateDirect(valueSize);
+        }
+
+        long before = System.nanoTime();
+        for (int b = 0; b < batches; b++)
+            ramcloud.multiWrite(tableId, keys[b], values);
+        printThroughput("multiWrite", count, System.nanoTime() - before);
+
+        before = System.nanoTime();
+        for (int b = 0; b < batches; b++) {
+            for (int i = 0; i < batchSize; i++)
+                ramcloud.read(tableId, ("key" + (b * batchSize + i)).getBytes());
+        }
+        printThroughput("read(byte[])", count, System.nanoTime() - before);
+
+        before = System.nanoTime();
+        for (int b = 0; b < batches; b++) {
+            for (int i = 0; i < batchSize; i++) {
+                values[0].clear();
+                ramcloud.read(tableId, keys[b][i], values[0]);
+            }
+        }
+        printThroughput("read(ByteBuffer)", count, System.nanoTime() - before);
+
+        before = System.nanoTime();
+        for (int b = 0; b < batches; b++) {
+            for (int i = 0; i < batchSize; i++)
+                values[i].clear();
+            ramcloud.multiRead(tableId, keys[b], values);
+        }
+        printThroughput("multiRead", count, System.nanoTime() - before);
+
+        before = System.nanoTime();
+        MultiOp pending = null;
+        for (int b = 0; b < batches; b++) {
+            ByteBuffer[] current = (b % 2 == 0) ? values : spare;
+            for (int i = 0; i < batchSize; i++)
+                current[i].clear();
+            MultiOp op = ramcloud.multiReadAsync(tableId, keys[b], current);
+            if (pending != null)
+                pending.waitFor();
+            pending = op;
+        }
+        pending.waitFor();
+        printThroughput("multiReadAsync", count, System.nanoTime() - before);
+    }
+
+    private static void
+    printThroughput(String name, int count, long nanoseconds)
+    {
+        System.out.println(name + ": " +
+            ((double)count / nanoseconds * 1e6) + " kops/sec");
     }
 }
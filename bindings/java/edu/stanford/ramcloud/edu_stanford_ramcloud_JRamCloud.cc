@@ -14,6 +14,8 @@
  */
 
 #include <RamCloud.h>
+#include <MultiRead.h>
+#include <MultiWrite.h>
 #include "edu_stanford_ramcloud_JRamCloud.h"
 
 using namespace RAMCloud;
@@ -92,6 +94,55 @@ class JByteArrayGetter {
     const jsize length;
 };
 
+/**
+ * Return the address of a given byte in a direct java.nio.ByteBuffer.
+ * Unlike JByteArrayGetter, this accesses the buffer's memory in place,
+ * without copying it.
+ */
+static char*
+getDirectBufferAddress(JNIEnv* env, jobject jByteBuffer, jint offset)
+{
+    char* base = static_cast<char*>(env->GetDirectBufferAddress(jByteBuffer));
+    check_null(base, "GetDirectBufferAddress failed (not a direct buffer?)");
+    return base + offset;
+}
+
+/**
+ * Holds the state of a multiRead or multiWrite started from Java until
+ * multiOpFinish is called. The Java MultiOp object keeps the keys and
+ * values referred to here from being garbage collected in the meantime.
+ */
+struct JMultiOp {
+    explicit JMultiOp(jsize numObjects)
+        : numObjects(numObjects)
+        , reads(numObjects)
+        , readRequests(numObjects)
+        , values(new Tub<Buffer>[numObjects])
+        , destinations(numObjects)
+        , space(numObjects)
+        , multiRead()
+        , writes(numObjects)
+        , writeRequests(numObjects)
+        , multiWrite()
+    {}
+
+    jsize numObjects;
+
+    /// Used for reads: each object's value is copied from values[i] into
+    /// destinations[i], which has room for space[i] bytes.
+    std::vector<MultiReadObject> reads;
+    std::vector<MultiReadObject*> readRequests;
+    std::unique_ptr<Tub<Buffer>[]> values;
+    std::vector<char*> destinations;
+    std::vector<jint> space;
+    Tub<MultiRead> multiRead;
+
+    /// Used for writes.
+    std::vector<MultiWriteObject> writes;
+    std::vector<MultiWriteObject*> writeRequests;
+    Tub<MultiWrite> multiWrite;
+};
+
 static RamCloud*
 getRamCloud(JNIEnv* env, jobject jRamCloud)
 {
@@ -416,3 +467,231 @@ JNICALL Java_edu_stanford_ramcloud_JRamCloud_write__J_3B_3BLJRamCloud_RejectRule
     } EXCEPTION_CATCHER(-1);
     return static_cast<jlong>(version);
 }
+
+/*
+ * Class:     edu_stanford_ramcloud_JRamCloud
+ * Method:    readDirect
+ * Signature: (JLjava/nio/ByteBuffer;IILjava/nio/ByteBuffer;II[I)J
+ */
+JNIEXPORT jlong
+JNICALL Java_edu_stanford_ramcloud_JRamCloud_readDirect(JNIEnv *env,
+                                  jobject jRamCloud,
+                                  jlong jTableId,
+                                  jobject jKey,
+                                  jint jKeyOffset,
+                                  jint jKeyLength,
+                                  jobject jValue,
+                                  jint jValueOffset,
+                                  jint jValueSpace,
+                                  jintArray jLength)
+{
+    RamCloud* ramcloud = getRamCloud(env, jRamCloud);
+    const char* key = getDirectBufferAddress(env, jKey, jKeyOffset);
+    char* value = getDirectBufferAddress(env, jValue, jValueOffset);
+
+    Buffer buffer;
+    uint64_t version;
+    try {
+        ramcloud->read(jTableId, key, static_cast<uint16_t>(jKeyLength),
+                       &buffer, NULL, &version);
+    } EXCEPTION_CATCHER(-1);
+
+    jint length = buffer.getTotalLength();
+    buffer.copy(0, std::min(length, jValueSpace), value);
+    env->SetIntArrayRegion(jLength, 0, 1, &length);
+    return static_cast<jlong>(version);
+}
+
+/*
+ * Class:     edu_stanford_ramcloud_JRamCloud
+ * Method:    writeDirect
+ * Signature: (JLjava/nio/ByteBuffer;IILjava/nio/ByteBuffer;II)J
+ */
+JNIEXPORT jlong
+JNICALL Java_edu_stanford_ramcloud_JRamCloud_writeDirect(JNIEnv *env,
+                                   jobject jRamCloud,
+                                   jlong jTableId,
+                                   jobject jKey,
+                                   jint jKeyOffset,
+                                   jint jKeyLength,
+                                   jobject jValue,
+                                   jint jValueOffset,
+                                   jint jValueLength)
+{
+    RamCloud* ramcloud = getRamCloud(env, jRamCloud);
+    const char* key = getDirectBufferAddress(env, jKey, jKeyOffset);
+    const char* value = getDirectBufferAddress(env, jValue, jValueOffset);
+    uint64_t version;
+    try {
+        ramcloud->write(jTableId,
+                        key, static_cast<uint16_t>(jKeyLength),
+                        value, jValueLength,
+                        NULL,
+                        &version);
+    } EXCEPTION_CATCHER(-1);
+    return static_cast<jlong>(version);
+}
+
+/*
+ * Class:     edu_stanford_ramcloud_JRamCloud
+ * Method:    multiReadStart
+ * Signature: (J[Ljava/nio/ByteBuffer;[I[I[Ljava/nio/ByteBuffer;[I[I)J
+ */
+JNIEXPORT jlong
+JNICALL Java_edu_stanford_ramcloud_JRamCloud_multiReadStart(JNIEnv *env,
+                                      jobject jRamCloud,
+                                      jlong jTableId,
+                                      jobjectArray jKeys,
+                                      jintArray jKeyOffsets,
+                                      jintArray jKeyLengths,
+                                      jobjectArray jValues,
+                                      jintArray jValueOffsets,
+                                      jintArray jValueSpace)
+{
+    RamCloud* ramcloud = getRamCloud(env, jRamCloud);
+    jsize numObjects = env->GetArrayLength(jKeys);
+    std::unique_ptr<JMultiOp> op(new JMultiOp(numObjects));
+
+    std::vector<jint> keyOffsets(numObjects);
+    std::vector<jint> keyLengths(numObjects);
+    std::vector<jint> valueOffsets(numObjects);
+    env->GetIntArrayRegion(jKeyOffsets, 0, numObjects, keyOffsets.data());
+    env->GetIntArrayRegion(jKeyLengths, 0, numObjects, keyLengths.data());
+    env->GetIntArrayRegion(jValueOffsets, 0, numObjects, valueOffsets.data());
+    env->GetIntArrayRegion(jValueSpace, 0, numObjects, op->space.data());
+
+    for (jsize i = 0; i < numObjects; i++) {
+        jobject jKey = env->GetObjectArrayElement(jKeys, i);
+        jobject jValue = env->GetObjectArrayElement(jValues, i);
+        op->reads[i] = MultiReadObject(jTableId,
+                getDirectBufferAddress(env, jKey, keyOffsets[i]),
+                static_cast<uint16_t>(keyLengths[i]),
+                &op->values[i]);
+        op->readRequests[i] = &op->reads[i];
+        op->destinations[i] = getDirectBufferAddress(env, jValue,
+                                                     valueOffsets[i]);
+        env->DeleteLocalRef(jKey);
+        env->DeleteLocalRef(jValue);
+    }
+
+    try {
+        op->multiRead.construct(ramcloud, op->readRequests.data(),
+                                numObjects);
+    } EXCEPTION_CATCHER(0);
+    return reinterpret_cast<jlong>(op.release());
+}
+
+/*
+ * Class:     edu_stanford_ramcloud_JRamCloud
+ * Method:    multiWriteStart
+ * Signature: (J[Ljava/nio/ByteBuffer;[I[I[Ljava/nio/ByteBuffer;[I[I)J
+ */
+JNIEXPORT jlong
+JNICALL Java_edu_stanford_ramcloud_JRamCloud_multiWriteStart(JNIEnv *env,
+                                       jobject jRamCloud,
+                                       jlong jTableId,
+                                       jobjectArray jKeys,
+                                       jintArray jKeyOffsets,
+                                       jintArray jKeyLengths,
+                                       jobjectArray jValues,
+                                       jintArray jValueOffsets,
+                                       jintArray jValueLengths)
+{
+    RamCloud* ramcloud = getRamCloud(env, jRamCloud);
+    jsize numObjects = env->GetArrayLength(jKeys);
+    std::unique_ptr<JMultiOp> op(new JMultiOp(numObjects));
+
+    std::vector<jint> keyOffsets(numObjects);
+    std::vector<jint> keyLengths(numObjects);
+    std::vector<jint> valueOffsets(numObjects);
+    std::vector<jint> valueLengths(numObjects);
+    env->GetIntArrayRegion(jKeyOffsets, 0, numObjects, keyOffsets.data());
+    env->GetIntArrayRegion(jKeyLengths, 0, numObjects, keyLengths.data());
+    env->GetIntArrayRegion(jValueOffsets, 0, numObjects, valueOffsets.data());
+    env->GetIntArrayRegion(jValueLengths, 0, numObjects, valueLengths.data());
+
+    for (jsize i = 0; i < numObjects; i++) {
+        jobject jKey = env->GetObjectArrayElement(jKeys, i);
+        jobject jValue = env->GetObjectArrayElement(jValues, i);
+        op->writes[i] = MultiWriteObject(jTableId,
+                getDirectBufferAddress(env, jKey, keyOffsets[i]),
+                static_cast<uint16_t>(keyLengths[i]),
+                getDirectBufferAddress(env, jValue, valueOffsets[i]),
+                valueLengths[i]);
+        op->writeRequests[i] = &op->writes[i];
+        env->DeleteLocalRef(jKey);
+        env->DeleteLocalRef(jValue);
+    }
+
+    try {
+        op->multiWrite.construct(ramcloud, op->writeRequests.data(),
+                                 numObjects);
+    } EXCEPTION_CATCHER(0);
+    return reinterpret_cast<jlong>(op.release());
+}
+
+/*
+ * Class:     edu_stanford_ramcloud_JRamCloud
+ * Method:    multiOpIsReady
+ * Signature: (J)Z
+ */
+JNIEXPORT jboolean
+JNICALL Java_edu_stanford_ramcloud_JRamCloud_multiOpIsReady(JNIEnv *env,
+                                      jobject jRamCloud,
+                                      jlong jHandle)
+{
+    JMultiOp* op = reinterpret_cast<JMultiOp*>(jHandle);
+    bool ready;
+    try {
+        if (op->multiRead)
+            ready = op->multiRead->isReady();
+        else
+            ready = op->multiWrite->isReady();
+    } EXCEPTION_CATCHER(true);
+    return ready;
+}
+
+/*
+ * Class:     edu_stanford_ramcloud_JRamCloud
+ * Method:    multiOpFinish
+ * Signature: (J[I[J[I)V
+ */
+JNIEXPORT void
+JNICALL Java_edu_stanford_ramcloud_JRamCloud_multiOpFinish(JNIEnv *env,
+                                     jobject jRamCloud,
+                                     jlong jHandle,
+                                     jintArray jLengths,
+                                     jlongArray jVersions,
+                                     jintArray jStatuses)
+{
+    std::unique_ptr<JMultiOp> op(reinterpret_cast<JMultiOp*>(jHandle));
+    jsize numObjects = op->numObjects;
+    std::vector<jint> lengths(numObjects);
+    std::vector<jlong> versions(numObjects);
+    std::vector<jint> statuses(numObjects);
+    try {
+        if (op->multiRead) {
+            op->multiRead->wait();
+            for (jsize i = 0; i < numObjects; i++) {
+                Tub<Buffer>& value = op->values[i];
+                statuses[i] = op->reads[i].status;
+                versions[i] = op->reads[i].version;
+                if (value) {
+                    lengths[i] = value->getTotalLength();
+                    value->copy(0, std::min(lengths[i], op->space[i]),
+                                op->destinations[i]);
+                }
+            }
+        } else {
+            op->multiWrite->wait();
+            for (jsize i = 0; i < numObjects; i++) {
+                statuses[i] = op->writes[i].status;
+                versions[i] = op->writes[i].version;
+            }
+        }
+    } EXCEPTION_CATCHER();
+
+    env->SetIntArrayRegion(jLengths, 0, numObjects, lengths.data());
+    env->SetLongArrayRegion(jVersions, 0, numObjects, versions.data());
+    env->SetIntArrayRegion(jStatuses, 0, numObjects, statuses.data());
+}
@@ -0,0 +1,104 @@
+#!/usr/bin/env python
+
+# Copyright (c) 2013 Stanford University
+#
+# Permission to use, copy, modify, and distribute this software for any
+# purpose with or without fee is hereby granted, provided that the above
+# copyright notice and this permission notice appear in all copies.
+#
+# THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+# WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+# MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+# ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+# WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+# ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+# OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+
+"""Measure the read and write throughput of the Python bindings.
+
+Compares the single-object calls (which copy every value through a
+temporary ctypes buffer) with read_into, which reads directly into a
+bytearray, and with multi_read/multi_write, which also batch many objects
+into each RPC.  The async variant keeps two batches outstanding at once.
+
+Run this program with --help for usage."""
+
+import sys
+import time
+from optparse import OptionParser
+
+import ramcloud
+
+def measure(name, count, f):
+    """Run f, which performs count operations, and print the throughput."""
+    start = time.time()
+    f()
+    elapsed = time.time() - start
+    print '%-20s %10.1f kops/sec' % (name, count / elapsed / 1e3)
+
+def main():
+    parser = OptionParser()
+    parser.add_option('-C', '--coordinator', dest='coordinator',
+                      default='fast+udp:host=127.0.0.1,port=12246',
+                      help='service locator of the cluster coordinator')
+    parser.add_option('-n', '--count', dest='count', type='int',
+                      default=10000, help='number of objects in the table')
+    parser.add_option('-s', '--size', dest='size', type='int', default=100,
+                      help='size of each object in bytes')
+    parser.add_option('-b', '--batch', dest='batch', type='int', default=100,
+                      help='number of objects per multi_read/multi_write')
+    (options, args) = parser.parse_args()
+
+    rc = ramcloud.RAMCloud()
+    rc.connect(options.coordinator)
+    rc.create_table('pyBenchmark')
+    table = rc.get_table_id('pyBenchmark')
+
+    count = options.count - options.count % options.batch
+    value = 'x' * options.size
+    keys = range(count)
+    batches = [keys[i:i + options.batch]
+               for i in range(0, count, options.batch)]
+    buffers = [bytearray(options.size) for i in range(options.batch)]
+
+    def write():
+        for key in keys:
+            rc.write(table, key, value)
+    def multi_write():
+        for batch in batches:
+            rc.multi_write(table, [(key, value) for key in batch])
+    def read():
+        for key in keys:
+            rc.read(table, key)
+    def read_into():
+        for key in keys:
+            rc.read_into(table, key, buffers[0])
+    def multi_read():
+        for batch in batches:
+            rc.multi_read(table, batch, buffers)
+    def multi_read_async():
+        # Two sets of buffers, so one batch can be in flight while the
+        # previous one is being waited for.
+        current = buffers
+        spare = [bytearray(options.size) for i in range(options.batch)]
+        pending = None
+        for batch in batches:
+            op = rc.multi_read_async(table, batch, current)
+            if pending is not None:
+                pending.wait()
+            pending = op
+            current, spare = spare, current
+        if pending is not None:
+            pending.wait()
+
+    measure('write', count, write)
+    measure('multi_write', count, multi_write)
+    measure('read', count, read)
+    measure('read_into', count, read_into)
+    measure('multi_read', count, multi_read)
+    measure('multi_read_async', count, multi_read_async)
+
+    rc.drop_table('pyBenchmark')
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -45,6 +45,30 @@ class RejectRules(ctypes.Structure):
         return RejectRules(object_doesnt_exist=True, version_gt_given=True,
                            given_version=want_version)
 
+class MultiReadObject(ctypes.Structure):
+    """Mirrors struct rc_multiReadObject in CRamCloud.h."""
+    _fields_ = [("tableId", ctypes.c_uint64),
+                ("key", ctypes.c_char_p),
+                ("keyLength", ctypes.c_uint16),
+                ("buf", ctypes.c_void_p),
+                ("maxLength", ctypes.c_uint32),
+                ("actualLength", ctypes.c_uint32),
+                ("version", ctypes.c_uint64),
+                ("status", ctypes.c_int),
+                ]
+
+class MultiWriteObject(ctypes.Structure):
+    """Mirrors struct rc_multiWriteObject in CRamCloud.h."""
+    _fields_ = [("tableId", ctypes.c_uint64),
+                ("key", ctypes.c_char_p),
+                ("keyLength", ctypes.c_uint16),
+                ("buf", ctypes.c_void_p),
+                ("length", ctypes.c_uint32),
+                ("rejectRules", ctypes.POINTER(RejectRules)),
+                ("version", ctypes.c_uint64),
+                ("status", ctypes.c_int),
+                ]
+
 
 def load_so():
     not_found = ImportError("Couldn't find libramcloud.so, ensure it is " +
@@ -109,6 +133,7 @@ def load_so():
     key                 = ctypes.c_char_p
     keyLength           = ctypes.c_uint16
     len                 = ctypes.c_uint32
+    multiOp             = ctypes.c_void_p
     name                = ctypes.c_char_p
     nanoseconds         = ctypes.c_uint64
     nonce               = ctypes.c_uint64
@@ -141,6 +166,26 @@ def load_so():
                            buf, len, POINTER(len)]
     so.rc_read.restype  = status
 
+    so.rc_multiRead.argtypes = [client, POINTER(MultiReadObject), len]
+    so.rc_multiRead.restype  = status
+
+    so.rc_multiReadStart.argtypes = [client, POINTER(MultiReadObject), len,
+                                     POINTER(multiOp)]
+    so.rc_multiReadStart.restype  = status
+
+    so.rc_multiWrite.argtypes = [client, POINTER(MultiWriteObject), len]
+    so.rc_multiWrite.restype  = status
+
+    so.rc_multiWriteStart.argtypes = [client, POINTER(MultiWriteObject), len,
+                                      POINTER(multiOp)]
+    so.rc_multiWriteStart.restype  = status
+
+    so.rc_multiOpIsReady.argtypes = [multiOp]
+    so.rc_multiOpIsReady.restype  = ctypes.c_int
+
+    so.rc_multiOpFinish.argtypes = [multiOp]
+    so.rc_multiOpFinish.restype  = status
+
     so.rc_remove.argtypes = [client, table, key, keyLength, rejectRules,
                              POINTER(version)]
     so.rc_remove.restype  = status
@@ -181,6 +226,20 @@ def _ctype_copy(addr, var, width):
     ctypes.memmove(addr, ctypes.addressof(var), width)
     return addr + width
 
+def _buffer_address(data, writable):
+    """Return the address of the memory behind an object supporting the
+    buffer protocol (str, bytearray, mmap, array, ...), without copying it.
+
+    Read-only objects such as str are only accepted if writable is False.
+    """
+    if type(data) is str:
+        if writable:
+            raise TypeError('read-only buffer: use a bytearray instead')
+        return ctypes.cast(ctypes.c_char_p(data), ctypes.c_void_p).value
+    if not data:
+        return None
+    return ctypes.addressof((ctypes.c_char * len(data)).from_buffer(data))
+
 def get_key(id):
     if type(id) is int:
         return str(id)
@@ -212,6 +271,54 @@ class VersionError(Exception):
         self.want_version = want_version
         self.got_version = got_version
 
+class MultiOp(object):
+    """An outstanding multi_read_async or multi_write_async operation.
+
+    Holds references to the keys and buffers of the operation so they stay
+    alive until it completes.  wait() must be called exactly once.
+    """
+
+    def __init__(self, ramcloud, objects, buffers, is_read):
+        self.ramcloud = ramcloud
+        self.objects = objects
+        self.buffers = buffers
+        self.is_read = is_read
+        self.op = ctypes.c_void_p()
+
+    def __del__(self):
+        if self.op:
+            so.rc_multiOpFinish(self.op)
+
+    def is_ready(self):
+        """Make progress on the operation without blocking and return True
+        if it has completed."""
+        return so.rc_multiOpIsReady(self.op) != 0
+
+    def wait(self):
+        """Wait for the operation to complete.
+
+        For reads, returns a list with an entry for each object: either
+        (length, version), where length is the total size of the object
+        (only the part that fit was copied into its buffer), or None if
+        the object doesn't exist.  For writes, returns the list of new
+        versions.
+        """
+        s = so.rc_multiOpFinish(self.op)
+        self.op = None
+        self.ramcloud.handle_error(s)
+        results = []
+        for object in self.objects:
+            if self.is_read:
+                if object.status == 3:      # STATUS_OBJECT_DOESNT_EXIST
+                    results.append(None)
+                    continue
+                self.ramcloud.handle_error(object.status, object.version)
+                results.append((object.actualLength, object.version))
+            else:
+                self.ramcloud.handle_error(object.status, object.version)
+                results.append(object.version)
+        return results
+
 class RAMCloud(object):
     def __init__(self):
         self.client = ctypes.c_void_p()
@@ -297,6 +404,79 @@ class RAMCloud(object):
         self.handle_error(s, got_version.value)
         return (buf.raw[0:actual_length.value], got_version.value)
 
+    def read_into(self, table_id, id, buffer):
+        """Read an object directly into a writable buffer (bytearray, mmap,
+        array, ...), avoiding the copies made by read().
+
+        Returns (length, version), where length is the total size of the
+        object; if it is larger than the buffer, only the part that fits
+        is copied.
+        """
+        actual_length = ctypes.c_uint32()
+        got_version = ctypes.c_uint64()
+        reject_rules = RejectRules(object_doesnt_exist=True)
+        self.hook()
+        s = so.rc_read(self.client, table_id, get_key(id), get_keyLength(id),
+                       ctypes.byref(reject_rules), ctypes.byref(got_version),
+                       _buffer_address(buffer, True), len(buffer),
+                       ctypes.byref(actual_length))
+        self.handle_error(s, got_version.value)
+        return (actual_length.value, got_version.value)
+
+    def multi_read(self, table_id, ids, buffers):
+        """Read many objects from a table at once, directly into buffers.
+
+        buffers holds one writable buffer for each id.  See MultiOp.wait
+        for the result.
+        """
+        return self.multi_read_async(table_id, ids, buffers).wait()
+
+    def multi_read_async(self, table_id, ids, buffers):
+        """Start a multi_read and return its MultiOp without waiting for
+        the objects to arrive."""
+        assert len(ids) == len(buffers)
+        objects = (MultiReadObject * len(ids))()
+        for i, (id, buffer) in enumerate(zip(ids, buffers)):
+            objects[i].tableId = table_id
+            objects[i].key = get_key(id)
+            objects[i].keyLength = get_keyLength(id)
+            objects[i].buf = _buffer_address(buffer, True)
+            objects[i].maxLength = len(buffer)
+        op = MultiOp(self, objects, buffers, True)
+        self.hook()
+        s = so.rc_multiReadStart(self.client, objects, len(ids),
+                                 ctypes.byref(op.op))
+        self.handle_error(s)
+        return op
+
+    def multi_write(self, table_id, items):
+        """Write many objects to a table at once.
+
+        items is a list of (id, data) pairs, where data is a str or any
+        other object supporting the buffer protocol; it is sent without
+        being copied.  Returns the list of new versions.
+        """
+        return self.multi_write_async(table_id, items).wait()
+
+    def multi_write_async(self, table_id, items):
+        """Start a multi_write and return its MultiOp without waiting for
+        the writes to complete."""
+        objects = (MultiWriteObject * len(items))()
+        buffers = []
+        for i, (id, data) in enumerate(items):
+            objects[i].tableId = table_id
+            objects[i].key = get_key(id)
+            objects[i].keyLength = get_keyLength(id)
+            objects[i].buf = _buffer_address(data, False)
+            objects[i].length = len(data)
+            buffers.append(data)
+        op = MultiOp(self, objects, buffers, False)
+        self.hook()
+        s = so.rc_multiWriteStart(self.client, objects, len(items),
+                                  ctypes.byref(op.op))
+        self.handle_error(s)
+        return op
+
     def update(self, table_id, id, data, want_version=None):
         if want_version:
             reject_rules = RejectRules.exactly(want_version)
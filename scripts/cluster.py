@@ -54,6 +54,10 @@ server_locator_templates = {
     'unreliable+infud': 'unreliable+infud:',
     'fast+infeth': 'fast+infeth:mac=00:11:22:33:44:%(id)02x',
     'unreliable+infeth': 'unreliable+infeth:mac=00:11:22:33:44:%(id)02x',
+    # Clients on other hosts can't use shared memory, so they fall back
+    # to tcp.
+    'shm': ('shm:name=%(host1g)s-%(port)d,host=%(host1g)s;'
+            'tcp:host=%(host)s,port=%(port)d'),
 }
 coord_locator_templates = {
     'tcp': 'tcp:host=%(host)s,port=%(port)d',
@@ -68,6 +72,7 @@ coord_locator_templates = {
     'unreliable+infud': 'fast+udp:host=%(host)s,port=%(port)d',
     'fast+infeth': 'fast+udp:host=%(host)s,port=%(port)d',
     'unreliable+infeth': 'fast+udp:host=%(host)s,port=%(port)d',
+    'shm': 'tcp:host=%(host)s,port=%(port)d',
 }
 
 def server_locator(transport, host, port=server_port):
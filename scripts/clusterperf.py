@@ -167,6 +167,14 @@ def run_test(
         client_args['--size'] = options.size
     if options.warmup != None:
         client_args['--warmup'] = options.warmup
+    if options.server_latency:
+        client_args['--serverLatency'] = 'true'
+    if options.records != None:
+        client_args['--records'] = options.records
+    if options.target_ops != None:
+        client_args['--targetOps'] = options.target_ops
+    if options.key_distribution != None:
+        client_args['--keyDistribution'] = options.key_distribution
     test.function(test.name, options, cluster_args, client_args)
 
 #-------------------------------------------------------------------
@@ -254,6 +262,15 @@ def readDist(name, options, cluster_args, client_args):
           % options.size)
     print_cdf_from_log()
 
+def readDuringMigration(name, options, cluster_args, client_args):
+    if options.num_servers == None:
+        cluster_args['num_servers'] = 2
+    if options.count == None:
+        client_args['--count'] = 10000
+    cluster.run(client='%s/ClusterPerf %s %s' %
+            (obj_path, flatten_args(client_args), name), **cluster_args)
+    print(get_client_log(), end='')
+
 def readLoaded(name, options, cluster_args, client_args):
     if 'num_clients' not in cluster_args:
         cluster_args['num_clients'] = 20
@@ -261,6 +278,13 @@ def readLoaded(name, options, cluster_args, client_args):
             (obj_path, flatten_args(client_args), name), **cluster_args)
     print(get_client_log(), end='')
 
+def readVsLoad(name, options, cluster_args, client_args):
+    if options.count == None:
+        client_args['--count'] = 10000
+    cluster.run(client='%s/ClusterPerf %s %s' %
+            (obj_path, flatten_args(client_args), name), **cluster_args)
+    print(get_client_log(), end='')
+
 def readRandom(name, options, cluster_args, client_args):
     cluster_args['timeout'] = 60
     if 'num_clients' not in cluster_args:
@@ -272,6 +296,19 @@ def readRandom(name, options, cluster_args, client_args):
             (obj_path, flatten_args(client_args), name), **cluster_args)
     print(get_client_log(), end='')
 
+def ycsb(name, options, cluster_args, client_args):
+    cluster_args['timeout'] = 300
+    if 'num_clients' not in cluster_args:
+        cluster_args['num_clients'] = 4
+    if options.num_servers == None:
+        cluster_args['num_servers'] = len(hosts)
+    if options.count == None:
+        client_args['--count'] = 100000
+    client_args['--numTables'] = cluster_args['num_servers'];
+    cluster.run(client='%s/ClusterPerf %s %s' %
+            (obj_path, flatten_args(client_args), name), **cluster_args)
+    print(get_client_log(), end='')
+
 #-------------------------------------------------------------------
 #  End of driver functions.
 #-------------------------------------------------------------------
@@ -288,7 +325,9 @@ simple_tests = [
     Test("broadcast", broadcast),
     Test("netBandwidth", netBandwidth),
     Test("readAllToAll", readAllToAll),
+    Test("readDuringMigration", readDuringMigration),
     Test("readNotFound", default),
+    Test("transactionVsRetry", default),
     Test("writeAsyncSync", default),
 ]
 
@@ -302,7 +341,15 @@ graph_tests = [
     Test("readVaryingKeyLength", default),
     Test("writeVaryingKeyLength", default),
     Test("readLoaded", readLoaded),
-    Test("readRandom", readRandom)
+    Test("readRandom", readRandom),
+    Test("readVsLoad", readVsLoad),
+    Test("readVsThreads", default),
+    Test("ycsbA", ycsb),
+    Test("ycsbB", ycsb),
+    Test("ycsbC", ycsb),
+    Test("ycsbD", ycsb),
+    Test("ycsbE", ycsb),
+    Test("ycsbF", ycsb)
 ]
 
 if __name__ == '__main__':
@@ -330,6 +377,11 @@ if __name__ == '__main__':
             choices=['DEBUG', 'NOTICE', 'WARNING', 'ERROR', 'SILENT'],
             metavar='L', dest='log_level',
             help='Controls degree of logging in servers')
+    parser.add_option('--keyDistribution', metavar='DIST',
+            dest='key_distribution',
+            choices=['uniform', 'zipfian', 'latest'],
+            help='Distribution the YCSB tests use to choose keys (default: '
+                 "each workload's own)")
     parser.add_option('-b', '--numBackups', type=int, default=1,
             metavar='N', dest='backups_per_server',
             help='Number of backups to run on each server host '
@@ -337,11 +389,21 @@ if __name__ == '__main__':
     parser.add_option('-r', '--replicas', type=int, default=3,
             metavar='N',
             help='Number of disk backup copies for each segment')
+    parser.add_option('--records', type=int, metavar='N',
+            help='Number of objects loaded by the YCSB tests')
     parser.add_option('--servers', type=int,
             metavar='N', dest='num_servers',
             help='Number of hosts on which to run servers')
+    parser.add_option('--serverLatency', action='store_true', default=False,
+            dest='server_latency',
+            help='Also print server-side latencies for each stage of an '
+            'RPC, for tests that support this')
     parser.add_option('-s', '--size', type=int, default=100,
             help='Object size in bytes')
+    parser.add_option('--targetOps', type=float, metavar='OPS',
+            dest='target_ops',
+            help='If specified, each client in the YCSB tests issues '
+                 'operations open-loop at this average rate (ops/sec)')
     parser.add_option('-t', '--timeout', type=int, default=20,
             metavar='SECS',
             help="Abort if the client application doesn't finish within "
@@ -18,6 +18,11 @@
 This file contains the definitions for all of the RawMetrics supported by
 RAMCloud.  When executed, it generates two files, RawMetrics.in.h and
 RawMetrics.in.cc, which are included by other files when building RAMCloud.
+
+The counters are declared in RawMetrics.in.h in exactly the order in which
+RawMetrics.in.cc numbers them: the per-thread shards in RawMetrics.cc find
+a counter's slot from its position in the RawMetrics object, and aggregate
+the slots using those numbers.
 """
 
 from __future__ import division, print_function
@@ -110,6 +115,12 @@ class Group:
     def group(self, group):
         self.groups.append(group)
 
+    def children(self):
+        """ Subgroups and metrics, in the order that they are laid out in
+            memory and numbered by metricInfo.
+        """
+        return self.groups + self.metrics
+
     def dump_header(self, out):
         indent = ' ' * 4 * (out._indent + 2)
         out('/// %s' % self.documentation)
@@ -118,7 +129,7 @@ class Group:
             out('struct %s {' % self.name)
         else:
             constructorBody = 'init();'
-        children = self.groups + self.metrics;
+        children = self.children()
         out('    %s()' % self.name)
         out('        : %s {%s}' %
             (('\n%s, ' % (indent)).join(
@@ -149,7 +160,7 @@ class Group:
         prefix = path
         if len(path) != 0:
             prefix += '.'
-        for child in self.groups + self.metrics:
+        for child in self.children():
             child.dump_metric_info_code(out,
                     prefix + child.instance_name(), counter)
 
@@ -346,6 +357,9 @@ rpc.metric('multiWriteCount', 'number of invocations of MULTI_WRITE RPC')
 rpc.metric('verifyMembershipCount', 'number of invocations of VERIFY_MEMBERSHIP RPC')
 rpc.metric('getRuntimeOptionCount', 'number of invocations of GET_RUNTIME_OPTION RPC')
 rpc.metric('serverControlCount', 'number of invocations of SERVER_CONTROL RPC')
+rpc.metric('lookupIndexKeysCount', 'number of invocations of LOOKUP_INDEX_KEYS RPC')
+rpc.metric('setTableExpiryCount', 'number of invocations of SET_TABLE_EXPIRY RPC')
+rpc.metric('transactionCount', 'number of invocations of TRANSACTION RPC')
 rpc.metric('illegalRpcCount', 'number of invocations of RPCs with illegal opcodes')
 
 rpc.metric('rpc0Ticks', 'time spent executing RPC 0 (undefined)')
@@ -407,6 +421,9 @@ rpc.metric('multiWriteTicks', 'time spent executing MULTI_WRITE RPC')
 rpc.metric('verifyMembershipTicks', 'number of invocations of VERIFY_MEMBERSHIP')
 rpc.metric('getRuntimeOptionTicks', 'time spent executing GET_RUNTIME_OPTION RPC')
 rpc.metric('serverControlTicks', 'time spent executing SERVER_CONTROL')
+rpc.metric('lookupIndexKeysTicks', 'time spent executing LOOKUP_INDEX_KEYS RPC')
+rpc.metric('setTableExpiryTicks', 'time spent executing SET_TABLE_EXPIRY RPC')
+rpc.metric('transactionTicks', 'time spent executing TRANSACTION RPC')
 rpc.metric('illegalRpcTicks', 'time spent executing RPCs with illegal opcodes')
 
 transmit = Group('Transmit', 'metrics related to transmitting messages')
@@ -443,6 +460,16 @@ transport.metric('retrySessionOpenCount',
 transport.metric('clientRpcsActiveTicks',
     'time with a client RPC active on the network')
 
+serviceManager = Group('ServiceManager',
+    'metrics for RPCs waiting for worker threads')
+for c in ['foreground', 'recovery', 'background']:
+    serviceManager.metric('%sWaitCount' % c,
+        'number of %s RPCs that had to wait for a worker thread' % c)
+    serviceManager.metric('%sWaitTicks' % c,
+        'total time %s RPCs spent waiting for worker threads' % c)
+serviceManager.metric('deadlineMissedCount',
+    'number of RPCs rejected because their deadlines passed while waiting')
+
 temp = Group('Temp', 'metrics for temporary use')
 for i in range(10):
     temp.metric('ticks{0:}'.format(i),'amount of time for some undefined activity')
@@ -454,6 +481,7 @@ definitions.group(master);
 definitions.group(backup);
 definitions.group(rpc);
 definitions.group(transport);
+definitions.group(serviceManager);
 definitions.group(temp);
 definitions.metric('serverId', 'server id assigned by coordinator')
 definitions.metric('pid', 'process ID on machine')
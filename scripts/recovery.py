@@ -42,6 +42,7 @@ def recover(num_servers,
             master_ram=None,
             old_master_ram=None,
             num_removals=0,
+            max_bytes_per_partition=0,
             timeout=100,
             log_level='NOTICE',
             log_dir='logs',
@@ -108,6 +109,13 @@ def recover(num_servers,
                          recoveries where some of the log contains tombstones.
     @type  num_removals: C{int}
 
+    @param max_bytes_per_partition: If nonzero, the coordinator divides the
+                                    old Master's tablets into partitions of
+                                    about this many bytes each using its table
+                                    stats, splitting large tablets, instead of
+                                    recovering each tablet separately.
+    @type  max_bytes_per_partition: C{int}
+
     @param timeout: Seconds to wait before giving up and declaring the recovery
                     to have failed.
     @type  timeout: C{int}
@@ -168,6 +176,9 @@ def recover(num_servers,
                       '-t %d -k %d -l %s' % (client_binary,
                       num_objects, num_removals, object_size,
                       num_partitions, num_servers, log_level))
+    if max_bytes_per_partition:
+        args['client'] += (' --maxBytesPerPartition %d' %
+                           max_bytes_per_partition)
     args['old_master_host'] = config.old_master_host
     args['client_hosts'] = [config.old_master_host]
     if old_master_ram:
@@ -266,6 +277,11 @@ if __name__ == '__main__':
     parser.add_option('--masterRam', type=int,
             metavar='N', dest='master_ram',
             help='Megabytes to allocate for the log per recovery master')
+    parser.add_option('--maxBytesPerPartition', type=int, default=0,
+            metavar='BYTES', dest='max_bytes_per_partition',
+            help=('Have the coordinator balance recovery partitions so that '
+                  'each holds about this many bytes (0 means one partition '
+                  'per tablet)'))
     parser.add_option('--oldMasterRam', type=int,
             metavar='N', dest='old_master_ram',
             help='Megabytes to allocate for the log of the old master')
@@ -287,6 +303,7 @@ if __name__ == '__main__':
     args['master_ram'] = options.master_ram
     args['old_master_ram'] = options.old_master_ram
     args['num_removals'] = options.num_removals
+    args['max_bytes_per_partition'] = options.max_bytes_per_partition
     args['timeout'] = options.timeout
     args['log_level'] = options.log_level
     args['log_dir'] = options.log_dir
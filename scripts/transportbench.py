@@ -61,9 +61,9 @@ if __name__ == '__main__':
         dest='cached', default=False, action="store_true",
         help='Read the same object repeatedly')
     options, args = parser.parse_args()
-    if options.transport not in locators['coordinator']:
+    if options.transport not in server_locator_templates:
         print('First argument must be a transport, one of:',
-              locators['coordinator'].keys())
+              server_locator_templates.keys())
         sys.exit(-1)
 
     print('Running', options.transport, 'with',
@@ -16,6 +16,7 @@
 #include <assert.h>
 #include <stdint.h>
 
+#include "CleanerCandidateIndex.h"
 #include "Log.h"
 #include "LogCleaner.h"
 #include "ServerConfig.h"
@@ -49,6 +50,7 @@ AbstractLog::AbstractLog(LogEntryHandlers* entryHandlers,
       segmentSize(segmentSize),
       head(NULL),
       appendLock("AbstractLog::appendLock"),
+      pendingAppends(NULL),
       metrics()
 {
 }
@@ -75,37 +77,32 @@ AbstractLog::AbstractLog(LogEntryHandlers* entryHandlers,
 bool
 AbstractLog::append(AppendVector* appends, uint32_t numAppends)
 {
-    CycleCounter<uint64_t> _(&metrics.totalAppendTicks);
-    Lock lock(appendLock);
-    metrics.totalAppendCalls++;
-
-    uint32_t lengths[numAppends];
-    for (uint32_t i = 0; i < numAppends; i++)
-        lengths[i] = appends[i].buffer.getTotalLength();
-
-    if (head == NULL || !head->hasSpaceFor(lengths, numAppends)) {
-        if (!allocNewWritableHead())
-            return false;
+    LatencyMetrics::Timer _(LatencyMetrics::LOG_APPEND);
+
+    // Rather than have every writer take turns acquiring the append lock
+    // (and bouncing the head segment's cache lines between cores), writers
+    // publish their requests on a list and whichever one holds the lock
+    // applies all of the requests that have accumulated. See PendingAppend.
+    PendingAppend request(appends, numAppends);
+    PendingAppend* first = pendingAppends.load(std::memory_order_relaxed);
+    do {
+        request.next = first;
+    } while (!pendingAppends.compare_exchange_weak(first, &request,
+                                                   std::memory_order_release,
+                                                   std::memory_order_relaxed));
+
+    int state;
+    while ((state = request.state.load(std::memory_order_acquire)) ==
+            PendingAppend::WAITING) {
+        if (appendLock.try_lock()) {
+            Lock lock(appendLock, std::adopt_lock);
+            applyPendingAppends(lock);
+        }
     }
 
-    if (head->isEmergencyHead)
-        return false;
-
-    if (!head->hasSpaceFor(lengths, numAppends))
+    if (state == PendingAppend::TOO_BIG)
         throw FatalError(HERE, "too much data to append to one segment");
-
-    LogSegment* headBefore = head;
-    for (uint32_t i = 0; i < numAppends; i++) {
-        bool enoughSpace = append(lock,
-                                  appends[i].type,
-                                  appends[i].buffer,
-                                  &appends[i].reference);
-        if (!enoughSpace)
-            throw FatalError(HERE, "Guaranteed append managed to fail");
-    }
-    assert(head == headBefore);
-
-    return true;
+    return state == PendingAppend::SUCCEEDED;
 }
 
 /**
@@ -131,6 +128,7 @@ AbstractLog::free(Reference reference)
     uint32_t lengthWithMetadata;
     segment.getEntry(offset, buffer, &lengthWithMetadata);
     segment.liveBytes -= lengthWithMetadata;
+    CleanerCandidateIndex::liveBytesChanged(&segment);
 }
 
 /**
@@ -250,6 +248,85 @@ AbstractLog::append(Lock& appendLock,
             uint32_t length,
             Reference* outReference,
             uint64_t* outTickCounter)
+{
+    return appendEntry(appendLock, type, buffer, NULL, length,
+                       outReference, outTickCounter);
+}
+
+/**
+ * Append a typed entry to the log by coping in the data. Entries are binary
+ * blobs described by a simple <type, length> tuple.
+ *
+ * Note that the append operation is not synchronous with respect to backups.
+ * To ensure that the data appended has been safely written to backups, the
+ * sync() method must be invoked after appending. Until sync() is called, the
+ * data may or may not have been made durable.
+ *
+ * \param appendLock
+ *      The append lock must have already been acquired before entering this
+ *      method. This parameter exists in the hopes that you don't forget to
+ *      do that.
+ * \param type
+ *      Type of the entry. See LogEntryTypes.h.
+ * \param buffer
+ *      Buffer object containing the entry to be appended.
+ * \param[out] outReference
+ *      If the append succeeds, a reference to the created entry is returned
+ *      here. This reference may be used to access the appended entry via the
+ *      lookup method. It may also be inserted into a HashTable.
+ * \param[out] outTickCounter
+ *      If non-NULL, store the number of processor ticks spent executing this
+ *      method.
+ * \return
+ *      True if the append succeeded, false if there was insufficient space to
+ *      complete the operation.
+ */
+bool
+AbstractLog::append(Lock& appendLock,
+            LogEntryType type,
+            Buffer& buffer,
+            Reference* outReference,
+            uint64_t* outTickCounter)
+{
+    return appendEntry(appendLock, type, NULL, &buffer,
+                       buffer.getTotalLength(), outReference, outTickCounter);
+}
+
+/**
+ * Common core of the private append() methods. The entry's contents are
+ * given either as a contiguous block of memory (#data) or as a Buffer
+ * (#buffer), which is copied into the segment chunk by chunk. Exactly one of
+ * the two must be non-NULL.
+ *
+ * \param appendLock
+ *      The append lock must have already been acquired before entering this
+ *      method.
+ * \param type
+ *      Type of the entry. See LogEntryTypes.h.
+ * \param data
+ *      Pointer to the entry to be appended, or NULL if #buffer is given.
+ * \param buffer
+ *      Buffer containing the entry to be appended, or NULL if #data is given.
+ * \param length
+ *      Size of the entry in bytes.
+ * \param[out] outReference
+ *      If the append succeeds, a reference to the created entry is returned
+ *      here.
+ * \param[out] outTickCounter
+ *      If non-NULL, store the number of processor ticks spent executing this
+ *      method.
+ * \return
+ *      True if the append succeeded, false if there was insufficient space
+ *      to complete the operation.
+ */
+bool
+AbstractLog::appendEntry(Lock& appendLock,
+                         LogEntryType type,
+                         const void* data,
+                         Buffer* buffer,
+                         uint32_t length,
+                         Reference* outReference,
+                         uint64_t* outTickCounter)
 {
     CycleCounter<uint64_t> _(outTickCounter);
 
@@ -267,13 +344,14 @@ AbstractLog::append(Lock& appendLock,
     // Try to append. If we can't, try to allocate a new head to get more space.
     uint32_t segmentOffset;
     uint32_t bytesUsedBefore = head->getAppendedLength();
-    bool enoughSpace = head->append(type, buffer, length, &segmentOffset);
+    bool enoughSpace =
+        appendToHead(type, data, buffer, length, &segmentOffset);
     if (!enoughSpace) {
         if (!allocNewWritableHead())
             return false;
 
         bytesUsedBefore = head->getAppendedLength();
-        if (!head->append(type, buffer, length, &segmentOffset)) {
+        if (!appendToHead(type, data, buffer, length, &segmentOffset)) {
             // TODO(Steve): We should probably just permit up to 1/N'th of the
             // size of a segment in any single append. Say, 1/2th or 1/4th as
             // a ceiling. Then we could ensure that after opening a new head
@@ -294,52 +372,112 @@ AbstractLog::append(Lock& appendLock,
     head->liveBytes += lengthWithMetadata;
 
     metrics.totalBytesAppended += length;
-    metrics.totalMetadataBytesAppended += (lengthWithMetadata - length);
+    // Objects stored with compact headers may take up less space than their
+    // full form, in which case they add no metadata.
+    if (lengthWithMetadata > length)
+        metrics.totalMetadataBytesAppended += (lengthWithMetadata - length);
 
     return true;
 }
 
 /**
- * Append a typed entry to the log by coping in the data. Entries are binary
- * blobs described by a simple <type, length> tuple.
+ * Append an entry to the current head segment, copying it from either a
+ * contiguous block of memory or a Buffer. See appendEntry() for the
+ * parameters.
+ */
+bool
+AbstractLog::appendToHead(LogEntryType type,
+                          const void* data,
+                          Buffer* buffer,
+                          uint32_t length,
+                          uint32_t* outOffset)
+{
+    if (buffer != NULL)
+        return head->append(type, *buffer, outOffset);
+    return head->append(type, data, length, outOffset);
+}
+
+/**
+ * Apply every request that has been published on #pendingAppends, in the
+ * order in which they were published, and notify each requester of the
+ * outcome. This is invoked by whichever writer acquires the append lock.
  *
- * Note that the append operation is not synchronous with respect to backups.
- * To ensure that the data appended has been safely written to backups, the
- * sync() method must be invoked after appending. Until sync() is called, the
- * data may or may not have been made durable.
+ * \param lock
+ *      The append lock must have already been acquired before entering this
+ *      method.
+ */
+void
+AbstractLog::applyPendingAppends(Lock& lock)
+{
+    CycleCounter<uint64_t> _(&metrics.totalAppendTicks);
+
+    // The list is pushed onto at the front, so reverse it to append entries
+    // in arrival order.
+    PendingAppend* list = pendingAppends.exchange(NULL,
+                                                  std::memory_order_acquire);
+    PendingAppend* ordered = NULL;
+    while (list != NULL) {
+        PendingAppend* next = list->next;
+        list->next = ordered;
+        ordered = list;
+        list = next;
+    }
+
+    while (ordered != NULL) {
+        // The request lives on its owner's stack and may disappear as soon
+        // as its state changes, so don't touch it after that.
+        PendingAppend* request = ordered;
+        ordered = request->next;
+        metrics.totalAppendCalls++;
+        int state = appendVector(lock, request->appends, request->numAppends);
+        request->state.store(state, std::memory_order_release);
+    }
+}
+
+/**
+ * Append multiple entries to the head segment atomically. This is the body
+ * of append(AppendVector*, uint32_t), which describes the parameters.
  *
- * \param appendLock
+ * \param lock
  *      The append lock must have already been acquired before entering this
- *      method. This parameter exists in the hopes that you don't forget to
- *      do that.
- * \param type
- *      Type of the entry. See LogEntryTypes.h.
- * \param buffer
- *      Buffer object containing the entry to be appended.
- * \param[out] outReference
- *      If the append succeeds, a reference to the created entry is returned
- *      here. This reference may be used to access the appended entry via the
- *      lookup method. It may also be inserted into a HashTable.
- * \param[out] outTickCounter
- *      If non-NULL, store the number of processor ticks spent executing this
  *      method.
  * \return
- *      True if the append succeeded, false if there was insufficient space to
- *      complete the operation.
+ *      PendingAppend::SUCCEEDED if the entries were appended,
+ *      PendingAppend::FAILED if there was insufficient space, or
+ *      PendingAppend::TOO_BIG if the entries could never fit in one segment.
  */
-bool
-AbstractLog::append(Lock& appendLock,
-            LogEntryType type,
-            Buffer& buffer,
-            Reference* outReference,
-            uint64_t* outTickCounter)
+int
+AbstractLog::appendVector(Lock& lock,
+                          AppendVector* appends,
+                          uint32_t numAppends)
 {
-    return append(appendLock,
-                  type,
-                  buffer.getRange(0, buffer.getTotalLength()),
-                  buffer.getTotalLength(),
-                  outReference,
-                  outTickCounter);
+    uint32_t lengths[numAppends];
+    for (uint32_t i = 0; i < numAppends; i++)
+        lengths[i] = appends[i].buffer.getTotalLength();
+
+    if (head == NULL || !head->hasSpaceFor(lengths, numAppends)) {
+        if (!allocNewWritableHead())
+            return PendingAppend::FAILED;
+    }
+
+    if (head->isEmergencyHead)
+        return PendingAppend::FAILED;
+
+    if (!head->hasSpaceFor(lengths, numAppends))
+        return PendingAppend::TOO_BIG;
+
+    LogSegment* headBefore = head;
+    for (uint32_t i = 0; i < numAppends; i++) {
+        bool enoughSpace = append(lock,
+                                  appends[i].type,
+                                  appends[i].buffer,
+                                  &appends[i].reference);
+        if (!enoughSpace)
+            throw FatalError(HERE, "Guaranteed append managed to fail");
+    }
+    assert(head == headBefore);
+
+    return PendingAppend::SUCCEEDED;
 }
 
 /**
@@ -16,6 +16,7 @@
 #ifndef RAMCLOUD_ABSTRACTLOG_H
 #define RAMCLOUD_ABSTRACTLOG_H
 
+#include <atomic>
 #include <stdint.h>
 #include <unordered_map>
 #include <vector>
@@ -26,6 +27,7 @@
 #include "SpinLock.h"
 #include "ReplicaManager.h"
 #include "HashTable.h"
+#include "LatencyMetrics.h"
 
 #include "LogMetrics.pb.h"
 
@@ -258,6 +260,7 @@ class AbstractLog {
            uint32_t length,
            Reference* outReference = NULL)
     {
+        LatencyMetrics::Timer _(LatencyMetrics::LOG_APPEND);
         Lock lock(appendLock);
         metrics.totalAppendCalls++;
         return append(lock,
@@ -276,12 +279,12 @@ class AbstractLog {
            Buffer& buffer,
            Reference* outReference = NULL)
     {
+        LatencyMetrics::Timer _(LatencyMetrics::LOG_APPEND);
         Lock lock(appendLock);
         metrics.totalAppendCalls++;
         return append(lock,
                       type,
-                      buffer.getRange(0, buffer.getTotalLength()),
-                      buffer.getTotalLength(),
+                      buffer,
                       outReference,
                       &metrics.totalAppendTicks);
     }
@@ -320,8 +323,58 @@ class AbstractLog {
                 Buffer& buffer,
                 Reference* outReference = NULL,
                 uint64_t* outTickCounter = NULL);
+    bool appendEntry(Lock& lock,
+                     LogEntryType type,
+                     const void* data,
+                     Buffer* buffer,
+                     uint32_t length,
+                     Reference* outReference,
+                     uint64_t* outTickCounter);
+    bool appendToHead(LogEntryType type,
+                      const void* data,
+                      Buffer* buffer,
+                      uint32_t length,
+                      uint32_t* outOffset);
     bool allocNewWritableHead();
 
+    /**
+     * A request to append a vector of entries that a writer has published
+     * on #pendingAppends. Writers that cannot acquire the append lock
+     * leave their requests for the lock holder to apply, so a single
+     * thread appends to the head segment while others are waiting, rather
+     * than the lock (and the head) passing from core to core for every
+     * append. Instances live on the requesting thread's stack.
+     */
+    struct PendingAppend {
+        /// Values of #state.
+        enum { WAITING, SUCCEEDED, FAILED, TOO_BIG };
+
+        PendingAppend(AppendVector* appends, uint32_t numAppends)
+            : appends(appends),
+              numAppends(numAppends),
+              next(NULL),
+              state(WAITING)
+        {
+        }
+
+        /// Entries to append.
+        AppendVector* appends;
+
+        /// Number of entries in #appends.
+        uint32_t numAppends;
+
+        /// Next request on #pendingAppends (published earlier).
+        PendingAppend* next;
+
+        /// WAITING until the request has been applied, then its outcome.
+        std::atomic<int> state;
+
+        DISALLOW_COPY_AND_ASSIGN(PendingAppend);
+    };
+
+    void applyPendingAppends(Lock& lock);
+    int appendVector(Lock& lock, AppendVector* appends, uint32_t numAppends);
+
     /// Various handlers for entries appended to this log. Used to obtain
     /// timestamps and to relocate entries during cleaning.
     LogEntryHandlers* entryHandlers;
@@ -358,6 +411,10 @@ class AbstractLog {
     /// segment in the presence of multiple appending threads.
     SpinLock appendLock;
 
+    /// Requests from append(AppendVector*, uint32_t) waiting to be applied
+    /// by the holder of #appendLock, most recently published first.
+    std::atomic<PendingAppend*> pendingAppends;
+
     /// Various event counters and performance measurements taken during log
     /// operation.
     class Metrics {
@@ -13,6 +13,8 @@
  * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
  */
 
+#include <thread>
+
 #include "TestUtil.h"
 
 #include "Segment.h"
@@ -103,13 +105,13 @@ TEST_F(AbstractLogTest, append_basic) {
 }
 
 static bool
-appendFilter(string s)
+appendEntryFilter(string s)
 {
-    return s == "append";
+    return s == "appendEntry";
 }
 
 TEST_F(AbstractLogTest, append_tooBigToEverFit) {
-    TestLog::Enable _(appendFilter);
+    TestLog::Enable _(appendEntryFilter);
 
     char* data = new char[serverConfig.segmentSize + 1];
     LogSegment* oldHead = l.head;
@@ -119,7 +121,7 @@ TEST_F(AbstractLogTest, append_tooBigToEverFit) {
                           serverConfig.segmentSize + 1),
         FatalError);
     EXPECT_NE(oldHead, l.head);
-    EXPECT_EQ("append: Entry too big to append to log: 131073 bytes of type 2",
+    EXPECT_EQ("appendEntry: Entry too big to append to log: 131073 bytes of type 7",
         TestLog::get());
     delete[] data;
 }
@@ -151,6 +153,63 @@ TEST_F(AbstractLogTest, append_multiple_basics) {
     delete[] data;
 }
 
+TEST_F(AbstractLogTest, append_multiple_combined) {
+    // Simulate a request published by another writer while this one
+    // didn't hold the lock; this thread should apply both, oldest first.
+    Log::AppendVector other;
+    other.type = LOG_ENTRY_TYPE_OBJ;
+    other.buffer.append("other", 5);
+    AbstractLog::PendingAppend pending(&other, 1);
+    l.pendingAppends = &pending;
+
+    Log::AppendVector v;
+    v.type = LOG_ENTRY_TYPE_OBJTOMB;
+    v.buffer.append("mine", 4);
+    uint64_t callsBefore = l.AbstractLog::metrics.totalAppendCalls;
+    EXPECT_TRUE(l.append(&v, 1));
+
+    EXPECT_EQ(AbstractLog::PendingAppend::SUCCEEDED, pending.state.load());
+    EXPECT_TRUE(l.pendingAppends.load() == NULL);
+    EXPECT_EQ(callsBefore + 2, l.AbstractLog::metrics.totalAppendCalls);
+    EXPECT_LT(other.reference.toInteger(), v.reference.toInteger());
+    Buffer buffer;
+    EXPECT_EQ(LOG_ENTRY_TYPE_OBJ, l.getEntry(other.reference, buffer));
+    EXPECT_EQ("other", TestUtil::toString(&buffer));
+    buffer.reset();
+    EXPECT_EQ(LOG_ENTRY_TYPE_OBJTOMB, l.getEntry(v.reference, buffer));
+    EXPECT_EQ("mine", TestUtil::toString(&buffer));
+}
+
+static void
+appendMany(Log* log, uint32_t id, uint32_t count)
+{
+    for (uint32_t i = 0; i < count; i++) {
+        Log::AppendVector v;
+        v.type = LOG_ENTRY_TYPE_OBJ;
+        uint32_t data[2] = { id, i };
+        v.buffer.append(data, sizeof32(data));
+        if (!log->append(&v, 1))
+            throw FatalError(HERE, "append failed");
+        Buffer buffer;
+        log->getEntry(v.reference, buffer);
+        if (memcmp(buffer.getRange(0, sizeof32(data)), data, sizeof(data)))
+            throw FatalError(HERE, "wrong data appended");
+    }
+}
+
+TEST_F(AbstractLogTest, append_multiple_concurrent) {
+    uint64_t callsBefore = l.AbstractLog::metrics.totalAppendCalls;
+    std::thread* threads[4];
+    for (uint32_t i = 0; i < 4; i++)
+        threads[i] = new std::thread(appendMany, &l, i, 2000);
+    for (uint32_t i = 0; i < 4; i++) {
+        threads[i]->join();
+        delete threads[i];
+    }
+    EXPECT_EQ(callsBefore + 8000, l.AbstractLog::metrics.totalAppendCalls);
+    EXPECT_TRUE(l.pendingAppends.load() == NULL);
+}
+
 TEST_F(AbstractLogTest, free) {
     // Currently nothing to do - it just passes through to SegmentManager
 }
@@ -464,7 +464,7 @@ StartReadingDataRpc::Result::Result()
     , logDigestBytes(0)
     , logDigestSegmentId(-1)
     , logDigestSegmentEpoch(-1)
-    , tabletMetricsLen(-1)
+    , tabletMetricsLen(0)
 {
 }
 
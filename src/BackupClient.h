@@ -135,10 +135,10 @@ class StartReadingDataRpc : public ServerIdRpcWrapper {
         std::unique_ptr<char[]> logDigestBuffer;
 
         /**
-         * A buffer containing the tabletMetrics gathered from the
-         * newest open segment replica found on this master, if one exists.
-         * These metrics may not be completely up-to-date as the metrics
-         * are updated only when a new log head is created.
+         * A buffer containing the table stats (a TableStats::Digest) gathered
+         * from the same replica as #logDigestBuffer, if they exist.
+         * These stats may not be completely up-to-date as they are
+         * written only when a new log head is created.
          */
         std::unique_ptr<char[]> tabletMetricsBuffer;
 
@@ -163,8 +163,8 @@ class StartReadingDataRpc : public ServerIdRpcWrapper {
         uint64_t logDigestSegmentEpoch;
 
         /**
-         * The number of bytes making up the TabletMetrics.
-         * This will be -1 if no metrics were found.
+         * The number of bytes making up #tabletMetricsBuffer.
+         * This will be 0 if no table stats were found.
          */
         uint32_t tabletMetricsLen;
 
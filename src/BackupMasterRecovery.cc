@@ -68,6 +68,7 @@ BackupMasterRecovery::BackupMasterRecovery(TaskQueue& taskQueue,
     , logDigest()
     , logDigestSegmentId(~0lu)
     , logDigestSegmentEpoch()
+    , tableStats()
     , startCompleted()
     , freeQueued()
     , recoveryTicks()
@@ -113,7 +114,7 @@ BackupMasterRecovery::start(const std::vector<BackupStorage::FrameRef>& frames,
     }
 
     recoveryTicks.construct(&metrics->backup.recoveryTicks);
-    metrics->backup.recoveryCount++;
+    ++metrics->backup.recoveryCount;
 
     LOG(DEBUG, "Backup preparing for recovery %lu of crashed server %s; "
                "loading replicas", recoveryId,
@@ -185,7 +186,7 @@ BackupMasterRecovery::start(const std::vector<BackupStorage::FrameRef>& frames,
             foundDigest =
                 RecoverySegmentBuilder::extractDigest(
                     replicaData, segmentSize,
-                    replica.metadata->certificate, &logDigest);
+                    replica.metadata->certificate, &logDigest, &tableStats);
         }
         if (foundDigest) {
             logDigestSegmentId = replica.metadata->segmentId;
@@ -470,13 +471,13 @@ BackupMasterRecovery::populateStartResponse(Buffer* responseBuffer,
             response->digestBytes);
     }
 
-    //TODO(cstlee) Pull tablet stats info out.
-    char tabletMetrics[] = "";
-    response->tabletMetricsLen = sizeof(tabletMetrics);
+    response->tabletMetricsLen = tableStats.getTotalLength();
     if (response->tabletMetricsLen > 0) {
         void* out = new(responseBuffer, APPEND)
                 char[response->tabletMetricsLen];
-        memcpy(out, tabletMetrics, response->tabletMetricsLen);
+        tableStats.copy(0, response->tabletMetricsLen, out);
+        LOG(DEBUG, "Sent %u bytes of table stats to coordinator",
+            response->tabletMetricsLen);
     }
 }
 
@@ -55,7 +55,9 @@ class BackupReplicaMetadata;
  * methods are not thread-safe unless stated otherwise. Assumptions this
  * class relies on:
  * 1) There is exactly one backup worker thread.
- * 2) Calls to performTask() are serialized.
+ * 2) Calls to performTask() are serialized. This holds even when the
+ *    TaskQueue has several workers, since TaskQueue never runs a task
+ *    on two threads at once.
  * 3) FrameRefs delivered to start() remain valid until destruction.
  *
  * Primary replicas are ONLY filtered by the task queue thread serially.
@@ -264,6 +266,13 @@ class BackupMasterRecovery : public Task {
      */
     uint64_t logDigestSegmentEpoch;
 
+    /**
+     * Caches the table stats digest (see TableStats::Digest) found in the
+     * same replica as #logDigest, if any. Returned to the coordinator,
+     * which uses it to balance the partitions of the crashed master.
+     */
+    Buffer tableStats;
+
     /**
      * Indicates whether start() should scan all the replicas to extract
      * information or whether the results are already cached.
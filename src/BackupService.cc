@@ -51,6 +51,7 @@ BackupService::BackupService(Context* context,
     , initCalled(false)
     , gcTracker(context, this)
     , gcThread()
+    , taskWorkersStarted(false)
     , testingDoNotStartGcThread(false)
     , testingSkipCallerIdCheck(false)
     , taskQueue()
@@ -124,6 +125,7 @@ BackupService::~BackupService()
     if (gcThread)
         gcThread->join();
     gcThread.destroy();
+    taskQueue.stopWorkers();
 
     // All frames will get free() called on them when there ref count drops
     // to zero as #frames is destroyed, but since free doesn't modify storage
@@ -674,9 +676,16 @@ BackupService::trackerChangesEnqueued()
     // processed before the first push to the server list from the coordinator.
     if (!initCalled)
         return;
-    if (!gcThread && !testingDoNotStartGcThread) {
-        LOG(NOTICE, "Starting backup replica garbage collector thread");
-        gcThread.construct(&BackupService::gcMain, this);
+    if (!gcThread && !taskWorkersStarted && !testingDoNotStartGcThread) {
+        if (config->backup.taskThreads > 1) {
+            LOG(NOTICE, "Starting %u backup task threads",
+                config->backup.taskThreads);
+            taskQueue.startWorkers(config->backup.taskThreads);
+            taskWorkersStarted = true;
+        } else {
+            LOG(NOTICE, "Starting backup replica garbage collector thread");
+            gcThread.construct(&BackupService::gcMain, this);
+        }
     }
     ServerDetails server;
     ServerChangeEvent event;
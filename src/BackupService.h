@@ -168,6 +168,10 @@ class BackupService : public Service
     /// Runs garbage collection tasks.
     Tub<std::thread> gcThread;
 
+    /// True once taskQueue's workers have been started; used instead of
+    /// gcThread when config->backup.taskThreads is more than 1.
+    bool taskWorkersStarted;
+
     /// For testing; don't start gcThread when tracker changes are enqueued.
     bool testingDoNotStartGcThread;
 
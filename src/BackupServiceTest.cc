@@ -767,4 +767,24 @@ TEST_F(BackupServiceTest, trackerChangesEnqueued) {
     EXPECT_EQ(0lu, backup->taskQueue.outstandingTasks());
 }
 
+TEST_F(BackupServiceTest, trackerChangesEnqueued_taskThreads) {
+    server->config.backup.taskThreads = 2;
+    backup->gcTracker.enqueueChange({{99, 0}, "", {}, 0, ServerStatus::UP},
+                                    SERVER_ADDED);
+    backup->gcTracker.enqueueChange({{99, 0}, "", {}, 0, ServerStatus::REMOVE},
+                                    SERVER_REMOVED);
+    backup->trackerChangesEnqueued();
+    EXPECT_FALSE(backup->gcThread);
+    EXPECT_TRUE(backup->taskWorkersStarted);
+    EXPECT_EQ(2lu, backup->taskQueue.workers.size());
+
+    // The workers run the garbage collection task on their own.
+    for (int i = 0; i < 1000; i++) {
+        if (backup->taskQueue.isIdle())
+            break;
+        usleep(1000);
+    }
+    EXPECT_EQ(0lu, backup->taskQueue.outstandingTasks());
+}
+
 } // namespace RAMCloud
@@ -21,8 +21,15 @@
 
 namespace RAMCloud {
 
+__thread Buffer::Allocation*
+Buffer::Allocation::cachedAllocations[CACHE_SIZE_CLASSES];
+__thread uint32_t
+Buffer::Allocation::cachedAllocationCounts[CACHE_SIZE_CLASSES];
+
 /**
- * Malloc and construct an Allocation.
+ * Malloc and construct an Allocation. If the calling thread has a cached
+ * Allocation of exactly the right size, it is reused instead of calling
+ * malloc.
  * \param[in] prependSize
  *      See constructor.
  * \param[in] totalSize
@@ -31,10 +38,58 @@ namespace RAMCloud {
 Buffer::Allocation*
 Buffer::Allocation::newAllocation(uint32_t prependSize, uint32_t totalSize) {
     totalSize = (totalSize + 7) & ~7U;
+    int sizeClass = cacheSizeClass(totalSize);
+    if (sizeClass >= 0 && cachedAllocations[sizeClass] != NULL) {
+        Allocation* a = cachedAllocations[sizeClass];
+        cachedAllocations[sizeClass] = a->next;
+        cachedAllocationCounts[sizeClass]--;
+        a->reset(prependSize, totalSize);
+        return a;
+    }
     void* a = Memory::xmalloc(HERE, sizeof(Allocation) + totalSize);
     return new(a) Allocation(prependSize, totalSize);
 }
 
+/**
+ * Release an Allocation previously returned by #newAllocation. Commonly
+ * sized Allocations are kept in a per-thread cache for future use; all
+ * others are returned to malloc.
+ * \param[in] allocation
+ *      The Allocation to release. Its contents must no longer be in use.
+ */
+void
+Buffer::Allocation::freeAllocation(Allocation* allocation) {
+    int sizeClass = cacheSizeClass(allocation->totalSize);
+    if (sizeClass >= 0 &&
+            cachedAllocationCounts[sizeClass] < CACHE_MAX_PER_CLASS) {
+        allocation->next = cachedAllocations[sizeClass];
+        cachedAllocations[sizeClass] = allocation;
+        cachedAllocationCounts[sizeClass]++;
+        return;
+    }
+    allocation->~Allocation();
+    free(allocation);
+}
+
+/**
+ * Compute the index into #cachedAllocations for Allocations of a given
+ * size.
+ * \param[in] totalSize
+ *      The number of bytes managed by the Allocation.
+ * \return
+ *      The size class, or -1 if Allocations of this size are not cached.
+ */
+int
+Buffer::Allocation::cacheSizeClass(uint32_t totalSize) {
+    if ((totalSize & (totalSize - 1)) != 0)
+        return -1;
+    for (int i = 0; i < CACHE_SIZE_CLASSES; i++) {
+        if (totalSize == (1U << (CACHE_MIN_SIZE_SHIFT + i)))
+            return i;
+    }
+    return -1;
+}
+
 /**
  * Constructor for Allocation.
  * The Allocation must be 8-byte aligned.
@@ -51,7 +106,8 @@ Buffer::Allocation::Allocation(uint32_t prependSize, uint32_t totalSize)
     : next(NULL),
       prependTop(prependSize),
       appendTop(prependSize),
-      chunkTop(totalSize) {
+      chunkTop(totalSize),
+      totalSize(totalSize) {
     assert((reinterpret_cast<uint64_t>(this) & 0x7) == 0);
     assert((totalSize & 0x7) == 0);
     assert(prependSize <= totalSize);
@@ -79,6 +135,7 @@ Buffer::Allocation::reset(uint32_t prependSize, uint32_t totalSize)
     prependTop = prependSize;
     appendTop = prependSize;
     chunkTop = totalSize;
+    this->totalSize = totalSize;
     assert((totalSize & 0x7) == 0);
     assert(prependSize <= totalSize);
 }
@@ -171,7 +228,7 @@ Buffer::reset() {
             while (current->next != NULL) {
                 Allocation* next;
                 next = current->next;
-                free(current);
+                Allocation::freeAllocation(current);
                 current = next;
             }
         }
@@ -164,6 +164,7 @@ class Buffer {
       public:
         static Allocation* newAllocation(uint32_t prependSize,
                                          uint32_t totalSize);
+        static void freeAllocation(Allocation* allocation);
         Allocation(uint32_t prependSize, uint32_t totalSize);
         ~Allocation();
 
@@ -173,12 +174,54 @@ class Buffer {
         void reset(uint32_t prependSize, uint32_t totalSize);
 
       PRIVATE:
+        static int cacheSizeClass(uint32_t totalSize);
+
+        enum {
+            /**
+             * Log base 2 of the smallest Allocation size (in bytes of
+             * #data) that is kept in the per-thread cache. Buffers start
+             * growing from twice INITIAL_ALLOCATION_SIZE, so this is the
+             * size of the first Allocation that a Buffer mallocs.
+             */
+            CACHE_MIN_SIZE_SHIFT = 12,
+
+            /**
+             * Number of power-of-two size classes kept in the per-thread
+             * cache, starting at 1 << CACHE_MIN_SIZE_SHIFT. Larger (or
+             * oddly-sized) Allocations always go straight to malloc/free.
+             */
+            CACHE_SIZE_CLASSES = 5,
+
+            /**
+             * Maximum number of free Allocations of any one size class that
+             * each thread will hold onto. This bounds the memory a thread
+             * can strand in its cache to a little under 2 MB.
+             */
+            CACHE_MAX_PER_CLASS = 16,
+        };
 
         /**
-         * Structure padding so that \a data is 8-byte aligned within an
-         * Allocation.
+         * Per-thread lists (linked through #next) of Allocations that were
+         * released by Buffers and can be handed out again without calling
+         * malloc. Indexed by cacheSizeClass(). Buffers on the RPC path
+         * routinely outgrow their initial allocation, so recycling these
+         * blocks keeps malloc and free off the fast path. Since the lists
+         * are thread-local, no synchronization is needed; an Allocation
+         * freed by a different thread than the one that allocated it simply
+         * migrates to the freeing thread's cache. Any Allocations still
+         * cached when a thread exits are leaked (threads are long-lived).
          */
-        char padding[4];
+        static __thread Allocation* cachedAllocations[CACHE_SIZE_CLASSES];
+
+        /// Number of Allocations in each list of #cachedAllocations.
+        static __thread uint32_t cachedAllocationCounts[CACHE_SIZE_CLASSES];
+
+        /**
+         * The number of bytes of #data this Allocation manages. This also
+         * serves as structure padding so that \a data is 8-byte aligned
+         * within an Allocation.
+         */
+        DataIndex totalSize;
 
         /**
          * The memory from which portions are returned by the allocate methods
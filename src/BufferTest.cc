@@ -91,6 +91,48 @@ TEST_F(BufferAllocationTest, reset) {
     EXPECT_EQ(256U, a->chunkTop);
 }
 
+TEST_F(BufferAllocationTest, newAllocation_reuseCached) {
+    Buffer::Allocation* b = Buffer::Allocation::newAllocation(512, 4096);
+    b->allocateAppend(100);
+    Buffer::Allocation::freeAllocation(b);
+    Buffer::Allocation* c = Buffer::Allocation::newAllocation(64, 4096);
+    EXPECT_EQ(b, c);
+    EXPECT_EQ(64U, c->prependTop);
+    EXPECT_EQ(64U, c->appendTop);
+    EXPECT_EQ(4096U, c->chunkTop);
+    EXPECT_EQ(4096U, c->totalSize);
+
+    // Different size classes don't share cached Allocations.
+    Buffer::Allocation::freeAllocation(c);
+    Buffer::Allocation* d = Buffer::Allocation::newAllocation(64, 8192);
+    EXPECT_NE(c, d);
+    Buffer::Allocation::freeAllocation(d);
+}
+
+TEST_F(BufferAllocationTest, freeAllocation) {
+    Buffer::Allocation* b[Buffer::Allocation::CACHE_MAX_PER_CLASS + 1];
+    foreach (Buffer::Allocation*& allocation, b)
+        allocation = Buffer::Allocation::newAllocation(0, 8192);
+    foreach (Buffer::Allocation* allocation, b)
+        Buffer::Allocation::freeAllocation(allocation);
+    EXPECT_EQ(uint32_t(Buffer::Allocation::CACHE_MAX_PER_CLASS),
+              Buffer::Allocation::cachedAllocationCounts[1]);
+
+    // Sizes outside of the cached classes go straight back to free.
+    Buffer::Allocation* e = Buffer::Allocation::newAllocation(0, 6000);
+    Buffer::Allocation::freeAllocation(e);
+    EXPECT_EQ(-1, Buffer::Allocation::cacheSizeClass(6000));
+}
+
+TEST_F(BufferAllocationTest, cacheSizeClass) {
+    EXPECT_EQ(-1, Buffer::Allocation::cacheSizeClass(2048));
+    EXPECT_EQ(0, Buffer::Allocation::cacheSizeClass(4096));
+    EXPECT_EQ(1, Buffer::Allocation::cacheSizeClass(8192));
+    EXPECT_EQ(4, Buffer::Allocation::cacheSizeClass(65536));
+    EXPECT_EQ(-1, Buffer::Allocation::cacheSizeClass(131072));
+    EXPECT_EQ(-1, Buffer::Allocation::cacheSizeClass(4104));
+}
+
 TEST_F(BufferAllocationTest, allocateChunk) {
     uint32_t size = 2048 - 256;
     a->allocateChunk(0);
@@ -22,6 +22,8 @@
 #include "CRamCloud.h"
 #include "ClientException.h"
 #include "Logger.h"
+#include "MultiRead.h"
+#include "MultiWrite.h"
 
 using namespace RAMCloud;
 
@@ -32,6 +34,56 @@ struct rc_client {
     RamCloud* client;
 };
 
+/**
+ * Holds the state of a multi-object operation started by rc_multiReadStart
+ * or rc_multiWriteStart until rc_multiOpFinish is called.
+ */
+struct rc_multiOp {
+    explicit rc_multiOp(uint32_t numObjects)
+        : numObjects(numObjects)
+        , readObjects(NULL)
+        , reads(numObjects)
+        , readRequests(numObjects)
+        , values(new Tub<Buffer>[numObjects])
+        , multiRead()
+        , writeObjects(NULL)
+        , writes(numObjects)
+        , writeRequests(numObjects)
+        , multiWrite()
+    {}
+
+    /// Number of entries in readObjects or writeObjects.
+    uint32_t numObjects;
+
+    /// For reads, the caller's descriptions of the objects; results are
+    /// copied back here by rc_multiOpFinish.  NULL for writes.
+    struct rc_multiReadObject* readObjects;
+
+    /// C++ versions of readObjects, passed to MultiRead.
+    std::vector<MultiReadObject> reads;
+    std::vector<MultiReadObject*> readRequests;
+
+    /// Holds the value of each object read until it can be copied
+    /// to the caller's buffer.
+    std::unique_ptr<Tub<Buffer>[]> values;
+
+    /// The underlying C++ operation, if this is a read.
+    Tub<MultiRead> multiRead;
+
+    /// For writes, the caller's descriptions of the objects; versions and
+    /// statuses are copied back here by rc_multiOpFinish.  NULL for reads.
+    struct rc_multiWriteObject* writeObjects;
+
+    /// C++ versions of writeObjects, passed to MultiWrite.
+    std::vector<MultiWriteObject> writes;
+    std::vector<MultiWriteObject*> writeRequests;
+
+    /// The underlying C++ operation, if this is a write.
+    Tub<MultiWrite> multiWrite;
+
+    DISALLOW_COPY_AND_ASSIGN(rc_multiOp);
+};
+
 /**
  * Create a new client connection to a RAMCloud cluster.
  *
@@ -251,6 +303,257 @@ rc_read(struct rc_client* client, uint64_t tableId,
     return STATUS_OK;
 }
 
+/**
+ * Read several objects at once; see RamCloud::multiRead.  This is
+ * equivalent to rc_multiReadStart followed by rc_multiOpFinish.
+ *
+ * \param client
+ *      Handle for the RAMCloud connection.
+ * \param objects
+ *      Describes the objects to read; the value, version, and status of
+ *      each object are returned in its entry.
+ * \param numObjects
+ *      Number of entries in \a objects.
+ *
+ * \return
+ *      STATUS_OK if the operation was carried out (individual objects
+ *      may still have failed: check the status in each entry), otherwise
+ *      the error that prevented the operation from completing.
+ */
+Status
+rc_multiRead(struct rc_client* client, struct rc_multiReadObject* objects,
+        uint32_t numObjects)
+{
+    struct rc_multiOp* op;
+    Status status = rc_multiReadStart(client, objects, numObjects, &op);
+    if (status != STATUS_OK)
+        return status;
+    return rc_multiOpFinish(op);
+}
+
+/**
+ * Start reading several objects without waiting for them to arrive.
+ * The caller can do other work (including starting other operations)
+ * and later call rc_multiOpFinish to wait for the results.
+ *
+ * \param client
+ *      Handle for the RAMCloud connection.
+ * \param objects
+ *      Describes the objects to read.  This array, along with the keys
+ *      and buffers it refers to, must remain valid until rc_multiOpFinish
+ *      returns.
+ * \param numObjects
+ *      Number of entries in \a objects.
+ * \param[out] op
+ *      If the return value is STATUS_OK, a handle for the operation is
+ *      returned here; it must eventually be passed to rc_multiOpFinish.
+ *
+ * \return
+ *      STATUS_OK or the error that prevented the operation from starting.
+ */
+Status
+rc_multiReadStart(struct rc_client* client,
+        struct rc_multiReadObject* objects, uint32_t numObjects,
+        struct rc_multiOp** op)
+{
+    struct rc_multiOp* newOp = new rc_multiOp(numObjects);
+    newOp->readObjects = objects;
+    for (uint32_t i = 0; i < numObjects; i++) {
+        newOp->reads[i] = MultiReadObject(objects[i].tableId, objects[i].key,
+                objects[i].keyLength, &newOp->values[i]);
+        newOp->readRequests[i] = &newOp->reads[i];
+    }
+    try {
+        newOp->multiRead.construct(client->client, newOp->readRequests.data(),
+                numObjects);
+    } catch (ClientException& e) {
+        delete newOp;
+        *op = NULL;
+        return e.status;
+    }
+    catch (std::exception& e) {
+        RAMCLOUD_LOG(ERROR, "An unhandled C++ Exception occurred: %s",
+                e.what());
+        delete newOp;
+        *op = NULL;
+        return STATUS_INTERNAL_ERROR;
+    } catch (...) {
+        RAMCLOUD_LOG(ERROR, "An unknown, unhandled C++ Exception occurred");
+        delete newOp;
+        *op = NULL;
+        return STATUS_INTERNAL_ERROR;
+    }
+
+    *op = newOp;
+    return STATUS_OK;
+}
+
+/**
+ * Write several objects at once; see RamCloud::multiWrite.  This is
+ * equivalent to rc_multiWriteStart followed by rc_multiOpFinish.
+ *
+ * \param client
+ *      Handle for the RAMCloud connection.
+ * \param objects
+ *      Describes the objects to write; the new version and status of
+ *      each object are returned in its entry.
+ * \param numObjects
+ *      Number of entries in \a objects.
+ *
+ * \return
+ *      STATUS_OK if the operation was carried out (individual objects
+ *      may still have failed: check the status in each entry), otherwise
+ *      the error that prevented the operation from completing.
+ */
+Status
+rc_multiWrite(struct rc_client* client, struct rc_multiWriteObject* objects,
+        uint32_t numObjects)
+{
+    struct rc_multiOp* op;
+    Status status = rc_multiWriteStart(client, objects, numObjects, &op);
+    if (status != STATUS_OK)
+        return status;
+    return rc_multiOpFinish(op);
+}
+
+/**
+ * Start writing several objects without waiting for the writes to
+ * complete; call rc_multiOpFinish later to wait for them.
+ *
+ * \param client
+ *      Handle for the RAMCloud connection.
+ * \param objects
+ *      Describes the objects to write.  This array, along with the keys
+ *      and values it refers to, must remain valid until rc_multiOpFinish
+ *      returns.
+ * \param numObjects
+ *      Number of entries in \a objects.
+ * \param[out] op
+ *      If the return value is STATUS_OK, a handle for the operation is
+ *      returned here; it must eventually be passed to rc_multiOpFinish.
+ *
+ * \return
+ *      STATUS_OK or the error that prevented the operation from starting.
+ */
+Status
+rc_multiWriteStart(struct rc_client* client,
+        struct rc_multiWriteObject* objects, uint32_t numObjects,
+        struct rc_multiOp** op)
+{
+    struct rc_multiOp* newOp = new rc_multiOp(numObjects);
+    newOp->writeObjects = objects;
+    for (uint32_t i = 0; i < numObjects; i++) {
+        newOp->writes[i] = MultiWriteObject(objects[i].tableId, objects[i].key,
+                objects[i].keyLength, objects[i].buf, objects[i].length,
+                objects[i].rejectRules);
+        newOp->writeRequests[i] = &newOp->writes[i];
+    }
+    try {
+        newOp->multiWrite.construct(client->client,
+                newOp->writeRequests.data(), numObjects);
+    } catch (ClientException& e) {
+        delete newOp;
+        *op = NULL;
+        return e.status;
+    }
+    catch (std::exception& e) {
+        RAMCLOUD_LOG(ERROR, "An unhandled C++ Exception occurred: %s",
+                e.what());
+        delete newOp;
+        *op = NULL;
+        return STATUS_INTERNAL_ERROR;
+    } catch (...) {
+        RAMCLOUD_LOG(ERROR, "An unknown, unhandled C++ Exception occurred");
+        delete newOp;
+        *op = NULL;
+        return STATUS_INTERNAL_ERROR;
+    }
+
+    *op = newOp;
+    return STATUS_OK;
+}
+
+/**
+ * Make progress on an operation started by rc_multiReadStart or
+ * rc_multiWriteStart without blocking.
+ *
+ * \param op
+ *      Handle returned by rc_multiReadStart or rc_multiWriteStart.
+ *
+ * \return
+ *      Nonzero means the operation has completed, so rc_multiOpFinish
+ *      will return immediately.
+ */
+int
+rc_multiOpIsReady(struct rc_multiOp* op)
+{
+    try {
+        if (op->multiRead)
+            return op->multiRead->isReady();
+        return op->multiWrite->isReady();
+    } catch (...) {
+        // rc_multiOpFinish will report the error.
+        return 1;
+    }
+}
+
+/**
+ * Wait for an operation started by rc_multiReadStart or rc_multiWriteStart
+ * to complete, fill in the results in the caller's array of objects, and
+ * free the handle.
+ *
+ * \param op
+ *      Handle returned by rc_multiReadStart or rc_multiWriteStart.  This
+ *      is freed by this function, so it should not be used again after
+ *      the function returns.
+ *
+ * \return
+ *      STATUS_OK if the operation was carried out (individual objects
+ *      may still have failed: check the status in each entry), otherwise
+ *      the error that prevented the operation from completing.
+ */
+Status
+rc_multiOpFinish(struct rc_multiOp* op)
+{
+    Status status = STATUS_OK;
+    try {
+        if (op->multiRead) {
+            op->multiRead->wait();
+            for (uint32_t i = 0; i < op->numObjects; i++) {
+                struct rc_multiReadObject* object = &op->readObjects[i];
+                Tub<Buffer>& value = op->values[i];
+                object->status = op->reads[i].status;
+                object->version = op->reads[i].version;
+                object->actualLength = 0;
+                if (value) {
+                    object->actualLength = value->getTotalLength();
+                    value->copy(0, std::min(object->actualLength,
+                            object->maxLength), object->buf);
+                }
+            }
+        } else {
+            op->multiWrite->wait();
+            for (uint32_t i = 0; i < op->numObjects; i++) {
+                op->writeObjects[i].status = op->writes[i].status;
+                op->writeObjects[i].version = op->writes[i].version;
+            }
+        }
+    } catch (ClientException& e) {
+        status = e.status;
+    }
+    catch (std::exception& e) {
+        RAMCLOUD_LOG(ERROR, "An unhandled C++ Exception occurred: %s",
+                e.what());
+        status = STATUS_INTERNAL_ERROR;
+    } catch (...) {
+        RAMCLOUD_LOG(ERROR, "An unknown, unhandled C++ Exception occurred");
+        status = STATUS_INTERNAL_ERROR;
+    }
+
+    delete op;
+    return status;
+}
+
 Status
 rc_remove(struct rc_client* client, uint64_t tableId,
           const void* key, uint16_t keyLength,
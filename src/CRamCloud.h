@@ -33,6 +33,44 @@ struct RamCloud;
 struct rc_client;
 #endif
 
+struct rc_multiOp;
+
+/**
+ * Describes one object to be fetched by rc_multiRead or rc_multiReadStart.
+ * The caller fills in the first five fields; the remaining fields are
+ * filled in when the operation completes.  The object's value is copied
+ * directly into buf, so callers can point buf at memory they already own
+ * (e.g. a Java direct buffer or a Python bytearray) and avoid any further
+ * copies.
+ */
+struct rc_multiReadObject {
+    uint64_t tableId;           // Table containing the object.
+    const void* key;            // Key of the object (not null-terminated).
+    uint16_t keyLength;         // Size in bytes of key.
+    void* buf;                  // The object's value is copied here.
+    uint32_t maxLength;         // Bytes of space available at buf.
+    uint32_t actualLength;      // [out] Total size of the object; may be
+                                // larger than maxLength.
+    uint64_t version;           // [out] Version of the object.
+    Status status;              // [out] Outcome of the read for this object.
+};
+
+/**
+ * Describes one object to be written by rc_multiWrite or
+ * rc_multiWriteStart.  The value is sent straight from buf without
+ * being copied.
+ */
+struct rc_multiWriteObject {
+    uint64_t tableId;           // Table in which to write the object.
+    const void* key;            // Key of the object (not null-terminated).
+    uint16_t keyLength;         // Size in bytes of key.
+    const void* buf;            // New contents of the object.
+    uint32_t length;            // Size in bytes of buf.
+    const struct RejectRules* rejectRules;  // May be NULL.
+    uint64_t version;           // [out] Version of the new object.
+    Status status;              // [out] Outcome of the write for this object.
+};
+
 Status    rc_connect(const char* serverLocator,
                             struct rc_client** newClient);
 Status    rc_connectWithClient(
@@ -53,6 +91,22 @@ Status    rc_read(struct rc_client* client, uint64_t tableId,
                             const struct RejectRules* rejectRules,
                             uint64_t* version, void* buf, uint32_t maxLength,
                             uint32_t* actualLength);
+Status    rc_multiRead(struct rc_client* client,
+                             struct rc_multiReadObject* objects,
+                             uint32_t numObjects);
+Status    rc_multiReadStart(struct rc_client* client,
+                             struct rc_multiReadObject* objects,
+                             uint32_t numObjects,
+                             struct rc_multiOp** op);
+Status    rc_multiWrite(struct rc_client* client,
+                             struct rc_multiWriteObject* objects,
+                             uint32_t numObjects);
+Status    rc_multiWriteStart(struct rc_client* client,
+                             struct rc_multiWriteObject* objects,
+                             uint32_t numObjects,
+                             struct rc_multiOp** op);
+int       rc_multiOpIsReady(struct rc_multiOp* op);
+Status    rc_multiOpFinish(struct rc_multiOp* op);
 Status    rc_remove(struct rc_client* client, uint64_t tableId,
                               const void* key, uint16_t keyLength,
                               const struct RejectRules* rejectRules,
@@ -0,0 +1,357 @@
+/* Copyright (c) 2013 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <queue>
+
+#include "CleanerCandidateIndex.h"
+#include "Cycles.h"
+#include "ShortMacros.h"
+#include "WallTime.h"
+
+namespace RAMCloud {
+
+/**
+ * Construct an empty index.
+ *
+ * \param segletSize
+ *      Size of each seglet in bytes.
+ * \param segmentSize
+ *      Size of each full segment in bytes.
+ * \param maxCleanableMemoryUtilization
+ *      Compaction may not leave a segment's memory more than this percent
+ *      full. Used to compute how many seglets compacting a segment may free,
+ *      and segments whose memory is fuller than this are never chosen for
+ *      disk cleaning.
+ */
+CleanerCandidateIndex::CleanerCandidateIndex(
+        uint32_t segletSize,
+        uint32_t segmentSize,
+        uint32_t maxCleanableMemoryUtilization)
+    : lock("CleanerCandidateIndex::lock"),
+      segletSize(segletSize),
+      segmentSize(segmentSize),
+      maxCleanableMemoryUtilization(maxCleanableMemoryUtilization),
+      all(),
+      byFreeableSeglets(segmentSize / segletSize + 1),
+      byUtilization(101),
+      totalRefiles(0),
+      refileTicks(0),
+      totalCandidatesExamined(0)
+{
+}
+
+/**
+ * Destroy the index. Segments still in it are told that they're no longer
+ * candidates, so that freeing their entries doesn't refer to the index.
+ */
+CleanerCandidateIndex::~CleanerCandidateIndex()
+{
+    Lock guard(lock);
+    foreach (LogSegment* segment, all)
+        segment->candidateIndex = NULL;
+}
+
+/**
+ * Add newly cleanable segments to the index.
+ *
+ * \param segments
+ *      The segments to add. None of them may already be a candidate.
+ */
+void
+CleanerCandidateIndex::add(LogSegmentVector& segments)
+{
+    Lock guard(lock);
+    foreach (LogSegment* segment, segments)
+        insert(segment);
+}
+
+/**
+ * Return the number of candidates in the index.
+ */
+size_t
+CleanerCandidateIndex::size()
+{
+    Lock guard(lock);
+    return all.size();
+}
+
+/**
+ * Choose the best segment to compact in memory and remove it from the index.
+ * This is the segment that compaction would free the most seglets from. If no
+ * segment has any freeable seglets, the segment with the most tombstones that
+ * hasn't been compacted in a while is chosen instead (see
+ * LogCleaner::getSegmentToCompact for why).
+ *
+ * \param[out] outFreeableSeglets
+ *      The number of seglets that may safely be freed by compacting the
+ *      chosen segment (0 if it was chosen for its tombstones).
+ * \return
+ *      The chosen segment, or NULL if there are no candidates worth
+ *      compacting.
+ */
+LogSegment*
+CleanerCandidateIndex::removeSegmentToCompact(uint32_t* outFreeableSeglets)
+{
+    Lock guard(lock);
+
+    for (size_t seglets = byFreeableSeglets.size() - 1; seglets > 0; seglets--) {
+        SegmentSet& bucket = byFreeableSeglets[seglets];
+        if (bucket.empty())
+            continue;
+        LogSegment* best = *bucket.begin();
+        totalCandidatesExamined++;
+        erase(best);
+        *outFreeableSeglets = downCast<uint32_t>(seglets);
+        return best;
+    }
+
+    LogSegment* best = NULL;
+    __uint128_t bestGoodness = 0;
+    uint64_t now = WallTime::secondsTimestamp();
+    foreach (LogSegment* candidate, all) {
+        uint32_t tombstoneCount =
+            candidate->getEntryCount(LOG_ENTRY_TYPE_OBJTOMB);
+        uint64_t timeSinceLastCompaction =
+            now - candidate->lastCompactionTimestamp;
+        __uint128_t goodness =
+            (__uint128_t)tombstoneCount * timeSinceLastCompaction;
+        if (goodness > bestGoodness) {
+            best = candidate;
+            bestGoodness = goodness;
+        }
+    }
+    totalCandidatesExamined += all.size();
+
+    if (best != NULL)
+        erase(best);
+    *outFreeableSeglets = 0;
+    return best;
+}
+
+/**
+ * Choose the best segments to clean on disk, in decreasing order of their
+ * cost-benefit scores, and remove them from the index. Segments whose memory
+ * is more than maxCleanableMemoryUtilization percent full are skipped.
+ *
+ * \param maximumLiveBytes
+ *      Segments are chosen until adding the next one would bring the total
+ *      number of live bytes in the chosen segments above this.
+ * \param[out] outSegments
+ *      The chosen segments are appended to this vector, best first.
+ * \param utilizationHistogram
+ *      If non-NULL, the disk utilization of every candidate (including the
+ *      chosen ones) is added to this histogram.
+ */
+void
+CleanerCandidateIndex::removeSegmentsToClean(uint64_t maximumLiveBytes,
+                                             LogSegmentVector& outSegments,
+                                             Histogram* utilizationHistogram)
+{
+    Lock guard(lock);
+
+    if (utilizationHistogram != NULL) {
+        for (uint32_t i = 0; i < byUtilization.size(); i++)
+            utilizationHistogram->storeSample(i, byUtilization[i].size());
+    }
+
+    // Merge the buckets by cost-benefit. The heap holds the score of the
+    // front segment of each bucket that has yet to be looked at.
+    uint64_t now = WallTime::secondsTimestamp();
+    typedef std::pair<uint64_t, uint32_t> ScoreAndBucket;
+    std::priority_queue<ScoreAndBucket> heads;
+    vector<SegmentSet::iterator> cursors(byUtilization.size());
+    for (uint32_t i = 0; i < byUtilization.size(); i++) {
+        cursors[i] = byUtilization[i].begin();
+        if (cursors[i] != byUtilization[i].end())
+            heads.push(ScoreAndBucket(costBenefit(i, *cursors[i], now), i));
+    }
+
+    uint64_t totalLiveBytes = 0;
+    size_t firstChosen = outSegments.size();
+    while (!heads.empty()) {
+        uint32_t utilization = heads.top().second;
+        heads.pop();
+        LogSegment* candidate = *cursors[utilization];
+        totalCandidatesExamined++;
+        if (++cursors[utilization] != byUtilization[utilization].end()) {
+            heads.push(ScoreAndBucket(
+                costBenefit(utilization, *cursors[utilization], now),
+                utilization));
+        }
+
+        int memoryUtilization = candidate->getMemoryUtilization();
+        if (memoryUtilization > static_cast<int>(maxCleanableMemoryUtilization))
+            continue;
+
+        uint64_t liveBytes = candidate->liveBytes;
+        if ((totalLiveBytes + liveBytes) > maximumLiveBytes)
+            break;
+
+        totalLiveBytes += liveBytes;
+        outSegments.push_back(candidate);
+    }
+
+    for (size_t i = firstChosen; i < outSegments.size(); i++)
+        erase(outSegments[i]);
+}
+
+/**
+ * Add the index's metrics to the given cleaner metrics.
+ */
+void
+CleanerCandidateIndex::getMetrics(ProtoBuf::LogMetrics_CleanerMetrics& m)
+{
+    m.set_total_candidate_refiles(totalRefiles);
+    m.set_candidate_refile_ticks(refileTicks);
+    m.set_total_candidates_examined(totalCandidatesExamined);
+}
+
+/**
+ * Called whenever the number of live bytes in a segment drops (see
+ * AbstractLog::free). If the segment is a cleaning candidate and no longer
+ * belongs in the buckets it's filed under, it is moved. This is cheap and
+ * doesn't lock anything unless the segment needs to be moved, which only
+ * happens after about one percent of the segment has been freed.
+ *
+ * \param segment
+ *      The segment whose live bytes changed.
+ */
+void
+CleanerCandidateIndex::liveBytesChanged(LogSegment* segment)
+{
+    CleanerCandidateIndex* index = segment->candidateIndex;
+    if (expect_true(index == NULL))
+        return;
+
+    // These reads race with the cleaner refiling or removing the segment;
+    // refile() checks again with the lock held.
+    if (index->getUtilization(segment) == segment->indexedUtilization &&
+            index->getFreeableSeglets(segment) ==
+            segment->indexedFreeableSeglets) {
+        return;
+    }
+    index->refile(segment);
+}
+
+/******************************************************************************
+ * PRIVATE METHODS
+ ******************************************************************************/
+
+/**
+ * Calculate the cost-benefit ratio (benefit/cost) for cleaning a segment on
+ * disk. Higher values indicate better candidates.
+ *
+ * \param utilization
+ *      The segment's disk utilization (the bucket it is filed under).
+ * \param segment
+ *      The segment to score.
+ * \param now
+ *      The current WallTime, in seconds.
+ */
+uint64_t
+CleanerCandidateIndex::costBenefit(uint32_t utilization,
+                                   LogSegment* segment,
+                                   uint64_t now)
+{
+    // If utilization is 0, cost-benefit is infinity.
+    if (utilization == 0)
+        return -1UL;
+
+    // This generally shouldn't happen, but is possible due to:
+    //  1) Unsynchronized TSCs across cores (WallTime uses rdtsc).
+    //  2) Unsynchronized clocks and "newer" recovered data in the log.
+    uint64_t timestamp = segment->creationTimestamp;
+    if (timestamp > now) {
+        LOG(WARNING, "timestamp > now");
+        timestamp = now;
+    }
+
+    uint64_t age = now - timestamp;
+    return ((100 - utilization) * age) / utilization;
+}
+
+/**
+ * Return the number of seglets that compacting a segment may free without
+ * leaving it more than maxCleanableMemoryUtilization percent full. Keeping
+ * under that limit ensures that the compacted segment can always be cleaned
+ * on disk later.
+ */
+uint32_t
+CleanerCandidateIndex::getFreeableSeglets(LogSegment* segment)
+{
+    uint32_t liveBytes = segment->liveBytes;
+    uint32_t segletsNeeded = (100 * (liveBytes + segletSize - 1)) /
+                             segletSize / maxCleanableMemoryUtilization;
+    uint32_t segletsAllocated = segment->getSegletsAllocated();
+    if (segletsNeeded >= segletsAllocated)
+        return 0;
+    return std::min(segletsAllocated - segletsNeeded,
+                    downCast<uint32_t>(byFreeableSeglets.size() - 1));
+}
+
+/**
+ * Return a segment's disk utilization: the percentage of a full segment that
+ * its live data takes up.
+ */
+uint32_t
+CleanerCandidateIndex::getUtilization(LogSegment* segment)
+{
+    return std::min(100U, downCast<uint32_t>(
+        (static_cast<uint64_t>(segment->liveBytes) * 100) / segmentSize));
+}
+
+/**
+ * File a segment under its current keys. The caller must hold the lock.
+ */
+void
+CleanerCandidateIndex::insert(LogSegment* segment)
+{
+    segment->indexedUtilization = getUtilization(segment);
+    segment->indexedFreeableSeglets = getFreeableSeglets(segment);
+    all.insert(segment);
+    byUtilization[segment->indexedUtilization].insert(segment);
+    byFreeableSeglets[segment->indexedFreeableSeglets].insert(segment);
+    segment->candidateIndex = this;
+}
+
+/**
+ * Remove a segment from the index. The caller must hold the lock.
+ */
+void
+CleanerCandidateIndex::erase(LogSegment* segment)
+{
+    all.erase(segment);
+    byUtilization[segment->indexedUtilization].erase(segment);
+    byFreeableSeglets[segment->indexedFreeableSeglets].erase(segment);
+    segment->candidateIndex = NULL;
+}
+
+/**
+ * Move a segment to the buckets that match its current live bytes, if it's
+ * still in the index.
+ */
+void
+CleanerCandidateIndex::refile(LogSegment* segment)
+{
+    CycleCounter<LogCleanerMetrics::Metric64BitType> _(&refileTicks);
+    Lock guard(lock);
+    if (segment->candidateIndex != this)
+        return;
+    erase(segment);
+    insert(segment);
+    totalRefiles++;
+}
+
+} // namespace
@@ -0,0 +1,133 @@
+/* Copyright (c) 2013 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef RAMCLOUD_CLEANERCANDIDATEINDEX_H
+#define RAMCLOUD_CLEANERCANDIDATEINDEX_H
+
+#include <set>
+
+#include "Common.h"
+#include "LogCleanerMetrics.h"
+#include "LogSegment.h"
+#include "SpinLock.h"
+
+namespace RAMCloud {
+
+/**
+ * The set of closed log segments that the LogCleaner may choose to clean,
+ * indexed so that the best ones can be found without looking at all of them.
+ * A large master may have hundreds of thousands of candidates, and scanning
+ * or sorting all of them every time the cleaner runs can cost more than the
+ * cleaning itself.
+ *
+ * Each candidate is filed under two keys: the number of seglets that compacting
+ * it would free (used to choose segments to compact in memory) and its disk
+ * utilization (used to choose segments to clean on disk). The keys only change
+ * when the segment's live bytes do, so the index is kept up to date by having
+ * AbstractLog::free() call liveBytesChanged(). Since the keys are coarse, most
+ * calls just notice that nothing changed and return without locking.
+ *
+ * Within each disk utilization bucket segments are ordered by age. Every
+ * segment in a bucket has the same utilization in the cost-benefit formula, so
+ * the oldest has the best score, and the best segments overall can be found
+ * by merging the fronts of the buckets.
+ *
+ * This class is thread-safe.
+ */
+class CleanerCandidateIndex {
+  public:
+    CleanerCandidateIndex(uint32_t segletSize,
+                          uint32_t segmentSize,
+                          uint32_t maxCleanableMemoryUtilization);
+    ~CleanerCandidateIndex();
+    void add(LogSegmentVector& segments);
+    size_t size();
+    LogSegment* removeSegmentToCompact(uint32_t* outFreeableSeglets);
+    void removeSegmentsToClean(uint64_t maximumLiveBytes,
+                               LogSegmentVector& outSegments,
+                               Histogram* utilizationHistogram);
+    void getMetrics(ProtoBuf::LogMetrics_CleanerMetrics& m);
+
+    static void liveBytesChanged(LogSegment* segment);
+
+  PRIVATE:
+    typedef std::lock_guard<SpinLock> Lock;
+
+    /**
+     * Orders segments from oldest to youngest. The segment identifier breaks
+     * ties so that no two candidates compare equal.
+     */
+    struct OlderFirst {
+        bool
+        operator()(const LogSegment* a, const LogSegment* b) const
+        {
+            if (a->creationTimestamp != b->creationTimestamp)
+                return a->creationTimestamp < b->creationTimestamp;
+            return a->id < b->id;
+        }
+    };
+    typedef std::set<LogSegment*, OlderFirst> SegmentSet;
+
+    static uint64_t costBenefit(uint32_t utilization,
+                                LogSegment* segment,
+                                uint64_t now);
+    uint32_t getFreeableSeglets(LogSegment* segment);
+    uint32_t getUtilization(LogSegment* segment);
+    void insert(LogSegment* segment);
+    void erase(LogSegment* segment);
+    void refile(LogSegment* segment);
+
+    /// Serializes all access to the members below.
+    SpinLock lock;
+
+    /// Size of each seglet in bytes.
+    const uint32_t segletSize;
+
+    /// Size of each full segment in bytes.
+    const uint32_t segmentSize;
+
+    /// Compaction may not leave a segment's memory more than this percent
+    /// full (see LogCleaner::MAX_CLEANABLE_MEMORY_UTILIZATION).
+    const uint32_t maxCleanableMemoryUtilization;
+
+    /// All candidates. Only used when no candidate has freeable seglets and
+    /// the cleaner falls back to looking for tombstones to compact away.
+    SegmentSet all;
+
+    /// Candidates, bucketed by how many seglets compacting them would free.
+    /// The vector is indexed by that count.
+    vector<SegmentSet> byFreeableSeglets;
+
+    /// Candidates, bucketed by their disk utilization. The vector is indexed
+    /// by utilization percentage (0 through 100).
+    vector<SegmentSet> byUtilization;
+
+    /// Number of times a candidate moved to a different bucket because its
+    /// live bytes changed.
+    LogCleanerMetrics::Metric64BitType totalRefiles;
+
+    /// Total number of cpu cycles spent moving candidates between buckets.
+    LogCleanerMetrics::Metric64BitType refileTicks;
+
+    /// Total number of candidates examined while choosing segments to clean
+    /// or compact.
+    LogCleanerMetrics::Metric64BitType totalCandidatesExamined;
+
+    DISALLOW_COPY_AND_ASSIGN(CleanerCandidateIndex);
+};
+
+} // namespace
+
+#endif // !RAMCLOUD_CLEANERCANDIDATEINDEX_H
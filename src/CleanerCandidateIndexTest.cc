@@ -0,0 +1,211 @@
+/* Copyright (c) 2013 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "TestUtil.h"
+
+#include "CleanerCandidateIndex.h"
+#include "SegletAllocator.h"
+#include "ServerConfig.h"
+
+namespace RAMCloud {
+
+/**
+ * Unit tests for CleanerCandidateIndex.
+ */
+class CleanerCandidateIndexTest : public ::testing::Test {
+  public:
+    ServerConfig serverConfig;
+    Tub<SegletAllocator> allocator;
+    Tub<CleanerCandidateIndex> index;
+    LogSegmentVector segments;
+
+    CleanerCandidateIndexTest()
+        : serverConfig(ServerConfig::forTesting()),
+          allocator(),
+          index(),
+          segments()
+    {
+        serverConfig.segletSize = 16 * 1024;
+        allocator.construct(&serverConfig);
+        index.construct(serverConfig.segletSize, serverConfig.segmentSize, 98);
+        WallTime::mockWallTimeValue = 1000;
+    }
+
+    ~CleanerCandidateIndexTest()
+    {
+        index.destroy();
+        foreach (LogSegment* segment, segments)
+            delete segment;
+        WallTime::mockWallTimeValue = 0;
+    }
+
+    /**
+     * Create a closed segment with the given number of live bytes that was
+     * created the given number of seconds ago.
+     */
+    LogSegment*
+    newSegment(uint32_t liveBytes, uint32_t age, uint32_t seglets = 8)
+    {
+        vector<Seglet*> allocated;
+        EXPECT_TRUE(allocator->alloc(SegletAllocator::DEFAULT, seglets,
+                                     allocated));
+        LogSegment* segment = new LogSegment(allocated,
+                                             serverConfig.segletSize,
+                                             serverConfig.segmentSize,
+                                             segments.size() + 1,
+                                             downCast<SegmentSlot>(
+                                                segments.size()),
+                                             1000 - age,
+                                             false);
+        segment->liveBytes = liveBytes;
+        segments.push_back(segment);
+        return segment;
+    }
+
+    void
+    add(LogSegment* segment)
+    {
+        LogSegmentVector newCandidates;
+        newCandidates.push_back(segment);
+        index->add(newCandidates);
+    }
+
+  private:
+    DISALLOW_COPY_AND_ASSIGN(CleanerCandidateIndexTest);
+};
+
+TEST_F(CleanerCandidateIndexTest, add) {
+    LogSegment* a = newSegment(64 * 1024, 10);
+    LogSegment* b = newSegment(32 * 1024, 10);
+    index->add(segments);
+
+    EXPECT_EQ(2U, index->size());
+    EXPECT_EQ(index.get(), a->candidateIndex);
+    EXPECT_EQ(50U, a->indexedUtilization);
+    EXPECT_EQ(3U, a->indexedFreeableSeglets);
+    EXPECT_EQ(25U, b->indexedUtilization);
+    EXPECT_EQ(5U, b->indexedFreeableSeglets);
+}
+
+TEST_F(CleanerCandidateIndexTest, removeSegmentToCompact) {
+    LogSegment* half = newSegment(64 * 1024, 10);
+    LogSegment* empty = newSegment(0, 5);
+    LogSegment* olderEmpty = newSegment(0, 10);
+    index->add(segments);
+
+    uint32_t freeableSeglets;
+    EXPECT_EQ(olderEmpty, index->removeSegmentToCompact(&freeableSeglets));
+    EXPECT_EQ(7U, freeableSeglets);
+    EXPECT_EQ(empty, index->removeSegmentToCompact(&freeableSeglets));
+    EXPECT_EQ(7U, freeableSeglets);
+    EXPECT_EQ(half, index->removeSegmentToCompact(&freeableSeglets));
+    EXPECT_EQ(3U, freeableSeglets);
+    EXPECT_TRUE(half->candidateIndex == NULL);
+    EXPECT_EQ(0U, index->size());
+    EXPECT_TRUE(index->removeSegmentToCompact(&freeableSeglets) == NULL);
+}
+
+TEST_F(CleanerCandidateIndexTest, removeSegmentToCompact_tombstones) {
+    WallTime::mockWallTimeValue = 990;
+    LogSegment* noTombstones = newSegment(120 * 1024, 10);
+    LogSegment* fewTombstones = newSegment(120 * 1024, 10);
+    LogSegment* manyTombstones = newSegment(120 * 1024, 10);
+    fewTombstones->entryCounts[LOG_ENTRY_TYPE_OBJTOMB] = 5;
+    manyTombstones->entryCounts[LOG_ENTRY_TYPE_OBJTOMB] = 10;
+    WallTime::mockWallTimeValue = 1000;
+    index->add(segments);
+
+    uint32_t freeableSeglets = 1;
+    EXPECT_EQ(manyTombstones, index->removeSegmentToCompact(&freeableSeglets));
+    EXPECT_EQ(0U, freeableSeglets);
+    EXPECT_EQ(fewTombstones, index->removeSegmentToCompact(&freeableSeglets));
+    EXPECT_TRUE(index->removeSegmentToCompact(&freeableSeglets) == NULL);
+    EXPECT_EQ(1U, index->size());
+    EXPECT_EQ(index.get(), noTombstones->candidateIndex);
+}
+
+TEST_F(CleanerCandidateIndexTest, removeSegmentsToClean) {
+    // Cost-benefit is (100 - u) * age / u.
+    LogSegment* ten = newSegment(13108, 10);            // 90
+    LogSegment* fifty = newSegment(64 * 1024, 100);     // 100
+    LogSegment* quarter = newSegment(32 * 1024, 100);   // 300
+    LogSegment* empty = newSegment(0, 1);               // infinite
+    LogSegment* fullMemory = newSegment(32 * 1024, 900, 2);
+    index->add(segments);
+
+    LogSegmentVector chosen;
+    Histogram histogram(101, 1);
+    index->removeSegmentsToClean(1024 * 1024, chosen, &histogram);
+    ASSERT_EQ(4U, chosen.size());
+    EXPECT_EQ(empty, chosen[0]);
+    EXPECT_EQ(quarter, chosen[1]);
+    EXPECT_EQ(fifty, chosen[2]);
+    EXPECT_EQ(ten, chosen[3]);
+    EXPECT_TRUE(ten->candidateIndex == NULL);
+
+    EXPECT_EQ(1U, index->size());
+    EXPECT_EQ(index.get(), fullMemory->candidateIndex);
+    EXPECT_EQ(1U, histogram.buckets[0]);
+    EXPECT_EQ(1U, histogram.buckets[10]);
+    EXPECT_EQ(2U, histogram.buckets[25]);
+    EXPECT_EQ(1U, histogram.buckets[50]);
+}
+
+TEST_F(CleanerCandidateIndexTest, removeSegmentsToClean_maximumLiveBytes) {
+    LogSegment* quarter = newSegment(32 * 1024, 100);
+    newSegment(64 * 1024, 100);
+    newSegment(13108, 10);
+    index->add(segments);
+
+    LogSegmentVector chosen;
+    index->removeSegmentsToClean(96 * 1024 - 1, chosen, NULL);
+    ASSERT_EQ(1U, chosen.size());
+    EXPECT_EQ(quarter, chosen[0]);
+    EXPECT_EQ(2U, index->size());
+}
+
+TEST_F(CleanerCandidateIndexTest, liveBytesChanged) {
+    LogSegment* segment = newSegment(64 * 1024 + 1000, 10);
+
+    // Not a candidate: nothing happens.
+    CleanerCandidateIndex::liveBytesChanged(segment);
+    EXPECT_EQ(0U, index->totalRefiles);
+
+    add(segment);
+    segment->liveBytes -= 100;
+    CleanerCandidateIndex::liveBytesChanged(segment);
+    EXPECT_EQ(0U, index->totalRefiles);
+
+    segment->liveBytes = 32 * 1024;
+    CleanerCandidateIndex::liveBytesChanged(segment);
+    EXPECT_EQ(1U, index->totalRefiles);
+    EXPECT_EQ(25U, segment->indexedUtilization);
+    EXPECT_EQ(5U, segment->indexedFreeableSeglets);
+    EXPECT_EQ(1U, index->byUtilization[25].size());
+    EXPECT_EQ(0U, index->byUtilization[50].size());
+    EXPECT_EQ(1U, index->byFreeableSeglets[5].size());
+    EXPECT_EQ(0U, index->byFreeableSeglets[3].size());
+    EXPECT_EQ(1U, index->size());
+}
+
+TEST_F(CleanerCandidateIndexTest, destructor) {
+    LogSegment* segment = newSegment(64 * 1024, 10);
+    add(segment);
+    index.destroy();
+    EXPECT_TRUE(segment->candidateIndex == NULL);
+    CleanerCandidateIndex::liveBytesChanged(segment);
+}
+
+}  // namespace RAMCloud
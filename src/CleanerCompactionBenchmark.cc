@@ -55,6 +55,8 @@ class CleanerCompactionBenchmark {
         config.services = {};
         config.master.numReplicas = 0;
         config.master.disableLogCleaner = true;
+        config.master.disableInMemoryCleaning = false;
+        config.master.cleanerWriteCostThreshold = 4;
         config.segmentSize = Segment::DEFAULT_SEGMENT_SIZE;
         config.segletSize = Seglet::DEFAULT_SEGLET_SIZE;
         objectManager = new ObjectManager(&context,
@@ -112,8 +114,9 @@ class CleanerCompactionBenchmark {
         /*
          * Now compact each segment.
          */
-        objectManager->segmentManager.cleanableSegments(
-            objectManager->log.cleaner->candidates);
+        LogSegmentVector candidates;
+        objectManager->segmentManager.cleanableSegments(candidates);
+        objectManager->log.cleaner->candidates.add(candidates);
         uint64_t before = Cycles::rdtsc();
         for (uint32_t i = 0; i < numSegments; i++)
             objectManager->log.cleaner->doMemoryCleaning();
@@ -0,0 +1,365 @@
+/* Copyright (c) 2013 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <sstream>
+
+#include "CleanerScheduler.h"
+#include "Cycles.h"
+#include "ShortMacros.h"
+
+namespace RAMCloud {
+
+/**
+ * Construct a scheduler with the default thresholds and no rate history.
+ *
+ * \param segletSize
+ *      Size of each seglet in bytes. Used to convert the seglet counts given
+ *      to noteSegletsAllocated() into bytes.
+ */
+CleanerScheduler::CleanerScheduler(uint32_t segletSize)
+    : lock("CleanerScheduler::lock"),
+      segletSize(segletSize),
+      minMemoryUtilization(90),
+      earliestMemoryUtilization(75),
+      memoryDepletedUtilization(99),
+      minDiskUtilization(95),
+      leadTimeMs(2000),
+      pollUsec(10000),
+      lastSegletsAllocated(0),
+      lastSegletsAllocatedTicks(0),
+      appendBytesPerSecond(0),
+      latestAppendBytesPerSecond(0),
+      compactionBytesPerSecond(0),
+      diskCleaningBytesPerSecond(0),
+      totalCompactions(0),
+      totalDiskCleanings(0),
+      consecutiveFallbacks(0),
+      totalEarlyCompactions(0),
+      totalCompactionFallbacks(0)
+{
+}
+
+/**
+ * Decide what a cleaner thread should do next.
+ *
+ * Thread 0 cleans on disk whenever the backups are running out of space or
+ * memory is nearly exhausted, and otherwise compacts once memory utilization
+ * reaches minMemoryUtilization (or earlier, if the append rate says memory
+ * will soon run out). If compaction isn't keeping up with the append rate and
+ * disk cleaning has been freeing memory faster, it cleans on disk instead.
+ *
+ * The remaining threads only ever compact. Each one joins in at a slightly
+ * higher memory utilization than the last, or as soon as there's work to do
+ * if compaction is falling behind.
+ *
+ * \param threadNumber
+ *      Which cleaner thread is asking (0 is the first).
+ * \param memoryUtilization
+ *      Current percentage of log memory in use.
+ * \param diskUtilization
+ *      Current percentage of backup segment space in use.
+ * \param freeBytes
+ *      Bytes of log memory still available for appends.
+ * \param[out] outLowOnDiskSpace
+ *      Set to true if backup disk utilization is at or above
+ *      minDiskUtilization (see LogCleaner::doDiskCleaning), false otherwise.
+ */
+CleanerScheduler::Work
+CleanerScheduler::getWork(uint32_t threadNumber,
+                          int memoryUtilization,
+                          int diskUtilization,
+                          uint64_t freeBytes,
+                          bool* outLowOnDiskSpace)
+{
+    Lock guard(lock);
+
+    uint32_t memUtil = static_cast<uint32_t>(std::max(0, memoryUtilization));
+    uint32_t diskUtil = static_cast<uint32_t>(std::max(0, diskUtilization));
+    bool lowOnDiskSpace = (diskUtil >= minDiskUtilization);
+    bool notKeepingUp = (memUtil >= memoryDepletedUtilization);
+    bool lowOnMemory = (memUtil >= minMemoryUtilization);
+
+    uint64_t appendRate = std::max(appendBytesPerSecond,
+                                   latestAppendBytesPerSecond);
+    bool runningOutSoon = (!lowOnMemory &&
+                           memUtil >= earliestMemoryUtilization &&
+                           appendRate * leadTimeMs / 1000 > freeBytes);
+
+    *outLowOnDiskSpace = lowOnDiskSpace;
+
+    if (threadNumber == 0) {
+        if (lowOnDiskSpace || notKeepingUp)
+            return CLEAN_ON_DISK;
+
+        if (lowOnMemory) {
+            if (compactionFallingBehind()) {
+                consecutiveFallbacks++;
+                totalCompactionFallbacks++;
+                return CLEAN_ON_DISK;
+            }
+            consecutiveFallbacks = 0;
+            return COMPACT;
+        }
+
+        if (runningOutSoon) {
+            totalEarlyCompactions++;
+            return COMPACT;
+        }
+
+        return NO_WORK;
+    }
+
+    uint32_t threshold = std::min(memoryDepletedUtilization,
+                                  minMemoryUtilization + 2 * threadNumber);
+    if (memUtil >= threshold)
+        return COMPACT;
+    if ((lowOnMemory || runningOutSoon) && compactionFallingBehind())
+        return COMPACT;
+    return NO_WORK;
+}
+
+/**
+ * Update the append rate. This should be called every time the cleaner looks
+ * for work; the rate is recomputed at most once every APPEND_RATE_INTERVAL_MS.
+ *
+ * \param totalSegletsAllocated
+ *      The total number of seglets ever allocated for appends to the log (see
+ *      SegletAllocator::getDefaultSegletsAllocated()).
+ */
+void
+CleanerScheduler::noteSegletsAllocated(uint64_t totalSegletsAllocated)
+{
+    Lock guard(lock);
+
+    uint64_t now = Cycles::rdtsc();
+    if (lastSegletsAllocatedTicks == 0) {
+        lastSegletsAllocated = totalSegletsAllocated;
+        lastSegletsAllocatedTicks = now;
+        return;
+    }
+
+    uint64_t elapsedNs = Cycles::toNanoseconds(now - lastSegletsAllocatedTicks);
+    if (elapsedNs < APPEND_RATE_INTERVAL_MS * 1000UL * 1000UL)
+        return;
+
+    uint64_t bytes = (totalSegletsAllocated - lastSegletsAllocated) *
+                     segletSize;
+    latestAppendBytesPerSecond = static_cast<uint64_t>(
+        static_cast<double>(bytes) * 1e9 / static_cast<double>(elapsedNs));
+    appendBytesPerSecond = average(appendBytesPerSecond,
+                                   latestAppendBytesPerSecond);
+    lastSegletsAllocated = totalSegletsAllocated;
+    lastSegletsAllocatedTicks = now;
+}
+
+/**
+ * Record how quickly a compaction pass freed memory.
+ *
+ * \param bytesFreedPerSecond
+ *      The rate returned by LogCleaner::doMemoryCleaning().
+ */
+void
+CleanerScheduler::noteCompaction(uint64_t bytesFreedPerSecond)
+{
+    Lock guard(lock);
+    if (totalCompactions == 0)
+        compactionBytesPerSecond = bytesFreedPerSecond;
+    else
+        compactionBytesPerSecond = average(compactionBytesPerSecond,
+                                           bytesFreedPerSecond);
+    totalCompactions++;
+}
+
+/**
+ * Record how quickly a disk cleaning pass freed memory.
+ *
+ * \param bytesFreedPerSecond
+ *      The rate returned by LogCleaner::doDiskCleaning().
+ */
+void
+CleanerScheduler::noteDiskCleaning(uint64_t bytesFreedPerSecond)
+{
+    Lock guard(lock);
+    if (totalDiskCleanings == 0)
+        diskCleaningBytesPerSecond = bytesFreedPerSecond;
+    else
+        diskCleaningBytesPerSecond = average(diskCleaningBytesPerSecond,
+                                             bytesFreedPerSecond);
+    totalDiskCleanings++;
+}
+
+/**
+ * Return how many microseconds a cleaner thread should sleep after finding
+ * nothing to do.
+ */
+uint32_t
+CleanerScheduler::getPollUsec()
+{
+    Lock guard(lock);
+    return pollUsec;
+}
+
+/**
+ * Estimate how long the cleaner will take to free the given amount of
+ * memory, based on how fast compaction and disk cleaning have recently been
+ * freeing it. Masters use this to tell clients whose writes were turned away
+ * for lack of log space when to try again.
+ *
+ * \param bytesNeeded
+ *      Amount of memory that must be freed.
+ * \return
+ *      The estimated delay in microseconds, between MIN_RETRY_DELAY_MICROS
+ *      and MAX_RETRY_DELAY_MICROS.
+ */
+uint32_t
+CleanerScheduler::getRetryDelayMicros(uint64_t bytesNeeded)
+{
+    Lock guard(lock);
+
+    uint64_t bytesPerSecond = 0;
+    if (totalCompactions != 0)
+        bytesPerSecond = compactionBytesPerSecond;
+    if (totalDiskCleanings != 0)
+        bytesPerSecond = std::max(bytesPerSecond, diskCleaningBytesPerSecond);
+    if (bytesPerSecond == 0)
+        return DEFAULT_RETRY_DELAY_MICROS;
+
+    uint64_t micros = bytesNeeded * 1000000 / bytesPerSecond;
+    micros = std::max(micros, uint64_t(MIN_RETRY_DELAY_MICROS));
+    micros = std::min(micros, uint64_t(MAX_RETRY_DELAY_MICROS));
+    return downCast<uint32_t>(micros);
+}
+
+/**
+ * Change one of the scheduler's thresholds. The names are the same as the
+ * member fields: "minMemoryUtilization", "earliestMemoryUtilization",
+ * "memoryDepletedUtilization", "minDiskUtilization", "leadTimeMs", and
+ * "pollUsec".
+ *
+ * \param option
+ *      Name of the threshold to change.
+ * \param value
+ *      New value, as a decimal string. Utilizations must be between 0 and
+ *      100 and pollUsec must be non-zero.
+ * \return
+ *      True if the threshold was changed. False if there's no threshold with
+ *      the given name or the value couldn't be parsed or is out of range, in
+ *      which case nothing is changed.
+ */
+bool
+CleanerScheduler::setOption(const char* option, const char* value)
+{
+    std::istringstream iss(value);
+    uint32_t parsed;
+    if (!(iss >> parsed) || !iss.eof())
+        return false;
+
+    Lock guard(lock);
+
+    string name(option);
+    uint32_t* target = NULL;
+    uint32_t maximum = ~0U;
+    if (name == "minMemoryUtilization") {
+        target = &minMemoryUtilization;
+        maximum = 100;
+    } else if (name == "earliestMemoryUtilization") {
+        target = &earliestMemoryUtilization;
+        maximum = 100;
+    } else if (name == "memoryDepletedUtilization") {
+        target = &memoryDepletedUtilization;
+        maximum = 100;
+    } else if (name == "minDiskUtilization") {
+        target = &minDiskUtilization;
+        maximum = 100;
+    } else if (name == "leadTimeMs") {
+        target = &leadTimeMs;
+    } else if (name == "pollUsec") {
+        if (parsed == 0)
+            return false;
+        target = &pollUsec;
+    }
+
+    if (target == NULL || parsed > maximum)
+        return false;
+
+    LOG(NOTICE, "Cleaner option %s changed from %u to %u",
+        option, *target, parsed);
+    *target = parsed;
+    return true;
+}
+
+/**
+ * Add the scheduler's thresholds and metrics to the given cleaner metrics.
+ */
+void
+CleanerScheduler::getMetrics(ProtoBuf::LogMetrics_CleanerMetrics& m)
+{
+    Lock guard(lock);
+    m.set_poll_usec(pollUsec);
+    m.set_min_memory_utilization(minMemoryUtilization);
+    m.set_min_disk_utilization(minDiskUtilization);
+    m.set_earliest_memory_utilization(earliestMemoryUtilization);
+    m.set_memory_depleted_utilization(memoryDepletedUtilization);
+    m.set_lead_time_ms(leadTimeMs);
+    m.set_append_bytes_per_second(appendBytesPerSecond);
+    m.set_compaction_bytes_per_second(compactionBytesPerSecond);
+    m.set_disk_cleaning_bytes_per_second(diskCleaningBytesPerSecond);
+    m.set_total_early_compactions(totalEarlyCompactions);
+    m.set_total_compaction_fallbacks(totalCompactionFallbacks);
+}
+
+/******************************************************************************
+ * PRIVATE METHODS
+ ******************************************************************************/
+
+/**
+ * Fold a new sample into a moving average.
+ */
+uint64_t
+CleanerScheduler::average(uint64_t previous, uint64_t sample)
+{
+    return (previous / 8) * HISTORY_WEIGHT + (sample / 8) * (8 - HISTORY_WEIGHT);
+}
+
+/**
+ * Return true if memory is being consumed faster than compaction has been
+ * freeing it and disk cleaning looks like a better bet: either it has been
+ * freeing memory faster, or it hasn't been tried yet. The caller must hold
+ * the lock.
+ *
+ * Compaction's rate is only measured when it runs, so after
+ * COMPACTION_PROBE_INTERVAL consecutive passes of disk cleaning this returns
+ * false once to give compaction a chance to show that it's doing better.
+ */
+bool
+CleanerScheduler::compactionFallingBehind()
+{
+    if (totalCompactions == 0)
+        return false;
+
+    uint64_t appendRate = std::max(appendBytesPerSecond,
+                                   latestAppendBytesPerSecond);
+    if (compactionBytesPerSecond >= appendRate)
+        return false;
+
+    if (totalDiskCleanings != 0 &&
+            diskCleaningBytesPerSecond <= compactionBytesPerSecond) {
+        return false;
+    }
+
+    return consecutiveFallbacks < COMPACTION_PROBE_INTERVAL;
+}
+
+} // namespace
@@ -0,0 +1,180 @@
+/* Copyright (c) 2013 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef RAMCLOUD_CLEANERSCHEDULER_H
+#define RAMCLOUD_CLEANERSCHEDULER_H
+
+#include "Common.h"
+#include "LogCleanerMetrics.h"
+#include "SpinLock.h"
+
+namespace RAMCloud {
+
+/**
+ * Decides when the LogCleaner's threads should run and whether they should
+ * compact segments in memory or clean them on disk.
+ *
+ * Static utilization thresholds alone start cleaning either too late for
+ * bursty write loads (memory runs out before the cleaner catches up, stalling
+ * writes) or too eagerly (disk cleaning generates backup traffic that
+ * compaction would have avoided). This class therefore also tracks how fast
+ * the log is consuming memory and how fast each kind of cleaning has recently
+ * freed it, and uses them to:
+ *
+ *  1) Start compacting before memory utilization reaches the usual threshold
+ *     if, at the current append rate, free memory would run out within a
+ *     configurable lead time.
+ *
+ *  2) Prefer compaction, which doesn't use the network, and only clean on
+ *     disk when compaction isn't freeing memory as fast as the log consumes
+ *     it and disk cleaning has been doing better (or hasn't been tried).
+ *
+ * The thresholds may be changed while the server is running with setOption().
+ * This class is thread-safe.
+ */
+class CleanerScheduler {
+  public:
+    /**
+     * The kind of work a cleaner thread should do next.
+     */
+    enum Work {
+        /// Nothing needs cleaning right now; sleep for getPollUsec().
+        NO_WORK = 0,
+
+        /// Compact a segment in memory.
+        COMPACT = 1,
+
+        /// Clean segments on disk.
+        CLEAN_ON_DISK = 2
+    };
+
+    explicit CleanerScheduler(uint32_t segletSize);
+    Work getWork(uint32_t threadNumber,
+                 int memoryUtilization,
+                 int diskUtilization,
+                 uint64_t freeBytes,
+                 bool* outLowOnDiskSpace);
+    void noteSegletsAllocated(uint64_t totalSegletsAllocated);
+    void noteCompaction(uint64_t bytesFreedPerSecond);
+    void noteDiskCleaning(uint64_t bytesFreedPerSecond);
+    uint32_t getPollUsec();
+    uint32_t getRetryDelayMicros(uint64_t bytesNeeded);
+    bool setOption(const char* option, const char* value);
+    void getMetrics(ProtoBuf::LogMetrics_CleanerMetrics& m);
+
+  PRIVATE:
+    typedef std::lock_guard<SpinLock> Lock;
+
+    /// The append rate is recomputed at most this often, in milliseconds.
+    /// Shorter intervals make the rate too noisy to be useful.
+    enum { APPEND_RATE_INTERVAL_MS = 100 };
+
+    /// Weight (out of 8) given to the previous value when folding a new
+    /// sample into one of the moving averages below.
+    enum { HISTORY_WEIGHT = 6 };
+
+    /// Thread 0 compacts at least once after this many consecutive disk
+    /// cleaning passes chosen by compactionFallingBehind().
+    enum { COMPACTION_PROBE_INTERVAL = 8 };
+
+    /// Bounds on the delays suggested by getRetryDelayMicros(), and the
+    /// delay suggested before the cleaner has freed anything.
+    enum { MIN_RETRY_DELAY_MICROS = 100,
+           MAX_RETRY_DELAY_MICROS = 100000,
+           DEFAULT_RETRY_DELAY_MICROS = 1000 };
+
+    static uint64_t average(uint64_t previous, uint64_t sample);
+    bool compactionFallingBehind();
+
+    /// Serializes all access to the members below.
+    SpinLock lock;
+
+    /// Size of each seglet in bytes.
+    const uint32_t segletSize;
+
+    /// The minimum memory utilization at which compaction always runs.
+    uint32_t minMemoryUtilization;
+
+    /// Compaction never starts early (see leadTimeMs) below this memory
+    /// utilization.
+    uint32_t earliestMemoryUtilization;
+
+    /// Memory utilization at which we declare that the cleaner isn't able to
+    /// keep up with the incoming write rate. We'll then clean on disk, which
+    /// also frees tombstones, even if it means increasing backup traffic (and
+    /// possibly reducing write throughput by contending for the network).
+    uint32_t memoryDepletedUtilization;
+
+    /// The minimum backup disk utilization at which disk cleaning runs. The
+    /// disk cleaner may also run if compaction is not keeping up with the
+    /// log writes (accumulation of tombstones will eventually make compaction
+    /// inefficient, and disk cleaning is needed to free them).
+    uint32_t minDiskUtilization;
+
+    /// Compaction starts early if free memory would run out within this
+    /// many milliseconds at the current append rate. 0 disables early starts.
+    uint32_t leadTimeMs;
+
+    /// If no cleaning work had to be done the last time we checked, sleep for
+    /// this many microseconds before checking again.
+    uint32_t pollUsec;
+
+    /// The value passed to the last noteSegletsAllocated() call that
+    /// updated the append rate.
+    uint64_t lastSegletsAllocated;
+
+    /// Cycles::rdtsc() time of that call (0 if there hasn't been one).
+    uint64_t lastSegletsAllocatedTicks;
+
+    /// Moving average of the rate at which the log consumes memory, in bytes
+    /// per second.
+    uint64_t appendBytesPerSecond;
+
+    /// The most recently measured append rate. Bursts show up here before
+    /// they move the average, so the larger of the two is used.
+    uint64_t latestAppendBytesPerSecond;
+
+    /// Moving average of the rate at which compaction freed memory, in bytes
+    /// per second. Only meaningful once totalCompactions is non-zero.
+    uint64_t compactionBytesPerSecond;
+
+    /// Moving average of the rate at which disk cleaning freed memory, in
+    /// bytes per second. Only meaningful once totalDiskCleanings is non-zero.
+    uint64_t diskCleaningBytesPerSecond;
+
+    /// Number of compaction passes whose rates have been noted.
+    uint64_t totalCompactions;
+
+    /// Number of disk cleaning passes whose rates have been noted.
+    uint64_t totalDiskCleanings;
+
+    /// Number of disk cleaning passes chosen by compactionFallingBehind()
+    /// since thread 0 last compacted.
+    uint32_t consecutiveFallbacks;
+
+    /// Number of times compaction was started early because memory was
+    /// running out faster than the utilization thresholds would have noticed.
+    LogCleanerMetrics::Metric64BitType totalEarlyCompactions;
+
+    /// Number of times the disk cleaner was chosen because compaction wasn't
+    /// keeping up with the append rate.
+    LogCleanerMetrics::Metric64BitType totalCompactionFallbacks;
+
+    DISALLOW_COPY_AND_ASSIGN(CleanerScheduler);
+};
+
+} // namespace
+
+#endif // !RAMCLOUD_CLEANERSCHEDULER_H
@@ -0,0 +1,194 @@
+/* Copyright (c) 2013 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "TestUtil.h"
+
+#include "CleanerScheduler.h"
+#include "Cycles.h"
+
+namespace RAMCloud {
+
+/**
+ * Unit tests for CleanerScheduler.
+ */
+class CleanerSchedulerTest : public ::testing::Test {
+  public:
+    CleanerScheduler scheduler;
+    bool lowOnDiskSpace;
+
+    CleanerSchedulerTest()
+        : scheduler(1024 * 1024),
+          lowOnDiskSpace(false)
+    {
+    }
+
+    ~CleanerSchedulerTest()
+    {
+        Cycles::mockTscValue = 0;
+    }
+
+    /// Ask for work for the given thread with plenty of free memory.
+    CleanerScheduler::Work
+    getWork(uint32_t threadNumber, int memUtil, int diskUtil = 0)
+    {
+        return scheduler.getWork(threadNumber, memUtil, diskUtil,
+                                 1024UL * 1024 * 1024, &lowOnDiskSpace);
+    }
+
+    /// Feed the scheduler a steady append rate of the given number of
+    /// megabytes per second.
+    void
+    setAppendRate(uint64_t megabytesPerSecond)
+    {
+        Cycles::mockTscValue = 1000;
+        scheduler.noteSegletsAllocated(0);
+        Cycles::mockTscValue = 1000 + Cycles::fromSeconds(1);
+        scheduler.noteSegletsAllocated(megabytesPerSecond);
+    }
+
+  private:
+    DISALLOW_COPY_AND_ASSIGN(CleanerSchedulerTest);
+};
+
+TEST_F(CleanerSchedulerTest, getWork_thresholds) {
+    EXPECT_EQ(CleanerScheduler::NO_WORK, getWork(0, 89));
+    EXPECT_EQ(CleanerScheduler::COMPACT, getWork(0, 90));
+    EXPECT_FALSE(lowOnDiskSpace);
+    EXPECT_EQ(CleanerScheduler::CLEAN_ON_DISK, getWork(0, 99));
+    EXPECT_EQ(CleanerScheduler::CLEAN_ON_DISK, getWork(0, 0, 95));
+    EXPECT_TRUE(lowOnDiskSpace);
+
+    // Other threads join in at successively higher utilizations, and never
+    // clean on disk.
+    EXPECT_EQ(CleanerScheduler::NO_WORK, getWork(1, 91));
+    EXPECT_EQ(CleanerScheduler::COMPACT, getWork(1, 92));
+    EXPECT_EQ(CleanerScheduler::NO_WORK, getWork(2, 93));
+    EXPECT_EQ(CleanerScheduler::COMPACT, getWork(2, 94));
+    EXPECT_EQ(CleanerScheduler::COMPACT, getWork(10, 99));
+    EXPECT_EQ(CleanerScheduler::NO_WORK, getWork(1, 0, 100));
+}
+
+TEST_F(CleanerSchedulerTest, getWork_earlyCompaction) {
+    // 100 MB/s with a 2 second lead time: start once less than 200 MB is
+    // free, but never below earliestMemoryUtilization.
+    setAppendRate(100);
+    EXPECT_EQ(100UL * 1024 * 1024, scheduler.latestAppendBytesPerSecond);
+    uint64_t mb = 1024 * 1024;
+    EXPECT_EQ(CleanerScheduler::NO_WORK,
+              scheduler.getWork(0, 80, 0, 201 * mb, &lowOnDiskSpace));
+    EXPECT_EQ(CleanerScheduler::COMPACT,
+              scheduler.getWork(0, 80, 0, 199 * mb, &lowOnDiskSpace));
+    EXPECT_EQ(CleanerScheduler::NO_WORK,
+              scheduler.getWork(0, 74, 0, 199 * mb, &lowOnDiskSpace));
+    EXPECT_EQ(CleanerScheduler::NO_WORK,
+              scheduler.getWork(1, 80, 0, 199 * mb, &lowOnDiskSpace));
+    EXPECT_EQ(1U, scheduler.totalEarlyCompactions);
+}
+
+TEST_F(CleanerSchedulerTest, getWork_compactionFallingBehind) {
+    uint64_t mb = 1024 * 1024;
+    setAppendRate(100);
+
+    // Compaction hasn't run yet, so it's given the benefit of the doubt.
+    EXPECT_EQ(CleanerScheduler::COMPACT, getWork(0, 95));
+    scheduler.noteCompaction(50 * mb);
+
+    // Compaction is falling behind and disk cleaning hasn't been tried.
+    EXPECT_EQ(CleanerScheduler::CLEAN_ON_DISK, getWork(0, 95));
+    EXPECT_EQ(CleanerScheduler::COMPACT, getWork(1, 90));
+    scheduler.noteDiskCleaning(40 * mb);
+
+    // Disk cleaning did worse.
+    EXPECT_EQ(CleanerScheduler::COMPACT, getWork(0, 95));
+    EXPECT_EQ(CleanerScheduler::NO_WORK, getWork(1, 90));
+
+    // Disk cleaning does better.
+    for (int i = 0; i < 10; i++)
+        scheduler.noteDiskCleaning(200 * mb);
+    EXPECT_EQ(CleanerScheduler::CLEAN_ON_DISK, getWork(0, 95));
+
+    // Compaction keeps up again.
+    for (int i = 0; i < 10; i++)
+        scheduler.noteCompaction(400 * mb);
+    EXPECT_EQ(CleanerScheduler::COMPACT, getWork(0, 95));
+    EXPECT_EQ(2U, scheduler.totalCompactionFallbacks);
+}
+
+TEST_F(CleanerSchedulerTest, getWork_compactionProbe) {
+    uint64_t mb = 1024 * 1024;
+    setAppendRate(100);
+    scheduler.noteCompaction(10 * mb);
+    scheduler.noteDiskCleaning(50 * mb);
+
+    for (int i = 0; i < 8; i++)
+        EXPECT_EQ(CleanerScheduler::CLEAN_ON_DISK, getWork(0, 95));
+    EXPECT_EQ(CleanerScheduler::COMPACT, getWork(0, 95));
+    EXPECT_EQ(CleanerScheduler::CLEAN_ON_DISK, getWork(0, 95));
+}
+
+TEST_F(CleanerSchedulerTest, noteSegletsAllocated) {
+    Cycles::mockTscValue = 1000;
+    scheduler.noteSegletsAllocated(10);
+    EXPECT_EQ(0U, scheduler.appendBytesPerSecond);
+
+    // Too soon to update the rate.
+    Cycles::mockTscValue = 1000 + Cycles::fromSeconds(0.05);
+    scheduler.noteSegletsAllocated(20);
+    EXPECT_EQ(0U, scheduler.latestAppendBytesPerSecond);
+
+    Cycles::mockTscValue = 1000 + Cycles::fromSeconds(0.5);
+    scheduler.noteSegletsAllocated(60);
+    EXPECT_NEAR(100.0 * 1024 * 1024,
+                static_cast<double>(scheduler.latestAppendBytesPerSecond),
+                1024);
+    EXPECT_NEAR(25.0 * 1024 * 1024,
+                static_cast<double>(scheduler.appendBytesPerSecond),
+                1024);
+    EXPECT_EQ(60U, scheduler.lastSegletsAllocated);
+}
+
+TEST_F(CleanerSchedulerTest, getRetryDelayMicros) {
+    uint64_t mb = 1024 * 1024;
+    EXPECT_EQ(1000U, scheduler.getRetryDelayMicros(8 * mb));
+
+    // The faster of the two kinds of cleaning is used.
+    scheduler.noteCompaction(100 * mb);
+    scheduler.noteDiskCleaning(400 * mb);
+    EXPECT_EQ(20000U, scheduler.getRetryDelayMicros(8 * mb));
+
+    EXPECT_EQ(100U, scheduler.getRetryDelayMicros(1));
+    EXPECT_EQ(100000U, scheduler.getRetryDelayMicros(1000 * mb));
+}
+
+TEST_F(CleanerSchedulerTest, setOption) {
+    EXPECT_TRUE(scheduler.setOption("minMemoryUtilization", "80"));
+    EXPECT_EQ(80U, scheduler.minMemoryUtilization);
+    EXPECT_EQ(CleanerScheduler::COMPACT, getWork(0, 80));
+
+    EXPECT_TRUE(scheduler.setOption("pollUsec", "500"));
+    EXPECT_EQ(500U, scheduler.getPollUsec());
+    EXPECT_TRUE(scheduler.setOption("leadTimeMs", "0"));
+    EXPECT_EQ(0U, scheduler.leadTimeMs);
+
+    EXPECT_FALSE(scheduler.setOption("bogus", "1"));
+    EXPECT_FALSE(scheduler.setOption("minDiskUtilization", "101"));
+    EXPECT_FALSE(scheduler.setOption("minDiskUtilization", "9x"));
+    EXPECT_FALSE(scheduler.setOption("minDiskUtilization", ""));
+    EXPECT_FALSE(scheduler.setOption("pollUsec", "0"));
+    EXPECT_EQ(95U, scheduler.minDiskUtilization);
+    EXPECT_EQ(500U, scheduler.getPollUsec());
+}
+
+}  // namespace RAMCloud
@@ -143,9 +143,27 @@ DEFINE_EXCEPTION(BackupMalformedSegmentException,
 DEFINE_EXCEPTION(SegmentRecoveryFailedException,
                  STATUS_SEGMENT_RECOVERY_FAILED,
                  ClientException)
-DEFINE_EXCEPTION(RetryException,
-                 STATUS_RETRY,
-                 ClientException)
+
+/**
+ * Thrown when the server asks the client to retry the operation later.
+ * Servers may throw it with a suggested range for the retry delay, which
+ * Service::handleRpc returns to the client in a WireFormat::RetryResponse.
+ */
+class RetryException : public ClientException {
+  public:
+    explicit RetryException(const CodeLocation& where,
+                            uint32_t minDelayMicros = 0,
+                            uint32_t maxDelayMicros = 0)
+        : ClientException(where, STATUS_RETRY)
+        , minDelayMicros(minDelayMicros)
+        , maxDelayMicros(maxDelayMicros) {}
+
+    /// Suggested range for the delay before the client retries, in
+    /// microseconds; 0 for both means use the client's default.
+    uint32_t minDelayMicros;
+    uint32_t maxDelayMicros;
+};
+
 DEFINE_EXCEPTION(ServiceNotAvailableException,
                  STATUS_SERVICE_NOT_AVAILABLE,
                  ClientException)
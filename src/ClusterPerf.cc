@@ -41,13 +41,22 @@
 
 #include <boost/program_options.hpp>
 #include <boost/version.hpp>
+#if __GNUC__ >= 4 && __GNUC_MINOR__ >= 5
+#include <atomic>
+#else
+#include <cstdatomic>
+#endif
+#include <cmath>
 #include <iostream>
+#include <thread>
 namespace po = boost::program_options;
 
 #include "RamCloud.h"
 #include "CycleCounter.h"
 #include "Cycles.h"
 #include "KeyUtil.h"
+#include "LatencyMetrics.h"
+#include "ProtoBuf.h"
 
 using namespace RAMCloud;
 
@@ -57,6 +66,10 @@ Context context(true);
 // Used to invoke RAMCloud operations.
 static RamCloud* cluster;
 
+// Value of the "--coordinator" command-line option: service locator for
+// the cluster coordinator.
+static string coordinatorLocator;
+
 // Total number of clients that will be participating in this test.
 static int numClients;
 
@@ -84,6 +97,26 @@ static int numTables;
 // measurements (e.g. to make sure that caches are loaded).
 static int warmupCount;
 
+// Value of the "--serverLatency" command-line option: if true, some tests
+// also print the server-side latency of each stage of their RPCs.
+static bool serverLatency;
+
+// Value of the "--records" command-line option: number of objects the
+// YCSB tests load into their table before running a workload.
+static int records;
+
+// Value of the "--targetOps" command-line option: if nonzero, each client
+// in the YCSB tests issues operations open-loop, at exponentially
+// distributed intervals averaging this many operations per second.
+// Otherwise each client issues its next operation as soon as the previous
+// one completes.
+static double targetOps;
+
+// Value of the "--keyDistribution" command-line option: if nonempty,
+// overrides the distribution ("uniform", "zipfian", or "latest") that each
+// YCSB workload uses to choose keys.
+static string keyDistribution;
+
 // Identifier for table that is used for test-specific data.
 uint64_t dataTable = -1;
 
@@ -103,6 +136,8 @@ enum Id {
                                      // regions; used in log messages.
     METRICS = 3,                     // Statistics returned from slaves
                                      // to masters.
+    HISTOGRAMS = 4,                  // Latency histograms returned from
+                                     // slaves to masters by YCSB tests.
 };
 
 #define MAX_METRICS 8
@@ -242,6 +277,82 @@ printPercent(const char* name, double value, const char* description)
     printf("%-20s    %.1f %%      %s\n", name, value, description);
 }
 
+/**
+ * Discard the RPC latencies recorded by a master, so that a following call
+ * to printServerLatency reports only on the RPCs issued in between. This
+ * does nothing unless the "--serverLatency" option was specified.
+ *
+ * \param tableId
+ *      Table containing the object identified by \a key.
+ * \param key
+ *      Key of any object stored on the master of interest.
+ * \param keyLength
+ *      Size in bytes of the key.
+ */
+void
+resetServerLatency(uint64_t tableId, const void* key, uint16_t keyLength)
+{
+    if (!serverLatency)
+        return;
+    Buffer output;
+    cluster->serverControl(tableId, key, keyLength,
+            WireFormat::RESET_LATENCY_METRICS, NULL, 0, &output);
+}
+
+/**
+ * Print the median and 99th percentile latency of each stage that a master
+ * went through when serving one kind of RPC, as recorded since the last
+ * call to resetServerLatency. This does nothing unless the
+ * "--serverLatency" option was specified.
+ *
+ * \param name
+ *      Symbolic name for the measurement, in the form test.value (as for
+ *      printTime); the name of each stage is appended to it.
+ * \param opcode
+ *      Kind of RPC whose latencies are to be printed.
+ * \param tableId
+ *      Table containing the object identified by \a key.
+ * \param key
+ *      Key of any object stored on the master of interest.
+ * \param keyLength
+ *      Size in bytes of the key.
+ */
+void
+printServerLatency(const char* name, WireFormat::Opcode opcode,
+        uint64_t tableId, const void* key, uint16_t keyLength)
+{
+    if (!serverLatency)
+        return;
+    Buffer output;
+    cluster->serverControl(tableId, key, keyLength,
+            WireFormat::GET_LATENCY_METRICS, NULL, 0, &output);
+    ProtoBuf::LatencyMetrics metrics;
+    ProtoBuf::parseFromResponse(&output, 0, output.getTotalLength(),
+            &metrics);
+
+    char stageName[50], description[50];
+    for (int i = 0; i < LatencyMetrics::NUM_STAGES; i++) {
+        LatencyMetrics::Stage stage = LatencyMetrics::Stage(i);
+        const ProtoBuf::LatencyMetrics_Histogram* histogram =
+                LatencyMetrics::find(metrics, WireFormat::opcodeSymbol(opcode),
+                stage);
+        if (histogram == NULL)
+            continue;
+        snprintf(stageName, sizeof(stageName), "%s.%s", name,
+                LatencyMetrics::stageName(stage));
+        snprintf(description, sizeof(description), "server %s, median",
+                LatencyMetrics::stageName(stage));
+        printTime(stageName, 1e-09 * static_cast<double>(
+                LatencyMetrics::getPercentile(*histogram, 50)), description);
+        snprintf(stageName, sizeof(stageName), "%s.%s.p99", name,
+                LatencyMetrics::stageName(stage));
+        snprintf(description, sizeof(description), "server %s, 99%%",
+                LatencyMetrics::stageName(stage));
+        printTime(stageName, 1e-09 * static_cast<double>(
+                LatencyMetrics::getPercentile(*histogram, 99)), description);
+    }
+}
+
 /**
  * Time how long it takes to read a set of objects in one multiRead
  * operation repeatedly.
@@ -895,6 +1006,540 @@ average(std::vector<double>& data)
     return result / length;
 }
 
+//----------------------------------------------------------------------
+// Workload engine for the YCSB tests (ycsbA through ycsbF).  These
+// implement the six core workloads of the Yahoo! Cloud Serving Benchmark
+// natively, so they can be driven by many clients at once with the same
+// master/slave protocol as the other tests.
+//----------------------------------------------------------------------
+
+/**
+ * Return a random number uniformly distributed in [0, 1).
+ */
+static double
+randomFraction()
+{
+    return static_cast<double>(generateRandom() >> 11) /
+            static_cast<double>(1UL << 53);
+}
+
+/**
+ * Generates integers in the range [0, n) following a Zipfian distribution
+ * in which 0 is the most popular value. This uses the algorithm from Gray
+ * et al., "Quickly Generating Billion-Record Synthetic Databases" (the
+ * same one YCSB uses); n may grow over time as records are inserted.
+ */
+class ZipfianGenerator {
+  public:
+    explicit ZipfianGenerator(uint64_t n, double theta = 0.99)
+        : n(0)
+        , theta(theta)
+        , alpha(1.0 / (1.0 - theta))
+        , zetan(0.0)
+        , zeta2(1.0 + pow(0.5, theta))
+        , eta(0.0)
+    {
+        grow(n);
+    }
+
+    /**
+     * Increase the number of values that can be generated; the constants
+     * that depend on it are updated incrementally.
+     */
+    void
+    grow(uint64_t newN)
+    {
+        if (newN <= n)
+            return;
+        for (uint64_t i = n + 1; i <= newN; i++)
+            zetan += 1.0 / pow(static_cast<double>(i), theta);
+        n = newN;
+        eta = (1.0 - pow(2.0 / static_cast<double>(n), 1.0 - theta)) /
+                (1.0 - zeta2 / zetan);
+    }
+
+    uint64_t
+    next()
+    {
+        double u = randomFraction();
+        double uz = u * zetan;
+        if (uz < 1.0)
+            return 0;
+        if (uz < zeta2)
+            return 1;
+        uint64_t result = static_cast<uint64_t>(static_cast<double>(n) *
+                pow(eta * u - eta + 1.0, alpha));
+        return std::min(result, n - 1);
+    }
+
+  PRIVATE:
+    uint64_t n;                   // Values are in the range [0, n).
+    double theta;                 // Skew: larger means more skewed.
+    double alpha;                 // 1 / (1 - theta).
+    double zetan;                 // Sum of 1/i^theta for i = 1..n.
+    double zeta2;                 // Sum of 1/i^theta for i = 1..2.
+    double eta;
+};
+
+/**
+ * Counts latencies in buckets whose width grows with the latency, so a
+ * few hundred buckets cover everything up to 10ms with at most 10% error:
+ * 100ns buckets below 10us, then 1us buckets up to 100us, 10us buckets up
+ * to 1ms, and 100us buckets up to 10ms.  One more bucket holds anything
+ * slower.  The structure contains no pointers, so it can be sent between
+ * clients as the value of an object.
+ */
+struct LatencyHistogram {
+    enum { NUM_BUCKETS = 100 + 3*90 + 1 };
+
+    LatencyHistogram()
+        : count(0)
+        , totalNs(0)
+        , maxNs(0)
+        , buckets()
+    {}
+
+    /**
+     * Return the smallest latency, in nanoseconds, counted in a bucket.
+     */
+    static uint64_t
+    bucketStart(int bucket)
+    {
+        if (bucket < 100)
+            return 100UL * bucket;
+        uint64_t start = 10000;
+        uint64_t width = 1000;
+        bucket -= 100;
+        while (bucket >= 90) {
+            start *= 10;
+            width *= 10;
+            bucket -= 90;
+        }
+        return start + width * bucket;
+    }
+
+    /**
+     * Record one latency measurement, in nanoseconds.
+     */
+    void
+    record(uint64_t ns)
+    {
+        int bucket = NUM_BUCKETS - 1;
+        if (ns < 10000) {
+            bucket = downCast<int>(ns / 100);
+        } else {
+            uint64_t start = 10000;
+            uint64_t width = 1000;
+            for (int decade = 0; decade < 3; decade++) {
+                if (ns < start * 10) {
+                    bucket = 100 + 90*decade +
+                            downCast<int>((ns - start) / width);
+                    break;
+                }
+                start *= 10;
+                width *= 10;
+            }
+        }
+        buckets[bucket]++;
+        count++;
+        totalNs += ns;
+        maxNs = std::max(maxNs, ns);
+    }
+
+    /**
+     * Add the measurements from another histogram to this one.
+     */
+    void
+    merge(const LatencyHistogram& other)
+    {
+        for (int i = 0; i < NUM_BUCKETS; i++)
+            buckets[i] += other.buckets[i];
+        count += other.count;
+        totalNs += other.totalNs;
+        maxNs = std::max(maxNs, other.maxNs);
+    }
+
+    /**
+     * Return an upper bound, in nanoseconds, on the given fraction of
+     * the recorded latencies (e.g. 0.99 for the 99th percentile).
+     */
+    uint64_t
+    percentile(double fraction)
+    {
+        uint64_t target = static_cast<uint64_t>(
+                ceil(fraction * static_cast<double>(count)));
+        uint64_t seen = 0;
+        for (int i = 0; i < NUM_BUCKETS - 1; i++) {
+            seen += buckets[i];
+            if (seen >= target)
+                return std::min(bucketStart(i + 1), maxNs);
+        }
+        return maxNs;
+    }
+
+    uint64_t count;               // Number of latencies recorded.
+    uint64_t totalNs;             // Sum of all latencies recorded.
+    uint64_t maxNs;               // Largest latency recorded.
+    uint64_t buckets[NUM_BUCKETS];
+};
+
+// The kinds of operations issued by the YCSB workloads.
+enum YcsbOp {
+    YCSB_READ,
+    YCSB_UPDATE,
+    YCSB_INSERT,
+    YCSB_SCAN,
+    YCSB_READ_MODIFY_WRITE,
+    YCSB_OP_TYPES                 // Must be last.
+};
+static const char* ycsbOpNames[] = {"read", "update", "insert", "scan",
+                                    "readModifyWrite"};
+
+/**
+ * The mix of operations and the key distribution for one of the YCSB
+ * core workloads (see the "workloads" directory of the YCSB distribution).
+ */
+struct YcsbWorkload {
+    const char* name;             // Name of the test, such as "ycsbA".
+    const char* description;      // Printed at the start of the output.
+    double fractions[YCSB_OP_TYPES]; // Fraction of operations of each
+                                  // type, indexed by YcsbOp.
+    const char* keyDistribution;  // "uniform", "zipfian", or "latest".
+};
+
+// YCSB has no range scans over RAMCloud's hashed tables, so a scan
+// multiReads this many consecutive records (at most) starting at the key
+// chosen.
+static const int YCSB_MAX_SCAN_LENGTH = 100;
+
+/**
+ * Fill in the key for a given YCSB record.
+ *
+ * \param record
+ *      Index of the record.
+ * \param key
+ *      Where to store the key; must have room for 30 bytes.
+ *
+ * \return
+ *      Length of the key in bytes.
+ */
+static uint16_t
+ycsbKey(uint64_t record, char* key)
+{
+    return downCast<uint16_t>(snprintf(key, 30, "user%lu", record));
+}
+
+/**
+ * Return a hash of a record index, used to spread the popular records
+ * chosen by a Zipfian distribution across the whole table (what YCSB
+ * calls a "scrambled" Zipfian distribution).
+ */
+static uint64_t
+fnvHash(uint64_t value)
+{
+    uint64_t hash = 0xcbf29ce484222325UL;
+    for (int i = 0; i < 8; i++) {
+        hash ^= value & 0xff;
+        hash *= 1099511628211UL;
+        value >>= 8;
+    }
+    return hash;
+}
+
+/**
+ * Write the initial records for the YCSB tests, using multiWrites of
+ * 100 objects at a time.
+ *
+ * \param tableId
+ *      Table in which to write the records.
+ * \param value
+ *      Contents of each record.
+ * \param valueLength
+ *      Size of value in bytes.
+ */
+static void
+ycsbLoad(uint64_t tableId, const char* value, uint32_t valueLength)
+{
+    const int batchSize = 100;
+    char keys[batchSize][30];
+    MultiWriteObject objects[batchSize];
+    MultiWriteObject* requests[batchSize];
+    for (int first = 0; first < records; first += batchSize) {
+        int numObjects = std::min(batchSize, records - first);
+        for (int i = 0; i < numObjects; i++) {
+            uint16_t keyLength = ycsbKey(first + i, keys[i]);
+            objects[i] = MultiWriteObject(tableId, keys[i], keyLength,
+                    value, valueLength);
+            requests[i] = &objects[i];
+        }
+        cluster->multiWrite(requests, numObjects);
+    }
+}
+
+/**
+ * Run one YCSB workload from this client, issuing "count" operations.
+ *
+ * \param workload
+ *      Describes the operations to issue.
+ * \param tableId
+ *      Table containing the YCSB records.
+ * \param histograms
+ *      The latency of each operation is recorded here, indexed by YcsbOp.
+ *      For open-loop runs (--targetOps), latency is measured from the
+ *      time an operation was scheduled to start, so time spent waiting
+ *      behind earlier operations counts.
+ *
+ * \return
+ *      The number of reads (or records in scans) that found no object;
+ *      this happens when the "latest" distribution chooses a record that
+ *      another client hasn't inserted yet.
+ */
+static int
+ycsbRun(const YcsbWorkload& workload, uint64_t tableId,
+        LatencyHistogram* histograms)
+{
+    const char* distribution = keyDistribution.empty()
+            ? workload.keyDistribution : keyDistribution.c_str();
+    bool latest = (strcmp(distribution, "latest") == 0);
+    bool zipfian = (strcmp(distribution, "zipfian") == 0);
+    if (!latest && !zipfian && (strcmp(distribution, "uniform") != 0)) {
+        throw Exception(HERE, format("unknown key distribution '%s'",
+                distribution));
+    }
+
+    // Each client inserts records with different indexes: client c
+    // inserts records + c, records + c + numClients, and so on.
+    uint64_t knownRecords = records;
+    uint64_t nextInsert = records + clientIndex;
+    ZipfianGenerator zipf(records);
+
+    uint32_t valueLength = downCast<uint32_t>(objectSize);
+    char* value = new char[valueLength];
+    genRandomString(value, objectSize);
+    char key[30];
+    char scanKeys[YCSB_MAX_SCAN_LENGTH][30];
+    MultiReadObject scanObjects[YCSB_MAX_SCAN_LENGTH];
+    MultiReadObject* scanRequests[YCSB_MAX_SCAN_LENGTH];
+    Tub<Buffer> scanValues[YCSB_MAX_SCAN_LENGTH];
+    Buffer buffer;
+    int misses = 0;
+
+    double meanGap = 0;
+    if (targetOps > 0)
+        meanGap = static_cast<double>(Cycles::fromSeconds(1.0/targetOps));
+    uint64_t nextArrival = Cycles::rdtsc();
+    for (int i = 0; i < count; i++) {
+        // Pick the operation.
+        double choice = randomFraction();
+        int op = 0;
+        while ((op < YCSB_OP_TYPES - 1) &&
+                (choice >= workload.fractions[op])) {
+            choice -= workload.fractions[op];
+            op++;
+        }
+
+        // Pick the record.
+        uint64_t record;
+        if (op == YCSB_INSERT) {
+            record = nextInsert;
+            nextInsert += numClients;
+        } else if (latest) {
+            zipf.grow(knownRecords);
+            record = knownRecords - 1 - zipf.next();
+        } else if (zipfian) {
+            record = fnvHash(zipf.next()) % knownRecords;
+        } else {
+            record = generateRandom() % knownRecords;
+        }
+        uint16_t keyLength = ycsbKey(record, key);
+
+        uint64_t start;
+        if (meanGap > 0) {
+            while (Cycles::rdtsc() < nextArrival) {
+                // Wait for the next operation to come due.
+            }
+            start = nextArrival;
+            nextArrival += static_cast<uint64_t>(-log(1.0 - randomFraction())
+                    * meanGap);
+        } else {
+            start = Cycles::rdtsc();
+        }
+
+        switch (op) {
+        case YCSB_READ:
+            try {
+                cluster->read(tableId, key, keyLength, &buffer);
+            } catch (ObjectDoesntExistException& e) {
+                misses++;
+            }
+            break;
+        case YCSB_UPDATE:
+        case YCSB_INSERT:
+            cluster->write(tableId, key, keyLength, value, valueLength);
+            break;
+        case YCSB_SCAN: {
+            uint64_t length = 1 + generateRandom() % YCSB_MAX_SCAN_LENGTH;
+            length = std::min(length, knownRecords - record);
+            for (uint64_t j = 0; j < length; j++) {
+                uint16_t scanKeyLength = ycsbKey(record + j, scanKeys[j]);
+                scanObjects[j] = MultiReadObject(tableId, scanKeys[j],
+                        scanKeyLength, &scanValues[j]);
+                scanRequests[j] = &scanObjects[j];
+            }
+            cluster->multiRead(scanRequests, downCast<uint32_t>(length));
+            for (uint64_t j = 0; j < length; j++) {
+                if (scanObjects[j].status != STATUS_OK)
+                    misses++;
+            }
+            break;
+        }
+        case YCSB_READ_MODIFY_WRITE:
+            try {
+                cluster->read(tableId, key, keyLength, &buffer);
+            } catch (ObjectDoesntExistException& e) {
+                misses++;
+            }
+            cluster->write(tableId, key, keyLength, value, valueLength);
+            break;
+        }
+        histograms[op].record(Cycles::toNanoseconds(Cycles::rdtsc() - start));
+
+        if (op == YCSB_INSERT)
+            knownRecords = std::max(knownRecords, record + 1);
+    }
+    delete[] value;
+    return misses;
+}
+
+/**
+ * Run a YCSB workload on all of the clients and (on the master) print
+ * the throughput and the latency of each kind of operation.
+ *
+ * \param workload
+ *      The workload to run.
+ */
+static void
+ycsb(const YcsbWorkload& workload)
+{
+    LatencyHistogram histograms[YCSB_OP_TYPES];
+    uint64_t tableId;
+
+    if (clientIndex > 0) {
+        // This is a slave: execute commands coming from the master.
+        while (true) {
+            char command[20];
+            getCommand(command, sizeof(command));
+            if (strcmp(command, "run") == 0) {
+                tableId = cluster->getTableId("ycsb");
+                setSlaveState("running");
+                for (int i = 0; i < YCSB_OP_TYPES; i++)
+                    histograms[i] = LatencyHistogram();
+                uint64_t start = Cycles::rdtsc();
+                int misses = ycsbRun(workload, tableId, histograms);
+                double elapsed = Cycles::toSeconds(Cycles::rdtsc() - start);
+                MakeKey key(keyVal(clientIndex, HISTOGRAMS));
+                cluster->write(controlTable, key.get(), key.length(),
+                        histograms, sizeof(histograms));
+                sendMetrics(count/elapsed, misses);
+                setSlaveState("idle");
+            } else if (strcmp(command, "done") == 0) {
+                setSlaveState("done");
+                return;
+            } else {
+                RAMCLOUD_LOG(ERROR, "unknown command %s", command);
+                return;
+            }
+        }
+    }
+
+    // This is the master: load the records, then run the workload on all
+    // of the clients at once.
+    if (records <= 0)
+        throw Exception(HERE, "the YCSB tests need --records > 0");
+    tableId = cluster->createTable("ycsb", numTables);
+    char* value = new char[objectSize];
+    genRandomString(value, objectSize);
+    ycsbLoad(tableId, value, downCast<uint32_t>(objectSize));
+    delete[] value;
+
+    sendCommand("run", "running", 1, numClients-1);
+    uint64_t start = Cycles::rdtsc();
+    int misses = ycsbRun(workload, tableId, histograms);
+    double elapsed = Cycles::toSeconds(Cycles::rdtsc() - start);
+    sendMetrics(count/elapsed, misses);
+
+    // Give the slaves plenty of time: in open-loop runs with more load
+    // than the cluster can handle, they may take much longer than we did.
+    for (int slave = 1; slave < numClients; slave++)
+        waitSlave(slave, "idle", 100.0 + 10*elapsed);
+    ClientMetrics metrics;
+    getMetrics(metrics, numClients);
+    for (int client = 1; client < numClients; client++) {
+        Buffer buffer;
+        MakeKey key(keyVal(client, HISTOGRAMS));
+        waitForObject(controlTable, key.get(), key.length(), NULL, buffer);
+        LatencyHistogram slaveHistograms[YCSB_OP_TYPES];
+        buffer.copy(0, sizeof(slaveHistograms), slaveHistograms);
+        for (int i = 0; i < YCSB_OP_TYPES; i++)
+            histograms[i].merge(slaveHistograms[i]);
+    }
+
+    const char* distribution = keyDistribution.empty()
+            ? workload.keyDistribution : keyDistribution.c_str();
+    printf("# YCSB %s: %s, %s keys.\n", workload.name, workload.description,
+            distribution);
+    printf("# %d clients each issue %d operations ", numClients, count);
+    if (targetOps > 0)
+        printf("open-loop at %.0f ops/sec", targetOps);
+    else
+        printf("closed-loop");
+    printf(" on %d records of %d bytes\n", records, objectSize);
+    printf("# Generated by 'clusterperf.py %s'\n", workload.name);
+    printf("#\n");
+    printf("# throughput: %.1f kops/sec, missing records: %.0f\n",
+            sum(metrics[0])/1e03, sum(metrics[1]));
+    printf("#\n");
+    printf("# operation        count  avg(us)  p50(us)  p90(us)  p99(us)  "
+           "p999(us)  max(us)\n");
+    printf("#-----------------------------------------------------------"
+           "--------------------\n");
+    for (int i = 0; i < YCSB_OP_TYPES; i++) {
+        LatencyHistogram& h = histograms[i];
+        if (h.count == 0)
+            continue;
+        printf("# %-15s %7lu %8.1f %8.1f %8.1f %8.1f %9.1f %8.1f\n",
+                ycsbOpNames[i], h.count,
+                static_cast<double>(h.totalNs)/static_cast<double>(h.count)
+                /1e03,
+                static_cast<double>(h.percentile(.5))/1e03,
+                static_cast<double>(h.percentile(.9))/1e03,
+                static_cast<double>(h.percentile(.99))/1e03,
+                static_cast<double>(h.percentile(.999))/1e03,
+                static_cast<double>(h.maxNs)/1e03);
+    }
+    printf("#\n");
+    printf("# Latency histograms: each line gives an operation, the start\n"
+           "# of a latency bucket, and the fraction of that operation's\n"
+           "# latencies that fell in the bucket.\n");
+    printf("#\n");
+    printf("# operation  latency(us)  fraction\n");
+    printf("#---------------------------------\n");
+    for (int i = 0; i < YCSB_OP_TYPES; i++) {
+        LatencyHistogram& h = histograms[i];
+        for (int b = 0; b < LatencyHistogram::NUM_BUCKETS; b++) {
+            if (h.buckets[b] == 0)
+                continue;
+            printf("%-15s %10.1f  %8.6f\n", ycsbOpNames[i],
+                    static_cast<double>(LatencyHistogram::bucketStart(b))
+                    /1e03,
+                    static_cast<double>(h.buckets[b])
+                    /static_cast<double>(h.count));
+        }
+    }
+    fflush(stdout);
+    sendCommand("done", "done", 1, numClients-1);
+}
+
 //----------------------------------------------------------------------
 // Test functions start here
 //----------------------------------------------------------------------
@@ -918,6 +1563,7 @@ basic()
         cluster->write(dataTable, key, keyLength,
                 input.getRange(0, size), size);
         Buffer output;
+        resetServerLatency(dataTable, key, keyLength);
         double t = timeRead(dataTable, key, keyLength, 100, output);
         checkBuffer(&output, size, dataTable, key, keyLength);
 
@@ -925,6 +1571,7 @@ basic()
         snprintf(description, sizeof(description),
                 "read single %sB object with %uB key", ids[i], keyLength);
         printTime(name, t, description);
+        printServerLatency(name, WireFormat::READ, dataTable, key, keyLength);
         snprintf(name, sizeof(name), "basic.readBw%s", ids[i]);
         snprintf(description, sizeof(description),
                 "bandwidth reading %sB object with %uB key", ids[i], keyLength);
@@ -937,6 +1584,7 @@ basic()
         cluster->write(dataTable, key, keyLength,
                 input.getRange(0, size), size);
         Buffer output;
+        resetServerLatency(dataTable, key, keyLength);
         double t = timeWrite(dataTable, key, keyLength,
                 input.getRange(0, size), size, 100);
         // Make sure the object was properly written.
@@ -947,6 +1595,7 @@ basic()
         snprintf(description, sizeof(description),
                 "write single %sB object with %uB key", ids[i], keyLength);
         printTime(name, t, description);
+        printServerLatency(name, WireFormat::WRITE, dataTable, key, keyLength);
         snprintf(name, sizeof(name), "basic.writeBw%s", ids[i]);
         snprintf(description, sizeof(description),
                 "bandwidth writing %sB object with %uB key", ids[i], keyLength);
@@ -1635,6 +2284,277 @@ readLoaded()
     sendCommand("done", "done", 1, numClients-1);
 }
 
+/**
+ * Print the 50th, 90th, 99th, and 99.9th percentiles of a collection of
+ * latencies, one per line.
+ *
+ * \param name
+ *      Symbolic name for the measurements; each line adds a suffix
+ *      such as ".p50".
+ * \param ticks
+ *      Latencies in Cycles::rdtsc ticks; sorted by this function.
+ * \param description
+ *      Human-readable explanation of the measurements.
+ */
+static void
+printPercentiles(const char* name, std::vector<uint64_t>& ticks,
+        const char* description)
+{
+    if (ticks.empty())
+        return;
+    std::sort(ticks.begin(), ticks.end());
+    const char* suffixes[] = {"p50", "p90", "p99", "p999"};
+    double fractions[] = {.5, .9, .99, .999};
+    for (int i = 0; i < 4; i++) {
+        char fullName[100], fullDescription[200];
+        snprintf(fullName, sizeof(fullName), "%s.%s", name, suffixes[i]);
+        snprintf(fullDescription, sizeof(fullDescription), "%s (%s)",
+                description, suffixes[i]);
+        size_t index = static_cast<size_t>(fractions[i] *
+                static_cast<double>(ticks.size()));
+        if (index >= ticks.size())
+            index = ticks.size() - 1;
+        printTime(fullName, Cycles::toSeconds(ticks[index]), fullDescription);
+    }
+}
+
+// Measure the latency of reads from a master while that master migrates a
+// large tablet to another master. The migration's requests and the reads
+// compete for the master's worker threads, so this shows how well the
+// master keeps client reads moving during background work. Requires at
+// least 2 masters.
+void
+readDuringMigration()
+{
+    if (clientIndex != 0)
+        return;
+
+    const char* key = "123456789012345678901234567890";
+    uint16_t keyLength = downCast<uint16_t>(strlen(key));
+    int size = objectSize;
+    if (size < 0)
+        size = 100;
+    Buffer input, value;
+    fillBuffer(input, size, dataTable, key, keyLength);
+    cluster->write(dataTable, key, keyLength, input.getRange(0, size), size);
+    uint64_t source = cluster->testingGetServerId(dataTable, key, keyLength);
+
+    // Tables are spread across masters round-robin, so create tables until
+    // one lands on the same master as the object being read (that's the
+    // one to migrate) and one lands somewhere else (that's where it goes).
+    uint64_t migrateTable = ~0UL;
+    uint64_t destination = source;
+    for (int i = 0; (migrateTable == ~0UL) || (destination == source); i++) {
+        if (i >= 20) {
+            printf("readDuringMigration requires at least 2 masters\n");
+            return;
+        }
+        char tableName[20];
+        snprintf(tableName, sizeof(tableName), "migrate%d", i);
+        uint64_t table = cluster->createTable(tableName);
+        uint64_t server = cluster->testingGetServerId(table, "0", 1);
+        if (server == source) {
+            if (migrateTable == ~0UL)
+                migrateTable = table;
+        } else {
+            destination = server;
+        }
+    }
+    const int numObjects = 200000;
+    for (int i = 0; i < numObjects; i++) {
+        MakeKey objectKey(i);
+        cluster->write(migrateTable, objectKey.get(), objectKey.length(),
+                input.getRange(0, size), size);
+    }
+
+    // Measure reads with and without the migration running.
+    std::vector<uint64_t> before, during;
+    for (int i = 0; i < count; i++) {
+        uint64_t start = Cycles::rdtsc();
+        cluster->read(dataTable, key, keyLength, &value);
+        before.push_back(Cycles::rdtsc() - start);
+    }
+    uint64_t migrationStart = Cycles::rdtsc();
+    MigrateTabletRpc migrate(cluster, migrateTable, 0, ~0UL,
+            ServerId(destination));
+    while (!migrate.isReady()) {
+        uint64_t start = Cycles::rdtsc();
+        cluster->read(dataTable, key, keyLength, &value);
+        during.push_back(Cycles::rdtsc() - start);
+    }
+    migrate.wait();
+    double migrationTime = Cycles::toSeconds(Cycles::rdtsc() -
+            migrationStart);
+    checkBuffer(&value, size, dataTable, key, keyLength);
+
+    printPercentiles("readBeforeMigration", before,
+            "read latency, no migration");
+    printPercentiles("readDuringMigration", during,
+            "read latency during migration");
+    printTime("migrationTime", migrationTime, "time to migrate tablet");
+    printRate("migrationReadRate",
+            static_cast<double>(during.size())/migrationTime,
+            "reads/sec during migration");
+}
+
+// This benchmark measures how read latency grows with the load offered to
+// a server. A single client reads one object at a series of average rates.
+// Reads arrive open-loop (at exponentially distributed intervals): each
+// read is issued at its scheduled time whether or not earlier reads have
+// finished, and its latency is measured from that time, so queueing
+// anywhere along the way shows up in the results.
+void
+readVsLoad()
+{
+    if (clientIndex != 0)
+        return;
+
+    const char* key = "123456789012345678901234567890";
+    uint16_t keyLength = downCast<uint16_t>(strlen(key));
+    int size = objectSize;
+    if (size < 0)
+        size = 100;
+    Buffer input, value;
+    fillBuffer(input, size, dataTable, key, keyLength);
+    cluster->write(dataTable, key, keyLength, input.getRange(0, size), size);
+    cluster->read(dataTable, key, keyLength, &value);
+    checkBuffer(&value, size, dataTable, key, keyLength);
+    for (int i = 0; i < warmupCount; i++) {
+        cluster->read(dataTable, key, keyLength, &value);
+    }
+
+    printf("# RAMCloud read latency as a function of offered load (1 client\n"
+           "# reading a single %d-byte object with %d-byte key at\n"
+           "# exponentially distributed intervals).\n", size, keyLength);
+    printf("# Generated by 'clusterperf.py readVsLoad'\n");
+    printf("#\n");
+    printf("# offered(kreads/sec)  achieved(kreads/sec)  median(us)  "
+           "p99(us)\n");
+    printf("#---------------------------------------------------------"
+           "------\n");
+
+    // Reads that come due while this many are already outstanding wait
+    // for one of them to finish.
+    const int maxOutstanding = 64;
+    double loads[] = {10e03, 20e03, 50e03, 100e03, 150e03, 200e03, 300e03,
+                      400e03};
+    foreach (double load, loads) {
+        Tub<ReadRpc> rpcs[maxOutstanding];
+        Buffer values[maxOutstanding];
+        uint64_t issueTimes[maxOutstanding];
+        std::vector<uint64_t> latencies;
+        double meanGap = static_cast<double>(Cycles::fromSeconds(1.0/load));
+        uint64_t start = Cycles::rdtsc();
+        uint64_t nextArrival = start;
+        int issued = 0;
+        while (latencies.size() < static_cast<size_t>(count)) {
+            if ((issued < count) && (Cycles::rdtsc() >= nextArrival)) {
+                for (int i = 0; i < maxOutstanding; i++) {
+                    if (rpcs[i])
+                        continue;
+                    rpcs[i].construct(cluster, dataTable, key, keyLength,
+                            &values[i]);
+                    issueTimes[i] = nextArrival;
+                    issued++;
+                    double uniform = static_cast<double>(
+                            generateRandom() % 1000000 + 1) / 1e06;
+                    nextArrival += static_cast<uint64_t>(
+                            -log(uniform) * meanGap);
+                    break;
+                }
+            }
+            context.dispatch->poll();
+            for (int i = 0; i < maxOutstanding; i++) {
+                if (rpcs[i] && rpcs[i]->isReady()) {
+                    rpcs[i]->wait();
+                    latencies.push_back(Cycles::rdtsc() - issueTimes[i]);
+                    rpcs[i].destroy();
+                }
+            }
+        }
+        double elapsed = Cycles::toSeconds(Cycles::rdtsc() - start);
+        checkBuffer(&values[0], size, dataTable, key, keyLength);
+
+        std::sort(latencies.begin(), latencies.end());
+        double median = Cycles::toSeconds(latencies[latencies.size()/2]);
+        double p99 = Cycles::toSeconds(latencies[latencies.size()*99/100]);
+        printf("%10.0f            %10.1f         %8.1f   %8.1f\n",
+                load/1e03, count/(elapsed*1e03), median*1e06, p99*1e06);
+    }
+}
+
+// Main program for each of the threads in readVsThreads: reads a single
+// object through a shared RamCloud object until told to stop.
+static void
+readVsThreadsWorker(RamCloud* client, const char* key, uint16_t keyLength,
+        std::atomic<bool>* stop, std::atomic<uint64_t>* reads)
+{
+    Buffer value;
+    uint64_t count = 0;
+    while (!*stop) {
+        client->read(dataTable, key, keyLength, &value);
+        count++;
+    }
+    *reads += count;
+}
+
+// This benchmark measures the aggregate read throughput of a single client
+// process as the number of threads sharing one multi-threaded RamCloud
+// object grows. Each thread reads a single object in a tight loop.
+void
+readVsThreads()
+{
+    if (clientIndex != 0)
+        return;
+
+    const char* key = "123456789012345678901234567890";
+    uint16_t keyLength = downCast<uint16_t>(strlen(key));
+    int size = objectSize;
+    if (size < 0)
+        size = 100;
+    Buffer input, value;
+    fillBuffer(input, size, dataTable, key, keyLength);
+    cluster->write(dataTable, key, keyLength, input.getRange(0, size), size);
+
+    RamCloud client(coordinatorLocator.c_str(), true);
+    client.read(dataTable, key, keyLength, &value);
+    checkBuffer(&value, size, dataTable, key, keyLength);
+    for (int i = 0; i < warmupCount; i++) {
+        client.read(dataTable, key, keyLength, &value);
+    }
+
+    printf("# RAMCloud read throughput as a function of the number of\n"
+           "# threads sharing one client (each thread reads a single\n"
+           "# %d-byte object with %d-byte key in a loop).\n",
+           size, keyLength);
+    printf("# Generated by 'clusterperf.py readVsThreads'\n");
+    printf("#\n");
+    printf("# threads   kreads/sec   avg latency(us)\n");
+    printf("#---------------------------------------\n");
+
+    int threadCounts[] = {1, 2, 4, 8, 16, 32, 64};
+    foreach (int numThreads, threadCounts) {
+        std::atomic<bool> stop(false);
+        std::atomic<uint64_t> reads(0);
+        std::vector<std::thread*> threads;
+        uint64_t start = Cycles::rdtsc();
+        for (int i = 0; i < numThreads; i++) {
+            threads.push_back(new std::thread(readVsThreadsWorker, &client,
+                    key, keyLength, &stop, &reads));
+        }
+        usleep(1000000);
+        stop = true;
+        foreach (std::thread* thread, threads) {
+            thread->join();
+            delete thread;
+        }
+        double elapsed = Cycles::toSeconds(Cycles::rdtsc() - start);
+        double rate = static_cast<double>(reads.load())/elapsed;
+        printf("%6d      %9.1f      %8.2f\n", numThreads, rate/1e03,
+                1e06*numThreads/rate);
+    }
+}
+
 // Read an object that doesn't exist. This excercises some exception paths that
 // are supposed to be fast. This comes up, for example, in workloads in which a
 // RAMCloud is used as a cache with frequent cache misses.
@@ -1884,6 +2804,112 @@ writeVaryingKeyLength()
     }
 }
 
+// Used by transactionVsRetry to update a group of objects with the
+// client-side approach: write each object with RejectRules that check the
+// version read earlier, and if any write is rejected, restore the objects
+// already written and report failure.
+static bool
+conditionalMultiUpdate(MultiReadObject* reads, int numObjects,
+                       const char* value, uint32_t valueLength)
+{
+    for (int i = 0; i < numObjects; i++) {
+        RejectRules rules;
+        memset(&rules, 0, sizeof(rules));
+        rules.givenVersion = reads[i].version;
+        rules.versionNeGiven = true;
+        try {
+            cluster->write(reads[i].tableId, reads[i].key,
+                           reads[i].keyLength, value, valueLength, &rules);
+        } catch (RejectRulesException& e) {
+            for (int j = 0; j < i; j++) {
+                Buffer* old = reads[j].value->get();
+                cluster->write(reads[j].tableId, reads[j].key,
+                               reads[j].keyLength,
+                               old->getRange(0, old->getTotalLength()),
+                               old->getTotalLength());
+            }
+            return false;
+        }
+    }
+    return true;
+}
+
+// This benchmark compares two ways for a single client to atomically
+// read-modify-write a group of objects on one master: a transaction RPC,
+// and the client-side approach of writing each object with version-checking
+// RejectRules and rolling back on conflict. Both approaches first read the
+// objects with multiRead.
+void
+transactionVsRetry()
+{
+    if (clientIndex > 0)
+        return;
+
+    const int maxObjects = 16;
+    const uint16_t keyLength = 30;
+    const uint32_t valueLength = 100;
+    const double seconds = 1.0;
+    char keys[maxObjects][keyLength];
+    char value[valueLength];
+    memset(value, 'x', valueLength);
+    for (int i = 0; i < maxObjects; i++) {
+        genRandomString(keys[i], keyLength);
+        cluster->write(dataTable, keys[i], keyLength, value, valueLength);
+    }
+
+    printf("# Atomic updates of several %u B objects with %u B keys on one\n"
+           "# master: reading them with multiRead and then either writing\n"
+           "# them in one transaction or writing each with version checks.\n"
+           "# Generated by 'clusterperf.py transactionVsRetry'\n#\n"
+           "# Num Objs    Transaction (updates/s)    "
+           "Conditional writes (updates/s)\n"
+           "#--------------------------------------------------------"
+           "--------------------\n", valueLength, keyLength);
+
+    for (int numObjects = 1; numObjects <= maxObjects; numObjects *= 2) {
+        MultiReadObject reads[numObjects];
+        MultiReadObject* readPtrs[numObjects];
+        Tub<Buffer> values[numObjects];
+        TransactionObject writes[numObjects];
+        TransactionObject* writePtrs[numObjects];
+        RejectRules rules[numObjects];
+        for (int i = 0; i < numObjects; i++) {
+            reads[i] = MultiReadObject(dataTable, keys[i], keyLength,
+                                       &values[i]);
+            readPtrs[i] = &reads[i];
+            writePtrs[i] = &writes[i];
+        }
+
+        uint64_t transactions = 0;
+        uint64_t stop = Cycles::rdtsc() + Cycles::fromSeconds(seconds);
+        while (Cycles::rdtsc() < stop) {
+            cluster->multiRead(readPtrs, numObjects);
+            for (int i = 0; i < numObjects; i++) {
+                memset(&rules[i], 0, sizeof(rules[i]));
+                rules[i].givenVersion = reads[i].version;
+                rules[i].versionNeGiven = true;
+                writes[i] = TransactionObject(
+                        WireFormat::Transaction::WRITE, dataTable, keys[i],
+                        keyLength, &rules[i], value, valueLength);
+            }
+            if (cluster->transaction(writePtrs, numObjects))
+                transactions++;
+        }
+
+        uint64_t updates = 0;
+        stop = Cycles::rdtsc() + Cycles::fromSeconds(seconds);
+        while (Cycles::rdtsc() < stop) {
+            cluster->multiRead(readPtrs, numObjects);
+            if (conditionalMultiUpdate(reads, numObjects, value, valueLength))
+                updates++;
+        }
+
+        printf("%10d %26.0f %33.0f\n", numObjects,
+               static_cast<double>(transactions) / seconds,
+               static_cast<double>(updates) / seconds);
+    }
+}
+
 // This benchmark measures the latency and server throughput for write
 // when some data is written asynchronously and then some smaller value
 // is written synchronously.
@@ -1953,6 +2979,71 @@ writeAsyncSync()
     delete garbage;
 }
 
+// The YCSB core workloads.  Each client issues "count" operations of the
+// given mix on a table of "records" objects of "size" bytes, spread over
+// "numTables" masters.
+static YcsbWorkload ycsbWorkloads[] = {
+    // name     description
+    //          read   update insert scan   readModifyWrite  keys
+    {"ycsbA", "update heavy (50% reads, 50% updates)",
+             {0.50,  0.50,  0.0,   0.0,   0.0},            "zipfian"},
+    {"ycsbB", "read mostly (95% reads, 5% updates)",
+             {0.95,  0.05,  0.0,   0.0,   0.0},            "zipfian"},
+    {"ycsbC", "read only",
+             {1.0,   0.0,   0.0,   0.0,   0.0},            "zipfian"},
+    {"ycsbD", "read latest (95% reads, 5% inserts)",
+             {0.95,  0.0,   0.05,  0.0,   0.0},            "latest"},
+    {"ycsbE", "short ranges (95% scans, 5% inserts)",
+             {0.0,   0.0,   0.05,  0.95,  0.0},            "zipfian"},
+    {"ycsbF", "read-modify-write (50% reads, 50% read-modify-writes)",
+             {0.50,  0.0,   0.0,   0.0,   0.50},           "zipfian"},
+};
+
+// YCSB workload A: 50% reads and 50% updates of Zipfian-chosen records.
+void
+ycsbA()
+{
+    ycsb(ycsbWorkloads[0]);
+}
+
+// YCSB workload B: 95% reads and 5% updates of Zipfian-chosen records.
+void
+ycsbB()
+{
+    ycsb(ycsbWorkloads[1]);
+}
+
+// YCSB workload C: reads of Zipfian-chosen records.
+void
+ycsbC()
+{
+    ycsb(ycsbWorkloads[2]);
+}
+
+// YCSB workload D: 95% reads, favoring recently inserted records, and 5%
+// inserts.
+void
+ycsbD()
+{
+    ycsb(ycsbWorkloads[3]);
+}
+
+// YCSB workload E: 95% short scans starting at Zipfian-chosen records and
+// 5% inserts.
+void
+ycsbE()
+{
+    ycsb(ycsbWorkloads[4]);
+}
+
+// YCSB workload F: 50% reads and 50% read-modify-writes of Zipfian-chosen
+// records.
+void
+ycsbF()
+{
+    ycsb(ycsbWorkloads[5]);
+}
+
 // The following struct and table define each performance test in terms of
 // a string name and a function that implements the test.
 struct TestInfo {
@@ -1972,12 +3063,22 @@ TestInfo tests[] = {
     {"netBandwidth", netBandwidth},
     {"readAllToAll", readAllToAll},
     {"readDist", readDist},
+    {"readDuringMigration", readDuringMigration},
     {"readLoaded", readLoaded},
     {"readNotFound", readNotFound},
     {"readRandom", readRandom},
     {"readVaryingKeyLength", readVaryingKeyLength},
+    {"readVsLoad", readVsLoad},
+    {"readVsThreads", readVsThreads},
     {"writeVaryingKeyLength", writeVaryingKeyLength},
+    {"transactionVsRetry", transactionVsRetry},
     {"writeAsyncSync", writeAsyncSync},
+    {"ycsbA", ycsbA},
+    {"ycsbB", ycsbB},
+    {"ycsbC", ycsbC},
+    {"ycsbD", ycsbD},
+    {"ycsbE", ycsbE},
+    {"ycsbF", ycsbF},
 };
 
 int
@@ -1986,7 +3087,7 @@ try
 {
     // Parse command-line options.
     vector<string> testNames;
-    string coordinatorLocator, logFile;
+    string logFile;
     string logLevel("NOTICE");
     po::options_description desc(
             "Usage: ClusterPerf [options] testName testName ...\n\n"
@@ -2007,12 +3108,25 @@ try
                 "Print log messages only at this severity level or higher "
                 "(ERROR, WARNING, NOTICE, DEBUG)")
         ("help,h", "Print this help message")
+        ("keyDistribution", po::value<string>(&keyDistribution),
+                "Distribution used by the YCSB tests to choose keys "
+                "(uniform, zipfian, or latest); overrides the default "
+                "for each workload")
         ("numClients", po::value<int>(&numClients)->default_value(1),
                 "Total number of clients running")
         ("size,s", po::value<int>(&objectSize)->default_value(100),
                 "Size of objects (in bytes) to use for test")
         ("numTables", po::value<int>(&numTables)->default_value(10),
                 "Number of tables to use for test")
+        ("records", po::value<int>(&records)->default_value(100000),
+                "Number of objects loaded by the YCSB tests")
+        ("serverLatency",
+                po::value<bool>(&serverLatency)->default_value(false),
+                "Also print the latency of each stage of an RPC on the "
+                "server, for tests that support this")
+        ("targetOps", po::value<double>(&targetOps)->default_value(0),
+                "If nonzero, each client in the YCSB tests issues "
+                "operations open-loop at this average rate (ops/sec)")
         ("testName", po::value<vector<string>>(&testNames),
                 "Name(s) of test(s) to run")
         ("warmup", po::value<int>(&warmupCount)->default_value(100),
@@ -0,0 +1,142 @@
+/* Copyright (c) 2013 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <algorithm>
+#include <fstream>
+
+#include "CpuAffinity.h"
+#include "ShortMacros.h"
+
+namespace RAMCloud {
+namespace CpuAffinity {
+
+string topologyDir = "/sys/devices/system/cpu";
+
+/**
+ * Select the cores for one group of threads, skipping any core that
+ * another group has already claimed or whose hyperthread sibling has been
+ * claimed.
+ *
+ * \param requested
+ *      Cores the user asked for, in the order threads should be assigned
+ *      to them.
+ * \param used
+ *      Cores claimed by previous calls (including their siblings); the
+ *      cores selected here and their siblings are added to it.
+ * \return
+ *      The subset of \a requested that the group may use, in the same order.
+ */
+std::vector<uint32_t>
+assign(const std::vector<uint32_t>& requested, std::vector<uint32_t>* used)
+{
+    std::vector<uint32_t> result;
+    foreach (uint32_t cpu, requested) {
+        if (std::find(used->begin(), used->end(), cpu) != used->end()) {
+            LOG(WARNING, "Not using core %u: it (or its hyperthread sibling) "
+                    "is already assigned to another thread", cpu);
+            continue;
+        }
+        result.push_back(cpu);
+        foreach (uint32_t sibling, getSiblings(cpu))
+            used->push_back(sibling);
+    }
+    return result;
+}
+
+/**
+ * Return all of the hyperthreads that share a physical core with a
+ * given CPU (including the CPU itself).  If the topology for the CPU
+ * isn't available (e.g., no sysfs), the CPU is assumed to have no siblings.
+ */
+std::vector<uint32_t>
+getSiblings(uint32_t cpu)
+{
+    string path = format("%s/cpu%u/topology/thread_siblings_list",
+            topologyDir.c_str(), cpu);
+    std::ifstream in(path.c_str());
+    string line;
+    if (in && std::getline(in, line)) {
+        try {
+            std::vector<uint32_t> siblings = parse(line);
+            if (std::find(siblings.begin(), siblings.end(), cpu) !=
+                    siblings.end()) {
+                return siblings;
+            }
+        } catch (Exception& e) {
+            LOG(WARNING, "Couldn't parse %s: %s", path.c_str(), e.what());
+        }
+    }
+    return std::vector<uint32_t>(1, cpu);
+}
+
+/**
+ * Parse one core number at the start of a string.
+ *
+ * \param cpuList
+ *      The full list being parsed (for error messages).
+ * \param p
+ *      Points to the number to parse; advanced past it on return.
+ */
+static uint32_t
+parseCpu(const string& cpuList, const char** p)
+{
+    if (!isdigit(**p)) {
+        throw Exception(HERE, format("invalid CPU list '%s'",
+                cpuList.c_str()));
+    }
+    char* end;
+    unsigned long cpu = strtoul(*p, &end, 10);
+    *p = end;
+    return downCast<uint32_t>(cpu);
+}
+
+/**
+ * Parse a list of cores in the format used by taskset and the kernel,
+ * such as "0-3,6".
+ *
+ * \param cpuList
+ *      Comma-separated list of core numbers and inclusive ranges of
+ *      core numbers.  An empty list is allowed.
+ * \return
+ *      The cores in \a cpuList, in the order given.
+ * \throw Exception
+ *      \a cpuList is malformed.
+ */
+std::vector<uint32_t>
+parse(const string& cpuList)
+{
+    std::vector<uint32_t> result;
+    const char* p = cpuList.c_str();
+    while (*p != '\0' && *p != '\n') {
+        uint32_t first = parseCpu(cpuList, &p);
+        uint32_t last = first;
+        if (*p == '-') {
+            p++;
+            last = parseCpu(cpuList, &p);
+        }
+        if ((last < first) || (*p != ',' && *p != '\0' && *p != '\n')) {
+            throw Exception(HERE, format("invalid CPU list '%s'",
+                    cpuList.c_str()));
+        }
+        for (uint32_t cpu = first; cpu <= last; cpu++)
+            result.push_back(cpu);
+        if (*p == ',')
+            p++;
+    }
+    return result;
+}
+
+} // end CpuAffinity
+} // end RAMCloud
@@ -0,0 +1,48 @@
+/* Copyright (c) 2013 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef RAMCLOUD_CPUAFFINITY_H
+#define RAMCLOUD_CPUAFFINITY_H
+
+#include <vector>
+
+#include "Common.h"
+
+namespace RAMCloud {
+
+/**
+ * Utilities for deciding which cores a server's threads should run on.
+ * A server's dispatch thread, worker threads, and log cleaner threads
+ * each get their own set of cores; since hyperthreads on the same physical
+ * core compete for its execution units and L1/L2 caches, no two of these
+ * threads are ever given sibling hyperthreads.
+ */
+namespace CpuAffinity {
+
+std::vector<uint32_t> assign(const std::vector<uint32_t>& requested,
+        std::vector<uint32_t>* used);
+std::vector<uint32_t> getSiblings(uint32_t cpu);
+std::vector<uint32_t> parse(const string& cpuList);
+
+/// Directory containing the kernel's description of each CPU (a
+/// "cpu<N>/topology/thread_siblings_list" file for each CPU N).
+/// Only changed during testing.
+extern string topologyDir;
+
+} // end CpuAffinity
+
+} // end RAMCloud
+
+#endif  // RAMCLOUD_CPUAFFINITY_H
@@ -0,0 +1,128 @@
+/* Copyright (c) 2013 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <sys/stat.h>
+#include "TestUtil.h"
+#include "CpuAffinity.h"
+
+namespace RAMCloud {
+
+using namespace CpuAffinity; // NOLINT
+
+static string
+toString(const std::vector<uint32_t>& cpus)
+{
+    string result;
+    foreach (uint32_t cpu, cpus) {
+        if (!result.empty())
+            result.append(" ");
+        result.append(format("%u", cpu));
+    }
+    return result;
+}
+
+class CpuAffinityTest : public ::testing::Test {
+  public:
+    string savedTopologyDir;
+    char dir[32];
+
+    CpuAffinityTest()
+        : savedTopologyDir(topologyDir)
+        , dir()
+    {
+        // Fake topology: cpus 0 and 2 share a core, as do 1 and 3.
+        strncpy(dir, "/tmp/ramcloud-cpu-XXXXXX", sizeof(dir));
+        EXPECT_TRUE(mkdtemp(dir) != NULL);
+        topologyDir = dir;
+        addCpu(0, "0,2");
+        addCpu(1, "1,3");
+        addCpu(2, "0,2");
+        addCpu(3, "1,3");
+    }
+
+    ~CpuAffinityTest()
+    {
+        topologyDir = savedTopologyDir;
+        int r = system(format("rm -rf %s", dir).c_str());
+        EXPECT_EQ(0, r);
+    }
+
+    void
+    addCpu(uint32_t cpu, const char* siblings)
+    {
+        string path = format("%s/cpu%u", dir, cpu);
+        mkdir(path.c_str(), 0700);
+        path.append("/topology");
+        mkdir(path.c_str(), 0700);
+        path.append("/thread_siblings_list");
+        FILE* f = fopen(path.c_str(), "w");
+        ASSERT_TRUE(f != NULL);
+        fprintf(f, "%s\n", siblings);
+        fclose(f);
+    }
+
+    DISALLOW_COPY_AND_ASSIGN(CpuAffinityTest);
+};
+
+TEST_F(CpuAffinityTest, assign) {
+    TestLog::Enable _;
+    std::vector<uint32_t> used;
+    EXPECT_EQ("0", toString(assign(parse("0"), &used)));
+    EXPECT_EQ("0 2", toString(used));
+
+    // Core 2 is core 0's sibling, and core 3 is core 1's sibling.
+    EXPECT_EQ("1 7", toString(assign(parse("1-3,7"), &used)));
+    EXPECT_EQ("0 2 1 3 7", toString(used));
+    EXPECT_EQ("assign: Not using core 2: it (or its hyperthread sibling) "
+              "is already assigned to another thread | "
+              "assign: Not using core 3: it (or its hyperthread sibling) "
+              "is already assigned to another thread", TestLog::get());
+
+    EXPECT_EQ("", toString(assign(parse(""), &used)));
+}
+
+TEST_F(CpuAffinityTest, getSiblings) {
+    EXPECT_EQ("1 3", toString(getSiblings(1)));
+    EXPECT_EQ("0 2", toString(getSiblings(2)));
+
+    // No topology information.
+    EXPECT_EQ("5", toString(getSiblings(5)));
+
+    // Garbage in the file.
+    TestLog::Enable _;
+    addCpu(6, "bogus");
+    EXPECT_EQ("6", toString(getSiblings(6)));
+    EXPECT_TRUE(TestUtil::matchesPosixRegex("invalid CPU list 'bogus'",
+            TestLog::get()));
+
+    // The file doesn't mention the CPU itself.
+    addCpu(7, "4,5");
+    EXPECT_EQ("7", toString(getSiblings(7)));
+}
+
+TEST_F(CpuAffinityTest, parse) {
+    EXPECT_EQ("", toString(parse("")));
+    EXPECT_EQ("4", toString(parse("4")));
+    EXPECT_EQ("0 1 2 3 6", toString(parse("0-3,6")));
+    EXPECT_EQ("6 2 3", toString(parse("6,2-3\n")));
+    EXPECT_THROW(parse("x"), Exception);
+    EXPECT_THROW(parse("-1"), Exception);
+    EXPECT_THROW(parse("3-1"), Exception);
+    EXPECT_THROW(parse("1-"), Exception);
+    EXPECT_THROW(parse("1;2"), Exception);
+    EXPECT_THROW(parse(" 1"), Exception);
+}
+
+}  // namespace RAMCloud
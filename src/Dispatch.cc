@@ -68,7 +68,11 @@ Dispatch::Dispatch(bool hasDedicatedThread)
     , readyFd(-1)
     , readyEvents(0)
     , fileInvocationSerial(0)
-    , timers()
+    , timerWheel()
+    , timerWheelCounts()
+    , nearTimers()
+    , wheelTick(currentTime >> TIMER_TICK_SHIFT)
+    , timerCount(0)
     , earliestTriggerTime(0)
     , ownerId(ThreadId::get())
     , mutex("Dispatch::mutex")
@@ -118,11 +122,20 @@ Dispatch::~Dispatch()
         }
     }
     readyFd = -1;
-    while (timers.size() > 0) {
-        Timer* t = timers.back();
+    while (!nearTimers.empty()) {
+        Timer* t = &nearTimers.front();
         t->stop();
         t->owner = NULL;
     }
+    for (int level = 0; level < TIMER_WHEEL_LEVELS; level++) {
+        for (uint32_t i = 0; i < TIMER_WHEEL_SLOTS; i++) {
+            while (!timerWheel[level][i].empty()) {
+                Timer* t = &timerWheel[level][i].front();
+                t->stop();
+                t->owner = NULL;
+            }
+        }
+    }
     cleanProfiler();
 }
 
@@ -220,62 +233,181 @@ Dispatch::poll()
         }
     }
     if (currentTime >= earliestTriggerTime) {
-        // Looks like a timer may have triggered. Check all the timers and
-        // invoke any that have triggered.
-        //
-        // There are two goals here:
-        // * Invoke every timer that has triggered.
-        // * Don't invoke any timer more than once (in particular, if the
-        //   handler for a timer reschedules the timer in the past, don't
-        //   run it a second time; otherwise an infinite loop could result).
-        //
-        // The code meets these goals, except that if the handler for one
-        // timer A stops another timer B, this could cause a third timer
-        // C to move into A's slot in the timers vector, and this could
-        // potentially cause C to be missed in this pass (if we have
-        // already passed that slot).  However, C will be invoked the
-        // next time this method is called.
-        uint32_t end = downCast<uint32_t>(timers.size());
-        for (uint32_t i = 0; i < end; ) {
-            Timer* timer = timers[i];
-            if (timer->triggerTime <= currentTime) {
-                timer->stop();
-                timer->handleTimerEvent();
-
-                // Since we just removed the timer that triggered, reduce
-                // the endpoint of the loop to reflect this (this prevents
-                // the timer from being invoked a second time if its handler
-                // reschedules it; the rescheduled time or would end up at
-                // the end of the timers vector).  However, it's possible
-                // that the timer handler also deleted other timers, so
-                // shrink the endpoint even more if needed to keep it in
-                // range.
-                end--;
-                if (timers.size() < end)
-                    end = downCast<uint32_t>(timers.size());
-            } else {
-                // Only increment i if the current timer did not trigger.
-                // If it did trigger, it got removed from the vector and
-                // we need to process the timer that got moved into its
-                // slot.
-                i++;
-            }
+        // Looks like a timer may have triggered.
+        runTimers();
+    }
+}
+
+/**
+ * Invoke every timer whose trigger time has been reached, as of
+ * #currentTime, then recompute #earliestTriggerTime. Timers that are
+ * (re)started by a handler are not invoked again in the same call, even
+ * if their new trigger time has already passed; otherwise an infinite
+ * loop could result.
+ */
+void
+Dispatch::runTimers()
+{
+    // Step the wheel forward to the current tick, moving the timers in
+    // every slot that comes due into nearTimers. Levels with no timers
+    // have nothing to cascade, so jump straight to the next boundary of
+    // the lowest level that has any timers.
+    uint64_t currentTick = currentTime >> TIMER_TICK_SHIFT;
+    while (wheelTick < currentTick) {
+        int level = 0;
+        while ((level < TIMER_WHEEL_LEVELS) && (timerWheelCounts[level] == 0))
+            level++;
+        if (level == TIMER_WHEEL_LEVELS) {
+            wheelTick = currentTick;
+            break;
+        }
+        uint64_t mask = (1ull << (level * TIMER_WHEEL_BITS)) - 1;
+        uint64_t next = (wheelTick | mask) + 1;
+        if (next > currentTick) {
+            wheelTick = currentTick;
+            break;
+        }
+        wheelTick = next;
+        cascadeTimers(wheelTick);
+    }
+
+    // Invoke the timers that are due. Work from a private list, so that
+    // timers started by the handlers (which go into nearTimers or the
+    // wheel) aren't seen again during this pass, and so that a handler
+    // can safely stop or delete any other timer.
+    Timer::TimerList pending;
+    while (!nearTimers.empty()) {
+        Timer* timer = &nearTimers.front();
+        nearTimers.pop_front();
+        pending.push_back(*timer);
+        timer->list = &pending;
+    }
+    while (!pending.empty()) {
+        Timer* timer = &pending.front();
+        pending.pop_front();
+        if (timer->triggerTime <= currentTime) {
+            timer->list = NULL;
+            timerCount--;
+            timer->handleTimerEvent();
+        } else {
+            nearTimers.push_back(*timer);
+            timer->list = &nearTimers;
         }
+    }
+    updateEarliestTriggerTime();
+}
 
-        // Compute a new value for earliestTriggerTime. Can't do this
-        // in the loop above, because one timer handler could delete
-        // another, which can rearrange the list and cause us to miss
-        // a trigger time.
-        earliestTriggerTime = ~(0ull);
-        for (uint32_t i = 0; i < timers.size(); i++) {
-            Timer* timer = timers[i];
-            if (timer->triggerTime < earliestTriggerTime) {
-                earliestTriggerTime = timer->triggerTime;
-            }
+/**
+ * Move the timers in every slot of the timer wheel that comes due at a
+ * given tick down to lower levels of the wheel (or into nearTimers, if
+ * their tick has arrived).
+ *
+ * \param tick
+ *      The new value of #wheelTick.
+ */
+void
+Dispatch::cascadeTimers(uint64_t tick)
+{
+    // Work from the top down, so that timers moved down from a higher
+    // level are picked up if their new slot is also due now.
+    for (int level = TIMER_WHEEL_LEVELS - 1; level >= 0; level--) {
+        int shift = level * TIMER_WHEEL_BITS;
+        if ((tick & ((1ull << shift) - 1)) != 0)
+            continue;
+        Timer::TimerList& slot =
+                timerWheel[level][(tick >> shift) & (TIMER_WHEEL_SLOTS - 1)];
+        while (!slot.empty()) {
+            Timer* timer = &slot.front();
+            removeTimer(timer);
+            addTimer(timer);
         }
     }
 }
 
+/**
+ * Add a timer that isn't currently in any list to the timer wheel, or to
+ * nearTimers if its tick has already been reached. Does not update
+ * #timerCount.
+ *
+ * \param timer
+ *      Timer to add; its triggerTime must already be set.
+ */
+void
+Dispatch::addTimer(Timer* timer)
+{
+    uint64_t tick = timer->triggerTime >> TIMER_TICK_SHIFT;
+    if (tick <= wheelTick) {
+        nearTimers.push_back(*timer);
+        timer->list = &nearTimers;
+        timer->level = -1;
+        return;
+    }
+
+    // Choose the lowest level whose slots can reach the timer's tick
+    // before wrapping around. Timers beyond the end of the wheel are
+    // filed as if they were at the end; they get refiled when that slot
+    // comes due.
+    uint64_t delta = tick - wheelTick;
+    int level = 0;
+    while ((level < TIMER_WHEEL_LEVELS - 1) &&
+            ((delta >> ((level + 1) * TIMER_WHEEL_BITS)) != 0)) {
+        level++;
+    }
+    if ((delta >> (TIMER_WHEEL_LEVELS * TIMER_WHEEL_BITS)) != 0)
+        tick = wheelTick + (1ull << (TIMER_WHEEL_LEVELS * TIMER_WHEEL_BITS))
+                - 1;
+    uint64_t index = (tick >> (level * TIMER_WHEEL_BITS)) &
+            (TIMER_WHEEL_SLOTS - 1);
+    Timer::TimerList& slot = timerWheel[level][index];
+    slot.push_back(*timer);
+    timer->list = &slot;
+    timer->level = level;
+    timerWheelCounts[level]++;
+}
+
+/**
+ * Remove a timer from whichever list it is in. Does not update
+ * #timerCount.
+ *
+ * \param timer
+ *      Timer to remove; must be running.
+ */
+void
+Dispatch::removeTimer(Timer* timer)
+{
+    erase(*timer->list, *timer);
+    if (timer->level >= 0)
+        timerWheelCounts[timer->level]--;
+    timer->list = NULL;
+    timer->level = -1;
+}
+
+/**
+ * Recompute #earliestTriggerTime after timers have run. If any timers are
+ * in nearTimers the earliest of them is used (nothing in the wheel can
+ * trigger sooner); otherwise it is the start of the next tick at which a
+ * slot of the wheel comes due.
+ */
+void
+Dispatch::updateEarliestTriggerTime()
+{
+    earliestTriggerTime = ~0ull;
+    if (!nearTimers.empty()) {
+        foreach (Timer& timer, nearTimers) {
+            if (timer.triggerTime < earliestTriggerTime)
+                earliestTriggerTime = timer.triggerTime;
+        }
+        return;
+    }
+    for (int level = 0; level < TIMER_WHEEL_LEVELS; level++) {
+        if (timerWheelCounts[level] == 0)
+            continue;
+        uint64_t mask = (1ull << (level * TIMER_WHEEL_BITS)) - 1;
+        earliestTriggerTime = ((wheelTick | mask) + 1) << TIMER_TICK_SHIFT;
+        return;
+    }
+}
+
 /**
  * Starts execution time profiling of Dispatch::poll() method. 
  *
@@ -640,7 +772,7 @@ Dispatch::fdIsReady(int fd)
  *      Dispatch object that will manage this timer.
  */
 Dispatch::Timer::Timer(Dispatch& dispatch)
-    : owner(&dispatch), triggerTime(0), slot(-1)
+    : owner(&dispatch), triggerTime(0), listEntries(), list(NULL), level(-1)
 {
 }
 
@@ -654,7 +786,8 @@ Dispatch::Timer::Timer(Dispatch& dispatch)
  *      returned by #Cycles::rdtsc).
  */
 Dispatch::Timer::Timer(Dispatch& dispatch, uint64_t cycles)
-        : owner(&dispatch), triggerTime(0), slot(-1)
+        : owner(&dispatch), triggerTime(0), listEntries(), list(NULL)
+        , level(-1)
 {
     start(cycles);
 }
@@ -682,7 +815,7 @@ Dispatch::Timer::handleTimerEvent()
  */
 bool Dispatch::Timer::isRunning()
 {
-    return slot >= 0;
+    return list != NULL;
 }
 
 /**
@@ -701,11 +834,13 @@ void Dispatch::Timer::start(uint64_t rdtscTime)
     }
     CHECK_LOCK;
 
-    triggerTime = rdtscTime;
-    if (slot < 0) {
-        slot = downCast<unsigned>(owner->timers.size());
-        owner->timers.push_back(this);
+    if (list != NULL) {
+        owner->removeTimer(this);
+    } else {
+        owner->timerCount++;
     }
+    triggerTime = rdtscTime;
+    owner->addTimer(this);
     if (triggerTime < owner->earliestTriggerTime) {
         owner->earliestTriggerTime = triggerTime;
     }
@@ -717,23 +852,17 @@ void Dispatch::Timer::start(uint64_t rdtscTime)
  */
 void Dispatch::Timer::stop()
 {
-    if (slot < 0) {
+    if (list == NULL) {
         return;
     }
     CHECK_LOCK;
 
-    // Remove this Timer from the timers vector by overwriting its slot
-    // with the timer that used to be the last one in the vector.
-    //
-    // Note: this approach using a vector is reentrant.  It is safe
-    // to delete a Timer while executing a timer callback, which means
-    // that Dispatch::poll is in the middle of scanning the list of all
-    // Timers; the worst that will happen is that the Timer that got
-    // moved may not be invoked in the current scan).
-    owner->timers[slot] = owner->timers.back();
-    owner->timers[slot]->slot = slot;
-    owner->timers.pop_back();
-    slot = -1;
+    // The timer knows which list it is in, so this is O(1). It is safe
+    // to stop (or delete) a Timer while executing a timer callback:
+    // Dispatch::runTimers always takes the next timer from the front of
+    // its list, so it never holds a reference to a stopped timer.
+    owner->removeTimer(this);
+    owner->timerCount--;
 }
 
 /**
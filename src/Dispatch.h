@@ -25,6 +25,7 @@
 
 #include "Common.h"
 #include "Atomic.h"
+#include "BoostIntrusive.h"
 #include "ThreadId.h"
 #include "Tub.h"
 #include "SpinLock.h"
@@ -199,15 +200,27 @@ class Dispatch {
 
         /// If the timer is running it will be invoked as soon as #rdtsc
         /// returns a value greater or equal to this. This value is only
-        /// valid if slot >= 0.
+        /// valid if list != NULL.
         uint64_t triggerTime;
 
-        /// If >= 0 this timer is running, and the value contains the
-        /// index of this Timer in Dispatch::timers. <0 means this
-        /// timer is not currently running, and isn't in Dispatch::timers.
-        /// Among other things, this value allows a timer to be deleted
-        /// without having to scan all the entries in timers.
-        int slot;
+        /// Used to link this Timer into one of the lists of timers kept
+        /// by its Dispatch.
+        IntrusiveListHook listEntries;
+
+      public:
+        INTRUSIVE_LIST_TYPEDEF(Timer, listEntries) TimerList;
+
+      PRIVATE:
+        /// The list (a slot of Dispatch::timerWheel, Dispatch::nearTimers,
+        /// or a list private to Dispatch::runTimers) that currently holds
+        /// this timer; NULL means the timer is not running. Among other
+        /// things, this allows a timer to be stopped without searching
+        /// for it.
+        TimerList* list;
+
+        /// Level of Dispatch::timerWheel that holds this timer, or -1 if
+        /// the timer isn't in the wheel.
+        int level;
 
         friend class Dispatch;
         DISALLOW_COPY_AND_ASSIGN(Timer);
@@ -244,6 +257,29 @@ class Dispatch {
     static void epollThreadMain(Dispatch* owner);
     static bool fdIsReady(int fd);
     void cleanProfiler();
+    void addTimer(Timer* timer);
+    void cascadeTimers(uint64_t tick);
+    void removeTimer(Timer* timer);
+    void runTimers();
+    void updateEarliestTriggerTime();
+
+    /// Timers are kept in a hierarchical timer wheel whose slots are
+    /// ticks of 2^TIMER_TICK_SHIFT cycles (about 25us on a 2.5GHz
+    /// machine). Ticks only determine which list a timer lives in; timers
+    /// still fire at their exact trigger times.
+    static const int TIMER_TICK_SHIFT = 16;
+
+    /// log2 of the number of slots in each level of the timer wheel.
+    static const int TIMER_WHEEL_BITS = 8;
+
+    /// Number of slots in each level of the timer wheel.
+    static const uint32_t TIMER_WHEEL_SLOTS = 1 << TIMER_WHEEL_BITS;
+
+    /// Number of levels in the timer wheel. Each slot of level i spans
+    /// TIMER_WHEEL_SLOTS^i ticks; timers further in the future than the
+    /// whole wheel spans (about 2^48 cycles) are parked in the last slot
+    /// of the top level and moved down when that slot comes due.
+    static const int TIMER_WHEEL_LEVELS = 4;
 
     // Keeps track of all of the pollers currently defined.  We don't
     // use an intrusive list here because it isn't reentrant: we need
@@ -284,10 +320,30 @@ class Dispatch {
     // of a File.
     int fileInvocationSerial;
 
-    // Keeps track of all of the timers that are currently active.  We
-    // don't use an intrusive list here because it isn't reentrant: we need
-    // to add/remove elements while the dispatcher is traversing the list.
-    std::vector<Timer*> timers;
+    // Hierarchical timer wheel holding the active timers that will
+    // trigger after the tick #wheelTick. Slot j of level i holds timers
+    // whose tick shares bits above (i + 1) * TIMER_WHEEL_BITS with
+    // wheelTick and has j in bits [i * TIMER_WHEEL_BITS,
+    // (i + 1) * TIMER_WHEEL_BITS). Starting, stopping, and expiring a
+    // timer are all O(1), no matter how many timers are active.
+    Timer::TimerList timerWheel[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SLOTS];
+
+    // Number of timers in each level of timerWheel; lets runTimers skip
+    // over empty parts of the wheel quickly.
+    uint32_t timerWheelCounts[TIMER_WHEEL_LEVELS];
+
+    // Active timers whose tick is at or before wheelTick. These are the
+    // only timers that might trigger before the tick after wheelTick, so
+    // each call to runTimers checks all of them.
+    Timer::TimerList nearTimers;
+
+    // All timers in ticks before this one have been moved out of
+    // timerWheel (either to nearTimers or triggered). Follows
+    // currentTime >> TIMER_TICK_SHIFT.
+    uint64_t wheelTick;
+
+    // Total number of active timers.
+    uint32_t timerCount;
 
     // Optimization for timers: no timer will trigger sooner than this time
     // (measured in cycles).
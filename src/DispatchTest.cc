@@ -272,9 +272,9 @@ TEST_F(DispatchTest, destructor) {
     EXPECT_TRUE(p1->owner == NULL);
     EXPECT_EQ(-1, p2->slot);
     EXPECT_TRUE(p2->owner == NULL);
-    EXPECT_EQ(-1, t1->slot);
+    EXPECT_FALSE(t1->isRunning());
     EXPECT_TRUE(t1->owner == NULL);
-    EXPECT_EQ(-1, t2->slot);
+    EXPECT_FALSE(t2->isRunning());
     EXPECT_TRUE(t2->owner == NULL);
     EXPECT_EQ(0, f1->active);
     EXPECT_EQ(0, f1->events);
@@ -406,11 +406,57 @@ TEST_F(DispatchTest, poll_triggerTimers) {
     t4.start(170);
     Cycles::mockTscValue = 175;
     dispatch.poll();
-    EXPECT_EQ("timer t1 invoked; timer t4 invoked; "
-                "timer t2 invoked", *localLog);
+    EXPECT_EQ("timer t1 invoked; timer t2 invoked; "
+                "timer t4 invoked", *localLog);
     EXPECT_EQ(180UL, dispatch.earliestTriggerTime);
 }
 
+TEST_F(DispatchTest, poll_triggerTimersFromWheel) {
+    uint64_t tick = 1ull << Dispatch::TIMER_TICK_SHIFT;
+    Cycles::mockTscValue = 0;
+    dispatch.wheelTick = 0;
+    DummyTimer t1("t1", &dispatch), t2("t2", &dispatch);
+    t1.start(300*tick + 5);
+    t2.start(2*tick);
+    EXPECT_EQ(1, t1.level);
+    EXPECT_EQ(0, t2.level);
+
+    Cycles::mockTscValue = 299*tick;
+    dispatch.poll();
+    EXPECT_EQ("timer t2 invoked", *localLog);
+    EXPECT_EQ(299UL, dispatch.wheelTick);
+    EXPECT_EQ(0, t1.level);
+    EXPECT_EQ(300*tick, dispatch.earliestTriggerTime);
+
+    localLog->clear();
+    Cycles::mockTscValue = 300*tick + 4;
+    dispatch.poll();
+    EXPECT_EQ("", *localLog);
+    EXPECT_TRUE(t1.list == &dispatch.nearTimers);
+    EXPECT_EQ(300*tick + 5, dispatch.earliestTriggerTime);
+
+    Cycles::mockTscValue = 300*tick + 5;
+    dispatch.poll();
+    EXPECT_EQ("timer t1 invoked", *localLog);
+    EXPECT_EQ(0U, dispatch.timerCount);
+    EXPECT_EQ(~0UL, dispatch.earliestTriggerTime);
+}
+
+TEST_F(DispatchTest, poll_timeGoesBackwards) {
+    uint64_t tick = 1ull << Dispatch::TIMER_TICK_SHIFT;
+    Cycles::mockTscValue = 0;
+    dispatch.wheelTick = 10;
+    DummyTimer t1("t1", &dispatch);
+    t1.start(12*tick);
+    Cycles::mockTscValue = 5*tick;
+    dispatch.poll();
+    EXPECT_EQ(10UL, dispatch.wheelTick);
+    EXPECT_EQ("", *localLog);
+    Cycles::mockTscValue = 12*tick;
+    dispatch.poll();
+    EXPECT_EQ("timer t1 invoked", *localLog);
+}
+
 TEST_F(DispatchTest, poll_callEachTimerOnlyOnce) {
     // The timer below will reschedule itself the first few times
     // it's invoked.
@@ -445,8 +491,8 @@ TEST_F(DispatchTest, poll_callEachTimerOnlyOnce) {
 }
 
 TEST_F(DispatchTest, poll_handlerDeletesTimers) {
-    // If one timer deletes others, make sure that the loop index doesn't
-    // overflow the length of the "timers" vector.
+    // If one timer deletes others that are also due, make sure that the
+    // deleted timers aren't invoked.
     DummyTimer t1("t1", &dispatch), t4("t4", &dispatch);
     DummyTimer* t2 = new DummyTimer("t2", &dispatch);
     DummyTimer* t3 = new DummyTimer("t3", &dispatch);
@@ -461,6 +507,71 @@ TEST_F(DispatchTest, poll_handlerDeletesTimers) {
     EXPECT_EQ("timer t1 invoked; timer t4 invoked", *localLog);
 }
 
+TEST_F(DispatchTest, cascadeTimers) {
+    uint64_t tick = 1ull << Dispatch::TIMER_TICK_SHIFT;
+    dispatch.wheelTick = 0;
+    DummyTimer t1("t1", &dispatch), t2("t2", &dispatch);
+    DummyTimer t3("t3", &dispatch);
+    t1.start(65536*tick);
+    t2.start(65536*tick + 256*tick + 3*tick);
+    t3.start(65536*tick + 7*tick);
+    EXPECT_EQ(2, t1.level);
+    EXPECT_EQ(3U, dispatch.timerWheelCounts[2]);
+
+    // Level 2 is due, and t1 goes all the way down to nearTimers.
+    dispatch.wheelTick = 65536;
+    dispatch.cascadeTimers(65536);
+    EXPECT_TRUE(t1.list == &dispatch.nearTimers);
+    EXPECT_EQ(-1, t1.level);
+    EXPECT_EQ(1, t2.level);
+    EXPECT_EQ(0, t3.level);
+    EXPECT_EQ(0U, dispatch.timerWheelCounts[2]);
+    EXPECT_EQ(1U, dispatch.timerWheelCounts[1]);
+    EXPECT_EQ(1U, dispatch.timerWheelCounts[0]);
+    EXPECT_EQ(3U, dispatch.timerCount);
+}
+
+TEST_F(DispatchTest, addTimer_levels) {
+    uint64_t tick = 1ull << Dispatch::TIMER_TICK_SHIFT;
+    dispatch.wheelTick = 1000;
+    DummyTimer t1("t1", &dispatch), t2("t2", &dispatch);
+    DummyTimer t3("t3", &dispatch), t4("t4", &dispatch);
+    t1.start(1000*tick + 100);
+    EXPECT_TRUE(t1.list == &dispatch.nearTimers);
+    t2.start(1255*tick);
+    EXPECT_EQ(0, t2.level);
+    EXPECT_TRUE(t2.list == &dispatch.timerWheel[0][1255 & 255]);
+    t3.start(1256*tick);
+    EXPECT_EQ(1, t3.level);
+    EXPECT_TRUE(t3.list == &dispatch.timerWheel[1][(1256 >> 8) & 255]);
+
+    // Timers beyond the end of the wheel go in the last slot it can
+    // reach.
+    t4.start(~0ull);
+    EXPECT_EQ(3, t4.level);
+    uint64_t last = 1000 + (1ull << 32) - 1;
+    EXPECT_TRUE(t4.list == &dispatch.timerWheel[3][(last >> 24) & 255]);
+}
+
+TEST_F(DispatchTest, updateEarliestTriggerTime) {
+    uint64_t tick = 1ull << Dispatch::TIMER_TICK_SHIFT;
+    dispatch.wheelTick = 1000;
+    dispatch.updateEarliestTriggerTime();
+    EXPECT_EQ(~0UL, dispatch.earliestTriggerTime);
+
+    DummyTimer t1("t1", &dispatch), t2("t2", &dispatch);
+    t1.start(5000*tick);
+    dispatch.updateEarliestTriggerTime();
+    EXPECT_EQ(1024*tick, dispatch.earliestTriggerTime);
+    t2.start(1001*tick);
+    dispatch.updateEarliestTriggerTime();
+    EXPECT_EQ(1001*tick, dispatch.earliestTriggerTime);
+    t1.start(900*tick + 17);
+    t2.start(900*tick + 12);
+    dispatch.updateEarliestTriggerTime();
+    EXPECT_EQ(900*tick + 12, dispatch.earliestTriggerTime);
+}
+
 // Helper function that runs in a separate thread for the following test.
 static void checkDispatchThread(Dispatch* dispatch, bool* result) {
     *result = dispatch->isDispatchThread();
@@ -747,13 +858,14 @@ TEST_F(DispatchTest, epollThreadMain_signalEventsAndExit) {
 TEST_F(DispatchTest, Timer_constructorDestructor) {
     DummyTimer* t1 = new DummyTimer("t1", &dispatch);
     DummyTimer* t2 = new DummyTimer("t2", 100, &dispatch);
-    EXPECT_EQ(1U, dispatch.timers.size());
-    EXPECT_EQ(-1, t1->slot);
-    EXPECT_EQ(0, t2->slot);
+    EXPECT_EQ(1U, dispatch.timerCount);
+    EXPECT_FALSE(t1->isRunning());
+    EXPECT_TRUE(t2->isRunning());
     EXPECT_EQ(100UL, t2->triggerTime);
     delete t1;
     delete t2;
-    EXPECT_EQ(0U, dispatch.timers.size());
+    EXPECT_EQ(0U, dispatch.timerCount);
+    EXPECT_TRUE(dispatch.nearTimers.empty());
 }
 
 // Make sure that a timer can safely be deleted from a timer
@@ -767,7 +879,7 @@ TEST_F(DispatchTest, Timer_reentrant) {
     Cycles::mockTscValue = 300;
     dispatch.poll();
     EXPECT_EQ("timer t2 invoked", *localLog);
-    EXPECT_EQ(1U, dispatch.timers.size());
+    EXPECT_EQ(1U, dispatch.timerCount);
 }
 
 TEST_F(DispatchTest, Timer_isRunning) {
@@ -785,14 +897,26 @@ TEST_F(DispatchTest, Timer_start) {
     dispatch.earliestTriggerTime = 200;
     t1.start(210);
     EXPECT_EQ(210UL, t1.triggerTime);
-    EXPECT_EQ(0, t1.slot);
+    EXPECT_TRUE(t1.list == &dispatch.nearTimers);
     EXPECT_EQ(200UL, dispatch.earliestTriggerTime);
     t2.start(190);
     EXPECT_EQ(190UL, dispatch.earliestTriggerTime);
-    EXPECT_EQ(1, t2.slot);
+    EXPECT_EQ(2U, dispatch.timerCount);
     t1.start(300);
     EXPECT_EQ(300UL, t1.triggerTime);
-    EXPECT_EQ(0, t1.slot);
+    EXPECT_EQ(2U, dispatch.timerCount);
+
+    // Restarting a timer moves it to the right list.
+    uint64_t tick = 1ull << Dispatch::TIMER_TICK_SHIFT;
+    dispatch.wheelTick = 0;
+    t1.start(10*tick);
+    EXPECT_EQ(0, t1.level);
+    EXPECT_EQ(1U, dispatch.timerWheelCounts[0]);
+    t1.start(1000*tick);
+    EXPECT_EQ(1, t1.level);
+    EXPECT_EQ(0U, dispatch.timerWheelCounts[0]);
+    EXPECT_EQ(1U, dispatch.timerWheelCounts[1]);
+    EXPECT_EQ(2U, dispatch.timerCount);
 }
 
 TEST_F(DispatchTest, Timer_start_dispatchDeleted) {
@@ -809,13 +933,21 @@ TEST_F(DispatchTest, Timer_stop) {
     DummyTimer t1("t1", 100, &dispatch);
     DummyTimer t2("t2", 100, &dispatch);
     DummyTimer t3("t3", 100, &dispatch);
-    EXPECT_EQ(0, t1.slot);
+    EXPECT_TRUE(t1.isRunning());
     t1.stop();
-    EXPECT_EQ(-1, t1.slot);
-    EXPECT_EQ(2U, dispatch.timers.size());
+    EXPECT_FALSE(t1.isRunning());
+    EXPECT_EQ(2U, dispatch.timerCount);
     t1.stop();
-    EXPECT_EQ(-1, t1.slot);
-    EXPECT_EQ(2U, dispatch.timers.size());
+    EXPECT_FALSE(t1.isRunning());
+    EXPECT_EQ(2U, dispatch.timerCount);
+
+    dispatch.wheelTick = 0;
+    t2.start(5000ull << Dispatch::TIMER_TICK_SHIFT);
+    EXPECT_EQ(1U, dispatch.timerWheelCounts[1]);
+    t2.stop();
+    EXPECT_EQ(0U, dispatch.timerWheelCounts[1]);
+    EXPECT_EQ(-1, t2.level);
+    EXPECT_EQ(1U, dispatch.timerCount);
 }
 
 TEST_F(DispatchTest, Lock_inDispatchThread) {
@@ -16,6 +16,10 @@
 #ifndef RAMCLOUD_HASHTABLE_H
 #define RAMCLOUD_HASHTABLE_H
 
+#if __SSE4_1__
+#include <smmintrin.h>
+#endif
+
 #include "Common.h"
 #include "BitOps.h"
 #include "CycleCounter.h"
@@ -24,14 +28,23 @@
 #include "MurmurHash3.h"
 #include "Key.h"
 
+#ifndef HASHTABLE_TAG_BITS
+/**
+ * Number of secondary hash bits stored in each hash table entry. See
+ * HashTable. Set at build time with, e.g., "make HASHTABLE_TAG_BITS=20".
+ */
+#define HASHTABLE_TAG_BITS 16
+#endif
+
 namespace RAMCloud {
 
 /**
  * A map from Key objects to 47-bit "references". These references are just
  * opaque values that could be anything from direct pointers, to indexes into
  * some other structure, or even tiny bits of data themselves. The only
- * requirements are that 1) they fit within the lower 47 bits of a uint64_t,
- * and 2) the value 0 is never used.
+ * requirements are that 1) they fit within the lower 47 bits of a uint64_t
+ * (fewer if HASHTABLE_TAG_BITS is raised; see below), and 2) the value 0 is
+ * never used.
  *
  * This class is used, for instance, in resolving most object-level %RAMCloud
  * requests. I.e., to read and write a %RAMCloud object, this lets you find the
@@ -52,12 +65,43 @@ namespace RAMCloud {
  * buckets). In this case, the last hash table entry in each of the
  * non-terminal cache lines has a pointer to the next cache line instead of a
  * log reference.
+ *
+ * Lookups compare the secondary hash bits of all entries in a cache line at
+ * once using SSE (see #CacheLine::matchMask()), so only entries whose tags
+ * match are ever unpacked or handed back to the caller.
+ *
+ * The number of secondary hash bits kept in each entry is fixed at compile
+ * time by HASHTABLE_TAG_BITS (16 by default). Wider tags make it less likely
+ * that a lookup returns a candidate whose key does not match (each of which
+ * costs the caller a trip to the log), at the cost of narrowing the
+ * references that can be stored: references must fit in 63 minus
+ * HASHTABLE_TAG_BITS bits.
  */
 class HashTable {
   PRIVATE:
     // Forward declaration.
     struct CacheLine;
 
+    /**
+     * The number of secondary hash bits stored in each Entry.
+     */
+    static const uint32_t TAG_BITS = HASHTABLE_TAG_BITS;
+    static_assert(TAG_BITS >= 16 && TAG_BITS <= 22,
+                  "HASHTABLE_TAG_BITS must be between 16 and 22");
+
+    /**
+     * The number of bits of each Entry available for a reference or chain
+     * pointer (everything but the secondary hash and the chain bit).
+     */
+    static const uint32_t POINTER_BITS = 63 - TAG_BITS;
+
+    /**
+     * How far chain pointers are shifted right when packed into an Entry.
+     * Chained cache lines are 64-byte aligned and user-space pointers fit
+     * in 47 bits, so chain pointers always fit in POINTER_BITS this way.
+     */
+    static const uint32_t CHAIN_POINTER_SHIFT = 47 - POINTER_BITS;
+
     /**
      * A hash table entry.
      *
@@ -91,7 +135,7 @@ class HashTable {
         /**
          * Reinitialize a regular hash table entry.
          * \param[in] hash
-         *      The secondary hash bits computed from the key (16 bits).
+         *      The secondary hash bits computed from the key (TAG_BITS bits).
          * \param[in] reference
          *      The Reference to insert. It must be valid.
          */
@@ -111,7 +155,9 @@ class HashTable {
         setChainPointer(CacheLine *ptr)
         {
             assert(ptr != NULL);
-            pack(0, true, reinterpret_cast<uint64_t>(ptr));
+            uint64_t p = reinterpret_cast<uint64_t>(ptr);
+            assert((p & ((1UL << CHAIN_POINTER_SHIFT) - 1)) == 0);
+            pack(0, true, p >> CHAIN_POINTER_SHIFT);
         }
 
         /**
@@ -131,8 +177,8 @@ class HashTable {
          * The caller must first verify that the hash table entry indeed stores
          * a reference with #hashMatches().
          * \return
-         *      47-bit reference referring to the entry being stored in this
-         *      Entry.
+         *      Reference (of up to POINTER_BITS bits) referring to the entry
+         *      being stored in this Entry.
          */
         uint64_t
         getReference() const
@@ -154,13 +200,14 @@ class HashTable {
             UnpackedEntry ue = unpack();
             if (!ue.chain)
                 return NULL;
-            return reinterpret_cast<CacheLine*>(ue.ptr);
+            return reinterpret_cast<CacheLine*>(ue.ptr << CHAIN_POINTER_SHIFT);
         }
 
         /**
          * Check whether the secondary hash bits stored match those given.
          * \param[in] hash
-         *      The secondary hash bits computed from the key to test (16 bits).
+         *      The secondary hash bits computed from the key to test
+         *      (TAG_BITS bits).
          * \return
          *      True if the secondary hash bits stored with this Entry are equal
          *      (indicating a possible match), otherwise false.
@@ -177,9 +224,9 @@ class HashTable {
          * The packed value stored in the entry.
          *
          * The exact bits are, from MSB to LSB:
-         * \li 16 bits for the secondary hash
+         * \li TAG_BITS (16 by default) bits for the secondary hash
          * \li 1 bit for whether the pointer is a chain
-         * \li 47 bits for the pointer
+         * \li POINTER_BITS (47 by default) bits for the pointer
          *
          * The main reason why it's not a struct with bit fields is that we'll
          * probably want to use atomic operations to set it eventually.
@@ -192,7 +239,7 @@ class HashTable {
         /**
          * Replace this hash table entry.
          * \param[in] hash
-         *      The secondary hash bits (16 bits) computed from the key.
+         *      The secondary hash bits (TAG_BITS bits) computed from the key.
          *      Irrelevant if \a chain is true.
          * \param[in] chain
          *      Whether \a ptr is a chain pointer as opposed to a reference.
@@ -209,7 +256,7 @@ class HashTable {
             if (ptr == 0)
                 assert(hash == 0 && !chain);
 
-            if ((ptr >> 47) != 0) {
+            if ((ptr >> POINTER_BITS) != 0) {
                 throw Exception(HERE, format(
                     "The given pointer (0x%016lx) can't fit "
                     "in a hash table entry.",
@@ -217,8 +264,9 @@ class HashTable {
             }
 
             uint64_t c = chain ? 1 : 0;
-            assert((hash >> 16) == 0);
-            this->value = ((hash << 48) | (c << 47) | ptr);
+            assert((hash >> TAG_BITS) == 0);
+            this->value = ((hash << (POINTER_BITS + 1)) |
+                           (c << POINTER_BITS) | ptr);
         }
 
         /**
@@ -240,9 +288,9 @@ class HashTable {
         unpack() const
         {
             UnpackedEntry ue;
-            ue.hash  = (this->value >> 48) & 0x000000000000ffffUL;
-            ue.chain = (this->value >> 47) & 0x0000000000000001UL;
-            ue.ptr   = this->value         & 0x00007fffffffffffUL;
+            ue.hash  = this->value >> (POINTER_BITS + 1);
+            ue.chain = (this->value >> POINTER_BITS) & 0x1UL;
+            ue.ptr   = this->value & ((1UL << POINTER_BITS) - 1);
             return ue;
         }
     };
@@ -276,6 +324,49 @@ class HashTable {
      * achieve this.
      */
     struct CacheLine {
+        /**
+         * Find the entries in this cache line that hold references whose
+         * secondary hash bits match the given ones. When SSE4.1 is
+         * available, the tags of all entries are compared with a handful
+         * of vector instructions rather than unpacking each Entry in turn.
+         * \param[in] hash
+         *      The secondary hash bits computed from the key to test
+         *      (TAG_BITS bits).
+         * \return
+         *      A bitmask with bit i set if entries[i].hashMatches(hash).
+         */
+        uint32_t
+        matchMask(uint64_t hash) const
+        {
+            uint32_t mask = 0;
+#if __SSE4_1__
+            static_assert(ENTRIES_PER_CACHE_LINE % 2 == 0,
+                          "SSE probe assumes pairs of entries");
+            // An entry matches if its tag and chain bit (everything above
+            // the pointer) equal the tag we're looking for with the chain
+            // bit clear, and it isn't an empty (all zero) entry.
+            const __m128i* pairs = reinterpret_cast<const __m128i*>(entries);
+            const __m128i wanted = _mm_set1_epi64x(
+                    static_cast<int64_t>(hash << 1));
+            const __m128i zero = _mm_setzero_si128();
+            for (uint32_t i = 0; i < ENTRIES_PER_CACHE_LINE / 2; i++) {
+                __m128i pair = _mm_loadu_si128(&pairs[i]);
+                __m128i tags = _mm_srli_epi64(pair, POINTER_BITS);
+                __m128i matches = _mm_andnot_si128(
+                        _mm_cmpeq_epi64(pair, zero),
+                        _mm_cmpeq_epi64(tags, wanted));
+                mask |= static_cast<uint32_t>(
+                        _mm_movemask_pd(_mm_castsi128_pd(matches))) << (2 * i);
+            }
+#else
+            for (uint32_t i = 0; i < ENTRIES_PER_CACHE_LINE; i++) {
+                if (entries[i].hashMatches(hash))
+                    mask |= 1U << i;
+            }
+#endif
+            return mask;
+        }
+
         /**
          * See CacheLine.
          */
@@ -370,33 +461,28 @@ class HashTable {
         void
         next()
         {
-            while (true) {
-                // Not found in the cache line, see if there's a chain to
-                // another cache line.
-                if (index == ENTRIES_PER_CACHE_LINE && bucket != NULL) {
-                    Entry* entry = &bucket->entries[ENTRIES_PER_CACHE_LINE - 1];
-                    bucket = entry->getChainPointer();
-                    index = -1;
-                }
-
-                if (bucket == NULL)
-                    return;
-
+            while (bucket != NULL) {
                 // Resume in the current cache line.
                 index++;
-                Entry* candidate = &bucket->entries[index];
-                while (index < ENTRIES_PER_CACHE_LINE) {
-                    if (candidate->hashMatches(secondaryHash)) {
+                if (index < ENTRIES_PER_CACHE_LINE) {
+                    uint32_t matches =
+                        bucket->matchMask(secondaryHash) >> index;
+                    if (matches != 0) {
                         // The hash within the hash table entry matches, so with
                         // high probability this is the pointer we're looking
                         // for. We'll report this index to the user of this
                         // class in the next getReference() call so that they
                         // can verify the match.
+                        index += downCast<uint32_t>(BitOps::findFirstSet(matches) - 1);
                         return;
                     }
-                    candidate++;
-                    index++;
                 }
+
+                // Not found in the cache line, see if there's a chain to
+                // another cache line.
+                Entry* entry = &bucket->entries[ENTRIES_PER_CACHE_LINE - 1];
+                bucket = entry->getChainPointer();
+                index = -1;
             }
         }
 
@@ -627,7 +713,7 @@ class HashTable {
      * \param[in] key
      *      Key object representing the element we're looking for. 
      * \param[out] secondaryHash
-     *      The secondary hash bits (16 bits).
+     *      The secondary hash bits (TAG_BITS bits).
      * \return
      *      The bucket index corresponding to the given referent ID.
      */
@@ -635,8 +721,8 @@ class HashTable {
     findBucketIndex(uint64_t numBuckets, Key& key, uint64_t *secondaryHash)
     {
         uint64_t hashValue = key.getHash();
-        uint64_t bucketHash = hashValue & 0x0000ffffffffffffUL;
-        *secondaryHash = hashValue >> 48;
+        uint64_t bucketHash = hashValue & ((1UL << (64 - TAG_BITS)) - 1);
+        *secondaryHash = hashValue >> (64 - TAG_BITS);
         return (bucketHash & (numBuckets - 1));
         // This is equivalent to:
         //     &buckets.get()[bucketHash % numBuckets]
@@ -657,7 +743,7 @@ class HashTable {
      * \param[in] key
      *      Key object representing the element we're looking for. 
      * \param[out] secondaryHash
-     *      The secondary hash bits (16 bits).
+     *      The secondary hash bits (TAG_BITS bits).
      * \return
      *      The bucket corresponding to the given key.
      */
@@ -54,9 +54,15 @@ hashTableBenchmark(uint64_t nkeys, uint64_t nlines)
     HashTable ht(nlines);
     TestObject** values = new TestObject*[nkeys];
 
+    // References are indexes into values (offset by one, since 0 is not a
+    // valid reference) rather than pointers, so that they fit regardless of
+    // how many bits HASHTABLE_TAG_BITS leaves for references.
+#define REFERENCE_TO_OBJECT(_r) (values[(_r) - 1])
+
     printf("hash table keys: %lu\n", nkeys);
     printf("hash table lines: %lu\n", nlines);
     printf("cache line size: %d\n", ht.bytesPerCacheLine());
+    printf("secondary hash bits: %u\n", HashTable::TAG_BITS);
     printf("load factor: %.03f\n", static_cast<double>(nkeys) /
            (static_cast<double>(nlines) * ht.entriesPerCacheLine()));
 
@@ -65,8 +71,7 @@ hashTableBenchmark(uint64_t nkeys, uint64_t nlines)
     for (i = 0; i < nkeys; i++) {
         Key key(0, &i, sizeof(i));
         values[i] = new TestObject(i);
-        uint64_t reference(reinterpret_cast<uint64_t>(values[i]));
-        ht.insert(key, reference);
+        ht.insert(key, i + 1);
     }
     printf("done!\n");
 
@@ -77,13 +82,13 @@ hashTableBenchmark(uint64_t nkeys, uint64_t nlines)
     uint64_t replaceCycles = Cycles::rdtsc();
     for (i = 0; i < nkeys; i++) {
         Key key(0, &i, sizeof(i));
-        uint64_t reference(reinterpret_cast<uint64_t>(values[i]));
+        uint64_t reference = i + 1;
 
         bool success = false;
         HashTable::Candidates c = ht.lookup(key);
         while (!c.isDone()) {
             TestObject* candidateObject =
-                reinterpret_cast<TestObject*>(c.getReference());
+                REFERENCE_TO_OBJECT(c.getReference());
             Key candidateKey(0,
                              &candidateObject->key,
                              sizeof(candidateObject->key));
@@ -99,9 +104,6 @@ hashTableBenchmark(uint64_t nkeys, uint64_t nlines)
     i = Cycles::rdtsc() - replaceCycles;
     printf("done!\n");
 
-    delete[] values;
-    values = NULL;
-
     printf("== replace() ==\n");
 
     printf("    external avg: %lu ticks, %lu nsec\n",
@@ -111,6 +113,7 @@ hashTableBenchmark(uint64_t nkeys, uint64_t nlines)
     fflush(stdout);
 
     // don't use a CycleCounter, as we may want to run without PERF_COUNTERS
+    uint64_t falseCandidates = 0;
     uint64_t lookupCycles = Cycles::rdtsc();
     for (i = 0; i < nkeys; i++) {
         Key key(0, &i, sizeof(i));
@@ -120,8 +123,7 @@ hashTableBenchmark(uint64_t nkeys, uint64_t nlines)
         HashTable::Candidates c = ht.lookup(key);
         while (!c.isDone()) {
             reference = c.getReference();
-            TestObject* candidateObject =
-                reinterpret_cast<TestObject*>(reference);
+            TestObject* candidateObject = REFERENCE_TO_OBJECT(reference);
             Key candidateKey(0,
                              &candidateObject->key,
                              sizeof(candidateObject->key));
@@ -129,10 +131,11 @@ hashTableBenchmark(uint64_t nkeys, uint64_t nlines)
                 success = true;
                 break;
             }
+            falseCandidates++;
             c.next();
         }
         assert(success);
-        assert(reinterpret_cast<TestObject*>(reference)->key == i);
+        assert(REFERENCE_TO_OBJECT(reference)->key == i);
     }
     i = Cycles::rdtsc() - lookupCycles;
     printf("done!\n");
@@ -141,6 +144,14 @@ hashTableBenchmark(uint64_t nkeys, uint64_t nlines)
 
     printf("    external avg: %lu ticks, %lu nsec\n", i / nkeys,
         Cycles::toNanoseconds(i / nkeys));
+    printf("    false candidates: %lu (%.6f per lookup)\n", falseCandidates,
+        static_cast<double>(falseCandidates) / static_cast<double>(nkeys));
+
+    for (i = 0; i < nkeys; i++)
+        delete values[i];
+    delete[] values;
+    values = NULL;
+#undef REFERENCE_TO_OBJECT
 
     uint64_t *histogram = static_cast<uint64_t *>(
         Memory::xmalloc(HERE, nlines * sizeof(histogram[0])));
@@ -186,6 +197,7 @@ main(int argc, char **argv)
 
     uint64_t hashTableMegs, numberOfKeys;
     double loadFactor;
+    bool loadFactorSweep;
 
     OptionsDescription benchmarkOptions("HashTableBenchmark");
     benchmarkOptions.add_options()
@@ -200,18 +212,33 @@ main(int argc, char **argv)
         ("NumberOfKeys,n",
          ProgramOptions::value<uint64_t>(&numberOfKeys)->
             default_value(0),
-         "Number of keys to insert into the HashTable (overrides LoadFactor)");
+         "Number of keys to insert into the HashTable (overrides LoadFactor)")
+        ("LoadFactorSweep,s",
+         ProgramOptions::bool_switch(&loadFactorSweep),
+         "Run at load factors of 0.50, 0.80, and 0.95 in turn (overrides "
+         "LoadFactor and NumberOfKeys)");
 
     OptionParser optionParser(benchmarkOptions, argc, argv);
 
     uint64_t numberOfCachelines = (hashTableMegs * 1024 * 1024) /
         HashTable::bytesPerCacheLine();
+    uint64_t totalEntries = numberOfCachelines *
+        HashTable::entriesPerCacheLine();
+
+    if (loadFactorSweep) {
+        double loadFactors[] = { 0.50, 0.80, 0.95 };
+        foreach (double lf, loadFactors) {
+            hashTableBenchmark(static_cast<uint64_t>(lf *
+                                   static_cast<double>(totalEntries)),
+                               numberOfCachelines);
+            printf("\n");
+        }
+        return 0;
+    }
 
     // If the user specified a load factor, auto-calculate the number of
     // keys based on the number of cachelines.
     if (numberOfKeys == 0) {
-        uint64_t totalEntries = numberOfCachelines *
-            HashTable::entriesPerCacheLine();
         numberOfKeys = static_cast<uint64_t>(loadFactor *
                           static_cast<double>(totalEntries));
     }
@@ -225,6 +225,35 @@ TEST_F(HashTableEntryTest, hashMatches) {
     EXPECT_TRUE(!e.hashMatches(0xfeedUL));
 }
 
+TEST_F(HashTableEntryTest, matchMask) {
+    HashTable::CacheLine cl;
+    for (uint32_t i = 0; i < HashTable::ENTRIES_PER_CACHE_LINE; i++)
+        cl.entries[i].clear();
+    EXPECT_EQ(0U, cl.matchMask(0UL));
+    EXPECT_EQ(0U, cl.matchMask(0xbeefUL));
+
+    cl.entries[1].setReference(0xbeefUL, 0x1UL);
+    cl.entries[2].setReference(0UL, 0x2UL);
+    cl.entries[4].setReference(0xbeefUL, 0x3UL);
+    cl.entries[5].setReference(0xfeedUL, 0x4UL);
+    cl.entries[7].setChainPointer(reinterpret_cast<HashTable::CacheLine*>(
+        0x40UL));
+    EXPECT_EQ(0x12U, cl.matchMask(0xbeefUL));
+    EXPECT_EQ(0x20U, cl.matchMask(0xfeedUL));
+    EXPECT_EQ(0x04U, cl.matchMask(0UL));
+    EXPECT_EQ(0U, cl.matchMask(0xbeeeUL));
+
+    // The mask must agree with hashMatches() entry by entry.
+    uint64_t hashes[] = { 0UL, 0xbeefUL, 0xfeedUL, 0x1234UL };
+    foreach (uint64_t hash, hashes) {
+        uint32_t mask = cl.matchMask(hash);
+        for (uint32_t i = 0; i < HashTable::ENTRIES_PER_CACHE_LINE; i++) {
+            EXPECT_EQ(cl.entries[i].hashMatches(hash),
+                      (mask & (1U << i)) != 0);
+        }
+    }
+}
+
 /**
  * Unit tests for HashTable.
  */
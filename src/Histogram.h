@@ -102,24 +102,29 @@ class Histogram {
      *
      * \param sample
      *      The sample to store.
+     * \param count
+     *      The number of times to store the sample.
      */
     void
-    storeSample(uint64_t sample)
+    storeSample(uint64_t sample, uint64_t count = 1)
     {
+        if (count == 0)
+            return;
+
         // round to the nearest bucket
         uint64_t bucket = (sample + (bucketWidth / 2)) / bucketWidth;
 
         if (bucket < numBuckets)
-            buckets[bucket]++;
+            buckets[bucket] += count;
         else
-            outliers++;
+            outliers += count;
 
         if (sample < min)
             min = sample;
         if (sample > max)
             max = sample;
 
-        sampleSum += sample;
+        sampleSum += static_cast<__uint128_t>(sample) * count;
     }
 
     /**
@@ -91,6 +91,23 @@ TEST_F(HistogramTest, storeSample) {
         downCast<uint64_t>(h.sampleSum));
 }
 
+TEST_F(HistogramTest, storeSample_count) {
+    Histogram h(5000, 10);
+
+    h.storeSample(12, 0);
+    EXPECT_EQ(0UL, h.buckets[1]);
+    EXPECT_EQ(0UL, downCast<uint64_t>(h.sampleSum));
+
+    h.storeSample(12, 3);
+    h.storeSample(h.numBuckets * h.bucketWidth + 40, 2);
+    EXPECT_EQ(12UL, h.min);
+    EXPECT_EQ(h.numBuckets * h.bucketWidth + 40, h.max);
+    EXPECT_EQ(3UL, h.buckets[1]);
+    EXPECT_EQ(2UL, h.outliers);
+    EXPECT_EQ(3UL * 12 + 2 * (h.numBuckets * h.bucketWidth + 40),
+        downCast<uint64_t>(h.sampleSum));
+}
+
 TEST_F(HistogramTest, reset) {
     Histogram h(100, 1);
     h.storeSample(23);
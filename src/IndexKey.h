@@ -0,0 +1,287 @@
+/* Copyright (c) 2013 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef RAMCLOUD_INDEXKEY_H
+#define RAMCLOUD_INDEXKEY_H
+
+#include "Common.h"
+#include "Buffer.h"
+
+namespace RAMCloud {
+
+/**
+ * In addition to its primary (table, string key) name, an object may carry
+ * a small set of typed secondary keys, each tagged with the identifier of the
+ * index it belongs to. Masters keep an ordered index over the secondary keys
+ * of the objects they store (see IndexletManager), which lets clients look
+ * objects up by ranges of secondary key values.
+ *
+ * This class defines the format of such a set of secondary keys, both in write
+ * requests and at the end of each object in the log, and provides helpers to
+ * build and walk these sets. Each key is preceded by a small header:
+ *
+ * +---------+------+--------+--------------------+---------+-- - -
+ * | indexId | type | length | Key Bytes . . .    | indexId |
+ * +---------+------+--------+--------------------+---------+-- - -
+ *
+ * Keys of every type are encoded so that a bytewise comparison orders them
+ * correctly (UINT64 keys are stored big-endian), so the index itself never
+ * needs to interpret them.
+ */
+class IndexKey {
+  public:
+    /// The different kinds of secondary keys an index may hold.
+    enum Type {
+        /// Unsigned 64-bit integer, ordered numerically.
+        UINT64 = 0,
+        /// Binary string of up to 64KB, ordered lexicographically.
+        STRING = 1,
+    };
+
+    /**
+     * Header that precedes the bytes of each secondary key.
+     */
+    struct Header {
+        /// Identifier of the index this key belongs to. An object may carry
+        /// at most one key for each index.
+        uint8_t indexId;
+
+        /// One of the values of IndexKey::Type.
+        uint8_t type;
+
+        /// Length of the encoded key bytes following this header.
+        uint16_t length;
+    } __attribute__((__packed__));
+    static_assert(sizeof(Header) == 4, "Unexpected IndexKey header size");
+
+    /**
+     * Return the encoding of a UINT64 secondary key: its big-endian bytes,
+     * which sort in the same order as the integers themselves.
+     */
+    static string
+    encode(uint64_t key)
+    {
+        char bytes[sizeof(key)];
+        for (uint32_t i = 0; i < sizeof(key); i++)
+            bytes[i] = static_cast<char>(key >> (8 * (sizeof(key) - 1 - i)));
+        return string(bytes, sizeof(bytes));
+    }
+
+    /**
+     * Append a UINT64 secondary key to a set of secondary keys.
+     *
+     * \param buffer
+     *      Buffer holding the set of secondary keys to extend.
+     * \param indexId
+     *      Index the key belongs to.
+     * \param key
+     *      Value of the key.
+     */
+    static void
+    append(Buffer& buffer, uint8_t indexId, uint64_t key)
+    {
+        string encoded = encode(key);
+        appendHeader(buffer, indexId, UINT64, downCast<uint16_t>(
+                encoded.size()));
+        memcpy(new(&buffer, APPEND) char[encoded.size()], encoded.data(),
+               encoded.size());
+    }
+
+    /**
+     * Append a STRING secondary key to a set of secondary keys.
+     *
+     * \param buffer
+     *      Buffer holding the set of secondary keys to extend.
+     * \param indexId
+     *      Index the key belongs to.
+     * \param key
+     *      Bytes of the key. They are copied, so the caller need not keep
+     *      them around.
+     * \param keyLength
+     *      Length of the key in bytes.
+     */
+    static void
+    append(Buffer& buffer, uint8_t indexId, const void* key,
+           uint16_t keyLength)
+    {
+        appendHeader(buffer, indexId, STRING, keyLength);
+        memcpy(new(&buffer, APPEND) char[keyLength], key, keyLength);
+    }
+
+    /**
+     * Walks the secondary keys in a range of a Buffer. The range must be
+     * well-formed (see isValid()).
+     */
+    class Iterator {
+      public:
+        /**
+         * Construct an iterator positioned at the first key of the set.
+         *
+         * \param buffer
+         *      Buffer containing the set of secondary keys.
+         * \param offset
+         *      Offset of the first key's header in the buffer.
+         * \param length
+         *      Total length of the set of keys in bytes.
+         */
+        Iterator(Buffer& buffer, uint32_t offset, uint32_t length)
+            : buffer(buffer)
+            , offset(offset)
+            , end(offset + length)
+            , header()
+        {
+            loadHeader();
+        }
+
+        /// Return true once every key has been visited.
+        bool isDone() const { return offset >= end; }
+
+        /// Advance to the next key in the set.
+        void
+        next()
+        {
+            offset += sizeof32(Header) + header.length;
+            loadHeader();
+        }
+
+        /// Index that the current key belongs to.
+        uint8_t getIndexId() const { return header.indexId; }
+
+        /// Type of the current key.
+        Type getType() const { return static_cast<Type>(header.type); }
+
+        /// Return a copy of the encoded bytes of the current key.
+        string
+        getKey()
+        {
+            string key(header.length, '\0');
+            buffer.copy(offset + sizeof32(Header), header.length, &key[0]);
+            return key;
+        }
+
+      PRIVATE:
+        /// Copy out the header at #offset, if there is one.
+        void
+        loadHeader()
+        {
+            if (!isDone())
+                buffer.copy(offset, sizeof32(header), &header);
+        }
+
+        /// Buffer holding the keys.
+        Buffer& buffer;
+
+        /// Offset of the current key's header in #buffer.
+        uint32_t offset;
+
+        /// Offset just past the last key in #buffer.
+        uint32_t end;
+
+        /// Copy of the current key's header.
+        Header header;
+
+        DISALLOW_COPY_AND_ASSIGN(Iterator);
+    };
+
+    /**
+     * Find the key an object carries for a particular index.
+     *
+     * \param buffer
+     *      Buffer containing a well-formed set of secondary keys.
+     * \param offset
+     *      Offset of the set within the buffer.
+     * \param length
+     *      Length of the set in bytes.
+     * \param indexId
+     *      Index whose key is wanted.
+     * \param[out] key
+     *      If found, the encoded key is returned here.
+     * \return
+     *      True if the set holds a key for the index, otherwise false.
+     */
+    static bool
+    find(Buffer& buffer, uint32_t offset, uint32_t length, uint8_t indexId,
+         string* key)
+    {
+        for (Iterator it(buffer, offset, length); !it.isDone(); it.next()) {
+            if (it.getIndexId() == indexId) {
+                *key = it.getKey();
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /**
+     * Check that a range of a buffer holds a well-formed set of secondary
+     * keys: every header and key lies within the range, types are known,
+     * UINT64 keys are 8 bytes long, and no index appears twice. Sets that
+     * come from clients must pass this check before they are stored.
+     *
+     * \param buffer
+     *      Buffer containing the set of secondary keys.
+     * \param offset
+     *      Offset of the set within the buffer.
+     * \param length
+     *      Length of the set in bytes.
+     */
+    static bool
+    isValid(Buffer& buffer, uint32_t offset, uint32_t length)
+    {
+        if (offset + length > buffer.getTotalLength())
+            return false;
+
+        bool seen[256] = { false };
+        uint32_t end = offset + length;
+        while (offset < end) {
+            Header header;
+            if (end - offset < sizeof32(header))
+                return false;
+            buffer.copy(offset, sizeof32(header), &header);
+            offset += sizeof32(header);
+            if (header.length > end - offset)
+                return false;
+            if (header.type == UINT64) {
+                if (header.length != sizeof(uint64_t))
+                    return false;
+            } else if (header.type != STRING) {
+                return false;
+            }
+            if (seen[header.indexId])
+                return false;
+            seen[header.indexId] = true;
+            offset += header.length;
+        }
+        return true;
+    }
+
+  PRIVATE:
+    /**
+     * Append the header for a new key to a set of secondary keys.
+     */
+    static void
+    appendHeader(Buffer& buffer, uint8_t indexId, Type type,
+                 uint16_t length)
+    {
+        Header* header = new(&buffer, APPEND) Header;
+        header->indexId = indexId;
+        header->type = static_cast<uint8_t>(type);
+        header->length = length;
+    }
+};
+
+} // namespace RAMCloud
+
+#endif // RAMCLOUD_INDEXKEY_H
@@ -0,0 +1,223 @@
+/* Copyright (c) 2013 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "IndexLookup.h"
+#include "ShortMacros.h"
+
+namespace RAMCloud {
+
+/**
+ * Compare two byte strings the way std::string does.
+ */
+static int
+compareKeys(const char* a, uint16_t aLength, const char* b, uint16_t bLength)
+{
+    uint16_t length = std::min(aLength, bLength);
+    if (length > 0) {
+        int cmp = memcmp(a, b, length);
+        if (cmp != 0)
+            return cmp;
+    }
+    return aLength - bLength;
+}
+
+/**
+ * Order results by secondary key, then by primary key, as the masters do.
+ */
+bool
+IndexLookup::Result::operator<(const Result& other) const
+{
+    int cmp = compareKeys(indexKey, header.indexKeyLength,
+                          other.indexKey, other.header.indexKeyLength);
+    if (cmp != 0)
+        return cmp < 0;
+    return compareKeys(primaryKey, header.primaryKeyLength,
+                       other.primaryKey, other.header.primaryKeyLength) < 0;
+}
+
+/**
+ * Constructor for IndexLookup objects. No requests are issued until
+ * #hasNext() or #next() is first called.
+ *
+ * \param ramcloud
+ *      Overall information about the RAMCloud cluster to use for this
+ *      lookup.
+ * \param tableId
+ *      Identifier for the table whose index is to be searched.
+ * \param indexId
+ *      Identifies the index within the table.
+ * \param firstKey
+ *      Smallest secondary key to return, encoded as described in IndexKey
+ *      (for example, by IndexKey::encode()).
+ * \param lastKey
+ *      Largest secondary key to return.
+ * \param returnObjects
+ *      If true, the values of the objects are returned along with their
+ *      keys. Otherwise #getValue() always returns NULL.
+ * \param batchSize
+ *      Maximum number of results to fetch from a master in one request.
+ */
+IndexLookup::IndexLookup(RamCloud& ramcloud, uint64_t tableId,
+                         uint8_t indexId, const string& firstKey,
+                         const string& lastKey, bool returnObjects,
+                         uint32_t batchSize)
+    : ramcloud(ramcloud)
+    , tableId(tableId)
+    , indexId(indexId)
+    , firstKey(firstKey)
+    , lastKey(lastKey)
+    , returnObjects(returnObjects)
+    , batchSize(batchSize)
+    , started(false)
+    , tablets()
+    , current()
+{
+}
+
+IndexLookup::~IndexLookup()
+{
+    foreach (Tablet* tablet, tablets)
+        delete tablet;
+}
+
+/**
+ * Test if any objects remain to be returned. This may contact masters to
+ * fetch more results, after which the keys and value of the current object
+ * are no longer valid.
+ *
+ * \return
+ *      True if any objects remain, or false otherwise.
+ */
+bool
+IndexLookup::hasNext()
+{
+    start();
+
+    // Every tablet must have its next result on hand before the smallest
+    // can be chosen.
+    bool found = false;
+    foreach (Tablet* tablet, tablets) {
+        while (tablet->numResults == 0 && tablet->haveNext)
+            fetch(tablet);
+        if (tablet->numResults > 0)
+            found = true;
+    }
+    return found;
+}
+
+/**
+ * Advance to the next object, making its keys, version, and value available
+ * through the accessors. These remain valid until the next call to
+ * #hasNext() or #next(). Objects are returned in secondary key order; an
+ * object that is written or removed during the lookup may or may not be
+ * returned. The caller must check #hasNext() first.
+ */
+void
+IndexLookup::next()
+{
+    if (!hasNext())
+        throw ObjectDoesntExistException(HERE);
+
+    // Merge the sorted runs returned by each tablet. Tables have few
+    // tablets, so a linear scan for the smallest head is cheap enough.
+    Tablet* smallest = NULL;
+    foreach (Tablet* tablet, tablets) {
+        if (tablet->numResults == 0)
+            continue;
+        if (smallest == NULL || tablet->head < smallest->head)
+            smallest = tablet;
+    }
+
+    current = smallest->head;
+    smallest->numResults--;
+    if (smallest->numResults > 0)
+        loadHead(smallest);
+}
+
+/**
+ * Request the next batch of results from a tablet, replacing any results
+ * left from the previous batch.
+ *
+ * \param tablet
+ *      Tablet whose results are to be fetched.
+ * \return
+ *      The first key hash of the next tablet in the table, or 0 if this
+ *      is the last one.
+ */
+uint64_t
+IndexLookup::fetch(Tablet* tablet)
+{
+    string key = firstKey;
+    string primaryKey;
+    if (tablet->haveNext) {
+        key = tablet->nextKey;
+        primaryKey = tablet->nextPrimaryKey;
+    }
+
+    uint64_t nextTabletHash = ramcloud.lookupIndexKeys(tableId,
+        tablet->firstHash, indexId,
+        key.data(), downCast<uint16_t>(key.size()),
+        primaryKey.data(), downCast<uint16_t>(primaryKey.size()),
+        lastKey.data(), downCast<uint16_t>(lastKey.size()),
+        batchSize, returnObjects, tablet->results, &tablet->numResults,
+        &tablet->haveNext, &tablet->nextKey, &tablet->nextPrimaryKey);
+    tablet->offset = 0;
+    if (tablet->numResults > 0)
+        loadHead(tablet);
+    return nextTabletHash;
+}
+
+/**
+ * Parse the result at a tablet's current offset into its #Tablet::head
+ * and advance the offset past it.
+ */
+void
+IndexLookup::loadHead(Tablet* tablet)
+{
+    Result& head = tablet->head;
+    Buffer& results = tablet->results;
+    results.copy(tablet->offset, sizeof32(head.header), &head.header);
+    uint32_t offset = tablet->offset + sizeof32(head.header);
+    head.indexKey = static_cast<const char*>(
+        results.getRange(offset, head.header.indexKeyLength));
+    offset += head.header.indexKeyLength;
+    head.primaryKey = static_cast<const char*>(
+        results.getRange(offset, head.header.primaryKeyLength));
+    offset += head.header.primaryKeyLength;
+    head.value = results.getRange(offset, head.header.valueLength);
+    tablet->offset = offset + head.header.valueLength;
+}
+
+/**
+ * Used internally by #hasNext() to fetch the first batch of results from
+ * every tablet of the table, which is needed before any result can be
+ * known to be the smallest.
+ */
+void
+IndexLookup::start()
+{
+    if (started)
+        return;
+
+    uint64_t tabletFirstHash = 0;
+    do {
+        Tablet* tablet = new Tablet(tabletFirstHash);
+        tablets.push_back(tablet);
+        tabletFirstHash = fetch(tablet);
+    } while (tabletFirstHash != 0);
+    started = true;
+}
+
+} // namespace RAMCloud
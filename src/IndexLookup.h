@@ -0,0 +1,162 @@
+/* Copyright (c) 2013 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef RAMCLOUD_INDEXLOOKUP_H
+#define RAMCLOUD_INDEXLOOKUP_H
+
+#include "IndexKey.h"
+#include "RamCloud.h"
+
+namespace RAMCloud {
+
+/**
+ * This class provides the client-side interface for secondary index lookups;
+ * each instance of this class returns the objects of one table whose keys in
+ * one index lie within a given range, in order of secondary key (objects with
+ * equal secondary keys are ordered by primary key).
+ *
+ * Each master indexes only the objects in its own tablets, so an instance
+ * of this class queries every tablet of the table and merges the results.
+ */
+class IndexLookup {
+  public:
+    IndexLookup(RamCloud& ramcloud, uint64_t tableId, uint8_t indexId,
+                const string& firstKey, const string& lastKey,
+                bool returnObjects = true, uint32_t batchSize = 1000);
+    ~IndexLookup();
+    bool hasNext();
+    void next();
+
+    /// Encoded secondary key of the current object.
+    const void* getIndexKey() { return current.indexKey; }
+    /// Length in bytes of the current object's secondary key.
+    uint16_t getIndexKeyLength() { return current.header.indexKeyLength; }
+    /// Primary key of the current object.
+    const void* getPrimaryKey() { return current.primaryKey; }
+    /// Length in bytes of the current object's primary key.
+    uint16_t getPrimaryKeyLength() { return current.header.primaryKeyLength; }
+    /// Value of the current object; NULL unless objects were requested.
+    const void* getValue() { return current.value; }
+    /// Length in bytes of the current object's value.
+    uint32_t getValueLength() { return current.header.valueLength; }
+    /// Version of the current object.
+    uint64_t getVersion() { return current.header.version; }
+
+  PRIVATE:
+    /**
+     * A result returned by a master. The pointers refer to the Buffer of
+     * the Tablet it came from.
+     */
+    struct Result {
+        Result()
+            : header()
+            , indexKey(NULL)
+            , primaryKey(NULL)
+            , value(NULL)
+        {
+            memset(&header, 0, sizeof(header));
+        }
+
+        bool operator<(const Result& other) const;
+
+        WireFormat::LookupIndexKeys::Result header;
+        const char* indexKey;
+        const char* primaryKey;
+        const void* value;
+    };
+
+    /**
+     * Lookup state for one tablet of the table.
+     */
+    struct Tablet {
+        explicit Tablet(uint64_t firstHash)
+            : firstHash(firstHash)
+            , results()
+            , numResults(0)
+            , offset(0)
+            , head()
+            , haveNext(false)
+            , nextKey()
+            , nextPrimaryKey()
+        {
+        }
+
+        /// First key hash of the tablet; identifies it in requests.
+        uint64_t firstHash;
+
+        /// Results of the last request to this tablet.
+        Buffer results;
+
+        /// Number of results in #results not yet consumed, including #head.
+        uint32_t numResults;
+
+        /// Offset in #results of the result following #head.
+        uint32_t offset;
+
+        /// The smallest result from this tablet not yet returned, if
+        /// #numResults is non-zero.
+        Result head;
+
+        /// True if the tablet holds results beyond those in #results.
+        bool haveNext;
+
+        /// If #haveNext, where to continue the lookup in this tablet.
+        string nextKey;
+        string nextPrimaryKey;
+
+        DISALLOW_COPY_AND_ASSIGN(Tablet);
+    };
+
+    uint64_t fetch(Tablet* tablet);
+    void loadHead(Tablet* tablet);
+    void start();
+
+    /// The RamCloud master object.
+    RamCloud& ramcloud;
+
+    /// The table whose index is being searched.
+    uint64_t tableId;
+
+    /// Identifies the index within the table.
+    uint8_t indexId;
+
+    /// Smallest secondary key to return.
+    string firstKey;
+
+    /// Largest secondary key to return.
+    string lastKey;
+
+    /// Whether values are to be returned along with keys.
+    bool returnObjects;
+
+    /// Maximum number of results to request from a tablet at once.
+    uint32_t batchSize;
+
+    /// Set once the first batch of results has been requested from every
+    /// tablet.
+    bool started;
+
+    /// One entry for each tablet of the table, in key hash order.
+    vector<Tablet*> tablets;
+
+    /// The result most recently returned by next().
+    Result current;
+
+    DISALLOW_COPY_AND_ASSIGN(IndexLookup);
+};
+
+} // end RAMCloud
+
+#endif  // RAMCLOUD_INDEXLOOKUP_H
@@ -0,0 +1,147 @@
+/* Copyright (c) 2013 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "TestUtil.h"
+#include "IndexLookup.h"
+#include "MockCluster.h"
+
+namespace RAMCloud {
+
+class IndexLookupTest : public ::testing::Test {
+  public:
+    Context context;
+    MockCluster cluster;
+    RamCloud ramcloud;
+    uint64_t tableId;
+
+  public:
+    IndexLookupTest()
+        : context()
+        , cluster(&context)
+        , ramcloud(&context, "mock:host=coordinator")
+        , tableId(-1)
+    {
+        Logger::get().setLogLevels(RAMCloud::SILENT_LOG_LEVEL);
+
+        ServerConfig config = ServerConfig::forTesting();
+        config.services = {WireFormat::MASTER_SERVICE,
+                           WireFormat::PING_SERVICE};
+        config.localLocator = "mock:host=master1";
+        cluster.addServer(config);
+        config.localLocator = "mock:host=master2";
+        cluster.addServer(config);
+
+        tableId = ramcloud.createTable("table", 2);
+    }
+
+    // Write an object whose key in index 1 is the given integer.
+    void
+    write(const char* key, uint64_t indexKey, const char* value)
+    {
+        Buffer secondaryKeys;
+        IndexKey::append(secondaryKeys, 1, indexKey);
+        ramcloud.write(tableId, key, downCast<uint16_t>(strlen(key)),
+                       value, downCast<uint32_t>(strlen(value)),
+                       secondaryKeys);
+    }
+
+    // Run a lookup on index 1, returning "primaryKey:value" for each result.
+    string
+    lookup(uint64_t first, uint64_t last, uint32_t batchSize = 1000)
+    {
+        IndexLookup lookup(ramcloud, tableId, 1, IndexKey::encode(first),
+                           IndexKey::encode(last), true, batchSize);
+        string result;
+        while (lookup.hasNext()) {
+            lookup.next();
+            if (result.size() > 0)
+                result += " ";
+            result += string(static_cast<const char*>(lookup.getPrimaryKey()),
+                             lookup.getPrimaryKeyLength());
+            result += ":";
+            result += string(static_cast<const char*>(lookup.getValue()),
+                             lookup.getValueLength());
+        }
+        return result;
+    }
+
+    DISALLOW_COPY_AND_ASSIGN(IndexLookupTest);
+};
+
+TEST_F(IndexLookupTest, basics) {
+    // Keys "0".."4" are spread over both masters (see TableEnumeratorTest).
+    write("0", 40, "a");
+    write("1", 10, "b");
+    write("2", 30, "c");
+    write("3", 20, "d");
+    write("4", 50, "e");
+
+    EXPECT_EQ("1:b 3:d 2:c 0:a 4:e", lookup(0, 100));
+    EXPECT_EQ("3:d 2:c 0:a", lookup(20, 40));
+    EXPECT_EQ("", lookup(41, 49));
+}
+
+TEST_F(IndexLookupTest, batches) {
+    write("0", 7, "a");
+    write("1", 7, "b");
+    write("2", 7, "c");
+    write("3", 6, "d");
+    write("4", 8, "e");
+
+    // Equal secondary keys are ordered by primary key, and resuming a
+    // tablet's lookup must neither skip nor repeat entries.
+    EXPECT_EQ("3:d 0:a 1:b 2:c 4:e", lookup(0, 100, 1));
+}
+
+TEST_F(IndexLookupTest, overwriteAndRemove) {
+    write("0", 1, "a");
+    write("1", 2, "b");
+    write("2", 3, "c");
+    write("1", 9, "B");
+    ramcloud.remove(tableId, "2", 1);
+
+    EXPECT_EQ("0:a 1:B", lookup(0, 100));
+
+    // Objects written without secondary keys drop out of the index.
+    ramcloud.write(tableId, "0", 1, "x", 1);
+    EXPECT_EQ("1:B", lookup(0, 100));
+}
+
+TEST_F(IndexLookupTest, keysOnly) {
+    write("0", 5, "abc");
+
+    IndexLookup lookup(ramcloud, tableId, 1, IndexKey::encode(0),
+                       IndexKey::encode(10), false);
+    EXPECT_TRUE(lookup.hasNext());
+    lookup.next();
+    EXPECT_EQ(IndexKey::encode(5),
+              string(static_cast<const char*>(lookup.getIndexKey()),
+                     lookup.getIndexKeyLength()));
+    EXPECT_EQ(1U, lookup.getPrimaryKeyLength());
+    EXPECT_TRUE(lookup.getValue() == NULL);
+    EXPECT_EQ(0U, lookup.getValueLength());
+    EXPECT_NE(0U, lookup.getVersion());
+    EXPECT_FALSE(lookup.hasNext());
+}
+
+TEST_F(IndexLookupTest, write_malformedSecondaryKeys) {
+    Buffer secondaryKeys;
+    IndexKey::append(secondaryKeys, 1, 5);
+    IndexKey::append(secondaryKeys, 1, 6);
+    EXPECT_THROW(ramcloud.write(tableId, "0", 1, "a", 1, secondaryKeys),
+                 RequestFormatError);
+}
+
+}  // namespace RAMCloud
@@ -0,0 +1,190 @@
+/* Copyright (c) 2013 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "IndexletManager.h"
+
+namespace RAMCloud {
+
+/**
+ * Construct an IndexletManager with no indexes.
+ */
+IndexletManager::IndexletManager()
+    : indexes()
+    , lock("IndexletManager::lock")
+{
+}
+
+/**
+ * Add an entry to the appropriate index for each secondary key carried by
+ * an object. Entries that are already present are left alone, so this may
+ * safely be called more than once for the same object.
+ *
+ * \param object
+ *      Object whose secondary keys are to be indexed.
+ */
+void
+IndexletManager::insertEntries(Object& object)
+{
+    if (object.getSecondaryKeysLength() == 0)
+        return;
+
+    Buffer keys;
+    object.appendSecondaryKeysToBuffer(keys);
+    string primaryKey(static_cast<const char*>(object.getKey()),
+                      object.getKeyLength());
+    KeyHash primaryKeyHash = Key::getHash(object.getTableId(),
+                                          object.getKey(),
+                                          object.getKeyLength());
+
+    Lock _(lock);
+    for (IndexKey::Iterator it(keys, 0, keys.getTotalLength());
+         !it.isDone(); it.next()) {
+        Index& index = indexes[IndexId(object.getTableId(), it.getIndexId())];
+        index.insert(Entry(it.getKey(), primaryKey, primaryKeyHash));
+    }
+}
+
+/**
+ * Remove the entries that were added for an object by insertEntries().
+ *
+ * \param object
+ *      Object whose secondary keys are no longer to be indexed.
+ */
+void
+IndexletManager::removeEntries(Object& object)
+{
+    if (object.getSecondaryKeysLength() == 0)
+        return;
+
+    Buffer keys;
+    object.appendSecondaryKeysToBuffer(keys);
+    string primaryKey(static_cast<const char*>(object.getKey()),
+                      object.getKeyLength());
+
+    Lock _(lock);
+    for (IndexKey::Iterator it(keys, 0, keys.getTotalLength());
+         !it.isDone(); it.next()) {
+        IndexMap::iterator index =
+            indexes.find(IndexId(object.getTableId(), it.getIndexId()));
+        if (index == indexes.end())
+            continue;
+        index->second.erase(Entry(it.getKey(), primaryKey, 0));
+    }
+}
+
+/**
+ * Remove a single entry from an index. Used to discard entries found to be
+ * stale during lookups.
+ *
+ * \param tableId
+ *      Table the index belongs to.
+ * \param indexId
+ *      Identifies the index within the table.
+ * \param entry
+ *      The entry to remove. Nothing happens if it isn't in the index.
+ */
+void
+IndexletManager::removeEntry(uint64_t tableId, uint8_t indexId,
+                             const Entry& entry)
+{
+    Lock _(lock);
+    IndexMap::iterator index = indexes.find(IndexId(tableId, indexId));
+    if (index != indexes.end())
+        index->second.erase(entry);
+}
+
+/**
+ * Scan a range of an index, in order, collecting the entries whose objects
+ * lie in a given range of primary key hashes (typically one tablet).
+ *
+ * \param tableId
+ *      Table the index belongs to.
+ * \param indexId
+ *      Identifies the index within the table.
+ * \param firstKey
+ *      Smallest secondary key to return.
+ * \param firstPrimaryKey
+ *      Entries for #firstKey whose primary key sorts before this are skipped.
+ *      Pass an empty string to start at the first entry for #firstKey; pass
+ *      the primary key of a previously returned #nextEntry to resume a scan.
+ * \param lastKey
+ *      Largest secondary key to return.
+ * \param firstKeyHash
+ *      Only entries whose primary key hash is at least this are returned.
+ * \param lastKeyHash
+ *      Only entries whose primary key hash is at most this are returned.
+ * \param maxEntries
+ *      Maximum number of entries to return.
+ * \param[out] entries
+ *      Matching entries are appended here, in index order.
+ * \param[out] nextEntry
+ *      If the scan stopped because #maxEntries were found and more matching
+ *      entries remain, the first of them is returned here. Otherwise this
+ *      is left empty.
+ * \return
+ *      True if more matching entries remain (#nextEntry is filled in),
+ *      false if the scan reached #lastKey.
+ */
+bool
+IndexletManager::lookup(uint64_t tableId, uint8_t indexId,
+                        const string& firstKey, const string& firstPrimaryKey,
+                        const string& lastKey,
+                        KeyHash firstKeyHash, KeyHash lastKeyHash,
+                        uint32_t maxEntries, vector<Entry>* entries,
+                        Tub<Entry>* nextEntry)
+{
+    nextEntry->destroy();
+
+    Lock _(lock);
+    IndexMap::iterator index = indexes.find(IndexId(tableId, indexId));
+    if (index == indexes.end())
+        return false;
+
+    uint32_t found = 0;
+    Index::iterator it =
+        index->second.lower_bound(Entry(firstKey, firstPrimaryKey, 0));
+    for (; it != index->second.end() && it->indexKey <= lastKey; ++it) {
+        if (it->primaryKeyHash < firstKeyHash ||
+            it->primaryKeyHash > lastKeyHash)
+            continue;
+        if (found == maxEntries) {
+            nextEntry->construct(*it);
+            return true;
+        }
+        entries->push_back(*it);
+        found++;
+    }
+    return false;
+}
+
+/**
+ * Return the number of entries in an index. Used mostly for testing.
+ *
+ * \param tableId
+ *      Table the index belongs to.
+ * \param indexId
+ *      Identifies the index within the table.
+ */
+size_t
+IndexletManager::getEntryCount(uint64_t tableId, uint8_t indexId)
+{
+    Lock _(lock);
+    IndexMap::iterator index = indexes.find(IndexId(tableId, indexId));
+    if (index == indexes.end())
+        return 0;
+    return index->second.size();
+}
+
+} // namespace RAMCloud
@@ -0,0 +1,135 @@
+/* Copyright (c) 2013 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef RAMCLOUD_INDEXLETMANAGER_H
+#define RAMCLOUD_INDEXLETMANAGER_H
+
+#include <map>
+#include <set>
+
+#include "Common.h"
+#include "IndexKey.h"
+#include "Key.h"
+#include "Object.h"
+#include "SpinLock.h"
+
+namespace RAMCloud {
+
+/**
+ * The IndexletManager keeps the secondary indexes for the objects stored on a
+ * master. There is one ordered index per (table, index) pair; it maps each
+ * secondary key (see IndexKey) to the primary keys of the objects carrying it.
+ * Indexes are partitioned the same way as the data: a master only indexes the
+ * objects in the tablets it holds, so an index "tablet" (indexlet) moves,
+ * splits and is recovered together with the data tablet it covers.
+ *
+ * The index itself is never written to the log. Secondary keys are stored as
+ * part of each object, and ObjectManager adds index entries whenever it adds
+ * an object to its hash table, including while replaying segments during
+ * recovery. The index is therefore rebuilt from the log like the hash table.
+ *
+ * Entries are removed eagerly when ObjectManager overwrites or removes an
+ * object, but callers must still treat the index as a hint: entries for
+ * objects purged in bulk (dropped tablets, aborted recoveries) are left behind
+ * and are only discarded when a lookup finds they no longer match a live
+ * object (see ObjectManager::lookupIndexKeys).
+ *
+ * This class is thread-safe.
+ */
+class IndexletManager {
+  public:
+    /**
+     * A single index entry: a secondary key and the primary key of an object
+     * that carries it. Entries sort by secondary key and then by primary key.
+     */
+    struct Entry {
+        Entry(const string& indexKey, const string& primaryKey,
+              KeyHash primaryKeyHash)
+            : indexKey(indexKey)
+            , primaryKey(primaryKey)
+            , primaryKeyHash(primaryKeyHash)
+        {
+        }
+
+        bool
+        operator<(const Entry& other) const
+        {
+            int cmp = indexKey.compare(other.indexKey);
+            if (cmp != 0)
+                return cmp < 0;
+            return primaryKey < other.primaryKey;
+        }
+
+        bool
+        operator==(const Entry& other) const
+        {
+            return indexKey == other.indexKey &&
+                   primaryKey == other.primaryKey;
+        }
+
+        /// Encoded secondary key.
+        string indexKey;
+
+        /// Binary string key of the object carrying #indexKey.
+        string primaryKey;
+
+        /// Hash of the object's (tableId, primaryKey); used to decide which
+        /// tablet the object belongs to.
+        KeyHash primaryKeyHash;
+    };
+
+    IndexletManager();
+    void insertEntries(Object& object);
+    void removeEntries(Object& object);
+    void removeEntry(uint64_t tableId, uint8_t indexId, const Entry& entry);
+    bool lookup(uint64_t tableId, uint8_t indexId,
+                const string& firstKey, const string& firstPrimaryKey,
+                const string& lastKey,
+                KeyHash firstKeyHash, KeyHash lastKeyHash,
+                uint32_t maxEntries, vector<Entry>* entries,
+                Tub<Entry>* nextEntry);
+    size_t getEntryCount(uint64_t tableId, uint8_t indexId);
+
+  PRIVATE:
+    /// Ordered set of entries making up one index on one master. This is a
+    /// balanced search tree, so range scans cost O(log n) to start and then
+    /// constant time per entry.
+    typedef std::set<Entry> Index;
+
+    /// Identifies an index: (tableId, indexId).
+    typedef std::pair<uint64_t, uint8_t> IndexId;
+
+    /// All of the indexes on this master.
+    typedef std::map<IndexId, Index> IndexMap;
+
+    /// Lock guard type used to hold the monitor spinlock and automatically
+    /// release it.
+    typedef std::lock_guard<SpinLock> Lock;
+
+    /// Every index that has had an entry on this master. Empty indexes are
+    /// not removed; they cost only a few bytes.
+    IndexMap indexes;
+
+    /// Serializes all access to #indexes. Callers may hold one of
+    /// ObjectManager's hash table bucket locks when calling in, but no
+    /// bucket lock is ever acquired while this lock is held.
+    SpinLock lock;
+
+    DISALLOW_COPY_AND_ASSIGN(IndexletManager);
+};
+
+} // namespace RAMCloud
+
+#endif // RAMCLOUD_INDEXLETMANAGER_H
@@ -0,0 +1,159 @@
+/* Copyright (c) 2013 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "TestUtil.h"
+#include "IndexletManager.h"
+
+namespace RAMCloud {
+
+class IndexletManagerTest : public ::testing::Test {
+  public:
+    IndexletManager manager;
+    Buffer value;
+
+    IndexletManagerTest()
+        : manager()
+        , value()
+    {
+        value.append("value", 5);
+    }
+
+    // Index an object in table 1 with the given key in index 1 and a
+    // UINT64 key of 7 in index 2.
+    void
+    insert(const char* primaryKey, const char* indexKey)
+    {
+        Buffer secondaryKeys;
+        IndexKey::append(secondaryKeys, 1, indexKey,
+                         downCast<uint16_t>(strlen(indexKey)));
+        IndexKey::append(secondaryKeys, 2, 7);
+        Key key(1, primaryKey, downCast<uint16_t>(strlen(primaryKey)));
+        Object object(key, value, 1, 0, &secondaryKeys);
+        manager.insertEntries(object);
+    }
+
+    // Return the "indexKey/primaryKey" pairs found by a lookup on index 1.
+    string
+    lookup(const char* first, const char* firstPrimary, const char* last,
+           uint32_t maxEntries = 100, KeyHash firstHash = 0,
+           KeyHash lastHash = ~0UL)
+    {
+        vector<IndexletManager::Entry> entries;
+        Tub<IndexletManager::Entry> next;
+        bool more = manager.lookup(1, 1, first, firstPrimary, last,
+                                   firstHash, lastHash, maxEntries,
+                                   &entries, &next);
+        EXPECT_EQ(more, static_cast<bool>(next));
+        string result;
+        foreach (IndexletManager::Entry& entry, entries) {
+            if (result.size() > 0)
+                result += " ";
+            result += entry.indexKey + "/" + entry.primaryKey;
+        }
+        if (next)
+            result += " next " + next->indexKey + "/" + next->primaryKey;
+        return result;
+    }
+
+    DISALLOW_COPY_AND_ASSIGN(IndexletManagerTest);
+};
+
+TEST_F(IndexletManagerTest, insertEntries) {
+    insert("a", "m");
+    insert("b", "k");
+    insert("a", "m");
+    EXPECT_EQ(2U, manager.getEntryCount(1, 1));
+    EXPECT_EQ(2U, manager.getEntryCount(1, 2));
+    EXPECT_EQ(0U, manager.getEntryCount(1, 3));
+    EXPECT_EQ(0U, manager.getEntryCount(2, 1));
+
+    // Objects without secondary keys are ignored.
+    Key key(1, "c", 1);
+    Object object(key, value, 1, 0);
+    manager.insertEntries(object);
+    EXPECT_EQ(2U, manager.getEntryCount(1, 1));
+}
+
+TEST_F(IndexletManagerTest, removeEntries) {
+    insert("a", "m");
+    insert("b", "k");
+
+    Buffer secondaryKeys;
+    IndexKey::append(secondaryKeys, 1, "m", 1);
+    Key key(1, "a", 1);
+    Object object(key, value, 1, 0, &secondaryKeys);
+    manager.removeEntries(object);
+    EXPECT_EQ(1U, manager.getEntryCount(1, 1));
+    EXPECT_EQ(2U, manager.getEntryCount(1, 2));
+    EXPECT_EQ("k/b", lookup("", "", "z"));
+
+    // Removing again, or from a table with no index, is harmless.
+    manager.removeEntries(object);
+    Key otherKey(5, "a", 1);
+    Object other(otherKey, value, 1, 0, &secondaryKeys);
+    manager.removeEntries(other);
+    EXPECT_EQ(1U, manager.getEntryCount(1, 1));
+}
+
+TEST_F(IndexletManagerTest, removeEntry) {
+    insert("a", "m");
+    manager.removeEntry(1, 1, IndexletManager::Entry("m", "a", 0));
+    EXPECT_EQ(0U, manager.getEntryCount(1, 1));
+    manager.removeEntry(1, 1, IndexletManager::Entry("m", "a", 0));
+    manager.removeEntry(9, 1, IndexletManager::Entry("m", "a", 0));
+}
+
+TEST_F(IndexletManagerTest, lookup_range) {
+    insert("a", "m");
+    insert("b", "k");
+    insert("c", "x");
+    insert("d", "k");
+
+    EXPECT_EQ("k/b k/d m/a x/c", lookup("", "", "z"));
+    EXPECT_EQ("k/b k/d m/a", lookup("k", "", "m"));
+    EXPECT_EQ("k/d m/a", lookup("k", "c", "m"));
+    EXPECT_EQ("", lookup("n", "", "w"));
+    EXPECT_EQ("", lookup("", "", "z", 100, 0, 0));
+}
+
+TEST_F(IndexletManagerTest, lookup_maxEntries) {
+    insert("a", "m");
+    insert("b", "k");
+    insert("c", "x");
+
+    EXPECT_EQ("k/b m/a next x/c", lookup("", "", "z", 2));
+    EXPECT_EQ("x/c", lookup("x", "c", "z", 2));
+    EXPECT_EQ("k/b m/a x/c", lookup("", "", "z", 3));
+}
+
+TEST_F(IndexletManagerTest, lookup_keyHashRange) {
+    insert("a", "m");
+    insert("b", "k");
+    KeyHash hashA = Key::getHash(1, "a", 1);
+    EXPECT_EQ("m/a", lookup("", "", "z", 100, hashA, hashA));
+
+    // Entries outside the hash range don't count towards maxEntries.
+    EXPECT_EQ("m/a", lookup("", "", "z", 1, hashA, hashA));
+}
+
+TEST_F(IndexletManagerTest, lookup_noSuchIndex) {
+    vector<IndexletManager::Entry> entries;
+    Tub<IndexletManager::Entry> next;
+    EXPECT_FALSE(manager.lookup(1, 1, "", "", "z", 0, ~0UL, 10,
+                                &entries, &next));
+    EXPECT_EQ(0U, entries.size());
+}
+
+}  // namespace RAMCloud
@@ -47,12 +47,14 @@ Key::Key(LogEntryType type, Buffer& buffer)
         tableId = object.getTableId();
         stringKeyLength = object.getKeyLength();
         stringKey = object.getKey();
+        hash.construct(object.getKeyHash());
 
     } else if (type == LOG_ENTRY_TYPE_OBJTOMB) {
         ObjectTombstone tomb(buffer);
         tableId = tomb.getTableId();
         stringKeyLength = tomb.getKeyLength();
         stringKey = tomb.getKey();
+        hash.construct(tomb.getKeyHash());
 
     } else {
         throw FatalError(HERE, "unknown Log::Entry type");
@@ -108,6 +110,28 @@ Key::Key(uint64_t tableId, const void* stringKey, uint16_t stringKeyLength)
 {
 }
 
+/**
+ * Construct a new key object whose hash is already known, such as one read
+ * from an object or tombstone in the log (see Object::getKeyHash()).
+ *
+ * \param tableId
+ *      64-bit table identifier portion of this key.
+ * \param stringKey
+ *      Pointer to the binary string key.
+ * \param stringKeyLength
+ *      Length of the binary string key in bytes.
+ * \param keyHash
+ *      The value getHash() returns for this key.
+ */
+Key::Key(uint64_t tableId, const void* stringKey, uint16_t stringKeyLength,
+         KeyHash keyHash)
+    : tableId(tableId),
+      stringKey(stringKey),
+      stringKeyLength(stringKeyLength),
+      hash(keyHash)
+{
+}
+
 /**
  * Return the 64-bit hash of this key, which covers the table identifier and the
  * binary string key. The first invocation will compute the key and cache it for
@@ -122,6 +146,21 @@ Key::getHash()
     return *hash;
 }
 
+/**
+ * Supply the hash of this key when it is already known, for example because
+ * the client that sent a request computed it to find this master, so that
+ * getHash() needn't compute it again.
+ *
+ * \param knownHash
+ *      The value getHash() would return for this key.
+ */
+void
+Key::setHash(KeyHash knownHash)
+{
+    assert(knownHash == getHash(tableId, stringKey, stringKeyLength));
+    hash.construct(knownHash);
+}
+
 /**
  * Compare two keys for equality. This method tries to avoid full binary string
  * key comparison by first checking hashes (if available), table identifiers,
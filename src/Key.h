@@ -53,7 +53,10 @@ class Key {
     Key(uint64_t tableId, Buffer& buffer,
         uint32_t stringKeyOffset, uint16_t stringKeyLength);
     Key(uint64_t tableId, const void* stringKey, uint16_t stringKeyLength);
+    Key(uint64_t tableId, const void* stringKey, uint16_t stringKeyLength,
+        KeyHash keyHash);
     KeyHash getHash();
+    void setHash(KeyHash knownHash);
     bool operator==(const Key& other) const;
     bool operator!=(const Key& other) const;
     uint64_t getTableId() const;
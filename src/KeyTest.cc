@@ -52,9 +52,9 @@ TEST_F(KeyTest, constructor_fromLog)
     EXPECT_STREQ("blah", reinterpret_cast<const char*>(key3.getStringKey()));
     EXPECT_EQ(5U, key3.getStringKeyLength());
 
-    EXPECT_FALSE(key.hash);
-    EXPECT_FALSE(key2.hash);
-    EXPECT_FALSE(key3.hash);
+    // Entries in the log carry the key hash, so it needn't be recomputed.
+    EXPECT_EQ(key.getHash(), *key2.hash);
+    EXPECT_EQ(key.getHash(), *key3.hash);
 
     EXPECT_THROW(Key(LOG_ENTRY_TYPE_SEGHEADER, buffer), FatalError);
 }
@@ -86,6 +86,21 @@ TEST_F(KeyTest, constructor_fromVoidPointer) {
     EXPECT_FALSE(key.hash);
 }
 
+TEST_F(KeyTest, constructor_withHash) {
+    Key key(74, "na-na-na-na", 13, 0xbeefUL);
+    EXPECT_EQ(74U, key.getTableId());
+    EXPECT_EQ(0, memcmp("na-na-na-na", key.getStringKey(), 13));
+    EXPECT_EQ(13U, key.getStringKeyLength());
+    EXPECT_EQ(0xbeefUL, key.getHash());
+}
+
+TEST_F(KeyTest, setHash) {
+    Key key(82, "hey-hey-hey", 13);
+    key.setHash(0xed7cc41c7081ba0UL);
+    EXPECT_TRUE(key.hash);
+    EXPECT_EQ(0xed7cc41c7081ba0UL, key.getHash());
+}
+
 TEST_F(KeyTest, getHash) {
     Key key(82, "hey-hey-hey", 13);
     EXPECT_FALSE(key.hash);
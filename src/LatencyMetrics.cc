@@ -0,0 +1,299 @@
+/* Copyright (c) 2013 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "LatencyMetrics.h"
+
+namespace RAMCloud {
+
+__thread LatencyMetrics::ThreadBuffer* LatencyMetrics::threadBuffer = NULL;
+__thread int LatencyMetrics::currentOpcode = -1;
+std::mutex LatencyMetrics::mutex;
+std::vector<LatencyMetrics::ThreadBuffer*> LatencyMetrics::threadBuffers;
+
+/**
+ * Record one sample for a stage of the RPC that the current thread is
+ * executing. This is a no-op if no RPC is being executed (see #setOpcode).
+ *
+ * \param stage
+ *      Stage of the RPC that the sample measures.
+ * \param ticks
+ *      Duration of the stage, in Cycles::rdtsc() ticks.
+ */
+void
+LatencyMetrics::record(Stage stage, uint64_t ticks)
+{
+    if (currentOpcode < 0)
+        return;
+    record(stage, currentOpcode, ticks);
+}
+
+/**
+ * Record one sample for a stage of an RPC.
+ *
+ * \param stage
+ *      Stage of the RPC that the sample measures.
+ * \param opcode
+ *      Opcode of the RPC.
+ * \param ticks
+ *      Duration of the stage, in Cycles::rdtsc() ticks.
+ */
+void
+LatencyMetrics::record(Stage stage, uint32_t opcode, uint64_t ticks)
+{
+    if (opcode >= NUM_OPCODES)
+        opcode = WireFormat::ILLEGAL_RPC_TYPE;
+    ThreadBuffer* buffer = threadBuffer;
+    if (expect_false(buffer == NULL))
+        buffer = registerThread();
+    std::atomic<Counts*>& slot = buffer->counts[stage][opcode];
+    Counts* counts = slot.load(std::memory_order_relaxed);
+    if (expect_false(counts == NULL)) {
+        counts = new Counts;
+        slot.store(counts, std::memory_order_release);
+    }
+
+    // This thread is the only writer, so a separate load and store are
+    // safe and avoid the cost of a locked increment.
+    std::atomic<uint64_t>& bucket =
+            counts->buckets[bucketIndex(Cycles::toNanoseconds(ticks))];
+    bucket.store(bucket.load(std::memory_order_relaxed) + 1,
+                 std::memory_order_relaxed);
+}
+
+/**
+ * Discard all of the samples recorded so far. Samples recorded by other
+ * threads while this method runs may or may not be discarded.
+ */
+void
+LatencyMetrics::reset()
+{
+    std::lock_guard<std::mutex> _(mutex);
+    foreach (ThreadBuffer* buffer, threadBuffers) {
+        for (uint32_t stage = 0; stage < NUM_STAGES; stage++) {
+            for (uint32_t opcode = 0; opcode < NUM_OPCODES; opcode++) {
+                Counts* counts = buffer->counts[stage][opcode].load(
+                        std::memory_order_acquire);
+                if (counts == NULL)
+                    continue;
+                for (uint32_t i = 0; i < NUM_BUCKETS; i++)
+                    counts->buckets[i].store(0, std::memory_order_relaxed);
+            }
+        }
+    }
+}
+
+/**
+ * Merge the samples recorded by all threads and return them in a form
+ * that can be sent to another machine.
+ *
+ * \param[out] metrics
+ *      One histogram is appended to this for each stage and opcode with
+ *      at least one sample.
+ */
+void
+LatencyMetrics::serialize(ProtoBuf::LatencyMetrics& metrics)
+{
+    std::lock_guard<std::mutex> _(mutex);
+    uint64_t merged[NUM_BUCKETS];
+    for (uint32_t stage = 0; stage < NUM_STAGES; stage++) {
+        for (uint32_t opcode = 0; opcode < NUM_OPCODES; opcode++) {
+            memset(merged, 0, sizeof(merged));
+            uint32_t usedBuckets = 0;
+            foreach (ThreadBuffer* buffer, threadBuffers) {
+                Counts* counts = buffer->counts[stage][opcode].load(
+                        std::memory_order_acquire);
+                if (counts == NULL)
+                    continue;
+                for (uint32_t i = 0; i < NUM_BUCKETS; i++) {
+                    uint64_t count = counts->buckets[i].load(
+                            std::memory_order_relaxed);
+                    if (count == 0)
+                        continue;
+                    merged[i] += count;
+                    usedBuckets = std::max(usedBuckets, i + 1);
+                }
+            }
+            if (usedBuckets == 0)
+                continue;
+
+            ProtoBuf::LatencyMetrics_Histogram& histogram =
+                    *metrics.add_histogram();
+            histogram.set_opcode(WireFormat::opcodeSymbol(opcode));
+            histogram.set_stage(stageName(Stage(stage)));
+            for (uint32_t i = 0; i < usedBuckets; i++)
+                histogram.add_bucket_count(merged[i]);
+        }
+    }
+}
+
+/**
+ * Indicate that the current thread is about to execute an RPC; samples
+ * recorded by Timers or #record(Stage, uint64_t) are attributed to it
+ * until #clearOpcode is invoked.
+ *
+ * \param opcode
+ *      Opcode of the RPC.
+ */
+void
+LatencyMetrics::setOpcode(uint32_t opcode)
+{
+    if (opcode >= NUM_OPCODES)
+        opcode = WireFormat::ILLEGAL_RPC_TYPE;
+    currentOpcode = opcode;
+}
+
+/**
+ * Indicate that the current thread has finished executing its RPC (see
+ * #setOpcode).
+ */
+void
+LatencyMetrics::clearOpcode()
+{
+    currentOpcode = -1;
+}
+
+/**
+ * Return a human-readable name for a stage.
+ */
+const char*
+LatencyMetrics::stageName(Stage stage)
+{
+    switch (stage) {
+        case QUEUE:         return "queue";
+        case EXECUTE:       return "execute";
+        case LOG_APPEND:    return "logAppend";
+        case LOG_SYNC:      return "logSync";
+        default:            return "unknown";
+    }
+}
+
+/**
+ * Return the total number of samples in a histogram returned by
+ * #serialize.
+ */
+uint64_t
+LatencyMetrics::getCount(const ProtoBuf::LatencyMetrics_Histogram& h)
+{
+    uint64_t total = 0;
+    for (int i = 0; i < h.bucket_count_size(); i++)
+        total += h.bucket_count(i);
+    return total;
+}
+
+/**
+ * Estimate a percentile of a histogram returned by #serialize.
+ *
+ * \param h
+ *      Histogram to examine.
+ * \param percent
+ *      Which percentile to return, such as 50 for the median or 99.9.
+ * \return
+ *      The largest value, in nanoseconds, that could be in the bucket
+ *      holding the given percentile; 0 if the histogram is empty.
+ */
+uint64_t
+LatencyMetrics::getPercentile(const ProtoBuf::LatencyMetrics_Histogram& h,
+                              double percent)
+{
+    uint64_t total = getCount(h);
+    if (total == 0)
+        return 0;
+    uint64_t target = static_cast<uint64_t>(
+            static_cast<double>(total) * percent / 100.0);
+    if (target >= total)
+        target = total - 1;
+    uint64_t seen = 0;
+    int i = 0;
+    for (; i < h.bucket_count_size(); i++) {
+        seen += h.bucket_count(i);
+        if (seen > target)
+            break;
+    }
+    return bucketLowerBound(i + 1) - 1;
+}
+
+/**
+ * Find the histogram for a given opcode and stage among those returned
+ * by #serialize.
+ *
+ * \param metrics
+ *      Histograms to search.
+ * \param opcode
+ *      Name of the opcode, as returned by WireFormat::opcodeSymbol().
+ * \param stage
+ *      Stage of interest.
+ * \return
+ *      The histogram, or NULL if no samples were recorded for the opcode
+ *      and stage.
+ */
+const ProtoBuf::LatencyMetrics_Histogram*
+LatencyMetrics::find(const ProtoBuf::LatencyMetrics& metrics,
+                     const char* opcode, Stage stage)
+{
+    for (int i = 0; i < metrics.histogram_size(); i++) {
+        const ProtoBuf::LatencyMetrics_Histogram& h = metrics.histogram(i);
+        if (h.opcode() == opcode && h.stage() == stageName(stage))
+            return &h;
+    }
+    return NULL;
+}
+
+/**
+ * Return the index of the histogram bucket that holds a given value.
+ * Values below SUB_BUCKETS have a bucket each; larger values are grouped
+ * by their most significant bit and the SUB_BUCKET_BITS bits below it.
+ */
+uint32_t
+LatencyMetrics::bucketIndex(uint64_t value)
+{
+    if (value < SUB_BUCKETS)
+        return downCast<uint32_t>(value);
+    uint32_t msb = 63 - __builtin_clzll(value);
+    uint32_t shift = msb - SUB_BUCKET_BITS;
+    return (shift + 1) * SUB_BUCKETS +
+           downCast<uint32_t>((value >> shift) & (SUB_BUCKETS - 1));
+}
+
+/**
+ * Return the smallest value that falls into a given histogram bucket (the
+ * inverse of #bucketIndex). For the bucket after the last one this wraps
+ * around to 0.
+ */
+uint64_t
+LatencyMetrics::bucketLowerBound(uint32_t index)
+{
+    if (index < SUB_BUCKETS)
+        return index;
+    uint32_t shift = index / SUB_BUCKETS - 1;
+    if (shift >= 64 - SUB_BUCKET_BITS)
+        return 0;
+    return uint64_t(SUB_BUCKETS + index % SUB_BUCKETS) << shift;
+}
+
+/**
+ * Create the ThreadBuffer for the current thread and add it to the list
+ * consulted by #serialize.
+ */
+LatencyMetrics::ThreadBuffer*
+LatencyMetrics::registerThread()
+{
+    ThreadBuffer* buffer = new ThreadBuffer;
+    std::lock_guard<std::mutex> _(mutex);
+    threadBuffers.push_back(buffer);
+    threadBuffer = buffer;
+    return buffer;
+}
+
+} // namespace RAMCloud
@@ -0,0 +1,185 @@
+/* Copyright (c) 2013 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef RAMCLOUD_LATENCYMETRICS_H
+#define RAMCLOUD_LATENCYMETRICS_H
+
+#include <atomic>
+#include <mutex>
+
+#include "Common.h"
+#include "Cycles.h"
+#include "WireFormat.h"
+#include "LatencyMetrics.pb.h"
+
+namespace RAMCloud {
+
+/**
+ * This class collects latency distributions for the stages that an RPC
+ * passes through on a server: waiting for a worker thread, executing, and
+ * (for RPCs that modify the log) appending to the log and waiting for
+ * replication. Each stage keeps a separate histogram for each opcode, so
+ * that the server-side cost of an operation can be broken down without
+ * guessing from client-side times alone.
+ *
+ * Recording is cheap enough for the fast path: each thread records into
+ * its own buffer without locking or atomic read-modify-write operations,
+ * and the buffers are only merged when someone asks for the results
+ * (see #serialize). Histogram buckets are log-linear: each power of two is
+ * split into 8 buckets, so any value is known to within 12.5%.
+ *
+ * All methods are static; there is one set of histograms per process.
+ */
+class LatencyMetrics {
+  public:
+    /// The stages of an RPC whose latencies are recorded.
+    enum Stage {
+        /// From the time the dispatch thread receives a request until a
+        /// worker thread starts executing it.
+        QUEUE = 0,
+        /// Execution of the request by a worker thread, including any of
+        /// the stages below.
+        EXECUTE,
+        /// Appending entries to the log (AbstractLog::append).
+        LOG_APPEND,
+        /// Waiting for appended entries to be replicated (Log::sync).
+        LOG_SYNC,
+        NUM_STAGES
+    };
+
+    /**
+     * An instance of this class records the time from its construction
+     * until its destruction as one sample for a given stage of the RPC
+     * that the current thread is executing (see #setOpcode). Nothing is
+     * recorded if the thread isn't executing an RPC.
+     */
+    class Timer {
+      public:
+        explicit Timer(Stage stage)
+            : stage(stage)
+            , startTime(Cycles::rdtsc())
+        {
+        }
+
+        ~Timer()
+        {
+            record(stage, Cycles::rdtsc() - startTime);
+        }
+
+      PRIVATE:
+        /// Stage to which the sample belongs.
+        Stage stage;
+
+        /// Cycles::rdtsc() when the timer was constructed.
+        uint64_t startTime;
+
+        DISALLOW_COPY_AND_ASSIGN(Timer);
+    };
+
+    static void record(Stage stage, uint64_t ticks);
+    static void record(Stage stage, uint32_t opcode, uint64_t ticks);
+    static void reset();
+    static void serialize(ProtoBuf::LatencyMetrics& metrics);
+    static void setOpcode(uint32_t opcode);
+    static void clearOpcode();
+    static const char* stageName(Stage stage);
+
+    static uint64_t getCount(const ProtoBuf::LatencyMetrics_Histogram& h);
+    static uint64_t getPercentile(const ProtoBuf::LatencyMetrics_Histogram& h,
+                                  double percent);
+    static const ProtoBuf::LatencyMetrics_Histogram* find(
+            const ProtoBuf::LatencyMetrics& metrics, const char* opcode,
+            Stage stage);
+
+  PRIVATE:
+    /// The number of buckets that each power of two is divided into
+    /// is 2^SUB_BUCKET_BITS.
+    static const uint32_t SUB_BUCKET_BITS = 3;
+    static const uint32_t SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+
+    /// Enough buckets to cover every 64-bit value.
+    static const uint32_t NUM_BUCKETS = (64 - SUB_BUCKET_BITS + 1) *
+                                        SUB_BUCKETS;
+
+    /// Opcodes at or beyond ILLEGAL_RPC_TYPE are all recorded as
+    /// ILLEGAL_RPC_TYPE.
+    static const uint32_t NUM_OPCODES = WireFormat::ILLEGAL_RPC_TYPE + 1;
+
+    /**
+     * Sample counts for one stage of one opcode, as recorded by a single
+     * thread. Only the owning thread increments the counts, so they need
+     * not be updated atomically; they are std::atomic only so that other
+     * threads may read them safely while they change.
+     */
+    struct Counts {
+        Counts()
+            : buckets()
+        {
+            for (uint32_t i = 0; i < NUM_BUCKETS; i++)
+                buckets[i].store(0, std::memory_order_relaxed);
+        }
+
+        /// Number of samples that fell into each bucket (see #bucketIndex).
+        std::atomic<uint64_t> buckets[NUM_BUCKETS];
+
+        DISALLOW_COPY_AND_ASSIGN(Counts);
+    };
+
+    /**
+     * The samples recorded by one thread. Counts are allocated the first
+     * time a thread records a sample for a stage and opcode, since most
+     * threads only ever see a few opcodes. ThreadBuffers are never freed:
+     * RAMCloud creates few threads and they usually live as long as the
+     * process.
+     */
+    struct ThreadBuffer {
+        ThreadBuffer()
+            : counts()
+        {
+            for (uint32_t stage = 0; stage < NUM_STAGES; stage++) {
+                for (uint32_t opcode = 0; opcode < NUM_OPCODES; opcode++)
+                    counts[stage][opcode].store(NULL);
+            }
+        }
+
+        std::atomic<Counts*> counts[NUM_STAGES][NUM_OPCODES];
+
+        DISALLOW_COPY_AND_ASSIGN(ThreadBuffer);
+    };
+
+    static uint32_t bucketIndex(uint64_t value);
+    static uint64_t bucketLowerBound(uint32_t index);
+    static ThreadBuffer* registerThread();
+
+    /// The buffer of the current thread; NULL until the thread records
+    /// its first sample.
+    static __thread ThreadBuffer* threadBuffer;
+
+    /// Opcode of the RPC being executed by the current thread, or -1 if
+    /// it isn't executing an RPC.
+    static __thread int currentOpcode;
+
+    /// Protects #threadBuffers.
+    static std::mutex mutex;
+
+    /// Every ThreadBuffer that has been created.
+    static std::vector<ThreadBuffer*> threadBuffers;
+
+    LatencyMetrics();
+};
+
+} // namespace RAMCloud
+
+#endif // RAMCLOUD_LATENCYMETRICS_H
@@ -0,0 +1,177 @@
+/* Copyright (c) 2013 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <thread>
+
+#include "TestUtil.h"
+#include "LatencyMetrics.h"
+
+namespace RAMCloud {
+
+class LatencyMetricsTest : public ::testing::Test {
+  public:
+    LatencyMetricsTest()
+    {
+        LatencyMetrics::reset();
+        LatencyMetrics::clearOpcode();
+    }
+
+    ~LatencyMetricsTest()
+    {
+        LatencyMetrics::clearOpcode();
+        Cycles::mockTscValue = 0;
+    }
+
+    // Return "opcode/stage:count" for each histogram in the metrics.
+    static string
+    summary()
+    {
+        ProtoBuf::LatencyMetrics metrics;
+        LatencyMetrics::serialize(metrics);
+        string result;
+        for (int i = 0; i < metrics.histogram_size(); i++) {
+            const ProtoBuf::LatencyMetrics_Histogram& h =
+                    metrics.histogram(i);
+            if (result.size() > 0)
+                result += " ";
+            result += format("%s/%s:%lu", h.opcode().c_str(),
+                             h.stage().c_str(), LatencyMetrics::getCount(h));
+        }
+        return result;
+    }
+
+    // Record samples of a READ's queueing time on another thread.
+    static void
+    recordOnOtherThread()
+    {
+        LatencyMetrics::record(LatencyMetrics::QUEUE, WireFormat::READ,
+                               Cycles::fromNanoseconds(1000));
+    }
+
+    DISALLOW_COPY_AND_ASSIGN(LatencyMetricsTest);
+};
+
+TEST_F(LatencyMetricsTest, record_noOpcode) {
+    LatencyMetrics::record(LatencyMetrics::EXECUTE, 100);
+    EXPECT_EQ("", summary());
+}
+
+TEST_F(LatencyMetricsTest, record_currentOpcode) {
+    LatencyMetrics::setOpcode(WireFormat::WRITE);
+    LatencyMetrics::record(LatencyMetrics::EXECUTE, 100);
+    LatencyMetrics::record(LatencyMetrics::EXECUTE, 200);
+    LatencyMetrics::clearOpcode();
+    LatencyMetrics::record(LatencyMetrics::EXECUTE, 300);
+    EXPECT_EQ("WRITE/execute:2", summary());
+}
+
+TEST_F(LatencyMetricsTest, record_illegalOpcode) {
+    LatencyMetrics::record(LatencyMetrics::EXECUTE, 5000, 100);
+    EXPECT_EQ("ILLEGAL_RPC_TYPE/execute:1", summary());
+}
+
+TEST_F(LatencyMetricsTest, reset) {
+    LatencyMetrics::record(LatencyMetrics::QUEUE, WireFormat::READ, 100);
+    LatencyMetrics::reset();
+    EXPECT_EQ("", summary());
+    LatencyMetrics::record(LatencyMetrics::QUEUE, WireFormat::READ, 100);
+    EXPECT_EQ("READ/queue:1", summary());
+}
+
+TEST_F(LatencyMetricsTest, serialize_mergeThreads) {
+    LatencyMetrics::record(LatencyMetrics::QUEUE, WireFormat::READ,
+                           Cycles::fromNanoseconds(1000));
+    LatencyMetrics::record(LatencyMetrics::LOG_SYNC, WireFormat::WRITE, 1);
+    std::thread thread(recordOnOtherThread);
+    thread.join();
+    EXPECT_EQ("READ/queue:2 WRITE/logSync:1", summary());
+
+    ProtoBuf::LatencyMetrics metrics;
+    LatencyMetrics::serialize(metrics);
+    const ProtoBuf::LatencyMetrics_Histogram* h = LatencyMetrics::find(
+            metrics, "READ", LatencyMetrics::QUEUE);
+    ASSERT_TRUE(h != NULL);
+    // Empty buckets past the last sample are omitted.
+    EXPECT_EQ(64, h->bucket_count_size());
+    EXPECT_EQ(2U, h->bucket_count(63));
+    EXPECT_TRUE(LatencyMetrics::find(metrics, "READ",
+                                     LatencyMetrics::EXECUTE) == NULL);
+}
+
+TEST_F(LatencyMetricsTest, timer) {
+    LatencyMetrics::setOpcode(WireFormat::WRITE);
+    Cycles::mockTscValue = 1000;
+    {
+        LatencyMetrics::Timer _(LatencyMetrics::LOG_APPEND);
+    }
+    LatencyMetrics::clearOpcode();
+    {
+        LatencyMetrics::Timer _(LatencyMetrics::LOG_APPEND);
+    }
+    EXPECT_EQ("WRITE/logAppend:1", summary());
+}
+
+TEST_F(LatencyMetricsTest, getPercentile) {
+    ProtoBuf::LatencyMetrics_Histogram h;
+    h.set_opcode("READ");
+    h.set_stage("execute");
+    EXPECT_EQ(0U, LatencyMetrics::getPercentile(h, 50));
+
+    for (uint32_t i = 0; i < 20; i++)
+        h.add_bucket_count(0);
+    h.set_bucket_count(3, 90);
+    h.set_bucket_count(17, 9);
+    h.set_bucket_count(19, 1);
+    EXPECT_EQ(100U, LatencyMetrics::getCount(h));
+    EXPECT_EQ(3U, LatencyMetrics::getPercentile(h, 0));
+    EXPECT_EQ(3U, LatencyMetrics::getPercentile(h, 50));
+    EXPECT_EQ(19U, LatencyMetrics::getPercentile(h, 90));
+    EXPECT_EQ(23U, LatencyMetrics::getPercentile(h, 99));
+    EXPECT_EQ(23U, LatencyMetrics::getPercentile(h, 100));
+}
+
+TEST_F(LatencyMetricsTest, bucketIndex) {
+    EXPECT_EQ(0U, LatencyMetrics::bucketIndex(0));
+    EXPECT_EQ(7U, LatencyMetrics::bucketIndex(7));
+    EXPECT_EQ(8U, LatencyMetrics::bucketIndex(8));
+    EXPECT_EQ(15U, LatencyMetrics::bucketIndex(15));
+    EXPECT_EQ(16U, LatencyMetrics::bucketIndex(16));
+    EXPECT_EQ(16U, LatencyMetrics::bucketIndex(17));
+    EXPECT_EQ(17U, LatencyMetrics::bucketIndex(18));
+    EXPECT_EQ(63U, LatencyMetrics::bucketIndex(1000));
+    EXPECT_EQ(LatencyMetrics::NUM_BUCKETS - 1,
+              LatencyMetrics::bucketIndex(~0UL));
+}
+
+TEST_F(LatencyMetricsTest, bucketLowerBound) {
+    for (uint32_t i = 0; i < LatencyMetrics::NUM_BUCKETS; i++) {
+        uint64_t lower = LatencyMetrics::bucketLowerBound(i);
+        EXPECT_EQ(i, LatencyMetrics::bucketIndex(lower));
+        if (i > 0)
+            EXPECT_EQ(i - 1, LatencyMetrics::bucketIndex(lower - 1));
+    }
+    EXPECT_EQ(0U, LatencyMetrics::bucketLowerBound(
+            LatencyMetrics::NUM_BUCKETS));
+}
+
+TEST_F(LatencyMetricsTest, stageName) {
+    EXPECT_STREQ("queue", LatencyMetrics::stageName(LatencyMetrics::QUEUE));
+    EXPECT_STREQ("logSync",
+                 LatencyMetrics::stageName(LatencyMetrics::LOG_SYNC));
+    EXPECT_STREQ("unknown",
+                 LatencyMetrics::stageName(LatencyMetrics::NUM_STAGES));
+}
+
+}  // namespace RAMCloud
@@ -117,6 +117,47 @@ Log::getMetrics(ProtoBuf::LogMetrics& m)
     cleaner->getMetrics(*m.mutable_cleaner_metrics());
 }
 
+/**
+ * Change one of the thresholds that control when and how the cleaner runs.
+ * See LogCleaner::setOption for details.
+ *
+ * 
+eturn
+ *      True if the option was changed, false if there is no such option or
+ *      the value was invalid.
+ */
+bool
+Log::setCleanerOption(const char* option, const char* value)
+{
+    return cleaner->setOption(option, value);
+}
+
+/**
+ * Return the number of bytes that may be appended to the log before it runs
+ * out of memory, not counting any space left in the current head segment or
+ * reserved for the cleaner. Writers use this to hold off while the cleaner
+ * catches up, instead of failing appends. This method is thread-safe.
+ */
+uint64_t
+Log::getWriteCredit()
+{
+    SegletAllocator& allocator = segmentManager->getAllocator();
+    return allocator.getFreeCount(SegletAllocator::DEFAULT) *
+           allocator.getSegletSize();
+}
+
+/**
+ * Return an estimate of how many microseconds it will take for the cleaner
+ * to free enough memory for another head segment, based on how fast it has
+ * been freeing memory recently. Used to tell clients when to retry writes
+ * that failed because the log was out of space.
+ */
+uint32_t
+Log::getWriteRetryDelayMicros()
+{
+    return cleaner->getRetryDelayMicros(segmentSize);
+}
+
 /**
  * Wait for all log appends made at the time this method is invoked to be fully
  * replicated to backups. If no appends have ever been done, this method will
@@ -144,6 +185,7 @@ void
 Log::sync()
 {
     CycleCounter<uint64_t> __(&metrics.totalSyncTicks);
+    LatencyMetrics::Timer ___(LatencyMetrics::LOG_SYNC);
 
     Tub<Lock> lock;
     lock.construct(appendLock);
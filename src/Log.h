@@ -82,6 +82,9 @@ class Log : public AbstractLog {
     void enableCleaner();
     void disableCleaner();
     void getMetrics(ProtoBuf::LogMetrics& m);
+    bool setCleanerOption(const char* option, const char* value);
+    uint64_t getWriteCredit();
+    uint32_t getWriteRetryDelayMicros();
     void sync();
     Log::Position rollHeadOver();
 
@@ -0,0 +1,140 @@
+/* Copyright (c) 2013 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/**
+ * \file
+ * Measures how the rate of small writes to a master's log scales with the
+ * number of threads writing concurrently (as worker threads do when
+ * servicing write RPCs). No replicas or network are involved.
+ */
+
+#include <thread>
+
+#include "Cycles.h"
+#include "Logger.h"
+#include "ObjectManager.h"
+#include "Seglet.h"
+#include "TabletManager.h"
+#include "MasterTableMetadata.h"
+
+namespace RAMCloud {
+
+class LogAppendBenchmark {
+
+  public:
+    Context context;
+    ServerConfig config;
+    ServerList serverList;
+    TabletManager tabletManager;
+    MasterTableMetadata masterTableMetadata;
+    ServerId serverId;
+    ObjectManager* objectManager;
+
+    LogAppendBenchmark(string logSize, string hashTableSize)
+        : context()
+        , config(ServerConfig::forTesting())
+        , serverList(&context)
+        , tabletManager()
+        , masterTableMetadata()
+        , serverId(1, 1)
+        , objectManager(NULL)
+    {
+        Logger::get().setLogLevels(WARNING);
+        config.localLocator = "bogus";
+        config.coordinatorLocator = "bogus";
+        config.setLogAndHashTableSize(logSize, hashTableSize);
+        config.services = {};
+        config.master.numReplicas = 0;
+        config.master.disableLogCleaner = true;
+        config.segmentSize = Segment::DEFAULT_SEGMENT_SIZE;
+        config.segletSize = Seglet::DEFAULT_SEGLET_SIZE;
+        objectManager = new ObjectManager(&context,
+                                          &serverId,
+                                          &config,
+                                          &tabletManager,
+                                          &masterTableMetadata);
+        tabletManager.addTablet(0, 0, ~0UL, TabletManager::NORMAL);
+    }
+
+    ~LogAppendBenchmark()
+    {
+        delete objectManager;
+    }
+
+    /**
+     * Body of each writing thread: repeatedly overwrite a private set of
+     * objects.
+     */
+    void
+    writer(uint32_t threadId, uint32_t numWrites, uint32_t dataBytes)
+    {
+        char objectData[dataBytes];
+        memset(objectData, 'x', dataBytes);
+        for (uint32_t i = 0; i < numWrites; i++) {
+            uint64_t keyVal = (uint64_t(threadId) << 32) | (i % 1000);
+            Key key(0, &keyVal, sizeof(keyVal));
+            Object object(key, objectData, dataBytes, 0, 0);
+            Buffer buffer;
+            object.serializeToBuffer(buffer);
+            Status status = objectManager->writeObject(key, buffer, NULL, NULL);
+            if (status != STATUS_OK) {
+                fprintf(stderr, "Failed to write object! Out of memory?\n");
+                exit(1);
+            }
+        }
+    }
+
+    void
+    run(uint32_t numThreads, uint32_t numWrites, uint32_t dataBytes)
+    {
+        std::thread* threads[numThreads];
+        uint64_t before = Cycles::rdtsc();
+        for (uint32_t i = 0; i < numThreads; i++) {
+            threads[i] = new std::thread(&LogAppendBenchmark::writer, this,
+                                         i, numWrites, dataBytes);
+        }
+        for (uint32_t i = 0; i < numThreads; i++) {
+            threads[i]->join();
+            delete threads[i];
+        }
+        double seconds = Cycles::toSeconds(Cycles::rdtsc() - before);
+
+        uint64_t totalWrites = uint64_t(numThreads) * numWrites;
+        printf("%2u threads: %8.0f writes/sec  %6.0f ns/write\n",
+               numThreads,
+               static_cast<double>(totalWrites) / seconds,
+               seconds * 1e9 / static_cast<double>(totalWrites));
+    }
+
+    DISALLOW_COPY_AND_ASSIGN(LogAppendBenchmark);
+};
+
+}  // namespace RAMCloud
+
+int
+main()
+{
+    uint32_t numThreads[] = { 1, 2, 4, 8, 16, 0 };
+    uint32_t numWrites = 200000;
+    uint32_t dataBytes = 100;
+
+    printf("%u writes of %u-byte objects per thread\n", numWrites, dataBytes);
+    for (int i = 0; numThreads[i] != 0; i++) {
+        RAMCloud::LogAppendBenchmark benchmark("4096", "10%");
+        benchmark.run(numThreads[i], numWrites, dataBytes);
+    }
+
+    return 0;
+}
@@ -59,8 +59,9 @@ LogCleaner::LogCleaner(Context* context,
       writeCostThreshold(config->master.cleanerWriteCostThreshold),
       disableInMemoryCleaning(config->master.disableInMemoryCleaning),
       numThreads(config->master.cleanerThreadCount),
-      candidates(),
-      candidatesLock("LogCleaner::candidatesLock"),
+      candidates(config->segletSize, config->segmentSize,
+                 MAX_CLEANABLE_MEMORY_UTILIZATION),
+      scheduler(config->segletSize),
       segletSize(config->segletSize),
       segmentSize(config->segmentSize),
       doWorkTicks(0),
@@ -69,6 +70,7 @@ LogCleaner::LogCleaner(Context* context,
       onDiskMetrics(),
       threadMetrics(numThreads),
       threadsShouldExit(false),
+      cpus(config->cleanerCpus),
       threads()
 {
     if (!segmentManager.initializeSurvivorReserve(numThreads *
@@ -140,17 +142,41 @@ LogCleaner::stop()
 void
 LogCleaner::getMetrics(ProtoBuf::LogMetrics_CleanerMetrics& m)
 {
-    m.set_poll_usec(POLL_USEC);
     m.set_max_cleanable_memory_utilization(MAX_CLEANABLE_MEMORY_UTILIZATION);
     m.set_live_segments_per_disk_pass(MAX_LIVE_SEGMENTS_PER_DISK_PASS);
     m.set_survivor_segments_to_reserve(SURVIVOR_SEGMENTS_TO_RESERVE);
-    m.set_min_memory_utilization(MIN_MEMORY_UTILIZATION);
-    m.set_min_disk_utilization(MIN_DISK_UTILIZATION);
     m.set_do_work_ticks(doWorkTicks);
     m.set_do_work_sleep_ticks(doWorkSleepTicks);
     inMemoryMetrics.serialize(*m.mutable_in_memory_metrics());
     onDiskMetrics.serialize(*m.mutable_on_disk_metrics());
     threadMetrics.serialize(*m.mutable_thread_metrics());
+    candidates.getMetrics(m);
+    scheduler.getMetrics(m);
+}
+
+/**
+ * Change one of the thresholds that decide when the cleaner runs and how it
+ * cleans. See CleanerScheduler::setOption for the options and their formats.
+ *
+ * 
+eturn
+ *      True if the option was changed, false if there is no such option or
+ *      the value was invalid.
+ */
+bool
+LogCleaner::setOption(const char* option, const char* value)
+{
+    return scheduler.setOption(option, value);
+}
+
+/**
+ * Estimate how many microseconds the cleaner will take to free the given
+ * number of bytes of memory (see CleanerScheduler::getRetryDelayMicros).
+ */
+uint32_t
+LogCleaner::getRetryDelayMicros(uint64_t bytesNeeded)
+{
+    return scheduler.getRetryDelayMicros(bytesNeeded);
 }
 
 /******************************************************************************
@@ -171,6 +197,10 @@ LogCleaner::cleanerThreadEntry(LogCleaner* logCleaner, Context* context)
 
     CleanerThreadState state;
     state.threadNumber = __sync_fetch_and_add(&threadCnt, 1);
+    if (!logCleaner->cpus.empty()) {
+        pinToCpu(logCleaner->cpus[state.threadNumber %
+                                  logCleaner->cpus.size()]);
+    }
     try {
         while (1) {
             Fence::lfence();
@@ -201,44 +231,37 @@ LogCleaner::doWork(CleanerThreadState* state)
 
     // Update our list of candidates whether we need to clean or not (it's
     // better not to put off work until we really need to clean).
-    candidatesLock.lock();
-    segmentManager.cleanableSegments(candidates);
-    candidatesLock.unlock();
-
-    int memUtil = segmentManager.getAllocator().getMemoryUtilization();
-    bool lowOnMemory = (segmentManager.getAllocator().getMemoryUtilization() >=
-                        MIN_MEMORY_UTILIZATION);
-    bool notKeepingUp = (segmentManager.getAllocator().getMemoryUtilization() >=
-                         MEMORY_DEPLETED_UTILIZATION);
-    bool lowOnDiskSpace = (segmentManager.getSegmentUtilization() >=
-                           MIN_DISK_UTILIZATION);
-    bool haveWorkToDo = (lowOnMemory || lowOnDiskSpace);
-
-    if (haveWorkToDo) {
-        if (state->threadNumber == 0) {
-            if (lowOnDiskSpace || notKeepingUp)
-                doDiskCleaning(lowOnDiskSpace);
-            else
-                doMemoryCleaning();
-        } else {
-            int threshold = 90 + 2 * static_cast<int>(state->threadNumber);
-            if (memUtil >= std::min(99, threshold))
-                doMemoryCleaning();
-            else
-                haveWorkToDo = false;
-        }
-    }
+    LogSegmentVector newCandidates;
+    segmentManager.cleanableSegments(newCandidates);
+    candidates.add(newCandidates);
+
+    SegletAllocator& allocator = segmentManager.getAllocator();
+    scheduler.noteSegletsAllocated(allocator.getDefaultSegletsAllocated());
+
+    bool lowOnDiskSpace;
+    CleanerScheduler::Work work = scheduler.getWork(
+        state->threadNumber,
+        allocator.getMemoryUtilization(),
+        segmentManager.getSegmentUtilization(),
+        allocator.getFreeCount(SegletAllocator::DEFAULT) * segletSize,
+        &lowOnDiskSpace);
+
+    if (work == CleanerScheduler::COMPACT)
+        scheduler.noteCompaction(doMemoryCleaning());
+    else if (work == CleanerScheduler::CLEAN_ON_DISK)
+        scheduler.noteDiskCleaning(doDiskCleaning(lowOnDiskSpace));
 
     threadMetrics.noteThreadStop();
 
-    if (!haveWorkToDo) {
+    if (work == CleanerScheduler::NO_WORK) {
         MetricCycleCounter __(&doWorkSleepTicks);
         // Jitter the sleep delay a little bit (up to 10%). It's not a big deal
         // if we don't, but it can make some locks look artificially contended
         // when there's no cleaning to be done and threads manage to caravan
         // together.
-        useconds_t r = downCast<useconds_t>(generateRandom() % POLL_USEC) / 10;
-        usleep(POLL_USEC + r);
+        useconds_t pollUsec = scheduler.getPollUsec();
+        useconds_t r = downCast<useconds_t>(generateRandom() % pollUsec) / 10;
+        usleep(pollUsec + r);
     }
 }
 
@@ -278,26 +301,38 @@ LogCleaner::doMemoryCleaning()
     uint64_t liveScannedEntryLengths[TOTAL_LOG_ENTRY_TYPES] = { 0 };
     uint32_t bytesAppended = 0;
 
-    for (SegmentIterator it(*segment); !it.isDone(); it.next()) {
-        LogEntryType type = it.getType();
-        Buffer buffer;
-        it.appendToBuffer(buffer);
-        Log::Reference reference = segment->getReference(it.getOffset());
-
-        RelocStatus s = relocateEntry(type,
-                                      buffer,
-                                      reference,
-                                      survivor,
-                                      inMemoryMetrics,
-                                      &bytesAppended);
-        if (expect_false(s == RELOCATION_FAILED))
-            throw FatalError(HERE, "Entry didn't fit into survivor!");
-
-        entriesScanned[type]++;
-        scannedEntryLengths[type] += buffer.getTotalLength();
-        if (expect_true(s == RELOCATED)) {
-            liveEntriesScanned[type]++;
-            liveScannedEntryLengths[type] += buffer.getTotalLength();
+    EntryVector batch;
+    batch.reserve(RELOCATION_BATCH_SIZE);
+    SegmentIterator it(*segment);
+    while (!it.isDone()) {
+        batch.clear();
+        for (; !it.isDone() && batch.size() < RELOCATION_BATCH_SIZE; it.next())
+            batch.push_back(Entry(segment, it.getOffset(), 0));
+
+        Tub<Buffer> buffers[RELOCATION_BATCH_SIZE];
+        LogEntryType types[RELOCATION_BATCH_SIZE];
+        prefetchEntries(&batch[0], batch.size(), buffers, types);
+
+        for (size_t i = 0; i < batch.size(); i++) {
+            LogEntryType type = types[i];
+            Buffer& buffer = *buffers[i];
+            Log::Reference reference = segment->getReference(batch[i].offset);
+
+            RelocStatus s = relocateEntry(type,
+                                          buffer,
+                                          reference,
+                                          survivor,
+                                          inMemoryMetrics,
+                                          &bytesAppended);
+            if (expect_false(s == RELOCATION_FAILED))
+                throw FatalError(HERE, "Entry didn't fit into survivor!");
+
+            entriesScanned[type]++;
+            scannedEntryLengths[type] += buffer.getTotalLength();
+            if (expect_true(s == RELOCATED)) {
+                liveEntriesScanned[type]++;
+                liveScannedEntryLengths[type] += buffer.getTotalLength();
+            }
         }
     }
 
@@ -430,22 +465,6 @@ LogSegment*
 LogCleaner::getSegmentToCompact(uint32_t& outFreeableSeglets)
 {
     MetricCycleCounter _(&inMemoryMetrics.getSegmentToCompactTicks);
-    Lock guard(candidatesLock);
-
-    size_t bestIndex = -1;
-    uint32_t bestDelta = 0;
-    for (size_t i = 0; i < candidates.size(); i++) {
-        LogSegment* candidate = candidates[i];
-        uint32_t liveBytes = candidate->liveBytes;
-        uint32_t segletsNeeded = (100 * (liveBytes + segletSize - 1)) /
-                                 segletSize / MAX_CLEANABLE_MEMORY_UTILIZATION;
-        uint32_t segletsAllocated = candidate->getSegletsAllocated();
-        uint32_t delta = segletsAllocated - segletsNeeded;
-        if (segletsNeeded < segletsAllocated && delta > bestDelta) {
-            bestIndex = i;
-            bestDelta = delta;
-        }
-    }
 
     // If we don't think any memory can be safely freed then either we're full
     // up with live objects (in which case nothing's wrong and we can't actually
@@ -471,57 +490,19 @@ LogCleaner::getSegmentToCompact(uint32_t& outFreeableSeglets)
     // overall performance.
     //
     // Did I ever mention how much I hate tombstones?
-    if (bestIndex == static_cast<size_t>(-1)) {
-        __uint128_t bestGoodness = 0;
-        for (size_t i = 0; i < candidates.size(); i++) {
-            LogSegment* candidate = candidates[i];
-            uint32_t tombstoneCount =
-                candidate->getEntryCount(LOG_ENTRY_TYPE_OBJTOMB);
-            uint64_t timeSinceLastCompaction = WallTime::secondsTimestamp() -
-                                            candidate->lastCompactionTimestamp;
-            __uint128_t goodness =
-                (__uint128_t)tombstoneCount * timeSinceLastCompaction;
-            if (goodness > bestGoodness) {
-                bestIndex = i;
-                bestGoodness = goodness;
-            }
-        }
-
-        // Still no dice. Looks like we're just full of live data.
-        if (bestIndex == static_cast<size_t>(-1))
-            return NULL;
-
-        // It's not safe for the compactor to free any memory this time around
-        // (it could be that no tombstones were dead, or we will free too few to
-        // allow us to free seglets while still guaranteeing forward progress
-        // of the disk cleaner).
-        //
-        // If we do free enough memory, we'll get it back in a subsequent pass.
-        // The alternative would be to have a separate algorithm that just
-        // counts dead tombstones and updates the liveness counters. That is
-        // slightly more complicated. Perhaps if this becomes frequently enough
-        // we can optimise that case.
-        bestDelta = 0;
-    }
-
-    LogSegment* best = candidates[bestIndex];
-    candidates[bestIndex] = candidates.back();
-    candidates.pop_back();
-
-    outFreeableSeglets = bestDelta;
-    return best;
-}
-
-void
-LogCleaner::sortSegmentsByCostBenefit(LogSegmentVector& segments)
-{
-    MetricCycleCounter _(&onDiskMetrics.costBenefitSortTicks);
-
-    // Sort segments so that the best candidates are at the front of the vector.
-    // We could probably use a heap instead and go a little faster, but it's not
-    // easy to say how many top candidates we'd want to track in the heap since
-    // they could each have significantly different numbers of seglets.
-    std::sort(segments.begin(), segments.end(), CostBenefitComparer());
+    //
+    // The index takes care of both cases. If it falls back to tombstones, it
+    // tells us that it's not safe for the compactor to free any memory this
+    // time around (it could be that no tombstones were dead, or we will free
+    // too few to allow us to free seglets while still guaranteeing forward
+    // progress of the disk cleaner).
+    //
+    // If we do free enough memory, we'll get it back in a subsequent pass.
+    // The alternative would be to have a separate algorithm that just
+    // counts dead tombstones and updates the liveness counters. That is
+    // slightly more complicated. Perhaps if this becomes frequently enough
+    // we can optimise that case.
+    return candidates.removeSegmentToCompact(&outFreeableSeglets);
 }
 
 /**
@@ -539,47 +520,28 @@ void
 LogCleaner::getSegmentsToClean(LogSegmentVector& outSegmentsToClean)
 {
     MetricCycleCounter _(&onDiskMetrics.getSegmentsToCleanTicks);
-    Lock guard(candidatesLock);
-
-    foreach (LogSegment* segment, candidates) {
-        onDiskMetrics.allSegmentsDiskHistogram.storeSample(
-            segment->getDiskUtilization());
-    }
-
-    sortSegmentsByCostBenefit(candidates);
 
-    uint32_t totalSeglets = 0;
-    uint64_t totalLiveBytes = 0;
+    // Walk candidates in decreasing cost-benefit order, stopping once we'd
+    // have to relocate more live data than we can fit in the survivors.
     uint64_t maximumLiveBytes = MAX_LIVE_SEGMENTS_PER_DISK_PASS * segmentSize;
-    vector<size_t> chosenIndices;
-
-    for (size_t i = 0; i < candidates.size(); i++) {
-        LogSegment* candidate = candidates[i];
-
-        int utilization = candidate->getMemoryUtilization();
-        if (utilization > MAX_CLEANABLE_MEMORY_UTILIZATION)
-            continue;
-
-        uint64_t liveBytes = candidate->liveBytes;
-        if ((totalLiveBytes + liveBytes) > maximumLiveBytes)
-            break;
-
-        totalLiveBytes += liveBytes;
-        totalSeglets += candidate->getSegletsAllocated();
-        outSegmentsToClean.push_back(candidate);
-        chosenIndices.push_back(i);
+    size_t firstChosen = outSegmentsToClean.size();
+    {
+        MetricCycleCounter selectTicks(&onDiskMetrics.costBenefitSortTicks);
+        candidates.removeSegmentsToClean(
+            maximumLiveBytes,
+            outSegmentsToClean,
+            &onDiskMetrics.allSegmentsDiskHistogram);
     }
 
-    // Remove chosen segments from the list of candidates. At this point, we've
-    // committed to cleaning what we chose and have guaranteed that we have the
-    // necessary resources to complete the operation.
-    reverse_foreach(size_t i, chosenIndices) {
-        candidates[i] = candidates.back();
-        candidates.pop_back();
-    }
+    // At this point, we've committed to cleaning what we chose and have
+    // guaranteed that we have the necessary resources to complete the
+    // operation.
+    uint32_t totalSeglets = 0;
+    for (size_t i = firstChosen; i < outSegmentsToClean.size(); i++)
+        totalSeglets += outSegmentsToClean[i]->getSegletsAllocated();
 
     TEST_LOG("%lu segments selected with %u allocated segments",
-        chosenIndices.size(), totalSeglets);
+        outSegmentsToClean.size() - firstChosen, totalSeglets);
 }
 
 /**
@@ -647,6 +609,48 @@ LogCleaner::getSortedEntries(LogSegmentVector& segmentsToClean,
         outEntries.size(), segmentsToClean.size());
 }
 
+/**
+ * Look up a batch of entries that are about to be relocated, prefetching
+ * everything that relocating them will touch. First the start of each entry
+ * is prefetched, so that reading their headers misses in parallel, and then
+ * the entry handlers are given a chance to prefetch their own metadata (the
+ * hash table buckets, in the case of objects and tombstones).
+ *
+ * \param entries
+ *      Array of entries to look up.
+ * \param count
+ *      Number of entries in the array. Must not exceed RELOCATION_BATCH_SIZE.
+ * \param[out] outBuffers
+ *      Array in which buffers describing each entry are constructed.
+ * \param[out] outTypes
+ *      Array in which the type of each entry is returned.
+ */
+void
+LogCleaner::prefetchEntries(Entry* entries,
+                            size_t count,
+                            Tub<Buffer>* outBuffers,
+                            LogEntryType* outTypes)
+{
+    assert(count <= RELOCATION_BATCH_SIZE);
+
+    for (size_t i = 0; i < count; i++) {
+        const void* start = NULL;
+        uint32_t contiguousBytes =
+            entries[i].segment->peek(entries[i].offset, &start);
+        if (contiguousBytes != 0) {
+            prefetch(start, std::min(contiguousBytes,
+                                     uint32_t(ENTRY_PREFETCH_BYTES)));
+        }
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        outBuffers[i].construct();
+        outTypes[i] = entries[i].segment->getEntry(entries[i].offset,
+                                                   *outBuffers[i]);
+        entryHandlers.prefetch(outTypes[i], *outBuffers[i]);
+    }
+}
+
 /**
  * Given a vector of entries from segments being cleaned, write them out to
  * survivor segments in order and alert their owning module (MasterService,
@@ -679,58 +683,74 @@ LogCleaner::relocateLiveEntries(EntryVector& entries,
     uint64_t liveScannedEntryLengths[TOTAL_LOG_ENTRY_TYPES] = { 0 };
     uint32_t bytesAppended = 0;
 
-    foreach (Entry& entry, entries) {
-        Buffer buffer;
-        LogEntryType type = entry.segment->getEntry(entry.offset, buffer);
-        Log::Reference reference = entry.segment->getReference(entry.offset);
-
-        RelocStatus s = relocateEntry(type,
-                                      buffer,
-                                      reference,
-                                      survivor,
-                                      onDiskMetrics,
-                                      &bytesAppended);
-        if (s == RELOCATION_FAILED) {
-            if (survivor != NULL) {
-                survivor->liveBytes += bytesAppended;
-                bytesAppended = 0;
-                closeSurvivor(survivor);
+    for (size_t batchStart = 0;
+         batchStart < entries.size();
+         batchStart += RELOCATION_BATCH_SIZE) {
+        size_t batchSize = std::min(entries.size() - batchStart,
+                                    size_t(RELOCATION_BATCH_SIZE));
+        Tub<Buffer> buffers[RELOCATION_BATCH_SIZE];
+        LogEntryType types[RELOCATION_BATCH_SIZE];
+        prefetchEntries(&entries[batchStart], batchSize, buffers, types);
+
+        for (size_t i = 0; i < batchSize; i++) {
+            Entry& entry = entries[batchStart + i];
+            LogEntryType type = types[i];
+            Buffer& buffer = *buffers[i];
+            Log::Reference reference =
+                entry.segment->getReference(entry.offset);
+
+            RelocStatus s = relocateEntry(type,
+                                          buffer,
+                                          reference,
+                                          survivor,
+                                          onDiskMetrics,
+                                          &bytesAppended);
+            if (s == RELOCATION_FAILED) {
+                if (survivor != NULL) {
+                    survivor->liveBytes += bytesAppended;
+                    bytesAppended = 0;
+                    closeSurvivor(survivor);
+                }
+
+                // Allocate a survivor segment to write into. This call may
+                // block if one is not available right now.
+                MetricCycleCounter waitTicks(
+                    &onDiskMetrics.waitForFreeSurvivorsTicks);
+                survivor = segmentManager.allocSideSegment(
+                    SegmentManager::FOR_CLEANING |
+                    SegmentManager::MUST_NOT_FAIL,
+                    NULL);
+                assert(survivor != NULL);
+                waitTicks.stop();
+                outSurvivors.push_back(survivor);
+                currentSurvivorBytesAppended = survivor->getAppendedLength();
+
+                s = relocateEntry(type,
+                                  buffer,
+                                  reference,
+                                  survivor,
+                                  onDiskMetrics,
+                                  &bytesAppended);
+                if (s == RELOCATION_FAILED) {
+                    throw FatalError(HERE,
+                        "Entry didn't fit into empty survivor!");
+                }
             }
 
-            // Allocate a survivor segment to write into. This call may block if
-            // one is not available right now.
-            MetricCycleCounter waitTicks(
-                &onDiskMetrics.waitForFreeSurvivorsTicks);
-            survivor = segmentManager.allocSideSegment(
-                SegmentManager::FOR_CLEANING | SegmentManager::MUST_NOT_FAIL,
-                NULL);
-            assert(survivor != NULL);
-            waitTicks.stop();
-            outSurvivors.push_back(survivor);
-            currentSurvivorBytesAppended = survivor->getAppendedLength();
-
-            s = relocateEntry(type,
-                              buffer,
-                              reference,
-                              survivor,
-                              onDiskMetrics,
-                              &bytesAppended);
-            if (s == RELOCATION_FAILED)
-                throw FatalError(HERE, "Entry didn't fit into empty survivor!");
-        }
-
-        entriesScanned[type]++;
-        scannedEntryLengths[type] += buffer.getTotalLength();
-        if (s == RELOCATED) {
-            liveEntriesScanned[type]++;
-            liveScannedEntryLengths[type] += buffer.getTotalLength();
-        }
+            entriesScanned[type]++;
+            scannedEntryLengths[type] += buffer.getTotalLength();
+            if (s == RELOCATED) {
+                liveEntriesScanned[type]++;
+                liveScannedEntryLengths[type] += buffer.getTotalLength();
+            }
 
-        if (survivor != NULL) {
-            uint32_t newSurvivorBytesAppended = survivor->getAppendedLength();
-            entryBytesAppended += (newSurvivorBytesAppended -
-                                   currentSurvivorBytesAppended);
-            currentSurvivorBytesAppended = newSurvivorBytesAppended;
+            if (survivor != NULL) {
+                uint32_t newSurvivorBytesAppended =
+                    survivor->getAppendedLength();
+                entryBytesAppended += (newSurvivorBytesAppended -
+                                       currentSurvivorBytesAppended);
+                currentSurvivorBytesAppended = newSurvivorBytesAppended;
+            }
         }
     }
 
@@ -785,69 +805,4 @@ LogCleaner::closeSurvivor(LogSegment* survivor)
     assert(r);
 }
 
-/******************************************************************************
- * LogCleaner::CostBenefitComparer inner class
- ******************************************************************************/
-
-/**
- * Construct a new comparison functor that compares segments by cost-benefit.
- * Used when selecting among candidate segments by first sorting them.
- */
-LogCleaner::CostBenefitComparer::CostBenefitComparer()
-    : now(WallTime::secondsTimestamp()),
-      version(Cycles::rdtsc())
-{
-}
-
-/**
- * Calculate the cost-benefit ratio (benefit/cost) for the given segment.
- */
-uint64_t
-LogCleaner::CostBenefitComparer::costBenefit(LogSegment* s)
-{
-    // If utilization is 0, cost-benefit is infinity.
-    uint64_t costBenefit = -1UL;
-
-    int utilization = s->getDiskUtilization();
-    if (utilization != 0) {
-        uint64_t timestamp = s->creationTimestamp;
-
-        // This generally shouldn't happen, but is possible due to:
-        //  1) Unsynchronized TSCs across cores (WallTime uses rdtsc).
-        //  2) Unsynchronized clocks and "newer" recovered data in the log.
-        if (timestamp > now) {
-            LOG(WARNING, "timestamp > now");
-            timestamp = now;
-        }
-
-        uint64_t age = now - timestamp;
-        costBenefit = ((100 - utilization) * age) / utilization;
-    }
-
-    return costBenefit;
-}
-
-/**
- * Compare two segment's cost-benefit ratios. Higher values (better cleaning
- * candidates) are better, so the less than comparison is inverted.
- */
-bool
-LogCleaner::CostBenefitComparer::operator()(LogSegment* a, LogSegment* b)
-{
-    // We must ensure that we maintain the weak strictly ordered constraint,
-    // otherwise surprising things may happen in the stl algorithms when
-    // segment statistics change and alter the computed cost-benefit of a
-    // segment from one comparison to the next during the same sort operation.
-    if (a->costBenefitVersion != version) {
-        a->costBenefit = costBenefit(a);
-        a->costBenefitVersion = version;
-    }
-    if (b->costBenefitVersion != version) {
-        b->costBenefit = costBenefit(b);
-        b->costBenefitVersion = version;
-    }
-    return a->costBenefit > b->costBenefit;
-}
-
-
 } // namespace
@@ -19,6 +19,8 @@
 #include <thread>
 #include <vector>
 
+#include "CleanerCandidateIndex.h"
+#include "CleanerScheduler.h"
 #include "Common.h"
 #include "HashTable.h"
 #include "Segment.h"
@@ -67,15 +69,13 @@ class LogCleaner {
     void start();
     void stop();
     void getMetrics(ProtoBuf::LogMetrics_CleanerMetrics& m);
+    bool setOption(const char* option, const char* value);
+    uint32_t getRetryDelayMicros(uint64_t bytesNeeded);
 
   PRIVATE:
     typedef LogCleanerMetrics::MetricCycleCounter MetricCycleCounter;
     typedef std::lock_guard<SpinLock> Lock;
 
-    /// If no cleaning work had to be done the last time we checked, sleep for
-    /// this many microseconds before checking again.
-    enum { POLL_USEC = 10000 };
-
     /// The maximum in-memory segment utilization we will clean at. This upper
     /// limit, in conjunction with the number of seglets per segment, ensures
     /// that we can never consume more seglets in cleaning than we free.
@@ -97,28 +97,16 @@ class LogCleaner {
     /// segment size, maximum entry size, and MAX_LIVE_SEGMENTS_PER_DISK_PASS.
     enum { SURVIVOR_SEGMENTS_TO_RESERVE = 15 };
 
-    /// The minimum amount of memory utilization we will begin cleaning at using
-    /// the in-memory cleaner.
-    enum { MIN_MEMORY_UTILIZATION = 90 };
+    /// The number of entries the cleaner looks up at a time before relocating
+    /// them. Every entry in a batch has its first cache lines and its hash
+    /// table bucket prefetched before any of them are relocated, so that the
+    /// cache misses overlap rather than being taken one entry at a time.
+    enum { RELOCATION_BATCH_SIZE = 8 };
 
-    /// Memory utilization at which we declare that the cleaner isn't able to
-    /// keep up with the incoming write rate. We'll then clean by whatever means
-    /// are most efficient at freeing memory, even if it means increasing backup
-    /// traffic by cleaning on disk (which may also reduce write throughput by
-    /// contending for the network).
-    ///
-    /// As long as our memory utilization is below this value, we'll prefer to
-    /// compact in memory. If compaction can keep up with the write rate, then
-    /// we'll not contend for network bandwidth, but if we fall behind, we'll
-    /// use this constant to permit more aggressive disk cleaning.
-    enum { MEMORY_DEPLETED_UTILIZATION = 99 };
-
-    /// The minimum amount of backup disk utilization we will begin cleaning at
-    /// using the disk cleaner. Note that the disk cleaner may also run if the
-    /// in-memory cleaner is not working efficiently enough to keep up with the
-    /// log writes (accumulation of tombstones will eventually create such
-    /// inefficiency and requires disk cleaning to free them).
-    enum { MIN_DISK_UTILIZATION = 95 };
+    /// The number of bytes at the start of each entry in a batch that are
+    /// prefetched. This covers the entry header and the object or tombstone
+    /// header, which is what relocation looks at.
+    enum { ENTRY_PREFETCH_BYTES = 128 };
 
     /**
      * Tuple containing a reference to an entry being cleaned, as well as a
@@ -163,41 +151,12 @@ class LogCleaner {
         }
     };
 
-    /**
-     * Comparison functor used when sorting segments by best cost-benefit ratio.
-     * This is used when choosing disk segments to clean. All candidates are
-     * sorted by cost-benefit and then the list is walked in order.
-     */
-    class CostBenefitComparer {
-      public:
-        CostBenefitComparer();
-        uint64_t costBenefit(LogSegment* s);
-        bool operator()(LogSegment* a, LogSegment* b);
-
-      PRIVATE:
-        /// WallTime timestamp when this object was constructed.
-        uint64_t now;
-
-        /// Unique identifier for this comparer instance. The cost-benefit for a
-        /// particular LogSegment must not change within a comparer's lifetime,
-        /// otherwise weird things can happen, for example A < B, B < C, C < A).
-        uint64_t version;
-    };
-
     class CleanerThreadState {
       public:
         CleanerThreadState()
-            : lastDiskCleaningMemFreeRate(0)
-            , lastMemCompactionMemFreeRate(0)
-            , lastDiskCleaningTime(0)
-            , lastMemCompactionTime(0)
-            , threadNumber(0)
+            : threadNumber(0)
         {
         }
-        uint64_t lastDiskCleaningMemFreeRate;
-        uint64_t lastMemCompactionMemFreeRate;
-        uint64_t lastDiskCleaningTime;
-        uint64_t lastMemCompactionTime;
         uint32_t threadNumber;
     };
 
@@ -206,12 +165,15 @@ class LogCleaner {
     uint64_t doMemoryCleaning();
     uint64_t doDiskCleaning(bool lowOnDiskSpace);
     LogSegment* getSegmentToCompact(uint32_t& outFreeableSeglets);
-    void sortSegmentsByCostBenefit(LogSegmentVector& segments);
     void debugDumpSegments(LogSegmentVector& segments);
     void getSegmentsToClean(LogSegmentVector& outSegmentsToClean);
     void sortEntriesByTimestamp(EntryVector& entries);
     void getSortedEntries(LogSegmentVector& segmentsToClean,
                           EntryVector& outEntries);
+    void prefetchEntries(Entry* entries,
+                         size_t count,
+                         Tub<Buffer>* outBuffers,
+                         LogEntryType* outTypes);
     uint64_t relocateLiveEntries(EntryVector& entries,
                                  LogSegmentVector& outSurvivors);
     void closeSurvivor(LogSegment* survivor);
@@ -336,15 +298,17 @@ class LogCleaner {
     const int numThreads;
 
     /// Closed log segments that are candidates for cleaning. Before each
-    /// cleaning pass this list will be updated from the SegmentManager with
+    /// cleaning pass the index will be updated from the SegmentManager with
     /// newly closed segments. The most appropriate segments will then be
-    /// cleaned. This list is shared across all cleaning threads and must only
-    /// be accessed with the candidatesLock held.
-    LogSegmentVector candidates;
+    /// cleaned. The index is shared across all cleaning threads and does its
+    /// own locking.
+    CleanerCandidateIndex candidates;
 
-    /// SpinLock protecting access to candidates. Needed because multiple
-    /// cleaning threads may need to access it simultaneously.
-    SpinLock candidatesLock;
+    /// Decides when each cleaner thread should run and whether it should
+    /// compact or clean on disk, based on memory and disk utilization and on
+    /// how fast the log and the cleaner have recently been consuming and
+    /// freeing memory. Shared across all cleaning threads.
+    CleanerScheduler scheduler;
 
     /// Size of each seglet in bytes. Used to calculate the best segment for in-
     /// memory cleaning.
@@ -373,6 +337,10 @@ class LogCleaner {
     /// Set by halt() to indicate that the cleaning thread(s) should exit.
     bool threadsShouldExit;
 
+    /// Cores on which cleaner threads may run (see ServerConfig::cleanerCpus);
+    /// each thread pins itself to one of them. Empty means run anywhere.
+    vector<uint32_t> cpus;
+
     /// The cleaner spins one or more threads to perform its work (#numThreads).
     /// This vector contains pointers to these threads. When the cleaner is
     /// started, these threads are created. When stopped, they are deleted and
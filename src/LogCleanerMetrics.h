@@ -23,8 +23,11 @@
 #endif
 
 #include "Common.h"
+#include "CycleCounter.h"
 #include "Histogram.h"
+#include "LogEntryTypes.h"
 #include "SpinLock.h"
+#include "Tub.h"
 
 #include "LogMetrics.pb.h"
 
@@ -380,8 +383,8 @@ class OnDisk {
     /// Total number of cpu cycles spent in getSegmentsToClean().
     Metric64BitType getSegmentsToCleanTicks;
 
-    /// Total number of cpu cycles spent sorting candidate segments by best
-    /// cost-benefit.
+    /// Total number of cpu cycles spent picking the candidate segments with
+    /// the best cost-benefit.
     Metric64BitType costBenefitSortTicks;
 
     /// Total number of cpu cycles spent in getSortedEntries().
@@ -41,6 +41,17 @@ class LogEntryHandlers {
      */
     virtual uint32_t getTimestamp(LogEntryType type, Buffer& buffer) = 0;
 
+    /**
+     * This method is called shortly before relocate() is invoked on the
+     * same entry. The cleaner calls it on a batch of entries at once, so
+     * implementations may issue prefetches for any metadata (for example,
+     * hash table buckets) they will need in relocate() and have the cache
+     * misses overlap, rather than taking them one at a time.
+     *
+     * This is only a hint; the default implementation does nothing.
+     */
+    virtual void prefetch(LogEntryType type, Buffer& buffer) { }
+
     /**
      * This method is called for each entry the encountered in segments
      * being cleaned. If the caller wants to retain the data, it should
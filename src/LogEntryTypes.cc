@@ -30,14 +30,22 @@ toString(LogEntryType type)
         return "Invalid";
     case LOG_ENTRY_TYPE_SEGHEADER:
         return "Segment Header";
-    case LOG_ENTRY_TYPE_OBJ:
-        return "Object";
-    case LOG_ENTRY_TYPE_OBJTOMB:
-        return "Object Tombstone";
+    case LOG_ENTRY_TYPE_LEGACY_OBJ:
+        return "Legacy Object";
+    case LOG_ENTRY_TYPE_LEGACY_OBJTOMB:
+        return "Legacy Object Tombstone";
     case LOG_ENTRY_TYPE_LOGDIGEST:
         return "Log Digest";
     case LOG_ENTRY_TYPE_SAFEVERSION:
         return "Object Safe Version";
+    case LOG_ENTRY_TYPE_TABLESTATS:
+        return "Table Stats Digest";
+    case LOG_ENTRY_TYPE_OBJ:
+        return "Object";
+    case LOG_ENTRY_TYPE_OBJTOMB:
+        return "Object Tombstone";
+    case LOG_ENTRY_TYPE_COMPACT_OBJ:
+        return "Compact Object";
     default:
         return "<<Unknown>>";
     }
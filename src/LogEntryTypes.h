@@ -31,11 +31,15 @@ enum LogEntryType {
     /// See LogMetadata.h::SegmentHeader
     LOG_ENTRY_TYPE_SEGHEADER,
 
-    /// See Object.h::Object
-    LOG_ENTRY_TYPE_OBJ,
+    /// An object in the format used before the key hash was stored in the
+    /// log. Masters no longer write these, but replicas written by older
+    /// masters may still contain them; RecoverySegmentBuilder converts them
+    /// to LOG_ENTRY_TYPE_OBJ during recovery.
+    LOG_ENTRY_TYPE_LEGACY_OBJ,
 
-    /// See Object.h::ObjectTombstone
-    LOG_ENTRY_TYPE_OBJTOMB,
+    /// A tombstone in the format used before the key hash was stored in the
+    /// log. See LOG_ENTRY_TYPE_LEGACY_OBJ.
+    LOG_ENTRY_TYPE_LEGACY_OBJTOMB,
 
     /// See LogMetadata.h::LogDigest
     LOG_ENTRY_TYPE_LOGDIGEST,
@@ -43,6 +47,21 @@ enum LogEntryType {
     /// See Object.h::ObjectSafeVersion
     LOG_ENTRY_TYPE_SAFEVERSION,
 
+    /// See TableStats.h::Digest
+    LOG_ENTRY_TYPE_TABLESTATS,
+
+    /// See Object.h::Object
+    LOG_ENTRY_TYPE_OBJ,
+
+    /// See Object.h::ObjectTombstone
+    LOG_ENTRY_TYPE_OBJTOMB,
+
+    /// An object whose header a segment stored in compact form (see
+    /// Segment::setCompactObjects). Only Segment and SegmentIterator ever
+    /// see this type: they expand these entries and return them as
+    /// LOG_ENTRY_TYPE_OBJ.
+    LOG_ENTRY_TYPE_COMPACT_OBJ,
+
     /// Not a type, but rather the total number of types we have defined.
     /// This is currently restricted by the lower 6 bits in a uint8_t field
     /// in Segment.h's Segment::EntryHeader. RAMCloud will probably collapse
@@ -147,6 +147,10 @@ TEST_F(LogIteratorTest, isDone_simple) {
         EXPECT_EQ(LOG_ENTRY_TYPE_SAFEVERSION, i.getType());
         i.next();
 
+        EXPECT_FALSE(i.isDone());
+        EXPECT_EQ(LOG_ENTRY_TYPE_TABLESTATS, i.getType());
+        i.next();
+
         EXPECT_TRUE(i.isDone());
     }
 
@@ -158,7 +162,7 @@ TEST_F(LogIteratorTest, isDone_simple) {
     int count;
     for (count = 0; !i.isDone(); count++)
         i.next();
-    EXPECT_EQ(4, count);
+    EXPECT_EQ(5, count);
 }
 
 #if 0
@@ -211,7 +215,8 @@ TEST_F(LogIteratorTest, next) {
         EXPECT_EQ(0U, i.segmentList.size());
         EXPECT_FALSE(i.currentIterator->isDone());
 
-        // We have <SegHeader, LogDigest, Object> in the log.
+        // We have <SegHeader, LogDigest, SafeVersion, TableStats, Object>
+        // in the log.
         Segment* lastSegment = i.currentIterator->segment;
         EXPECT_EQ(LOG_ENTRY_TYPE_SEGHEADER, i.getType());
 
@@ -223,6 +228,10 @@ TEST_F(LogIteratorTest, next) {
         EXPECT_EQ(LOG_ENTRY_TYPE_SAFEVERSION, i.getType());
         EXPECT_EQ(lastSegment, i.currentIterator->segment);
 
+        i.next();
+        EXPECT_EQ(LOG_ENTRY_TYPE_TABLESTATS, i.getType());
+        EXPECT_EQ(lastSegment, i.currentIterator->segment);
+
         i.next();
         EXPECT_EQ(LOG_ENTRY_TYPE_OBJ, i.getType());
         EXPECT_EQ(lastSegment, i.currentIterator->segment);
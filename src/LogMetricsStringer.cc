@@ -136,6 +136,15 @@ LogMetricsStringer::getServerParameters()
     s += ls + format("  Min Disk Utilization:          %d\n",
         logMetrics->cleaner_metrics().min_disk_utilization());
 
+    s += ls + format("  Earliest Memory Utilization:   %d\n",
+        logMetrics->cleaner_metrics().earliest_memory_utilization());
+
+    s += ls + format("  Memory Depleted Utilization:   %d\n",
+        logMetrics->cleaner_metrics().memory_depleted_utilization());
+
+    s += ls + format("  Cleaning Lead Time:            %d ms\n",
+        logMetrics->cleaner_metrics().lead_time_ms());
+
     return s;
 }
 
@@ -156,6 +165,21 @@ LogMetricsStringer::getGenericCleanerMetrics()
         Cycles::toSeconds(cleanerMetrics.do_work_ticks(), serverHz));
     s += ls + format("    Time Sleeping:               %.3f sec\n",
         Cycles::toSeconds(cleanerMetrics.do_work_sleep_ticks(), serverHz));
+    s += ls + format("  Candidates Examined:           %lu\n",
+        cleanerMetrics.total_candidates_examined());
+    s += ls + format("  Candidate Refiles:             %lu (%.3f sec)\n",
+        cleanerMetrics.total_candidate_refiles(),
+        Cycles::toSeconds(cleanerMetrics.candidate_refile_ticks(), serverHz));
+    s += ls + format("  Append Rate:                   %.2f MB/s\n",
+        d(cleanerMetrics.append_bytes_per_second()) / 1024 / 1024);
+    s += ls + format("  Compaction Free Rate:          %.2f MB/s\n",
+        d(cleanerMetrics.compaction_bytes_per_second()) / 1024 / 1024);
+    s += ls + format("  Disk Cleaning Free Rate:       %.2f MB/s\n",
+        d(cleanerMetrics.disk_cleaning_bytes_per_second()) / 1024 / 1024);
+    s += ls + format("  Early Compactions:             %lu\n",
+        cleanerMetrics.total_early_compactions());
+    s += ls + format("  Compaction Fallbacks:          %lu\n",
+        cleanerMetrics.total_compaction_fallbacks());
 
     const ProtoBuf::LogMetrics_CleanerMetrics_ThreadMetrics& threadMetrics =
         cleanerMetrics.thread_metrics();
@@ -278,7 +302,7 @@ LogMetricsStringer::getDiskCleanerMetrics()
 
     double sortSegmentTime = Cycles::toSeconds(
         onDiskMetrics.cost_benefit_sort_ticks(), serverHz);
-    s += ls + format("      Sort Segments:             %.3f sec "
+    s += ls + format("      Rank Segments:             %.3f sec "
         "(%.2f%%, %.2f%% active)\n",
         sortSegmentTime,
         100.0 * sortSegmentTime / elapsedTime,
@@ -527,6 +551,21 @@ LogMetricsStringer::getLogMetrics()
         onDisk,
         100 * static_cast<double>(onDisk) / static_cast<double>(logSegments));
 
+    if (logMetrics->has_expiry_metrics()) {
+        const ProtoBuf::LogMetrics_ExpiryMetrics& em =
+            logMetrics->expiry_metrics();
+        s += ls + format("  Expired Objects Dropped:       %lu "
+            "(%.2f MB)\n",
+            em.total_expired_objects(),
+            d(em.total_expired_bytes()) / 1024 / 1024);
+        s += ls + format("    Reads of Expired Objects:    %lu\n",
+            em.total_expired_reads());
+        s += ls + format("  Objects Evicted:               %lu "
+            "(%.2f MB)\n",
+            em.total_evicted_objects(),
+            d(em.total_evicted_bytes()) / 1024 / 1024);
+    }
+
     return s;
 }
 
@@ -30,6 +30,8 @@
 
 namespace RAMCloud {
 
+class CleanerCandidateIndex;
+
 /// Redeclare the typedef defined in SegmentManager.h to avoid a cyclical
 /// dependency. See SegmentManager.h's typedef comments for documentation on
 /// this type.
@@ -85,8 +87,9 @@ class LogSegment : public Segment {
           creationTimestamp(creationTimestamp),
           isEmergencyHead(isEmergencyHead),
           cleanedEpoch(0),
-          costBenefit(0),
-          costBenefitVersion(0),
+          candidateIndex(NULL),
+          indexedUtilization(0),
+          indexedFreeableSeglets(0),
           replicatedSegment(NULL),
           listEntries(),
           allListEntries(),
@@ -180,16 +183,17 @@ class LogSegment : public Segment {
     /// memory may be safely freed and reused.
     uint64_t cleanedEpoch;
 
-    /// Cached value of this segment's cost-benefit score as computed by the
-    /// cleaner. This value is really only of interest to the cleaner.
-    uint64_t costBenefit;
+    /// The cleaner's CleanerCandidateIndex while this segment is a cleaning
+    /// candidate, otherwise NULL. AbstractLog::free() uses this to tell the
+    /// index when the segment's live bytes change.
+    std::atomic<CleanerCandidateIndex*> candidateIndex;
+
+    /// Disk utilization this segment is filed under in candidateIndex.
+    uint32_t indexedUtilization;
 
-    /// Version of our cached costBenefit value. The cleaner uses this to check
-    /// when it must recompute and when it must use the cached value instead.
-    /// The point is that the costBenefit value must not change while std::sort
-    /// is in progress. This version ensures that the costBenefit calculation
-    /// is performed only once each time segments are evaluated for cleaning.
-    uint64_t costBenefitVersion;
+    /// Number of freeable seglets this segment is filed under in
+    /// candidateIndex.
+    uint32_t indexedFreeableSeglets;
 
     /// The ReplicatedSegment instance that is responsible for replicating and
     /// this segment to backups.
@@ -88,6 +88,56 @@ MasterService::~MasterService()
 {
 }
 
+/**
+ * Hold off writes (including increments and multi-writes) while the log is
+ * nearly out of memory, rather than letting them fail and having clients
+ * retry immediately (see Service::admitRpc). Writes are admitted as long as
+ * there's enough free memory for another head segment; below that, they wait
+ * in ServiceManager for the cleaner to free some.
+ */
+bool
+MasterService::admitRpc(WireFormat::Opcode opcode,
+                        Buffer* requestPayload,
+                        uint32_t* minRetryDelayMicros,
+                        uint32_t* maxRetryDelayMicros)
+{
+    switch (opcode) {
+        case WireFormat::WRITE:
+        case WireFormat::INCREMENT:
+            break;
+        case WireFormat::MULTI_OP: {
+            const WireFormat::MultiOp::Request* reqHdr =
+                requestPayload->getStart<WireFormat::MultiOp::Request>();
+            if (reqHdr == NULL || reqHdr->type != WireFormat::MultiOp::WRITE)
+                return true;
+            break;
+        }
+        default:
+            return true;
+    }
+    if (objectManager.getLog()->getWriteCredit() >= config->segmentSize)
+        return true;
+    getWriteRetryDelay(minRetryDelayMicros, maxRetryDelayMicros);
+    return false;
+}
+
+/**
+ * Reads may carry a client-supplied deadline (see Service::getRpcDeadline);
+ * nothing else does.
+ */
+uint32_t
+MasterService::getRpcDeadline(WireFormat::Opcode opcode,
+                              Buffer* requestPayload)
+{
+    if (opcode != WireFormat::READ)
+        return 0;
+    const WireFormat::Read::Request* reqHdr =
+        requestPayload->getStart<WireFormat::Read::Request>();
+    if (reqHdr == NULL)
+        return 0;
+    return reqHdr->deadlineMicros;
+}
+
 // See Server::dispatch.
 void
 MasterService::dispatch(WireFormat::Opcode opcode, Rpc* rpc)
@@ -135,6 +185,10 @@ MasterService::dispatch(WireFormat::Opcode opcode, Rpc* rpc)
             callHandler<WireFormat::GetHeadOfLog, MasterService,
                         &MasterService::getHeadOfLog>(rpc);
             break;
+        case WireFormat::LookupIndexKeys::opcode:
+            callHandler<WireFormat::LookupIndexKeys, MasterService,
+                        &MasterService::lookupIndexKeys>(rpc);
+            break;
         case WireFormat::MigrateTablet::opcode:
             callHandler<WireFormat::MigrateTablet, MasterService,
                         &MasterService::migrateTablet>(rpc);
@@ -163,6 +217,10 @@ MasterService::dispatch(WireFormat::Opcode opcode, Rpc* rpc)
             callHandler<WireFormat::Remove, MasterService,
                         &MasterService::remove>(rpc);
             break;
+        case WireFormat::SetTableExpiry::opcode:
+            callHandler<WireFormat::SetTableExpiry, MasterService,
+                        &MasterService::setTableExpiry>(rpc);
+            break;
         case WireFormat::SplitMasterTablet::opcode:
             callHandler<WireFormat::SplitMasterTablet, MasterService,
                         &MasterService::splitMasterTablet>(rpc);
@@ -171,6 +229,10 @@ MasterService::dispatch(WireFormat::Opcode opcode, Rpc* rpc)
             callHandler<WireFormat::TakeTabletOwnership, MasterService,
                         &MasterService::takeTabletOwnership>(rpc);
             break;
+        case WireFormat::Transaction::opcode:
+            callHandler<WireFormat::Transaction, MasterService,
+                        &MasterService::transaction>(rpc);
+            break;
         case WireFormat::Write::opcode:
             callHandler<WireFormat::Write, MasterService,
                         &MasterService::write>(rpc);
@@ -268,10 +330,97 @@ MasterService::getLogMetrics(
 {
     ProtoBuf::LogMetrics logMetrics;
     objectManager.getLog()->getMetrics(logMetrics);
+    objectManager.getMetrics(*logMetrics.mutable_expiry_metrics());
     respHdr->logMetricsLength = ProtoBuf::serializeToResponse(rpc->replyPayload,
                                                              &logMetrics);
 }
 
+/**
+ * Change one of the thresholds that control when and how this master's log
+ * cleaner runs (see CleanerScheduler::setOption). Invoked by PingService for
+ * SET_CLEANER_OPTION server control requests.
+ *
+ * \param option
+ *      Name of the option to change (e.g. "minMemoryUtilization").
+ * \param value
+ *      String representation of the new value.
+ * \return
+ *      True if the option was changed, false if there is no such option or
+ *      the value was invalid.
+ */
+bool
+MasterService::setCleanerOption(const char* option, const char* value)
+{
+    return objectManager.getLog()->setCleanerOption(option, value);
+}
+
+/**
+ * Top-level server method to handle the LOOKUP_INDEX_KEYS request.
+ *
+ * \copydetails Service::ping
+ */
+void
+MasterService::lookupIndexKeys(
+    const WireFormat::LookupIndexKeys::Request* reqHdr,
+    WireFormat::LookupIndexKeys::Response* respHdr,
+    Rpc* rpc)
+{
+    uint32_t offset = sizeof32(*reqHdr);
+    if (offset + reqHdr->firstKeyLength + reqHdr->firstPrimaryKeyLength +
+            reqHdr->lastKeyLength > rpc->requestPayload->getTotalLength()) {
+        respHdr->common.status = STATUS_REQUEST_FORMAT_ERROR;
+        return;
+    }
+    string firstKey(reqHdr->firstKeyLength, '\0');
+    rpc->requestPayload->copy(offset, reqHdr->firstKeyLength, &firstKey[0]);
+    offset += reqHdr->firstKeyLength;
+    string firstPrimaryKey(reqHdr->firstPrimaryKeyLength, '\0');
+    rpc->requestPayload->copy(offset, reqHdr->firstPrimaryKeyLength,
+                              &firstPrimaryKey[0]);
+    offset += reqHdr->firstPrimaryKeyLength;
+    string lastKey(reqHdr->lastKeyLength, '\0');
+    rpc->requestPayload->copy(offset, reqHdr->lastKeyLength, &lastKey[0]);
+
+    TabletManager::Tablet tablet;
+    if (!tabletManager.getTablet(reqHdr->tableId, reqHdr->tabletFirstHash,
+                                 &tablet) ||
+            tablet.state != TabletManager::NORMAL) {
+        respHdr->common.status = STATUS_UNKNOWN_TABLET;
+        return;
+    }
+
+    // As in enumerate(), filter by the hash the client asked for rather than
+    // the start of the tablet we own, in case tablets were merged between
+    // requests.
+    // Leave room in the response for the (16-bit length) keys of nextEntry.
+    Tub<IndexletManager::Entry> nextEntry;
+    uint32_t maxBytes = downCast<uint32_t>(Transport::MAX_RPC_LEN -
+        sizeof(*respHdr) - 2 * ((1 << 16) - 1));
+    respHdr->numResults = objectManager.lookupIndexKeys(reqHdr->tableId,
+        reqHdr->indexId, firstKey, firstPrimaryKey, lastKey,
+        reqHdr->tabletFirstHash, tablet.endKeyHash, reqHdr->maxResults,
+        reqHdr->returnObjects != 0, maxBytes, rpc->replyPayload, &nextEntry);
+
+    // Note: If this is the last tablet, this rolls around to 0.
+    respHdr->tabletFirstHash = tablet.endKeyHash + 1;
+    if (nextEntry) {
+        respHdr->haveNext = 1;
+        respHdr->nextKeyLength = downCast<uint16_t>(
+            nextEntry->indexKey.size());
+        respHdr->nextPrimaryKeyLength = downCast<uint16_t>(
+            nextEntry->primaryKey.size());
+        memcpy(new(rpc->replyPayload, APPEND) char[respHdr->nextKeyLength],
+               nextEntry->indexKey.data(), respHdr->nextKeyLength);
+        memcpy(new(rpc->replyPayload, APPEND)
+                    char[respHdr->nextPrimaryKeyLength],
+               nextEntry->primaryKey.data(), respHdr->nextPrimaryKeyLength);
+    } else {
+        respHdr->haveNext = 0;
+        respHdr->nextKeyLength = 0;
+        respHdr->nextPrimaryKeyLength = 0;
+    }
+}
+
 /**
  * Fill a master server with the given number of objects, each of the
  * same given size. Objects are added to all tables in the master in
@@ -586,8 +735,13 @@ MasterService::multiWrite(const WireFormat::MultiOp::Request* reqHdr,
 
     respHdr->count = numRequests;
 
-    // Each iteration extracts one request from the rpc, writes the object
-    // if possible, and appends a status and version to the response buffer.
+    // Parse all of the requests first so that the objects can be written
+    // to the log as a batch rather than one at a time.
+    std::unique_ptr<Tub<Key>[]> keys(new Tub<Key>[numRequests]);
+    std::unique_ptr<RejectRules[]> rejectRules(new RejectRules[numRequests]);
+    std::unique_ptr<ObjectManager::WriteOp[]> ops(
+        new ObjectManager::WriteOp[numRequests]);
+    uint32_t numParsed = 0;
     for (uint32_t i = 0; i < numRequests; i++) {
         const WireFormat::MultiOp::Request::WritePart *currentReq =
             rpc->requestPayload->getOffset<
@@ -611,19 +765,27 @@ MasterService::multiWrite(const WireFormat::MultiOp::Request* reqHdr,
             break;
         }
 
-        Key key(currentReq->tableId, stringKey, currentReq->keyLength);
-        Buffer buffer;
-        buffer.append(value, currentReq->valueLength);
+        keys[i].construct(currentReq->tableId, stringKey,
+                          currentReq->keyLength);
+        rejectRules[i] = currentReq->rejectRules;
+        ObjectManager::WriteOp& op = ops[i];
+        op.key = keys[i].get();
+        op.value = value;
+        op.valueLength = currentReq->valueLength;
+        op.rejectRules = &rejectRules[i];
+        op.status = STATUS_OK;
+        op.version = VERSION_NONEXISTENT;
+        numParsed++;
+    }
+
+    objectManager.writeObjects(ops.get(), numParsed);
 
+    for (uint32_t i = 0; i < numParsed; i++) {
         WireFormat::MultiOp::Response::WritePart* currentResp =
             new(rpc->replyPayload, APPEND)
                 WireFormat::MultiOp::Response::WritePart();
-
-        RejectRules rejectRules = currentReq->rejectRules;
-        currentResp->status = objectManager.writeObject(key,
-                                                         buffer,
-                                                         &rejectRules,
-                                                         &currentResp->version);
+        currentResp->status = ops[i].status;
+        currentResp->version = ops[i].version;
     }
 
     // By design, our response will be shorter than the request. This ensures
@@ -661,6 +823,7 @@ MasterService::read(const WireFormat::Read::Request* reqHdr,
     const void* stringKey = rpc->requestPayload->getRange(reqOffset,
                                                         reqHdr->keyLength);
     Key key(reqHdr->tableId, stringKey, reqHdr->keyLength);
+    key.setHash(reqHdr->keyHash);
 
     RejectRules rejectRules = reqHdr->rejectRules;
     Buffer buffer;
@@ -709,6 +872,35 @@ MasterService::dropTabletOwnership(
     }
 }
 
+/**
+ * Top-level server method to handle the SET_TABLE_EXPIRY request.
+ *
+ * \copydetails Service::ping
+ */
+void
+MasterService::setTableExpiry(
+    const WireFormat::SetTableExpiry::Request* reqHdr,
+    WireFormat::SetTableExpiry::Response* respHdr,
+    Rpc* rpc)
+{
+    TabletManager::Tablet tablet;
+    if (!tabletManager.setExpiryPolicy(reqHdr->tableId,
+                                       reqHdr->tabletFirstHash,
+                                       reqHdr->ttl,
+                                       reqHdr->evictable != 0,
+                                       &tablet)) {
+        respHdr->common.status = STATUS_UNKNOWN_TABLET;
+        return;
+    }
+
+    LOG(NOTICE, "Tablet [0x%lx,0x%lx] of table %lu now has ttl %u s and is "
+        "%sevictable", tablet.startKeyHash, tablet.endKeyHash,
+        tablet.tableId, tablet.ttl, tablet.evictable ? "" : "not ");
+
+    // Note: If this is the last tablet, this rolls around to 0.
+    respHdr->tabletFirstHash = tablet.endKeyHash + 1;
+}
+
 /**
  * Top-level server method to handle the SPLIT_MASTER_TABLET_OWNERSHIP request.
  *
@@ -1562,7 +1754,7 @@ MasterService::recover(const WireFormat::Recover::Request* reqHdr,
 {
     ReplicatedSegment::recoveryStart = Cycles::rdtsc();
     CycleCounter<RawMetric> recoveryTicks(&metrics->master.recoveryTicks);
-    metrics->master.recoveryCount++;
+    ++metrics->master.recoveryCount;
     metrics->master.replicas = objectManager.getReplicaManager()->numReplicas;
 
     uint64_t recoveryId = reqHdr->recoveryId;
@@ -1710,6 +1902,8 @@ MasterService::remove(const WireFormat::Remove::Request* reqHdr,
     respHdr->common.status = objectManager.removeObject(key,
                                                         &rejectRules,
                                                         &respHdr->version);
+    if (respHdr->common.status == STATUS_RETRY)
+        throwLogFullRetry();
     if (respHdr->common.status == STATUS_OK)
         objectManager.syncChanges();
 }
@@ -1750,6 +1944,8 @@ MasterService::increment(const WireFormat::Increment::Request* reqHdr,
 
     *status = objectManager.writeObject(key, newValueBuffer,
         &rejectRules, &respHdr->version);
+    if (*status == STATUS_RETRY)
+        throwLogFullRetry();
     if (*status != STATUS_OK)
         return;
     objectManager.syncChanges();
@@ -1774,6 +1970,81 @@ MasterService::isReplicaNeeded(
         backupServerId, reqHdr->segmentId);
 }
 
+/**
+ * Top-level server method to handle the TRANSACTION request.
+ *
+ * \copydetails MasterService::read
+ */
+void
+MasterService::transaction(const WireFormat::Transaction::Request* reqHdr,
+                           WireFormat::Transaction::Response* respHdr,
+                           Rpc* rpc)
+{
+    uint32_t numRequests = reqHdr->count;
+    uint32_t reqOffset = sizeof32(*reqHdr);
+
+    std::unique_ptr<Tub<Key>[]> keys(new Tub<Key>[numRequests]);
+    std::unique_ptr<RejectRules[]> rejectRules(new RejectRules[numRequests]);
+    std::unique_ptr<ObjectManager::TransactionOp[]> ops(
+        new ObjectManager::TransactionOp[numRequests]);
+    for (uint32_t i = 0; i < numRequests; i++) {
+        const WireFormat::Transaction::Request::Part* part =
+            rpc->requestPayload->getOffset<
+                WireFormat::Transaction::Request::Part>(reqOffset);
+        if (part == NULL ||
+                part->type > WireFormat::Transaction::REMOVE) {
+            respHdr->common.status = STATUS_REQUEST_FORMAT_ERROR;
+            return;
+        }
+        reqOffset += sizeof32(*part);
+        const void* stringKey = rpc->requestPayload->getRange(
+            reqOffset, part->keyLength);
+        reqOffset += part->keyLength;
+        const void* value = NULL;
+        if (part->valueLength > 0) {
+            value = rpc->requestPayload->getRange(reqOffset,
+                                                  part->valueLength);
+        }
+        reqOffset += part->valueLength;
+        if (stringKey == NULL || (value == NULL && part->valueLength > 0)) {
+            respHdr->common.status = STATUS_REQUEST_FORMAT_ERROR;
+            return;
+        }
+
+        keys[i].construct(part->tableId, stringKey, part->keyLength);
+        rejectRules[i] = part->rejectRules;
+        ObjectManager::TransactionOp& op = ops[i];
+        op.type = static_cast<WireFormat::Transaction::OpType>(part->type);
+        op.key = keys[i].get();
+        op.value = value;
+        op.valueLength = part->valueLength;
+        op.rejectRules = &rejectRules[i];
+        op.status = STATUS_OK;
+        op.version = VERSION_NONEXISTENT;
+    }
+
+    Status status = objectManager.commitTransaction(ops.get(), numRequests);
+    if (status == STATUS_REQUEST_FORMAT_ERROR || status == STATUS_RETRY ||
+            (status == STATUS_UNKNOWN_TABLET && numRequests > 0 &&
+             ops[0].status == STATUS_UNKNOWN_TABLET)) {
+        // The client sends the request to the master of the first key, so
+        // if that one isn't here the client's tablet map is out of date.
+        respHdr->common.status = status;
+        return;
+    }
+
+    respHdr->count = numRequests;
+    for (uint32_t i = 0; i < numRequests; i++) {
+        WireFormat::Transaction::Response::Part* respPart =
+            new(rpc->replyPayload, APPEND)
+                WireFormat::Transaction::Response::Part();
+        respPart->status = ops[i].status;
+        respPart->version = ops[i].version;
+    }
+    if (status == STATUS_OK)
+        objectManager.syncChanges();
+}
+
 /**
  * Top-level server method to handle the WRITE request.
  *
@@ -1793,14 +2064,69 @@ MasterService::write(const WireFormat::Write::Request* reqHdr,
             *rpc->requestPayload,
             sizeof32(*reqHdr),
             reqHdr->keyLength);
+    key.setHash(reqHdr->keyHash);
+
+    // Any secondary keys follow the value.
+    Buffer secondaryKeys;
+    if (reqHdr->secondaryKeysLength > 0) {
+        uint32_t offset = sizeof32(*reqHdr) + reqHdr->keyLength +
+                          reqHdr->length;
+        if (!IndexKey::isValid(*rpc->requestPayload, offset,
+                               reqHdr->secondaryKeysLength)) {
+            respHdr->common.status = STATUS_REQUEST_FORMAT_ERROR;
+            return;
+        }
+        secondaryKeys.append(rpc->requestPayload->getRange(offset,
+                                 reqHdr->secondaryKeysLength),
+                             reqHdr->secondaryKeysLength);
+    }
 
     RejectRules rejectRules = reqHdr->rejectRules;
     respHdr->common.status = objectManager.writeObject(key,
-        buffer, &rejectRules, &respHdr->version);
+        buffer, &rejectRules, &respHdr->version,
+        reqHdr->secondaryKeysLength > 0 ? &secondaryKeys : NULL);
+    if (respHdr->common.status == STATUS_RETRY)
+        throwLogFullRetry();
     if (respHdr->common.status == STATUS_OK)
         objectManager.syncChanges();
 }
 
+/**
+ * Suggest how long a client should wait before retrying a write that
+ * couldn't be performed for lack of log space: about as long as the cleaner
+ * is expected to take to free enough memory for another head segment.
+ * Clients pick a random delay in the range, which is wide enough to keep
+ * them from all coming back together.
+ *
+ * \param[out] minDelayMicros
+ *      Set to the shortest suggested delay.
+ * \param[out] maxDelayMicros
+ *      Set to the longest suggested delay.
+ */
+void
+MasterService::getWriteRetryDelay(uint32_t* minDelayMicros,
+                                  uint32_t* maxDelayMicros)
+{
+    uint32_t delay = objectManager.getLog()->getWriteRetryDelayMicros();
+    *minDelayMicros = delay / 2;
+    *maxDelayMicros = delay + delay / 2;
+}
+
+/**
+ * Reject a write RPC because the log is out of space, telling the client
+ * when to try again (see getWriteRetryDelay).
+ *
+ * \throw RetryException
+ *      Always.
+ */
+void
+MasterService::throwLogFullRetry()
+{
+    uint32_t minDelayMicros, maxDelayMicros;
+    getWriteRetryDelay(&minDelayMicros, &maxDelayMicros);
+    throw RetryException(HERE, minDelayMicros, maxDelayMicros);
+}
+
 /**
  * Construct a Disabler object (disable the associated master).
  *
@@ -56,6 +56,12 @@ class MasterService : public Service {
     void dispatch(WireFormat::Opcode opcode,
                   Rpc* rpc);
     int maxThreads() { return config->master.masterServiceThreadCount; }
+    bool admitRpc(WireFormat::Opcode opcode,
+                  Buffer* requestPayload,
+                  uint32_t* minRetryDelayMicros,
+                  uint32_t* maxRetryDelayMicros);
+    uint32_t getRpcDeadline(WireFormat::Opcode opcode, Buffer* requestPayload);
+    bool setCleanerOption(const char* option, const char* value);
 
     /*
      * The following class is used to temporarily disable the servicing of
@@ -127,6 +133,9 @@ class MasterService : public Service {
     void getHeadOfLog(const WireFormat::GetHeadOfLog::Request* reqHdr,
                       WireFormat::GetHeadOfLog::Response* respHdr,
                       Rpc* rpc);
+    void lookupIndexKeys(const WireFormat::LookupIndexKeys::Request* reqHdr,
+                         WireFormat::LookupIndexKeys::Response* respHdr,
+                         Rpc* rpc);
     void multiOp(const WireFormat::MultiOp::Request* reqHdr,
                    WireFormat::MultiOp::Response* respHdr,
                    Rpc* rpc);
@@ -175,12 +184,21 @@ class MasterService : public Service {
     void remove(const WireFormat::Remove::Request* reqHdr,
                 WireFormat::Remove::Response* respHdr,
                 Rpc* rpc);
+    void setTableExpiry(const WireFormat::SetTableExpiry::Request* reqHdr,
+                WireFormat::SetTableExpiry::Response* respHdr,
+                Rpc* rpc);
     void splitMasterTablet(const WireFormat::SplitMasterTablet::Request* reqHdr,
                 WireFormat::SplitMasterTablet::Response* respHdr,
                 Rpc* rpc);
+    void transaction(const WireFormat::Transaction::Request* reqHdr,
+               WireFormat::Transaction::Response* respHdr,
+               Rpc* rpc);
     void write(const WireFormat::Write::Request* reqHdr,
                WireFormat::Write::Response* respHdr,
                Rpc* rpc);
+    void getWriteRetryDelay(uint32_t* minDelayMicros,
+                            uint32_t* maxDelayMicros);
+    void throwLogFullRetry() __attribute__((noreturn));
 
   public:
     /// Shared RAMCloud information.
@@ -32,6 +32,7 @@
 #include "ShortMacros.h"
 #include "StringUtil.h"
 #include "Tablets.pb.h"
+#include "WallTime.h"
 
 namespace RAMCloud {
 
@@ -324,6 +325,52 @@ class MasterServiceTest : public ::testing::Test {
     DISALLOW_COPY_AND_ASSIGN(MasterServiceTest);
 };
 
+TEST_F(MasterServiceTest, admitRpc) {
+    Buffer request;
+    WireFormat::MultiOp::Request* multiOp =
+        new(&request, APPEND) WireFormat::MultiOp::Request();
+    multiOp->type = WireFormat::MultiOp::WRITE;
+    uint32_t minDelay = 0, maxDelay = 0;
+    EXPECT_TRUE(service->admitRpc(WireFormat::WRITE, &request,
+                                  &minDelay, &maxDelay));
+
+    // Use up all of the log's free memory.
+    SegletAllocator& allocator =
+        service->objectManager.segmentManager.getAllocator();
+    vector<Seglet*> seglets;
+    EXPECT_TRUE(allocator.alloc(SegletAllocator::DEFAULT,
+        downCast<uint32_t>(allocator.getFreeCount(SegletAllocator::DEFAULT)),
+        seglets));
+    EXPECT_FALSE(service->admitRpc(WireFormat::WRITE, &request,
+                                   &minDelay, &maxDelay));
+    EXPECT_EQ(500U, minDelay);
+    EXPECT_EQ(1500U, maxDelay);
+    EXPECT_FALSE(service->admitRpc(WireFormat::INCREMENT, &request,
+                                   &minDelay, &maxDelay));
+    EXPECT_FALSE(service->admitRpc(WireFormat::MULTI_OP, &request,
+                                   &minDelay, &maxDelay));
+    multiOp->type = WireFormat::MultiOp::READ;
+    EXPECT_TRUE(service->admitRpc(WireFormat::MULTI_OP, &request,
+                                  &minDelay, &maxDelay));
+    EXPECT_TRUE(service->admitRpc(WireFormat::READ, &request,
+                                  &minDelay, &maxDelay));
+
+    foreach (Seglet* seglet, seglets)
+        seglet->free();
+    EXPECT_TRUE(service->admitRpc(WireFormat::WRITE, &request,
+                                  &minDelay, &maxDelay));
+}
+
+TEST_F(MasterServiceTest, getRpcDeadline) {
+    Buffer request;
+    EXPECT_EQ(0U, service->getRpcDeadline(WireFormat::READ, &request));
+    WireFormat::Read::Request* reqHdr =
+        new(&request, APPEND) WireFormat::Read::Request();
+    reqHdr->deadlineMicros = 250;
+    EXPECT_EQ(250U, service->getRpcDeadline(WireFormat::READ, &request));
+    EXPECT_EQ(0U, service->getRpcDeadline(WireFormat::WRITE, &request));
+}
+
 TEST_F(MasterServiceTest, dispatch_disableCount) {
     Buffer request, response;
 
@@ -357,10 +404,10 @@ TEST_F(MasterServiceTest, enumeration_basics) {
     EnumerateTableRpc rpc(ramcloud.get(), 1, 0, iter, objects);
     nextTabletStartHash = rpc.wait(nextIter);
     EXPECT_EQ(0U, nextTabletStartHash);
-    EXPECT_EQ(74U, objects.getTotalLength());
+    EXPECT_EQ(94U, objects.getTotalLength());
 
     // First object.
-    EXPECT_EQ(33U, *objects.getOffset<uint32_t>(0));            // size
+    EXPECT_EQ(43U, *objects.getOffset<uint32_t>(0));            // size
     Buffer buffer1;
     buffer1.append(objects.getRange(4, objects.getTotalLength() - 4),
                      objects.getTotalLength() - 4);
@@ -373,10 +420,10 @@ TEST_F(MasterServiceTest, enumeration_basics) {
                                (object1.getData()), 6));
 
     // Second object.
-    EXPECT_EQ(33U, *objects.getOffset<uint32_t>(37));           // size
+    EXPECT_EQ(43U, *objects.getOffset<uint32_t>(47));           // size
     Buffer buffer2;
-    buffer2.append(objects.getRange(41, objects.getTotalLength() - 41),
-                     objects.getTotalLength() - 41);
+    buffer2.append(objects.getRange(51, objects.getTotalLength() - 51),
+                     objects.getTotalLength() - 51);
     Object object2(buffer2);
     EXPECT_EQ(1U, object2.getTableId());                        // table ID
     EXPECT_EQ(1U, object2.getKeyLength());                      // key length
@@ -431,10 +478,10 @@ TEST_F(MasterServiceTest, enumeration_mergeTablet) {
     EnumerateTableRpc rpc(ramcloud.get(), 1, 0, iter, objects);
     nextTabletStartHash = rpc.wait(nextIter);
     EXPECT_EQ(0U, nextTabletStartHash);
-    EXPECT_EQ(42U, objects.getTotalLength());
+    EXPECT_EQ(52U, objects.getTotalLength());
 
     // Object coresponding to key "678910"
-    EXPECT_EQ(38U, *objects.getOffset<uint32_t>(0));            // size
+    EXPECT_EQ(48U, *objects.getOffset<uint32_t>(0));            // size
     Buffer buffer1;
     buffer1.append(objects.getRange(4, objects.getTotalLength() - 4),
                      objects.getTotalLength() - 4);
@@ -766,10 +813,10 @@ TEST_F(MasterServiceTest, detectSegmentRecoveryFailure_failure) {
 }
 
 TEST_F(MasterServiceTest, getHeadOfLog) {
-    EXPECT_EQ(Log::Position(2, 62),
+    EXPECT_EQ(Log::Position(2, 88),
               MasterClient::getHeadOfLog(&context, masterServer->serverId));
     ramcloud->write(1, "0", 1, "abcdef", 6);
-    EXPECT_EQ(Log::Position(3, 70),
+    EXPECT_EQ(Log::Position(3, 96),
               MasterClient::getHeadOfLog(&context, masterServer->serverId));
 }
 
@@ -1070,8 +1117,8 @@ TEST_F(MasterServiceTest, remove_basics) {
     uint64_t version;
     ramcloud->remove(1, "key0", 4, NULL, &version);
     EXPECT_EQ(1U, version);
-    EXPECT_EQ("free: free on reference 3670070 | "
-              "sync: syncing segment 1 to offset 131 | "
+    EXPECT_EQ("free: free on reference 3670096 | "
+              "sync: syncing segment 1 to offset 175 | "
               "schedule: scheduled | "
               "performWrite: Sending write to backup 1.0 | "
               "schedule: scheduled | "
@@ -1156,6 +1203,24 @@ TEST_F(MasterServiceTest, GetServerStatistics) {
               "spin_lock_stats { locks { name:"));
 }
 
+TEST_F(MasterServiceTest, setTableExpiry) {
+    ramcloud->write(1, "0", 1, "abcdef", 6);
+    ramcloud->setTableExpiry(1, 100, true);
+    TabletManager::Tablet tablet;
+    EXPECT_TRUE(service->tabletManager.getTablet(1, 0, &tablet));
+    EXPECT_EQ(100U, tablet.ttl);
+    EXPECT_TRUE(tablet.evictable);
+
+    Buffer value;
+    WallTime::mockWallTimeValue = WallTime::secondsTimestamp() + 100;
+    EXPECT_THROW(ramcloud->read(1, "0", 1, &value),
+                 ObjectDoesntExistException);
+    WallTime::mockWallTimeValue = 0;
+
+    ProtoBuf::LogMetrics logMetrics;
+    ramcloud->getLogMetrics("mock:host=master", logMetrics);
+    EXPECT_EQ(1U, logMetrics.expiry_metrics().total_expired_reads());
+}
 
 TEST_F(MasterServiceTest, splitMasterTablet) {
 
@@ -1408,7 +1473,7 @@ TEST_F(MasterServiceTest, migrateTablet_movingData) {
         "migrateTablet: Sending last migration segment | "
         "migrateTablet: Migration succeeded for tablet "
         "[0x0,0xffffffffffffffff] in tableId 1; sent 1 objects and "
-        "0 tombstones to server 3.0 at mock:host=master2, 35 bytes in total",
+        "0 tombstones to server 3.0 at mock:host=master2, 45 bytes in total",
         TestLog::get());
 
     // Ensure that the tablet ``creation'' time on the new master is
@@ -1487,6 +1552,80 @@ TEST_F(MasterServiceTest, receiveMigrationData) {
                         32));
 }
 
+TEST_F(MasterServiceTest, transaction_basics) {
+    uint64_t tableId1 = ramcloud->createTable("table1");
+    uint64_t version;
+    ramcloud->write(tableId1, "0", 1, "zero", 4, NULL, &version);
+    ramcloud->write(tableId1, "1", 1, "one", 3);
+    ramcloud->write(tableId1, "2", 1, "two", 3);
+
+    RejectRules rules;
+    memset(&rules, 0, sizeof(rules));
+    rules.givenVersion = version;
+    rules.versionNeGiven = true;
+    TransactionObject check(WireFormat::Transaction::CHECK, tableId1,
+                            "0", 1, &rules);
+    TransactionObject write(WireFormat::Transaction::WRITE, tableId1,
+                            "1", 1, NULL, "uno", 3);
+    TransactionObject remove(WireFormat::Transaction::REMOVE, tableId1,
+                             "2", 1);
+    TransactionObject* requests[] = {&check, &write, &remove};
+    EXPECT_TRUE(ramcloud->transaction(requests, 3));
+    EXPECT_EQ(STATUS_OK, check.status);
+    EXPECT_EQ(version, check.version);
+    EXPECT_EQ(version + 2, write.version);
+    EXPECT_EQ(version + 2, remove.version);
+
+    Buffer value;
+    ramcloud->read(tableId1, "1", 1, &value);
+    EXPECT_EQ("uno", TestUtil::toString(&value));
+    EXPECT_THROW(ramcloud->read(tableId1, "2", 1, &value),
+                 ObjectDoesntExistException);
+}
+
+TEST_F(MasterServiceTest, transaction_aborted) {
+    uint64_t tableId1 = ramcloud->createTable("table1");
+    ramcloud->write(tableId1, "0", 1, "zero", 4);
+
+    RejectRules rules;
+    memset(&rules, 0, sizeof(rules));
+    rules.exists = true;
+    TransactionObject write0(WireFormat::Transaction::WRITE, tableId1,
+                             "0", 1, &rules, "cero", 4);
+    TransactionObject write1(WireFormat::Transaction::WRITE, tableId1,
+                             "1", 1, NULL, "uno", 3);
+    TransactionObject* requests[] = {&write1, &write0};
+    EXPECT_FALSE(ramcloud->transaction(requests, 2));
+    EXPECT_EQ(STATUS_OK, write1.status);
+    EXPECT_EQ(STATUS_OBJECT_EXISTS, write0.status);
+
+    Buffer value;
+    ramcloud->read(tableId1, "0", 1, &value);
+    EXPECT_EQ("zero", TestUtil::toString(&value));
+    EXPECT_THROW(ramcloud->read(tableId1, "1", 1, &value),
+                 ObjectDoesntExistException);
+}
+
+TEST_F(MasterServiceTest, transaction_errors) {
+    uint64_t tableId1 = ramcloud->createTable("table1");
+
+    // Table 99 will be directed to the server, but the server
+    // doesn't know about it.
+    TransactionObject write(WireFormat::Transaction::WRITE, tableId1,
+                            "0", 1, NULL, "zero", 4);
+    TransactionObject bogus(WireFormat::Transaction::WRITE, 99,
+                            "bogus", 5, NULL, "hi", 2);
+    TransactionObject* requests[] = {&write, &bogus};
+    EXPECT_FALSE(ramcloud->transaction(requests, 2));
+    EXPECT_EQ(STATUS_UNKNOWN_TABLET, bogus.status);
+
+    TransactionObject again(WireFormat::Transaction::CHECK, tableId1,
+                            "0", 1);
+    requests[1] = &again;
+    EXPECT_THROW(ramcloud->transaction(requests, 2),
+                 RequestFormatError);
+}
+
 TEST_F(MasterServiceTest, write_basics) {
     Buffer value;
     uint64_t version;
@@ -1494,8 +1633,8 @@ TEST_F(MasterServiceTest, write_basics) {
     TestLog::Enable _;
     ramcloud->write(1, "key0", 4, "item0", 5, NULL, &version);
     EXPECT_EQ(1U, version);
-    EXPECT_EQ("writeObject: object: 35 bytes, version 1 | "
-              "sync: syncing segment 1 to offset 91 | "
+    EXPECT_EQ("writeObject: object: 45 bytes, version 1 | "
+              "sync: syncing segment 1 to offset 127 | "
               "schedule: scheduled | "
               "performWrite: Sending write to backup 1.0 | "
               "schedule: scheduled | "
@@ -0,0 +1,601 @@
+/* Copyright (c) 2013 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+// This program runs an entire RAMCloud cluster (coordinator, masters and
+// backups) inside a single process using MockCluster and BindTransport,
+// then drives it with one or more client threads and reports throughput
+// and latency for each kind of operation.  Since BindTransport invokes
+// services directly in the calling thread, no network is involved: the
+// numbers reflect the cost of the client library, the RPC wrappers and
+// the master and backup hot paths, which makes this a quick way to spot
+// regressions on a single machine.  Use ClusterPerf for measurements of
+// a real cluster.
+//
+// Like the unit tests, this program is built with TESTING defined (for
+// MockCluster), and it reaches into server internals to drive recovery.
+
+#include <algorithm>
+#include <thread>
+
+// Make private structure members public, as TestUtil.h does for the unit
+// tests (see Common.h for details).
+#define EXPOSE_PRIVATES
+
+#include "Common.h"
+#include "BackupClient.h"
+#include "Cycles.h"
+#include "MasterClient.h"
+#include "MockCluster.h"
+#include "OptionParser.h"
+#include "RamCloud.h"
+#include "ShortMacros.h"
+
+namespace RAMCloud {
+
+// Command-line options.
+static uint32_t numMasters;
+static uint32_t numBackups;
+static uint32_t numReplicas;
+static uint32_t numThreads;
+static uint32_t numObjects;
+static uint32_t objectSize;
+static uint32_t batchSize;
+static uint32_t numRecoveries;
+static double seconds;
+
+// The cluster being measured, its masters, and the table holding the
+// benchmark objects.
+static MockCluster* cluster;
+static vector<Server*> masters;
+static uint64_t tableId;
+
+// Used to start all the client threads of a phase at the same time (after
+// they have created their RamCloud objects) and to stop them together.
+static std::atomic<uint32_t> readyThreads;
+static std::atomic<bool> startThreads;
+static uint64_t stopTime;
+
+// The operations this program can measure.
+enum Operation {
+    WRITE,
+    READ,
+    MULTI_WRITE,
+    MULTI_READ,
+    ENUMERATE,
+    RECOVER,
+    NUM_OPERATIONS
+};
+static const char* operationNames[] = {
+    "write", "read", "multiWrite", "multiRead", "enumerate", "recover"
+};
+
+/**
+ * Measurements collected by one thread during one phase of the benchmark.
+ */
+struct Results {
+    Results()
+        : latencies()
+        , objects(0)
+        , start(0)
+        , stop(0)
+    {}
+
+    /// Elapsed time of each operation, in Cycles::rdtsc ticks.
+    vector<uint64_t> latencies;
+
+    /// Number of objects read, written, enumerated or recovered (an
+    /// operation may cover more than one object).
+    uint64_t objects;
+
+    /// Times (from Cycles::rdtsc) at which the thread started and
+    /// finished issuing operations.
+    uint64_t start;
+    uint64_t stop;
+};
+
+/// Length of every key: keys are the binary form of the object's index.
+static const uint16_t KEY_LENGTH = sizeof(uint64_t);
+
+/**
+ * Fill in the key for object \a index.  Keys are the binary form of the
+ * object's index, so they cost nothing to generate.
+ */
+static inline void
+makeKey(uint64_t index, uint64_t* key)
+{
+    *key = index;
+}
+
+/**
+ * Return the number of objects in a buffer returned by enumerateTable.
+ */
+static uint64_t
+countEnumeratedObjects(Buffer& objects)
+{
+    uint64_t count = 0;
+    uint32_t offset = 0;
+    uint32_t length = objects.getTotalLength();
+    while (offset < length) {
+        offset += *objects.getOffset<uint32_t>(offset) + sizeof32(uint32_t);
+        count++;
+    }
+    return count;
+}
+
+/**
+ * Issue one operation of the given type (for the client-driven operations)
+ * and return the number of objects it covered.
+ *
+ * \param ramcloud
+ *      Client to issue the operation with.
+ * \param operation
+ *      Which operation to perform; anything except RECOVER.
+ * \param value
+ *      Contents to use for objects written (objectSize bytes).
+ * \param enumerateHash
+ *      Enumeration position for ENUMERATE: the first key hash of the tablet
+ *      being enumerated; updated to the next tablet on return.
+ * \param enumerateState
+ *      Opaque enumeration state for ENUMERATE; updated on return.
+ */
+static uint64_t
+doOperation(RamCloud& ramcloud, Operation operation, const char* value,
+        uint64_t* enumerateHash, Buffer* enumerateState)
+{
+    uint64_t keys[batchSize];
+    switch (operation) {
+        case WRITE:
+            makeKey(generateRandom() % numObjects, &keys[0]);
+            ramcloud.write(tableId, &keys[0], KEY_LENGTH,
+                           value, objectSize);
+            return 1;
+        case READ: {
+            Buffer buffer;
+            makeKey(generateRandom() % numObjects, &keys[0]);
+            ramcloud.read(tableId, &keys[0], KEY_LENGTH, &buffer);
+            return 1;
+        }
+        case MULTI_WRITE: {
+            MultiWriteObject objects[batchSize];
+            MultiWriteObject* requests[batchSize];
+            for (uint32_t i = 0; i < batchSize; i++) {
+                makeKey(generateRandom() % numObjects, &keys[i]);
+                objects[i] = MultiWriteObject(tableId, &keys[i],
+                        KEY_LENGTH, value, objectSize);
+                requests[i] = &objects[i];
+            }
+            ramcloud.multiWrite(requests, batchSize);
+            return batchSize;
+        }
+        case MULTI_READ: {
+            MultiReadObject objects[batchSize];
+            MultiReadObject* requests[batchSize];
+            Tub<Buffer> values[batchSize];
+            for (uint32_t i = 0; i < batchSize; i++) {
+                makeKey(generateRandom() % numObjects, &keys[i]);
+                objects[i] = MultiReadObject(tableId, &keys[i],
+                        KEY_LENGTH, &values[i]);
+                requests[i] = &objects[i];
+            }
+            ramcloud.multiRead(requests, batchSize);
+            return batchSize;
+        }
+        case ENUMERATE: {
+            Buffer objects;
+            *enumerateHash = ramcloud.enumerateTable(tableId, *enumerateHash,
+                    *enumerateState, objects);
+            if (*enumerateHash == 0)
+                enumerateState->reset();
+            return countEnumeratedObjects(objects);
+        }
+        default:
+            DIE("Operation %s can't be issued by a client thread",
+                operationNames[operation]);
+    }
+}
+
+/**
+ * The main program for each client thread: create a client of its own,
+ * wait for the rest of the threads, then issue operations until stopTime.
+ *
+ * \param operation
+ *      Which operation to issue.
+ * \param results
+ *      Measurements are recorded here.
+ */
+static void
+clientThread(Operation operation, Results* results)
+{
+    // Each thread has its own context, so it has its own dispatcher and
+    // sessions, just like an independent client.
+    Context context;
+    context.transportManager->registerMock(&cluster->transport);
+    RamCloud ramcloud(&context, cluster->coordinatorLocator.c_str());
+    char value[objectSize];
+    memset(value, 'x', objectSize);
+    uint64_t enumerateHash = 0;
+    Buffer enumerateState;
+
+    // Fetch the tablet map before timing starts.
+    Buffer buffer;
+    uint64_t key;
+    makeKey(0, &key);
+    ramcloud.read(tableId, &key, KEY_LENGTH, &buffer);
+
+    readyThreads++;
+    while (!startThreads) {
+        // Wait for the other threads.
+    }
+
+    results->start = Cycles::rdtsc();
+    uint64_t now = results->start;
+    while (now < stopTime) {
+        uint64_t start = now;
+        results->objects += doOperation(ramcloud, operation, value,
+                                        &enumerateHash, &enumerateState);
+        now = Cycles::rdtsc();
+        results->latencies.push_back(now - start);
+    }
+    results->stop = now;
+}
+
+/**
+ * Return the tablets owned by a master, with the fields a recovery master
+ * needs in order to recover them as a single partition.
+ */
+static void
+getRecoveryPartition(Server* master, ProtoBuf::Tablets* partition)
+{
+    vector<TabletManager::Tablet> tablets;
+    master->master->tabletManager.getTablets(&tablets);
+    foreach (TabletManager::Tablet& tablet, tablets) {
+        ProtoBuf::Tablets::Tablet& entry(*partition->add_tablet());
+        entry.set_table_id(tablet.tableId);
+        entry.set_start_key_hash(tablet.startKeyHash);
+        entry.set_end_key_hash(tablet.endKeyHash);
+        entry.set_state(ProtoBuf::Tablets::Tablet::RECOVERING);
+        entry.set_user_data(0);
+        entry.set_ctime_log_head_id(0);
+        entry.set_ctime_log_head_offset(0);
+    }
+}
+
+/**
+ * Recover the objects of the first master onto a separate recovery master,
+ * numRecoveries times.  Each recovery follows the path a real one takes
+ * once the coordinator has chosen recovery masters: the backups read and
+ * partition the crashed master's replicas, and the recovery master
+ * fetches, replays and re-replicates them.  The "crashed" master keeps
+ * running and the coordinator doesn't know about the recovery, so it
+ * tells the recovery master to discard the recovered data afterwards.
+ *
+ * \param context
+ *      Context linked to the cluster, used to send RPCs to the servers.
+ * \param results
+ *      Measurements are recorded here.
+ */
+static void
+recoverMaster(Context* context, Results* results)
+{
+    Server* crashed = masters[0];
+    ServerId crashedId = crashed->serverId;
+    ProtoBuf::Tablets partition;
+    getRecoveryPartition(crashed, &partition);
+
+    // Count the objects the recovery will find, so we can report
+    // objects/sec.
+    uint64_t objectsPerRecovery = 0;
+    for (uint64_t i = 0; i < numObjects; i++) {
+        uint64_t key;
+        makeKey(i, &key);
+        KeyHash hash = Key::getHash(tableId, &key, KEY_LENGTH);
+        foreach (const ProtoBuf::Tablets::Tablet& tablet, partition.tablet()) {
+            if (hash >= tablet.start_key_hash() &&
+                    hash <= tablet.end_key_hash()) {
+                objectsPerRecovery++;
+                break;
+            }
+        }
+    }
+
+    ServerConfig config = crashed->config;
+    config.services = {WireFormat::MASTER_SERVICE,
+                       WireFormat::MEMBERSHIP_SERVICE,
+                       WireFormat::PING_SERVICE};
+    config.localLocator = "mock:host=recoveryMaster";
+    Server* recoveryMaster = cluster->addServer(config);
+
+    // The recovery master reports its results to the coordinator, which
+    // needs its recovery thread for that.
+    cluster->coordinator->recoveryManager.start();
+
+    results->start = Cycles::rdtsc();
+    for (uint64_t recoveryId = 1; recoveryId <= numRecoveries; recoveryId++) {
+        uint64_t start = Cycles::rdtsc();
+        vector<WireFormat::Recover::Replica> replicas;
+        foreach (Server* server, cluster->servers) {
+            if (!server->backup)
+                continue;
+            auto result = BackupClient::startReadingData(context,
+                    server->serverId, recoveryId, crashedId);
+            foreach (auto& replica, result.replicas) {
+                replicas.push_back({server->serverId.getId(),
+                                    replica.segmentId});
+            }
+            BackupClient::StartPartitioningReplicas(context, server->serverId,
+                    recoveryId, crashedId, &partition);
+        }
+        MasterClient::recover(context, recoveryMaster->serverId, recoveryId,
+                crashedId, 0, &partition, &replicas[0],
+                downCast<uint32_t>(replicas.size()));
+        results->latencies.push_back(Cycles::rdtsc() - start);
+        results->objects += objectsPerRecovery;
+    }
+    results->stop = Cycles::rdtsc();
+}
+
+/**
+ * Return a given percentile of a sorted list of latencies, in microseconds.
+ */
+static double
+percentile(const vector<uint64_t>& latencies, double fraction)
+{
+    size_t index = static_cast<size_t>(
+            fraction * static_cast<double>(latencies.size()));
+    if (index >= latencies.size())
+        index = latencies.size() - 1;
+    return Cycles::toSeconds(latencies[index]) * 1e06;
+}
+
+/**
+ * Measure one operation and print a line of results for it.
+ *
+ * \param context
+ *      Context linked to the cluster.
+ * \param operation
+ *      Operation to measure.
+ */
+static void
+runOperation(Context* context, Operation operation)
+{
+    uint32_t threads = (operation == RECOVER) ? 1 : numThreads;
+    Results results[threads];
+
+    if (operation == RECOVER) {
+        recoverMaster(context, &results[0]);
+    } else {
+        std::thread* clients[threads];
+        readyThreads = 0;
+        startThreads = false;
+        for (uint32_t i = 0; i < threads; i++)
+            clients[i] = new std::thread(clientThread, operation, &results[i]);
+        while (readyThreads < threads) {
+            // Wait for all of the clients to be ready.
+        }
+        stopTime = Cycles::rdtsc() + Cycles::fromSeconds(seconds);
+        startThreads = true;
+        for (uint32_t i = 0; i < threads; i++) {
+            clients[i]->join();
+            delete clients[i];
+        }
+    }
+
+    // Merge the results from all of the threads.
+    vector<uint64_t> latencies;
+    uint64_t objects = 0;
+    uint64_t start = ~0UL;
+    uint64_t stop = 0;
+    for (uint32_t i = 0; i < threads; i++) {
+        latencies.insert(latencies.end(), results[i].latencies.begin(),
+                         results[i].latencies.end());
+        objects += results[i].objects;
+        start = std::min(start, results[i].start);
+        stop = std::max(stop, results[i].stop);
+    }
+    if (latencies.empty()) {
+        printf("%-11s %7u %10s\n", operationNames[operation], threads,
+               "no operations completed");
+        return;
+    }
+    std::sort(latencies.begin(), latencies.end());
+    uint64_t total = 0;
+    foreach (uint64_t latency, latencies)
+        total += latency;
+    double elapsed = Cycles::toSeconds(stop - start);
+    double ops = static_cast<double>(latencies.size());
+
+    printf("%-11s %7u %10lu %10.0f %11.0f %8.1f %8.1f %8.1f %8.1f %8.1f\n",
+           operationNames[operation], threads, latencies.size(),
+           ops / elapsed, static_cast<double>(objects) / elapsed,
+           Cycles::toSeconds(total) * 1e06 / ops,
+           percentile(latencies, 0.5), percentile(latencies, 0.99),
+           percentile(latencies, 0.999),
+           Cycles::toSeconds(latencies.back()) * 1e06);
+    fflush(stdout);
+}
+
+/**
+ * Write every benchmark object once, so reads and enumerations find them.
+ */
+static void
+loadObjects(RamCloud& ramcloud)
+{
+    char value[objectSize];
+    memset(value, 'x', objectSize);
+    uint64_t keys[batchSize];
+    MultiWriteObject objects[batchSize];
+    MultiWriteObject* requests[batchSize];
+
+    uint64_t start = Cycles::rdtsc();
+    for (uint32_t first = 0; first < numObjects; first += batchSize) {
+        uint32_t count = std::min(batchSize, numObjects - first);
+        for (uint32_t i = 0; i < count; i++) {
+            makeKey(first + i, &keys[i]);
+            objects[i] = MultiWriteObject(tableId, &keys[i],
+                    KEY_LENGTH, value, objectSize);
+            requests[i] = &objects[i];
+        }
+        ramcloud.multiWrite(requests, count);
+    }
+    printf("Loaded %u objects of %u bytes in %.2f seconds\n", numObjects,
+           objectSize, Cycles::toSeconds(Cycles::rdtsc() - start));
+}
+
+} // namespace RAMCloud
+
+int
+main(int argc, char *argv[])
+try
+{
+    using namespace RAMCloud;
+
+    uint32_t logMegs, hashTableMegs, segmentSize;
+    vector<string> operations;
+
+    OptionsDescription benchmarkOptions("MockClusterBenchmark");
+    benchmarkOptions.add_options()
+        ("masters",
+         ProgramOptions::value<uint32_t>(&numMasters)->default_value(3),
+         "Number of servers running masters")
+        ("backups",
+         ProgramOptions::value<uint32_t>(&numBackups)->default_value(3),
+         "Number of servers running backups")
+        ("replicas",
+         ProgramOptions::value<uint32_t>(&numReplicas)->default_value(1),
+         "Number of backup replicas of each segment")
+        ("threads",
+         ProgramOptions::value<uint32_t>(&numThreads)->default_value(1),
+         "Number of client threads issuing operations concurrently")
+        ("objects",
+         ProgramOptions::value<uint32_t>(&numObjects)->default_value(100000),
+         "Number of objects in the benchmark table")
+        ("size",
+         ProgramOptions::value<uint32_t>(&objectSize)->default_value(100),
+         "Size of each object in bytes")
+        ("batch",
+         ProgramOptions::value<uint32_t>(&batchSize)->default_value(16),
+         "Number of objects in each multiRead and multiWrite")
+        ("seconds",
+         ProgramOptions::value<double>(&seconds)->default_value(1.0),
+         "How long to measure each client operation")
+        ("recoveries",
+         ProgramOptions::value<uint32_t>(&numRecoveries)->default_value(3),
+         "Number of times to recover the first master")
+        ("logMegs",
+         ProgramOptions::value<uint32_t>(&logMegs)->default_value(512),
+         "Megabytes of log memory on each master")
+        ("hashTableMegs",
+         ProgramOptions::value<uint32_t>(&hashTableMegs)->default_value(16),
+         "Megabytes of hash table on each master")
+        ("segmentSize",
+         ProgramOptions::value<uint32_t>(&segmentSize)->
+            default_value(1024 * 1024),
+         "Size of each log segment in bytes")
+        ("operations",
+         ProgramOptions::value<vector<string>>(&operations)->multitoken(),
+         "Operations to measure, in order: any of write, read, multiWrite, "
+         "multiRead, enumerate and recover (default: all of them)");
+
+    OptionParser optionParser(benchmarkOptions, argc, argv);
+    // Recoveries are aborted by the coordinator on purpose (see
+    // recoverMaster); keep the errors that causes out of the results.
+    Logger::get().setLogLevels(SILENT_LOG_LEVEL);
+
+    if (numMasters == 0 || numThreads == 0 || numObjects == 0 ||
+            batchSize == 0) {
+        fprintf(stderr, "--masters, --threads, --objects and --batch must "
+                "all be positive\n");
+        return 1;
+    }
+    vector<Operation> toRun;
+    if (operations.empty()) {
+        for (int op = 0; op < NUM_OPERATIONS; op++)
+            toRun.push_back(static_cast<Operation>(op));
+    }
+    foreach (const string& name, operations) {
+        int op = 0;
+        while (op < NUM_OPERATIONS && name != operationNames[op])
+            op++;
+        if (op == NUM_OPERATIONS) {
+            fprintf(stderr, "Unknown operation '%s'\n", name.c_str());
+            return 1;
+        }
+        toRun.push_back(static_cast<Operation>(op));
+    }
+    if (numBackups < numReplicas) {
+        fprintf(stderr, "Need at least as many backups as replicas\n");
+        return 1;
+    }
+    if (numReplicas == 0) {
+        // Without replicas there is nothing to recover from.
+        toRun.erase(std::remove(toRun.begin(), toRun.end(), RECOVER),
+                    toRun.end());
+    }
+
+    Context context;
+    MockCluster mockCluster(&context);
+    cluster = &mockCluster;
+
+    ServerConfig config = ServerConfig::forTesting();
+    config.segmentSize = segmentSize;
+    config.segletSize = std::min(segmentSize,
+            uint32_t(Seglet::DEFAULT_SEGLET_SIZE));
+    config.maxObjectDataSize = segmentSize / 8;
+    config.master.logBytes = uint64_t(logMegs) * 1024 * 1024;
+    config.master.hashTableBytes = uint64_t(hashTableMegs) * 1024 * 1024;
+    config.master.numReplicas = numReplicas;
+    // Backup frames are only allocated as they are used, so make room for
+    // all of every master's log (plus the recovery master's).
+    config.backup.numSegmentFrames = downCast<uint32_t>(
+            (numMasters + 1) * numReplicas * config.master.logBytes /
+            segmentSize);
+
+    // Backups go first: masters replicate their initial log head as they
+    // enlist.
+    config.services = {WireFormat::BACKUP_SERVICE,
+                       WireFormat::MEMBERSHIP_SERVICE,
+                       WireFormat::PING_SERVICE};
+    for (uint32_t i = 0; i < numBackups; i++) {
+        config.localLocator = format("mock:host=backup%u", i);
+        cluster->addServer(config);
+    }
+    config.services = {WireFormat::MASTER_SERVICE,
+                       WireFormat::MEMBERSHIP_SERVICE,
+                       WireFormat::PING_SERVICE};
+    for (uint32_t i = 0; i < numMasters; i++) {
+        config.localLocator = format("mock:host=master%u", i);
+        masters.push_back(cluster->addServer(config));
+    }
+
+    RamCloud ramcloud(&context, cluster->coordinatorLocator.c_str());
+    tableId = ramcloud.createTable("benchmark", numMasters);
+    loadObjects(ramcloud);
+
+    printf("%u masters, %u backups, %u replicas, %u-byte objects, "
+           "batches of %u\n", numMasters, numBackups, numReplicas,
+           objectSize, batchSize);
+    printf("%-11s %7s %10s %10s %11s %8s %8s %8s %8s %8s\n",
+           "operation", "threads", "ops", "ops/sec", "objects/sec",
+           "avg(us)", "p50", "p99", "p99.9", "max");
+    foreach (Operation operation, toRun)
+        runOperation(&context, operation);
+    return 0;
+} catch (RAMCloud::ClientException& e) {
+    fprintf(stderr, "RAMCloud exception: %s\n", e.str().c_str());
+    return 1;
+} catch (RAMCloud::Exception& e) {
+    fprintf(stderr, "RAMCloud exception: %s\n", e.str().c_str());
+    return 1;
+}
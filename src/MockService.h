@@ -31,7 +31,7 @@ class MockService : public Service {
 
     explicit MockService(int threadLimit = 3) : mutex(), log(),
             gate(0), sendReply(false),
-            threadLimit(threadLimit) { }
+            threadLimit(threadLimit), admit(true), deadlineMicros(0) { }
     virtual ~MockService() {}
     virtual void dispatch(WireFormat::Opcode opcode, Rpc* rpc)
     {
@@ -45,13 +45,17 @@ class MockService : public Service {
         }
 
         // Create a response that increments each of the (integer) values
-        // in the request.  Throw an error if value 54321 appears.
+        // in the request.  Throw an error if value 54321 appears, and ask
+        // for a retry if 54322 appears.
         for (uint32_t i = 0; i < rpc->requestPayload->getTotalLength()-3;
                 i += 4) {
             int32_t inputValue = *(rpc->requestPayload->getOffset<int32_t>(i));
             if (inputValue == 54321) {
                 throw ClientException(HERE, STATUS_REQUEST_FORMAT_ERROR);
             }
+            if (inputValue == 54322) {
+                throw RetryException(HERE, 100, 200);
+            }
             *(new(rpc->replyPayload, APPEND) int32_t) = inputValue+1;
         }
         int secondWord = *(rpc->requestPayload->getOffset<int>(4));
@@ -76,6 +80,18 @@ class MockService : public Service {
     virtual int maxThreads() {
         return threadLimit;
     }
+    virtual bool admitRpc(WireFormat::Opcode opcode,
+                          Buffer* requestPayload,
+                          uint32_t* minRetryDelayMicros,
+                          uint32_t* maxRetryDelayMicros) {
+        *minRetryDelayMicros = 300;
+        *maxRetryDelayMicros = 400;
+        return admit;
+    }
+    virtual uint32_t getRpcDeadline(WireFormat::Opcode opcode,
+                                    Buffer* requestPayload) {
+        return deadlineMicros;
+    }
     virtual void initOnceEnlisted() {
         TEST_LOG("called");
     }
@@ -99,6 +115,12 @@ class MockService : public Service {
     /// Return value from maxThreads.
     int threadLimit;
 
+    /// Return value from admitRpc.
+    bool admit;
+
+    /// Return value from getRpcDeadline.
+    uint32_t deadlineMicros;
+
     DISALLOW_COPY_AND_ASSIGN(MockService);
 };
 
@@ -19,6 +19,7 @@
 #include "Common.h"
 #include "Buffer.h"
 #include "Crc32C.h"
+#include "IndexKey.h"
 #include "Key.h"
 
 namespace RAMCloud {
@@ -35,13 +36,14 @@ namespace RAMCloud {
  * Objects are basically a key, some additional metadata, and an associated
  * binary blob of data. When serialized in the log, objects simply consist of
  * a common header, followed immediately by the binary string key, and then the
- * data. The header is of fixed size, while the latter two are variable in
- * length. For example:
+ * data. Objects may also carry secondary keys for indexing (see IndexKey);
+ * these follow the data. The header is of fixed size, while the rest are
+ * variable in length. For example:
  *
- * +-----------------------+---------------------+---------------------------+
- * |     Object Header     |    String Key . . . |          Data . . .       |
- * +-----------------------+---------------------+---------------------------+
- *  sizeof(SerializedForm)     variable length           variable length
+ * +-------------------+------------------+---------------+-----------------+
+ * |   Object Header   | String Key . . . |  Data . . .   | Index Keys . . .|
+ * +-------------------+------------------+---------------+-----------------+
+ *  sizeof(SerializedForm)  variable length  variable length  variable length
  *
  * When creating objects, one will typically gather and compute the necessary
  * fields (tableId, binary string key, version, data associated with the object,
@@ -85,13 +87,15 @@ class Object {
            uint32_t timestamp)
         : serializedForm(key.getTableId(),
                          key.getStringKeyLength(),
+                         key.getHash(),
                          version,
                          timestamp),
           key(key.getStringKey()),
           dataLength(dataLength),
           data(data),
           dataBuffer(),
-          objectBuffer()
+          objectBuffer(),
+          secondaryKeysBuffer()
     {
         serializedForm.checksum = computeChecksum();
     }
@@ -115,21 +119,32 @@ class Object {
      *      The creation time of this object, as returned by the WallTime
      *      module. Used primarily by the cleaner to order live objects and
      *      improve future cleaning performance.
+     * \param secondaryKeys
+     *      If non-NULL, a Buffer holding a well-formed set of secondary keys
+     *      for this object (see IndexKey). The buffer must not be mutated
+     *      after this call.
      */
     Object(Key& key,
            Buffer& dataBuffer,
            uint64_t version,
-           uint32_t timestamp)
+           uint32_t timestamp,
+           Buffer* secondaryKeys = NULL)
         : serializedForm(key.getTableId(),
                          key.getStringKeyLength(),
+                         key.getHash(),
                          version,
-                         timestamp),
+                         timestamp,
+                         secondaryKeys ? downCast<uint16_t>(
+                            secondaryKeys->getTotalLength()) : 0),
           key(key.getStringKey()),
           dataLength(dataBuffer.getTotalLength()),
           data(),
           dataBuffer(&dataBuffer),
-          objectBuffer()
+          objectBuffer(),
+          secondaryKeysBuffer()
     {
+        if (secondaryKeys != NULL)
+            secondaryKeysBuffer.construct(secondaryKeys);
         serializedForm.checksum = computeChecksum();
     }
 
@@ -148,10 +163,12 @@ class Object {
           key(NULL),
           dataLength(buffer.getTotalLength() -
                      sizeof32(serializedForm) -
-                     serializedForm.keyLength),
+                     serializedForm.keyLength -
+                     serializedForm.secondaryKeysLength),
           data(),
           dataBuffer(),
-          objectBuffer(&buffer)
+          objectBuffer(&buffer),
+          secondaryKeysBuffer()
     {
     }
 
@@ -172,17 +189,19 @@ class Object {
           key(reinterpret_cast<const void*>(reinterpret_cast<const uint8_t*>(
               buffer) + sizeof(SerializedForm))),
           dataLength(length - sizeof32(serializedForm) -
-                              serializedForm.keyLength),
+                              serializedForm.keyLength -
+                              serializedForm.secondaryKeysLength),
           data(reinterpret_cast<const void*>(reinterpret_cast<const uint8_t*>(
               key) + serializedForm.keyLength)),
           dataBuffer(),
-          objectBuffer()
+          objectBuffer(),
+          secondaryKeysBuffer()
     {
     }
 
     /**
-     * Append the serialized object header, binary string key, and data blob
-     * to the provided buffer.
+     * Append the serialized object header, binary string key, data blob, and
+     * secondary keys to the provided buffer.
      *
      * \param buffer
      *      The buffer to append a serialized version of this object to.
@@ -193,6 +212,7 @@ class Object {
         buffer.append(&serializedForm, sizeof32(serializedForm));
         appendKeyToBuffer(buffer);
         appendDataToBuffer(buffer);
+        appendSecondaryKeysToBuffer(buffer);
     }
 
     /**
@@ -250,6 +270,44 @@ class Object {
         }
     }
 
+    /**
+     * Append the secondary keys carried by this object (see IndexKey) to a
+     * provided buffer. Nothing is appended if the object has none.
+     *
+     * \param buffer
+     *      The buffer to append the secondary keys to.
+     */
+    void
+    appendSecondaryKeysToBuffer(Buffer& buffer)
+    {
+        uint32_t length = getSecondaryKeysLength();
+        if (length == 0)
+            return;
+
+        if (secondaryKeysBuffer) {
+            for (Buffer::Iterator it(**secondaryKeysBuffer);
+                 !it.isDone(); it.next()) {
+                buffer.append(it.getData(), it.getLength());
+            }
+            return;
+        }
+
+        if (data) {
+            buffer.append(static_cast<const uint8_t*>(*data) + dataLength,
+                          length);
+            return;
+        }
+
+        Buffer::Iterator it(**objectBuffer,
+                            sizeof32(serializedForm) + getKeyLength() +
+                            dataLength,
+                            length);
+        while (!it.isDone()) {
+            buffer.append(it.getData(), it.getLength());
+            it.next();
+        }
+    }
+
     /**
      * Obtain the 64-bit table identifier associated with this object.
      */
@@ -282,6 +340,17 @@ class Object {
         return serializedForm.keyLength;
     }
 
+    /**
+     * Obtain the hash of this object's table identifier and key (see
+     * Key::getHash()). This is stored in the object, so it needn't be
+     * recomputed when the object is read back from the log.
+     */
+    KeyHash
+    getKeyHash()
+    {
+        return serializedForm.keyHash;
+    }
+
     /**
      * Obtain a pointer to a contiguous copy of this object's data blob. Note
      * that if the data is not already contiguous, it will be copied.
@@ -308,6 +377,35 @@ class Object {
         return dataLength;
     }
 
+    /**
+     * Obtain the total length of the secondary keys carried by this object
+     * (see IndexKey), or 0 if it has none.
+     */
+    uint16_t
+    getSecondaryKeysLength()
+    {
+        return serializedForm.secondaryKeysLength;
+    }
+
+    /**
+     * Obtain the key this object carries for a particular secondary index.
+     *
+     * \param indexId
+     *      Identifies the index.
+     * \param[out] key
+     *      If the object carries a key for the index, its encoded bytes are
+     *      returned here.
+     * \return
+     *      True if the object carries a key for the index, otherwise false.
+     */
+    bool
+    getSecondaryKey(uint8_t indexId, string* key)
+    {
+        Buffer keys;
+        appendSecondaryKeysToBuffer(keys);
+        return IndexKey::find(keys, 0, keys.getTotalLength(), indexId, key);
+    }
+
     /**
      * Obtain the 64-bit version number associated with this object.
      */
@@ -339,21 +437,24 @@ class Object {
     }
 
     /**
-     * Given the length of a prospective object's binary string key and data
-     * blob compute the exact byte byte length of such a serialized object.
+     * Given the length of a prospective object's binary string key, data
+     * blob, and secondary keys compute the exact byte length of such a
+     * serialized object.
      */
     static uint32_t
-    getSerializedLength(uint32_t keyLength, uint32_t dataLength)
+    getSerializedLength(uint32_t keyLength, uint32_t dataLength,
+                        uint32_t secondaryKeysLength = 0)
     {
-        return sizeof32(SerializedForm) + keyLength + dataLength;
+        return sizeof32(SerializedForm) + keyLength + dataLength +
+               secondaryKeysLength;
     }
 
 //  PRIVATE:
     /**
      * This data structure defines the format of an object stored in a master
      * server's log. When writing an object, the fields below are written
-     * first, then the binary string key, and finally the object's data are
-     * written sequentially.
+     * first, then the binary string key, the object's data, and finally its
+     * secondary keys are written sequentially.
      */
     class SerializedForm {
       public:
@@ -364,21 +465,29 @@ class Object {
          *      The 64-bit identifier for the table this object is in.
          * \param keyLength
          *      Length of the object's binary string key in bytes.
+         * \param keyHash
+         *      Hash of the table identifier and key (see Key::getHash()).
          * \param version
          *      64-bit version number associated with this object.
          * \param timestamp
          *      The creation time of this object, as returned by the WallTime
          *      module. Used primarily by the cleaner to order live objects and
          *      improve future cleaning performance.
+         * \param secondaryKeysLength
+         *      Total length of the object's secondary keys in bytes.
          */
         SerializedForm(uint64_t tableId,
                        uint16_t keyLength,
+                       KeyHash keyHash,
                        uint64_t version,
-                       uint32_t timestamp)
+                       uint32_t timestamp,
+                       uint16_t secondaryKeysLength = 0)
             : tableId(tableId),
               keyLength(keyLength),
+              keyHash(keyHash),
               version(version),
               timestamp(timestamp),
+              secondaryKeysLength(secondaryKeysLength),
               checksum(0)
         {
         }
@@ -390,6 +499,11 @@ class Object {
         /// Length of the binary string key in bytes.
         uint16_t keyLength;
 
+        /// Hash of the table identifier and key, as computed by
+        /// Key::getHash(). Kept here so that the cleaner, recovery, and
+        /// migration can look objects up without rehashing their keys.
+        KeyHash keyHash;
+
         /// Version of the object. Set to some initial value upon object
         /// creation and incremented by one for each modification. See
         /// MasterService for the exact behavior.
@@ -398,15 +512,19 @@ class Object {
         /// Object creation/modification timestamp. WallTime.cc is the clock.
         uint32_t timestamp;
 
+        /// Length in bytes of the secondary keys that follow the data. 0 if
+        /// the object is not indexed.
+        uint16_t secondaryKeysLength;
+
         /// CRC32C checksum covering everything but this field, including the
-        /// key and the data.
+        /// key, the data, and the secondary keys.
         uint32_t checksum;
 
-        /// Following this class will be the key and the data. This member is
-        /// only here to denote this.
+        /// Following this class will be the key, the data, and the secondary
+        /// keys. This member is only here to denote this.
         char keyAndData[0];
     } __attribute__((__packed__));
-    static_assert(sizeof(SerializedForm) == 26,
+    static_assert(sizeof(SerializedForm) == 36,
         "Unexpected serialized Object size");
 
     /**
@@ -437,6 +555,12 @@ class Object {
                 sizeof32(serializedForm) + getKeyLength(), getDataLength());
         }
 
+        if (getSecondaryKeysLength() > 0) {
+            Buffer keys;
+            appendSecondaryKeysToBuffer(keys);
+            crc.update(keys);
+        }
+
         return crc.getResult();
     }
 
@@ -448,7 +572,7 @@ class Object {
      *      Pointer to the beginning of the object.
      * \param totalLength
      *      Total length of the object in bytes, including the header, string
-     *      key, and data.
+     *      key, data, and secondary keys.
      */
     static uint32_t
     computeChecksum(const Object::SerializedForm* object, uint32_t totalLength)
@@ -456,12 +580,144 @@ class Object {
         Crc32C crc;
         crc.update(object,
             downCast<uint32_t>(OFFSET_OF(SerializedForm, checksum)));
-        uint32_t dataLen = totalLength - object->keyLength -
-                           sizeof32(SerializedForm);
-        crc.update(&object->keyAndData[0], object->keyLength + dataLen);
+        crc.update(&object->keyAndData[0],
+                   totalLength - sizeof32(SerializedForm));
         return crc.getResult();
     }
 
+    /// Upper bound on the number of bytes #compactHeader writes.
+    static const uint32_t MAX_COMPACT_HEADER_LENGTH = 42;
+
+    /**
+     * Encode an object header in the compact form that segments may store in
+     * place of the SerializedForm (see Segment::setCompactObjects). The table
+     * identifier, key length, version, and secondary keys length are written
+     * as variable-length integers holding seven bits per byte, so the small
+     * values most objects have take one to three bytes rather than eight.
+     * The timestamp, key hash, and checksum are copied as they are, so the
+     * expanded header is identical to the original one.
+     *
+     * \param header
+     *      The header to encode.
+     * \param[out] out
+     *      At least MAX_COMPACT_HEADER_LENGTH bytes to write the compact
+     *      header to.
+     * \return
+     *      The length of the compact header, or 0 if it would not be any
+     *      smaller than the SerializedForm (in which case the object should
+     *      be stored as it is).
+     */
+    static uint32_t
+    compactHeader(const SerializedForm& header, uint8_t* out)
+    {
+        uint32_t timestamp = header.timestamp;
+        KeyHash keyHash = header.keyHash;
+        uint32_t checksum = header.checksum;
+
+        uint8_t* p = out;
+        p = writeVarint(p, header.tableId);
+        p = writeVarint(p, header.keyLength);
+        p = writeVarint(p, header.version);
+        p = writeVarint(p, header.secondaryKeysLength);
+        memcpy(p, &timestamp, sizeof(timestamp));
+        p += sizeof(timestamp);
+        memcpy(p, &keyHash, sizeof(keyHash));
+        p += sizeof(keyHash);
+        memcpy(p, &checksum, sizeof(checksum));
+        p += sizeof(checksum);
+
+        uint32_t length = downCast<uint32_t>(p - out);
+        return (length < sizeof32(SerializedForm)) ? length : 0;
+    }
+
+    /**
+     * Decode a header written by #compactHeader.
+     *
+     * \param in
+     *      The compact header, possibly followed by other bytes.
+     * \param length
+     *      Number of bytes that may be read from #in.
+     * \param[out] out
+     *      The expanded header is written here.
+     * \return
+     *      The length of the compact header, or 0 if it is malformed or
+     *      longer than #length.
+     */
+    static uint32_t
+    expandCompactHeader(const void* in, uint32_t length, SerializedForm* out)
+    {
+        const uint8_t* p = static_cast<const uint8_t*>(in);
+        const uint8_t* end = p + length;
+        uint64_t tableId, keyLength, version, secondaryKeysLength;
+        if (!readVarint(&p, end, &tableId) ||
+                !readVarint(&p, end, &keyLength) ||
+                !readVarint(&p, end, &version) ||
+                !readVarint(&p, end, &secondaryKeysLength)) {
+            return 0;
+        }
+
+        uint32_t timestamp, checksum;
+        KeyHash keyHash;
+        if (keyLength > 0xffff || secondaryKeysLength > 0xffff ||
+                end - p < static_cast<ssize_t>(sizeof(timestamp) +
+                                               sizeof(keyHash) +
+                                               sizeof(checksum))) {
+            return 0;
+        }
+        memcpy(&timestamp, p, sizeof(timestamp));
+        p += sizeof(timestamp);
+        memcpy(&keyHash, p, sizeof(keyHash));
+        p += sizeof(keyHash);
+        memcpy(&checksum, p, sizeof(checksum));
+        p += sizeof(checksum);
+
+        out->tableId = tableId;
+        out->keyLength = downCast<uint16_t>(keyLength);
+        out->keyHash = keyHash;
+        out->version = version;
+        out->timestamp = timestamp;
+        out->secondaryKeysLength = downCast<uint16_t>(secondaryKeysLength);
+        out->checksum = checksum;
+        return downCast<uint32_t>(p - static_cast<const uint8_t*>(in));
+    }
+
+    /**
+     * Write a variable-length integer for #compactHeader and return a
+     * pointer to the byte following it.
+     */
+    static uint8_t*
+    writeVarint(uint8_t* out, uint64_t value)
+    {
+        while (value >= 0x80) {
+            *out++ = static_cast<uint8_t>(value | 0x80);
+            value >>= 7;
+        }
+        *out++ = static_cast<uint8_t>(value);
+        return out;
+    }
+
+    /**
+     * Read a variable-length integer written by #writeVarint, advancing
+     * #in past it. Returns false if the integer runs past #end or doesn't
+     * fit in 64 bits.
+     */
+    static bool
+    readVarint(const uint8_t** in, const uint8_t* end, uint64_t* value)
+    {
+        uint64_t result = 0;
+        for (uint32_t shift = 0; shift < 64; shift += 7) {
+            if (*in == end)
+                return false;
+            uint8_t byte = *(*in)++;
+            result |= static_cast<uint64_t>(byte & 0x7f) << shift;
+            if ((byte & 0x80) == 0) {
+                *value = result;
+                return true;
+            }
+        }
+        return false;
+    }
+
     /// Copy of the object header that is in, or will be written to, the log.
     SerializedForm serializedForm;
 
@@ -485,6 +741,10 @@ class Object {
     /// object.
     Tub<Buffer*> objectBuffer;
 
+    /// If an object is created with secondary keys, this will point to the
+    /// buffer holding them.
+    Tub<Buffer*> secondaryKeysBuffer;
+
     DISALLOW_COPY_AND_ASSIGN(Object);
 };
 
@@ -546,6 +806,7 @@ class ObjectTombstone {
     ObjectTombstone(Object& object, uint64_t segmentId, uint32_t timestamp)
         : serializedForm(object.getTableId(),
                          object.getKeyLength(),
+                         object.getKeyHash(),
                          segmentId,
                          object.getVersion(),
                          timestamp),
@@ -644,6 +905,16 @@ class ObjectTombstone {
         return serializedForm.keyLength;
     }
 
+    /**
+     * Obtain the hash of the dead object's table identifier and key (see
+     * Key::getHash()).
+     */
+    KeyHash
+    getKeyHash()
+    {
+        return serializedForm.keyHash;
+    }
+
     uint64_t
     getSegmentId()
     {
@@ -706,6 +977,8 @@ class ObjectTombstone {
          *      The 64-bit identifier for the table the dead object was in.
          * \param keyLength
          *      Length of the object's binary string key in bytes.
+         * \param keyHash
+         *      Hash of the table identifier and key (see Key::getHash()).
          * \param segmentId
          *      64-bit identifier of the log segment the dead object is in.
          * \param objectVersion
@@ -717,11 +990,13 @@ class ObjectTombstone {
          */
         SerializedForm(uint64_t tableId,
                        uint16_t keyLength,
+                       KeyHash keyHash,
                        uint64_t segmentId,
                        uint64_t objectVersion,
                        uint32_t timestamp)
             : tableId(tableId),
               keyLength(keyLength),
+              keyHash(keyHash),
               segmentId(segmentId),
               objectVersion(objectVersion),
               timestamp(timestamp),
@@ -736,6 +1011,10 @@ class ObjectTombstone {
         /// Length of the binary string key in bytes.
         uint16_t keyLength;
 
+        /// Hash of the table identifier and key, as computed by
+        /// Key::getHash().
+        KeyHash keyHash;
+
         /// The log segment that the dead object this tombstone refers to was
         /// in. Once this segment is no longer in the system, this tombstone
         /// is no longer necessary and may be garbage collected.
@@ -756,7 +1035,7 @@ class ObjectTombstone {
         /// denote this.
         char key[0];
     } __attribute__((__packed__));
-    static_assert(sizeof(SerializedForm) == 34,
+    static_assert(sizeof(SerializedForm) == 42,
         "Unexpected serialized ObjectTombstone size");
 
     /**
@@ -50,7 +50,10 @@ class RealTabletMapFetcher : public ObjectFinder::TabletMapFetcher {
  */
 ObjectFinder::ObjectFinder(Context* context)
     : context(context)
+    , mutex("ObjectFinder::mutex")
+    , refreshMutex()
     , tabletMap()
+    , refreshCount(0)
     , tabletMapFetcher(new RealTabletMapFetcher(context))
 {
 }
@@ -109,14 +112,14 @@ ObjectFinder::lookup(uint64_t table, KeyHash keyHash)
  * \param keyHash
  *      A hash value in the space of key hashes.
  * \return
- *      Reference to a tablet with the details of the server that owns
- *      the specified key. This reference may be invalidated by any future
- *      calls to the ObjectFinder.
+ *      A copy of the tablet with the details of the server that owns
+ *      the specified key. (A copy is returned because other threads may
+ *      replace the tablet map at any time.)
  *
  * \throw TableDoesntExistException
  *      The coordinator has no record of the table.
  */
-const ProtoBuf::Tablets::Tablet&
+ProtoBuf::Tablets::Tablet
 ObjectFinder::lookupTablet(uint64_t table, KeyHash keyHash)
 {
     /*
@@ -129,31 +132,64 @@ ObjectFinder::lookupTablet(uint64_t table, KeyHash keyHash)
     */
     bool haveRefreshed = false;
     while (true) {
-        foreach (const ProtoBuf::Tablets::Tablet& tablet, tabletMap.tablet()) {
-            if (tablet.table_id() == table &&
-                tablet.start_key_hash() <= keyHash &&
-                keyHash <= tablet.end_key_hash()) {
-                if (tablet.state() == ProtoBuf::Tablets_Tablet_State_NORMAL) {
-                    // TODO(ongaro): add cache
-                    return tablet;
-                } else {
+        bool recovering = false;
+        uint64_t seenRefreshCount;
+        {
+            std::lock_guard<SpinLock> _(mutex);
+            foreach (const ProtoBuf::Tablets::Tablet& tablet,
+                     tabletMap.tablet()) {
+                if (tablet.table_id() == table &&
+                    tablet.start_key_hash() <= keyHash &&
+                    keyHash <= tablet.end_key_hash()) {
+                    if (tablet.state() ==
+                            ProtoBuf::Tablets_Tablet_State_NORMAL) {
+                        // TODO(ongaro): add cache
+                        return tablet;
+                    }
                     // tablet is recovering or something, try again
-                    if (haveRefreshed)
-                        usleep(10000);
-                    goto refresh_and_retry;
+                    recovering = true;
+                    break;
                 }
             }
+            seenRefreshCount = refreshCount;
         }
-        // tablet not found in local tablet map cache
-        if (haveRefreshed) {
+        if (recovering) {
+            if (haveRefreshed)
+                usleep(10000);
+        } else if (haveRefreshed) {
+            // tablet not found in local tablet map cache
             throw TableDoesntExistException(HERE);
         }
-        refresh_and_retry:
-        tabletMapFetcher->getTabletMap(tabletMap);
+        refresh(seenRefreshCount);
         haveRefreshed = true;
     }
 }
 
+/**
+ * Replace the tablet map cache with a fresh copy from the coordinator.
+ *
+ * \param staleRefreshCount
+ *      The value of #refreshCount when the caller last looked at the map.
+ *      If some other thread has refreshed the map since then, its copy is
+ *      as fresh as the one we would fetch, so this method returns without
+ *      contacting the coordinator.
+ */
+void
+ObjectFinder::refresh(uint64_t staleRefreshCount)
+{
+    std::lock_guard<std::mutex> refreshLock(refreshMutex);
+    {
+        std::lock_guard<SpinLock> _(mutex);
+        if (refreshCount != staleRefreshCount)
+            return;
+    }
+    ProtoBuf::Tablets newTabletMap;
+    tabletMapFetcher->getTabletMap(newTabletMap);
+    std::lock_guard<SpinLock> _(mutex);
+    tabletMap.Swap(&newTabletMap);
+    refreshCount++;
+}
+
 /**
  * Flush the tablet map and refresh it until we detect that at least one tablet
  * has a state set to something other than normal.
@@ -167,13 +203,19 @@ ObjectFinder::waitForTabletDown()
     flush();
 
     for (;;) {
-        foreach (const ProtoBuf::Tablets::Tablet& tablet, tabletMap.tablet()) {
-            if (tablet.state() != ProtoBuf::Tablets_Tablet_State_NORMAL) {
-                return;
+        uint64_t seenRefreshCount;
+        {
+            std::lock_guard<SpinLock> _(mutex);
+            foreach (const ProtoBuf::Tablets::Tablet& tablet,
+                     tabletMap.tablet()) {
+                if (tablet.state() != ProtoBuf::Tablets_Tablet_State_NORMAL) {
+                    return;
+                }
             }
+            seenRefreshCount = refreshCount;
         }
         usleep(200);
-        tabletMapFetcher->getTabletMap(tabletMap);
+        refresh(seenRefreshCount);
     }
 }
 
@@ -191,17 +233,23 @@ ObjectFinder::waitForAllTabletsNormal(uint64_t timeoutNs)
 
     uint64_t start = Cycles::rdtsc();
     while (Cycles::toNanoseconds(Cycles::rdtsc() - start) < timeoutNs) {
-        bool allNormal = true;
-        foreach (const ProtoBuf::Tablets::Tablet& tablet, tabletMap.tablet()) {
-            if (tablet.state() != ProtoBuf::Tablets_Tablet_State_NORMAL) {
-                allNormal = false;
-                break;
+        uint64_t seenRefreshCount;
+        {
+            std::lock_guard<SpinLock> _(mutex);
+            bool allNormal = true;
+            foreach (const ProtoBuf::Tablets::Tablet& tablet,
+                     tabletMap.tablet()) {
+                if (tablet.state() != ProtoBuf::Tablets_Tablet_State_NORMAL) {
+                    allNormal = false;
+                    break;
+                }
             }
+            if (allNormal && tabletMap.tablet_size() > 0)
+                return;
+            seenRefreshCount = refreshCount;
         }
-        if (allNormal && tabletMap.tablet_size() > 0)
-            return;
         usleep(200);
-        tabletMapFetcher->getTabletMap(tabletMap);
+        refresh(seenRefreshCount);
     }
 }
 
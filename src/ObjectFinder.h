@@ -17,10 +17,12 @@
 #define RAMCLOUD_OBJECTFINDER_H
 
 #include <boost/function.hpp>
+#include <mutex>
 
 #include "Common.h"
 #include "CoordinatorClient.h"
 #include "Key.h"
+#include "SpinLock.h"
 #include "Transport.h"
 #include "MasterClient.h"
 
@@ -30,6 +32,8 @@ namespace RAMCloud {
  * This class maps from an object identifier (table and key) to a session
  * that can be used to communicate with the master that stores the object.
  * It retrieves configuration information from the coordinator and caches it.
+ * This class is thread-safe: many threads sharing one RamCloud object share
+ * one copy of the cache.
  */
 class ObjectFinder {
   public:
@@ -40,8 +44,7 @@ class ObjectFinder {
     Transport::SessionRef lookup(uint64_t table, const void* key,
                                  uint16_t keyLength);
     Transport::SessionRef lookup(uint64_t table, KeyHash keyHash);
-    const ProtoBuf::Tablets::Tablet& lookupTablet(uint64_t table,
-                                                  KeyHash keyHash);
+    ProtoBuf::Tablets::Tablet lookupTablet(uint64_t table, KeyHash keyHash);
 
     /**
      * Jettison all tablet map entries forcing a fetch of fresh mappings
@@ -49,6 +52,7 @@ class ObjectFinder {
      */
     void flush() {
         RAMCLOUD_TEST_LOG("flushing object map");
+        std::lock_guard<SpinLock> _(mutex);
         tabletMap.Clear();
     }
 
@@ -56,16 +60,37 @@ class ObjectFinder {
     void waitForAllTabletsNormal(uint64_t timeoutNs = ~0lu);
 
   PRIVATE:
+    void refresh(uint64_t staleRefreshCount);
+
     /**
      * Shared RAMCloud information.
      */
     Context* context;
 
+    /**
+     * Protects #tabletMap and #refreshCount. Only held long enough to scan
+     * or swap the map, never while talking to the coordinator.
+     */
+    SpinLock mutex;
+
+    /**
+     * Held while fetching a new tablet map from the coordinator, so that
+     * when many threads miss in the cache at once only one of them fetches
+     * it (see refresh()).
+     */
+    std::mutex refreshMutex;
+
     /**
      * A cache of the coordinator's tablet map.
      */
     ProtoBuf::Tablets tabletMap;
 
+    /**
+     * Number of times #tabletMap has been replaced with a fresh copy from
+     * the coordinator.
+     */
+    uint64_t refreshCount;
+
     /**
      * Update the local tablet map cache. Usually, calling
      * tabletMapFetcher.getTabletMap() is the same as calling
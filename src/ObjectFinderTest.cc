@@ -119,4 +119,19 @@ TEST_F(ObjectFinderTest, lookup_hash) {
                 getServiceLocator());
 }
 
+TEST_F(ObjectFinderTest, refresh) {
+    objectFinder->refresh(0);
+    EXPECT_EQ(1U, refresher->called);
+    EXPECT_EQ(1U, objectFinder->refreshCount);
+    EXPECT_EQ(3, objectFinder->tabletMap.tablet_size());
+
+    // Another thread refreshed the map since the caller looked at it.
+    objectFinder->refresh(0);
+    EXPECT_EQ(1U, refresher->called);
+
+    objectFinder->refresh(1);
+    EXPECT_EQ(2U, refresher->called);
+    EXPECT_EQ(2U, objectFinder->refreshCount);
+}
+
 }  // namespace RAMCloud
@@ -0,0 +1,114 @@
+/* Copyright (c) 2013 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/**
+ * \file
+ * Compares segments that store objects with full headers against segments
+ * that store them with compact headers (see Segment::setCompactObjects):
+ * how many bytes each object takes up, how fast objects can be appended,
+ * and how fast they can be iterated over and checksummed (as the cleaner
+ * and recovery do).
+ */
+
+#include "Cycles.h"
+#include "Object.h"
+#include "Segment.h"
+#include "SegmentIterator.h"
+
+namespace RAMCloud {
+
+class ObjectHeaderBenchmark {
+  public:
+    ObjectHeaderBenchmark(uint32_t dataBytes, bool compact)
+        : dataBytes(dataBytes)
+        , compact(compact)
+    {
+    }
+
+    void
+    run()
+    {
+        Segment segment;
+        segment.setCompactObjects(compact);
+
+        char objectData[dataBytes];
+        memset(objectData, 'x', dataBytes);
+        uint32_t numObjects = 0;
+        uint64_t appendTicks = 0;
+        while (true) {
+            uint64_t keyVal = numObjects;
+            Key key(numObjects % 16, &keyVal, sizeof(keyVal));
+            Object object(key, objectData, dataBytes, numObjects + 1,
+                          1384000000);
+            Buffer buffer;
+            object.serializeToBuffer(buffer);
+
+            uint64_t before = Cycles::rdtsc();
+            bool appended = segment.append(LOG_ENTRY_TYPE_OBJ, buffer);
+            appendTicks += Cycles::rdtsc() - before;
+            if (!appended)
+                break;
+            numObjects++;
+        }
+
+        uint64_t before = Cycles::rdtsc();
+        SegmentIterator it(segment);
+        uint32_t corrupt = 0;
+        while (!it.isDone()) {
+            Buffer buffer;
+            it.appendToBuffer(buffer);
+            Object object(buffer);
+            if (!object.checkIntegrity())
+                corrupt++;
+            it.next();
+        }
+        uint64_t iterateTicks = Cycles::rdtsc() - before;
+        if (corrupt != 0) {
+            fprintf(stderr, "%u objects failed their checksums!\n", corrupt);
+            exit(1);
+        }
+
+        printf("%5u-byte values, %-7s headers: %6.1f bytes/object  "
+               "%7u objects/segment  %5.0f ns/append  %5.0f ns/iterate\n",
+               dataBytes, compact ? "compact" : "full",
+               static_cast<double>(segment.getAppendedLength()) / numObjects,
+               numObjects,
+               Cycles::toSeconds(appendTicks) * 1e9 / numObjects,
+               Cycles::toSeconds(iterateTicks) * 1e9 / numObjects);
+    }
+
+    /// Length of each object's value.
+    uint32_t dataBytes;
+
+    /// Whether the segment stores compact headers.
+    bool compact;
+};
+
+}  // namespace RAMCloud
+
+int
+main()
+{
+    uint32_t dataBytes[] = { 30, 100, 1000, 0 };
+
+    printf("Objects have 8-byte keys and are appended until a %u-byte "
+           "segment fills up\n", RAMCloud::Segment::DEFAULT_SEGMENT_SIZE);
+    for (int i = 0; dataBytes[i] != 0; i++) {
+        RAMCloud::ObjectHeaderBenchmark(dataBytes[i], false).run();
+        RAMCloud::ObjectHeaderBenchmark(dataBytes[i], true).run();
+    }
+
+    return 0;
+}
@@ -28,6 +28,8 @@
 #include "Transport.h"
 #include "WallTime.h"
 
+#include <unordered_set>
+
 namespace RAMCloud {
 
 /**
@@ -69,10 +71,12 @@ ObjectManager::ObjectManager(Context* context,
                      allocator, replicaManager, masterTableMetadata)
     , log(context, config, this, &segmentManager, &replicaManager)
     , objectMap(config->master.hashTableBytes / HashTable::bytesPerCacheLine())
+    , indexletManager()
     , anyWrites(false)
     , hashTableBucketLocks()
     , replaySegmentReturnCount(0)
     , tombstoneRemover()
+    , expiryMetrics()
 {
     for (size_t i = 0; i < arrayLength(hashTableBucketLocks); i++)
         hashTableBucketLocks[i].setName("hashTableBucketLock");
@@ -136,6 +140,9 @@ ObjectManager::initOnceEnlisted()
  *      guaranteed to be greater than any previous version of the object. If the
  *      operation failed then the version number returned is the current version
  *      of the object, or VERSION_NONEXISTENT if the object does not exist.
+ * \param secondaryKeys
+ *      If non-NULL, a well-formed set of secondary keys (see IndexKey) that
+ *      the new object will carry and be indexed by.
  * \return
  *      STATUS_OK if the object was written. Otherwise, for example,
  *      STATUS_UKNOWN_TABLE may be returned.
@@ -144,26 +151,10 @@ Status
 ObjectManager::writeObject(Key& key,
                            Buffer& value,
                            RejectRules* rejectRules,
-                           uint64_t* outVersion)
+                           uint64_t* outVersion,
+                           Buffer* secondaryKeys)
 {
-    if (!anyWrites) {
-        // This is the first write; use this as a trigger to update the
-        // cluster configuration information and open a session with each
-        // backup, so it won't slow down recovery benchmarks.  This is a
-        // temporary hack, and needs to be replaced with a more robust
-        // approach to updating cluster configuration information.
-        anyWrites = true;
-
-        // Empty coordinator locator means we're in test mode, so skip this.
-        if (!context->coordinatorSession->getLocation().empty()) {
-            ProtoBuf::ServerList backups;
-            CoordinatorClient::getBackupList(context, &backups);
-            TransportManager& transportManager =
-                *context->transportManager;
-            foreach(auto& backup, backups.server())
-                transportManager.getSession(backup.service_locator().c_str());
-        }
-    }
+    noteWrite();
 
     HashTableBucketLock lock(*this, key);
 
@@ -178,6 +169,7 @@ ObjectManager::writeObject(Key& key,
     Buffer currentBuffer;
     Log::Reference currentReference;
     uint64_t currentVersion = VERSION_NONEXISTENT;
+    bool currentExpired = false;
 
     if (lookup(lock, key, currentType, currentBuffer, 0, &currentReference)) {
         if (currentType == LOG_ENTRY_TYPE_OBJTOMB) {
@@ -185,14 +177,19 @@ ObjectManager::writeObject(Key& key,
         } else {
             Object currentObject(currentBuffer);
             currentVersion = currentObject.getVersion();
+            currentExpired = isExpired(tablet, currentObject);
         }
     }
 
     if (rejectRules != NULL) {
-        Status status = rejectOperation(rejectRules, currentVersion);
+        // An expired object is invisible to clients, but it is still
+        // overwritten below like any other so that versions never repeat.
+        uint64_t visibleVersion = currentExpired ? VERSION_NONEXISTENT :
+                                                   currentVersion;
+        Status status = rejectOperation(rejectRules, visibleVersion);
         if (status != STATUS_OK) {
             if (outVersion != NULL)
-                *outVersion = currentVersion;
+                *outVersion = visibleVersion;
             return status;
         }
     }
@@ -205,7 +202,8 @@ ObjectManager::writeObject(Key& key,
     Object newObject(key,
                      value,
                      newObjectVersion,
-                     WallTime::secondsTimestamp());
+                     WallTime::secondsTimestamp(),
+                     secondaryKeys);
 
     assert(currentVersion == VERSION_NONEXISTENT ||
            newObject.getVersion() > currentVersion);
@@ -243,8 +241,12 @@ ObjectManager::writeObject(Key& key,
     }
 
     replace(lock, key, appends[0].reference);
-    if (tombstone)
+    if (tombstone) {
+        Object object(currentBuffer);
+        indexletManager.removeEntries(object);
         log.free(currentReference);
+    }
+    indexletManager.insertEntries(newObject);
     if (outVersion != NULL)
         *outVersion = newObject.getVersion();
 
@@ -275,6 +277,225 @@ ObjectManager::writeObject(Key& key,
     return STATUS_OK;
 }
 
+/**
+ * Write a batch of objects, as writeObject() would write each of them, but
+ * much more cheaply: the hash table buckets for all of the keys are locked
+ * together, the objects (and tombstones for the objects they replace) are
+ * added to the log in a single append, and table stats are updated once
+ * per table. As with writeObject(), syncChanges() must be called before the
+ * writes are guaranteed to be durable.
+ *
+ * Each write succeeds or fails individually. If the same key appears more
+ * than once, the writes are applied in order.
+ *
+ * \param ops
+ *      The objects to write. The status and version of each are filled in
+ *      on return.
+ * \param numOps
+ *      Number of entries in \a ops.
+ */
+void
+ObjectManager::writeObjects(WriteOp* ops, uint32_t numOps)
+{
+    noteWrite();
+
+    // Writes are applied in batches that fit comfortably in a segment and
+    // don't update any key twice (the second update must see the first).
+    // Each batch may need room for a tombstone for every object.
+    const uint32_t maxBatchBytes = config->segmentSize / 2;
+    std::unordered_set<uint64_t> batchKeyHashes;
+    uint32_t batchStart = 0;
+    uint32_t batchBytes = 0;
+    for (uint32_t i = 0; i < numOps; i++) {
+        uint32_t bytes = ops[i].valueLength +
+                         2 * (ops[i].key->getStringKeyLength() +
+                              sizeof32(Object::SerializedForm) +
+                              sizeof32(ObjectTombstone::SerializedForm));
+        bool duplicate = !batchKeyHashes.insert(ops[i].key->getHash()).second;
+        if (i > batchStart &&
+                (duplicate || batchBytes + bytes > maxBatchBytes)) {
+            writeObjectBatch(&ops[batchStart], i - batchStart);
+            batchStart = i;
+            batchBytes = 0;
+            batchKeyHashes.clear();
+            batchKeyHashes.insert(ops[i].key->getHash());
+        }
+        batchBytes += bytes;
+    }
+    if (batchStart < numOps)
+        writeObjectBatch(&ops[batchStart], numOps - batchStart);
+}
+
+/**
+ * Atomically check, write, and remove a set of objects owned by this
+ * master. The reject rules of every object are checked with all of their
+ * hash table buckets locked; if none of them rejects its object's current
+ * version, all of the new objects and tombstones are added to the log in a
+ * single append, so either all of the updates survive a crash or none do.
+ * As with writeObject(), syncChanges() must be called before the
+ * transaction is guaranteed to be durable.
+ *
+ * \param ops
+ *      The objects in the transaction; each key may appear only once. The
+ *      status and version of each are filled in on return.
+ * \param numOps
+ *      Number of entries in \a ops.
+ * \return
+ *      STATUS_OK if the transaction committed. If the reject rules of any
+ *      object failed, the status of the first to fail is returned and
+ *      nothing is changed. STATUS_UNKNOWN_TABLET means some object's tablet
+ *      isn't owned by this master (that object's status says which), and
+ *      STATUS_REQUEST_FORMAT_ERROR means a key appeared more than once.
+ *      STATUS_RETRY means the log is temporarily out of space.
+ */
+Status
+ObjectManager::commitTransaction(TransactionOp* ops, uint32_t numOps)
+{
+    noteWrite();
+
+    // Writing the same key twice would leave the hash table pointing at
+    // whichever object was replaced last, so don't allow it.
+    std::vector<std::pair<KeyHash, uint32_t>> hashes;
+    hashes.reserve(numOps);
+    for (uint32_t i = 0; i < numOps; i++)
+        hashes.push_back({ops[i].key->getHash(), i});
+    std::sort(hashes.begin(), hashes.end());
+    for (uint32_t i = 1; i < hashes.size(); i++) {
+        if (hashes[i].first == hashes[i - 1].first &&
+                *ops[hashes[i].second].key == *ops[hashes[i - 1].second].key)
+            return STATUS_REQUEST_FORMAT_ERROR;
+    }
+
+    Key* keys[numOps];
+    for (uint32_t i = 0; i < numOps; i++) {
+        keys[i] = ops[i].key;
+        objectMap.prefetchBucket(*keys[i]);
+    }
+    HashTableBucketLock lock(*this, keys, numOps);
+
+    // First pass: find each object's current version and check its reject
+    // rules. Nothing is modified until every object has been checked.
+    std::unique_ptr<Buffer[]> currentBuffers(new Buffer[numOps]);
+    std::unique_ptr<Log::Reference[]> currentReferences(
+        new Log::Reference[numOps]);
+    std::unique_ptr<TabletManager::Tablet[]> tablets(
+        new TabletManager::Tablet[numOps]);
+    bool currentExists[numOps];
+    Status result = STATUS_OK;
+    for (uint32_t i = 0; i < numOps; i++) {
+        TransactionOp& op = ops[i];
+        Key& key = *op.key;
+        currentExists[i] = false;
+        op.status = STATUS_OK;
+        op.version = VERSION_NONEXISTENT;
+
+        if (!tabletManager->getTablet(key, &tablets[i]) ||
+                tablets[i].state != TabletManager::NORMAL) {
+            op.status = STATUS_UNKNOWN_TABLET;
+            return STATUS_UNKNOWN_TABLET;
+        }
+
+        LogEntryType currentType;
+        if (lookup(lock, key, currentType, currentBuffers[i], 0,
+                   &currentReferences[i])) {
+            if (currentType == LOG_ENTRY_TYPE_OBJTOMB) {
+                CleanupParameters params = { this, &lock };
+                removeIfTombstone(currentReferences[i].toInteger(), &params);
+            } else {
+                Object currentObject(currentBuffers[i]);
+                currentExists[i] = true;
+                op.version = currentObject.getVersion();
+                if (isExpired(tablets[i], currentObject))
+                    op.version = VERSION_NONEXISTENT;
+            }
+        }
+
+        if (op.rejectRules != NULL) {
+            op.status = rejectOperation(op.rejectRules, op.version);
+            if (op.status != STATUS_OK && result == STATUS_OK)
+                result = op.status;
+        }
+    }
+    if (result != STATUS_OK)
+        return result;
+
+    // Second pass: build the new objects and the tombstones for the ones
+    // they replace or remove, and append them all at once.
+    // The appends refer to the objects and tombstones rather than copying
+    // them, so both must outlive the call to log.append().
+    std::unique_ptr<Tub<Object>[]> objects(new Tub<Object>[numOps]);
+    std::unique_ptr<Tub<ObjectTombstone>[]> tombstones(
+        new Tub<ObjectTombstone>[numOps]);
+    std::unique_ptr<Log::AppendVector[]> appends(
+        new Log::AppendVector[2 * numOps]);
+    uint32_t numAppends = 0;
+    uint32_t timestamp = WallTime::secondsTimestamp();
+    for (uint32_t i = 0; i < numOps; i++) {
+        TransactionOp& op = ops[i];
+        if (op.type == WireFormat::Transaction::WRITE) {
+            uint64_t newObjectVersion = currentExists[i] ?
+                    Object(currentBuffers[i]).getVersion() + 1 :
+                    segmentManager.allocateVersion();
+            objects[i].construct(*op.key, op.value, op.valueLength,
+                                 newObjectVersion, timestamp);
+            objects[i]->serializeToBuffer(appends[numAppends].buffer);
+            appends[numAppends].type = LOG_ENTRY_TYPE_OBJ;
+            numAppends++;
+        }
+        if (op.type != WireFormat::Transaction::CHECK && currentExists[i]) {
+            Object object(currentBuffers[i]);
+            tombstones[i].construct(object,
+                                    log.getSegmentId(currentReferences[i]),
+                                    timestamp);
+            tombstones[i]->serializeToBuffer(appends[numAppends].buffer);
+            appends[numAppends].type = LOG_ENTRY_TYPE_OBJTOMB;
+            numAppends++;
+        }
+    }
+
+    if (numAppends > 0 && !log.append(appends.get(), numAppends))
+        return STATUS_RETRY;
+
+    // Finally, make the new state visible.
+    uint32_t appendIndex = 0;
+    for (uint32_t i = 0; i < numOps; i++) {
+        TransactionOp& op = ops[i];
+        Key& key = *op.key;
+        if (op.type == WireFormat::Transaction::CHECK)
+            continue;
+
+        uint64_t byteCount = 0;
+        uint64_t recordCount = 0;
+        if (op.type == WireFormat::Transaction::WRITE) {
+            Log::AppendVector& append = appends[appendIndex++];
+            replace(lock, key, append.reference);
+            indexletManager.insertEntries(*objects[i]);
+            op.version = objects[i]->getVersion();
+            byteCount += append.buffer.getTotalLength();
+            recordCount++;
+        }
+        if (currentExists[i]) {
+            Object object(currentBuffers[i]);
+            byteCount += appends[appendIndex++].buffer.getTotalLength();
+            recordCount++;
+            indexletManager.removeEntries(object);
+            log.free(currentReferences[i]);
+            if (op.type == WireFormat::Transaction::REMOVE) {
+                segmentManager.raiseSafeVersion(object.getVersion() + 1);
+                remove(lock, key);
+            }
+        }
+        if (recordCount > 0) {
+            TableStats::increment(masterTableMetadata, tablets[i].tableId,
+                                  byteCount, recordCount);
+        }
+        tabletManager->incrementWriteCount(key);
+    }
+
+    TEST_LOG("%u objects, %u log entries", numOps, numAppends);
+    return STATUS_OK;
+}
+
 /**
  * Read an object previously written to this ObjectManager.
  *
@@ -317,6 +538,14 @@ ObjectManager::readObject(Key& key,
     if (!found || type != LOG_ENTRY_TYPE_OBJ)
         return STATUS_OBJECT_DOESNT_EXIST;
 
+    // Expired objects stay in the log until the cleaner comes across them
+    // (see relocateObject), but clients must not see them in the meantime.
+    Object object(buffer);
+    if (expect_false(isExpired(tablet, object))) {
+        expiryMetrics.expiredReads++;
+        return STATUS_OBJECT_DOESNT_EXIST;
+    }
+
     if (outVersion != NULL)
         *outVersion = version;
 
@@ -326,7 +555,6 @@ ObjectManager::readObject(Key& key,
             return status;
     }
 
-    Object object(buffer);
     object.appendDataToBuffer(*outBuffer);
 
     tabletManager->incrementReadCount(key);
@@ -413,11 +641,135 @@ ObjectManager::removeObject(Key& key,
                           tombstoneBuffer.getTotalLength(),
                           1);
     segmentManager.raiseSafeVersion(object.getVersion() + 1);
+    indexletManager.removeEntries(object);
     log.free(reference);
     remove(lock, key);
     return STATUS_OK;
 }
 
+/**
+ * Look up a range of secondary keys in one of a table's indexes, returning
+ * the objects that carry them in index order. Only objects whose primary key
+ * hashes lie in a given range (normally a tablet owned by this master) are
+ * considered; the caller is responsible for checking that range is owned.
+ *
+ * Index entries that no longer match a live object are discarded here (see
+ * IndexletManager), so fewer than maxResults results may be returned even
+ * when more remain; callers should rely on nextEntry to decide whether to
+ * continue.
+ *
+ * \param tableId
+ *      Table whose index is to be searched.
+ * \param indexId
+ *      Identifies the index within the table.
+ * \param firstKey
+ *      Smallest encoded secondary key to return.
+ * \param firstPrimaryKey
+ *      Entries for firstKey whose primary key sorts before this one are
+ *      skipped; empty to start at the first entry for firstKey.
+ * \param lastKey
+ *      Largest encoded secondary key to return.
+ * \param firstKeyHash
+ *      Smallest primary key hash of objects to consider.
+ * \param lastKeyHash
+ *      Largest primary key hash of objects to consider.
+ * \param maxResults
+ *      Maximum number of results to return.
+ * \param returnObjects
+ *      If true, each result includes the object's value; otherwise only its
+ *      keys and version are returned.
+ * \param maxBytes
+ *      Stop adding results once the results buffer would grow beyond this
+ *      many bytes (at least one result is always returned, if any match).
+ * \param[out] results
+ *      A WireFormat::LookupIndexKeys::Result, followed by the secondary key,
+ *      primary key and (optionally) value is appended here for each result.
+ * \param[out] nextEntry
+ *      If results remain after the ones returned, the index entry to resume
+ *      the lookup from is returned here. Otherwise this is left empty.
+ * \return
+ *      The number of results appended to the buffer.
+ */
+uint32_t
+ObjectManager::lookupIndexKeys(uint64_t tableId,
+                               uint8_t indexId,
+                               const string& firstKey,
+                               const string& firstPrimaryKey,
+                               const string& lastKey,
+                               uint64_t firstKeyHash,
+                               uint64_t lastKeyHash,
+                               uint32_t maxResults,
+                               bool returnObjects,
+                               uint32_t maxBytes,
+                               Buffer* results,
+                               Tub<IndexletManager::Entry>* nextEntry)
+{
+    vector<IndexletManager::Entry> entries;
+    indexletManager.lookup(tableId, indexId, firstKey, firstPrimaryKey,
+                           lastKey, firstKeyHash, lastKeyHash, maxResults,
+                           &entries, nextEntry);
+
+    // Needed only for its expiry policy; if the tablet has gone away, the
+    // default policy of never expiring is as good as any.
+    TabletManager::Tablet tablet;
+    tabletManager->getTablet(tableId, firstKeyHash, &tablet);
+
+    uint32_t numResults = 0;
+    uint32_t startLength = results->getTotalLength();
+    for (vector<IndexletManager::Entry>::iterator it = entries.begin();
+         it != entries.end(); ++it) {
+        Key key(tableId, it->primaryKey.data(),
+                downCast<uint16_t>(it->primaryKey.size()));
+        HashTableBucketLock lock(*this, key);
+
+        LogEntryType type;
+        Buffer buffer;
+        uint64_t version;
+        string currentKey;
+        if (!lookup(lock, key, type, buffer, &version) ||
+                type != LOG_ENTRY_TYPE_OBJ) {
+            indexletManager.removeEntry(tableId, indexId, *it);
+            continue;
+        }
+        Object object(buffer);
+        if (!object.getSecondaryKey(indexId, &currentKey) ||
+                currentKey != it->indexKey) {
+            indexletManager.removeEntry(tableId, indexId, *it);
+            continue;
+        }
+        if (expect_false(isExpired(tablet, object)))
+            continue;
+
+        uint32_t valueLength = returnObjects ? object.getDataLength() : 0;
+        uint32_t resultLength =
+            sizeof32(WireFormat::LookupIndexKeys::Result) +
+            downCast<uint32_t>(it->indexKey.size() + it->primaryKey.size()) +
+            valueLength;
+        if (numResults > 0 && results->getTotalLength() - startLength +
+                resultLength > maxBytes) {
+            nextEntry->construct(*it);
+            break;
+        }
+
+        WireFormat::LookupIndexKeys::Result* result =
+            new(results, APPEND) WireFormat::LookupIndexKeys::Result;
+        result->version = version;
+        result->indexKeyLength = downCast<uint16_t>(it->indexKey.size());
+        result->primaryKeyLength = downCast<uint16_t>(it->primaryKey.size());
+        result->valueLength = valueLength;
+        // The keys live only in #entries, so they must be copied; values
+        // are referenced in place in the log, as in readObject().
+        memcpy(new(results, APPEND) char[it->indexKey.size()],
+               it->indexKey.data(), it->indexKey.size());
+        memcpy(new(results, APPEND) char[it->primaryKey.size()],
+               it->primaryKey.data(), it->primaryKey.size());
+        if (returnObjects)
+            object.appendDataToBuffer(*results);
+        numResults++;
+    }
+    return numResults;
+}
+
 /**
  * Sync any previous writes or removes. This operation is required after any
  * writeObject() or removeObject() invocation if the caller wants to ensure that
@@ -450,12 +802,12 @@ ObjectManager::prefetchHashTableBucket(SegmentIterator* it)
     if (expect_true(it->getType() == LOG_ENTRY_TYPE_OBJ)) {
         const Object::SerializedForm* obj =
             it->getContiguous<Object::SerializedForm>(NULL, 0);
-        Key key(obj->tableId, obj->keyAndData, obj->keyLength);
+        Key key(obj->tableId, obj->keyAndData, obj->keyLength, obj->keyHash);
         objectMap.prefetchBucket(key);
     } else if (it->getType() == LOG_ENTRY_TYPE_OBJTOMB) {
         const ObjectTombstone::SerializedForm* tomb =
             it->getContiguous<ObjectTombstone::SerializedForm>(NULL, 0);
-        Key key(tomb->tableId, tomb->key, tomb->keyLength);
+        Key key(tomb->tableId, tomb->key, tomb->keyLength, tomb->keyHash);
         objectMap.prefetchBucket(key);
     }
 }
@@ -573,7 +925,8 @@ ObjectManager::replaySegment(SideLog* sideLog, SegmentIterator& it)
                 it.getContiguous<Object::SerializedForm>(NULL, 0);
             Key key(recoveryObj->tableId,
                     recoveryObj->keyAndData,
-                    recoveryObj->keyLength);
+                    recoveryObj->keyLength,
+                    recoveryObj->keyHash);
 
             bool checksumIsValid = ({
                 CycleCounter<uint64_t> c(&verifyChecksumTicks);
@@ -638,11 +991,20 @@ ObjectManager::replaySegment(SideLog* sideLog, SegmentIterator& it)
                 // TODO(steve): put tombstones in the HT and have this free them
                 //              as well
                 if (freeCurrentEntry) {
+                    Object currentObject(currentBuffer);
+                    indexletManager.removeEntries(currentObject);
                     liveObjectBytes -= currentBuffer.getTotalLength();
                     sideLog->free(currentReference);
                 } else {
                     liveObjectCount++;
                 }
+
+                // Secondary indexes aren't logged; rebuild them from the
+                // objects as they are recovered.
+                if (expect_false(recoveryObj->secondaryKeysLength != 0)) {
+                    Object object(recoveryObj, it.getLength());
+                    indexletManager.insertEntries(object);
+                }
             } else {
                 objectDiscardCount++;
             }
@@ -702,6 +1064,8 @@ ObjectManager::replaySegment(SideLog* sideLog, SegmentIterator& it)
 
                 // nuke the object, if it existed
                 if (freeCurrentEntry) {
+                    Object currentObject(currentBuffer);
+                    indexletManager.removeEntries(currentObject);
                     liveObjectCount++;
                     liveObjectBytes -= currentBuffer.getTotalLength();
                     sideLog->free(currentReference);
@@ -800,6 +1164,8 @@ ObjectManager::removeIfOrphanedObject(uint64_t reference, void *cookie)
         TEST_LOG("removing orphaned object at ref %lu", reference);
         bool r = objectManager->remove(*params->lock, key);
         assert(r);
+        Object object(buffer);
+        objectManager->indexletManager.removeEntries(object);
         objectManager->log.free(Log::Reference(reference));
     }
 }
@@ -871,6 +1237,53 @@ ObjectManager::getTimestamp(LogEntryType type, Buffer& buffer)
         return 0;
 }
 
+/**
+ * Prefetch the hash table bucket that relocate() will look up for an entry.
+ * The cleaner calls this on a batch of entries before relocating any of them,
+ * so that the cache misses on the buckets overlap.
+ *
+ * \param type
+ *      Type of the entry that will be relocated.
+ * \param buffer
+ *      Buffer pointing to the entry in the log.
+ */
+void
+ObjectManager::prefetch(LogEntryType type, Buffer& buffer)
+{
+    if (expect_true(type == LOG_ENTRY_TYPE_OBJ)) {
+        const Object::SerializedForm* obj =
+            buffer.getStart<Object::SerializedForm>();
+        if (obj == NULL)
+            return;
+        Key key(obj->tableId, obj->keyAndData, obj->keyLength, obj->keyHash);
+        objectMap.prefetchBucket(key);
+    } else if (type == LOG_ENTRY_TYPE_OBJTOMB) {
+        const ObjectTombstone::SerializedForm* tomb =
+            buffer.getStart<ObjectTombstone::SerializedForm>();
+        if (tomb == NULL)
+            return;
+        Key key(tomb->tableId, tomb->key, tomb->keyLength, tomb->keyHash);
+        objectMap.prefetchBucket(key);
+    }
+}
+
+/**
+ * Populate a protocol buffer with counts of objects that were dropped because
+ * they expired or were evicted.
+ *
+ * \param[out] m
+ *      The protocol buffer to fill with metrics.
+ */
+void
+ObjectManager::getMetrics(ProtoBuf::LogMetrics_ExpiryMetrics& m)
+{
+    m.set_total_expired_reads(expiryMetrics.expiredReads);
+    m.set_total_expired_objects(expiryMetrics.expiredObjects);
+    m.set_total_expired_bytes(expiryMetrics.expiredBytes);
+    m.set_total_evicted_objects(expiryMetrics.evictedObjects);
+    m.set_total_evicted_bytes(expiryMetrics.evictedBytes);
+}
+
 /**
  * Relocate and update metadata for an object or tombstone that is being
  * cleaned. The cleaner invokes this method for every entry it comes across
@@ -955,6 +1368,16 @@ ObjectManager::relocateObject(Buffer& oldBuffer,
             continue;
         }
 
+        if (expect_false(tabletManager->anyExpiryPolicies())) {
+            bool expired = false;
+            if (shouldDrop(key, oldBuffer, &expired)) {
+                if (!dropObject(oldBuffer, oldReference, relocator, expired))
+                    return;
+                candidates.remove();
+                break;
+            }
+        }
+
         // Try to relocate this live object. If we fail, just return. The
         // cleaner will allocate more memory and retry.
         if (!relocator.append(LOG_ENTRY_TYPE_OBJ, oldBuffer))
@@ -963,14 +1386,114 @@ ObjectManager::relocateObject(Buffer& oldBuffer,
         return;
     }
 
-    // No reference was found meaning object will be cleaned.  We should update
-    // the stats accordingly.
+    // No reference was found (or the object was dropped above) meaning object
+    // will be cleaned.  We should update the stats accordingly.
     TableStats::decrement(masterTableMetadata,
                           key.getTableId(),
                           oldBuffer.getTotalLength(),
                           1);
 }
 
+/**
+ * Decide whether a live object that the cleaner has come across should be
+ * dropped instead of relocated. This is the case if the object has outlived
+ * its tablet's ttl, or if its tablet is evictable and the master is short of
+ * memory. Since the cleaner favours segments holding old data, evicting the
+ * live objects it encounters approximates evicting the least recently written
+ * ones.
+ *
+ * \param key
+ *      Key of the object.
+ * \param buffer
+ *      Buffer pointing to the object in the log.
+ * \param[out] expired
+ *      Set to true if the object is to be dropped because it expired, rather
+ *      than evicted.
+ * \return
+ *      True if the object should be dropped, otherwise false.
+ */
+bool
+ObjectManager::shouldDrop(Key& key, Buffer& buffer, bool* expired)
+{
+    // Objects in tablets that are not open for business (being recovered,
+    // for example) are left alone.
+    TabletManager::Tablet tablet;
+    if (!tabletManager->getTablet(key, &tablet) ||
+            tablet.state != TabletManager::NORMAL) {
+        return false;
+    }
+
+    // A tombstone takes the object's place (see dropObject), but the cleaner
+    // won't relocate an entry larger than the original. Objects with tiny
+    // values may be smaller than their tombstones, so those are kept.
+    if (sizeof32(ObjectTombstone::SerializedForm) + key.getStringKeyLength() >
+            buffer.getTotalLength()) {
+        return false;
+    }
+
+    Object object(buffer);
+    *expired = isExpired(tablet, object);
+    if (*expired)
+        return true;
+    return tablet.evictable &&
+        allocator.getMemoryUtilization() >= EVICTION_MEMORY_UTILIZATION;
+}
+
+/**
+ * Used by relocateObject() to discard a live object, as though it had been
+ * removed by a client. A tombstone is relocated in place of the object, so
+ * that the object will not come back to life if the master crashes before
+ * the segment holding it is cleaned on backups. Its index entries are also
+ * removed; the caller must remove it from the hash table.
+ *
+ * \param oldBuffer
+ *      Buffer pointing to the object's current location.
+ * \param oldReference
+ *      Reference to the object in the log.
+ * \param relocator
+ *      Relocator used to append the tombstone.
+ * \param expired
+ *      True if the object is being dropped because it expired; false if it
+ *      is being evicted. Determines which metrics are updated.
+ * \return
+ *      True if the object was dropped. False if the tombstone could not be
+ *      appended, in which case the cleaner will allocate more memory and
+ *      call back again.
+ */
+bool
+ObjectManager::dropObject(Buffer& oldBuffer,
+                          Log::Reference oldReference,
+                          LogEntryRelocator& relocator,
+                          bool expired)
+{
+    Object object(oldBuffer);
+    ObjectTombstone tombstone(object,
+                              log.getSegmentId(oldReference),
+                              WallTime::secondsTimestamp());
+    Buffer tombstoneBuffer;
+    tombstone.serializeToBuffer(tombstoneBuffer);
+
+    if (!relocator.append(LOG_ENTRY_TYPE_OBJTOMB, tombstoneBuffer))
+        return false;
+
+    TableStats::increment(masterTableMetadata,
+                          object.getTableId(),
+                          tombstoneBuffer.getTotalLength(),
+                          1);
+    segmentManager.raiseSafeVersion(object.getVersion() + 1);
+    indexletManager.removeEntries(object);
+
+    uint64_t bytes = oldBuffer.getTotalLength();
+    if (expired) {
+        expiryMetrics.expiredObjects++;
+        expiryMetrics.expiredBytes += bytes;
+    } else {
+        expiryMetrics.evictedObjects++;
+        expiryMetrics.evictedBytes += bytes;
+    }
+    return true;
+}
+
 /**
  * Callback used by the Log to determine the modification timestamp of an
  * Object. Timestamps are stored in the Object itself, rather than in the
@@ -1047,6 +1570,210 @@ ObjectManager::getTombstoneTimestamp(Buffer& buffer)
     return tomb.getTimestamp();
 }
 
+/**
+ * Check whether an object has outlived the ttl of its tablet.
+ *
+ * \param tablet
+ *      The tablet the object belongs to.
+ * \param object
+ *      The object to check.
+ * \return
+ *      True if the object has expired, otherwise false.
+ */
+bool
+ObjectManager::isExpired(const TabletManager::Tablet& tablet, Object& object)
+{
+    if (tablet.ttl == 0)
+        return false;
+
+    // Objects replayed from another master may carry timestamps from a
+    // clock that is ahead of ours; treat them as brand new.
+    uint32_t now = WallTime::secondsTimestamp();
+    uint32_t timestamp = object.getTimestamp();
+    return now > timestamp && now - timestamp >= tablet.ttl;
+}
+
+/**
+ * Used by writeObjects() to write a batch of objects with distinct keys
+ * that all fit in one log append. See writeObjects() for details.
+ */
+void
+ObjectManager::writeObjectBatch(WriteOp* ops, uint32_t numOps)
+{
+    // Start bringing the buckets into the cache while waiting for locks.
+    Key* keys[numOps];
+    for (uint32_t i = 0; i < numOps; i++) {
+        keys[i] = ops[i].key;
+        objectMap.prefetchBucket(*keys[i]);
+    }
+    HashTableBucketLock lock(*this, keys, numOps);
+
+    // The appends refer to the objects and tombstones rather than copying
+    // them, so both must outlive the call to log.append().
+    std::unique_ptr<Tub<Object>[]> objects(new Tub<Object>[numOps]);
+    std::unique_ptr<Tub<ObjectTombstone>[]> tombstones(
+        new Tub<ObjectTombstone>[numOps]);
+    std::unique_ptr<Buffer[]> currentBuffers(new Buffer[numOps]);
+    std::unique_ptr<Log::Reference[]> currentReferences(
+        new Log::Reference[numOps]);
+    std::unique_ptr<Log::AppendVector[]> appends(
+        new Log::AppendVector[2 * numOps]);
+    bool hasTombstone[numOps];
+    uint32_t numAppends = 0;
+    uint32_t numObjects = 0;
+    uint32_t timestamp = WallTime::secondsTimestamp();
+
+    // Consecutive writes usually go to the same tablet, so keep the last
+    // one rather than looking it up for each object.
+    TabletManager::Tablet tablet;
+    bool haveTablet = false;
+
+    for (uint32_t i = 0; i < numOps; i++) {
+        WriteOp& op = ops[i];
+        Key& key = *op.key;
+        hasTombstone[i] = false;
+
+        KeyHash keyHash = key.getHash();
+        if (!haveTablet || tablet.tableId != key.getTableId() ||
+                keyHash < tablet.startKeyHash || keyHash > tablet.endKeyHash)
+            haveTablet = tabletManager->getTablet(key, &tablet);
+        if (!haveTablet || tablet.state != TabletManager::NORMAL) {
+            op.status = STATUS_UNKNOWN_TABLET;
+            continue;
+        }
+
+        LogEntryType currentType = LOG_ENTRY_TYPE_INVALID;
+        uint64_t currentVersion = VERSION_NONEXISTENT;
+        bool currentExpired = false;
+        if (lookup(lock, key, currentType, currentBuffers[i], 0,
+                   &currentReferences[i])) {
+            if (currentType == LOG_ENTRY_TYPE_OBJTOMB) {
+                CleanupParameters params = { this, &lock };
+                removeIfTombstone(currentReferences[i].toInteger(), &params);
+            } else {
+                Object currentObject(currentBuffers[i]);
+                currentVersion = currentObject.getVersion();
+                currentExpired = isExpired(tablet, currentObject);
+            }
+        }
+
+        if (op.rejectRules != NULL) {
+            uint64_t visibleVersion = currentExpired ? VERSION_NONEXISTENT :
+                                                       currentVersion;
+            op.status = rejectOperation(op.rejectRules, visibleVersion);
+            if (op.status != STATUS_OK) {
+                op.version = visibleVersion;
+                continue;
+            }
+        }
+
+        uint64_t newObjectVersion = (currentVersion == VERSION_NONEXISTENT) ?
+                segmentManager.allocateVersion() : currentVersion + 1;
+        objects[i].construct(key, op.value, op.valueLength,
+                             newObjectVersion, timestamp);
+        objects[i]->serializeToBuffer(appends[numAppends].buffer);
+        appends[numAppends].type = LOG_ENTRY_TYPE_OBJ;
+        numAppends++;
+        numObjects++;
+
+        // As in writeObject(), the tombstone must go into the same append
+        // as the object that replaces it.
+        if (currentVersion != VERSION_NONEXISTENT &&
+                currentType == LOG_ENTRY_TYPE_OBJ) {
+            Object object(currentBuffers[i]);
+            tombstones[i].construct(object,
+                                    log.getSegmentId(currentReferences[i]),
+                                    timestamp);
+            tombstones[i]->serializeToBuffer(appends[numAppends].buffer);
+            appends[numAppends].type = LOG_ENTRY_TYPE_OBJTOMB;
+            numAppends++;
+            hasTombstone[i] = true;
+        }
+    }
+
+    if (numAppends == 0)
+        return;
+
+    if (!log.append(appends.get(), numAppends)) {
+        // The log is out of space; every write in the batch must be retried.
+        for (uint32_t i = 0; i < numOps; i++) {
+            if (objects[i])
+                ops[i].status = STATUS_RETRY;
+        }
+        return;
+    }
+
+    uint64_t statsTableId = 0;
+    uint64_t statsByteCount = 0;
+    uint64_t statsRecordCount = 0;
+    uint32_t appendIndex = 0;
+    for (uint32_t i = 0; i < numOps; i++) {
+        if (!objects[i])
+            continue;
+        WriteOp& op = ops[i];
+        Key& key = *op.key;
+        uint32_t objectIndex = appendIndex++;
+
+        replace(lock, key, appends[objectIndex].reference);
+        if (hasTombstone[i]) {
+            Object object(currentBuffers[i]);
+            indexletManager.removeEntries(object);
+            log.free(currentReferences[i]);
+        }
+        indexletManager.insertEntries(*objects[i]);
+        op.status = STATUS_OK;
+        op.version = objects[i]->getVersion();
+        tabletManager->incrementWriteCount(key);
+
+        if (statsRecordCount > 0 && statsTableId != key.getTableId()) {
+            TableStats::increment(masterTableMetadata, statsTableId,
+                                  statsByteCount, statsRecordCount);
+            statsByteCount = 0;
+            statsRecordCount = 0;
+        }
+        statsTableId = key.getTableId();
+        statsByteCount += appends[objectIndex].buffer.getTotalLength();
+        statsRecordCount++;
+        if (hasTombstone[i]) {
+            uint32_t tombstoneIndex = appendIndex++;
+            statsByteCount += appends[tombstoneIndex].buffer.getTotalLength();
+            statsRecordCount++;
+        }
+    }
+    if (statsRecordCount > 0) {
+        TableStats::increment(masterTableMetadata, statsTableId,
+                              statsByteCount, statsRecordCount);
+    }
+
+    TEST_LOG("%u objects, %u tombstones", numObjects,
+             numAppends - numObjects);
+}
+
+/**
+ * Invoked at the start of every write. The first write is used as a
+ * trigger to update the cluster configuration information and open a
+ * session with each backup, so it won't slow down recovery benchmarks.
+ * This is a temporary hack, and needs to be replaced with a more robust
+ * approach to updating cluster configuration information.
+ */
+void
+ObjectManager::noteWrite()
+{
+    if (anyWrites)
+        return;
+    anyWrites = true;
+
+    // Empty coordinator locator means we're in test mode, so skip this.
+    if (!context->coordinatorSession->getLocation().empty()) {
+        ProtoBuf::ServerList backups;
+        CoordinatorClient::getBackupList(context, &backups);
+        TransportManager& transportManager =
+            *context->transportManager;
+        foreach(auto& backup, backups.server())
+            transportManager.getSession(backup.service_locator().c_str());
+    }
+}
+
 /**
  * Look up an object in the hash table, then extract the entry from the
  * log. Since tombstones are stored in the hash table during recovery,
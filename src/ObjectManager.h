@@ -18,9 +18,11 @@
 
 #include "Common.h"
 #include "Log.h"
+#include "LogMetrics.pb.h"
 #include "SideLog.h"
 #include "LogEntryHandlers.h"
 #include "HashTable.h"
+#include "IndexletManager.h"
 #include "Object.h"
 #include "SegmentManager.h"
 #include "SegmentIterator.h"
@@ -47,6 +49,63 @@ namespace RAMCloud {
  */
 class ObjectManager : public LogEntryHandlers {
   public:
+    /**
+     * Describes one of the objects to write in a call to writeObjects(), and
+     * returns the outcome of that write.
+     */
+    struct WriteOp {
+        /// Key of the object to write.
+        Key* key;
+
+        /// Contents of the object.
+        const void* value;
+
+        /// Number of bytes in #value.
+        uint32_t valueLength;
+
+        /// If non-NULL, conditions under which this write should be aborted.
+        RejectRules* rejectRules;
+
+        /// Set by writeObjects() to the outcome of the write, as for
+        /// writeObject().
+        Status status;
+
+        /// Set by writeObjects() to the version of the object after the
+        /// write or, if the write was aborted by #rejectRules, the current
+        /// version of the object.
+        uint64_t version;
+    };
+
+    /**
+     * Describes one of the objects in a call to commitTransaction(), and
+     * returns the outcome for that object.
+     */
+    struct TransactionOp {
+        /// What to do with the object.
+        WireFormat::Transaction::OpType type;
+
+        /// Key of the object.
+        Key* key;
+
+        /// New contents of the object (WRITE only).
+        const void* value;
+
+        /// Number of bytes in #value.
+        uint32_t valueLength;
+
+        /// If non-NULL, conditions under which the transaction should be
+        /// aborted.
+        RejectRules* rejectRules;
+
+        /// Set by commitTransaction() to the result of checking
+        /// #rejectRules.
+        Status status;
+
+        /// Set by commitTransaction() to the version of the object after
+        /// the transaction or, if it was aborted, the current version.
+        uint64_t version;
+    };
+
     ObjectManager(Context* context,
                   ServerId* serverId,
                   const ServerConfig* config,
@@ -61,20 +120,37 @@ class ObjectManager : public LogEntryHandlers {
     Status writeObject(Key& key,
                        Buffer& value,
                        RejectRules* rejectRules,
-                       uint64_t* outVersion);
+                       uint64_t* outVersion,
+                       Buffer* secondaryKeys = NULL);
+    void writeObjects(WriteOp* ops, uint32_t numOps);
+    Status commitTransaction(TransactionOp* ops, uint32_t numOps);
     Status removeObject(Key& key,
                         RejectRules* rejectRules,
                         uint64_t* outVersion);
+    uint32_t lookupIndexKeys(uint64_t tableId,
+                             uint8_t indexId,
+                             const string& firstKey,
+                             const string& firstPrimaryKey,
+                             const string& lastKey,
+                             uint64_t firstKeyHash,
+                             uint64_t lastKeyHash,
+                             uint32_t maxResults,
+                             bool returnObjects,
+                             uint32_t maxBytes,
+                             Buffer* results,
+                             Tub<IndexletManager::Entry>* nextEntry);
     void syncChanges();
     void prefetchHashTableBucket(SegmentIterator* it);
     void replaySegment(SideLog* sideLog, SegmentIterator& it);
     void removeOrphanedObjects();
+    void getMetrics(ProtoBuf::LogMetrics_ExpiryMetrics& m);
 
     /**
-     * The following two methods are used by the log cleaner. They aren't
+     * The following methods are used by the log cleaner. They aren't
      * intended to be called from any other modules.
      */
     uint32_t getTimestamp(LogEntryType type, Buffer& buffer);
+    void prefetch(LogEntryType type, Buffer& buffer);
     void relocate(LogEntryType type,
                   Buffer& oldBuffer,
                   Log::Reference oldReference,
@@ -91,6 +167,7 @@ class ObjectManager : public LogEntryHandlers {
     Log* getLog() { return &log; }
     ReplicaManager* getReplicaManager() { return &replicaManager; }
     HashTable* getObjectMap() { return &objectMap; }
+    IndexletManager* getIndexletManager() { return &indexletManager; }
 
   PRIVATE:
     /**
@@ -116,6 +193,7 @@ class ObjectManager : public LogEntryHandlers {
          */
         HashTableBucketLock(ObjectManager& objectManager, Key& key)
             : lock(NULL)
+            , extraLocks()
         {
             uint64_t unused;
             uint64_t bucket = HashTable::findBucketIndex(
@@ -134,13 +212,61 @@ class ObjectManager : public LogEntryHandlers {
          */
         HashTableBucketLock(ObjectManager& objectManager, uint64_t bucket)
             : lock(NULL)
+            , extraLocks()
         {
             takeBucketLock(objectManager, bucket);
         }
 
+        /**
+         * This constructor acquires the locks for the buckets that several
+         * keys map into, so that they can all be modified at once (see
+         * writeObjects()). Locks are taken in index order, so that callers
+         * locking overlapping sets of keys cannot deadlock, and a lock shared
+         * by several keys is only taken once.
+         *
+         * \param objectManager
+         *      The ObjectManager that owns the hash table buckets to lock.
+         * \param keys
+         *      Keys whose corresponding buckets in the hash table will be
+         *      locked.
+         * \param numKeys
+         *      Number of entries in \a keys.
+         */
+        HashTableBucketLock(ObjectManager& objectManager,
+                            Key** keys,
+                            uint32_t numKeys)
+            : lock(NULL)
+            , extraLocks()
+        {
+            uint32_t numLocks = arrayLength(objectManager.hashTableBucketLocks);
+            assert(BitOps::isPowerOfTwo(numLocks));
+            std::vector<uint64_t> lockIndexes;
+            lockIndexes.reserve(numKeys);
+            for (uint32_t i = 0; i < numKeys; i++) {
+                uint64_t unused;
+                uint64_t bucket = HashTable::findBucketIndex(
+                    objectManager.objectMap.getNumBuckets(), *keys[i], &unused);
+                lockIndexes.push_back(bucket & (numLocks - 1));
+            }
+            std::sort(lockIndexes.begin(), lockIndexes.end());
+            lockIndexes.erase(std::unique(lockIndexes.begin(),
+                                          lockIndexes.end()),
+                              lockIndexes.end());
+            extraLocks.reserve(lockIndexes.size());
+            foreach (uint64_t lockIndex, lockIndexes) {
+                SpinLock* bucketLock =
+                    &objectManager.hashTableBucketLocks[lockIndex];
+                bucketLock->lock();
+                extraLocks.push_back(bucketLock);
+            }
+        }
+
         ~HashTableBucketLock()
         {
-            lock->unlock();
+            if (lock != NULL)
+                lock->unlock();
+            foreach (SpinLock* bucketLock, extraLocks)
+                bucketLock->unlock();
         }
 
       PRIVATE:
@@ -168,6 +294,10 @@ class ObjectManager : public LogEntryHandlers {
         /// constructor and will release in the destructor.
         SpinLock* lock;
 
+        /// The spinlocks acquired by the multiple-key constructor, which
+        /// are released in the destructor. Empty otherwise.
+        std::vector<SpinLock*> extraLocks;
+
         DISALLOW_COPY_AND_ASSIGN(HashTableBucketLock);
     };
 
@@ -230,6 +360,8 @@ class ObjectManager : public LogEntryHandlers {
                 uint64_t* outVersion = NULL,
                 Log::Reference* outReference = NULL);
     bool remove(HashTableBucketLock& lock, Key& key);
+    void writeObjectBatch(WriteOp* ops, uint32_t numOps);
+    void noteWrite();
     bool replace(HashTableBucketLock& lock, Key& key, Log::Reference reference);
     static void removeIfOrphanedObject(uint64_t reference, void *cookie);
     static void removeIfTombstone(uint64_t maybeTomb, void *cookie);
@@ -294,6 +426,12 @@ class ObjectManager : public LogEntryHandlers {
      */
     HashTable objectMap;
 
+    /**
+     * Secondary indexes over the objects in #objectMap. Kept up to date as
+     * objects are written, removed, and replayed during recovery.
+     */
+    IndexletManager indexletManager;
+
   PRIVATE:
 
     /**
@@ -329,12 +467,52 @@ class ObjectManager : public LogEntryHandlers {
      */
     Tub<RemoveTombstonePoller> tombstoneRemover;
 
+    /**
+     * The cleaner evicts live objects from evictable tablets only when the
+     * percentage of memory in use is at least this high (the same level at
+     * which it starts cleaning in memory; see LogCleaner).
+     */
+    enum { EVICTION_MEMORY_UTILIZATION = 90 };
+
+    /**
+     * Counts of objects hidden from or dropped by this master because they
+     * expired or were evicted. See getMetrics().
+     */
+    struct ExpiryMetrics {
+        ExpiryMetrics()
+            : expiredReads(0)
+            , expiredObjects(0)
+            , expiredBytes(0)
+            , evictedObjects(0)
+            , evictedBytes(0)
+        {
+        }
+
+        /// Reads that found an object, but an expired one.
+        std::atomic<uint64_t> expiredReads;
+
+        /// Objects (and their total bytes) dropped by the cleaner because
+        /// they had expired.
+        std::atomic<uint64_t> expiredObjects;
+        std::atomic<uint64_t> expiredBytes;
+
+        /// Objects (and their total bytes) evicted by the cleaner because
+        /// memory was short.
+        std::atomic<uint64_t> evictedObjects;
+        std::atomic<uint64_t> evictedBytes;
+    } expiryMetrics;
+
     friend void recoveryCleanup(uint64_t maybeTomb, void *cookie);
     friend void removeObjectIfFromUnknownTablet(uint64_t reference,
                                                 void *cookie);
 
+    bool dropObject(Buffer& oldBuffer,
+                    Log::Reference oldReference,
+                    LogEntryRelocator& relocator,
+                    bool expired);
     uint32_t getObjectTimestamp(Buffer& buffer);
     uint32_t getTombstoneTimestamp(Buffer& buffer);
+    static bool isExpired(const TabletManager::Tablet& tablet, Object& object);
     Status rejectOperation(const RejectRules* rejectRules, uint64_t version)
         __attribute__((warn_unused_result));
     void relocateObject(Buffer& oldBuffer,
@@ -343,6 +521,7 @@ class ObjectManager : public LogEntryHandlers {
     void relocateTombstone(Buffer& oldBuffer,
                            LogEntryRelocator& relocator);
     void removeTombstones();
+    bool shouldDrop(Key& key, Buffer& buffer, bool* expired);
 
     friend class CleanerCompactionBenchmark;
 
@@ -31,6 +31,7 @@
 #include "ShortMacros.h"
 #include "StringUtil.h"
 #include "Tablets.pb.h"
+#include "WallTime.h"
 
 namespace RAMCloud {
 
@@ -233,6 +234,26 @@ class ObjectManagerTest : public ::testing::Test {
         return safeVerScanned;
     }
 
+    /**
+     * Count the tombstones in the log whose checksums don't match their
+     * contents.
+     */
+    int
+    countCorruptTombstones()
+    {
+        int corrupt = 0;
+        for (LogIterator it(objectManager.log); !it.isDone(); it.next()) {
+            if (it.getType() != LOG_ENTRY_TYPE_OBJTOMB)
+                continue;
+            Buffer buffer;
+            it.setBufferTo(buffer);
+            ObjectTombstone tombstone(buffer);
+            if (!tombstone.checkIntegrity())
+                corrupt++;
+        }
+        return corrupt;
+    }
+
     /**
      * Returns a stringafied format of metadata found for a particular table.
      *
@@ -333,24 +354,203 @@ TEST_F(ObjectManagerTest, writeObject) {
     tabletManager.changeState(1, 0, ~0UL, TabletManager::RECOVERING,
                                           TabletManager::NORMAL);
     EXPECT_EQ(STATUS_OK, objectManager.writeObject(key, buffer, 0, 0));
-    EXPECT_EQ("writeObject: object: 32 bytes, version 1", TestLog::get());
-    EXPECT_EQ("found=true tableId=1 byteCount=32 recordCount=1"
+    EXPECT_EQ("writeObject: object: 42 bytes, version 1", TestLog::get());
+    EXPECT_EQ("found=true tableId=1 byteCount=42 recordCount=1"
               , verifyMetadata(1));
 
     // object overwrite (tombstone needed)
     TestLog::reset();
     EXPECT_EQ(STATUS_OK, objectManager.writeObject(key, buffer, 0, 0));
-    EXPECT_EQ("writeObject: object: 32 bytes, version 2 | "
-              "writeObject: tombstone: 35 bytes, version 1", TestLog::get());
-    EXPECT_EQ("found=true tableId=1 byteCount=99 recordCount=3"
+    EXPECT_EQ("writeObject: object: 42 bytes, version 2 | "
+              "writeObject: tombstone: 43 bytes, version 1", TestLog::get());
+    EXPECT_EQ("found=true tableId=1 byteCount=127 recordCount=3"
               , verifyMetadata(1));
 }
 
+static bool
+writeObjectBatchFilter(string s)
+{
+    return s == "writeObjectBatch";
+}
+
+TEST_F(ObjectManagerTest, writeObjects_basics) {
+    tabletManager.addTablet(1, 0, ~0UL, TabletManager::NORMAL);
+    Key key1(1, "1", 1);
+    Key key2(1, "2", 1);
+    Key key3(2, "3", 1);
+    ObjectManager::WriteOp ops[3] = {
+        { &key1, "value", 5, NULL, STATUS_OK, 0 },
+        { &key2, "value", 5, NULL, STATUS_OK, 0 },
+        { &key3, "value", 5, NULL, STATUS_OK, 0 },
+    };
+
+    TestLog::Enable _(writeObjectBatchFilter);
+    objectManager.writeObjects(ops, 3);
+    EXPECT_EQ("writeObjectBatch: 2 objects, 0 tombstones", TestLog::get());
+    EXPECT_EQ(STATUS_OK, ops[0].status);
+    EXPECT_EQ(1U, ops[0].version);
+    EXPECT_EQ(STATUS_OK, ops[1].status);
+    EXPECT_EQ(2U, ops[1].version);
+    EXPECT_EQ(STATUS_UNKNOWN_TABLET, ops[2].status);
+    EXPECT_EQ("found=true tableId=1 byteCount=84 recordCount=2"
+              , verifyMetadata(1));
+
+    Buffer value;
+    EXPECT_EQ(STATUS_OK, objectManager.readObject(key2, &value, 0, 0));
+    EXPECT_EQ("value", TestUtil::toString(&value));
+
+    // Overwrites need tombstones.
+    TestLog::reset();
+    objectManager.writeObjects(ops, 2);
+    EXPECT_EQ("writeObjectBatch: 2 objects, 2 tombstones", TestLog::get());
+    EXPECT_EQ(2U, ops[0].version);
+    EXPECT_EQ(3U, ops[1].version);
+    EXPECT_EQ("found=true tableId=1 byteCount=254 recordCount=6"
+              , verifyMetadata(1));
+    EXPECT_EQ(0, countCorruptTombstones());
+}
+
+TEST_F(ObjectManagerTest, writeObjects_duplicateKeys) {
+    tabletManager.addTablet(1, 0, ~0UL, TabletManager::NORMAL);
+    Key key1(1, "1", 1);
+    Key key2(1, "2", 1);
+    ObjectManager::WriteOp ops[3] = {
+        { &key1, "a", 1, NULL, STATUS_OK, 0 },
+        { &key2, "b", 1, NULL, STATUS_OK, 0 },
+        { &key1, "c", 1, NULL, STATUS_OK, 0 },
+    };
+
+    TestLog::Enable _(writeObjectBatchFilter);
+    objectManager.writeObjects(ops, 3);
+    EXPECT_EQ("writeObjectBatch: 2 objects, 0 tombstones | "
+              "writeObjectBatch: 1 objects, 1 tombstones", TestLog::get());
+    EXPECT_EQ(1U, ops[0].version);
+    EXPECT_EQ(2U, ops[2].version);
+
+    Buffer value;
+    EXPECT_EQ(STATUS_OK, objectManager.readObject(key1, &value, 0, 0));
+    EXPECT_EQ("c", TestUtil::toString(&value));
+}
+
+TEST_F(ObjectManagerTest, writeObjects_rejectRules) {
+    tabletManager.addTablet(1, 0, ~0UL, TabletManager::NORMAL);
+    Key key1(1, "1", 1);
+    Key key2(1, "2", 1);
+    storeObject(key1, "hi", 5);
+    RejectRules rules;
+    memset(&rules, 0, sizeof(rules));
+    rules.exists = 1;
+    ObjectManager::WriteOp ops[2] = {
+        { &key1, "a", 1, &rules, STATUS_OK, 0 },
+        { &key2, "b", 1, &rules, STATUS_OK, 0 },
+    };
+
+    objectManager.writeObjects(ops, 2);
+    EXPECT_EQ(STATUS_OBJECT_EXISTS, ops[0].status);
+    EXPECT_EQ(5U, ops[0].version);
+    EXPECT_EQ(STATUS_OK, ops[1].status);
+
+    Buffer value;
+    EXPECT_EQ(STATUS_OK, objectManager.readObject(key1, &value, 0, 0));
+    EXPECT_EQ("hi", TestUtil::toString(&value));
+}
+
+static bool
+commitTransactionFilter(string s)
+{
+    return s == "commitTransaction";
+}
+
+TEST_F(ObjectManagerTest, commitTransaction) {
+    tabletManager.addTablet(1, 0, ~0UL, TabletManager::NORMAL);
+    Key key1(1, "1", 1);
+    Key key2(1, "2", 1);
+    Key key3(1, "3", 1);
+    storeObject(key1, "one", 5);
+    storeObject(key2, "two", 8);
+    RejectRules rules;
+    memset(&rules, 0, sizeof(rules));
+    rules.givenVersion = 5;
+    rules.versionNeGiven = 1;
+    ObjectManager::TransactionOp ops[3] = {
+        { WireFormat::Transaction::CHECK, &key1, NULL, 0, &rules,
+          STATUS_OK, 0 },
+        { WireFormat::Transaction::REMOVE, &key2, NULL, 0, NULL,
+          STATUS_OK, 0 },
+        { WireFormat::Transaction::WRITE, &key3, "three", 5, NULL,
+          STATUS_OK, 0 },
+    };
+
+    TestLog::Enable _(commitTransactionFilter);
+    EXPECT_EQ(STATUS_OK, objectManager.commitTransaction(ops, 3));
+    EXPECT_EQ("commitTransaction: 3 objects, 2 log entries", TestLog::get());
+    EXPECT_EQ(5U, ops[0].version);
+    EXPECT_EQ(8U, ops[1].version);
+    EXPECT_EQ(STATUS_OK, ops[2].status);
+
+    Buffer value;
+    EXPECT_EQ(STATUS_OBJECT_DOESNT_EXIST,
+              objectManager.readObject(key2, &value, 0, 0));
+    EXPECT_EQ(STATUS_OK, objectManager.readObject(key3, &value, 0, 0));
+    EXPECT_EQ("three", TestUtil::toString(&value));
+    EXPECT_EQ(0, countCorruptTombstones());
+}
+
+TEST_F(ObjectManagerTest, commitTransaction_aborted) {
+    tabletManager.addTablet(1, 0, ~0UL, TabletManager::NORMAL);
+    Key key1(1, "1", 1);
+    Key key2(1, "2", 1);
+    storeObject(key1, "one", 5);
+    RejectRules rules;
+    memset(&rules, 0, sizeof(rules));
+    rules.givenVersion = 4;
+    rules.versionNeGiven = 1;
+    ObjectManager::TransactionOp ops[2] = {
+        { WireFormat::Transaction::WRITE, &key2, "two", 3, NULL,
+          STATUS_OK, 0 },
+        { WireFormat::Transaction::WRITE, &key1, "uno", 3, &rules,
+          STATUS_OK, 0 },
+    };
+
+    EXPECT_EQ(STATUS_WRONG_VERSION, objectManager.commitTransaction(ops, 2));
+    EXPECT_EQ(STATUS_OK, ops[0].status);
+    EXPECT_EQ(STATUS_WRONG_VERSION, ops[1].status);
+    EXPECT_EQ(5U, ops[1].version);
+
+    Buffer value;
+    EXPECT_EQ(STATUS_OBJECT_DOESNT_EXIST,
+              objectManager.readObject(key2, &value, 0, 0));
+    EXPECT_EQ(STATUS_OK, objectManager.readObject(key1, &value, 0, 0));
+    EXPECT_EQ("one", TestUtil::toString(&value));
+}
+
+TEST_F(ObjectManagerTest, commitTransaction_badRequests) {
+    tabletManager.addTablet(1, 0, ~0UL, TabletManager::NORMAL);
+    Key key1(1, "1", 1);
+    Key key2(2, "2", 1);
+    ObjectManager::TransactionOp ops[2] = {
+        { WireFormat::Transaction::WRITE, &key1, "one", 3, NULL,
+          STATUS_OK, 0 },
+        { WireFormat::Transaction::WRITE, &key2, "two", 3, NULL,
+          STATUS_OK, 0 },
+    };
+    EXPECT_EQ(STATUS_UNKNOWN_TABLET, objectManager.commitTransaction(ops, 2));
+    EXPECT_EQ(STATUS_UNKNOWN_TABLET, ops[1].status);
+
+    ops[1].key = &key1;
+    EXPECT_EQ(STATUS_REQUEST_FORMAT_ERROR,
+              objectManager.commitTransaction(ops, 2));
+
+    Buffer value;
+    EXPECT_EQ(STATUS_OBJECT_DOESNT_EXIST,
+              objectManager.readObject(key1, &value, 0, 0));
+}
+
 TEST_F(ObjectManagerTest, readObject) {
     Buffer buffer;
     Key key(1, "1", 1);
     storeObject(key, "hi", 93);
-    EXPECT_EQ("found=true tableId=1 byteCount=29 recordCount=1"
+    EXPECT_EQ("found=true tableId=1 byteCount=39 recordCount=1"
               , verifyMetadata(1));
 
     // no tablet, no dice
@@ -395,21 +595,67 @@ TEST_F(ObjectManagerTest, readObject) {
         tabletManager.toString());
 }
 
+TEST_F(ObjectManagerTest, readObject_expired) {
+    Buffer buffer;
+    Key key(0, "1", 1);
+    storeObject(key, "hi", 93);
+    tabletManager.setExpiryPolicy(0, key.getHash(), 100, false);
+
+    WallTime::mockWallTimeValue = 99;
+    EXPECT_EQ(STATUS_OK, objectManager.readObject(key, &buffer, 0, 0));
+
+    uint64_t version = 0;
+    WallTime::mockWallTimeValue = 100;
+    EXPECT_EQ(STATUS_OBJECT_DOESNT_EXIST,
+        objectManager.readObject(key, &buffer, 0, &version));
+    EXPECT_EQ(0UL, version);
+    WallTime::mockWallTimeValue = 0;
+
+    ProtoBuf::LogMetrics_ExpiryMetrics m;
+    objectManager.getMetrics(m);
+    EXPECT_EQ(1UL, m.total_expired_reads());
+}
+
+TEST_F(ObjectManagerTest, writeObject_expired) {
+    Key key(0, "1", 1);
+    Buffer value;
+    value.append("hi", 2);
+    uint64_t version;
+    WallTime::mockWallTimeValue = 10;
+    EXPECT_EQ(STATUS_OK,
+        objectManager.writeObject(key, value, NULL, &version));
+    tabletManager.setExpiryPolicy(0, key.getHash(), 100, false);
+
+    // An expired object doesn't exist as far as reject rules are concerned,
+    // but its version is still superseded.
+    RejectRules rules;
+    memset(&rules, 0, sizeof(rules));
+    rules.exists = 1;
+    uint64_t newVersion;
+    EXPECT_EQ(STATUS_OBJECT_EXISTS,
+        objectManager.writeObject(key, value, &rules, &newVersion));
+    WallTime::mockWallTimeValue = 110;
+    EXPECT_EQ(STATUS_OK,
+        objectManager.writeObject(key, value, &rules, &newVersion));
+    EXPECT_EQ(version + 1, newVersion);
+    WallTime::mockWallTimeValue = 0;
+}
+
 TEST_F(ObjectManagerTest, removeObject) {
     Key key(1, "1", 1);
     storeObject(key, "hi", 93);
-    EXPECT_EQ("found=true tableId=1 byteCount=29 recordCount=1"
+    EXPECT_EQ("found=true tableId=1 byteCount=39 recordCount=1"
               , verifyMetadata(1));
 
     // no tablet, no dice
     EXPECT_EQ(STATUS_UNKNOWN_TABLET, objectManager.removeObject(key, 0, 0));
-    EXPECT_EQ("found=true tableId=1 byteCount=29 recordCount=1"
+    EXPECT_EQ("found=true tableId=1 byteCount=39 recordCount=1"
               , verifyMetadata(1));
 
     // non-normal tablet, no dice
     tabletManager.addTablet(1, 0, ~0UL, TabletManager::RECOVERING);
     EXPECT_EQ(STATUS_UNKNOWN_TABLET, objectManager.removeObject(key, 0, 0));
-    EXPECT_EQ("found=true tableId=1 byteCount=29 recordCount=1"
+    EXPECT_EQ("found=true tableId=1 byteCount=39 recordCount=1"
               , verifyMetadata(1));
 
     // (now make the tablet acceptable for handling removes)
@@ -419,15 +665,15 @@ TEST_F(ObjectManagerTest, removeObject) {
     // not found, not an error
     Key key2(1, "2", 1);
     EXPECT_EQ(STATUS_OK, objectManager.removeObject(key2, 0, 0));
-    EXPECT_EQ("found=true tableId=1 byteCount=29 recordCount=1"
+    EXPECT_EQ("found=true tableId=1 byteCount=39 recordCount=1"
               , verifyMetadata(1));
 
     // non-object, not an error
     storeTombstone(key2);
-    EXPECT_EQ("found=true tableId=1 byteCount=64 recordCount=2"
+    EXPECT_EQ("found=true tableId=1 byteCount=82 recordCount=2"
               , verifyMetadata(1));
     EXPECT_EQ(STATUS_OK, objectManager.removeObject(key2, 0, 0));
-    EXPECT_EQ("found=true tableId=1 byteCount=64 recordCount=2"
+    EXPECT_EQ("found=true tableId=1 byteCount=82 recordCount=2"
               , verifyMetadata(1));
 
     // ensure reject rules are applied
@@ -436,17 +682,17 @@ TEST_F(ObjectManagerTest, removeObject) {
     rules.exists = 1;
     EXPECT_EQ(STATUS_OBJECT_EXISTS,
         objectManager.removeObject(key, &rules, 0));
-    EXPECT_EQ("found=true tableId=1 byteCount=64 recordCount=2"
+    EXPECT_EQ("found=true tableId=1 byteCount=82 recordCount=2"
               , verifyMetadata(1));
 
     // let's finally try a case that should work...
     TestLog::Enable _;
     uint64_t version;
     EXPECT_EQ(STATUS_OK, objectManager.removeObject(key, 0, &version));
-    EXPECT_EQ("found=true tableId=1 byteCount=99 recordCount=3"
+    EXPECT_EQ("found=true tableId=1 byteCount=125 recordCount=3"
               , verifyMetadata(1));
     EXPECT_EQ(93UL, version);
-    EXPECT_EQ("free: free on reference 31457334", TestLog::get());
+    EXPECT_EQ("free: free on reference 31457360", TestLog::get());
     Buffer buffer;
     EXPECT_EQ(STATUS_OBJECT_DOESNT_EXIST,
         objectManager.readObject(key, &buffer, 0, 0));
@@ -483,8 +729,8 @@ TEST_F(ObjectManagerTest, removeOrphanedObjects) {
         objectManager.readObject(key, &value, NULL, NULL));
 
     EXPECT_EQ(
-        "removeIfOrphanedObject: removing orphaned object at ref 31457334 | "
-        "free: free on reference 31457334",
+        "removeIfOrphanedObject: removing orphaned object at ref 31457360 | "
+        "free: free on reference 31457360",
         TestLog::get());
 }
 
@@ -523,13 +769,13 @@ TEST_F(ObjectManagerTest, replaySegment) {
     it.construct(&seg[0], len, certificate);
     objectManager.replaySegment(&sl, *it);
     verifyRecoveryObject(key0, "newer guy");
-    EXPECT_EQ("found=true tableId=0 byteCount=40 recordCount=1"
+    EXPECT_EQ("found=true tableId=0 byteCount=50 recordCount=1"
               , verifyMetadata(0));
     len = buildRecoverySegment(seg, segLen, key0, 0, "older guy", &certificate);
     it.construct(&seg[0], len, certificate);
     objectManager.replaySegment(&sl, *it);
     verifyRecoveryObject(key0, "newer guy");
-    EXPECT_EQ("found=true tableId=0 byteCount=40 recordCount=1"
+    EXPECT_EQ("found=true tableId=0 byteCount=50 recordCount=1"
               , verifyMetadata(0));
 
     // Case 1b: Older object already there; replace object.
@@ -538,13 +784,13 @@ TEST_F(ObjectManagerTest, replaySegment) {
     it.construct(&seg[0], len, certificate);
     objectManager.replaySegment(&sl, *it);
     verifyRecoveryObject(key1, "older guy");
-    EXPECT_EQ("found=true tableId=0 byteCount=80 recordCount=2"
+    EXPECT_EQ("found=true tableId=0 byteCount=100 recordCount=2"
               , verifyMetadata(0)); // Object added.
     len = buildRecoverySegment(seg, segLen, key1, 1, "newer guy", &certificate);
     it.construct(&seg[0], len, certificate);
     objectManager.replaySegment(&sl, *it);
     verifyRecoveryObject(key1, "newer guy");
-    EXPECT_EQ("found=true tableId=0 byteCount=120 recordCount=3"
+    EXPECT_EQ("found=true tableId=0 byteCount=150 recordCount=3"
               , verifyMetadata(0));
 
     // Case 2a: Equal/newer tombstone already there; ignore object.
@@ -563,7 +809,7 @@ TEST_F(ObjectManagerTest, replaySegment) {
     len = buildRecoverySegment(seg, segLen, key2, 1, "equal guy", &certificate);
     it.construct(&seg[0], len, certificate);
     objectManager.replaySegment(&sl, *it);
-    EXPECT_EQ("found=true tableId=0 byteCount=120 recordCount=3"
+    EXPECT_EQ("found=true tableId=0 byteCount=150 recordCount=3"
               , verifyMetadata(0));
     len = buildRecoverySegment(seg, segLen, key2, 0, "older guy", &certificate);
     it.construct(&seg[0], len, certificate);
@@ -592,7 +838,7 @@ TEST_F(ObjectManagerTest, replaySegment) {
                                &certificate);
     it.construct(&seg[0], len, certificate);
     objectManager.replaySegment(&sl, *it);
-    EXPECT_EQ("found=true tableId=0 byteCount=160 recordCount=4"
+    EXPECT_EQ("found=true tableId=0 byteCount=200 recordCount=4"
               , verifyMetadata(0));
     verifyRecoveryObject(key3, "newer guy");
     EXPECT_TRUE(lookup(key3, &reference));
@@ -606,7 +852,7 @@ TEST_F(ObjectManagerTest, replaySegment) {
     len = buildRecoverySegment(seg, segLen, key4, 0, "only guy", &certificate);
     it.construct(&seg[0], len, certificate);
     objectManager.replaySegment(&sl, *it);
-    EXPECT_EQ("found=true tableId=0 byteCount=199 recordCount=5"
+    EXPECT_EQ("found=true tableId=0 byteCount=249 recordCount=5"
               , verifyMetadata(0));
     verifyRecoveryObject(key4, "only guy");
 
@@ -630,13 +876,13 @@ TEST_F(ObjectManagerTest, replaySegment) {
     len = buildRecoverySegment(seg, segLen, key5, 1, "newer guy", &certificate);
     it.construct(&seg[0], len, certificate);
     objectManager.replaySegment(&sl, *it);
-    EXPECT_EQ("found=true tableId=0 byteCount=239 recordCount=6"
+    EXPECT_EQ("found=true tableId=0 byteCount=299 recordCount=6"
               , verifyMetadata(0));
     Object o3(key5, NULL, 0, 0, 0);
     ObjectTombstone t3(o3, 0, 0);
     len = buildRecoverySegment(seg, segLen, t3, &certificate);
     objectManager.replaySegment(&sl, *it);
-    EXPECT_EQ("found=true tableId=0 byteCount=239 recordCount=6"
+    EXPECT_EQ("found=true tableId=0 byteCount=299 recordCount=6"
               , verifyMetadata(0));
     verifyRecoveryObject(key5, "newer guy");
 
@@ -645,7 +891,7 @@ TEST_F(ObjectManagerTest, replaySegment) {
     len = buildRecoverySegment(seg, segLen, key6, 0, "equal guy", &certificate);
     it.construct(&seg[0], len, certificate);
     objectManager.replaySegment(&sl, *it);
-    EXPECT_EQ("found=true tableId=0 byteCount=279 recordCount=7"
+    EXPECT_EQ("found=true tableId=0 byteCount=349 recordCount=7"
               , verifyMetadata(0));
     verifyRecoveryObject(key6, "equal guy");
     Object o4(key6, NULL, 0, 0, 0);
@@ -654,7 +900,7 @@ TEST_F(ObjectManagerTest, replaySegment) {
     it.construct(&seg[0], len, certificate);
     objectManager.replaySegment(&sl, *it);
     objectManager.removeTombstones();
-    EXPECT_EQ("found=true tableId=0 byteCount=317 recordCount=8"
+    EXPECT_EQ("found=true tableId=0 byteCount=395 recordCount=8"
               , verifyMetadata(0));
     EXPECT_FALSE(lookup(key6, &reference));
     EXPECT_EQ(STATUS_OBJECT_DOESNT_EXIST, getObjectStatus(0, "key6", 4));
@@ -663,7 +909,7 @@ TEST_F(ObjectManagerTest, replaySegment) {
     len = buildRecoverySegment(seg, segLen, key7, 0, "older guy", &certificate);
     it.construct(&seg[0], len, certificate);
     objectManager.replaySegment(&sl, *it);
-    EXPECT_EQ("found=true tableId=0 byteCount=357 recordCount=9"
+    EXPECT_EQ("found=true tableId=0 byteCount=445 recordCount=9"
               , verifyMetadata(0));
     verifyRecoveryObject(key7, "older guy");
     Object o5(key7, NULL, 0, 1, 0);
@@ -672,7 +918,7 @@ TEST_F(ObjectManagerTest, replaySegment) {
     it.construct(&seg[0], len, certificate);
     objectManager.replaySegment(&sl, *it);
     objectManager.removeTombstones();
-    EXPECT_EQ("found=true tableId=0 byteCount=395 recordCount=10"
+    EXPECT_EQ("found=true tableId=0 byteCount=491 recordCount=10"
               , verifyMetadata(0));
     EXPECT_FALSE(lookup(key7, &reference));
     EXPECT_EQ(STATUS_OBJECT_DOESNT_EXIST, getObjectStatus(0, "key7", 4));
@@ -689,7 +935,7 @@ TEST_F(ObjectManagerTest, replaySegment) {
         ObjectManager::HashTableBucketLock lock(objectManager, key8);
         ret = objectManager.lookup(lock, key8, type, buffer);
     }
-    EXPECT_EQ("found=true tableId=0 byteCount=433 recordCount=11"
+    EXPECT_EQ("found=true tableId=0 byteCount=537 recordCount=11"
               , verifyMetadata(0));
     EXPECT_TRUE(ret);
     EXPECT_EQ(LOG_ENTRY_TYPE_OBJTOMB, type);
@@ -707,7 +953,7 @@ TEST_F(ObjectManagerTest, replaySegment) {
         ObjectManager::HashTableBucketLock lock(objectManager, key8);
         ret = objectManager.lookup(lock, key8, type, buffer);
     }
-    EXPECT_EQ("found=true tableId=0 byteCount=433 recordCount=11"
+    EXPECT_EQ("found=true tableId=0 byteCount=537 recordCount=11"
               , verifyMetadata(0));
     EXPECT_TRUE(ret);
     EXPECT_EQ(t6LogPtr, buffer.getStart<uint8_t>());
@@ -724,7 +970,7 @@ TEST_F(ObjectManagerTest, replaySegment) {
         ObjectManager::HashTableBucketLock lock(objectManager, key9);
         ret = objectManager.lookup(lock, key9, type, buffer);
     }
-    EXPECT_EQ("found=true tableId=0 byteCount=471 recordCount=12"
+    EXPECT_EQ("found=true tableId=0 byteCount=583 recordCount=12"
               , verifyMetadata(0));
     EXPECT_TRUE(ret);
     ObjectTombstone t8InLog(buffer);
@@ -740,7 +986,7 @@ TEST_F(ObjectManagerTest, replaySegment) {
         ObjectManager::HashTableBucketLock lock(objectManager, key9);
         ret = objectManager.lookup(lock, key9, type, buffer);
     }
-    EXPECT_EQ("found=true tableId=0 byteCount=509 recordCount=13"
+    EXPECT_EQ("found=true tableId=0 byteCount=629 recordCount=13"
               , verifyMetadata(0));
     EXPECT_TRUE(ret);
     EXPECT_EQ(LOG_ENTRY_TYPE_OBJTOMB, type);
@@ -760,7 +1006,7 @@ TEST_F(ObjectManagerTest, replaySegment) {
         ObjectManager::HashTableBucketLock lock(objectManager, key10);
         EXPECT_TRUE(objectManager.lookup(lock, key10, type, buffer));
     }
-    EXPECT_EQ("found=true tableId=0 byteCount=548 recordCount=14"
+    EXPECT_EQ("found=true tableId=0 byteCount=676 recordCount=14"
               , verifyMetadata(0));
     EXPECT_EQ(LOG_ENTRY_TYPE_OBJTOMB, type);
     Buffer t10Buffer;
@@ -857,7 +1103,7 @@ TEST_F(ObjectManagerTest, objectRelocationCallback_objectAlive) {
     Buffer value;
     value.append("item0", 5);
     objectManager.writeObject(key, value, NULL, NULL);
-    EXPECT_EQ("found=true tableId=0 byteCount=35 recordCount=1"
+    EXPECT_EQ("found=true tableId=0 byteCount=45 recordCount=1"
               , verifyMetadata(0));
 
     LogEntryType oldType;
@@ -897,7 +1143,7 @@ TEST_F(ObjectManagerTest, objectRelocationCallback_objectAlive) {
     objectManager.relocate(LOG_ENTRY_TYPE_OBJ, oldBuffer,
                            oldReference, relocator);
     EXPECT_TRUE(relocator.didAppend);
-    EXPECT_EQ("found=true tableId=0 byteCount=35 recordCount=1"
+    EXPECT_EQ("found=true tableId=0 byteCount=45 recordCount=1"
               , verifyMetadata(0));
 
     LogEntryType newType2;
@@ -910,11 +1156,11 @@ TEST_F(ObjectManagerTest, objectRelocationCallback_objectAlive) {
     }
     EXPECT_TRUE(relocator.didAppend);
     EXPECT_EQ(newType, newType2);
-    EXPECT_EQ(newReference.toInteger() + 37, newReference2.toInteger());
+    EXPECT_EQ(newReference.toInteger() + 47, newReference2.toInteger());
     EXPECT_NE(oldReference, newReference);
     EXPECT_NE(newBuffer.getStart<uint8_t>(),
               oldBuffer.getStart<uint8_t>());
-    EXPECT_EQ(newBuffer.getStart<uint8_t>() + 37,
+    EXPECT_EQ(newBuffer.getStart<uint8_t>() + 47,
               newBuffer2.getStart<uint8_t>());
 }
 
@@ -924,7 +1170,7 @@ TEST_F(ObjectManagerTest, objectRelocationCallback_objectDeleted) {
     Buffer value;
     value.append("item0", 5);
     objectManager.writeObject(key, value, NULL, NULL);
-    EXPECT_EQ("found=true tableId=0 byteCount=35 recordCount=1"
+    EXPECT_EQ("found=true tableId=0 byteCount=45 recordCount=1"
               , verifyMetadata(0));
 
     LogEntryType type;
@@ -938,7 +1184,7 @@ TEST_F(ObjectManagerTest, objectRelocationCallback_objectDeleted) {
     EXPECT_TRUE(success);
 
     objectManager.removeObject(key, NULL, NULL);
-    EXPECT_EQ("found=true tableId=0 byteCount=73 recordCount=2"
+    EXPECT_EQ("found=true tableId=0 byteCount=91 recordCount=2"
               , verifyMetadata(0));
 
     LogEntryRelocator relocator(
@@ -947,7 +1193,7 @@ TEST_F(ObjectManagerTest, objectRelocationCallback_objectDeleted) {
     EXPECT_FALSE(relocator.didAppend);
     // Only the object was relocated so the stats should only reflect the
     // contents of the tombstone.
-    EXPECT_EQ("found=true tableId=0 byteCount=38 recordCount=1"
+    EXPECT_EQ("found=true tableId=0 byteCount=46 recordCount=1"
               , verifyMetadata(0));
 }
 
@@ -957,7 +1203,7 @@ TEST_F(ObjectManagerTest, objectRelocationCallback_objectModified) {
     Buffer value;
     value.append("item0", 5);
     objectManager.writeObject(key, value, NULL, NULL);
-    EXPECT_EQ("found=true tableId=0 byteCount=35 recordCount=1"
+    EXPECT_EQ("found=true tableId=0 byteCount=45 recordCount=1"
               , verifyMetadata(0));
 
     LogEntryType type;
@@ -971,7 +1217,7 @@ TEST_F(ObjectManagerTest, objectRelocationCallback_objectModified) {
     value.reset();
     value.append("item0-v2", 8);
     objectManager.writeObject(key, value, NULL, NULL);
-    EXPECT_EQ("found=true tableId=0 byteCount=111 recordCount=3"
+    EXPECT_EQ("found=true tableId=0 byteCount=139 recordCount=3"
               , verifyMetadata(0));
 
     Log::Reference dummyReference;
@@ -982,8 +1228,136 @@ TEST_F(ObjectManagerTest, objectRelocationCallback_objectModified) {
     EXPECT_FALSE(relocator.didAppend);
     // Only the object was relocated so the stats should only reflect the
     // contents of the tombstone and the new object.
-    EXPECT_EQ("found=true tableId=0 byteCount=76 recordCount=2"
+    EXPECT_EQ("found=true tableId=0 byteCount=94 recordCount=2"
+              , verifyMetadata(0));
+}
+
+TEST_F(ObjectManagerTest, objectRelocationCallback_objectExpired) {
+    Key key(0, "key0", 4);
+    Buffer value;
+    value.append("a value long enough", 19);
+    WallTime::mockWallTimeValue = 10;
+    objectManager.writeObject(key, value, NULL, NULL);
+    tabletManager.setExpiryPolicy(0, key.getHash(), 100, false);
+    EXPECT_EQ("found=true tableId=0 byteCount=59 recordCount=1"
+              , verifyMetadata(0));
+
+    LogEntryType type;
+    Buffer buffer;
+    Log::Reference reference;
+    {
+        ObjectManager::HashTableBucketLock lock(objectManager, key);
+        objectManager.lookup(lock, key, type, buffer, 0, &reference);
+    }
+
+    // Not expired yet: relocated as usual.
+    {
+        LogEntryRelocator relocator(
+            objectManager.segmentManager.getHeadSegment(), 1000);
+        objectManager.relocate(LOG_ENTRY_TYPE_OBJ, buffer, reference,
+                               relocator);
+        EXPECT_TRUE(relocator.didAppend);
+        ObjectManager::HashTableBucketLock lock(objectManager, key);
+        buffer.reset();
+        EXPECT_TRUE(objectManager.lookup(lock, key, type, buffer, 0,
+                                         &reference));
+        EXPECT_EQ(relocator.getNewReference(), reference);
+    }
+
+    // Expired: a tombstone takes its place.
+    WallTime::mockWallTimeValue = 110;
+    LogEntryRelocator relocator(
+        objectManager.segmentManager.getHeadSegment(), 1000);
+    objectManager.relocate(LOG_ENTRY_TYPE_OBJ, buffer, reference, relocator);
+    WallTime::mockWallTimeValue = 0;
+    EXPECT_TRUE(relocator.didAppend);
+    Buffer tombstoneBuffer;
+    EXPECT_EQ(LOG_ENTRY_TYPE_OBJTOMB, objectManager.log.getEntry(
+        relocator.getNewReference(), tombstoneBuffer));
+    {
+        ObjectManager::HashTableBucketLock lock(objectManager, key);
+        EXPECT_FALSE(objectManager.lookup(lock, key, type, buffer, 0, 0));
+    }
+    EXPECT_EQ("found=true tableId=0 byteCount=46 recordCount=1"
               , verifyMetadata(0));
+
+    ProtoBuf::LogMetrics_ExpiryMetrics m;
+    objectManager.getMetrics(m);
+    EXPECT_EQ(1UL, m.total_expired_objects());
+    EXPECT_EQ(59UL, m.total_expired_bytes());
+    EXPECT_EQ(0UL, m.total_evicted_objects());
+}
+
+TEST_F(ObjectManagerTest, objectRelocationCallback_objectEvicted) {
+    Key key(0, "key0", 4);
+    Buffer value;
+    value.append("a value long enough", 19);
+    objectManager.writeObject(key, value, NULL, NULL);
+    tabletManager.setExpiryPolicy(0, key.getHash(), 0, true);
+
+    LogEntryType type;
+    Buffer buffer;
+    Log::Reference reference;
+    {
+        ObjectManager::HashTableBucketLock lock(objectManager, key);
+        objectManager.lookup(lock, key, type, buffer, 0, &reference);
+    }
+
+    // Plenty of memory: relocated as usual.
+    SegletAllocator::mockMemoryUtilization = 50;
+    {
+        LogEntryRelocator relocator(
+            objectManager.segmentManager.getHeadSegment(), 1000);
+        objectManager.relocate(LOG_ENTRY_TYPE_OBJ, buffer, reference,
+                               relocator);
+        ObjectManager::HashTableBucketLock lock(objectManager, key);
+        buffer.reset();
+        EXPECT_TRUE(objectManager.lookup(lock, key, type, buffer, 0,
+                                         &reference));
+        EXPECT_EQ(relocator.getNewReference(), reference);
+    }
+
+    SegletAllocator::mockMemoryUtilization = 95;
+    LogEntryRelocator relocator(
+        objectManager.segmentManager.getHeadSegment(), 1000);
+    objectManager.relocate(LOG_ENTRY_TYPE_OBJ, buffer, reference, relocator);
+    SegletAllocator::mockMemoryUtilization = 0;
+    {
+        ObjectManager::HashTableBucketLock lock(objectManager, key);
+        EXPECT_FALSE(objectManager.lookup(lock, key, type, buffer, 0, 0));
+    }
+
+    ProtoBuf::LogMetrics_ExpiryMetrics m;
+    objectManager.getMetrics(m);
+    EXPECT_EQ(0UL, m.total_expired_objects());
+    EXPECT_EQ(1UL, m.total_evicted_objects());
+    EXPECT_EQ(59UL, m.total_evicted_bytes());
+}
+
+TEST_F(ObjectManagerTest, objectRelocationCallback_smallObjectNotDropped) {
+    // The tombstone for this object would be bigger than the object.
+    Key key(0, "key0", 4);
+    Buffer value;
+    value.append("item0", 5);
+    objectManager.writeObject(key, value, NULL, NULL);
+    tabletManager.setExpiryPolicy(0, key.getHash(), 0, true);
+
+    LogEntryType type;
+    Buffer buffer;
+    Log::Reference reference;
+    {
+        ObjectManager::HashTableBucketLock lock(objectManager, key);
+        objectManager.lookup(lock, key, type, buffer, 0, &reference);
+    }
+
+    SegletAllocator::mockMemoryUtilization = 95;
+    LogEntryRelocator relocator(
+        objectManager.segmentManager.getHeadSegment(), 1000);
+    objectManager.relocate(LOG_ENTRY_TYPE_OBJ, buffer, reference, relocator);
+    SegletAllocator::mockMemoryUtilization = 0;
+    ObjectManager::HashTableBucketLock lock(objectManager, key);
+    EXPECT_TRUE(objectManager.lookup(lock, key, type, buffer, 0, &reference));
+    EXPECT_EQ(relocator.getNewReference(), reference);
 }
 
 static bool
@@ -999,7 +1373,7 @@ TEST_F(ObjectManagerTest, tombstoneRelocationCallback_basics) {
     Buffer value;
     value.append("item0", 5);
     objectManager.writeObject(key, value, NULL, NULL);
-    EXPECT_EQ("found=true tableId=0 byteCount=35 recordCount=1"
+    EXPECT_EQ("found=true tableId=0 byteCount=45 recordCount=1"
               , verifyMetadata(0));
 
     LogEntryType type;
@@ -1031,7 +1405,7 @@ TEST_F(ObjectManagerTest, tombstoneRelocationCallback_basics) {
                           tombstone.getTableId(),
                           tombstoneBuffer.getTotalLength(),
                           1);
-    EXPECT_EQ("found=true tableId=0 byteCount=73 recordCount=2"
+    EXPECT_EQ("found=true tableId=0 byteCount=91 recordCount=2"
               , verifyMetadata(0));
 
     Log::Reference newTombstoneReference;
@@ -1044,7 +1418,7 @@ TEST_F(ObjectManagerTest, tombstoneRelocationCallback_basics) {
                           tombstone.getTableId(),
                           tombstoneBuffer.getTotalLength(),
                           1);
-    EXPECT_EQ("found=true tableId=0 byteCount=111 recordCount=3"
+    EXPECT_EQ("found=true tableId=0 byteCount=137 recordCount=3"
               , verifyMetadata(0));
 
 
@@ -1062,7 +1436,7 @@ TEST_F(ObjectManagerTest, tombstoneRelocationCallback_basics) {
     EXPECT_TRUE(relocator.didAppend);
     // Relocator should not drop the old tombstone.  The stats should still
     // reflect the existence of the object and both tombstones.
-    EXPECT_EQ("found=true tableId=0 byteCount=111 recordCount=3"
+    EXPECT_EQ("found=true tableId=0 byteCount=137 recordCount=3"
               , verifyMetadata(0));
 
     // Check that tombstoneRelocationCallback() is checking the liveness
@@ -1094,7 +1468,7 @@ TEST_F(ObjectManagerTest, tombstoneRelocationCallback_cleanTombstone) {
                           tombstone.getTableId(),
                           tombstoneBuffer.getTotalLength(),
                           1);
-    EXPECT_EQ("found=true tableId=0 byteCount=38 recordCount=1"
+    EXPECT_EQ("found=true tableId=0 byteCount=46 recordCount=1"
               , verifyMetadata(0));
 
     LogEntryType oldTypeInLog;
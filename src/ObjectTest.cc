@@ -90,7 +90,7 @@ TEST_F(ObjectTest, constructor_fromVoidPointer)
     EXPECT_EQ(3U, object.serializedForm.keyLength);
     EXPECT_EQ(75U, object.serializedForm.version);
     EXPECT_EQ(723U, object.serializedForm.timestamp);
-    EXPECT_EQ(0x618b50b0U, object.serializedForm.checksum);
+    EXPECT_EQ(0x85860f65U, object.serializedForm.checksum);
 
     EXPECT_EQ(0, memcmp("hi", object.key, 3));
     EXPECT_EQ(4U, object.dataLength);
@@ -108,7 +108,7 @@ TEST_F(ObjectTest, constructor_dataFromBuffer)
     EXPECT_EQ(3U, object.serializedForm.keyLength);
     EXPECT_EQ(75U, object.serializedForm.version);
     EXPECT_EQ(723U, object.serializedForm.timestamp);
-    EXPECT_EQ(0x618b50b0U, object.serializedForm.checksum);
+    EXPECT_EQ(0x85860f65U, object.serializedForm.checksum);
 
     EXPECT_EQ(0, memcmp("hi", object.key, 3));
     EXPECT_EQ(4U, object.dataLength);
@@ -126,7 +126,7 @@ TEST_F(ObjectTest, constructor_entirelyFromBuffer)
     EXPECT_EQ(3U, object.serializedForm.keyLength);
     EXPECT_EQ(75U, object.serializedForm.version);
     EXPECT_EQ(723U, object.serializedForm.timestamp);
-    EXPECT_EQ(0x618b50b0U, object.serializedForm.checksum);
+    EXPECT_EQ(0x85860f65U, object.serializedForm.checksum);
 
     EXPECT_EQ(static_cast<const void*>(NULL), object.key);
     EXPECT_EQ(0, memcmp("hi", object.getKey(), 3));
@@ -145,7 +145,7 @@ TEST_F(ObjectTest, constructor_fromContiguousVoidPointer)
     EXPECT_EQ(3U, object.serializedForm.keyLength);
     EXPECT_EQ(75U, object.serializedForm.version);
     EXPECT_EQ(723U, object.serializedForm.timestamp);
-    EXPECT_EQ(0x618b50b0U, object.serializedForm.checksum);
+    EXPECT_EQ(0x85860f65U, object.serializedForm.checksum);
 
     EXPECT_EQ(0, memcmp("hi", object.key, 3));
     EXPECT_EQ(4U, object.dataLength);
@@ -169,7 +169,7 @@ TEST_F(ObjectTest, serializeToBuffer) {
         EXPECT_EQ(3U, header->keyLength);
         EXPECT_EQ(75U, header->version);
         EXPECT_EQ(723U, header->timestamp);
-        EXPECT_EQ(0x618b50b0U, header->checksum);
+        EXPECT_EQ(0x85860f65U, header->checksum);
 
         const void* key = buffer.getRange(sizeof(*header), 3);
         EXPECT_EQ(0, memcmp(key, "hi", 3));
@@ -199,6 +199,49 @@ TEST_F(ObjectTest, appendDataToBuffer) {
     }
 }
 
+TEST_F(ObjectTest, secondaryKeys) {
+    Key key(57, stringKey, sizeof(stringKey));
+    Buffer secondaryKeys;
+    IndexKey::append(secondaryKeys, 1, 99);
+    IndexKey::append(secondaryKeys, 4, "abc", 3);
+
+    Object object(key, _buffer, 75, 723, &secondaryKeys);
+    Buffer serialized;
+    object.serializeToBuffer(serialized);
+    EXPECT_EQ(sizeof(Object::SerializedForm) + 3 + 4 + 4 + 8 + 4 + 3,
+              serialized.getTotalLength());
+    EXPECT_EQ(Object::getSerializedLength(3, 4, 19),
+              serialized.getTotalLength());
+
+    Object fromBuffer(serialized);
+    Object fromContiguous(
+        serialized.getRange(0, serialized.getTotalLength()),
+        serialized.getTotalLength());
+    Object* copies[] = { &object, &fromBuffer, &fromContiguous };
+    for (uint32_t i = 0; i < arrayLength(copies); i++) {
+        EXPECT_EQ(4U, copies[i]->getDataLength());
+        EXPECT_EQ(19U, copies[i]->getSecondaryKeysLength());
+        EXPECT_TRUE(copies[i]->checkIntegrity());
+
+        Buffer keys;
+        copies[i]->appendSecondaryKeysToBuffer(keys);
+        EXPECT_EQ(19U, keys.getTotalLength());
+
+        string indexKey;
+        EXPECT_TRUE(copies[i]->getSecondaryKey(1, &indexKey));
+        EXPECT_EQ(IndexKey::encode(99), indexKey);
+        EXPECT_TRUE(copies[i]->getSecondaryKey(4, &indexKey));
+        EXPECT_EQ("abc", indexKey);
+        EXPECT_FALSE(copies[i]->getSecondaryKey(2, &indexKey));
+    }
+
+    // The secondary keys are covered by the checksum.
+    uint8_t* evil = reinterpret_cast<uint8_t*>(const_cast<void*>(
+        serialized.getRange(serialized.getTotalLength() - 1, 1)));
+    *evil = static_cast<uint8_t>(~*evil);
+    EXPECT_FALSE(fromBuffer.checkIntegrity());
+}
+
 TEST_F(ObjectTest, getTableId) {
     for (uint32_t i = 0; i < arrayLength(objects); i++)
         EXPECT_EQ(57U, objects[i]->getTableId());
@@ -214,6 +257,12 @@ TEST_F(ObjectTest, getKeyLength) {
         EXPECT_EQ(3U, objects[i]->getKeyLength());
 }
 
+TEST_F(ObjectTest, getKeyHash) {
+    KeyHash hash = Key::getHash(57, "hi", 3);
+    for (uint32_t i = 0; i < arrayLength(objects); i++)
+        EXPECT_EQ(hash, objects[i]->getKeyHash());
+}
+
 TEST_F(ObjectTest, getData) {
     for (uint32_t i = 0; i < arrayLength(objects); i++)
         EXPECT_EQ(0, memcmp("YO!", objects[i]->getData(), 4));
@@ -279,6 +328,54 @@ TEST_F(ObjectTest, getSerializedLength) {
               Object::getSerializedLength(1, 2));
     EXPECT_EQ(sizeof(Object::SerializedForm) + 7,
               Object::getSerializedLength(5, 2));
+    EXPECT_EQ(sizeof(Object::SerializedForm) + 19,
+              Object::getSerializedLength(5, 2, 12));
+}
+
+TEST_F(ObjectTest, compactHeader) {
+    Object::SerializedForm header(57, 3, 0x0123456789abcdefUL, 75, 723);
+    header.checksum = 0xdeadbeef;
+    uint8_t compact[Object::MAX_COMPACT_HEADER_LENGTH];
+    // One byte for each of the table, key length, version and secondary
+    // keys length, plus the timestamp, key hash and checksum.
+    EXPECT_EQ(20U, Object::compactHeader(header, compact));
+
+    Object::SerializedForm expanded(0, 0, 0, 0, 0);
+    EXPECT_EQ(20U, Object::expandCompactHeader(compact, 20, &expanded));
+    EXPECT_EQ(0, memcmp(&header, &expanded, sizeof(header)));
+
+    header.version = 300;
+    EXPECT_EQ(21U, Object::compactHeader(header, compact));
+    EXPECT_EQ(21U, Object::expandCompactHeader(compact, 100, &expanded));
+    EXPECT_EQ(300U, expanded.version);
+}
+
+TEST_F(ObjectTest, compactHeader_notSmaller) {
+    Object::SerializedForm header(~0UL, 0xffff, 0, ~0UL, 0, 0xffff);
+    uint8_t compact[Object::MAX_COMPACT_HEADER_LENGTH];
+    EXPECT_EQ(0U, Object::compactHeader(header, compact));
+}
+
+TEST_F(ObjectTest, expandCompactHeader_malformed) {
+    Object::SerializedForm header(57, 3, 0, 75, 723);
+    uint8_t compact[Object::MAX_COMPACT_HEADER_LENGTH];
+    uint32_t length = Object::compactHeader(header, compact);
+    Object::SerializedForm expanded(0, 0, 0, 0, 0);
+
+    // Truncated.
+    EXPECT_EQ(0U, Object::expandCompactHeader(compact, length - 1,
+                                              &expanded));
+
+    // Key length doesn't fit in 16 bits.
+    uint8_t* p = Object::writeVarint(compact, 57);
+    p = Object::writeVarint(p, 0x10000);
+    EXPECT_EQ(0U, Object::expandCompactHeader(compact, sizeof32(compact),
+                                              &expanded));
+
+    // Integer doesn't fit in 64 bits.
+    memset(compact, 0xff, sizeof(compact));
+    EXPECT_EQ(0U, Object::expandCompactHeader(compact, sizeof32(compact),
+                                              &expanded));
 }
 
 /**
@@ -336,7 +433,7 @@ TEST_F(ObjectTombstoneTest, constructor_fromObject) {
     EXPECT_EQ(925U, tombstone.serializedForm.segmentId);
     EXPECT_EQ(58U, tombstone.serializedForm.objectVersion);
     EXPECT_EQ(335U, tombstone.serializedForm.timestamp);
-    EXPECT_EQ(0x837de743U, tombstone.serializedForm.checksum);
+    EXPECT_EQ(0xd82cfb23U, tombstone.serializedForm.checksum);
 
     EXPECT_TRUE(tombstone.key);
     EXPECT_FALSE(tombstone.tombstoneBuffer);
@@ -351,7 +448,7 @@ TEST_F(ObjectTombstoneTest, constructor_fromBuffer) {
     EXPECT_EQ(925U, tombstone.serializedForm.segmentId);
     EXPECT_EQ(58U, tombstone.serializedForm.objectVersion);
     EXPECT_EQ(335U, tombstone.serializedForm.timestamp);
-    EXPECT_EQ(0x837de743U, tombstone.serializedForm.checksum);
+    EXPECT_EQ(0xd82cfb23U, tombstone.serializedForm.checksum);
 
     EXPECT_FALSE(tombstone.key);
     EXPECT_TRUE(tombstone.tombstoneBuffer);
@@ -377,7 +474,7 @@ TEST_F(ObjectTombstoneTest, serializeToBuffer) {
         EXPECT_EQ(925U, header->segmentId);
         EXPECT_EQ(58U, header->objectVersion);
         EXPECT_EQ(335U, header->timestamp);
-        EXPECT_EQ(0x837de743U, header->checksum);
+        EXPECT_EQ(0xd82cfb23U, header->checksum);
 
         const void* key = buffer.getRange(sizeof(*header), 5);
         EXPECT_EQ(0, memcmp(key, "key!", 5));
@@ -409,6 +506,12 @@ TEST_F(ObjectTombstoneTest, getKeyLength) {
         EXPECT_EQ(5U, tombstones[i]->getKeyLength());
 }
 
+TEST_F(ObjectTombstoneTest, getKeyHash) {
+    KeyHash hash = Key::getHash(572, "key!", 5);
+    for (uint32_t i = 0; i < arrayLength(tombstones); i++)
+        EXPECT_EQ(hash, tombstones[i]->getKeyHash());
+}
+
 TEST_F(ObjectTombstoneTest, getSegmentId) {
     for (uint32_t i = 0; i < arrayLength(tombstones); i++)
         EXPECT_EQ(925U, tombstones[i]->getSegmentId());
@@ -39,6 +39,7 @@
 
 #include "Common.h"
 #include "Atomic.h"
+#include "Buffer.h"
 #include "Cycles.h"
 #include "CycleCounter.h"
 #include "Dispatch.h"
@@ -47,9 +48,11 @@
 #include "MurmurHash3.h"
 #include "Object.h"
 #include "ObjectPool.h"
+#include "RawMetrics.h"
 #include "Segment.h"
 #include "SegmentIterator.h"
 #include "SpinLock.h"
+#include "TaskQueue.h"
 #include "ClientException.h"
 #include "PerfHelper.h"
 #include "KeyUtil.h"
@@ -162,6 +165,24 @@ double bMutexNoBlock()
     return Cycles::toSeconds(stop - start)/count;
 }
 
+// Measure the cost of filling a Buffer past its initial allocation and then
+// destroying it. Request and response Buffers on the RPC path do this
+// routinely; each iteration needs two Allocations beyond the initial one
+// (4 KB and 8 KB), which come from the per-thread Allocation cache rather
+// than malloc once the cache is warm.
+double bufferAllocation()
+{
+    int count = 1000000;
+    uint64_t start = Cycles::rdtsc();
+    for (int i = 0; i < count; i++) {
+        Buffer buffer;
+        new(&buffer, APPEND) char[3000];
+        new(&buffer, APPEND) char[3000];
+    }
+    uint64_t stop = Cycles::rdtsc();
+    return Cycles::toSeconds(stop - start)/count;
+}
+
 // Implements the condPingPong test.
 class CondPingPong {
   public:
@@ -262,6 +283,48 @@ double dispatchPoll()
     return Cycles::toSeconds(stop - start)/count;
 }
 
+// Measure the cost of Dispatch::poll when there are 10000 active Timers,
+// each of which restarts itself when it fires (so the number of active
+// timers stays constant).
+class PerfTimer : public Dispatch::Timer {
+  public:
+    PerfTimer(Dispatch* dispatch, uint64_t interval)
+        : Dispatch::Timer(*dispatch), interval(interval)
+    {
+        start(Cycles::rdtsc() + interval);
+    }
+    void handleTimerEvent()
+    {
+        start(owner->currentTime + interval);
+    }
+    uint64_t interval;
+    DISALLOW_COPY_AND_ASSIGN(PerfTimer);
+};
+
+double dispatchPollTimers()
+{
+    int count = 1000000;
+    int numTimers = 10000;
+    Dispatch dispatch(false);
+    std::vector<PerfTimer*> timers;
+    for (int i = 0; i < numTimers; i++) {
+        // Intervals range from 1ms to 2ms, so a few timers fire during
+        // most calls to poll.
+        uint64_t interval = Cycles::fromSeconds(1e-03) +
+                Cycles::fromSeconds(1e-03)*i/numTimers;
+        timers.push_back(new PerfTimer(&dispatch, interval));
+    }
+    uint64_t start = Cycles::rdtsc();
+    for (int i = 0; i < count; i++) {
+        dispatch.poll();
+    }
+    uint64_t stop = Cycles::rdtsc();
+    for (int i = 0; i < numTimers; i++) {
+        delete timers[i];
+    }
+    return Cycles::toSeconds(stop - start)/count;
+}
+
 // Measure the cost of a 32-bit divide. Divides don't take a constant
 // number of cycles. Values were chosen here semi-randomly to depict a
 // fairly expensive scenario. Someone with fancy ALU knowledge could
@@ -575,6 +638,52 @@ double prefetch()
     return Cycles::toSeconds(totalTicks) / count / 16;
 }
 
+// Helper for the counter tests: increment a counter many times, as the
+// worker threads in a server do with RawMetrics.
+template<typename Counter>
+void incrementCounterHelper(Counter* counter, int count)
+{
+    for (int i = 0; i < count; i++)
+        ++*counter;
+}
+
+// Measure the cost of incrementing a counter from 4 threads at once.  The
+// result is the time per increment in each thread.
+template<typename Counter>
+double incrementCounter(Counter* counter)
+{
+    const int threads = 4;
+    const int count = 10000000;
+    std::vector<std::thread*> workers;
+    uint64_t start = Cycles::rdtsc();
+    for (int i = 0; i < threads; i++) {
+        workers.push_back(new std::thread(incrementCounterHelper<Counter>,
+                                          counter, count));
+    }
+    foreach (std::thread* worker, workers) {
+        worker->join();
+        delete worker;
+    }
+    uint64_t stop = Cycles::rdtsc();
+    return Cycles::toSeconds(stop - start)/count;
+}
+
+// Measure the cost of incrementing a counter in RawMetrics from 4 threads;
+// each thread updates its own shard of the counters.
+double rawMetricIncrement()
+{
+    return incrementCounter(&metrics->temp.count0);
+}
+
+// Measure the cost of incrementing a single std::atomic from 4 threads (the
+// way RawMetrics counters used to work); the counter's cache line bounces
+// between the cores.
+double sharedAtomicIncrement()
+{
+    std::atomic<uint64_t> counter(0);
+    return incrementCounter(&counter);
+}
+
 // Measure the cost of reading the fine-grain cycle counter.
 double rdtscTest()
 {
@@ -752,6 +861,70 @@ double spawnThread()
     return Cycles::toSeconds(stop - start)/count;
 }
 
+// Helper for the TaskQueue tests: a task that reschedules itself until it
+// has run a given number of times, then increments a shared counter.
+class PerfTask : public Task {
+  public:
+    PerfTask(TaskQueue& taskQueue, int count, std::atomic<int>* finished)
+        : Task(taskQueue)
+        , remaining(count)
+        , finished(finished)
+    {}
+    void performTask()
+    {
+        if (--remaining > 0)
+            schedule();
+        else
+            (*finished)++;
+    }
+    int remaining;
+    std::atomic<int>* finished;
+    DISALLOW_COPY_AND_ASSIGN(PerfTask);
+};
+
+// Measure the cost of scheduling a Task and executing it with
+// TaskQueue::performTask in a single thread.
+double taskQueueSchedule()
+{
+    int count = 1000000;
+    TaskQueue taskQueue;
+    std::atomic<int> finished(0);
+    PerfTask task(taskQueue, count, &finished);
+    task.schedule();
+    uint64_t start = Cycles::rdtsc();
+    while (taskQueue.performTask()) {
+        /* Empty loop body. */
+    }
+    uint64_t stop = Cycles::rdtsc();
+    return Cycles::toSeconds(stop - start)/count;
+}
+
+// Measure the throughput of a TaskQueue with 4 workers, each running many
+// tasks that repeatedly reschedule themselves.  The result is the time per
+// task execution across all workers.
+double taskQueueWorkers()
+{
+    const int tasks = 64;
+    const int count = 100000;
+    TaskQueue taskQueue;
+    std::atomic<int> finished(0);
+    std::vector<PerfTask*> perfTasks;
+    for (int i = 0; i < tasks; i++) {
+        perfTasks.push_back(new PerfTask(taskQueue, count, &finished));
+        perfTasks.back()->schedule();
+    }
+    uint64_t start = Cycles::rdtsc();
+    taskQueue.startWorkers(4);
+    while (finished < tasks) {
+        /* Empty loop body. */
+    }
+    uint64_t stop = Cycles::rdtsc();
+    taskQueue.stopWorkers();
+    foreach (PerfTask* task, perfTasks)
+        delete task;
+    return Cycles::toSeconds(stop - start)/(tasks * count);
+}
+
 // Measure the cost of starting and stopping a Dispatch::Timer.
 double startStopTimer()
 {
@@ -901,6 +1074,8 @@ TestInfo tests[] = {
      "Atomic<int>::exchange"},
     {"bMutexNoBlock", bMutexNoBlock,
      "std::mutex lock/unlock (no blocking)"},
+    {"bufferAllocation", bufferAllocation,
+     "Fill a Buffer past its initial allocation, then free"},
     {"condPingPong", condPingPong,
      "std::condition_variable round-trip"},
     {"cppAtomicExchg", cppAtomicExchange,
@@ -913,6 +1088,8 @@ TestInfo tests[] = {
      "Convert a rdtsc result to (uint64_t) nanoseconds"},
     {"dispatchPoll", dispatchPoll,
      "Dispatch::poll (no timers or pollers)"},
+    {"dispatchPollTimers", dispatchPollTimers,
+     "Dispatch::poll (10000 timers firing every 1-2ms)"},
     {"div32", div32,
      "32-bit integer division instruction"},
     {"div64", div64,
@@ -941,6 +1118,8 @@ TestInfo tests[] = {
      "Cost of ObjectPool allocation after destroying an object"},
     {"prefetch", prefetch,
      "Prefetch instruction"},
+    {"rawMetricInc", rawMetricIncrement,
+     "Increment a RawMetric in 4 threads at once"},
     {"rdtsc", rdtscTest,
      "Read the fine-grain cycle counter"},
     {"segmentEntrySort", segmentEntrySort,
@@ -951,12 +1130,18 @@ TestInfo tests[] = {
      "Create/delete SessionRef"},
     {"sfence", sfence,
      "Sfence instruction"},
+    {"sharedAtomicInc", sharedAtomicIncrement,
+     "Increment one std::atomic in 4 threads at once"},
     {"spinLock", spinLock,
      "Acquire/release SpinLock"},
     {"startStopTimer", startStopTimer,
      "Start and stop a Dispatch::Timer"},
     {"spawnThread", spawnThread,
      "Start and stop a thread"},
+    {"taskQueueSchedule", taskQueueSchedule,
+     "Schedule and perform a Task in one thread"},
+    {"taskQueueWorkers", taskQueueWorkers,
+     "Perform self-rescheduling Tasks on 4 TaskQueue workers"},
     {"throwInt", throwInt,
      "Throw an int"},
     {"throwIntNL", throwIntNL,
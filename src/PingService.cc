@@ -17,10 +17,13 @@
 #include "Common.h"
 #include "CycleCounter.h"
 #include "Cycles.h"
+#include "LatencyMetrics.h"
+#include "MasterService.h"
 #include "RawMetrics.h"
 #include "ShortMacros.h"
 #include "PingClient.h"
 #include "PingService.h"
+#include "ProtoBuf.h"
 #include "ServerList.h"
 
 namespace RAMCloud {
@@ -162,6 +165,45 @@ PingService::serverControl(const WireFormat::ServerControl::Request* reqHdr,
                 return;
             }
         }
+        case WireFormat::GET_LATENCY_METRICS:
+        {
+            ProtoBuf::LatencyMetrics metrics;
+            LatencyMetrics::serialize(metrics);
+            respHdr->outputLength = ProtoBuf::serializeToResponse(
+                    rpc->replyPayload, &metrics);
+            break;
+        }
+        case WireFormat::RESET_LATENCY_METRICS:
+        {
+            LatencyMetrics::reset();
+            break;
+        }
+        case WireFormat::SET_CLEANER_OPTION:
+        {
+            // The input is the option name followed by its new value, each
+            // terminated by a zero byte.
+            const char* option = (const char*) inputData;
+            uint32_t optionLength = 0;
+            while (optionLength < reqHdr->inputLength &&
+                    option[optionLength] != '\0') {
+                optionLength++;
+            }
+            if (optionLength + 1 >= reqHdr->inputLength ||
+                    option[reqHdr->inputLength - 1] != '\0') {
+                respHdr->common.status = STATUS_REQUEST_FORMAT_ERROR;
+                return;
+            }
+            if (context->masterService == NULL) {
+                respHdr->common.status = STATUS_UNIMPLEMENTED_REQUEST;
+                return;
+            }
+            const char* value = option + optionLength + 1;
+            if (!context->masterService->setCleanerOption(option, value)) {
+                respHdr->common.status = STATUS_OBJECT_DOESNT_EXIST;
+                return;
+            }
+            break;
+        }
         default:
             respHdr->common.status = STATUS_UNIMPLEMENTED_REQUEST;
             return;
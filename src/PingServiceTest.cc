@@ -25,6 +25,8 @@
 #include "ServerList.h"
 #include "CoordinatorClient.h"
 #include "Key.h"
+#include "LatencyMetrics.h"
+#include "ProtoBuf.h"
 #include "Tablets.pb.h"
 #include "Tub.h"
 #include "RamCloud.h"
@@ -175,6 +177,57 @@ TEST_F(PingServiceTest, serverControl_DispatchProfilerExceptions) {
                 , RequestFormatError);
 }
 
+TEST_F(PingServiceTest, serverControl_latencyMetrics) {
+    uint64_t tableId = 3;
+    string locator = serverList.getLocator(serverId);
+    ramcloud->objectFinder.tabletMapFetcher.reset(
+                            new MockTabletMapFetcher(locator, tableId));
+    Buffer output;
+
+    LatencyMetrics::record(LatencyMetrics::QUEUE, WireFormat::READ, 100);
+    ramcloud->serverControl(tableId, "0", 1,
+                            WireFormat::RESET_LATENCY_METRICS,
+                            NULL, 0, &output);
+    LatencyMetrics::record(LatencyMetrics::LOG_SYNC, WireFormat::WRITE, 100);
+    ramcloud->serverControl(tableId, "0", 1,
+                            WireFormat::GET_LATENCY_METRICS,
+                            NULL, 0, &output);
+
+    ProtoBuf::LatencyMetrics metrics;
+    ProtoBuf::parseFromResponse(&output, 0, output.getTotalLength(),
+                                &metrics);
+    EXPECT_TRUE(LatencyMetrics::find(metrics, "READ",
+                                     LatencyMetrics::QUEUE) == NULL);
+    const ProtoBuf::LatencyMetrics_Histogram* h = LatencyMetrics::find(
+            metrics, "WRITE", LatencyMetrics::LOG_SYNC);
+    ASSERT_TRUE(h != NULL);
+    EXPECT_EQ(1U, LatencyMetrics::getCount(*h));
+}
+
+TEST_F(PingServiceTest, serverControl_setCleanerOption) {
+    uint64_t tableId = 4;
+    string locator = serverList.getLocator(serverId);
+    ramcloud->objectFinder.tabletMapFetcher.reset(
+                            new MockTabletMapFetcher(locator, tableId));
+    Buffer output;
+
+    // Name and value must both be present and zero-terminated.
+    EXPECT_THROW(ramcloud->serverControl(tableId, "0", 1,
+                            WireFormat::SET_CLEANER_OPTION,
+                            "pollUsec", 9, &output)
+                , RequestFormatError);
+    EXPECT_THROW(ramcloud->serverControl(tableId, "0", 1,
+                            WireFormat::SET_CLEANER_OPTION,
+                            "pollUsec\0005", 10, &output)
+                , RequestFormatError);
+
+    // No master on this server.
+    EXPECT_THROW(ramcloud->serverControl(tableId, "0", 1,
+                            WireFormat::SET_CLEANER_OPTION,
+                            "pollUsec\0005", 11, &output)
+                , UnimplementedRequestError);
+}
+
 TEST_F(PingServiceTest, ping_basics) {
     TestLog::Enable _;
     PingClient::ping(&context, serverId);
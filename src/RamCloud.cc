@@ -35,14 +35,23 @@ static RejectRules defaultRejectRules;
  * \param serviceLocator
  *      The service locator for the coordinator.
  *      See \ref ServiceLocatorStrings.
+ * \param multiThreaded
+ *      True means the new object may be used concurrently by many threads
+ *      (it runs its own dispatch thread; see the class documentation).
+ *      False means only one thread at a time may use it.
  * \exception CouldntConnectException
  *      Couldn't connect to the server.
  */
-RamCloud::RamCloud(const char* serviceLocator)
+RamCloud::RamCloud(const char* serviceLocator, bool multiThreaded)
     : coordinatorLocator(serviceLocator)
     , realClientContext()
-    , clientContext(realClientContext.construct(false))
+    , dispatchThread()
+    , dispatchReady(false)
+    , dispatchExit(false)
+    , clientContext(multiThreaded ? startDispatchThread()
+                                  : realClientContext.construct(false))
     , status(STATUS_OK)
+    , readDeadlineMicros(0)
     , objectFinder(clientContext)
 {
     clientContext->coordinatorSession->setLocation(serviceLocator);
@@ -56,8 +65,12 @@ RamCloud::RamCloud(const char* serviceLocator)
 RamCloud::RamCloud(Context* context, const char* serviceLocator)
     : coordinatorLocator(serviceLocator)
     , realClientContext()
+    , dispatchThread()
+    , dispatchReady(false)
+    , dispatchExit(false)
     , clientContext(context)
     , status(STATUS_OK)
+    , readDeadlineMicros(0)
     , objectFinder(clientContext)
 {
     clientContext->coordinatorSession->setLocation(serviceLocator);
@@ -69,9 +82,53 @@ RamCloud::RamCloud(Context* context, const char* serviceLocator)
 
 RamCloud::~RamCloud()
 {
+    if (dispatchThread) {
+        // The dispatch thread destroys realClientContext as it exits.
+        dispatchExit = true;
+        dispatchThread->join();
+        dispatchThread.destroy();
+    }
     realClientContext.destroy();
 }
 
+/**
+ * The main program for the dispatch thread of a multi-threaded RamCloud
+ * object. The context is created here so that this thread becomes its
+ * dispatch thread.
+ */
+void
+RamCloud::dispatchMain()
+try {
+    Context* context = realClientContext.construct(true);
+    context->transportManager->enableClientThreads();
+    dispatchReady = true;
+    while (!dispatchExit)
+        context->dispatch->poll();
+    realClientContext.destroy();
+} catch (const std::exception& e) {
+    LOG(ERROR, "Fatal error in RamCloud::dispatchThread: %s", e.what());
+    throw;
+} catch (...) {
+    LOG(ERROR, "Unknown fatal error in RamCloud::dispatchThread.");
+    throw;
+}
+
+/**
+ * Start the dispatch thread for a multi-threaded RamCloud object and wait
+ * for it to create the client context.
+ *
+ * \return
+ *      The new context.
+ */
+Context*
+RamCloud::startDispatchThread()
+{
+    dispatchThread.construct(&RamCloud::dispatchMain, this);
+    while (!dispatchReady)
+        usleep(100);
+    return realClientContext.get();
+}
+
 /**
  * Create a new table.
  *
@@ -863,6 +920,156 @@ IncrementRpc::wait(uint64_t* version)
     return respHdr->newValue;
 }
 
+/**
+ * Look up a range of secondary keys in one tablet's portion of an index.
+ * Each master indexes only the objects in the tablets it owns, so a
+ * complete lookup must visit every tablet of the table, merging the
+ * results; IndexLookup does this.
+ *
+ * This method is meant to be called from IndexLookup and should not
+ * normally be used directly by applications.
+ *
+ * \param tableId
+ *      The table whose index is to be searched.
+ * \param tabletFirstHash
+ *      Identifies the tablet to search. The caller should provide zero on
+ *      the initial call; each call returns the value to pass to reach the
+ *      next tablet.
+ * \param indexId
+ *      Identifies the index within the table.
+ * \param firstKey
+ *      Smallest secondary key to return, encoded as described in IndexKey.
+ * \param firstKeyLength
+ *      Size in bytes of firstKey.
+ * \param firstPrimaryKey
+ *      Entries for firstKey whose primary keys sort before this one are
+ *      skipped. Used to resume a lookup from nextKey and nextPrimaryKey.
+ * \param firstPrimaryKeyLength
+ *      Size in bytes of firstPrimaryKey; 0 to start with the first entry
+ *      for firstKey.
+ * \param lastKey
+ *      Largest secondary key to return.
+ * \param lastKeyLength
+ *      Size in bytes of lastKey.
+ * \param maxResults
+ *      Maximum number of results to return.
+ * \param returnObjects
+ *      If true, results include the objects' values.
+ * \param[out] results
+ *      After a successful return, holds numResults results in index order,
+ *      each a WireFormat::LookupIndexKeys::Result followed by the secondary
+ *      key, primary key, and value (if requested).
+ * \param[out] numResults
+ *      The number of results returned.
+ * \param[out] haveNext
+ *      Set to true if this tablet holds more results; the caller should
+ *      continue from nextKey and nextPrimaryKey with the same tabletFirstHash.
+ * \param[out] nextKey
+ *      If haveNext, the secondary key to continue from.
+ * \param[out] nextPrimaryKey
+ *      If haveNext, the primary key to continue from.
+ *
+ * \return
+ *      The first key hash of the tablet following this one, or zero if this
+ *      was the last tablet of the table.
+ */
+uint64_t
+RamCloud::lookupIndexKeys(uint64_t tableId, uint64_t tabletFirstHash,
+        uint8_t indexId, const void* firstKey, uint16_t firstKeyLength,
+        const void* firstPrimaryKey, uint16_t firstPrimaryKeyLength,
+        const void* lastKey, uint16_t lastKeyLength, uint32_t maxResults,
+        bool returnObjects, Buffer& results, uint32_t* numResults,
+        bool* haveNext, string* nextKey, string* nextPrimaryKey)
+{
+    LookupIndexKeysRpc rpc(this, tableId, tabletFirstHash, indexId,
+            firstKey, firstKeyLength, firstPrimaryKey, firstPrimaryKeyLength,
+            lastKey, lastKeyLength, maxResults, returnObjects, results);
+    return rpc.wait(numResults, haveNext, nextKey, nextPrimaryKey);
+}
+
+/**
+ * Constructor for LookupIndexKeysRpc: initiates an RPC in the same way as
+ * #RamCloud::lookupIndexKeys, but returns once the RPC has been initiated,
+ * without waiting for it to complete. The key arguments are copied, so the
+ * caller need not keep them around.
+ *
+ * \param ramcloud
+ *      The RAMCloud object that governs this RPC.
+ * \copydetails RamCloud::lookupIndexKeys
+ */
+LookupIndexKeysRpc::LookupIndexKeysRpc(RamCloud* ramcloud, uint64_t tableId,
+        uint64_t tabletFirstHash, uint8_t indexId,
+        const void* firstKey, uint16_t firstKeyLength,
+        const void* firstPrimaryKey, uint16_t firstPrimaryKeyLength,
+        const void* lastKey, uint16_t lastKeyLength, uint32_t maxResults,
+        bool returnObjects, Buffer& results)
+    : ObjectRpcWrapper(ramcloud, tableId, tabletFirstHash,
+            sizeof(WireFormat::LookupIndexKeys::Response), &results)
+{
+    WireFormat::LookupIndexKeys::Request* reqHdr(
+            allocHeader<WireFormat::LookupIndexKeys>());
+    reqHdr->tableId = tableId;
+    reqHdr->tabletFirstHash = tabletFirstHash;
+    reqHdr->indexId = indexId;
+    reqHdr->returnObjects = returnObjects;
+    reqHdr->maxResults = maxResults;
+    reqHdr->firstKeyLength = firstKeyLength;
+    reqHdr->firstPrimaryKeyLength = firstPrimaryKeyLength;
+    reqHdr->lastKeyLength = lastKeyLength;
+    memcpy(new(&request, APPEND) char[firstKeyLength], firstKey,
+            firstKeyLength);
+    memcpy(new(&request, APPEND) char[firstPrimaryKeyLength], firstPrimaryKey,
+            firstPrimaryKeyLength);
+    memcpy(new(&request, APPEND) char[lastKeyLength], lastKey, lastKeyLength);
+    send();
+}
+
+/**
+ * Wait for a lookupIndexKeys RPC to complete, and return the same results
+ * as #RamCloud::lookupIndexKeys.
+ *
+ * \param[out] numResults
+ *      The number of results left in the \a results Buffer passed to the
+ *      constructor.
+ * \param[out] haveNext
+ *      Set to true if the tablet holds more results.
+ * \param[out] nextKey
+ *      If haveNext, the secondary key to continue from.
+ * \param[out] nextPrimaryKey
+ *      If haveNext, the primary key to continue from.
+ * \return
+ *      The first key hash of the next tablet, or 0 if there is none.
+ */
+uint64_t
+LookupIndexKeysRpc::wait(uint32_t* numResults, bool* haveNext,
+        string* nextKey, string* nextPrimaryKey)
+{
+    simpleWait(ramcloud->clientContext->dispatch);
+    const WireFormat::LookupIndexKeys::Response* respHdr(
+            getResponseHeader<WireFormat::LookupIndexKeys>());
+    uint64_t result = respHdr->tabletFirstHash;
+    *numResults = respHdr->numResults;
+    *haveNext = respHdr->haveNext;
+
+    // Copy out the keys to continue from, which follow the results.
+    uint32_t nextKeysLength = respHdr->nextKeyLength +
+            respHdr->nextPrimaryKeyLength;
+    uint32_t offset = response->getTotalLength() - nextKeysLength;
+    nextKey->assign(respHdr->nextKeyLength, '\0');
+    response->copy(offset, respHdr->nextKeyLength, &(*nextKey)[0]);
+    nextPrimaryKey->assign(respHdr->nextPrimaryKeyLength, '\0');
+    response->copy(offset + respHdr->nextKeyLength,
+            respHdr->nextPrimaryKeyLength, &(*nextPrimaryKey)[0]);
+
+    // Truncate the front and back of the response buffer, leaving just the
+    // results (the response buffer is the \c results argument from
+    // the constructor).
+    response->truncateFront(sizeof(*respHdr));
+    response->truncateEnd(nextKeysLength);
+
+    return result;
+}
+
 /**
  * Request that the master owning a particular tablet migrate it
  * to another designated master.
@@ -1079,7 +1286,9 @@ ReadRpc::ReadRpc(RamCloud* ramcloud, uint64_t tableId,
     WireFormat::Read::Request* reqHdr(allocHeader<WireFormat::Read>());
     reqHdr->tableId = tableId;
     reqHdr->keyLength = keyLength;
+    reqHdr->keyHash = keyHash;
     reqHdr->rejectRules = rejectRules ? *rejectRules : defaultRejectRules;
+    reqHdr->deadlineMicros = ramcloud->readDeadlineMicros;
     request.append(key, keyLength);
     send();
 }
@@ -1097,6 +1306,12 @@ ReadRpc::wait(uint64_t* version)
     waitInternal(ramcloud->clientContext->dispatch);
     const WireFormat::Read::Response* respHdr(
             getResponseHeader<WireFormat::Read>());
+
+
+    // Some errors (such as a read that missed its deadline) come back
+    // with nothing but a status.
+    if (response->getTotalLength() < sizeof(*respHdr))
+        ClientException::throwException(HERE, respHdr->common.status);
     if (version != NULL)
         *version = respHdr->version;
 
@@ -1303,6 +1518,84 @@ ServerControlRpc::wait()
 
 
 
+/**
+ * Set the expiry policy of a table. Objects older than the table's ttl are
+ * no longer returned by reads and are discarded when the log cleaner next
+ * comes across them. Objects in evictable tables may also be discarded by
+ * the cleaner when a master runs short of memory, older objects being more
+ * likely to go; this suits tables used as caches.
+ *
+ * Policies are kept by the masters that own the table's tablets at the time
+ * of the call; they do not survive crash recovery or tablet migration, so
+ * this should be invoked again after either.
+ *
+ * \param tableId
+ *      The table whose policy is to be set.
+ * \param ttl
+ *      Objects expire this many seconds after they were last written; 0
+ *      means they never expire.
+ * \param evictable
+ *      If true, live objects may be evicted under memory pressure.
+ */
+void
+RamCloud::setTableExpiry(uint64_t tableId, uint32_t ttl, bool evictable)
+{
+    uint64_t tabletFirstHash = 0;
+    do {
+        SetTableExpiryRpc rpc(this, tableId, tabletFirstHash, ttl, evictable);
+        tabletFirstHash = rpc.wait();
+    } while (tabletFirstHash != 0);
+}
+
+/**
+ * Constructor for SetTableExpiryRpc: initiates an RPC that sets the expiry
+ * policy of one tablet, but returns once the RPC has been initiated, without
+ * waiting for it to complete.
+ *
+ * \param ramcloud
+ *      The RAMCloud object that governs this RPC.
+ * \param tableId
+ *      The table whose policy is to be set.
+ * \param tabletFirstHash
+ *      Identifies the tablet whose policy is to be set. Zero identifies the
+ *      first tablet of the table; wait() returns the value identifying the
+ *      next one.
+ * \param ttl
+ *      Objects expire this many seconds after they were last written; 0
+ *      means they never expire.
+ * \param evictable
+ *      If true, live objects may be evicted under memory pressure.
+ */
+SetTableExpiryRpc::SetTableExpiryRpc(RamCloud* ramcloud, uint64_t tableId,
+        uint64_t tabletFirstHash, uint32_t ttl, bool evictable)
+    : ObjectRpcWrapper(ramcloud, tableId, tabletFirstHash,
+            sizeof(WireFormat::SetTableExpiry::Response))
+{
+    WireFormat::SetTableExpiry::Request* reqHdr(
+            allocHeader<WireFormat::SetTableExpiry>());
+    reqHdr->tableId = tableId;
+    reqHdr->tabletFirstHash = tabletFirstHash;
+    reqHdr->ttl = ttl;
+    reqHdr->evictable = evictable;
+    send();
+}
+
+/**
+ * Wait for a setTableExpiry RPC to complete.
+ *
+ * \return
+ *      The first key hash of the next tablet of the table, or 0 if there
+ *      is none.
+ */
+uint64_t
+SetTableExpiryRpc::wait()
+{
+    simpleWait(ramcloud->clientContext->dispatch);
+    const WireFormat::SetTableExpiry::Response* respHdr(
+            getResponseHeader<WireFormat::SetTableExpiry>());
+    return respHdr->tabletFirstHash;
+}
+
 /**
  * Divide a tablet into two separate tablets.
  *
@@ -1628,6 +1921,103 @@ RamCloud::testingWaitForAllTabletsNormal(uint64_t timeoutNs)
     objectFinder.waitForAllTabletsNormal(timeoutNs);
 }
 
+/**
+ * Atomically check, write, and remove several objects stored on a single
+ * master. Either all of the writes and removes take effect or none do: the
+ * transaction aborts if the RejectRules of any object reject its current
+ * version, which allows optimistic updates of several objects without
+ * rolling back partial updates. All of the objects must belong to tablets
+ * owned by the master that owns the first of them.
+ *
+ * \param requests
+ *      Each element in this array describes one object in the transaction;
+ *      each object may appear only once. The result of checking its reject
+ *      rules and its version are returned here. STATUS_UNKNOWN_TABLET means
+ *      the object doesn't live on the same master as the first one.
+ * \param numRequests
+ *      Number of valid entries in \c requests.
+ * \return
+ *      True if the transaction committed, false if it aborted (in which
+ *      case at least one of the requests has a status other than
+ *      STATUS_OK).
+ */
+bool
+RamCloud::transaction(TransactionObject* requests[], uint32_t numRequests)
+{
+    TransactionRpc rpc(this, requests, numRequests);
+    return rpc.wait();
+}
+
+/**
+ * Constructor for TransactionRpc: initiates an RPC in the same way as
+ * #RamCloud::transaction, but returns once the RPC has been initiated,
+ * without waiting for it to complete.
+ *
+ * \param ramcloud
+ *      The RAMCloud object that governs this RPC.
+ * \param requests
+ *      Each element in this array describes one object in the transaction.
+ *      The caller must ensure that the requests and the storage they refer
+ *      to are unchanged through the life of the RPC.
+ * \param numRequests
+ *      Number of valid entries in \c requests; must be at least 1.
+ */
+TransactionRpc::TransactionRpc(RamCloud* ramcloud,
+        TransactionObject* requests[], uint32_t numRequests)
+    : ObjectRpcWrapper(ramcloud, requests[0]->tableId, requests[0]->key,
+            requests[0]->keyLength, sizeof(WireFormat::Transaction::Response))
+    , requests(requests)
+    , numRequests(numRequests)
+{
+    WireFormat::Transaction::Request* reqHdr(
+            allocHeader<WireFormat::Transaction>());
+    reqHdr->count = numRequests;
+    for (uint32_t i = 0; i < numRequests; i++) {
+        TransactionObject& object = *requests[i];
+        uint32_t valueLength =
+            (object.type == WireFormat::Transaction::WRITE) ?
+                object.valueLength : 0;
+        new(&request, APPEND) WireFormat::Transaction::Request::Part(
+                downCast<uint8_t>(object.type), object.tableId,
+                object.keyLength, valueLength,
+                object.rejectRules ? *object.rejectRules :
+                                     defaultRejectRules);
+        request.append(object.key, object.keyLength);
+        request.append(object.value, valueLength);
+    }
+    send();
+}
+
+/**
+ * Wait for a transaction RPC to complete, and return the same results as
+ * #RamCloud::transaction.
+ */
+bool
+TransactionRpc::wait()
+{
+    waitInternal(ramcloud->clientContext->dispatch);
+    const WireFormat::Transaction::Response* respHdr(
+            getResponseHeader<WireFormat::Transaction>());
+    if (respHdr->common.status != STATUS_OK)
+        ClientException::throwException(HERE, respHdr->common.status);
+
+    bool committed = true;
+    uint32_t offset = sizeof32(*respHdr);
+    for (uint32_t i = 0; i < numRequests; i++) {
+        const WireFormat::Transaction::Response::Part* part =
+            response->getOffset<WireFormat::Transaction::Response::Part>(
+                offset);
+        if (part == NULL)
+            throw ResponseFormatError(HERE);
+        offset += sizeof32(*part);
+        requests[i]->status = part->status;
+        requests[i]->version = part->version;
+        if (part->status != STATUS_OK)
+            committed = false;
+    }
+    return committed;
+}
+
 /**
  * Replace the value of a given object, or create a new object if none
  * previously existed.
@@ -1714,6 +2104,54 @@ RamCloud::write(uint64_t tableId, const void* key, uint16_t keyLength,
     rpc.wait(version);
 }
 
+/**
+ * Replace the value of a given object, or create a new object if none
+ * previously existed, giving the object a set of secondary keys by which
+ * it is indexed (see IndexLookup).
+ *
+ * \param tableId
+ *      The table containing the desired object (return value from
+ *      a previous call to getTableId).
+ * \param key
+ *      Variable length key that uniquely identifies the object within tableId.
+ *      It does not necessarily have to be null terminated.  The caller must
+ *      ensure that the storage for this key is unchanged through the life of
+ *      the RPC.
+ * \param keyLength
+ *      Size in bytes of the key.
+ * \param buf
+ *      Address of the first byte of the new contents for the object;
+ *      must contain at least length bytes.
+ * \param length
+ *      Size in bytes of the new contents for the object.
+ * \param secondaryKeys
+ *      Secondary keys for the object, built with IndexKey::append(). Any
+ *      secondary keys the object had before are replaced.
+ * \param rejectRules
+ *      If non-NULL, specifies conditions under which the write
+ *      should be aborted with an error.
+ * \param[out] version
+ *      If non-NULL, the version number of the object is returned here.
+ *      If the operation was successful this will be the new version for
+ *      the object. If the operation failed then the version number returned
+ *      is the current version of the object, or 0 if the object does not
+ *      exist.
+ * \param async
+ *      If true, the new object will not be immediately replicated to backups.
+ *      Data loss may occur!
+ *
+ * \exception RejectRulesException
+ */
+void
+RamCloud::write(uint64_t tableId, const void* key, uint16_t keyLength,
+        const void* buf, uint32_t length, Buffer& secondaryKeys,
+        const RejectRules* rejectRules, uint64_t* version, bool async)
+{
+    WriteRpc rpc(this, tableId, key, keyLength, buf, length, rejectRules,
+            async, &secondaryKeys);
+    rpc.wait(version);
+}
+
 /**
  * Constructor for WriteRpc: initiates an RPC in the same way as
  * #RamCloud::write, but returns once the RPC has been initiated, without
@@ -1742,21 +2180,33 @@ RamCloud::write(uint64_t tableId, const void* key, uint16_t keyLength,
  * \param async
  *      If true, the new object will not be immediately replicated to backups.
  *      Data loss may occur!
+ * \param secondaryKeys
+ *      If non-NULL, secondary keys for the object (see IndexKey). The
+ *      caller must ensure that this buffer and the storage it refers to are
+ *      unchanged through the life of the RPC.
  */
 WriteRpc::WriteRpc(RamCloud* ramcloud, uint64_t tableId,
         const void* key, uint16_t keyLength, const void* buf, uint32_t length,
-        const RejectRules* rejectRules, bool async)
+        const RejectRules* rejectRules, bool async, Buffer* secondaryKeys)
     : ObjectRpcWrapper(ramcloud, tableId, key, keyLength,
             sizeof(WireFormat::Write::Response))
 {
     WireFormat::Write::Request* reqHdr(allocHeader<WireFormat::Write>());
     reqHdr->tableId = tableId;
     reqHdr->keyLength = keyLength;
+    reqHdr->keyHash = keyHash;
     reqHdr->length = length;
     reqHdr->rejectRules = rejectRules ? *rejectRules : defaultRejectRules;
     reqHdr->async = async;
+    reqHdr->secondaryKeysLength = 0;
     request.append(key, keyLength);
     request.append(buf, length);
+    if (secondaryKeys != NULL) {
+        reqHdr->secondaryKeysLength =
+            downCast<uint16_t>(secondaryKeys->getTotalLength());
+        for (Buffer::Iterator it(*secondaryKeys); !it.isDone(); it.next())
+            request.append(it.getData(), it.getLength());
+    }
     send();
 }
 
@@ -16,6 +16,13 @@
 #ifndef RAMCLOUD_RAMCLOUD_H
 #define RAMCLOUD_RAMCLOUD_H
 
+#if __GNUC__ >= 4 && __GNUC_MINOR__ >= 5
+#include <atomic>
+#else
+#include <cstdatomic>
+#endif
+#include <thread>
+
 #include "Common.h"
 #include "CoordinatorClient.h"
 #include "MasterClient.h"
@@ -30,6 +37,7 @@ namespace RAMCloud {
 class MultiReadObject;
 class MultiRemoveObject;
 class MultiWriteObject;
+class TransactionObject;
 
 /**
  * The RamCloud class provides the primary interface used by applications to
@@ -38,8 +46,13 @@ class MultiWriteObject;
  * Each RamCloud object provides access to a particular RAMCloud cluster;
  * all of the RAMCloud RPC requests appear as methods on this object.
  *
- * In multi-threaded clients there must be a separate RamCloud object for
- * each thread; as of 5/2012 these objects are not thread-safe.
+ * By default RamCloud objects are not thread-safe: RPCs make progress only
+ * while the thread that issued them polls the dispatcher.  A RamCloud object
+ * constructed with multiThreaded set may be shared by any number of threads.
+ * It starts its own dispatch thread, and the threads share its tablet map
+ * cache and sessions; each thread simply spins on its own RPCs until the
+ * dispatch thread completes them, and RPCs are handed to the dispatch
+ * thread without locking it.
  */
 class RamCloud {
   public:
@@ -62,6 +75,12 @@ class RamCloud {
     int64_t increment(uint64_t tableId, const void* key, uint16_t keyLength,
             int64_t incrementValue, const RejectRules* rejectRules = NULL,
             uint64_t* version = NULL);
+    uint64_t lookupIndexKeys(uint64_t tableId, uint64_t tabletFirstHash,
+            uint8_t indexId, const void* firstKey, uint16_t firstKeyLength,
+            const void* firstPrimaryKey, uint16_t firstPrimaryKeyLength,
+            const void* lastKey, uint16_t lastKeyLength, uint32_t maxResults,
+            bool returnObjects, Buffer& results, uint32_t* numResults,
+            bool* haveNext, string* nextKey, string* nextPrimaryKey);
     void migrateTablet(uint64_t tableId, uint64_t firstKeyHash,
             uint64_t lastKeyHash, ServerId newOwnerMasterId);
     void multiRead(MultiReadObject* requests[], uint32_t numRequests);
@@ -76,6 +95,8 @@ class RamCloud {
     void serverControl(uint64_t tableId, const void* key, uint16_t keyLength,
             WireFormat::ControlOp controlOp,
             const void* inputData, uint32_t inputLength, Buffer* outputData);
+    void setTableExpiry(uint64_t tableId, uint32_t ttl,
+            bool evictable = false);
     void splitTablet(const char* name, uint64_t splitKeyHash);
     void testingFill(uint64_t tableId, const void* key, uint16_t keyLength,
             uint32_t numObjects, uint32_t objectSize);
@@ -86,6 +107,7 @@ class RamCloud {
     void testingKill(uint64_t tableId, const void* key, uint16_t keyLength);
     void setRuntimeOption(const char* option, const char* value);
     void testingWaitForAllTabletsNormal(uint64_t timeoutNs = ~0lu);
+    bool transaction(TransactionObject* requests[], uint32_t numRequests);
     void write(uint64_t tableId, const void* key, uint16_t keyLength,
                 const void* buf, uint32_t length,
                 const RejectRules* rejectRules = NULL, uint64_t* version = NULL,
@@ -93,7 +115,11 @@ class RamCloud {
     void write(uint64_t tableId, const void* key, uint16_t keyLength,
             const char* value, const RejectRules* rejectRules = NULL,
             uint64_t* version = NULL, bool async = false);
-    explicit RamCloud(const char* serviceLocator);
+    void write(uint64_t tableId, const void* key, uint16_t keyLength,
+                const void* buf, uint32_t length, Buffer& secondaryKeys,
+                const RejectRules* rejectRules = NULL, uint64_t* version = NULL,
+                bool async = false);
+    explicit RamCloud(const char* serviceLocator, bool multiThreaded = false);
     RamCloud(Context* context, const char* serviceLocator);
     virtual ~RamCloud();
 
@@ -109,6 +135,22 @@ class RamCloud {
      */
     Tub<Context> realClientContext;
 
+    /**
+     * If this object was constructed with multiThreaded set, this thread
+     * creates #realClientContext and polls its dispatcher until the
+     * RamCloud object is destroyed (see dispatchMain()).
+     */
+    Tub<std::thread> dispatchThread;
+
+    /// Set by #dispatchThread once #realClientContext is ready for use.
+    std::atomic<bool> dispatchReady;
+
+    /// Set by the destructor to tell #dispatchThread to exit.
+    std::atomic<bool> dispatchExit;
+
+    void dispatchMain();
+    Context* startDispatchThread();
+
   public:
     /**
      * This usually refers to realClientContext. For testing purposes and
@@ -123,6 +165,17 @@ class RamCloud {
      */
     Status status;
 
+    /**
+     * If nonzero, reads issued through this object ask their master to
+     * give up on them (the read fails with TimeoutException) if they
+     * haven't started executing within this many microseconds of arriving;
+     * see WireFormat::Read::Request. Useful for clients that would rather
+     * fail fast than see a long tail of slow reads while the master is
+     * busy with background work such as migration. 0 (the default) means
+     * reads never time out.
+     */
+    uint32_t readDeadlineMicros;
+
   public: // public for now to make administrative calls from clients
     ObjectFinder objectFinder;
 
@@ -329,6 +382,26 @@ class KillRpc : public ObjectRpcWrapper {
     DISALLOW_COPY_AND_ASSIGN(KillRpc);
 };
 
+/**
+ * Encapsulates the state of a RamCloud::lookupIndexKeys
+ * request, allowing it to execute asynchronously.
+ */
+class LookupIndexKeysRpc : public ObjectRpcWrapper {
+  public:
+    LookupIndexKeysRpc(RamCloud* ramcloud, uint64_t tableId,
+            uint64_t tabletFirstHash, uint8_t indexId,
+            const void* firstKey, uint16_t firstKeyLength,
+            const void* firstPrimaryKey, uint16_t firstPrimaryKeyLength,
+            const void* lastKey, uint16_t lastKeyLength, uint32_t maxResults,
+            bool returnObjects, Buffer& results);
+    ~LookupIndexKeysRpc() {}
+    uint64_t wait(uint32_t* numResults, bool* haveNext, string* nextKey,
+            string* nextPrimaryKey);
+
+  PRIVATE:
+    DISALLOW_COPY_AND_ASSIGN(LookupIndexKeysRpc);
+};
+
 /**
  * Encapsulates the state of a RamCloud::migrateTablet operation,
  * allowing it to execute asynchronously.
@@ -556,6 +629,79 @@ struct MultiWriteObject : public MultiOpObject {
     }
 };
 
+/**
+ * Objects of this class are used to pass parameters into \c transaction
+ * and for transaction to return the outcome for each object.
+ */
+struct TransactionObject : public MultiOpObject {
+    /**
+     * Whether the object is to be written, removed, or only checked
+     * against #rejectRules.
+     */
+    WireFormat::Transaction::OpType type;
+
+    /**
+     * Pointer to the new contents of the object (WRITE only).
+     */
+    const void* value;
+
+    /**
+     * Length of value in bytes.
+     */
+    uint32_t valueLength;
+
+    /**
+     * The RejectRules specify when the whole transaction should be aborted.
+     */
+    const RejectRules* rejectRules;
+
+    /**
+     * The version number of the object after the transaction is returned
+     * here or, if the transaction aborted, its current version.
+     */
+    uint64_t version;
+
+    TransactionObject(WireFormat::Transaction::OpType type, uint64_t tableId,
+                      const void* key, uint16_t keyLength,
+                      const RejectRules* rejectRules = NULL,
+                      const void* value = NULL, uint32_t valueLength = 0)
+        : MultiOpObject(tableId, key, keyLength)
+        , type(type)
+        , value(value)
+        , valueLength(valueLength)
+        , rejectRules(rejectRules)
+        , version()
+    {}
+
+    TransactionObject()
+        : MultiOpObject()
+        , type(WireFormat::Transaction::CHECK)
+        , value()
+        , valueLength()
+        , rejectRules()
+        , version()
+    {}
+
+    TransactionObject(const TransactionObject& other)
+        : MultiOpObject(other)
+        , type(other.type)
+        , value(other.value)
+        , valueLength(other.valueLength)
+        , rejectRules(other.rejectRules)
+        , version(other.version)
+    {}
+
+    TransactionObject& operator=(const TransactionObject& other) {
+        MultiOpObject::operator =(other);
+        type = other.type;
+        value = other.value;
+        valueLength = other.valueLength;
+        rejectRules = other.rejectRules;
+        version = other.version;
+        return *this;
+    }
+};
+
 /**
  * Encapsulates the state of a RamCloud::quiesce operation,
  * allowing it to execute asynchronously.
@@ -633,6 +779,21 @@ class SetRuntimeOptionRpc : public CoordinatorRpcWrapper {
     DISALLOW_COPY_AND_ASSIGN(SetRuntimeOptionRpc);
 };
 
+/**
+ * Encapsulates the state of a RamCloud::setTableExpiry operation on a single
+ * tablet, allowing it to execute asynchronously.
+ */
+class SetTableExpiryRpc : public ObjectRpcWrapper {
+  public:
+    SetTableExpiryRpc(RamCloud* ramcloud, uint64_t tableId,
+            uint64_t tabletFirstHash, uint32_t ttl, bool evictable);
+    ~SetTableExpiryRpc() {}
+    uint64_t wait();
+
+  PRIVATE:
+    DISALLOW_COPY_AND_ASSIGN(SetTableExpiryRpc);
+};
+
 /**
  * Encapsulates the state of a RamCloud::splitTablet operation,
  * allowing it to execute asynchronously.
@@ -649,6 +810,27 @@ class SplitTabletRpc : public CoordinatorRpcWrapper {
     DISALLOW_COPY_AND_ASSIGN(SplitTabletRpc);
 };
 
+/**
+ * Encapsulates the state of a RamCloud::transaction operation,
+ * allowing it to execute asynchronously.
+ */
+class TransactionRpc : public ObjectRpcWrapper {
+  public:
+    TransactionRpc(RamCloud* ramcloud, TransactionObject* requests[],
+            uint32_t numRequests);
+    ~TransactionRpc() {}
+    bool wait();
+
+  PRIVATE:
+    /// Copy of constructor argument.
+    TransactionObject** requests;
+
+    /// Copy of constructor argument.
+    uint32_t numRequests;
+
+    DISALLOW_COPY_AND_ASSIGN(TransactionRpc);
+};
+
 /**
  * Encapsulates the state of a RamCloud::write operation,
  * allowing it to execute asynchronously.
@@ -657,7 +839,8 @@ class WriteRpc : public ObjectRpcWrapper {
   public:
     WriteRpc(RamCloud* ramcloud, uint64_t tableId, const void* key,
             uint16_t keyLength, const void* buf, uint32_t length,
-            const RejectRules* rejectRules = NULL, bool async = false);
+            const RejectRules* rejectRules = NULL, bool async = false,
+            Buffer* secondaryKeys = NULL);
     ~WriteRpc() {}
     void wait(uint64_t* version = NULL);
 
@@ -19,6 +19,7 @@
 #include "ServerMetrics.h"
 #include "RamCloud.h"
 #include "TableEnumerator.h"
+#include "TransportManager.h"
 
 namespace RAMCloud {
 
@@ -65,6 +66,19 @@ class RamCloudTest : public ::testing::Test {
     DISALLOW_COPY_AND_ASSIGN(RamCloudTest);
 };
 
+TEST_F(RamCloudTest, constructor_multiThreaded) {
+    Tub<RamCloud> client;
+    client.construct("mock:host=coordinator", true);
+    EXPECT_TRUE(client->dispatchThread);
+    EXPECT_TRUE(client->clientContext == client->realClientContext.get());
+    EXPECT_FALSE(client->clientContext->dispatch->isDispatchThread());
+    EXPECT_TRUE(client->clientContext->transportManager->multiThreaded);
+    EXPECT_TRUE(client->clientContext->transportManager->sendQueue);
+
+    // The destructor stops the dispatch thread, which destroys the context.
+    client.destroy();
+}
+
 TEST_F(RamCloudTest, createTable) {
     string message("no exception");
     try {
@@ -17,6 +17,7 @@
 
 #include "Common.h"
 #include "Cycles.h"
+#include "Memory.h"
 #include "ShortMacros.h"
 #include "RawMetrics.h"
 #include "MetricList.pb.h"
@@ -24,6 +25,14 @@
 
 namespace RAMCloud {
 
+#if !DISABLE_METRICS
+// These must be constructed before #metrics, whose constructor sets a few
+// of its counters.
+__thread RawMetrics::Shard* RawMetrics::threadShard = NULL;
+std::mutex RawMetrics::mutex;
+std::vector<RawMetrics::Shard*> RawMetrics::shards;
+#endif
+
 namespace {
     /// See #metrics.
     RawMetrics _metrics;
@@ -36,6 +45,77 @@ namespace {
  */
 RawMetrics* metrics = &_metrics;
 
+#if !DISABLE_METRICS
+// Shards index counters by their position in RawMetrics, so it must contain
+// nothing but counters.
+static_assert(sizeof(RawMetrics) == RawMetrics::numMetrics * sizeof(RawMetric),
+              "RawMetrics must contain only RawMetric counters");
+
+/**
+ * Return the value of the counter, including everything that threads have
+ * added to their shards.
+ */
+uint64_t
+RawMetric::load() const
+{
+    uint64_t total = value.load(std::memory_order_relaxed);
+    uintptr_t offset = reinterpret_cast<uintptr_t>(this) -
+                       reinterpret_cast<uintptr_t>(metrics);
+    if (offset < sizeof(RawMetrics))
+        total += RawMetrics::sumShards(downCast<int>(offset / sizeof(*this)));
+    return total;
+}
+
+/**
+ * Set the value of the counter. Updates made concurrently by other threads
+ * may or may not be reflected in the new value.
+ */
+RawMetric&
+RawMetric::operator=(uint64_t newValue)
+{
+    uintptr_t offset = reinterpret_cast<uintptr_t>(this) -
+                       reinterpret_cast<uintptr_t>(metrics);
+    if (offset < sizeof(RawMetrics)) {
+        // The shards can only be changed by their own threads, so fold
+        // their contribution into the base value instead.
+        newValue -= RawMetrics::sumShards(
+                downCast<int>(offset / sizeof(*this)));
+    }
+    value.store(newValue, std::memory_order_relaxed);
+    return *this;
+}
+
+/**
+ * Create a Shard for the current thread; invoked the first time the thread
+ * updates a counter in #metrics.
+ */
+RawMetrics::Shard*
+RawMetrics::registerThread()
+{
+    void* memory = Memory::xmemalign(HERE, 64, sizeof(Shard));
+    threadShard = new(memory) Shard();
+    std::lock_guard<std::mutex> lock(mutex);
+    shards.push_back(threadShard);
+    return threadShard;
+}
+
+/**
+ * Return the sum of one counter over all of the shards.
+ *
+ * \param index
+ *      Position of the counter in RawMetrics (and #metricInfo).
+ */
+uint64_t
+RawMetrics::sumShards(int index)
+{
+    uint64_t total = 0;
+    std::lock_guard<std::mutex> lock(mutex);
+    foreach (Shard* shard, shards)
+        total += shard->counters[index].load(std::memory_order_relaxed);
+    return total;
+}
+#endif
+
 /**
  * This method is invoked from the constructor (which is defined in
  * RawMetrics.in.h).  It initializes a few special "metrics" that contain
@@ -52,7 +132,8 @@ RawMetrics::init()
 
 /**
  * Generate a string that contains a serialized representation of all of the
- * performance counters.
+ * performance counters. For #metrics, this is where the per-thread shards
+ * are added up.
  *
  * \param out
  *      The contents of this variable are replaced with a (binary) string
@@ -62,11 +143,23 @@ void
 RawMetrics::serialize(std::string& out)
 {
      ProtoBuf::MetricList list;
+#if !DISABLE_METRICS
+     std::lock_guard<std::mutex> lock(mutex);
+#endif
      for (int i = 0; i < numMetrics; i++) {
         MetricInfo info = metricInfo(i);
         ProtoBuf::MetricList_Entry* metric = list.add_metric();
         metric->set_name(info.name);
+#if !DISABLE_METRICS
+        uint64_t value = info.value->value.load(std::memory_order_relaxed);
+        if (this == metrics) {
+            foreach (Shard* shard, shards)
+                value += shard->counters[i].load(std::memory_order_relaxed);
+        }
+        metric->set_value(value);
+#else
         metric->set_value(*info.value);
+#endif
      }
      out.clear();
      list.SerializeToString(&out);
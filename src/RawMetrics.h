@@ -23,10 +23,73 @@
 #else
 #include <cstdatomic>
 #endif
+#include <mutex>
+
+#include "Common.h"
 
 #if !DISABLE_METRICS
 namespace RAMCloud {
-typedef std::atomic_ulong RawMetric;
+
+/**
+ * A single performance counter. Counters are bumped on hot paths by every
+ * thread in a server, so rather than doing an atomic read-modify-write on
+ * a cache line shared by all cores, each thread adds to its own private
+ * copy of the counters in #metrics (see RawMetrics::Shard) with a plain
+ * load and store. Reading a counter adds up all of the copies, which is
+ * much slower than updating it, but only happens occasionally.
+ *
+ * Counters in any RawMetrics object other than #metrics (unit tests create
+ * their own) aren't sharded; they are simply updated atomically.
+ */
+class RawMetric {
+  public:
+    explicit RawMetric(uint64_t value)
+        : value(value)
+    {
+    }
+
+    operator uint64_t() const
+    {
+        return load();
+    }
+
+    RawMetric&
+    operator+=(uint64_t delta)
+    {
+        add(delta);
+        return *this;
+    }
+
+    // There is no postfix ++: returning the old value would mean adding up
+    // the shards on every increment.
+    RawMetric&
+    operator++()
+    {
+        add(1);
+        return *this;
+    }
+
+    /// Copies the value of another counter (as in "a = b = 0").
+    RawMetric&
+    operator=(const RawMetric& other)
+    {
+        return *this = other.load();
+    }
+
+    RawMetric& operator=(uint64_t newValue);
+    uint64_t load() const;
+
+  PRIVATE:
+    void add(uint64_t delta);
+
+    /// The counter's value, not including anything that threads have added
+    /// to their shards.
+    std::atomic<uint64_t> value;
+
+    friend class RawMetrics;
+    RawMetric(const RawMetric&) = delete;
+};
+
 } // namespace RAMCloud
 #else
 #include "NoOp.h"
@@ -44,7 +107,7 @@ namespace RAMCloud {
 class RawMetrics {
   public:
     void serialize(std::string& out);
-  private:
+  PRIVATE:
     void init();
 
     /**
@@ -78,9 +141,75 @@ class RawMetrics {
 // all of the individual counters, as well as nested structures containing
 // counters.
 #include "RawMetrics.in.h"
+
+#if !DISABLE_METRICS
+  PRIVATE:
+    /**
+     * One thread's private copy of the counters in #metrics. The counters
+     * are in the same order as in RawMetrics itself (and in #metricInfo),
+     * so a RawMetric's index in a Shard is its offset in #metrics divided
+     * by sizeof(RawMetric). Only the owning thread updates a Shard; the
+     * counters are std::atomic just so that other threads may read them
+     * safely while they change.
+     */
+    struct Shard {
+        Shard()
+            : counters()
+        {
+            for (int i = 0; i < numMetrics; i++)
+                counters[i].store(0, std::memory_order_relaxed);
+        }
+
+        std::atomic<uint64_t> counters[numMetrics];
+
+        DISALLOW_COPY_AND_ASSIGN(Shard);
+    } __attribute__((aligned(64)));
+
+    static Shard* registerThread();
+    static uint64_t sumShards(int index);
+
+    /// The current thread's shard; NULL until the thread first updates a
+    /// counter in #metrics.
+    static __thread Shard* threadShard;
+
+    /// Protects #shards.
+    static std::mutex mutex;
+
+    /// Every Shard that has been created. Shards are never freed (their
+    /// counts must survive the threads that made them), but RAMCloud
+    /// creates few threads and each Shard is only a few KB.
+    static std::vector<Shard*> shards;
+
+    friend class RawMetric;
+#endif
 };
 
 extern RawMetrics* metrics;
+
+#if !DISABLE_METRICS
+/**
+ * Add to the value of a counter: in the current thread's shard if the
+ * counter belongs to #metrics, otherwise atomically.
+ */
+inline void
+RawMetric::add(uint64_t delta)
+{
+    uintptr_t offset = reinterpret_cast<uintptr_t>(this) -
+                       reinterpret_cast<uintptr_t>(metrics);
+    if (expect_false(offset >= sizeof(RawMetrics))) {
+        value.fetch_add(delta, std::memory_order_relaxed);
+        return;
+    }
+    RawMetrics::Shard* shard = RawMetrics::threadShard;
+    if (expect_false(shard == NULL))
+        shard = RawMetrics::registerThread();
+    std::atomic<uint64_t>& counter =
+            shard->counters[offset / sizeof(RawMetric)];
+    counter.store(counter.load(std::memory_order_relaxed) + delta,
+                  std::memory_order_relaxed);
+}
+#endif
+
 } // namespace RAMCloud
 
 #endif // RAMCLOUD_RAWMETRICS_H
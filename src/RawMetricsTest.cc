@@ -15,6 +15,8 @@
  * CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
  */
 
+#include <thread>
+
 #include "TestUtil.h"
 #include "RawMetrics.h"
 #include "MetricList.pb.h"
@@ -44,4 +46,56 @@ TEST_F(MetricsTest, serialize) {
     FAIL() << "master.recoveryTicks record not found";
 }
 
+// Shards find a counter's slot from its position in RawMetrics, so that
+// position must match the counter's number in metricInfo.
+TEST_F(MetricsTest, metricInfo_matchesLayout) {
+    RawMetric* first = reinterpret_cast<RawMetric*>(metrics);
+    for (int i = 0; i < RawMetrics::numMetrics; i++)
+        EXPECT_EQ(first + i, metrics->metricInfo(i).value);
+}
+
+static void
+incrementCounter(int count)
+{
+    for (int i = 0; i < count; i++) {
+        ++metrics->temp.count9;
+        metrics->temp.ticks9 += 2;
+    }
+}
+
+static uint64_t
+serializedValue(const char* name)
+{
+    string serialized;
+    metrics->serialize(serialized);
+    ProtoBuf::MetricList list;
+    list.ParseFromString(serialized);
+    for (int i = 0; i < list.metric_size(); i++) {
+        if (list.metric(i).name() == name)
+            return list.metric(i).value();
+    }
+    return ~0UL;
+}
+
+TEST_F(MetricsTest, shards) {
+    metrics->temp.count9 = 5;
+    metrics->temp.ticks9 = 0;
+    std::thread thread1(incrementCounter, 1000);
+    std::thread thread2(incrementCounter, 2000);
+    incrementCounter(10);
+    thread1.join();
+    thread2.join();
+    EXPECT_EQ(3015U, metrics->temp.count9);
+    EXPECT_EQ(6020U, metrics->temp.ticks9.load());
+    EXPECT_EQ(3015U, serializedValue("temp.count9"));
+
+    // Assignment must account for what is already in the shards.
+    metrics->temp.count9 = 7;
+    ++metrics->temp.count9;
+    EXPECT_EQ(8U, metrics->temp.count9);
+    EXPECT_EQ(8U, serializedValue("temp.count9"));
+    metrics->temp.count9 = metrics->temp.ticks9 = 0;
+    EXPECT_EQ(0U, serializedValue("temp.ticks9"));
+}
+
 }
@@ -83,6 +83,7 @@ Recovery::Recovery(Context* context,
     , testingMasterStartTaskSendCallback()
     , testingBackupEndTaskSendCallback()
     , testingFailRecoveryMasters()
+    , maxBytesPerPartition(0)
 {
     // if the crashed master had no tablets, recovery is effectively done.
     // When this recovery gets scheduled, it will call back into
@@ -104,26 +105,117 @@ Recovery::~Recovery()
  * them into groups. Each of the groups is recovered later, one to each
  * recovery master. The result is left in #tabletsToRecover.
  *
- * Right now this just naively puts each tablet from the crashed master
- * in its own group (and thus on its own recovery master). At some
- * point we'll need smart logic to group tablets based on their
- * expected recovery time.
+ * If the crashed master's table stats are available and
+ * #maxBytesPerPartition is set, then the size of each tablet is estimated
+ * from the stats (see TableStats::Estimator). Tablets larger than
+ * #maxBytesPerPartition are split into equal key hash ranges in the
+ * coordinator's tablet map, and the resulting pieces are packed into
+ * partitions of at most #maxBytesPerPartition bytes, largest first, so that
+ * each recovery master has about the same amount of data to replay. There
+ * are never more partitions than masters in the cluster; once that many
+ * exist, remaining pieces go to whichever partition has the least data.
+ *
+ * Otherwise each tablet is recovered as its own partition.
+ *
+ * \param tablets
+ *      Tablets owned by the crashed master, as returned by
+ *      TableManager::markAllTabletsRecovering().
+ * \param tableStats
+ *      Table stats recovered along with the crashed master's log digest
+ *      (see findTableStats()), or NULL if none were found.
  */
 void
-Recovery::partitionTablets(vector<Tablet> tablets)
+Recovery::partitionTablets(vector<Tablet> tablets,
+                           const TableStats::Digest* tableStats)
 {
-    //TODO(cstlee) Use tablet stats to create new partition scheme.
+    if (tableStats == NULL || maxBytesPerPartition == 0) {
+        foreach (auto& tablet, tablets) {
+            ProtoBuf::Tablets::Tablet& entry = *tabletsToRecover.add_tablet();
+            tablet.serialize(entry);
+            entry.set_user_data(numPartitions++);
+        }
+        return;
+    }
+
+    size_t maxPartitions = std::max(size_t(1),
+        tracker->getServersWithService(WireFormat::MASTER_SERVICE).size());
+    TableStats::Estimator estimator(tableStats, tablets);
+
+    // Split tablets that are too large to recover on a single recovery
+    // master; the pieces must also be split in the tablet map so that each
+    // can be reassigned separately when its recovery completes.
+    typedef std::pair<uint64_t, Tablet> SizedTablet;
+    vector<SizedTablet> pieces;
+    foreach (const Tablet& tablet, tablets) {
+        uint64_t bytes = estimator.estimate(tablet).byteCount;
+        uint64_t count = (bytes + maxBytesPerPartition - 1) /
+                         maxBytesPerPartition;
+        count = std::min(count, uint64_t(maxPartitions));
+        uint64_t width = tablet.endKeyHash - tablet.startKeyHash;
+        if (count > width / 2)
+            count = width / 2;
+        if (count <= 1) {
+            pieces.push_back({bytes, tablet});
+            continue;
+        }
+
+        uint64_t step = width / count;
+        Tablet piece = tablet;
+        try {
+            for (uint64_t i = 1; i < count; i++) {
+                uint64_t splitKeyHash = tablet.startKeyHash + i * step;
+                tableManager->splitRecoveringTablet(tablet.tableId,
+                                                    splitKeyHash);
+                piece.endKeyHash = splitKeyHash - 1;
+                pieces.push_back({estimator.estimate(piece).byteCount,
+                                  piece});
+                piece.startKeyHash = splitKeyHash;
+            }
+        } catch (const TableManager::NoSuchTable& e) {
+            // The table was dropped while the master was down; there's
+            // no point in splitting it further.
+        }
+        piece.endKeyHash = tablet.endKeyHash;
+        pieces.push_back({estimator.estimate(piece).byteCount, piece});
+    }
 
+    // First fit decreasing: place each piece, largest first, into the first
+    // partition with room for it.
+    std::sort(pieces.begin(), pieces.end(),
+              [](const SizedTablet& a, const SizedTablet& b)
+              { return a.first > b.first; });
+    vector<uint64_t> partitionBytes;
+    uint64_t totalBytes = 0;
+    foreach (const SizedTablet& piece, pieces) {
+        uint32_t partition = 0;
+        for (; partition < partitionBytes.size(); partition++) {
+            if (partitionBytes[partition] + piece.first <=
+                maxBytesPerPartition)
+                break;
+        }
+        if (partition == partitionBytes.size()) {
+            if (partitionBytes.size() < maxPartitions) {
+                partitionBytes.push_back(0);
+            } else {
+                partition = downCast<uint32_t>(
+                    std::min_element(partitionBytes.begin(),
+                                     partitionBytes.end()) -
+                    partitionBytes.begin());
+            }
+        }
+        partitionBytes[partition] += piece.first;
+        totalBytes += piece.first;
 
-    // Figure out the number of partitions to be recovered and bucket tablets
-    // together for recovery on a single recovery master. Right now the
-    // bucketing is each tablet from the crashed master is recovered on a
-    // single recovery master.
-    foreach (auto& tablet, tablets) {
         ProtoBuf::Tablets::Tablet& entry = *tabletsToRecover.add_tablet();
-        tablet.serialize(entry);
-        entry.set_user_data(numPartitions++);
+        piece.second.serialize(entry);
+        entry.set_user_data(partition);
     }
+    numPartitions = downCast<uint32_t>(partitionBytes.size());
+
+    LOG(NOTICE, "Partitioned %lu tablets of server %s (about %lu bytes) "
+        "into %lu pieces and %u partitions", tablets.size(),
+        crashedServerId.toString().c_str(), totalBytes, pieces.size(),
+        numPartitions);
 }
 
 /**
@@ -150,7 +242,7 @@ Recovery::performTask()
         return;
     }
 
-    metrics->coordinator.recoveryCount++;
+    ++metrics->coordinator.recoveryCount;
     switch (status) {
     case START_RECOVERY_ON_BACKUPS:
         LOG(NOTICE, "Starting recovery %lu for crashed server %s",
@@ -313,6 +405,8 @@ BackupStartTask::filterOutInvalidReplicas()
         result.logDigestBuffer.reset();
         result.logDigestSegmentId = -1;
         result.logDigestSegmentEpoch = -1;
+        result.tabletMetricsLen = 0;
+        result.tabletMetricsBuffer.reset();
     }
 }
 
@@ -470,6 +564,44 @@ findLogDigest(Tub<BackupStartTask> tasks[], size_t taskCount)
     return {std::make_pair(headId, LogDigest(headBuffer, headBufferLength))};
 }
 
+/**
+ * Find the table stats that were stored alongside the log digest in the
+ * head of the crashed master's log.
+ *
+ * \param tasks
+ *      Already run tasks holding the results of startReadingData calls
+ *      to all of the available backups.
+ * \param taskCount
+ *      Number of elements in #tasks.
+ * \param headId
+ *      Segment id of the replica the log digest came from, as returned by
+ *      findLogDigest().
+ * \return
+ *      The table stats, or NULL if no backup returned well-formed stats
+ *      from that segment (for example, if the log was written by an older
+ *      master). The stats remain owned by \a tasks.
+ */
+const TableStats::Digest*
+findTableStats(Tub<BackupStartTask> tasks[], size_t taskCount,
+               uint64_t headId)
+{
+    for (size_t i = 0; i < taskCount; ++i) {
+        const auto& result = tasks[i]->result;
+        if (!result.tabletMetricsBuffer ||
+            result.logDigestSegmentId != headId ||
+            result.tabletMetricsLen < sizeof(TableStats::DigestHeader))
+            continue;
+        const TableStats::Digest* stats =
+            reinterpret_cast<const TableStats::Digest*>(
+                result.tabletMetricsBuffer.get());
+        if (result.tabletMetricsLen != sizeof(TableStats::DigestHeader) +
+                stats->header.entryCount * sizeof(TableStats::DigestEntry))
+            continue;
+        return stats;
+    }
+    return NULL;
+}
+
 /// Used in buildReplicaMap().
 struct ReplicaAndLoadTime {
     WireFormat::Recover::Replica replica;
@@ -624,6 +756,8 @@ Recovery::startBackups()
     }
     uint64_t headId = digestInfo->first;
     LogDigest digest = digestInfo->second;
+    const TableStats::Digest* tableStats =
+        findTableStats(backupStartTasks.get(), backups.size(), headId);
 
     LOG(NOTICE, "Segment %lu is the head of the log", headId);
 
@@ -640,7 +774,7 @@ Recovery::startBackups()
     }
 
     /* Broadcast 2: partition replicas into tablets for recovery masters */
-    partitionTablets(tablets);
+    partitionTablets(tablets, tableStats);
 
     parallelRun(backupPartitionTasks.get(), backups.size(),
             maxActiveBackupHosts);
@@ -26,6 +26,7 @@
 #include "RawMetrics.h"
 #include "ServerTracker.h"
 #include "TableManager.h"
+#include "TableStats.h"
 #include "Tablets.pb.h"
 #include "TaskQueue.h"
 
@@ -100,6 +101,8 @@ bool verifyLogComplete(Tub<BackupStartTask> tasks[],
                        const LogDigest& digest);
 Tub<std::pair<uint64_t, LogDigest>>
 findLogDigest(Tub<BackupStartTask> tasks[], size_t taskCount);
+const TableStats::Digest* findTableStats(Tub<BackupStartTask> tasks[],
+                                         size_t taskCount, uint64_t headId);
 vector<WireFormat::Recover::Replica> buildReplicaMap(
     Tub<BackupStartTask> tasks[], size_t taskCount,
     RecoveryTracker* tracker, uint64_t headId);
@@ -175,7 +178,8 @@ class Recovery : public Task {
     const ProtoBuf::MasterRecoveryInfo masterRecoveryInfo;
 
   PRIVATE:
-    void partitionTablets(vector<Tablet> tablets);
+    void partitionTablets(vector<Tablet> tablets,
+                          const TableStats::Digest* tableStats = NULL);
     void startBackups();
     void startRecoveryMasters();
     void broadcastRecoveryComplete();
@@ -301,6 +305,14 @@ class Recovery : public Task {
      */
     uint32_t testingFailRecoveryMasters;
 
+    /**
+     * Target number of bytes of live data per partition when dividing the
+     * crashed master's tablets among recovery masters (see
+     * partitionTablets()). Zero means each tablet is recovered as its own
+     * partition. Set from the coordinator's runtime options.
+     */
+    uint64_t maxBytesPerPartition;
+
     friend class RecoveryInternal::BackupStartTask;
     friend class RecoveryInternal::BackupStartPartitionTask;
     friend class RecoveryInternal::MasterStartTask;
@@ -162,6 +162,7 @@ try
     uint32_t objectDataSize;
     uint32_t tableCount;
     uint32_t tableSkip;
+    uint64_t maxBytesPerPartition;
 
     // need external context to set log levels with OptionParser
     Context context(true);
@@ -184,6 +185,12 @@ try
             default_value(1),
          "The number of empty tables to create per real table."
          "An enormous hack to create partitions on the crashed master.")
+        ("maxBytesPerPartition",
+         ProgramOptions::value<uint64_t>(&maxBytesPerPartition)->
+            default_value(0),
+         "If nonzero, have the coordinator divide the crashed master's "
+         "tablets into partitions of about this many bytes each (based on "
+         "its table stats) rather than one partition per tablet.")
         ("numClients",
          ProgramOptions::value<int>(&numClients)->
             default_value(1),
@@ -220,6 +227,13 @@ try
     if (verify && fillWithTestData)
         DIE("verify not supported with fillWithTestData");
 
+    if (maxBytesPerPartition > 0) {
+        client.setRuntimeOption("maxBytesPerPartition",
+                                format("%lu", maxBytesPerPartition).c_str());
+        LOG(NOTICE, "Partitioning recovered tablets into %lu byte partitions",
+            maxBytesPerPartition);
+    }
+
     char tableName[20];
     uint64_t tables[tableCount];
 
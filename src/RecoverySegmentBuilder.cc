@@ -76,7 +76,9 @@ RecoverySegmentBuilder::build(const void* buffer, uint32_t length,
             continue;
         }
         if (type != LOG_ENTRY_TYPE_OBJ && type != LOG_ENTRY_TYPE_OBJTOMB
-            && type != LOG_ENTRY_TYPE_SAFEVERSION)
+            && type != LOG_ENTRY_TYPE_SAFEVERSION
+            && type != LOG_ENTRY_TYPE_LEGACY_OBJ
+            && type != LOG_ENTRY_TYPE_LEGACY_OBJTOMB)
             continue;
 
         if (header == NULL) {
@@ -87,6 +89,16 @@ RecoverySegmentBuilder::build(const void* buffer, uint32_t length,
         Buffer entryBuffer;
         it.appendToBuffer(entryBuffer);
 
+        // Recovery masters only understand the current object format, so
+        // convert entries from replicas written by older masters.
+        Buffer upgradedBuffer;
+        if (expect_false(type == LOG_ENTRY_TYPE_LEGACY_OBJ ||
+                         type == LOG_ENTRY_TYPE_LEGACY_OBJTOMB)) {
+            type = upgradeLegacyEntry(type, entryBuffer, upgradedBuffer);
+            entryBuffer.reset();
+            entryBuffer.append(&upgradedBuffer);
+        }
+
         uint64_t tableId = -1;
         if (type == LOG_ENTRY_TYPE_SAFEVERSION) {
             // Copy SAFEVERSION to all the partitions for
@@ -122,13 +134,11 @@ RecoverySegmentBuilder::build(const void* buffer, uint32_t length,
         if (type == LOG_ENTRY_TYPE_OBJ) {
             Object object(entryBuffer);
             tableId = object.getTableId();
-            keyHash = Key::getHash(tableId,
-                                   object.getKey(), object.getKeyLength());
+            keyHash = object.getKeyHash();
         } else if (type == LOG_ENTRY_TYPE_OBJTOMB) {
             ObjectTombstone tomb(entryBuffer);
             tableId = tomb.getTableId();
-            keyHash = Key::getHash(tableId,
-                                   tomb.getKey(), tomb.getKeyLength());
+            keyHash = tomb.getKeyHash();
         } else {
             LOG(WARNING, "Unknown LogEntry (id=%u)", type);
             throw SegmentRecoveryFailedException(HERE);
@@ -171,7 +181,9 @@ RecoverySegmentBuilder::build(const void* buffer, uint32_t length,
 
 /**
  * Scan \a buffer for a LogDigest, and, if it exists, replace the contents
- * of \a digestBuffer with it.
+ * of \a digestBuffer with it. The table stats digest that masters write
+ * into each head segment along with the log digest may be extracted at the
+ * same time.
  *
  * \param buffer
  *      Contiguous region of \a length bytes that contains the replica contents
@@ -186,6 +198,10 @@ RecoverySegmentBuilder::build(const void* buffer, uint32_t length,
  * \param[out] digestBuffer
  *      Buffer to replace the contents of with a log digest if found. If no
  *      log digest is found the buffer is left unchanged.
+ * \param[out] tableStatsBuffer
+ *      If non-NULL and a log digest is found, the contents of this buffer are
+ *      replaced with the replica's table stats digest (see
+ *      TableStats::Digest), or emptied if the replica has none.
  * \return
  *      True if the digest was found and placed in the given buffer, otherwise
  *      false.
@@ -193,7 +209,8 @@ RecoverySegmentBuilder::build(const void* buffer, uint32_t length,
 bool
 RecoverySegmentBuilder::extractDigest(const void* buffer, uint32_t length,
                                       const Segment::Certificate& certificate,
-                                      Buffer* digestBuffer)
+                                      Buffer* digestBuffer,
+                                      Buffer* tableStatsBuffer)
 {
     // If the Segment is malformed somehow, just ignore it. The
     // coordinator will have to deal.
@@ -205,19 +222,137 @@ RecoverySegmentBuilder::extractDigest(const void* buffer, uint32_t length,
             "log digest: %s", e.str().c_str());
         return false;
     }
+    bool foundDigest = false;
     while (!it.isDone()) {
         if (it.getType() == LOG_ENTRY_TYPE_LOGDIGEST) {
             digestBuffer->reset();
             it.appendToBuffer(*digestBuffer);
-            return true;
+            foundDigest = true;
+            if (tableStatsBuffer == NULL)
+                break;
+            tableStatsBuffer->reset();
+        } else if (it.getType() == LOG_ENTRY_TYPE_TABLESTATS &&
+                   foundDigest && tableStatsBuffer != NULL) {
+            // Written right after the log digest in each new head segment.
+            it.appendToBuffer(*tableStatsBuffer);
+            break;
         }
         it.next();
     }
-    return false;
+    return foundDigest;
 }
 
 // - private -
 
+/**
+ * Header of an object in the LOG_ENTRY_TYPE_LEGACY_OBJ format: the same as
+ * Object::SerializedForm, but without the key hash.
+ */
+struct LegacyObjectHeader {
+    uint64_t tableId;
+    uint16_t keyLength;
+    uint64_t version;
+    uint32_t timestamp;
+    uint16_t secondaryKeysLength;
+    uint32_t checksum;
+} __attribute__((__packed__));
+static_assert(sizeof(LegacyObjectHeader) == 28,
+    "Unexpected legacy object header size");
+
+/**
+ * Header of a tombstone in the LOG_ENTRY_TYPE_LEGACY_OBJTOMB format: the same
+ * as ObjectTombstone::SerializedForm, but without the key hash.
+ */
+struct LegacyTombstoneHeader {
+    uint64_t tableId;
+    uint16_t keyLength;
+    uint64_t segmentId;
+    uint64_t objectVersion;
+    uint32_t timestamp;
+    uint32_t checksum;
+} __attribute__((__packed__));
+static_assert(sizeof(LegacyTombstoneHeader) == 34,
+    "Unexpected legacy tombstone header size");
+
+/**
+ * Convert an object or tombstone written in a legacy format (one without the
+ * key hash) into the current format. Replicas written by older masters may
+ * contain such entries, but recovery masters only replay the current format.
+ *
+ * \param type
+ *      Either LOG_ENTRY_TYPE_LEGACY_OBJ or LOG_ENTRY_TYPE_LEGACY_OBJTOMB.
+ * \param entryBuffer
+ *      The legacy entry.
+ * \param[out] outBuffer
+ *      A copy of the converted entry is appended here.
+ * \return
+ *      The type of the converted entry.
+ * \throw SegmentRecoveryFailedException
+ *      If the legacy entry's checksum doesn't match its contents.
+ */
+LogEntryType
+RecoverySegmentBuilder::upgradeLegacyEntry(LogEntryType type,
+                                           Buffer& entryBuffer,
+                                           Buffer& outBuffer)
+{
+    uint32_t length = entryBuffer.getTotalLength();
+    Crc32C crc;
+    if (type == LOG_ENTRY_TYPE_LEGACY_OBJ) {
+        LegacyObjectHeader header;
+        entryBuffer.copy(0, sizeof32(header), &header);
+        crc.update(&header, downCast<uint32_t>(
+            OFFSET_OF(LegacyObjectHeader, checksum)));
+        crc.update(entryBuffer, sizeof32(header), length - sizeof32(header));
+        if (crc.getResult() != header.checksum) {
+            LOG(WARNING, "bad checksum on legacy object in table %lu",
+                header.tableId);
+            throw SegmentRecoveryFailedException(HERE);
+        }
+
+        uint32_t keyOffset = sizeof32(header);
+        uint32_t dataOffset = keyOffset + header.keyLength;
+        uint32_t dataLength = length - dataOffset - header.secondaryKeysLength;
+        Key key(header.tableId, entryBuffer, keyOffset, header.keyLength);
+        Buffer data;
+        for (Buffer::Iterator it(entryBuffer, dataOffset, dataLength);
+             !it.isDone(); it.next())
+            data.append(it.getData(), it.getLength());
+        Buffer secondaryKeys;
+        for (Buffer::Iterator it(entryBuffer, dataOffset + dataLength,
+                                 header.secondaryKeysLength);
+             !it.isDone(); it.next())
+            secondaryKeys.append(it.getData(), it.getLength());
+
+        Object object(key, data, header.version, header.timestamp,
+                      header.secondaryKeysLength > 0 ? &secondaryKeys : NULL);
+        Buffer serialized;
+        object.serializeToBuffer(serialized);
+        uint32_t newLength = serialized.getTotalLength();
+        serialized.copy(0, newLength, new(&outBuffer, APPEND) char[newLength]);
+        return LOG_ENTRY_TYPE_OBJ;
+    }
+
+    LegacyTombstoneHeader header;
+    entryBuffer.copy(0, sizeof32(header), &header);
+    crc.update(&header, downCast<uint32_t>(
+        OFFSET_OF(LegacyTombstoneHeader, checksum)));
+    crc.update(entryBuffer, sizeof32(header), length - sizeof32(header));
+    if (crc.getResult() != header.checksum) {
+        LOG(WARNING, "bad checksum on legacy tombstone in table %lu",
+            header.tableId);
+        throw SegmentRecoveryFailedException(HERE);
+    }
+
+    Key key(header.tableId, entryBuffer, sizeof32(header), header.keyLength);
+    Object deadObject(key, NULL, 0, header.objectVersion, 0);
+    ObjectTombstone tombstone(deadObject, header.segmentId, header.timestamp);
+    Buffer serialized;
+    tombstone.serializeToBuffer(serialized);
+    uint32_t newLength = serialized.getTotalLength();
+    serialized.copy(0, newLength, new(&outBuffer, APPEND) char[newLength]);
+    return LOG_ENTRY_TYPE_OBJTOMB;
+}
+
 /**
  * Returns true if the entry is alive and should be recovered, otherwise
  * false if it should be ignored.
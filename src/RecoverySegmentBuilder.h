@@ -47,8 +47,12 @@ class RecoverySegmentBuilder {
                       Segment* recoverySegments);
     static bool extractDigest(const void* buffer, uint32_t length,
                               const Segment::Certificate& certificate,
-                              Buffer* digestBuffer);
+                              Buffer* digestBuffer,
+                              Buffer* tableStatsBuffer = NULL);
   PRIVATE:
+    static LogEntryType upgradeLegacyEntry(LogEntryType type,
+                                           Buffer& entryBuffer,
+                                           Buffer& outBuffer);
     static bool isEntryAlive(const Log::Position& position,
                              const ProtoBuf::Tablets::Tablet* tablet);
     static const ProtoBuf::Tablets::Tablet*
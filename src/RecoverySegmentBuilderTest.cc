@@ -20,6 +20,7 @@
 #include "SegmentManager.h"
 #include "ServerConfig.h"
 #include "StringUtil.h"
+#include "TableStats.h"
 #include "TabletsBuilder.h"
 
 namespace RAMCloud {
@@ -119,6 +120,115 @@ TEST_F(RecoverySegmentBuilderTest, build) {
         SegmentIteratorException);
 }
 
+// Append an object in the LOG_ENTRY_TYPE_LEGACY_OBJ format to a buffer.
+static void
+appendLegacyObject(Buffer& buffer, uint64_t tableId, const char* key,
+                   const char* value, uint64_t version)
+{
+    uint16_t keyLength = downCast<uint16_t>(strlen(key));
+    uint32_t valueLength = downCast<uint32_t>(strlen(value));
+    struct {
+        uint64_t tableId;
+        uint16_t keyLength;
+        uint64_t version;
+        uint32_t timestamp;
+        uint16_t secondaryKeysLength;
+        uint32_t checksum;
+    } __attribute__((__packed__)) header = {tableId, keyLength, version,
+                                            7, 0, 0};
+    Crc32C crc;
+    crc.update(&header, sizeof32(header) - 4);
+    crc.update(key, keyLength);
+    crc.update(value, valueLength);
+    header.checksum = crc.getResult();
+    memcpy(new(&buffer, APPEND) char[sizeof(header)], &header, sizeof(header));
+    buffer.append(key, keyLength);
+    buffer.append(value, valueLength);
+}
+
+TEST_F(RecoverySegmentBuilderTest, build_legacyEntries) {
+    LogSegment* segment = segmentManager.allocHeadSegment();
+    Buffer buffer;
+    appendLegacyObject(buffer, 1, "1", "hello", 9);
+    ASSERT_TRUE(segment->append(LOG_ENTRY_TYPE_LEGACY_OBJ, buffer));
+
+    struct {
+        uint64_t tableId;
+        uint16_t keyLength;
+        uint64_t segmentId;
+        uint64_t objectVersion;
+        uint32_t timestamp;
+        uint32_t checksum;
+    } __attribute__((__packed__)) tombHeader = {1, 1, 88, 9, 8, 0};
+    Crc32C crc;
+    crc.update(&tombHeader, sizeof32(tombHeader) - 4);
+    crc.update("1", 1);
+    tombHeader.checksum = crc.getResult();
+    buffer.reset();
+    buffer.append(&tombHeader, sizeof32(tombHeader));
+    buffer.append("1", 1);
+    ASSERT_TRUE(segment->append(LOG_ENTRY_TYPE_LEGACY_OBJTOMB, buffer));
+
+    Segment::Certificate certificate;
+    uint32_t length = segment->getAppendedLength(&certificate);
+    char buf[serverConfig.segmentSize];
+    ASSERT_TRUE(segment->copyOut(0, buf, length));
+    std::unique_ptr<Segment[]> recoverySegments(new Segment[2]);
+    RecoverySegmentBuilder::build(buf, length, certificate, partitions,
+                                  recoverySegments.get());
+
+    // Both entries were converted and placed in partition 1.
+    SegmentIterator it(recoverySegments[1]);
+    while (!it.isDone() && it.getType() == LOG_ENTRY_TYPE_SAFEVERSION)
+        it.next();
+    ASSERT_FALSE(it.isDone());
+    EXPECT_EQ(LOG_ENTRY_TYPE_OBJ, it.getType());
+    Buffer entry;
+    it.appendToBuffer(entry);
+    Object object(entry);
+    EXPECT_TRUE(object.checkIntegrity());
+    EXPECT_EQ(Key::getHash(1, "1", 1), object.getKeyHash());
+    EXPECT_EQ(9U, object.getVersion());
+    EXPECT_EQ(7U, object.getTimestamp());
+    EXPECT_EQ("hello", string(reinterpret_cast<const char*>(
+        object.getData()), object.getDataLength()));
+
+    it.next();
+    ASSERT_FALSE(it.isDone());
+    EXPECT_EQ(LOG_ENTRY_TYPE_OBJTOMB, it.getType());
+    entry.reset();
+    it.appendToBuffer(entry);
+    ObjectTombstone tombstone(entry);
+    EXPECT_TRUE(tombstone.checkIntegrity());
+    EXPECT_EQ(Key::getHash(1, "1", 1), tombstone.getKeyHash());
+    EXPECT_EQ(88U, tombstone.getSegmentId());
+    EXPECT_EQ(9U, tombstone.getObjectVersion());
+    EXPECT_EQ(8U, tombstone.getTimestamp());
+    it.next();
+    EXPECT_TRUE(it.isDone());
+}
+
+TEST_F(RecoverySegmentBuilderTest, build_legacyEntryBadChecksum) {
+    LogSegment* segment = segmentManager.allocHeadSegment();
+    Buffer buffer;
+    appendLegacyObject(buffer, 1, "1", "hello", 9);
+    Buffer corrupt;
+    corrupt.append(buffer.getRange(0, buffer.getTotalLength() - 5),
+                   buffer.getTotalLength() - 5);
+    corrupt.append("jello", 5);
+    ASSERT_TRUE(segment->append(LOG_ENTRY_TYPE_LEGACY_OBJ, corrupt));
+
+    Segment::Certificate certificate;
+    uint32_t length = segment->getAppendedLength(&certificate);
+    char buf[serverConfig.segmentSize];
+    ASSERT_TRUE(segment->copyOut(0, buf, length));
+    std::unique_ptr<Segment[]> recoverySegments(new Segment[2]);
+    EXPECT_THROW(RecoverySegmentBuilder::build(buf, length, certificate,
+                                               partitions,
+                                               recoverySegments.get()),
+                 SegmentRecoveryFailedException);
+}
+
 TEST_F(RecoverySegmentBuilderTest, extractDigest) {
     auto extractDigest = RecoverySegmentBuilder::extractDigest;
     LogSegment* segment = segmentManager.allocHeadSegment();
@@ -128,13 +238,20 @@ TEST_F(RecoverySegmentBuilderTest, extractDigest) {
     ASSERT_TRUE(segment->copyOut(0, buffer, length));
     Buffer digestBuffer;
     EXPECT_TRUE(extractDigest(buffer, sizeof32(buffer),
-                              certificate, &digestBuffer));
+                              certificate, &digestBuffer, NULL));
     EXPECT_NE(0u, digestBuffer.getTotalLength());
 
+    // The head also holds the table stats.
+    Buffer tableStatsBuffer;
+    EXPECT_TRUE(extractDigest(buffer, sizeof32(buffer),
+                              certificate, &digestBuffer, &tableStatsBuffer));
+    EXPECT_EQ(sizeof32(TableStats::DigestHeader),
+              tableStatsBuffer.getTotalLength());
+
     // Corrupt metadata.
     certificate.checksum = 0;
     EXPECT_FALSE(extractDigest(buffer, sizeof32(buffer),
-                              certificate, &digestBuffer));
+                              certificate, &digestBuffer, NULL));
     // Should have left previously found digest in the buffer.
     EXPECT_NE(0u, digestBuffer.getTotalLength());
 
@@ -143,12 +260,12 @@ TEST_F(RecoverySegmentBuilderTest, extractDigest) {
 
     // No digest.
     EXPECT_FALSE(extractDigest(buffer, sizeof32(buffer),
-                              certificate, &digestBuffer));
+                              certificate, &digestBuffer, NULL));
     // Should have left previously found digest in the buffer.
     EXPECT_NE(0u, digestBuffer.getTotalLength());
     digestBuffer.reset();
     EXPECT_FALSE(extractDigest(buffer, sizeof32(buffer),
-                              certificate, &digestBuffer));
+                              certificate, &digestBuffer, NULL));
     EXPECT_EQ(0u, digestBuffer.getTotalLength());
 }
 
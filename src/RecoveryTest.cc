@@ -14,6 +14,7 @@
  */
 
 #include "TestUtil.h"
+#include "LogCabinHelper.h"
 #include "Recovery.h"
 #include "ShortMacros.h"
 #include "TabletsBuilder.h"
@@ -101,6 +102,34 @@ populateLogDigest(StartReadingDataRpc::Result& result,
         std::unique_ptr<char[]>(new char[result.logDigestBytes]);
     buffer.copy(0, buffer.getTotalLength(), result.logDigestBuffer.get());
 }
+
+/**
+ * Helper for filling-in the table stats in a startReadingData result.
+ *
+ * \param[out] result
+ *      Result whose table stats should be filled in.
+ * \param otherByteCount
+ *      Bytes belonging to tables not listed separately.
+ * \param entries
+ *      (tableId, byteCount) for each table to list separately.
+ */
+void
+populateTableStats(StartReadingDataRpc::Result& result,
+                   uint64_t otherByteCount,
+                   std::vector<std::pair<uint64_t, uint64_t>> entries)
+{
+    Buffer buffer;
+    new(&buffer, APPEND) TableStats::DigestHeader(
+        {otherByteCount, 0, entries.size()});
+    foreach (const auto& entry, entries) {
+        new(&buffer, APPEND) TableStats::DigestEntry(
+            {entry.first, entry.second, 0});
+    }
+    result.tabletMetricsLen = buffer.getTotalLength();
+    result.tabletMetricsBuffer =
+        std::unique_ptr<char[]>(new char[result.tabletMetricsLen]);
+    buffer.copy(0, buffer.getTotalLength(), result.tabletMetricsBuffer.get());
+}
 } // namespace
 
 TEST_F(RecoveryTest, partitionTablets) {
@@ -132,6 +161,61 @@ TEST_F(RecoveryTest, partitionTablets) {
     EXPECT_EQ(3lu, recovery->numPartitions);
 }
 
+TEST_F(RecoveryTest, partitionTablets_tableStats) {
+    // Splitting tablets needs somewhere to log the new tablet map.
+    LogCabin::Client::Cluster logCabinCluster(
+        LogCabin::Client::Cluster::FOR_TESTING);
+    LogCabin::Client::Log logCabinLog(logCabinCluster.openLog("coordinator"));
+    LogCabinHelper logCabinHelper(logCabinLog);
+    LogCabin::Client::EntryId expectedEntryId = LogCabin::Client::NO_ID;
+    context.logCabinHelper = &logCabinHelper;
+    context.expectedEntryId = &expectedEntryId;
+
+    addServersToTracker(3, {WireFormat::MASTER_SERVICE});
+    Lock lock(mutex);     // To trick TableManager internal calls.
+    tableManager.tables["big"] = 123;
+    tableManager.tablesLogIds[123] = {0, 0};
+    tableManager.addTablet(
+        lock, {123, 0, ~0lu, {99, 0}, Tablet::RECOVERING, {}});
+    tableManager.addTablet(
+        lock, {124, 0, ~0lu, {99, 0}, Tablet::RECOVERING, {}});
+
+    Tub<BackupStartTask> task;
+    Recovery recovery(&context, taskQueue, &tableManager, &tracker, NULL,
+                      {99, 0}, recoveryInfo);
+    task.construct(&recovery, ServerId(2, 0));
+    populateTableStats(task->result, 100, {{123, 250}});
+    const TableStats::Digest* stats = reinterpret_cast<TableStats::Digest*>(
+        task->result.tabletMetricsBuffer.get());
+
+    // Without a partition size each tablet gets its own partition.
+    recovery.partitionTablets(
+        tableManager.markAllTabletsRecovering({99, 0}), stats);
+    EXPECT_EQ(2u, recovery.numPartitions);
+
+    // Table 123 gets split into 3 pieces of about 83 bytes. Table 124
+    // fills the first partition, and the 3 pieces go into the other two
+    // since there are only 3 masters.
+    recovery.tabletsToRecover.clear_tablet();
+    recovery.numPartitions = 0;
+    recovery.maxBytesPerPartition = 100;
+    recovery.partitionTablets(
+        tableManager.markAllTabletsRecovering({99, 0}), stats);
+    EXPECT_EQ(3u, recovery.numPartitions);
+    ASSERT_EQ(4, recovery.tabletsToRecover.tablet_size());
+    EXPECT_EQ(4u, tableManager.markAllTabletsRecovering({99, 0}).size());
+    uint32_t tabletsPerPartition[3] = {0, 0, 0};
+    foreach (const auto& tablet, recovery.tabletsToRecover.tablet()) {
+        ASSERT_GT(3u, tablet.user_data());
+        tabletsPerPartition[tablet.user_data()]++;
+    }
+    EXPECT_EQ(1u, tabletsPerPartition[0]);
+    EXPECT_EQ(2u, tabletsPerPartition[1]);
+    EXPECT_EQ(1u, tabletsPerPartition[2]);
+    EXPECT_EQ(124u, recovery.tabletsToRecover.tablet(0).table_id());
+    EXPECT_EQ(0u, recovery.tabletsToRecover.tablet(0).user_data());
+}
+
 TEST_F(RecoveryTest, startBackups) {
     /**
      * Called by BackupStartTask instead of sending the startReadingData
@@ -386,6 +470,32 @@ TEST_F(RecoveryTest, findLogDigest) {
     EXPECT_EQ(1u, digest->second[0]);
 }
 
+TEST_F(RecoveryTest, findTableStats) {
+    Tub<BackupStartTask> tasks[2];
+    Recovery recovery(&context, taskQueue, &tableManager, &tracker, NULL,
+            {1, 0}, recoveryInfo);
+    tasks[0].construct(&recovery, ServerId(2, 0));
+    tasks[1].construct(&recovery, ServerId(3, 0));
+    EXPECT_TRUE(findTableStats(tasks, 2, 10) == NULL);
+
+    // Stats from a replica other than the head are ignored.
+    auto& result0 = tasks[0]->result;
+    auto& result1 = tasks[1]->result;
+    populateLogDigest(result0, 9, {9});
+    populateTableStats(result0, 1, {});
+    populateLogDigest(result1, 10, {9, 10});
+    populateTableStats(result1, 2, {{5, 100}});
+    const TableStats::Digest* stats = findTableStats(tasks, 2, 10);
+    ASSERT_TRUE(stats != NULL);
+    EXPECT_EQ(2u, stats->header.otherByteCount);
+    EXPECT_EQ(1u, stats->header.entryCount);
+    EXPECT_EQ(5u, stats->entries[0].tableId);
+
+    // Truncated stats are ignored.
+    result1.tabletMetricsLen--;
+    EXPECT_TRUE(findTableStats(tasks, 2, 10) == NULL);
+}
+
 TEST_F(RecoveryTest, buildReplicaMap) {
     Tub<BackupStartTask> tasks[2];
     Recovery recovery(&context, taskQueue, &tableManager, &tracker, NULL,
@@ -204,7 +204,7 @@ struct ReplicatedSegmentTest : public ::testing::Test {
     }
 
     void reset() {
-        taskQueue.tasks.pop();
+        taskQueue.getNextTask(false);
         segment->scheduled = false;
     }
 
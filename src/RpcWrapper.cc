@@ -119,6 +119,32 @@ RpcWrapper::failed() {
     state = FAILED;
 }
 
+/**
+ * Decide how long to wait before retrying an RPC whose response had
+ * STATUS_RETRY. If the server suggested a range of delays (for example, a
+ * master that is out of log space and knows roughly how long its cleaner
+ * will take to free some), a random delay in that range is used, so that
+ * clients turned away together don't all return together. Otherwise the
+ * wrapper's default, #usBetweenRetry, is used.
+ *
+ * \return
+ *      The delay before retrying, in microseconds.
+ */
+uint64_t
+RpcWrapper::getRetryDelay()
+{
+    const WireFormat::RetryResponse* retryResponse =
+        response->getStart<WireFormat::RetryResponse>();
+    if (retryResponse == NULL || retryResponse->maxDelayMicros == 0)
+        return usBetweenRetry;
+
+    uint64_t delay = retryResponse->minDelayMicros;
+    if (retryResponse->maxDelayMicros > retryResponse->minDelayMicros) {
+        delay += generateRandom() % (retryResponse->maxDelayMicros -
+                                     retryResponse->minDelayMicros + 1);
+    }
+    return delay;
+}
 
 /**
  * This method is implemented in RpcWrapper subclasses; it is invoked
@@ -189,7 +215,7 @@ RpcWrapper::isReady() {
             LOG(DEBUG, "Server %s returned STATUS_RETRY from %s request",
                     session->getServiceLocator().c_str(),
                     WireFormat::opcodeSymbol(&request));
-            retry(usBetweenRetry);
+            retry(getRetryDelay());
             return false;
         }
 
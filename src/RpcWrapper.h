@@ -188,6 +188,7 @@ class RpcWrapper : public Transport::RpcNotifier {
         return result;
     }
 
+    uint64_t getRetryDelay();
     virtual bool handleTransportError();
     void retry(uint64_t microseconds);
     virtual void send();
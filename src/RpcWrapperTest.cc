@@ -148,6 +148,35 @@ TEST_F(RpcWrapperTest, isReady_retryStatus) {
     EXPECT_STREQ("RETRY", wrapper.stateString());
 }
 
+TEST_F(RpcWrapperTest, getRetryDelay) {
+    RpcWrapper wrapper(4);
+    wrapper.usBetweenRetry = 77;
+
+    // Plain status: use the default.
+    setStatus(wrapper.response, Status::STATUS_RETRY);
+    EXPECT_EQ(77U, wrapper.getRetryDelay());
+
+    // Server has no opinion.
+    wrapper.response->reset();
+    WireFormat::RetryResponse* response =
+        new(wrapper.response, APPEND) WireFormat::RetryResponse;
+    response->common.status = STATUS_RETRY;
+    response->minDelayMicros = 0;
+    response->maxDelayMicros = 0;
+    EXPECT_EQ(77U, wrapper.getRetryDelay());
+
+    response->minDelayMicros = 500;
+    response->maxDelayMicros = 500;
+    EXPECT_EQ(500U, wrapper.getRetryDelay());
+
+    response->maxDelayMicros = 600;
+    for (int i = 0; i < 20; i++) {
+        uint64_t delay = wrapper.getRetryDelay();
+        EXPECT_LE(500U, delay);
+        EXPECT_GE(600U, delay);
+    }
+}
+
 TEST_F(RpcWrapperTest, isReady_callCheckStatus) {
     TestLog::Enable _;
     LogRpcWrapper wrapper(4);
@@ -69,6 +69,37 @@ struct Parser<std::queue<T>> : public RuntimeOptions::Parseable {
 
 };
 
+/**
+ * Specialization which parses a single unsigned integer, such as "1000".
+ * If the string cannot be parsed then the field is left unchanged.
+ */
+template <>
+struct Parser<uint64_t> : public RuntimeOptions::Parseable {
+    explicit Parser(uint64_t& target)
+        : target(target), optionValue(format("%lu", target))
+    {}
+
+    void
+    parse(const char* value)
+    {
+        std::istringstream iss(value);
+        uint64_t parsed;
+        if (!(iss >> parsed))
+            return;
+        target = parsed;
+        optionValue = value;
+    }
+    std::string
+    getValue()
+    {
+        return optionValue;
+    }
+
+    uint64_t& target;
+    // A copy of the value string is saved in optionValue.
+    std::string optionValue;
+};
+
 /**
  * Parser for coordinator crash point run time options.
  * An option is just a string in this case and currently,
@@ -130,9 +161,11 @@ RuntimeOptions::RuntimeOptions()
     , mutex()
     , failRecoveryMasters()
     , crashCoordinator()
+    , maxBytesPerPartition(500lu * 1024 * 1024)
 {
 #define REGISTER(field) registerOption(#field, newParser(field))
     REGISTER(failRecoveryMasters);
+    REGISTER(maxBytesPerPartition);
 #undef REGISTER
     registerOption("crashCoordinator",
             newcrashCoordParser(crashCoordinator));
@@ -199,6 +232,16 @@ RuntimeOptions::popFailRecoveryMasters()
     return result;
 }
 
+/**
+ * Return the current value of #maxBytesPerPartition.
+ */
+uint64_t
+RuntimeOptions::getMaxBytesPerPartition()
+{
+    Lock _(mutex);
+    return maxBytesPerPartition;
+}
+
 /**
  * Check if the argument matches the currently active crash point
  * and kills the coordinator if necessary
@@ -44,6 +44,7 @@ class RuntimeOptions {
         void set(const char* option, const char* value);
         std::string get(const char* option);
         uint32_t popFailRecoveryMasters();
+        uint64_t getMaxBytesPerPartition();
         void checkAndCrashCoordinator(const char *crashPoint);
 
     PRIVATE:
@@ -94,6 +95,15 @@ class RuntimeOptions {
          */
         std::string crashCoordinator;
 
+        /**
+         * When a master crashes, its tablets are grouped (and, if
+         * necessary, split) into partitions holding about this many bytes
+         * of live data each, based on the table stats in its log, so that
+         * each recovery master has a similar amount of work. Zero means
+         * that each tablet is recovered as its own partition.
+         */
+        uint64_t maxBytesPerPartition;
+
     DISALLOW_COPY_AND_ASSIGN(RuntimeOptions);
 };
 
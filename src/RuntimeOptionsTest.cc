@@ -45,6 +45,13 @@ TEST_F(RuntimeOptionsTest, set) {
     ASSERT_EQ(0u, options.failRecoveryMasters.size());
     options.set("failRecoveryMasters", "1 foo 2 other 3");
     ASSERT_EQ(1u, options.failRecoveryMasters.size());
+
+    // Check uint64_t parser.
+    options.set("maxBytesPerPartition", "1000");
+    EXPECT_EQ(1000u, options.getMaxBytesPerPartition());
+    options.set("maxBytesPerPartition", "foo");
+    EXPECT_EQ(1000u, options.getMaxBytesPerPartition());
+    EXPECT_STREQ("1000", options.get("maxBytesPerPartition").c_str());
 }
 
 TEST_F(RuntimeOptionsTest, get){
@@ -55,6 +62,7 @@ TEST_F(RuntimeOptionsTest, get){
     ASSERT_STREQ("1 2 3", options.get("failRecoveryMasters").c_str());
     options.set("failRecoveryMasters", "black 1 white 2");
     ASSERT_STREQ("black 1 white 2", options.get("failRecoveryMasters").c_str());
+    ASSERT_STREQ("524288000", options.get("maxBytesPerPartition").c_str());
 }
 
 TEST_F(RuntimeOptionsTest, popFailRecoveryMasters) {
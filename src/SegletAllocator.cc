@@ -38,6 +38,7 @@ SegletAllocator::SegletAllocator(const ServerConfig* config)
       cleanerPool(),
       cleanerPoolReserve(0),
       defaultPool(),
+      defaultSegletsAllocated(0),
       block(config->master.logBytes)
 {
     uint8_t* segletBlock = block.get();
@@ -117,7 +118,10 @@ SegletAllocator::alloc(AllocationType type,
     if (type == CLEANER)
         return allocFromPool(cleanerPool, count, outSeglets);
 
-    return allocFromPool(defaultPool, count, outSeglets);
+    if (!allocFromPool(defaultPool, count, outSeglets))
+        return false;
+    defaultSegletsAllocated += count;
+    return true;
 }
 
 /**
@@ -280,6 +284,18 @@ SegletAllocator::getBaseAddress()
     return block.get();
 }
 
+/**
+ * Return the total number of seglets that have ever been allocated from the
+ * default pool (that is, for regular log heads and side logs rather than for
+ * the cleaner or emergency heads).
+ */
+uint64_t
+SegletAllocator::getDefaultSegletsAllocated()
+{
+    std::lock_guard<SpinLock> guard(lock);
+    return defaultSegletsAllocated;
+}
+
 /**
  * Return the total number of bytes this allocator has for the log.
  */
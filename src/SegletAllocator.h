@@ -84,6 +84,7 @@ class SegletAllocator {
     const void* getBaseAddress();
     uint64_t getTotalBytes();
     int getMemoryUtilization();
+    uint64_t getDefaultSegletsAllocated();
 
 #if TESTING
     /// Allow the reported memory utilization (from getMemoryUtilization) to be
@@ -137,6 +138,10 @@ class SegletAllocator {
     /// Pool holding all other seglets not otherwise reserved.
     vector<Seglet*> defaultPool;
 
+    /// Total number of seglets ever allocated from the defaultPool. The log
+    /// cleaner samples this to estimate how fast appends consume memory.
+    uint64_t defaultSegletsAllocated;
+
     /// Single contiguous block of memory backing all of our seglets.
     LargeBlockOfMemory<uint8_t> block;
 
@@ -74,9 +74,13 @@ TEST_F(SegletAllocatorTest, alloc) {
     EXPECT_EQ(0U, allocator.cleanerPool.size());
     EXPECT_FALSE(allocator.alloc(SegletAllocator::CLEANER, 1, seglets));
 
+    EXPECT_EQ(0U, allocator.getDefaultSegletsAllocated());
     EXPECT_EQ(254U, allocator.defaultPool.size());
+    EXPECT_FALSE(allocator.alloc(SegletAllocator::DEFAULT, 255, seglets));
+    EXPECT_EQ(0U, allocator.getDefaultSegletsAllocated());
     EXPECT_TRUE(allocator.alloc(SegletAllocator::DEFAULT, 254, seglets));
     EXPECT_EQ(0U, allocator.cleanerPool.size());
+    EXPECT_EQ(254U, allocator.getDefaultSegletsAllocated());
 
     foreach (Seglet* s, seglets)
         s->free();
@@ -34,6 +34,7 @@ Segment::Segment()
       segletBlocks(),
       closed(false),
       mustFreeBlocks(true),
+      compactObjects(false),
       head(0),
       checksum(),
       entryCounts(),
@@ -54,10 +55,15 @@ Segment::Segment(vector<Seglet*>& seglets, uint32_t segletSize)
       segletBlocks(),
       closed(false),
       mustFreeBlocks(false),
+      compactObjects(false),
       head(0),
-      checksum()
+      checksum(),
+      entryCounts(),
+      entryLengths()
 {
     assert(BitOps::isPowerOfTwo(segletSize));
+    memset(entryCounts, 0, sizeof(entryCounts));
+    memset(entryLengths, 0, sizeof(entryLengths));
     foreach (Seglet* seglet, seglets) {
         segletBlocks.push_back(seglet->get());
         assert(seglet->getLength() == segletSize);
@@ -84,6 +90,7 @@ Segment::Segment(const void* buffer, uint32_t length)
       segletBlocks(),
       closed(true),
       mustFreeBlocks(false),
+      compactObjects(false),
       head(length),
       checksum()
 {
@@ -163,35 +170,27 @@ Segment::append(LogEntryType type,
                 uint32_t length,
                 uint32_t* outOffset)
 {
-    EntryHeader entryHeader(type, length);
+    if (compactObjects && type == LOG_ENTRY_TYPE_OBJ &&
+            length >= sizeof32(Object::SerializedForm)) {
+        uint8_t compactHeader[Object::MAX_COMPACT_HEADER_LENGTH];
+        uint32_t compactHeaderLength = Object::compactHeader(
+            *static_cast<const Object::SerializedForm*>(buffer),
+            compactHeader);
+        if (compactHeaderLength != 0) {
+            return appendCompactObject(compactHeader, compactHeaderLength,
+                                       buffer, NULL, length, outOffset);
+        }
+    }
 
     if (!hasSpaceFor(&length, 1))
         return false;
 
-    uint32_t startOffset = head;
-
-    copyIn(head, &entryHeader, sizeof(entryHeader));
-    checksum.update(&entryHeader, sizeof(entryHeader));
-    head += sizeof32(entryHeader);
-
-    // Note that this assumes a little-endian byte order. I think this is
-    // justified considering how widely we have assume byte order (if not
-    // x86 in particular).
-    copyIn(head, &length, entryHeader.getLengthBytes());
-    checksum.update(&length, entryHeader.getLengthBytes());
-    head += entryHeader.getLengthBytes();
-
+    uint32_t startOffset = appendEntryHeader(type, length);
     copyIn(head, buffer, length);
     head += length;
 
     if (outOffset != NULL)
         *outOffset = startOffset;
-
-    entryCounts[type]++;
-    entryLengths[type] += length +
-                          downCast<uint32_t>(sizeof(entryHeader)) +
-                          entryHeader.getLengthBytes();
-
     return true;
 }
 
@@ -199,6 +198,10 @@ Segment::append(LogEntryType type,
  * Append a typed entry to this segment. Entries are binary blobs. The segment
  * records metadata identifying their type and length.
  *
+ * The buffer's chunks are copied directly into the segment, so appending a
+ * discontiguous buffer (for example, an object's header, key, and value) does
+ * not require flattening it into a temporary copy first.
+ *
  * \param type
  *      Type of the entry. See LogEntryTypes.h.
  * \param buffer
@@ -206,7 +209,8 @@ Segment::append(LogEntryType type,
  * \param[out] outOffset
  *      If the append was successful, the segment offset of the new entry is
  *      returned here. This is used to address the entry within the segment.
- * \return
+ * 
+eturn
  *      True if the append succeeded, false if there was insufficient space to
  *      complete the operation.
  */
@@ -216,7 +220,27 @@ Segment::append(LogEntryType type,
                 uint32_t* outOffset)
 {
     uint32_t length = buffer.getTotalLength();
-    return append(type, buffer.getRange(0, length), length, outOffset);
+    if (compactObjects && type == LOG_ENTRY_TYPE_OBJ &&
+            length >= sizeof32(Object::SerializedForm)) {
+        uint8_t compactHeader[Object::MAX_COMPACT_HEADER_LENGTH];
+        uint32_t compactHeaderLength = Object::compactHeader(
+            *buffer.getStart<Object::SerializedForm>(), compactHeader);
+        if (compactHeaderLength != 0) {
+            return appendCompactObject(compactHeader, compactHeaderLength,
+                                       NULL, &buffer, length, outOffset);
+        }
+    }
+
+    if (!hasSpaceFor(&length, 1))
+        return false;
+
+    uint32_t startOffset = appendEntryHeader(type, length);
+    copyInFromBuffer(head, buffer, 0, length);
+    head += length;
+
+    if (outOffset != NULL)
+        *outOffset = startOffset;
+    return true;
 }
 
 /**
@@ -303,6 +327,11 @@ Segment::appendToBuffer(Buffer& buffer)
  *      segment.
  * \return
  *      The entry's type as specified when it was appended (LogEntryType).
+ *      Objects stored with compact headers are returned in their full form
+ *      (see setCompactObjects), so callers always see LOG_ENTRY_TYPE_OBJ for
+ *      objects.
+ * \throw SegmentException
+ *      If the entry is an object whose compact header is corrupt.
  */
 LogEntryType
 Segment::getEntry(uint32_t offset, Buffer& buffer, uint32_t* lengthWithMetadata)
@@ -316,13 +345,30 @@ Segment::getEntry(uint32_t offset, Buffer& buffer, uint32_t* lengthWithMetadata)
     copyOut(offset + sizeof32(header), &entryDataLength,
         header.getLengthBytes());
 
-    appendToBuffer(buffer, entryDataOffset, entryDataLength);
+    LogEntryType type = header.getType();
+    if (type == LOG_ENTRY_TYPE_COMPACT_OBJ) {
+        Object::SerializedForm objectHeader(0, 0, 0, 0, 0);
+        uint32_t compactHeaderLength = expandObjectHeader(entryDataOffset,
+            entryDataLength, &objectHeader);
+        if (compactHeaderLength == 0) {
+            throw SegmentException(HERE, format(
+                "corrupt compact object header at offset %u", offset));
+        }
+        memcpy(new(&buffer, APPEND) char[sizeof(objectHeader)],
+               &objectHeader, sizeof(objectHeader));
+        appendToBuffer(buffer, entryDataOffset + compactHeaderLength,
+                       entryDataLength - compactHeaderLength);
+        type = LOG_ENTRY_TYPE_OBJ;
+    } else {
+        appendToBuffer(buffer, entryDataOffset, entryDataLength);
+    }
+
     if (lengthWithMetadata != NULL) {
         *lengthWithMetadata = entryDataLength +
                               sizeof32(header) +
                               header.getLengthBytes();
     }
-    return header.getType();
+    return type;
 }
 
 /**
@@ -550,6 +596,27 @@ Segment::copyOut(uint32_t offset, void* buffer, uint32_t length) const
     return initialLength - length;
 }
 
+/**
+ * Choose whether objects appended to this segment from now on are stored
+ * with compact headers. A compact header encodes the table identifier, key
+ * length, version, and secondary keys length as variable-length integers
+ * (see Object::compactHeader), which saves about 15 bytes per object; this
+ * matters most for small objects, whose headers otherwise take up a large
+ * fraction of the log.
+ *
+ * The encoding is private to the segment: getEntry and SegmentIterator
+ * return such objects with their usual SerializedForm header, so the rest
+ * of the system never sees the difference. Each compact header stands on
+ * its own, so entries can be copied between compact and non-compact
+ * segments (for example, by the cleaner or during recovery) without any
+ * per-segment state.
+ */
+void
+Segment::setCompactObjects(bool enabled)
+{
+    compactObjects = enabled;
+}
+
 /******************************************************************************
  * PRIVATE METHODS
  ******************************************************************************/
@@ -576,6 +643,124 @@ Segment::getEntryHeader(uint32_t offset)
     return *header;
 }
 
+/**
+ * Write the header and length of a new entry at the current head of the
+ * segment and update the entry statistics. The caller must already have
+ * ensured that there is space for the entire entry, and must copy in the
+ * entry's contents immediately afterwards.
+ *
+ * \param type
+ *      Type of the entry. See LogEntryTypes.h.
+ * \param length
+ *      Length of the entry's contents in bytes.
+ * \return
+ *      The segment offset of the new entry.
+ */
+uint32_t
+Segment::appendEntryHeader(LogEntryType type, uint32_t length)
+{
+    EntryHeader entryHeader(type, length);
+    uint32_t startOffset = head;
+
+    copyIn(head, &entryHeader, sizeof(entryHeader));
+    checksum.update(&entryHeader, sizeof(entryHeader));
+    head += sizeof32(entryHeader);
+
+    // Note that this assumes a little-endian byte order. I think this is
+    // justified considering how widely we have assume byte order (if not
+    // x86 in particular).
+    copyIn(head, &length, entryHeader.getLengthBytes());
+    checksum.update(&length, entryHeader.getLengthBytes());
+    head += entryHeader.getLengthBytes();
+
+    // Compact objects are only a different encoding of objects, so they're
+    // accounted for as such.
+    if (type == LOG_ENTRY_TYPE_COMPACT_OBJ)
+        type = LOG_ENTRY_TYPE_OBJ;
+    entryCounts[type]++;
+    entryLengths[type] += length +
+                          downCast<uint32_t>(sizeof(entryHeader)) +
+                          entryHeader.getLengthBytes();
+    return startOffset;
+}
+
+/**
+ * Append an object to the segment, storing its header in compact form (see
+ * setCompactObjects).
+ *
+ * \param compactHeader
+ *      The object's header, as encoded by Object::compactHeader.
+ * \param compactHeaderLength
+ *      Length of compactHeader in bytes.
+ * \param data
+ *      If non-NULL, the object in its full form (starting with its
+ *      SerializedForm header).
+ * \param buffer
+ *      If data is NULL, the Buffer containing the object in its full form.
+ * \param length
+ *      Length of the object in its full form.
+ * \param[out] outOffset
+ *      If the append was successful, the segment offset of the new entry is
+ *      returned here.
+ * \return
+ *      True if the append succeeded, false if there was insufficient space to
+ *      complete the operation.
+ */
+bool
+Segment::appendCompactObject(const uint8_t* compactHeader,
+                             uint32_t compactHeaderLength,
+                             const void* data,
+                             Buffer* buffer,
+                             uint32_t length,
+                             uint32_t* outOffset)
+{
+    uint32_t bodyLength = length - sizeof32(Object::SerializedForm);
+    uint32_t storedLength = compactHeaderLength + bodyLength;
+    if (!hasSpaceFor(&storedLength, 1))
+        return false;
+
+    uint32_t startOffset = appendEntryHeader(LOG_ENTRY_TYPE_COMPACT_OBJ,
+                                             storedLength);
+    copyIn(head, compactHeader, compactHeaderLength);
+    head += compactHeaderLength;
+    if (data != NULL) {
+        copyIn(head, static_cast<const uint8_t*>(data) +
+                     sizeof(Object::SerializedForm), bodyLength);
+    } else {
+        copyInFromBuffer(head, *buffer, sizeof32(Object::SerializedForm),
+                         bodyLength);
+    }
+    head += bodyLength;
+
+    if (outOffset != NULL)
+        *outOffset = startOffset;
+    return true;
+}
+
+/**
+ * Decode the compact header of an object stored in this segment.
+ *
+ * \param offset
+ *      Segment offset of the entry's contents (just past its EntryHeader and
+ *      length field).
+ * \param length
+ *      Length of the entry's contents, as stored in the segment.
+ * \param[out] header
+ *      The object's expanded header is written here.
+ * \return
+ *      The length of the compact header, or 0 if it is corrupt.
+ */
+uint32_t
+Segment::expandObjectHeader(uint32_t offset,
+                            uint32_t length,
+                            Object::SerializedForm* header) const
+{
+    uint8_t compactHeader[Object::MAX_COMPACT_HEADER_LENGTH];
+    uint32_t bytes = copyOut(offset, compactHeader,
+        std::min(length, Object::MAX_COMPACT_HEADER_LENGTH));
+    return Object::expandCompactHeader(compactHeader, bytes, header);
+}
+
 /**
  * Copy a contiguous buffer into the segment at the specified offset.
  *
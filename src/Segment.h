@@ -22,6 +22,7 @@
 #include "Buffer.h"
 #include "Crc32C.h"
 #include "LogEntryTypes.h"
+#include "Object.h"
 #include "Seglet.h"
 #include "SegletAllocator.h"
 #include "Tub.h"
@@ -284,6 +285,7 @@ class Segment {
     bool freeUnusedSeglets(uint32_t count);
     bool checkMetadataIntegrity(const Certificate& certificate);
     uint32_t copyOut(uint32_t offset, void* buffer, uint32_t length) const;
+    void setCompactObjects(bool enabled);
 
     /**
      * 'Peek' into the segment by specifying a logical byte offset and getting
@@ -328,6 +330,16 @@ class Segment {
 
   PRIVATE:
     EntryHeader getEntryHeader(uint32_t offset);
+    uint32_t appendEntryHeader(LogEntryType type, uint32_t length);
+    bool appendCompactObject(const uint8_t* compactHeader,
+                             uint32_t compactHeaderLength,
+                             const void* data,
+                             Buffer* buffer,
+                             uint32_t length,
+                             uint32_t* outOffset);
+    uint32_t expandObjectHeader(uint32_t offset,
+                                uint32_t length,
+                                Object::SerializedForm* header) const;
     uint32_t copyIn(uint32_t offset, const void* buffer, uint32_t length);
     uint32_t copyInFromBuffer(uint32_t segmentOffset,
                               Buffer& buffer,
@@ -375,6 +387,10 @@ class Segment {
     /// destructor must free that space.
     bool mustFreeBlocks;
 
+    /// If true, objects appended to this segment are stored with compact
+    /// headers (see setCompactObjects()).
+    bool compactObjects;
+
     /// Offset to the next free byte in Segment.
     uint32_t head;
 
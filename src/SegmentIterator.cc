@@ -144,9 +144,12 @@ SegmentIterator::next()
     if (isDone())
         return;
 
+    uint32_t storedLength = getLength();
+    if (expect_false(currentHeader.getType() == LOG_ENTRY_TYPE_COMPACT_OBJ))
+        storedLength = getStoredLength();
     currentOffset += sizeof32(currentHeader) +
                      currentHeader.getLengthBytes() +
-                     getLength();
+                     storedLength;
 
     // Check again, since we may have just moved on from the last entry in the
     // segment.
@@ -161,16 +164,25 @@ SegmentIterator::next()
 /**
  * Return the type of the entry currently pointed to by the iterator.
  * If no entry is currently pointed to, returns LOG_ENTRY_TYPE_INVALID.
+ * Objects stored with compact headers are reported as LOG_ENTRY_TYPE_OBJ.
  */
 LogEntryType
 SegmentIterator::getType()
 {
-    return currentHeader.getType();
+    LogEntryType type = currentHeader.getType();
+    if (expect_false(type == LOG_ENTRY_TYPE_COMPACT_OBJ))
+        return LOG_ENTRY_TYPE_OBJ;
+    return type;
 }
 
 /**
  * Return the length of the entry currently pointed to by the iterator.
- * If no entry is currently pointed to, returns 0.
+ * If no entry is currently pointed to, returns 0. The length of an object
+ * stored with a compact header is that of its full form, as returned by
+ * appendToBuffer().
+ *
+ * 	hrow SegmentIteratorException
+ *      If the entry is an object whose compact header is corrupt.
  */
 uint32_t
 SegmentIterator::getLength()
@@ -179,10 +191,13 @@ SegmentIterator::getLength()
         return 0;
 
     if (!currentLength) {
-        uint32_t length = 0;
-        segment->copyOut(currentOffset + sizeof32(currentHeader),
-                         &length,
-                         currentHeader.getLengthBytes());
+        uint32_t length = getStoredLength();
+        if (expect_false(currentHeader.getType() ==
+                         LOG_ENTRY_TYPE_COMPACT_OBJ)) {
+            Object::SerializedForm header(0, 0, 0, 0, 0);
+            length = length - expandObjectHeader(&header) +
+                     sizeof32(header);
+        }
         currentLength.construct(length);
     }
     return *currentLength;
@@ -200,10 +215,13 @@ SegmentIterator::getOffset()
 }
 
 /**
- * Append the current entry to the provided buffer.
+ * Append the current entry to the provided buffer. An object stored with a
+ * compact header is appended in its full form.
  *
  * \return
  *      The number of bytes appended to the buffer.
+ * \throw SegmentIteratorException
+ *      If the entry is an object whose compact header is corrupt.
  */
 uint32_t
 SegmentIterator::appendToBuffer(Buffer& buffer)
@@ -211,6 +229,21 @@ SegmentIterator::appendToBuffer(Buffer& buffer)
     uint32_t entryOffset = currentOffset +
                            sizeof32(currentHeader) +
                            currentHeader.getLengthBytes();
+    if (expect_false(currentHeader.getType() == LOG_ENTRY_TYPE_COMPACT_OBJ)) {
+        Object::SerializedForm* header =
+            new(&buffer, APPEND) Object::SerializedForm(0, 0, 0, 0, 0);
+        uint32_t compactHeaderLength = expandObjectHeader(header);
+        uint32_t storedLength = getStoredLength();
+        segment->appendToBuffer(buffer, entryOffset + compactHeaderLength,
+                                storedLength - compactHeaderLength);
+
+        // Save getLength() from decoding the header again.
+        if (!currentLength) {
+            currentLength.construct(storedLength - compactHeaderLength +
+                                    sizeof32(*header));
+        }
+        return buffer.getTotalLength();
+    }
     segment->appendToBuffer(buffer, entryOffset, getLength());
     return buffer.getTotalLength();
 }
@@ -252,4 +285,67 @@ SegmentIterator::checkMetadataIntegrity()
         throw SegmentIteratorException(HERE, "cannot iterate: corrupt segment");
 }
 
+/**
+ * Return the number of bytes the current entry takes up in the segment,
+ * not counting its EntryHeader and length field. This differs from
+ * getLength() only for objects stored with compact headers.
+ */
+uint32_t
+SegmentIterator::getStoredLength()
+{
+    uint32_t length = 0;
+    segment->copyOut(currentOffset + sizeof32(currentHeader),
+                     &length,
+                     currentHeader.getLengthBytes());
+    return length;
+}
+
+/**
+ * Decode the compact header of the current entry, which must be of type
+ * LOG_ENTRY_TYPE_COMPACT_OBJ.
+ *
+ * \param[out] header
+ *      The object's expanded header is written here.
+ * \return
+ *      The length of the compact header within the segment.
+ * \throw SegmentIteratorException
+ *      If the compact header is corrupt.
+ */
+uint32_t
+SegmentIterator::expandObjectHeader(Object::SerializedForm* header)
+{
+    uint32_t entryOffset = currentOffset +
+                           sizeof32(currentHeader) +
+                           currentHeader.getLengthBytes();
+    uint32_t compactHeaderLength = segment->expandObjectHeader(entryOffset,
+        getStoredLength(), header);
+    if (compactHeaderLength == 0) {
+        throw SegmentIteratorException(HERE, format(
+            "corrupt compact object header at offset %u", currentOffset));
+    }
+    return compactHeaderLength;
+}
+
+/**
+ * Implements getContiguous() for objects stored with compact headers: the
+ * expanded header and as much of the rest of the object as fits are copied
+ * into the caller's buffer.
+ */
+const void*
+SegmentIterator::getContiguousCompactObject(void* buffer, uint32_t length)
+{
+    assert(buffer != NULL && length >= sizeof(Object::SerializedForm));
+    Object::SerializedForm* header =
+        static_cast<Object::SerializedForm*>(buffer);
+    uint32_t compactHeaderLength = expandObjectHeader(header);
+    uint32_t entryOffset = currentOffset +
+                           sizeof32(currentHeader) +
+                           currentHeader.getLengthBytes();
+    segment->copyOut(entryOffset + compactHeaderLength,
+                     header + 1,
+                     std::min(length - sizeof32(*header),
+                              getStoredLength() - compactHeaderLength));
+    return buffer;
+}
+
 } // namespace
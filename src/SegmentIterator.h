@@ -101,6 +101,10 @@ class SegmentIterator {
      *      ensure this is to allocate a single buffer the size of the segment
      *      being iterated over that can be passed into this method.
      *
+     *      Objects stored with compact headers (see
+     *      Segment::setCompactObjects) are always expanded into this buffer,
+     *      so it must be provided when iterating over such segments.
+     *
      *      If only the front of the entry will be accessed (for example, just
      *      the object header and key), a smaller length can be specified so
      *      that large objects are not copied in their entirety when not being
@@ -117,6 +121,11 @@ class SegmentIterator {
     {
         if (isDone())
             return NULL;
+        if (expect_false(currentHeader.getType() ==
+                         LOG_ENTRY_TYPE_COMPACT_OBJ)) {
+            return reinterpret_cast<const T*>(
+                getContiguousCompactObject(buffer, length));
+        }
 
         uint32_t entryOffset = currentOffset +
                                sizeof32(currentHeader) +
@@ -135,6 +144,10 @@ class SegmentIterator {
     }
 
   PRIVATE:
+    uint32_t getStoredLength();
+    uint32_t expandObjectHeader(Object::SerializedForm* header);
+    const void* getContiguousCompactObject(void* buffer, uint32_t length);
+
     /// If the constructor was called on a void pointer, we'll create a wrapper
     /// segment to access the data in a common way using segment object calls.
     Tub<Segment> wrapperSegment;
@@ -167,8 +180,9 @@ class SegmentIterator {
     /// Copy of the current log entry's header (the one at currentOffset).
     Segment::EntryHeader currentHeader;
 
-    /// Cache of the length of the entry at currentOffset. Set the first time
-    /// getLength() is called and destroyed when next() is called.
+    /// Cache of the length of the entry at currentOffset, as returned by
+    /// getLength(). Set the first time getLength() is called and destroyed
+    /// when next() is called.
     Tub<uint32_t> currentLength;
 };
 
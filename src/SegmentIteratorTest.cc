@@ -18,6 +18,7 @@
 #include "Segment.h"
 #include "SegmentIterator.h"
 #include "LogEntryTypes.h"
+#include "Object.h"
 
 namespace RAMCloud {
 
@@ -203,4 +204,50 @@ TEST_F(SegmentIteratorTest, setBufferTo) {
     EXPECT_EQ(0, memcmp("this is the content", buffer.getRange(0, 20), 20));
 }
 
+TEST_F(SegmentIteratorTest, compactObject) {
+    s.setCompactObjects(true);
+    Key key(57, "key", 3);
+    Object object(key, "value", 5, 75, 723);
+    Buffer objectBuffer;
+    object.serializeToBuffer(objectBuffer);
+    uint32_t length = objectBuffer.getTotalLength();
+    const void* original = objectBuffer.getRange(0, length);
+    s.append(LOG_ENTRY_TYPE_OBJ, objectBuffer);
+    s.append(LOG_ENTRY_TYPE_OBJTOMB, "hihi", 5);
+
+    SegmentIterator it(s);
+    EXPECT_EQ(LOG_ENTRY_TYPE_OBJ, it.getType());
+    EXPECT_EQ(length, it.getLength());
+    EXPECT_EQ(length - 16, it.getStoredLength());
+
+    Buffer buffer;
+    it.appendToBuffer(buffer);
+    EXPECT_EQ(length, buffer.getTotalLength());
+    EXPECT_EQ(0, memcmp(original, buffer.getRange(0, length), length));
+
+    char copy[100];
+    const Object::SerializedForm* header =
+        it.getContiguous<Object::SerializedForm>(copy, sizeof32(copy));
+    EXPECT_EQ(static_cast<const void*>(copy), header);
+    EXPECT_EQ(0, memcmp(original, header, length));
+
+    it.next();
+    EXPECT_EQ(LOG_ENTRY_TYPE_OBJTOMB, it.getType());
+    EXPECT_EQ(5U, it.getLength());
+    it.next();
+    EXPECT_TRUE(it.isDone());
+}
+
+TEST_F(SegmentIteratorTest, compactObject_corrupt) {
+    uint8_t garbage[20];
+    memset(garbage, 0xff, sizeof(garbage));
+    s.append(LOG_ENTRY_TYPE_COMPACT_OBJ, garbage, sizeof32(garbage));
+
+    SegmentIterator it(s);
+    EXPECT_EQ(LOG_ENTRY_TYPE_OBJ, it.getType());
+    EXPECT_THROW(it.getLength(), SegmentIteratorException);
+    Buffer buffer;
+    EXPECT_THROW(it.appendToBuffer(buffer), SegmentIteratorException);
+}
+
 } // namespace RAMCloud
@@ -55,6 +55,7 @@ SegmentManager::SegmentManager(Context* context,
                                MasterTableMetadata* masterTableMetadata)
     : context(context),
       segmentSize(config->segmentSize),
+      compactObjectHeaders(config->master.compactObjectHeaders),
       logId(logId),
       allocator(allocator),
       replicaManager(replicaManager),
@@ -211,8 +212,7 @@ SegmentManager::allocHeadSegment(uint32_t flags)
     else
         writeDigest(newHead, NULL);
     writeSafeVersion(newHead);
-    //TODO(cstlee) added Tablet Stats block to segment;
-    //writeTableStatsDigest(newHead);
+    writeTableStatsDigest(newHead);
 
     // Make the head immutable if it's an emergency head. This will prevent the
     // log from adding anything to it and let us reclaim it without cleaning
@@ -654,7 +654,9 @@ SegmentManager::getSegmentUtilization()
  */
 uint64_t
 SegmentManager::allocateVersion() {
-    return safeVersion++;
+    // Called concurrently by every thread writing to the log, so this must
+    // be atomic; a plain increment could hand out the same version twice.
+    return safeVersion.fetch_add(1, std::memory_order_relaxed);
 }
 
 /**
@@ -666,9 +668,11 @@ SegmentManager::allocateVersion() {
  */
 bool
 SegmentManager::raiseSafeVersion(uint64_t minimum) {
-    if (minimum > safeVersion) {
-        safeVersion = minimum;
-        return true;
+    uint64_t current = safeVersion.load(std::memory_order_relaxed);
+    while (minimum > current) {
+        if (safeVersion.compare_exchange_weak(current, minimum,
+                                              std::memory_order_relaxed))
+            return true;
     }
     return false;
 }
@@ -877,7 +881,7 @@ SegmentManager::writeTableStatsDigest(LogSegment* head)
     Buffer buffer;
     TableStats::serialize(&buffer, masterTableMetadata);
 
-    bool success = head->append(LOG_ENTRY_TYPE_SAFEVERSION, buffer);
+    bool success = head->append(LOG_ENTRY_TYPE_TABLESTATS, buffer);
     if (!success) {
         throw FatalError(HERE,
                  format("Could not append TableStats of %u bytes "
@@ -974,6 +978,7 @@ SegmentManager::alloc(AllocPurpose purpose,
                              slot,
                              creationTimestamp,
                              (purpose == ALLOC_EMERGENCY_HEAD));
+    segments[slot]->setCompactObjects(compactObjectHeaders);
     states[slot] = state;
     idToSlotMap[segmentId] = slot;
 
@@ -16,6 +16,7 @@
 #ifndef RAMCLOUD_SEGMENTMANAGER_H
 #define RAMCLOUD_SEGMENTMANAGER_H
 
+#include <atomic>
 #include <stdint.h>
 #include <unordered_map>
 #include <vector>
@@ -268,6 +269,10 @@ class SegmentManager {
     /// Size of each full segment in bytes.
     const uint32_t segmentSize;
 
+    /// If true, segments store objects with compact headers (see
+    /// Segment::setCompactObjects).
+    const bool compactObjectHeaders;
+
     /// ServerId this log will be tagged with (for example, in SegmentHeader
     /// structures).
     const ServerId* logId;
@@ -406,8 +411,10 @@ class SegmentManager {
      * to the higher than any version number of the removed
      * object's version number. See #RaiseSafeVersion.
      *
+     *
+     * Writers allocate versions concurrently, so this is atomic.
      **/
-    uint64_t safeVersion;
+    std::atomic<uint64_t> safeVersion;
 
     DISALLOW_COPY_AND_ASSIGN(SegmentManager);
 };
@@ -13,6 +13,9 @@
  * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
  */
 
+#include <set>
+#include <thread>
+
 #include "TestUtil.h"
 
 #include "SegmentManager.h"
@@ -117,6 +120,10 @@ TEST_F(SegmentManagerTest, allocHead) {
     EXPECT_FALSE(it.isDone());
     EXPECT_EQ(LOG_ENTRY_TYPE_SAFEVERSION, it.getType());
 
+    it.next();
+    EXPECT_FALSE(it.isDone());
+    EXPECT_EQ(LOG_ENTRY_TYPE_TABLESTATS, it.getType());
+
     it.next();
     EXPECT_TRUE(it.isDone());
 
@@ -466,6 +473,18 @@ TEST_F(SegmentManagerTest, alloc_normal) {
     EXPECT_EQ(1U, segmentManager.segmentsByState[SegmentManager::HEAD].size());
 }
 
+TEST_F(SegmentManagerTest, alloc_compactObjectHeaders) {
+    LogSegment* s = segmentManager.alloc(SegmentManager::ALLOC_HEAD, 79, 0);
+    EXPECT_FALSE(s->compactObjects);
+
+    serverConfig.master.compactObjectHeaders = true;
+    SegletAllocator allocator2(&serverConfig);
+    SegmentManager sm(&context, &serverConfig, &serverId, allocator2,
+                      replicaManager, &masterTableMetadata);
+    s = sm.alloc(SegmentManager::ALLOC_HEAD, 80, 0);
+    EXPECT_TRUE(s->compactObjects);
+}
+
 TEST_F(SegmentManagerTest, alloc_emergencyHead) {
     SegmentManager* sm = &segmentManager;
     LogSegment* s = sm->alloc(SegmentManager::ALLOC_EMERGENCY_HEAD, 88, 94305);
@@ -589,6 +608,40 @@ TEST_F(SegmentManagerTest, removeFromLists) {
     segmentManager.addToLists(*s);
 }
 
+static void
+allocateVersions(SegmentManager* segmentManager, vector<uint64_t>* versions)
+{
+    for (size_t i = 0; i < versions->size(); i++)
+        (*versions)[i] = segmentManager->allocateVersion();
+}
+
+TEST_F(SegmentManagerTest, allocateVersion_concurrent) {
+    vector<uint64_t> versions[4];
+    std::thread* threads[4];
+    for (int i = 0; i < 4; i++) {
+        versions[i].resize(10000);
+        threads[i] = new std::thread(allocateVersions, &segmentManager,
+                                     &versions[i]);
+    }
+    std::set<uint64_t> allVersions;
+    for (int i = 0; i < 4; i++) {
+        threads[i]->join();
+        delete threads[i];
+        allVersions.insert(versions[i].begin(), versions[i].end());
+    }
+    EXPECT_EQ(40000U, allVersions.size());
+    EXPECT_EQ(1U, *allVersions.begin());
+    EXPECT_EQ(40000U, *allVersions.rbegin());
+    EXPECT_EQ(40001U, segmentManager.allocateVersion());
+}
+
+TEST_F(SegmentManagerTest, raiseSafeVersion) {
+    EXPECT_FALSE(segmentManager.raiseSafeVersion(1));
+    EXPECT_TRUE(segmentManager.raiseSafeVersion(10));
+    EXPECT_FALSE(segmentManager.raiseSafeVersion(5));
+    EXPECT_EQ(10U, segmentManager.allocateVersion());
+}
+
 // Need a do-nothing subclass of the abstract parent type.
 class TestServerRpc : public Transport::ServerRpc {
     void sendReply() {}
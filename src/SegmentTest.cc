@@ -19,6 +19,7 @@
 #include "StringUtil.h"
 #include "Log.h"
 #include "LogEntryTypes.h"
+#include "Object.h"
 #include "ServerConfig.h"
 
 namespace RAMCloud {
@@ -156,13 +157,40 @@ TEST_P(SegmentTest, append_whiteBox) {
     Segment::Certificate certificate;
     EXPECT_EQ(4U, s.getAppendedLength(&certificate));
     EXPECT_EQ(4u, certificate.segmentLength);
-    EXPECT_EQ(0x87a632e2u, certificate.checksum);
+    EXPECT_EQ(0xda636e8cu, certificate.checksum);
 
     Buffer buffer;
     s.appendToBuffer(buffer);
     EXPECT_EQ(0, memcmp("hi", buffer.getRange(2, 2), 2));
 }
 
+TEST_P(SegmentTest, append_discontiguousBuffer) {
+    SegmentAndAllocator segAndAlloc(GetParam());
+    Segment& s = *segAndAlloc.segment;
+
+    Buffer source;
+    source.append("abc", 3);
+    source.append("defgh", 5);
+    uint32_t offset;
+    EXPECT_TRUE(s.append(LOG_ENTRY_TYPE_OBJ, source, &offset));
+    EXPECT_EQ(0U, offset);
+
+    Buffer buffer;
+    EXPECT_EQ(LOG_ENTRY_TYPE_OBJ, s.getEntry(offset, buffer));
+    EXPECT_EQ("abcdefgh", TestUtil::toString(&buffer));
+
+    // The checksum covers only the entry header and length, so it must match
+    // that of the same entry appended from contiguous memory.
+    SegmentAndAllocator segAndAlloc2(GetParam());
+    Segment& s2 = *segAndAlloc2.segment;
+    s2.append(LOG_ENTRY_TYPE_OBJ, "abcdefgh", 8);
+    Segment::Certificate certificate, certificate2;
+    s.getAppendedLength(&certificate);
+    s2.getAppendedLength(&certificate2);
+    EXPECT_EQ(certificate2.segmentLength, certificate.segmentLength);
+    EXPECT_EQ(certificate2.checksum, certificate.checksum);
+}
+
 TEST_P(SegmentTest, append_differentLengthBytes) {
     uint32_t oneByteLengths[] = { 0, 255 };
     uint32_t twoByteLengths[] = { 256, 65535 };
@@ -249,6 +277,61 @@ TEST_P(SegmentTest, getEntry) {
         reinterpret_cast<const char*>(buffer.getRange(0, 21)));
 }
 
+TEST_P(SegmentTest, getEntry_compactObject) {
+    SegmentAndAllocator segAndAlloc(GetParam());
+    Segment& s = *segAndAlloc.segment;
+    s.setCompactObjects(true);
+
+    Key key(57, "key", 3);
+    Object object(key, "value", 5, 75, 723);
+    Buffer objectBuffer;
+    object.serializeToBuffer(objectBuffer);
+    uint32_t length = objectBuffer.getTotalLength();
+    const void* original = objectBuffer.getRange(0, length);
+
+    uint32_t offset, offset2;
+    EXPECT_TRUE(s.append(LOG_ENTRY_TYPE_OBJ, objectBuffer, &offset));
+    EXPECT_TRUE(s.append(LOG_ENTRY_TYPE_OBJ, original, length, &offset2));
+    EXPECT_TRUE(s.append(LOG_ENTRY_TYPE_OBJTOMB, "tomb", 4));
+    EXPECT_EQ(LOG_ENTRY_TYPE_COMPACT_OBJ, s.getEntryHeader(offset).getType());
+    EXPECT_EQ(2U, s.getEntryCount(LOG_ENTRY_TYPE_OBJ));
+    EXPECT_EQ(0U, s.getEntryCount(LOG_ENTRY_TYPE_COMPACT_OBJ));
+
+    // The header shrinks from 36 to 20 bytes.
+    uint32_t lengthWithMetadata;
+    Buffer buffer;
+    EXPECT_EQ(LOG_ENTRY_TYPE_OBJ, s.getEntry(offset, buffer,
+                                             &lengthWithMetadata));
+    EXPECT_EQ(length - 16 + 2, lengthWithMetadata);
+    EXPECT_EQ(offset2 - offset, lengthWithMetadata);
+    EXPECT_EQ(length, buffer.getTotalLength());
+    EXPECT_EQ(0, memcmp(original, buffer.getRange(0, length), length));
+    Object fromLog(buffer);
+    EXPECT_TRUE(fromLog.checkIntegrity());
+
+    buffer.reset();
+    EXPECT_EQ(LOG_ENTRY_TYPE_OBJ, s.getEntry(offset2, buffer));
+    EXPECT_EQ(0, memcmp(original, buffer.getRange(0, length), length));
+
+    // Other entries and undersized objects are stored as they are.
+    EXPECT_TRUE(s.append(LOG_ENTRY_TYPE_OBJ, "abc", 3, &offset));
+    buffer.reset();
+    EXPECT_EQ(LOG_ENTRY_TYPE_OBJ, s.getEntry(offset, buffer));
+    EXPECT_EQ("abc", TestUtil::toString(&buffer));
+}
+
+TEST_P(SegmentTest, getEntry_corruptCompactObject) {
+    SegmentAndAllocator segAndAlloc(GetParam());
+    Segment& s = *segAndAlloc.segment;
+    uint8_t garbage[20];
+    memset(garbage, 0xff, sizeof(garbage));
+    uint32_t offset;
+    s.append(LOG_ENTRY_TYPE_COMPACT_OBJ, garbage, sizeof32(garbage), &offset);
+
+    Buffer buffer;
+    EXPECT_THROW(s.getEntry(offset, buffer), SegmentException);
+}
+
 TEST_P(SegmentTest, getAppendedLength) {
     SegmentAndAllocator segAndAlloc(GetParam());
     Segment& s = *segAndAlloc.segment;
@@ -260,7 +343,7 @@ TEST_P(SegmentTest, getAppendedLength) {
     s.append(LOG_ENTRY_TYPE_OBJ, "yo!", 3);
     EXPECT_EQ(5lu, s.getAppendedLength(&certificate));
     EXPECT_EQ(5lu, certificate.segmentLength);
-    EXPECT_EQ(0x62f2f7f6u, certificate.checksum);
+    EXPECT_EQ(0x3f37ab98u, certificate.checksum);
 }
 
 TEST_P(SegmentTest, getSegletsAllocated) {
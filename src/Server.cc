@@ -85,6 +85,15 @@ Server::startForTesting(BindTransport& bindTransport)
 void
 Server::run()
 {
+    // This thread becomes the dispatch thread; also tell the ServiceManager
+    // where to put worker threads before services create them.
+    if (!config.dispatchCpus.empty()) {
+        LOG(NOTICE, "Pinning dispatch thread to core %u",
+            config.dispatchCpus[0]);
+        pinToCpu(config.dispatchCpus[0]);
+    }
+    context->serviceManager->setWorkerCpus(config.workerCpus);
+
     LOG(NOTICE, "Starting services");
     ServerId formerServerId = createAndRegisterServices(NULL);
     LOG(NOTICE, "Services started");
@@ -16,6 +16,7 @@
 #ifndef RAMCLOUD_SERVERCONFIG_H
 #define RAMCLOUD_SERVERCONFIG_H
 
+#include "CpuAffinity.h"
 #include "Log.h"
 #include "Seglet.h"
 #include "Segment.h"
@@ -62,6 +63,9 @@ struct ServerConfig {
         , segletSize(128 * 1024)
         , maxObjectDataSize(segmentSize / 4)
         , maxObjectKeySize((64 * 1024) - 1)
+        , dispatchCpus()
+        , workerCpus()
+        , cleanerCpus()
         , master(testing)
         , backup(testing)
     {}
@@ -84,6 +88,9 @@ struct ServerConfig {
         , segletSize(Seglet::DEFAULT_SEGLET_SIZE)
         , maxObjectDataSize(segmentSize / 8)
         , maxObjectKeySize((64 * 1024) - 1)
+        , dispatchCpus()
+        , workerCpus()
+        , cleanerCpus()
         , master()
         , backup()
     {}
@@ -132,6 +139,12 @@ struct ServerConfig {
         config.set_seglet_size(segletSize);
         config.set_max_object_data_size(maxObjectDataSize);
         config.set_max_object_key_size(maxObjectKeySize);
+        foreach (uint32_t cpu, dispatchCpus)
+            config.add_dispatch_cpus(cpu);
+        foreach (uint32_t cpu, workerCpus)
+            config.add_worker_cpus(cpu);
+        foreach (uint32_t cpu, cleanerCpus)
+            config.add_cleaner_cpus(cpu);
 
         if (services.has(WireFormat::MASTER_SERVICE))
             master.serialize(*config.mutable_master());
@@ -199,6 +212,18 @@ struct ServerConfig {
      */
     uint16_t maxObjectKeySize;
 
+    /**
+     * Cores on which the dispatch thread, ServiceManager worker threads,
+     * and log cleaner threads may run (threads of each kind are assigned
+     * to the cores of their list in round-robin order).  No two of the
+     * lists share a core or a pair of hyperthread siblings; see
+     * setCpuAffinity().  An empty list means the corresponding threads
+     * may run anywhere.
+     */
+    std::vector<uint32_t> dispatchCpus;
+    std::vector<uint32_t> workerCpus;           ///< See #dispatchCpus.
+    std::vector<uint32_t> cleanerCpus;          ///< See #dispatchCpus.
+
     /**
      * Configuration details specific to the MasterService on a server,
      * if any.  If !config.has(MASTER_SERVICE) then this field is ignored.
@@ -219,6 +244,7 @@ struct ServerConfig {
             , masterServiceThreadCount(1)
             , numReplicas(0)
             , useMinCopysets(false)
+            , compactObjectHeaders(false)
         {}
 
         /**
@@ -237,6 +263,7 @@ struct ServerConfig {
             , masterServiceThreadCount()
             , numReplicas()
             , useMinCopysets()
+            , compactObjectHeaders()
         {}
 
         /**
@@ -255,6 +282,7 @@ struct ServerConfig {
             config.set_master_service_thread_count(masterServiceThreadCount);
             config.set_num_replicas(numReplicas);
             config.set_use_mincopysets(useMinCopysets);
+            config.set_compact_object_headers(compactObjectHeaders);
         }
 
         /// Total number bytes to use for the in-memory Log.
@@ -296,6 +324,11 @@ struct ServerConfig {
         /// Specifies whether to use MinCopysets replication or random
         /// replication.
         bool useMinCopysets;
+
+        /// If true, objects are stored in the log with compact headers (see
+        /// Segment::setCompactObjects), which saves memory when objects are
+        /// small.
+        bool compactObjectHeaders;
     } master;
 
     /**
@@ -317,6 +350,7 @@ struct ServerConfig {
             , strategy(1)
             , mockSpeed(100)
             , writeRateLimit(0)
+            , taskThreads(1)
         {}
 
         /**
@@ -334,6 +368,7 @@ struct ServerConfig {
             , strategy(1)
             , mockSpeed(0)
             , writeRateLimit(0)
+            , taskThreads(1)
         {}
 
         /**
@@ -351,6 +386,7 @@ struct ServerConfig {
             config.set_strategy(strategy);
             config.set_mock_speed(mockSpeed);
             config.set_write_rate_limit(writeRateLimit);
+            config.set_task_threads(taskThreads);
         }
 
         /**
@@ -409,6 +445,14 @@ struct ServerConfig {
          * If non-0, limit writes to backup to this many megabytes per second.
          */
         size_t writeRateLimit;
+
+        /**
+         * Number of threads executing replica garbage collection and
+         * recovery tasks. With more than one, tasks for different masters
+         * and segments proceed in parallel (a single task never runs on two
+         * threads at once).
+         */
+        uint32_t taskThreads;
     } backup;
 
   public:
@@ -513,6 +557,35 @@ struct ServerConfig {
         master.logBytes = logBytes;
         master.hashTableBytes = hashTableBytes;
     }
+
+    /**
+     * Set #dispatchCpus, #workerCpus, and #cleanerCpus from command-line
+     * arguments.  Cores are handed out in that order: a core requested for
+     * workers is dropped if it (or its hyperthread sibling) was already
+     * given to the dispatch thread, and so on.
+     *
+     * \param[in] dispatchCpuList
+     *      Cores for the dispatch thread, e.g. "0" or "0-3,6".  Empty means
+     *      don't pin the dispatch thread.
+     * \param[in] workerCpuList
+     *      Cores for worker threads, in the same format.
+     * \param[in] cleanerCpuList
+     *      Cores for log cleaner threads, in the same format.
+     * \throw Exception
+     *      One of the lists is malformed.
+     */
+    void
+    setCpuAffinity(string dispatchCpuList, string workerCpuList,
+                   string cleanerCpuList)
+    {
+        std::vector<uint32_t> used;
+        dispatchCpus = CpuAffinity::assign(
+                CpuAffinity::parse(dispatchCpuList), &used);
+        workerCpus = CpuAffinity::assign(
+                CpuAffinity::parse(workerCpuList), &used);
+        cleanerCpus = CpuAffinity::assign(
+                CpuAffinity::parse(cleanerCpuList), &used);
+    }
 };
 
 } // namespace RAMCloud
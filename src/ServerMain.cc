@@ -38,6 +38,7 @@ main(int argc, char *argv[])
     try {
         ServerConfig config = ServerConfig::forExecution();
         string masterTotalMemory, hashTableMemory;
+        string dispatchCpus, workerCpus, cleanerCpus;
 
         bool masterOnly;
         bool backupOnly;
@@ -98,6 +99,11 @@ main(int argc, char *argv[])
              ProgramOptions::value<bool>(&config.master.useMinCopysets)->
                 default_value(false),
              "Whether to use MinCopysets or random replication")
+            ("compactObjectHeaders",
+             ProgramOptions::value<bool>(
+                &config.master.compactObjectHeaders)->default_value(false),
+             "Whether to store objects in the log with compact headers, "
+             "which saves memory for small objects")
             ("segmentFrames",
              ProgramOptions::value<uint32_t>(&config.backup.numSegmentFrames)->
                 default_value(512),
@@ -153,13 +159,36 @@ main(int argc, char *argv[])
              "The number of cleaner threads controls the amount of parallelism "
              "in the cleaner. More threads will use more cores, but may be "
              "able to better keep up with high write rates.")
+            ("dispatchCpus",
+             ProgramOptions::value<string>(&dispatchCpus)->default_value(""),
+             "Cores the dispatch thread may run on, e.g. \"0\" or \"0-3,6\". "
+             "By default threads aren't pinned and may run on any core. "
+             "Cores are handed out to the dispatch thread, then to worker "
+             "threads, then to cleaner threads; a core is skipped if it or "
+             "its hyperthread sibling was already handed out.")
+            ("workerCpus",
+             ProgramOptions::value<string>(&workerCpus)->default_value(""),
+             "Cores that threads executing RPCs may run on (see "
+             "dispatchCpus). Each worker thread is pinned to one of them, in "
+             "round-robin order.")
+            ("cleanerCpus",
+             ProgramOptions::value<string>(&cleanerCpus)->default_value(""),
+             "Cores that log cleaner threads may run on (see dispatchCpus). "
+             "Each cleaner thread is pinned to one of them, in round-robin "
+             "order.")
             ("backupWriteRateLimit",
              ProgramOptions::value<size_t>(
                 &config.backup.writeRateLimit)->default_value(0),
              "If non-0, specifies the maximum number of megabytes per second "
              "of bandwidth this backup should use. Useful for artificially "
              "restricting bandwidth when measuring various parts of the "
-             "system.");
+             "system.")
+            ("backupTaskThreads",
+             ProgramOptions::value<uint32_t>(
+                &config.backup.taskThreads)->default_value(1),
+             "Number of threads this backup uses to run replica garbage "
+             "collection and recovery tasks. Tasks for different masters "
+             "and segments run in parallel when this is more than 1.");
 
         OptionParser optionParser(serverOptions, argc, argv);
 
@@ -215,6 +244,7 @@ main(int argc, char *argv[])
             LOG(NOTICE, "Using %u backups", config.master.numReplicas);
             config.setLogAndHashTableSize(masterTotalMemory, hashTableMemory);
         }
+        config.setCpuAffinity(dispatchCpus, workerCpus, cleanerCpus);
 
         // Set PortTimeout and start portTimer
         LOG(NOTICE, "PortTimeOut=%d", optionParser.options.getPortTimeout());
@@ -14,6 +14,7 @@
  */
 
 #include "Cycles.h"
+#include "LatencyMetrics.h"
 #include "RawMetrics.h"
 #include "Service.h"
 #include "ShortMacros.h"
@@ -144,14 +145,32 @@ Service::handleRpc(Rpc* rpc) {
     uint32_t opcode = header->opcode;
     if (opcode >= WireFormat::ILLEGAL_RPC_TYPE)
         opcode = WireFormat::ILLEGAL_RPC_TYPE;
-    (&metrics->rpc.rpc0Count)[opcode]++;
+    ++(&metrics->rpc.rpc0Count)[opcode];
+    LatencyMetrics::setOpcode(opcode);
     uint64_t start = Cycles::rdtsc();
+    bool retryPrepared = false;
     try {
         dispatch(WireFormat::Opcode(header->opcode), rpc);
+    } catch (RetryException& e) {
+        prepareRetryResponse(rpc->replyPayload, e.minDelayMicros,
+                             e.maxDelayMicros);
+        retryPrepared = true;
     } catch (ClientException& e) {
         prepareErrorResponse(rpc->replyPayload, e.status);
     }
-    (&metrics->rpc.rpc0Ticks)[opcode] += Cycles::rdtsc() - start;
+
+    // Handlers may also return STATUS_RETRY in their usual response header;
+    // clients expect every such response to be a RetryResponse.
+    if (!retryPrepared) {
+        const WireFormat::ResponseCommon* responseCommon =
+            rpc->replyPayload->getStart<WireFormat::ResponseCommon>();
+        if (responseCommon != NULL && responseCommon->status == STATUS_RETRY)
+            prepareRetryResponse(rpc->replyPayload, 0, 0);
+    }
+    uint64_t ticks = Cycles::rdtsc() - start;
+    (&metrics->rpc.rpc0Ticks)[opcode] += ticks;
+    LatencyMetrics::record(LatencyMetrics::EXECUTE, ticks);
+    LatencyMetrics::clearOpcode();
 }
 
 /**
@@ -181,6 +200,33 @@ Service::prepareErrorResponse(Buffer* replyPayload, Status status)
     responseCommon->status = status;
 }
 
+/**
+ * Fill in an RPC response buffer to indicate that the client should retry
+ * the RPC later. Any response the RPC had already prepared is discarded.
+ *
+ * \param replyPayload
+ *      Buffer that should contain the response.
+ * \param minDelayMicros
+ *      The client should wait at least this many microseconds before
+ *      retrying. 0 for both this and \a maxDelayMicros means the client
+ *      should use its default delay.
+ * \param maxDelayMicros
+ *      The client should wait at most this many microseconds before
+ *      retrying.
+ */
+void
+Service::prepareRetryResponse(Buffer* replyPayload,
+                              uint32_t minDelayMicros,
+                              uint32_t maxDelayMicros)
+{
+    replyPayload->reset();
+    WireFormat::RetryResponse* response =
+        new(replyPayload, APPEND) WireFormat::RetryResponse;
+    response->common.status = STATUS_RETRY;
+    response->minDelayMicros = minDelayMicros;
+    response->maxDelayMicros = std::max(minDelayMicros, maxDelayMicros);
+}
+
 /**
  * This method is invoked once by Server.cc to notify the service that the
  * server has enlisted with the coordinator and to provide the ServerId it
@@ -85,6 +85,9 @@ class Service {
     virtual void dispatch(WireFormat::Opcode opcode,
                           Rpc* rpc);
     static void prepareErrorResponse(Buffer* buffer, Status status);
+    static void prepareRetryResponse(Buffer* replyPayload,
+                                     uint32_t minDelayMicros,
+                                     uint32_t maxDelayMicros);
 
     static const char* getString(Buffer* buffer, uint32_t offset,
                                  uint32_t length);
@@ -100,6 +103,56 @@ class Service {
         return 1;
     }
 
+    /**
+     * ServiceManager invokes this method in the dispatch thread before
+     * starting each incoming RPC. A service that is temporarily short of
+     * something a particular kind of RPC needs (such as log space for
+     * writes) can return false to have the RPC parked until it returns
+     * true, rather than having it fail and the client retry immediately.
+     * RPCs that stay parked too long are rejected with STATUS_RETRY. This
+     * method must be fast and thread-safe. The default admits everything.
+     *
+     * \param opcode
+     *      The RPC's opcode.
+     * \param requestPayload
+     *      The RPC's request, for services that need to look past the
+     *      opcode. The request is known to contain a RequestCommon.
+     * \param[out] minRetryDelayMicros
+     *      If false is returned, set to the shortest time the client should
+     *      wait before retrying if the RPC is eventually rejected.
+     * \param[out] maxRetryDelayMicros
+     *      If false is returned, set to the longest such time.
+     */
+    virtual bool admitRpc(WireFormat::Opcode opcode,
+                          Buffer* requestPayload,
+                          uint32_t* minRetryDelayMicros,
+                          uint32_t* maxRetryDelayMicros) {
+        return true;
+    }
+
+    /**
+     * ServiceManager invokes this method in the dispatch thread when an
+     * RPC has to wait for a worker thread. If the client supplied a
+     * deadline for the RPC, the service returns it here; RPCs that are
+     * still waiting when their deadline passes are rejected with
+     * STATUS_TIMEOUT instead of being executed, since the client has
+     * said it has no use for the result by then. This method must be
+     * fast and thread-safe. The default is no deadline.
+     *
+     * \param opcode
+     *      The RPC's opcode.
+     * \param requestPayload
+     *      The RPC's request. The request is known to contain a
+     *      RequestCommon.
+     * eturn
+     *      The longest time, in microseconds after the RPC's arrival, that
+     *      it may wait before starting, or 0 for no limit.
+     */
+    virtual uint32_t getRpcDeadline(WireFormat::Opcode opcode,
+                                    Buffer* requestPayload) {
+        return 0;
+    }
+
     void ping(const WireFormat::Ping::Request* reqHdr,
               WireFormat::Ping::Response* respHdr,
               Rpc* rpc);
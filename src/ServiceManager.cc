@@ -17,6 +17,8 @@
 #include "Cycles.h"
 #include "Fence.h"
 #include "Initialize.h"
+#include "LatencyMetrics.h"
+#include "RawMetrics.h"
 #include "ShortMacros.h"
 #include "ServerRpcPool.h"
 #include "ServiceManager.h"
@@ -42,14 +44,32 @@ static Syscall defaultSyscall;
  */
 Syscall* ServiceManager::sys = &defaultSyscall;
 
-// Length of time that a worker will actively poll for new work before it puts
-// itself to sleep. This period should be much longer than typical RPC
-// round-trip times so the worker thread doesn't go to sleep in an ongoing
-// conversation with a single client.  It must also be much longer than the
-// time it takes to wake up the thread once it has gone to sleep (as of
-// September 2011 this time appears to be as much as 50 microseconds).
+// Longest length of time that a worker will actively poll for new work
+// before it puts itself to sleep. This period should be much longer than
+// typical RPC round-trip times so the worker thread doesn't go to sleep in
+// an ongoing conversation with a single client.  It must also be much longer
+// than the time it takes to wake up the thread once it has gone to sleep (as
+// of September 2011 this time appears to be as much as 50 microseconds).
 int ServiceManager::pollMicros = 10000;
 
+// Shortest length of time that a worker will poll before sleeping: about
+// the cost of waking it back up, so a worker never gives up its core for
+// less than it costs to get the core back.
+int ServiceManager::minPollMicros = 50;
+
+// Idle workers keep polling for this many average interarrival times
+// before going to sleep (as long as that is less than pollMicros).
+static const uint64_t POLL_ARRIVAL_GAPS = 4;
+int ServiceManager::maxParkMicros = 10000;
+
+// Client requests get the lion's share of worker threads when there is a
+// backlog, but recovery and background work always make progress.
+const int ServiceManager::classWeights[NUM_PRIORITY_CLASSES] = {8, 4, 1};
+
+// The pass of a PriorityClass advances by this divided by its weight
+// each time it starts an RPC.
+static const uint64_t STRIDE = 1 << 16;
+
 // The following constant is used to signal a worker thread that
 // it should exit.
 #define WORKER_EXIT reinterpret_cast<Transport::ServerRpc*>(1)
@@ -64,6 +84,14 @@ ServiceManager::ServiceManager(Context* context)
     , busyThreads()
     , idleThreads()
     , serviceCount(0)
+    , parkedRpcCount(0)
+    , maxPollCycles(Cycles::fromNanoseconds(1000 * pollMicros))
+    , minPollCycles(Cycles::fromNanoseconds(1000 * minPollMicros))
+    , averageArrivalGap(maxPollCycles)
+    , lastArrivalTime(0)
+    , workerPollCycles(maxPollCycles)
+    , workerCpus()
+    , nextWorkerCpu(0)
     , testRpcs()
 {
 }
@@ -111,12 +139,33 @@ ServiceManager::addService(Service& service, WireFormat::ServiceType type) {
     // can cause timeouts.
 
     for (int i = services[type]->maxThreads; i > 0; i--) {
-        Worker* worker = new Worker(context);
+        int cpu = -1;
+        if (!workerCpus.empty()) {
+            cpu = downCast<int>(workerCpus[nextWorkerCpu % workerCpus.size()]);
+            nextWorkerCpu++;
+        }
+        Worker* worker = new Worker(context, this, cpu);
         worker->thread.construct(workerMain, worker);
         idleThreads.push_back(worker);
     }
 }
 
+/**
+ * Restrict the worker threads created by future calls to addService to
+ * particular cores: each new worker is pinned to the next core in the
+ * list, wrapping around as needed.
+ *
+ * \param cpus
+ *      Cores for worker threads (see ServerConfig::workerCpus).  Empty
+ *      means workers may run on any core.
+ */
+void
+ServiceManager::setWorkerCpus(const std::vector<uint32_t>& cpus)
+{
+    workerCpus = cpus;
+    nextWorkerCpu = 0;
+}
+
 /**
  * Transports invoke this method when an incoming RPC is complete and
  * ready for processing.  This method will arrange for the RPC (eventually)
@@ -131,6 +180,8 @@ void
 ServiceManager::handleRpc(Transport::ServerRpc* rpc)
 {
     assert(rpc->epochIsSet());
+    rpc->receiveTime = Cycles::rdtsc();
+    updateWorkerPollCycles(rpc->receiveTime);
 
     // Find the service for this RPC.
     const WireFormat::RequestCommon* header;
@@ -166,11 +217,6 @@ ServiceManager::handleRpc(Transport::ServerRpc* rpc)
             rpc->requestPayload.getTotalLength());
 #endif
 
-    // See if we have exceeded the concurrency limit for the service.
-    if (serviceInfo->requestsRunning >= serviceInfo->maxThreads) {
-        serviceInfo->waitingRpcs.push(rpc);
-        return;
-    }
     // Temporary code to test how much faster things would be without threads.
 #if 0
     if ((header->opcode == RpcOpcode::READ) &&
@@ -182,6 +228,39 @@ ServiceManager::handleRpc(Transport::ServerRpc* rpc)
     }
 #endif
 
+    // If the service isn't ready for this kind of request (e.g., a master
+    // that is out of log space for writes), hold on to it for a while
+    // rather than making the client retry right away.
+    uint32_t minRetryDelayMicros, maxRetryDelayMicros;
+    if (!serviceInfo->service.admitRpc(WireFormat::Opcode(header->opcode),
+                                       &rpc->requestPayload,
+                                       &minRetryDelayMicros,
+                                       &maxRetryDelayMicros)) {
+        serviceInfo->parkedRpcs.push(rpc);
+        parkedRpcCount++;
+        return;
+    }
+
+    startRpc(serviceInfo, rpc);
+}
+
+/**
+ * Start executing an RPC in a worker thread, or queue it if the service
+ * is already running as many RPCs as it can.
+ *
+ * \param serviceInfo
+ *      The service that will execute the RPC.
+ * \param rpc
+ *      The RPC.
+ */
+void
+ServiceManager::startRpc(ServiceInfo* serviceInfo, Transport::ServerRpc* rpc)
+{
+    // See if we have exceeded the concurrency limit for the service.
+    if (serviceInfo->requestsRunning >= serviceInfo->maxThreads) {
+        queueRpc(serviceInfo, rpc);
+        return;
+    }
     serviceInfo->requestsRunning++;
 
     // Hand off the RPC to a worker thread.
@@ -194,6 +273,140 @@ ServiceManager::handleRpc(Transport::ServerRpc* rpc)
     busyThreads.push_back(worker);
 }
 
+/**
+ * Add an RPC to the waitingRpcs queue for its PriorityClass, to be started
+ * by poll when a worker thread frees up.
+ *
+ * \param serviceInfo
+ *      The service that will execute the RPC.
+ * \param rpc
+ *      The RPC; the service is already running as many RPCs as it can.
+ */
+void
+ServiceManager::queueRpc(ServiceInfo* serviceInfo, Transport::ServerRpc* rpc)
+{
+    const WireFormat::RequestCommon* header =
+        rpc->requestPayload.getStart<WireFormat::RequestCommon>();
+    WireFormat::Opcode opcode = WireFormat::Opcode(header->opcode);
+    PriorityClass priority = priorityClass(opcode);
+    uint64_t deadline = 0;
+    uint32_t deadlineMicros = serviceInfo->service.getRpcDeadline(opcode,
+            &rpc->requestPayload);
+    if (deadlineMicros != 0) {
+        deadline = rpc->receiveTime +
+                Cycles::fromNanoseconds(1000UL * deadlineMicros);
+    }
+
+    // A class that has been idle rejoins at the current virtual time,
+    // rather than getting a burst of turns for the time it was idle.
+    if (serviceInfo->waitingRpcs[priority].empty() &&
+            (serviceInfo->pass[priority] < serviceInfo->virtualTime)) {
+        serviceInfo->pass[priority] = serviceInfo->virtualTime;
+    }
+    serviceInfo->waitingRpcs[priority].push(
+            ServiceInfo::WaitingRpc(rpc, deadline));
+    serviceInfo->waitingRpcCount++;
+    switch (priority) {
+        case FOREGROUND:
+            ++metrics->serviceManager.foregroundWaitCount;
+            break;
+        case RECOVERY:
+            ++metrics->serviceManager.recoveryWaitCount;
+            break;
+        default:
+            ++metrics->serviceManager.backgroundWaitCount;
+            break;
+    }
+}
+
+/**
+ * Pick the next waiting RPC for a service to start, using weighted fair
+ * queueing across PriorityClasses. RPCs whose deadlines have passed while
+ * they waited are rejected with STATUS_TIMEOUT along the way.
+ *
+ * \param serviceInfo
+ *      The service that has a worker thread available.
+ * \return
+ *      The RPC to start next, or NULL if none are waiting.
+ */
+Transport::ServerRpc*
+ServiceManager::nextWaitingRpc(ServiceInfo* serviceInfo)
+{
+    uint64_t now = 0;
+    while (serviceInfo->waitingRpcCount > 0) {
+        int next = -1;
+        for (int i = 0; i < NUM_PRIORITY_CLASSES; i++) {
+            if (serviceInfo->waitingRpcs[i].empty())
+                continue;
+            if ((next < 0) || (serviceInfo->pass[i] < serviceInfo->pass[next]))
+                next = i;
+        }
+        std::queue<ServiceInfo::WaitingRpc>& queue =
+                serviceInfo->waitingRpcs[next];
+        ServiceInfo::WaitingRpc waiting = queue.front();
+        queue.pop();
+        serviceInfo->waitingRpcCount--;
+        if (now == 0)
+            now = Cycles::rdtsc();
+        uint64_t waitTicks = now - waiting.rpc->receiveTime;
+        RawMetric* ticks;
+        switch (next) {
+            case FOREGROUND:
+                ticks = &metrics->serviceManager.foregroundWaitTicks;
+                break;
+            case RECOVERY:
+                ticks = &metrics->serviceManager.recoveryWaitTicks;
+                break;
+            default:
+                ticks = &metrics->serviceManager.backgroundWaitTicks;
+                break;
+        }
+        *ticks += waitTicks;
+
+        if ((waiting.deadline != 0) && (now > waiting.deadline)) {
+            // The client has no use for the result any more; don't spend
+            // a worker thread on it.
+            ++metrics->serviceManager.deadlineMissedCount;
+            Service::prepareErrorResponse(&waiting.rpc->replyPayload,
+                    STATUS_TIMEOUT);
+            waiting.rpc->sendReply();
+            continue;
+        }
+        serviceInfo->virtualTime = serviceInfo->pass[next];
+        serviceInfo->pass[next] += STRIDE / classWeights[next];
+        return waiting.rpc;
+    }
+    return NULL;
+}
+
+/**
+ * Returns the PriorityClass for RPCs with a given opcode, which determines
+ * their share of worker threads when RPCs have to wait (see queueRpc).
+ *
+ * \param opcode
+ *      The RPC's opcode.
+ */
+ServiceManager::PriorityClass
+ServiceManager::priorityClass(WireFormat::Opcode opcode)
+{
+    switch (opcode) {
+        case WireFormat::BACKUP_GETRECOVERYDATA:
+        case WireFormat::BACKUP_STARTREADINGDATA:
+        case WireFormat::BACKUP_STARTPARTITION:
+        case WireFormat::RECOVER:
+            return RECOVERY;
+        case WireFormat::ENUMERATE:
+        case WireFormat::FILL_WITH_TEST_DATA:
+        case WireFormat::MIGRATE_TABLET:
+        case WireFormat::PREP_FOR_MIGRATION:
+        case WireFormat::RECEIVE_MIGRATION_DATA:
+        case WireFormat::SPLIT_TABLET:
+            return BACKGROUND;
+        default:
+            return FOREGROUND;
+    }
+}
+
 /**
  * Returns true if there are currently no RPCs being serviced, false
  * if at least one RPC is currently being executed by a worker.  If true
@@ -242,9 +455,9 @@ ServiceManager::poll()
         if (state != Worker::POSTPROCESSING) {
             // If there is work waiting for this service, start the next RPC.
             ServiceInfo* info = worker->serviceInfo;
-            if (!info->waitingRpcs.empty()) {
-                worker->handoff(info->waitingRpcs.front());
-                info->waitingRpcs.pop();
+            Transport::ServerRpc* next = nextWaitingRpc(info);
+            if (next != NULL) {
+                worker->handoff(next);
             } else {
                 // This worker is now idle; remove it from busyThreads (fill
                 // its slot with the worker in the last slot).
@@ -260,6 +473,51 @@ ServiceManager::poll()
             }
         }
     }
+
+    if (parkedRpcCount > 0)
+        checkParkedRpcs();
+}
+
+/**
+ * Start any parked RPCs that their services are now ready to admit, and
+ * reject (with STATUS_RETRY) those that have been parked longer than
+ * #maxParkMicros. Invoked by poll while there are parked RPCs.
+ */
+void
+ServiceManager::checkParkedRpcs()
+{
+    uint64_t now = Cycles::rdtsc();
+    uint64_t maxParkCycles = Cycles::fromNanoseconds(1000UL * maxParkMicros);
+    for (int i = 0; i < WireFormat::INVALID_SERVICE; i++) {
+        if (!services[i])
+            continue;
+        ServiceInfo* info = services[i].get();
+
+        // RPCs are parked in order of arrival, so only the oldest one needs
+        // to be checked for expiration.
+        while (!info->parkedRpcs.empty()) {
+            Transport::ServerRpc* rpc = info->parkedRpcs.front();
+            const WireFormat::RequestCommon* header =
+                rpc->requestPayload.getStart<WireFormat::RequestCommon>();
+            uint32_t minRetryDelayMicros = 0, maxRetryDelayMicros = 0;
+            bool admitted = info->service.admitRpc(
+                    WireFormat::Opcode(header->opcode), &rpc->requestPayload,
+                    &minRetryDelayMicros, &maxRetryDelayMicros);
+            if (!admitted && (now - rpc->receiveTime) < maxParkCycles)
+                break;
+
+            info->parkedRpcs.pop();
+            parkedRpcCount--;
+            if (admitted) {
+                startRpc(info, rpc);
+            } else {
+                Service::prepareRetryResponse(&rpc->replyPayload,
+                                              minRetryDelayMicros,
+                                              maxRetryDelayMicros);
+                rpc->sendReply();
+            }
+        }
+    }
 }
 
 /**
@@ -290,6 +548,37 @@ ServiceManager::waitForRpc(double timeoutSeconds) {
     }
 }
 
+/**
+ * Adjust how long idle workers poll for new work before sleeping
+ * (#workerPollCycles), based on the rate at which RPCs are arriving.
+ * Invoked in the dispatch thread for each incoming RPC.
+ *
+ * \param arrivalTime
+ *      Cycles::rdtsc time at which the RPC arrived.
+ */
+void
+ServiceManager::updateWorkerPollCycles(uint64_t arrivalTime)
+{
+    // Gaps longer than maxPollCycles all mean the same thing (workers will
+    // have gone to sleep anyway); capping them lets the average recover
+    // quickly when a burst of RPCs follows a long idle period.
+    uint64_t gap = arrivalTime - lastArrivalTime;
+    if (gap > maxPollCycles)
+        gap = maxPollCycles;
+    lastArrivalTime = arrivalTime;
+    averageArrivalGap = averageArrivalGap - averageArrivalGap/8 + gap/8;
+
+    uint64_t pollCycles = POLL_ARRIVAL_GAPS * averageArrivalGap;
+    if (pollCycles > maxPollCycles) {
+        // RPCs are arriving too rarely for polling to pay off: a worker
+        // would usually burn its whole polling period and then sleep.
+        pollCycles = minPollCycles;
+    } else if (pollCycles < minPollCycles) {
+        pollCycles = minPollCycles;
+    }
+    workerPollCycles.store(pollCycles);
+}
+
 /**
  * This is the top-level method for worker threads.  It repeatedly waits for
  * an RPC to be assigned to it, then executes that RPC and communicates its
@@ -303,10 +592,12 @@ void
 ServiceManager::workerMain(Worker* worker)
 {
     Dispatch& dispatch = *worker->context->dispatch;
+    if (worker->cpu >= 0)
+        pinToCpu(downCast<uint32_t>(worker->cpu));
     try {
-        uint64_t pollCycles = Cycles::fromNanoseconds(1000*pollMicros);
         while (true) {
-            uint64_t stopPollingTime = dispatch.currentTime + pollCycles;
+            uint64_t stopPollingTime = dispatch.currentTime +
+                    worker->manager->workerPollCycles.load();
 
             // Wait for ServiceManager to supply us with some work to do.
             while (worker->state.load() != Worker::WORKING) {
@@ -339,6 +630,13 @@ ServiceManager::workerMain(Worker* worker)
             if (worker->rpc == WORKER_EXIT)
                 break;
 
+            // The dispatch thread has already checked that the request
+            // has a header.
+            const WireFormat::RequestCommon* header = worker->rpc->
+                    requestPayload.getStart<WireFormat::RequestCommon>();
+            LatencyMetrics::record(LatencyMetrics::QUEUE, header->opcode,
+                    Cycles::rdtsc() - worker->rpc->receiveTime);
+
             Service::Rpc rpc(worker, &worker->rpc->requestPayload,
                     &worker->rpc->replyPayload);
             worker->serviceInfo->service.handleRpc(&rpc);
@@ -43,19 +43,50 @@ class ServiceManager : Dispatch::Poller {
     static void init();
     void poll();
     void setServerId(ServerId serverId);
+    void setWorkerCpus(const std::vector<uint32_t>& cpus);
     Transport::ServerRpc* waitForRpc(double timeoutSeconds);
 
   PROTECTED:
 
-    /// How many microseconds worker threads should remain in their polling
-    /// loop waiting for work. If no new arrives during this period the
-    /// worker thread will put itself to sleep, which releases its core but
-    /// will result in additional delay for the next RPC while it wakes up.
-    /// The value of this variable is typically not modified except during
-    /// testing.
+    /// The longest time, in microseconds, that worker threads will remain
+    /// in their polling loop waiting for work. If no new arrives during this
+    /// period the worker thread will put itself to sleep, which releases its
+    /// core but will result in additional delay for the next RPC while it
+    /// wakes up. The actual polling period adapts to the rate at which RPCs
+    /// arrive (see #workerPollCycles). The value of this variable is
+    /// typically not modified except during testing.
     static int pollMicros;
+
+    /// The shortest time, in microseconds, that worker threads will poll
+    /// for work before sleeping, no matter how rarely RPCs arrive.
+    static int minPollMicros;
+
+    /// How many microseconds an RPC may stay parked (because its service
+    /// wasn't ready to admit it; see Service::admitRpc) before it is
+    /// rejected with STATUS_RETRY. This bounds how long clients wait
+    /// without hearing from the server.
+    static int maxParkMicros;
     static void workerMain(Worker* worker);
 
+    /// RPCs that have to wait for a worker thread are divided into the
+    /// following classes based on their opcodes (see #priorityClass).
+    /// When a worker thread frees up, the classes share it in proportion
+    /// to their weights in #classWeights, so a burst of recovery or
+    /// migration requests can't starve client requests, and vice versa.
+    enum PriorityClass {
+        FOREGROUND = 0,          // Client requests and anything not
+                                 // listed below.
+        RECOVERY,                // Bulk transfers for crash recovery.
+        BACKGROUND,              // Migration, enumeration, and similar
+                                 // long-running maintenance work.
+        NUM_PRIORITY_CLASSES
+    };
+    static PriorityClass priorityClass(WireFormat::Opcode opcode);
+
+    /// Relative share of worker threads for each PriorityClass while
+    /// RPCs of more than one class are waiting.
+    static const int classWeights[NUM_PRIORITY_CLASSES];
+
     /// Shared RAMCloud information.
     Context* context;
 
@@ -72,21 +103,60 @@ class ServiceManager : Dispatch::Poller {
                                        /// executed by the service (each in a
                                        /// separate thread); must never be
                                        /// greater than maxThreads.
-        std::queue<Transport::ServerRpc*> waitingRpcs;
+        // An RPC that is waiting for a worker thread.
+        struct WaitingRpc {
+            Transport::ServerRpc* rpc;
+            uint64_t deadline;         /// Cycles::rdtsc time after which
+                                       /// the RPC should be rejected rather
+                                       /// than started; 0 means never (see
+                                       /// Service::getRpcDeadline).
+            WaitingRpc(Transport::ServerRpc* rpc, uint64_t deadline)
+                : rpc(rpc), deadline(deadline) {}
+        };
+        std::queue<WaitingRpc> waitingRpcs[NUM_PRIORITY_CLASSES];
                                        /// Requests that cannot execute until
                                        /// an existing request completes
-                                       /// (requestsRunning == maxThreads).
+                                       /// (requestsRunning == maxThreads),
+                                       /// in order of arrival within each
+                                       /// PriorityClass.
+        uint64_t pass[NUM_PRIORITY_CLASSES];
+                                       /// Stride-scheduling position of each
+                                       /// class: the next waiting RPC comes
+                                       /// from the nonempty class with the
+                                       /// smallest pass, whose pass then
+                                       /// advances in inverse proportion to
+                                       /// its weight.
+        uint64_t virtualTime;          /// Pass of the class that most
+                                       /// recently started an RPC; a class
+                                       /// that was idle starts from here, so
+                                       /// it can't save up credit.
+        int waitingRpcCount;           /// Total size of waitingRpcs.
+        std::queue<Transport::ServerRpc*> parkedRpcs;
+                                       /// Requests that the service wasn't
+                                       /// ready to admit when they arrived,
+                                       /// in order of arrival (see
+                                       /// Service::admitRpc).
         explicit ServiceInfo(Service& service)
             : service(service)
             , maxThreads(service.maxThreads())
             , requestsRunning(0)
             , waitingRpcs()
+            , pass()
+            , virtualTime(0)
+            , waitingRpcCount(0)
+            , parkedRpcs()
         {}
         friend class Worker;
         DISALLOW_COPY_AND_ASSIGN(ServiceInfo);
     };
     Tub<ServiceInfo> services[WireFormat::INVALID_SERVICE];
 
+    void checkParkedRpcs();
+    Transport::ServerRpc* nextWaitingRpc(ServiceInfo* serviceInfo);
+    void queueRpc(ServiceInfo* serviceInfo, Transport::ServerRpc* rpc);
+    void startRpc(ServiceInfo* serviceInfo, Transport::ServerRpc* rpc);
+    void updateWorkerPollCycles(uint64_t arrivalTime);
+
     // Worker threads that are currently executing RPCs (no particular order).
     std::vector<Worker*> busyThreads;
 
@@ -99,6 +169,34 @@ class ServiceManager : Dispatch::Poller {
     // Number of services that are currently registered.
     int serviceCount;
 
+    // Total number of RPCs in the parkedRpcs queues of all services; lets
+    // poll skip checking them in the common case where there are none.
+    int parkedRpcCount;
+
+    // #pollMicros and #minPollMicros, converted to Cycles::rdtsc ticks.
+    uint64_t maxPollCycles;
+    uint64_t minPollCycles;
+
+    // Exponentially weighted moving average of the time between arrivals
+    // of consecutive RPCs, in Cycles::rdtsc ticks.
+    uint64_t averageArrivalGap;
+
+    // Cycles::rdtsc time when the most recent RPC arrived.
+    uint64_t lastArrivalTime;
+
+    // How long idle workers should poll for new work before going to
+    // sleep, in Cycles::rdtsc ticks. When RPCs arrive often enough that an
+    // idle worker will probably get one within a few interarrival times it
+    // pays to keep polling (waking a sleeping thread takes tens of
+    // microseconds); otherwise workers give their cores back quickly.
+    // Written by the dispatch thread in handleRpc, read by workers.
+    Atomic<uint64_t> workerPollCycles;
+
+    // Cores on which to run worker threads (see setWorkerCpus), and the
+    // index in this list of the core for the next worker created.
+    std::vector<uint32_t> workerCpus;
+    size_t nextWorkerCpu;
+
     // Used for testing: if no services are registered, incoming RPCs are
     // queued here.
     std::queue<Transport::ServerRpc*> testRpcs;
@@ -124,6 +222,11 @@ class Worker {
 
   PRIVATE:
     Context* context;                  /// Shared RAMCloud information.
+    ServiceManager* manager;           /// The ServiceManager that created
+                                       /// this worker; NULL only in tests.
+    int cpu;                           /// Core to which the worker's thread
+                                       /// pins itself, or -1 if it may run
+                                       /// anywhere.
     ServiceManager::ServiceInfo *serviceInfo;
                                        /// Service for the last request
                                        /// executed by this worker.
@@ -173,9 +276,10 @@ class Worker {
     bool exited;                       /// True means the worker is no longer
                                        /// running.
 
-    explicit Worker(Context* context)
-        : context(context), serviceInfo(NULL), thread(), rpc(NULL),
-          busyIndex(-1), state(POLLING), exited(false) {}
+    explicit Worker(Context* context, ServiceManager* manager = NULL,
+                    int cpu = -1)
+        : context(context), manager(manager), cpu(cpu), serviceInfo(NULL),
+          thread(), rpc(NULL), busyIndex(-1), state(POLLING), exited(false) {}
     void exit();
     void handoff(Transport::ServerRpc* rpc);
 
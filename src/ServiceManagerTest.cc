@@ -18,6 +18,7 @@
 #include "MockService.h"
 #include "MockSyscall.h"
 #include "MockTransport.h"
+#include "RawMetrics.h"
 #include "ServiceManager.h"
 #include "Tub.h"
 
@@ -135,6 +136,19 @@ TEST_F(ServiceManagerTest, addService) {
     EXPECT_EQ(3U, manager1.idleThreads.size());
 }
 
+TEST_F(ServiceManagerTest, addService_workerCpus) {
+    MockService mock;
+    ServiceManager manager1(&context);
+    EXPECT_EQ(-1, manager->idleThreads[0]->cpu);
+    manager1.setWorkerCpus({0, 1});
+    manager1.addService(mock, WireFormat::BACKUP_SERVICE);
+    ASSERT_EQ(3U, manager1.idleThreads.size());
+    EXPECT_EQ(0, manager1.idleThreads[0]->cpu);
+    EXPECT_EQ(1, manager1.idleThreads[1]->cpu);
+    EXPECT_EQ(0, manager1.idleThreads[2]->cpu);
+    EXPECT_EQ(&manager1, manager1.idleThreads[0]->manager);
+}
+
 TEST_F(ServiceManagerTest, handleRpc_noHeader) {
     TestLog::Enable _;
     MockTransport::MockServerRpc* rpc = new MockTransport::MockServerRpc(
@@ -170,10 +184,10 @@ TEST_F(ServiceManagerTest, handleRpc_concurrencyLimitExceeded) {
     manager->handleRpc(rpc2);
     manager->handleRpc(rpc3);
     EXPECT_EQ(3U, manager->busyThreads.size());
-    EXPECT_EQ(0U, manager->services[1]->waitingRpcs.size());
+    EXPECT_EQ(0, manager->services[1]->waitingRpcCount);
     manager->handleRpc(rpc4);
     EXPECT_EQ(3U, manager->busyThreads.size());
-    EXPECT_EQ(1U, manager->services[1]->waitingRpcs.size());
+    EXPECT_EQ(1, manager->services[1]->waitingRpcCount);
 }
 
 TEST_F(ServiceManagerTest, handleRpc_handoffToWorker) {
@@ -188,6 +202,169 @@ TEST_F(ServiceManagerTest, handleRpc_handoffToWorker) {
     EXPECT_EQ(3U, manager->idleThreads.size());
 }
 
+TEST_F(ServiceManagerTest, handleRpc_parkUntilAdmitted) {
+    service.admit = false;
+    MockTransport::MockServerRpc* rpc = new MockTransport::MockServerRpc(
+            &transport, "0x10000 3 4");
+    manager->handleRpc(rpc);
+    EXPECT_EQ(0U, manager->busyThreads.size());
+    EXPECT_EQ(1U, manager->services[1]->parkedRpcs.size());
+    EXPECT_EQ(1, manager->parkedRpcCount);
+
+    manager->poll();
+    EXPECT_EQ(1, manager->parkedRpcCount);
+    EXPECT_EQ("", transport.outputLog);
+
+    service.admit = true;
+    manager->poll();
+    EXPECT_EQ(0, manager->parkedRpcCount);
+    EXPECT_EQ(0U, manager->services[1]->parkedRpcs.size());
+    EXPECT_EQ(1U, manager->busyThreads.size());
+    waitUntilDone(1);
+    manager->poll();
+    EXPECT_EQ("rpc: 0x10000 3 4", service.log);
+    EXPECT_EQ("serverReply: 0x10001 4 5", transport.outputLog);
+}
+
+TEST_F(ServiceManagerTest, checkParkedRpcs_rejectAfterMaxParkMicros) {
+    service.admit = false;
+    Cycles::mockTscValue = 1000;
+    MockTransport::MockServerRpc* rpc1 = new MockTransport::MockServerRpc(
+            &transport, "0x10000 1");
+    manager->handleRpc(rpc1);
+    Cycles::mockTscValue = 1000 + Cycles::fromNanoseconds(
+            1000UL * ServiceManager::maxParkMicros / 2);
+    MockTransport::MockServerRpc* rpc2 = new MockTransport::MockServerRpc(
+            &transport, "0x10000 2");
+    manager->handleRpc(rpc2);
+
+    Cycles::mockTscValue = 1000 + Cycles::fromNanoseconds(
+            1000UL * ServiceManager::maxParkMicros);
+    manager->checkParkedRpcs();
+    Cycles::mockTscValue = 0;
+    EXPECT_EQ("serverReply: 17 300 400", transport.outputLog);
+    EXPECT_EQ(1, manager->parkedRpcCount);
+    EXPECT_EQ(1U, manager->services[1]->parkedRpcs.size());
+    EXPECT_EQ("", service.log);
+
+    service.admit = true;
+    manager->poll();
+    waitUntilDone(1);
+    manager->poll();
+    EXPECT_EQ("rpc: 0x10000 2", service.log);
+}
+
+TEST_F(ServiceManagerTest, queueRpc) {
+    ServiceManager::ServiceInfo* info = manager->services[1].get();
+    uint64_t foregroundCount = metrics->serviceManager.foregroundWaitCount;
+    uint64_t recoveryCount = metrics->serviceManager.recoveryWaitCount;
+    uint64_t backgroundCount = metrics->serviceManager.backgroundWaitCount;
+    MockTransport::MockServerRpc* rpc1 = new MockTransport::MockServerRpc(
+            &transport, "0x10000 1");
+    MockTransport::MockServerRpc* rpc2 = new MockTransport::MockServerRpc(
+            &transport, "0x10016 2");
+    MockTransport::MockServerRpc* rpc3 = new MockTransport::MockServerRpc(
+            &transport, "0x1001d 3");
+    rpc1->receiveTime = 1000;
+    service.deadlineMicros = 2;
+    manager->queueRpc(info, rpc1);
+    service.deadlineMicros = 0;
+    manager->queueRpc(info, rpc2);
+    manager->queueRpc(info, rpc3);
+    EXPECT_EQ(3, info->waitingRpcCount);
+    EXPECT_EQ(1U, info->waitingRpcs[ServiceManager::FOREGROUND].size());
+    EXPECT_EQ(1U, info->waitingRpcs[ServiceManager::BACKGROUND].size());
+    EXPECT_EQ(1U, info->waitingRpcs[ServiceManager::RECOVERY].size());
+    EXPECT_EQ(1000 + Cycles::fromNanoseconds(2000),
+            info->waitingRpcs[ServiceManager::FOREGROUND].front().deadline);
+    EXPECT_EQ(0U,
+            info->waitingRpcs[ServiceManager::BACKGROUND].front().deadline);
+    EXPECT_EQ(1U, metrics->serviceManager.foregroundWaitCount -
+            foregroundCount);
+    EXPECT_EQ(1U, metrics->serviceManager.recoveryWaitCount -
+            recoveryCount);
+    EXPECT_EQ(1U, metrics->serviceManager.backgroundWaitCount -
+            backgroundCount);
+
+    // An idle class rejoins at the current virtual time.
+    info->virtualTime = 5000;
+    info->waitingRpcs[ServiceManager::RECOVERY].pop();
+    info->waitingRpcCount--;
+    manager->queueRpc(info, rpc3);
+    EXPECT_EQ(5000U, info->pass[ServiceManager::RECOVERY]);
+    EXPECT_EQ(0U, info->pass[ServiceManager::BACKGROUND]);
+
+    while (Transport::ServerRpc* rpc = manager->nextWaitingRpc(info))
+        rpc->sendReply();
+}
+
+TEST_F(ServiceManagerTest, nextWaitingRpc_weightedFairQueueing) {
+    ServiceManager::ServiceInfo* info = manager->services[1].get();
+    const char* requests[] = {"0x10000 1", "0x10016 2", "0x1001d 3"};
+    for (int i = 0; i < 20; i++) {
+        for (int j = 0; j < 3; j++) {
+            manager->queueRpc(info, new MockTransport::MockServerRpc(
+                    &transport, requests[j]));
+        }
+    }
+
+    // Over one full round, each class gets turns in proportion to its
+    // weight.
+    int counts[ServiceManager::NUM_PRIORITY_CLASSES] = {0, 0, 0};
+    for (int i = 0; i < 13; i++) {
+        Transport::ServerRpc* rpc = manager->nextWaitingRpc(info);
+        const WireFormat::RequestCommon* header =
+            rpc->requestPayload.getStart<WireFormat::RequestCommon>();
+        counts[ServiceManager::priorityClass(
+                WireFormat::Opcode(header->opcode))]++;
+        rpc->sendReply();
+    }
+    EXPECT_EQ(8, counts[ServiceManager::FOREGROUND]);
+    EXPECT_EQ(4, counts[ServiceManager::RECOVERY]);
+    EXPECT_EQ(1, counts[ServiceManager::BACKGROUND]);
+
+    while (Transport::ServerRpc* rpc = manager->nextWaitingRpc(info))
+        rpc->sendReply();
+    EXPECT_EQ(0, info->waitingRpcCount);
+    EXPECT_TRUE(manager->nextWaitingRpc(info) == NULL);
+}
+
+TEST_F(ServiceManagerTest, nextWaitingRpc_rejectAfterDeadline) {
+    ServiceManager::ServiceInfo* info = manager->services[1].get();
+    uint64_t missed = metrics->serviceManager.deadlineMissedCount;
+    service.deadlineMicros = 10;
+    MockTransport::MockServerRpc* rpc1 = new MockTransport::MockServerRpc(
+            &transport, "0x10000 1");
+    MockTransport::MockServerRpc* rpc2 = new MockTransport::MockServerRpc(
+            &transport, "0x10000 2");
+    rpc1->receiveTime = 1000;
+    rpc2->receiveTime = 1000 + Cycles::fromNanoseconds(5000);
+    manager->queueRpc(info, rpc1);
+    manager->queueRpc(info, rpc2);
+
+    Cycles::mockTscValue = 1000 + Cycles::fromNanoseconds(12000);
+    Transport::ServerRpc* rpc = manager->nextWaitingRpc(info);
+    Cycles::mockTscValue = 0;
+    EXPECT_TRUE(rpc == rpc2);
+    EXPECT_EQ("serverReply: 19", transport.outputLog);
+    EXPECT_EQ(1U, metrics->serviceManager.deadlineMissedCount - missed);
+    EXPECT_EQ(0, info->waitingRpcCount);
+    rpc->sendReply();
+}
+
+TEST_F(ServiceManagerTest, priorityClass) {
+    EXPECT_EQ(ServiceManager::FOREGROUND,
+            ServiceManager::priorityClass(WireFormat::READ));
+    EXPECT_EQ(ServiceManager::FOREGROUND,
+            ServiceManager::priorityClass(WireFormat::WRITE));
+    EXPECT_EQ(ServiceManager::RECOVERY,
+            ServiceManager::priorityClass(WireFormat::BACKUP_GETRECOVERYDATA));
+    EXPECT_EQ(ServiceManager::BACKGROUND,
+            ServiceManager::priorityClass(WireFormat::ENUMERATE));
+    EXPECT_EQ(ServiceManager::BACKGROUND,
+            ServiceManager::priorityClass(WireFormat::RECEIVE_MIGRATION_DATA));
+}
+
 TEST_F(ServiceManagerTest, idle) {
     EXPECT_TRUE(manager->idle());
     // Start one RPC.
@@ -220,7 +397,7 @@ TEST_F(ServiceManagerTest, poll_basics) {
     manager->handleRpc(rpc3);
     manager->handleRpc(rpc4);
     manager->handleRpc(rpc5);
-    EXPECT_EQ(2U, manager->services[1]->waitingRpcs.size());
+    EXPECT_EQ(2, manager->services[1]->waitingRpcCount);
 
     // Allow 2 of the requests to complete, and make sure that the remaining
     // 2 start service.
@@ -229,7 +406,7 @@ TEST_F(ServiceManagerTest, poll_basics) {
     service.gate = 2;
     waitUntilDone(2);
     manager->poll();
-    EXPECT_EQ(0U, manager->services[1]->waitingRpcs.size());
+    EXPECT_EQ(0, manager->services[1]->waitingRpcCount);
     EXPECT_EQ("serverReply: 0x10001 3 | serverReply: 0x10001 2",
             transport.outputLog);
 
@@ -278,6 +455,36 @@ TEST_F(ServiceManagerTest, poll_postprocessing) {
     EXPECT_EQ(2U, manager->idleThreads.size());
 }
 
+TEST_F(ServiceManagerTest, updateWorkerPollCycles) {
+    uint64_t maxPoll = manager->maxPollCycles;
+    uint64_t minPoll = manager->minPollCycles;
+    EXPECT_EQ(maxPoll, manager->workerPollCycles.load());
+
+    // Long gaps are capped, and leave workers polling only briefly.
+    manager->lastArrivalTime = 1000;
+    manager->updateWorkerPollCycles(1000 + 10*maxPoll);
+    EXPECT_EQ(maxPoll, manager->averageArrivalGap);
+    EXPECT_EQ(minPoll, manager->workerPollCycles.load());
+
+    // A steady stream of RPCs pulls the average down until polling
+    // for a few interarrival times fits within maxPollCycles.
+    uint64_t now = manager->lastArrivalTime;
+    uint64_t gap = maxPoll/100;
+    for (int i = 0; i < 100; i++) {
+        now += gap;
+        manager->updateWorkerPollCycles(now);
+    }
+    EXPECT_LT(manager->averageArrivalGap, gap + gap/10);
+    EXPECT_EQ(4*manager->averageArrivalGap, manager->workerPollCycles.load());
+
+    // Very frequent RPCs don't push the polling time below its minimum.
+    for (int i = 0; i < 100; i++) {
+        now += 1;
+        manager->updateWorkerPollCycles(now);
+    }
+    EXPECT_EQ(minPoll, manager->workerPollCycles.load());
+}
+
 // No tests for waitForRpc: this method is only used in tests.
 
 TEST_F(ServiceManagerTest, workerMain_goToSleep) {
@@ -14,6 +14,7 @@
  */
 
 #include "TestUtil.h"
+#include "LatencyMetrics.h"
 #include "MockService.h"
 #include "MockTransport.h"
 #include "RawMetrics.h"
@@ -118,12 +119,56 @@ TEST_F(ServiceTest, handleRpc_undefinedType) {
             TestUtil::getStatus(&response));
     EXPECT_EQ(1U, metrics->rpc.illegalRpcCount);
 }
+TEST_F(ServiceTest, handleRpc_latencyMetrics) {
+    LatencyMetrics::reset();
+    auto* header = new(&request, APPEND) WireFormat::RequestCommon;
+    header->opcode = WireFormat::ILLEGAL_RPC_TYPE;
+    service.handleRpc(&rpc);
+
+    ProtoBuf::LatencyMetrics latency;
+    LatencyMetrics::serialize(latency);
+    const ProtoBuf::LatencyMetrics_Histogram* h = LatencyMetrics::find(
+            latency, "ILLEGAL_RPC_TYPE", LatencyMetrics::EXECUTE);
+    ASSERT_TRUE(h != NULL);
+    EXPECT_EQ(1U, LatencyMetrics::getCount(*h));
+
+    // Samples are no longer attributed to the RPC once it has finished.
+    LatencyMetrics::record(LatencyMetrics::LOG_APPEND, 100);
+    latency.Clear();
+    LatencyMetrics::serialize(latency);
+    EXPECT_EQ(1, latency.histogram_size());
+}
 TEST_F(ServiceTest, handleRpc_clientException) {
     MockService service;
     request.fillFromString("1 2 54321 3 4");
     service.handleRpc(&rpc);
     EXPECT_STREQ("STATUS_REQUEST_FORMAT_ERROR", TestUtil::getStatus(&response));
 }
+TEST_F(ServiceTest, handleRpc_retryException) {
+    MockService service;
+    request.fillFromString("1 2 54322 3 4");
+    service.handleRpc(&rpc);
+    EXPECT_STREQ("STATUS_RETRY", TestUtil::getStatus(&response));
+    const WireFormat::RetryResponse* retryResponse =
+        response.getStart<WireFormat::RetryResponse>();
+    ASSERT_TRUE(retryResponse != NULL);
+    EXPECT_EQ(sizeof(*retryResponse), response.getTotalLength());
+    EXPECT_EQ(100U, retryResponse->minDelayMicros);
+    EXPECT_EQ(200U, retryResponse->maxDelayMicros);
+}
+TEST_F(ServiceTest, handleRpc_retryStatusInHeader) {
+    // Mock service echoes back the first word incremented by one.
+    MockService service;
+    request.fillFromString("16 2 3 4");
+    service.handleRpc(&rpc);
+    EXPECT_STREQ("STATUS_RETRY", TestUtil::getStatus(&response));
+    const WireFormat::RetryResponse* retryResponse =
+        response.getStart<WireFormat::RetryResponse>();
+    ASSERT_TRUE(retryResponse != NULL);
+    EXPECT_EQ(sizeof(*retryResponse), response.getTotalLength());
+    EXPECT_EQ(0U, retryResponse->minDelayMicros);
+    EXPECT_EQ(0U, retryResponse->maxDelayMicros);
+}
 
 TEST_F(ServiceTest, prepareErrorResponse_bufferNotEmpty) {
     response.fillFromString("1 abcdef");
@@ -137,6 +182,16 @@ TEST_F(ServiceTest, prepareErrorResponse_bufferEmpty) {
     EXPECT_EQ(sizeof(WireFormat::ResponseCommon), response.getTotalLength());
     EXPECT_STREQ("STATUS_WRONG_VERSION", TestUtil::getStatus(&response));
 }
+TEST_F(ServiceTest, prepareRetryResponse) {
+    response.fillFromString("1 abcdef");
+    Service::prepareRetryResponse(&response, 500, 10);
+    EXPECT_EQ(sizeof(WireFormat::RetryResponse), response.getTotalLength());
+    EXPECT_STREQ("STATUS_RETRY", TestUtil::getStatus(&response));
+    const WireFormat::RetryResponse* retryResponse =
+        response.getStart<WireFormat::RetryResponse>();
+    EXPECT_EQ(500U, retryResponse->minDelayMicros);
+    EXPECT_EQ(500U, retryResponse->maxDelayMicros);
+}
 
 TEST_F(ServiceTest, callHandler_messageTooShort) {
     request.fillFromString("");
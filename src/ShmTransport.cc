@@ -0,0 +1,952 @@
+/* Copyright (c) 2013 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any purpose
+ * with or without fee is hereby granted, provided that the above copyright
+ * notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR ANY
+ * SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER
+ * RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF
+ * CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+ * CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "Common.h"
+#include "Cycles.h"
+#include "Fence.h"
+#include "ShortMacros.h"
+#include "ServiceManager.h"
+#include "ShmTransport.h"
+#include "WireFormat.h"
+
+namespace RAMCloud {
+
+/**
+ * Construct a ShmTransport instance.
+ *
+ * \param context
+ *      Overall information about the RAMCloud server or client.
+ * \param serviceLocator
+ *      If non-NULL this transport will be used to serve incoming
+ *      RPC requests as well as make outgoing requests; its "name" option
+ *      names the shared memory region that clients will open. If NULL this
+ *      transport will be used only for outgoing requests.
+ *
+ * \throw TransportException
+ *      There was a problem that prevented us from creating the transport.
+ */
+ShmTransport::ShmTransport(Context* context,
+        const ServiceLocator* serviceLocator)
+    : context(context)
+    , locatorString()
+    , shmName()
+    , region(NULL)
+    , serverChannels()
+    , lastChannelEvents(0)
+    , nextLivenessCheck(0)
+    , sessions()
+    , serverRpcPool()
+    , clientRpcPool()
+    , poller(this)
+{
+    if (serviceLocator == NULL)
+        return;
+    locatorString = serviceLocator->getOriginalString();
+    shmName = format("/ramcloud-%s",
+            serviceLocator->getOption<const char*>("name"));
+
+    // A region with this name may have been left behind by a server that
+    // crashed; take it over unless its server is still alive.
+    Region* old = NULL;
+    try {
+        old = mapRegion(shmName, false);
+    } catch (TransportException& e) {
+    }
+    if (old != NULL) {
+        bool inUse = (old->magic == REGION_MAGIC) &&
+                (kill(static_cast<pid_t>(old->serverPid), 0) == 0);
+        munmap(old, sizeof(Region));
+        if (inUse) {
+            string message = format("ShmTransport couldn't create '%s': "
+                    "another server is using it", shmName.c_str());
+            LOG(WARNING, "%s", message.c_str());
+            throw TransportException(HERE, message);
+        }
+        shm_unlink(shmName.c_str());
+    }
+
+    region = new(mapRegion(shmName, true)) Region;
+    region->serverPid = downCast<uint32_t>(getpid());
+    Fence::sfence();
+    region->magic = REGION_MAGIC;
+}
+
+/**
+ * Destructor for ShmTransports: remove the server's shared memory region
+ * and perform any other needed cleanup.
+ */
+ShmTransport::~ShmTransport()
+{
+    while (!sessions.empty())
+        sessions.front().close();
+    if (region != NULL) {
+        for (uint32_t i = 0; i < NUM_CHANNELS; i++) {
+            if (serverChannels[i].active)
+                closeChannel(i);
+        }
+        region->magic = 0;
+        munmap(region, sizeof(Region));
+        shm_unlink(shmName.c_str());
+        region = NULL;
+    }
+}
+
+/**
+ * Open (or create) a shared memory region and map it into our address
+ * space.
+ *
+ * \param shmName
+ *      Name of the POSIX shared memory object, such as "/ramcloud-foo".
+ * \param create
+ *      True means create a new object of the right size (it must not
+ *      already exist); false means open an existing one.
+ * \return
+ *      The address of the region; the caller must eventually munmap it.
+ *
+ * \throw TransportException
+ *      The object couldn't be opened or mapped.
+ */
+ShmTransport::Region*
+ShmTransport::mapRegion(const string& shmName, bool create)
+{
+    int fd = shm_open(shmName.c_str(),
+            create ? (O_RDWR|O_CREAT|O_EXCL) : O_RDWR, 0600);
+    if (fd == -1) {
+        throw TransportException(HERE, format(
+                "ShmTransport couldn't open '%s'", shmName.c_str()), errno);
+    }
+    if (create && ftruncate(fd, sizeof(Region)) != 0) {
+        int error = errno;
+        close(fd);
+        shm_unlink(shmName.c_str());
+        throw TransportException(HERE, format(
+                "ShmTransport couldn't size '%s'", shmName.c_str()), error);
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 ||
+            static_cast<size_t>(info.st_size) < sizeof(Region)) {
+        close(fd);
+        throw TransportException(HERE, format(
+                "ShmTransport found incomplete region '%s'", shmName.c_str()));
+    }
+    void* base = mmap(NULL, sizeof(Region), PROT_READ|PROT_WRITE,
+            MAP_SHARED, fd, 0);
+    int error = errno;
+    close(fd);
+    if (base == MAP_FAILED) {
+        throw TransportException(HERE, format(
+                "ShmTransport couldn't map '%s'", shmName.c_str()), error);
+    }
+    return static_cast<Region*>(base);
+}
+
+/**
+ * Copy as much of a message into a ring as there is room for.
+ *
+ * \param ring
+ *      The ring to produce into; the caller must be its only producer.
+ * \param nonce
+ *      Identifies the RPC that the message belongs to.
+ * \param message
+ *      The message to transmit.
+ * \param[in,out] bytesSent
+ *      The number of bytes of \a message that were transmitted by earlier
+ *      calls (0 for a new message); updated to reflect the bytes written
+ *      by this call.
+ * \return
+ *      True means the entire message is now in the ring; false means the
+ *      ring filled up, so this method must be invoked again later to
+ *      transmit the rest.
+ */
+bool
+ShmTransport::writeMessage(Ring* ring, uint64_t nonce, Buffer* message,
+        uint32_t* bytesSent)
+{
+    uint32_t totalLength = message->getTotalLength();
+    uint64_t head = ring->head.load();
+    uint64_t tail = ring->tail.load();
+    bool done = false;
+    do {
+        uint32_t length = std::min(totalLength - *bytesSent,
+                MAX_FRAGMENT_BYTES);
+        uint32_t needed = fragmentBytes(length);
+
+        // Fragments never wrap around the end of the ring; skip the
+        // remaining space if this one won't fit in it.
+        uint32_t position = downCast<uint32_t>(head % RING_BYTES);
+        uint32_t skip = 0;
+        if (position + needed > RING_BYTES)
+            skip = RING_BYTES - position;
+        if (head + skip + needed - tail > RING_BYTES) {
+            tail = ring->tail.load();
+            if (head + skip + needed - tail > RING_BYTES)
+                break;
+        }
+        if (skip >= sizeof(Header)) {
+            Header* padding = reinterpret_cast<Header*>(&ring->data[position]);
+            padding->nonce = 0;
+        }
+        head += skip;
+
+        Header* header = reinterpret_cast<Header*>(
+                &ring->data[head % RING_BYTES]);
+        header->nonce = nonce;
+        header->totalLength = totalLength;
+        header->offset = *bytesSent;
+        header->length = length;
+        message->copy(*bytesSent, length, header + 1);
+        head += needed;
+        *bytesSent += length;
+        done = (*bytesSent == totalLength);
+    } while (!done);
+
+    // Make sure the fragments are visible before the new head.
+    Fence::sfence();
+    ring->head.store(head);
+    return done;
+}
+
+/**
+ * This method is invoked when a client has closed a channel (or died).
+ * It discards all the server's pending work for the channel; the channel
+ * will be reset once its remaining RPCs have been destroyed.
+ *
+ * \param channelIndex
+ *      Index of the channel in region->channels.
+ */
+void
+ShmTransport::closeChannel(uint32_t channelIndex)
+{
+    ServerChannel& channel = serverChannels[channelIndex];
+    channel.closing = true;
+    if (channel.partial != NULL) {
+        serverRpcPool.destroy(channel.partial);
+        channel.partial = NULL;
+    }
+    while (!channel.repliesWaiting.empty()) {
+        ShmServerRpc& rpc = channel.repliesWaiting.front();
+        channel.repliesWaiting.pop_front();
+        serverRpcPool.destroy(&rpc);
+    }
+}
+
+/**
+ * Record that the server has read bytes of a request ring that aren't
+ * referenced by any request Buffer, so they can be released once all
+ * earlier bytes have been.
+ *
+ * \param channelIndex
+ *      Index of the channel in region->channels.
+ * \param bytes
+ *      The number of bytes at the channel's readPosition that were read.
+ */
+void
+ShmTransport::consumeRequestBytes(uint32_t channelIndex, uint32_t bytes)
+{
+    ServerChannel& channel = serverChannels[channelIndex];
+    channel.readPosition += bytes;
+    if (channel.consumed.empty()) {
+        region->channels[channelIndex].requests.tail.store(
+                channel.readPosition);
+    } else {
+        channel.consumed.push_back(ConsumedBytes(channel.readPosition,
+                false));
+    }
+}
+
+/**
+ * Record that the server has read bytes of a request ring that a request
+ * Buffer refers to; they will be released by releaseRequest.
+ *
+ * \param channelIndex
+ *      Index of the channel in region->channels.
+ * \param bytes
+ *      The number of bytes at the channel's readPosition that were read.
+ * \return
+ *      The sequence number to pass to releaseRequest.
+ */
+uint64_t
+ShmTransport::pinRequestBytes(uint32_t channelIndex, uint32_t bytes)
+{
+    ServerChannel& channel = serverChannels[channelIndex];
+    channel.readPosition += bytes;
+    channel.consumed.push_back(ConsumedBytes(channel.readPosition, true));
+    return channel.firstSequence + channel.consumed.size() - 1;
+}
+
+/**
+ * Server-side half of the poller: notice channels that clients have opened
+ * or closed, read incoming requests, and transmit replies that didn't fit
+ * in their response rings earlier.
+ */
+void
+ShmTransport::pollServer()
+{
+    uint32_t channelEvents = region->channelEvents.load();
+    if (channelEvents != lastChannelEvents ||
+            Cycles::rdtsc() >= nextLivenessCheck) {
+        lastChannelEvents = channelEvents;
+        scanChannels();
+    }
+    for (uint32_t i = 0; i < NUM_CHANNELS; i++) {
+        ServerChannel& channel = serverChannels[i];
+        if (!channel.active)
+            continue;
+        if (channel.closing) {
+            if (channel.outstandingRpcs == 0)
+                resetChannel(i);
+            continue;
+        }
+        readRequests(i);
+        if (!channel.repliesWaiting.empty())
+            sendWaitingReplies(i);
+    }
+}
+
+/**
+ * Read all of the complete fragments in a channel's request ring and
+ * pass finished requests to the ServiceManager. Requests that fit in a
+ * single fragment are passed on without copying them out of the ring.
+ *
+ * \param channelIndex
+ *      Index of the channel in region->channels.
+ */
+void
+ShmTransport::readRequests(uint32_t channelIndex)
+{
+    ServerChannel& channel = serverChannels[channelIndex];
+    Ring& ring = region->channels[channelIndex].requests;
+    uint64_t head = ring.head.load();
+    if (head == channel.readPosition)
+        return;
+    // Make sure the fragments are read after the head that covers them.
+    Fence::lfence();
+
+    while (channel.readPosition != head) {
+        uint32_t position = downCast<uint32_t>(channel.readPosition %
+                RING_BYTES);
+        uint32_t remaining = RING_BYTES - position;
+        if (remaining < sizeof(Header)) {
+            consumeRequestBytes(channelIndex, remaining);
+            continue;
+        }
+        Header* header = reinterpret_cast<Header*>(&ring.data[position]);
+        if (header->nonce == 0) {
+            consumeRequestBytes(channelIndex, remaining);
+            continue;
+        }
+        uint32_t length = header->length;
+        if (length > MAX_FRAGMENT_BYTES ||
+                fragmentBytes(length) > remaining ||
+                header->totalLength > MAX_RPC_LEN ||
+                header->offset + length > header->totalLength) {
+            LOG(WARNING, "ShmTransport closing channel %u: "
+                    "malformed request fragment", channelIndex);
+            closeChannel(channelIndex);
+            return;
+        }
+        char* data = reinterpret_cast<char*>(header + 1);
+
+        if (header->offset == 0 && length == header->totalLength &&
+                length > 0) {
+            // The common case: the entire request is in one fragment, so
+            // the service can read it directly from the ring.
+            ShmServerRpc* rpc = serverRpcPool.construct(*this, channelIndex,
+                    header->nonce);
+            uint64_t sequence = pinRequestBytes(channelIndex,
+                    fragmentBytes(length));
+            RequestChunk::appendToBuffer(&rpc->requestPayload, data, length,
+                    this, channelIndex, sequence);
+            context->serviceManager->handleRpc(rpc);
+            continue;
+        }
+
+        // Copy multi-fragment requests out of the ring, so that a large
+        // request can stream through the ring.
+        if (header->offset == 0) {
+            if (channel.partial != NULL) {
+                // The client canceled the previous request part way
+                // through sending it.
+                serverRpcPool.destroy(channel.partial);
+            }
+            channel.partial = serverRpcPool.construct(*this, channelIndex,
+                    header->nonce);
+        }
+        ShmServerRpc* rpc = channel.partial;
+        if (rpc != NULL && rpc->nonce == header->nonce &&
+                rpc->requestPayload.getTotalLength() == header->offset) {
+            if (length > 0) {
+                memcpy(new(&rpc->requestPayload, APPEND) char[length], data,
+                        length);
+            }
+            if (header->offset + length == header->totalLength) {
+                channel.partial = NULL;
+                context->serviceManager->handleRpc(rpc);
+            }
+        }
+        consumeRequestBytes(channelIndex, fragmentBytes(length));
+    }
+}
+
+/**
+ * This method is invoked when a request Buffer that refers to a request
+ * ring is destroyed; it releases as much of the ring as possible.
+ *
+ * \param channelIndex
+ *      Index of the channel in region->channels.
+ * \param sequence
+ *      The value returned by pinRequestBytes for the request.
+ */
+void
+ShmTransport::releaseRequest(uint32_t channelIndex, uint64_t sequence)
+{
+    ServerChannel& channel = serverChannels[channelIndex];
+    channel.consumed[sequence - channel.firstSequence].pinned = false;
+    uint64_t tail = 0;
+    while (!channel.consumed.empty() && !channel.consumed.front().pinned) {
+        tail = channel.consumed.front().end;
+        channel.consumed.pop_front();
+        channel.firstSequence++;
+    }
+    if (tail != 0)
+        region->channels[channelIndex].requests.tail.store(tail);
+}
+
+/**
+ * Return a channel to the FREE state so that another client can claim it.
+ * Must not be invoked until all of the channel's RPCs have been destroyed.
+ *
+ * \param channelIndex
+ *      Index of the channel in region->channels.
+ */
+void
+ShmTransport::resetChannel(uint32_t channelIndex)
+{
+    Channel& shared = region->channels[channelIndex];
+    serverChannels[channelIndex].reset();
+    shared.requests.head.store(0);
+    shared.requests.tail.store(0);
+    shared.responses.head.store(0);
+    shared.responses.tail.store(0);
+    shared.clientPid = 0;
+    Fence::sfence();
+    shared.state.store(FREE);
+}
+
+/**
+ * Compare the state of each channel in the region with the server's view
+ * of it: start polling channels that clients have opened, and close
+ * channels whose clients have closed them or died.
+ */
+void
+ShmTransport::scanChannels()
+{
+    bool checkLiveness = Cycles::rdtsc() >= nextLivenessCheck;
+    if (checkLiveness) {
+        nextLivenessCheck = Cycles::rdtsc() +
+                Cycles::fromNanoseconds(LIVENESS_CHECK_MS * 1000000UL);
+    }
+    for (uint32_t i = 0; i < NUM_CHANNELS; i++) {
+        Channel& shared = region->channels[i];
+        ServerChannel& channel = serverChannels[i];
+        uint32_t state = shared.state.load();
+        if (!channel.active) {
+            if (state == OPEN) {
+                Fence::lfence();
+                channel.active = true;
+                channel.clientPid = shared.clientPid;
+            }
+            continue;
+        }
+        if (channel.closing)
+            continue;
+        if (state == CLOSED) {
+            closeChannel(i);
+        } else if (checkLiveness &&
+                kill(static_cast<pid_t>(channel.clientPid), 0) != 0 &&
+                errno == ESRCH) {
+            LOG(NOTICE, "ShmTransport closing channel %u: client process "
+                    "%u has exited", i, channel.clientPid);
+            closeChannel(i);
+        }
+    }
+}
+
+/**
+ * Transmit as many of a channel's waiting replies as will fit in its
+ * response ring.
+ *
+ * \param channelIndex
+ *      Index of the channel in region->channels.
+ */
+void
+ShmTransport::sendWaitingReplies(uint32_t channelIndex)
+{
+    ServerChannel& channel = serverChannels[channelIndex];
+    Ring* ring = &region->channels[channelIndex].responses;
+    while (!channel.repliesWaiting.empty()) {
+        ShmServerRpc& rpc = channel.repliesWaiting.front();
+        if (!writeMessage(ring, rpc.nonce, &rpc.replyPayload,
+                &channel.bytesSent))
+            return;
+        channel.repliesWaiting.pop_front();
+        channel.bytesSent = 0;
+        serverRpcPool.destroy(&rpc);
+    }
+}
+
+/**
+ * Invoked by the dispatcher on each pass through its polling loop.
+ */
+void
+ShmTransport::Poller::poll()
+{
+    if (transport->region != NULL)
+        transport->pollServer();
+    foreach (ShmSession& session, transport->sessions)
+        session.poll();
+}
+
+//-------------------------------------
+// ShmTransport::RequestChunk class
+//-------------------------------------
+
+/**
+ * Append a request that is stored in a request ring to a Buffer; the
+ * ring space is released when the Buffer is destroyed.
+ *
+ * \param buffer
+ *      The Buffer to append the data to.
+ * \param data
+ *      The address of the request in the ring.
+ * \param dataLength
+ *      The length of the request in bytes.
+ * \param transport
+ *      The transport that owns the ring.
+ * \param channelIndex
+ *      Index of the channel that owns the ring.
+ * \param sequence
+ *      Value returned by pinRequestBytes for the request.
+ */
+ShmTransport::RequestChunk*
+ShmTransport::RequestChunk::appendToBuffer(Buffer* buffer, char* data,
+        uint32_t dataLength, ShmTransport* transport, uint32_t channelIndex,
+        uint64_t sequence)
+{
+    RequestChunk* chunk = new(buffer, CHUNK) RequestChunk(data, dataLength,
+            transport, channelIndex, sequence);
+    Buffer::Chunk::appendChunkToBuffer(buffer, chunk);
+    return chunk;
+}
+
+/// Returns the ring space to the client once the Chunk is discarded.
+ShmTransport::RequestChunk::~RequestChunk()
+{
+    // As in InfRcTransport, the Buffer may be destroyed by a worker, so
+    // take the Dispatch lock before touching the transport.
+    Dispatch::Lock lock(transport->context->dispatch);
+    transport->releaseRequest(channelIndex, sequence);
+}
+
+/**
+ * Construct a RequestChunk; see appendToBuffer for the parameters.
+ */
+ShmTransport::RequestChunk::RequestChunk(char* data, uint32_t dataLength,
+        ShmTransport* transport, uint32_t channelIndex, uint64_t sequence)
+    : Buffer::Chunk(data, dataLength)
+    , transport(transport)
+    , channelIndex(channelIndex)
+    , sequence(sequence)
+{
+}
+
+//-------------------------------------
+// ShmTransport::ServerChannel class
+//-------------------------------------
+
+/**
+ * Construct a ServerChannel for a channel that no client has opened.
+ */
+ShmTransport::ServerChannel::ServerChannel()
+    : active(false)
+    , closing(false)
+    , clientPid(0)
+    , readPosition(0)
+    , consumed()
+    , firstSequence(0)
+    , partial(NULL)
+    , repliesWaiting()
+    , bytesSent(0)
+    , outstandingRpcs(0)
+{
+}
+
+/**
+ * Forget everything about the channel's previous client.
+ */
+void
+ShmTransport::ServerChannel::reset()
+{
+    assert(outstandingRpcs == 0);
+    active = false;
+    closing = false;
+    clientPid = 0;
+    readPosition = 0;
+    consumed.clear();
+    firstSequence = 0;
+    bytesSent = 0;
+}
+
+//-------------------------------------
+// ShmTransport::ShmServerRpc class
+//-------------------------------------
+
+/**
+ * Construct a ShmServerRpc.
+ *
+ * \param transport
+ *      The transport that received the request.
+ * \param channelIndex
+ *      Index of the channel on which the request arrived.
+ * \param nonce
+ *      Copied from the request; identifies the RPC to the client.
+ */
+ShmTransport::ShmServerRpc::ShmServerRpc(ShmTransport& transport,
+        uint32_t channelIndex, uint64_t nonce)
+    : transport(transport)
+    , channelIndex(channelIndex)
+    , nonce(nonce)
+    , queueEntries()
+{
+    transport.serverChannels[channelIndex].outstandingRpcs++;
+}
+
+ShmTransport::ShmServerRpc::~ShmServerRpc()
+{
+    transport.serverChannels[channelIndex].outstandingRpcs--;
+}
+
+/**
+ * Transmit the reply for a request to the client, or queue it if there
+ * isn't room in the response ring.
+ */
+void
+ShmTransport::ShmServerRpc::sendReply()
+{
+    ServerChannel& channel = transport.serverChannels[channelIndex];
+    if (channel.closing) {
+        // The client has gone away.
+        transport.serverRpcPool.destroy(this);
+        return;
+    }
+    if (channel.repliesWaiting.empty()) {
+        Ring* ring = &transport.region->channels[channelIndex].responses;
+        channel.bytesSent = 0;
+        if (writeMessage(ring, nonce, &replyPayload, &channel.bytesSent)) {
+            transport.serverRpcPool.destroy(this);
+            return;
+        }
+    }
+    channel.repliesWaiting.push_back(*this);
+}
+
+// See Transport::ServerRpc::getClientServiceLocator for documentation.
+string
+ShmTransport::ShmServerRpc::getClientServiceLocator()
+{
+    return format("shm:pid=%u",
+            transport.serverChannels[channelIndex].clientPid);
+}
+
+//-------------------------------------
+// ShmTransport::ShmSession class
+//-------------------------------------
+
+/**
+ * Construct a ShmSession object for communication with a given server.
+ *
+ * \param transport
+ *      The transport with which this session is associated.
+ * \param serviceLocator
+ *      Identifies the server to which RPCs on this session will be sent.
+ * \param timeoutMs
+ *      If there is an active RPC and we can't get any signs of life out
+ *      of the server within this many milliseconds then the session will
+ *      be aborted.  0 means we get to pick a reasonable default.
+ *
+ * \throw TransportException
+ *      The server isn't running on this machine, or has no free channels.
+ */
+ShmTransport::ShmSession::ShmSession(ShmTransport& transport,
+        const ServiceLocator& serviceLocator,
+        uint32_t timeoutMs)
+    : transport(transport)
+    , region(NULL)
+    , channel(NULL)
+    , serial(1)
+    , rpcsWaitingToSend()
+    , bytesSent(0)
+    , rpcsWaitingForResponse()
+    , current(NULL)
+    , sessionEntries()
+    , alarm(transport.context->sessionAlarmTimer, this,
+            (timeoutMs != 0) ? timeoutMs : DEFAULT_TIMEOUT_MS)
+{
+    setServiceLocator(serviceLocator.getOriginalString());
+    if (serviceLocator.hasOption("host")) {
+        char hostName[256];
+        if (gethostname(hostName, sizeof(hostName)) != 0 ||
+                serviceLocator.getOption("host") != hostName) {
+            throw TransportException(HERE, format(
+                    "ShmTransport can't reach %s from this host",
+                    getServiceLocator().c_str()));
+        }
+    }
+    string shmName = format("/ramcloud-%s",
+            serviceLocator.getOption<const char*>("name"));
+    Region* newRegion = mapRegion(shmName, false);
+    if (newRegion->magic != REGION_MAGIC ||
+            kill(static_cast<pid_t>(newRegion->serverPid), 0) != 0) {
+        munmap(newRegion, sizeof(Region));
+        throw TransportException(HERE, format(
+                "ShmTransport found no server for %s",
+                getServiceLocator().c_str()));
+    }
+    for (uint32_t i = 0; i < NUM_CHANNELS; i++) {
+        Channel* candidate = &newRegion->channels[i];
+        if (candidate->state.compareExchange(FREE, CLAIMED) == FREE) {
+            candidate->clientPid = downCast<uint32_t>(getpid());
+            Fence::sfence();
+            candidate->state.store(OPEN);
+            newRegion->channelEvents.inc();
+            channel = candidate;
+            break;
+        }
+    }
+    if (channel == NULL) {
+        munmap(newRegion, sizeof(Region));
+        LOG(WARNING, "ShmTransport couldn't open session to %s: "
+                "no free channels", getServiceLocator().c_str());
+        throw TransportException(HERE, format(
+                "ShmTransport has no free channels for %s",
+                getServiceLocator().c_str()));
+    }
+    region = newRegion;
+
+    Dispatch::Lock lock(transport.context->dispatch);
+    transport.sessions.push_back(*this);
+}
+
+/**
+ * Destructor for ShmSession objects.
+ */
+ShmTransport::ShmSession::~ShmSession()
+{
+    close();
+}
+
+// See documentation for Transport::Session::abort.
+void
+ShmTransport::ShmSession::abort()
+{
+    close();
+}
+
+// See Transport::Session::cancelRequest for documentation.
+void
+ShmTransport::ShmSession::cancelRequest(RpcNotifier* notifier)
+{
+    // Search for an RPC that refers to this notifier; if one is
+    // found then remove all state relating to it. The rest of its
+    // response (or request) is simply dropped by the other side, since
+    // no RPC matches it any more.
+    foreach (ShmClientRpc& rpc, rpcsWaitingForResponse) {
+        if (rpc.notifier == notifier) {
+            rpcsWaitingForResponse.erase(
+                    rpcsWaitingForResponse.iterator_to(rpc));
+            if (&rpc == current)
+                current = NULL;
+            transport.clientRpcPool.destroy(&rpc);
+            alarm.rpcFinished();
+            return;
+        }
+    }
+    foreach (ShmClientRpc& rpc, rpcsWaitingToSend) {
+        if (rpc.notifier == notifier) {
+            if (&rpc == &rpcsWaitingToSend.front())
+                bytesSent = 0;
+            rpcsWaitingToSend.erase(
+                    rpcsWaitingToSend.iterator_to(rpc));
+            transport.clientRpcPool.destroy(&rpc);
+            alarm.rpcFinished();
+            return;
+        }
+    }
+}
+
+/**
+ * Release the session's channel and fail any RPCs in progress.
+ */
+void
+ShmTransport::ShmSession::close()
+{
+    if (region != NULL) {
+        Dispatch::Lock lock(transport.context->dispatch);
+        transport.sessions.erase(transport.sessions.iterator_to(*this));
+        channel->state.store(CLOSED);
+        region->channelEvents.inc();
+        munmap(region, sizeof(Region));
+        region = NULL;
+        channel = NULL;
+    }
+    current = NULL;
+    while (!rpcsWaitingForResponse.empty()) {
+        ShmClientRpc& rpc = rpcsWaitingForResponse.front();
+        rpc.notifier->failed();
+        rpcsWaitingForResponse.pop_front();
+        transport.clientRpcPool.destroy(&rpc);
+        alarm.rpcFinished();
+    }
+    while (!rpcsWaitingToSend.empty()) {
+        ShmClientRpc& rpc = rpcsWaitingToSend.front();
+        rpc.notifier->failed();
+        rpcsWaitingToSend.pop_front();
+        transport.clientRpcPool.destroy(&rpc);
+        alarm.rpcFinished();
+    }
+}
+
+// See Transport::Session::getRpcInfo for documentation.
+string
+ShmTransport::ShmSession::getRpcInfo()
+{
+    const char* separator = "";
+    string result;
+    foreach (ShmClientRpc& rpc, rpcsWaitingForResponse) {
+        result += separator;
+        result += WireFormat::opcodeSymbol(rpc.request);
+        separator = ", ";
+    }
+    foreach (ShmClientRpc& rpc, rpcsWaitingToSend) {
+        result += separator;
+        result += WireFormat::opcodeSymbol(rpc.request);
+        separator = ", ";
+    }
+    if (result.empty())
+        result = "no active RPCs";
+    result += " to server at ";
+    result += getServiceLocator();
+    return result;
+}
+
+/**
+ * Invoked by the transport's poller: transmit requests that didn't fit in
+ * the request ring earlier, and collect any responses.
+ */
+void
+ShmTransport::ShmSession::poll()
+{
+    while (!rpcsWaitingToSend.empty()) {
+        ShmClientRpc& rpc = rpcsWaitingToSend.front();
+        if (!writeMessage(&channel->requests, rpc.nonce, rpc.request,
+                &bytesSent))
+            break;
+        rpcsWaitingToSend.pop_front();
+        rpcsWaitingForResponse.push_back(rpc);
+        bytesSent = 0;
+    }
+
+    Ring& ring = channel->responses;
+    uint64_t head = ring.head.load();
+    uint64_t tail = ring.tail.load();
+    if (head == tail)
+        return;
+    // Make sure the fragments are read after the head that covers them.
+    Fence::lfence();
+
+    // Responses are copied out of the ring immediately: applications may
+    // hold on to response Buffers indefinitely, which would stall the ring.
+    while (tail != head) {
+        uint32_t position = downCast<uint32_t>(tail % RING_BYTES);
+        uint32_t remaining = RING_BYTES - position;
+        Header* header = reinterpret_cast<Header*>(&ring.data[position]);
+        if (remaining < sizeof(Header) || header->nonce == 0) {
+            tail += remaining;
+            continue;
+        }
+        uint32_t length = header->length;
+        if (header->offset == 0) {
+            current = NULL;
+            foreach (ShmClientRpc& rpc, rpcsWaitingForResponse) {
+                if (rpc.nonce == header->nonce) {
+                    current = &rpc;
+                    break;
+                }
+            }
+        }
+        if (current != NULL && current->nonce == header->nonce) {
+            if (length > 0) {
+                memcpy(new(current->response, APPEND) char[length],
+                        header + 1, length);
+            }
+            if (header->offset + length == header->totalLength) {
+                ShmClientRpc* rpc = current;
+                current = NULL;
+                rpcsWaitingForResponse.erase(
+                        rpcsWaitingForResponse.iterator_to(*rpc));
+                alarm.rpcFinished();
+                rpc->notifier->completed();
+                transport.clientRpcPool.destroy(rpc);
+            }
+        }
+        tail += fragmentBytes(length);
+    }
+    ring.tail.store(tail);
+}
+
+// See Transport::Session::sendRequest for documentation.
+void
+ShmTransport::ShmSession::sendRequest(Buffer* request, Buffer* response,
+        RpcNotifier* notifier)
+{
+    response->reset();
+    if (region == NULL) {
+        notifier->failed();
+        return;
+    }
+    alarm.rpcStarted();
+    ShmClientRpc* rpc = transport.clientRpcPool.construct(request, response,
+            notifier, serial);
+    serial++;
+    if (rpcsWaitingToSend.empty()) {
+        bytesSent = 0;
+        if (writeMessage(&channel->requests, rpc->nonce, request,
+                &bytesSent)) {
+            // The whole request fit in the ring (this should be the
+            // common case).
+            rpcsWaitingForResponse.push_back(*rpc);
+            return;
+        }
+    }
+    rpcsWaitingToSend.push_back(*rpc);
+}
+
+}  // namespace RAMCloud
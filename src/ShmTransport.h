@@ -0,0 +1,460 @@
+/* Copyright (c) 2013 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any purpose
+ * with or without fee is hereby granted, provided that the above copyright
+ * notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR ANY
+ * SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER
+ * RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF
+ * CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+ * CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef RAMCLOUD_SHMTRANSPORT_H
+#define RAMCLOUD_SHMTRANSPORT_H
+
+#include <deque>
+
+#include "Atomic.h"
+#include "BoostIntrusive.h"
+#include "Dispatch.h"
+#include "ObjectPool.h"
+#include "ServerRpcPool.h"
+#include "SessionAlarm.h"
+#include "Transport.h"
+
+namespace RAMCloud {
+
+/**
+ * A transport for clients that run on the same machine as the server they
+ * talk to. The server creates a POSIX shared memory region named after the
+ * "name" option of its service locator, and each client session claims a
+ * channel in that region. A channel consists of two single-producer
+ * single-consumer rings, one for requests and one for responses, so
+ * messages cross the process boundary without system calls or locks: both
+ * sides simply poll the rings from their dispatch threads. Requests are
+ * handed to services as Buffer chunks that refer directly to the ring, and
+ * the ring space is reclaimed once those Buffers are destroyed.
+ *
+ * Service locators have the form "shm: name=foo". The optional "host"
+ * option names the machine running the server; sessions can't be opened
+ * from any other machine, so a locator such as
+ * "shm: name=foo,host=rc01;tcp: host=rc01,port=12246" lets local clients
+ * use shared memory while remote clients fall back to TCP.
+ */
+class ShmTransport : public Transport {
+  public:
+    explicit ShmTransport(Context* context,
+            const ServiceLocator* serviceLocator = NULL);
+    ~ShmTransport();
+    SessionRef getSession(const ServiceLocator& serviceLocator,
+            uint32_t timeoutMs = 0) {
+        return new ShmSession(*this, serviceLocator, timeoutMs);
+    }
+    string getServiceLocator() {
+        return locatorString;
+    }
+    void registerMemory(void* base, size_t bytes) {}
+
+    class ShmServerRpc;
+  PRIVATE:
+    class ShmSession;
+
+    /// The number of client sessions that a server can have open at once.
+    static const uint32_t NUM_CHANNELS = 16;
+
+    /// The size of the data area in each ring, in bytes.
+    static const uint32_t RING_BYTES = 1 << 20;
+
+    /// The largest payload carried by a single fragment. Longer messages
+    /// are split into several fragments, so that a large message can
+    /// stream through a ring while the other side consumes it.
+    static const uint32_t MAX_FRAGMENT_BYTES = RING_BYTES / 4;
+
+    /// Stored in Region::magic once a server has initialized a region.
+    static const uint64_t REGION_MAGIC = 0x52414d4353484d31UL;
+
+    /// How often a server checks that the clients of its open channels
+    /// are still alive.
+    static const uint32_t LIVENESS_CHECK_MS = 100;
+
+    /**
+     * Precedes each fragment of a message in a ring. The fragments of a
+     * message are always adjacent in the ring.
+     */
+    struct Header {
+        /// Unique identifier for this RPC: generated on the client, and
+        /// returned by the server in responses. 0 means this header marks
+        /// unused space at the end of the ring, which should be skipped.
+        uint64_t nonce;
+
+        /// The size in bytes of the entire message. Must be less than or
+        /// equal to #MAX_RPC_LEN.
+        uint32_t totalLength;
+
+        /// Offset within the message of the first byte in this fragment.
+        uint32_t offset;
+
+        /// The number of bytes of message data in this fragment (they
+        /// follow the header immediately).
+        uint32_t length;
+
+        uint32_t unused;
+    };
+
+    /**
+     * A single-producer single-consumer queue of message fragments.
+     * The producer and consumer positions increase monotonically and are
+     * taken modulo RING_BYTES to index data; they live on separate cache
+     * lines so that the two processes don't fight over a line on every
+     * message.
+     */
+    struct Ring {
+        /// Total number of bytes ever added to the ring; written only by
+        /// the producer.
+        Atomic<uint64_t> head;
+        char pad1[CACHE_LINE_SIZE - sizeof(Atomic<uint64_t>)];
+
+        /// Total number of bytes ever released by the consumer; written
+        /// only by the consumer. Everything between tail and head is
+        /// either unread or still referenced by the consumer.
+        Atomic<uint64_t> tail;
+        char pad2[CACHE_LINE_SIZE - sizeof(Atomic<uint64_t>)];
+
+        /// Fragments (a Header followed by message data, padded to a
+        /// multiple of 8 bytes).
+        char data[RING_BYTES];
+    };
+
+    /// Values for Channel::state.
+    enum ChannelState {
+        FREE    = 0,          // Available for a client to claim.
+        CLAIMED = 1,          // A client is initializing the channel.
+        OPEN    = 2,          // A client session is using the channel.
+        CLOSED  = 3,          // The client is done; the server hasn't
+                              // reclaimed the channel yet.
+    };
+
+    /**
+     * The state shared between one client session and the server.
+     */
+    struct Channel {
+        /// One of the values of ChannelState. Clients move channels from
+        /// FREE to CLAIMED to OPEN and from OPEN to CLOSED; the server moves
+        /// them back to FREE once all of its RPCs for the channel are done.
+        Atomic<uint32_t> state;
+
+        /// Process id of the client that owns this channel, so that the
+        /// server can reclaim the channel if the client dies.
+        uint32_t clientPid;
+        char pad[CACHE_LINE_SIZE - 2 * sizeof(uint32_t)];
+
+        /// Requests from the client to the server.
+        Ring requests;
+
+        /// Responses from the server to the client.
+        Ring responses;
+    };
+
+    /**
+     * The layout of the shared memory region created by a server.
+     */
+    struct Region {
+        /// REGION_MAGIC once the server has initialized the region.
+        uint64_t magic;
+
+        /// Process id of the server, so that clients can ignore regions
+        /// left behind by servers that crashed.
+        uint32_t serverPid;
+
+        /// Incremented by clients whenever they open or close a channel,
+        /// so that the server only needs to scan channel states when
+        /// something has changed.
+        Atomic<uint32_t> channelEvents;
+        char pad[CACHE_LINE_SIZE - 2 * sizeof(uint64_t)];
+
+        Channel channels[NUM_CHANNELS];
+    };
+
+    /**
+     * Describes a part of a request ring that the server has read but not
+     * yet released.
+     */
+    struct ConsumedBytes {
+        ConsumedBytes(uint64_t end, bool pinned)
+            : end(end), pinned(pinned) {}
+
+        /// Ring position just after the last byte of this part.
+        uint64_t end;
+
+        /// True means a request Buffer still refers to these bytes.
+        bool pinned;
+    };
+
+  public:
+    /**
+     * The shared memory implementation of Transport::ServerRpc.
+     */
+    class ShmServerRpc : public Transport::ServerRpc {
+      friend class ShmTransport;
+      friend class ObjectPool<ShmServerRpc>;     // Since constructor is private
+      public:
+        virtual ~ShmServerRpc();
+        void sendReply();
+        string getClientServiceLocator();
+      PRIVATE:
+        ShmServerRpc(ShmTransport& transport, uint32_t channelIndex,
+                uint64_t nonce);
+
+        ShmTransport& transport;  /// The parent ShmTransport object.
+        uint32_t channelIndex;    /// Channel on which the request arrived.
+        uint64_t nonce;           /// Copied from the request header; must
+                                  /// be returned in the response.
+        IntrusiveListHook queueEntries;
+                                  /// Used to link this RPC onto the
+                                  /// repliesWaiting list of its channel.
+        DISALLOW_COPY_AND_ASSIGN(ShmServerRpc);
+    };
+
+    /**
+     * The shared memory implementation of Transport::ClientRpc.
+     */
+    class ShmClientRpc {
+      public:
+        friend class ShmTransport;
+        friend class ShmSession;
+        explicit ShmClientRpc(Buffer* request, Buffer* response,
+                RpcNotifier* notifier, uint64_t nonce)
+            : request(request)
+            , response(response)
+            , notifier(notifier)
+            , nonce(nonce)
+            , queueEntries()
+        { }
+
+      PRIVATE:
+        Buffer* request;          /// Request message for the RPC.
+        Buffer* response;         /// Will eventually hold the response message.
+        RpcNotifier* notifier;    /// Use this object to report completion.
+        uint64_t nonce;           /// Unique identifier for this RPC; used
+                                  /// to pair the RPC with its response.
+        IntrusiveListHook queueEntries;
+                                  /// Used to link this RPC onto the
+                                  /// rpcsWaitingToSend and
+                                  /// rpcsWaitingForResponse lists of session.
+        DISALLOW_COPY_AND_ASSIGN(ShmClientRpc);
+    };
+
+  PRIVATE:
+    /**
+     * A Buffer chunk that refers directly to a request in a ring; the
+     * ring space is released when the chunk's Buffer is destroyed.
+     */
+    class RequestChunk : public Buffer::Chunk {
+      public:
+        static RequestChunk* appendToBuffer(Buffer* buffer, char* data,
+                uint32_t dataLength, ShmTransport* transport,
+                uint32_t channelIndex, uint64_t sequence);
+        ~RequestChunk();
+
+      private:
+        RequestChunk(char* data, uint32_t dataLength,
+                ShmTransport* transport, uint32_t channelIndex,
+                uint64_t sequence);
+
+        ShmTransport* transport;
+        uint32_t channelIndex;
+
+        /// Identifies this request's entry in the channel's consumed list.
+        uint64_t sequence;
+
+        DISALLOW_COPY_AND_ASSIGN(RequestChunk);
+    };
+
+    /**
+     * The server's private information about one channel.
+     */
+    class ServerChannel {
+      public:
+        ServerChannel();
+        void reset();
+
+        /// True means a client has opened this channel, so the server
+        /// should poll its request ring.
+        bool active;
+
+        /// True means the client has gone away; the channel will be
+        /// reset once all of its RPCs have been destroyed.
+        bool closing;
+
+        /// Copied from Channel::clientPid when the channel opened.
+        uint32_t clientPid;
+
+        /// Position in the request ring of the next fragment to read.
+        uint64_t readPosition;
+
+        /// Parts of the request ring between its tail and readPosition,
+        /// in ring order; the tail moves forward past the front entries
+        /// once they are no longer pinned.
+        std::deque<ConsumedBytes> consumed;
+
+        /// Sequence number of the entry at the front of consumed.
+        uint64_t firstSequence;
+
+        /// A request whose fragments are being copied out of the ring,
+        /// or NULL if none.
+        ShmServerRpc* partial;
+
+        INTRUSIVE_LIST_TYPEDEF(ShmServerRpc, queueEntries) ServerRpcList;
+        ServerRpcList repliesWaiting;
+                                  /// RPCs whose responses didn't fit in the
+                                  /// response ring. The front RPC on this
+                                  /// list is currently being transmitted.
+        uint32_t bytesSent;       /// The number of bytes of the front RPC
+                                  /// on repliesWaiting already transmitted.
+        uint32_t outstandingRpcs; /// The number of ShmServerRpcs for this
+                                  /// channel that haven't been destroyed.
+        DISALLOW_COPY_AND_ASSIGN(ServerChannel);
+    };
+
+    /**
+     * The shared memory implementation of Sessions (stored on a client to
+     * manage its interactions with a particular server).
+     */
+    class ShmSession : public Session {
+      friend class ShmTransport;
+      public:
+        explicit ShmSession(ShmTransport& transport,
+                const ServiceLocator& serviceLocator,
+                uint32_t timeoutMs = 0);
+        ~ShmSession();
+        virtual void abort();
+        virtual void cancelRequest(RpcNotifier* notifier);
+        virtual string getRpcInfo();
+        virtual void sendRequest(Buffer* request, Buffer* response,
+                RpcNotifier* notifier);
+      PRIVATE:
+        void close();
+        void poll();
+
+        ShmTransport& transport;  /// Transport that owns this session.
+        Region* region;           /// The server's shared memory region,
+                                  /// or NULL if the session has been closed.
+        Channel* channel;         /// The channel in region owned by this
+                                  /// session.
+        uint64_t serial;          /// Used to generate nonces for RPCs: starts
+                                  /// at 1 and increments for each RPC.
+
+        INTRUSIVE_LIST_TYPEDEF(ShmClientRpc, queueEntries) ClientRpcList;
+        ClientRpcList rpcsWaitingToSend;
+                                  /// RPCs whose request messages didn't fit
+                                  /// in the request ring. The front RPC on
+                                  /// this list is currently being
+                                  /// transmitted.
+        uint32_t bytesSent;       /// The number of bytes of the front RPC on
+                                  /// rpcsWaitingToSend already transmitted.
+        ClientRpcList rpcsWaitingForResponse;
+                                  /// RPCs whose request messages have been
+                                  /// transmitted, but whose responses have
+                                  /// not yet been received.
+        ShmClientRpc* current;    /// RPC for which we are currently receiving
+                                  /// a multi-fragment response (NULL if
+                                  /// none).
+        IntrusiveListHook sessionEntries;
+                                  /// Used to link this session onto the
+                                  /// sessions list of the transport.
+        SessionAlarm alarm;       /// Used to detect server timeouts.
+        DISALLOW_COPY_AND_ASSIGN(ShmSession);
+    };
+
+    /**
+     * This class (and its instance below) connect with the dispatcher's
+     * polling mechanism so that we get invoked each time through the polling
+     * loop to check the rings for incoming messages.
+     */
+    class Poller : public Dispatch::Poller {
+      public:
+        explicit Poller(ShmTransport* transport)
+            : Dispatch::Poller(*transport->context->dispatch,
+                               "ShmTransport::Poller")
+            , transport(transport) {}
+        virtual void poll();
+
+      private:
+        /// Check this transport's rings every time we are invoked.
+        ShmTransport* transport;
+        DISALLOW_COPY_AND_ASSIGN(Poller);
+    };
+
+    static Region* mapRegion(const string& shmName, bool create);
+    static bool writeMessage(Ring* ring, uint64_t nonce, Buffer* message,
+            uint32_t* bytesSent);
+    void closeChannel(uint32_t channelIndex);
+    void consumeRequestBytes(uint32_t channelIndex, uint32_t bytes);
+    uint64_t pinRequestBytes(uint32_t channelIndex, uint32_t bytes);
+    void pollServer();
+    void readRequests(uint32_t channelIndex);
+    void releaseRequest(uint32_t channelIndex, uint64_t sequence);
+    void resetChannel(uint32_t channelIndex);
+    void scanChannels();
+    void sendWaitingReplies(uint32_t channelIndex);
+
+    /**
+     * Returns the number of ring bytes occupied by a fragment carrying
+     * \a length bytes of message data.
+     */
+    static uint32_t
+    fragmentBytes(uint32_t length)
+    {
+        return (sizeof32(Header) + length + 7) & ~7U;
+    }
+
+    /// Shared RAMCloud information.
+    Context* context;
+
+    /// Service locator used to create the server's region (empty string if
+    /// this isn't a server).
+    string locatorString;
+
+    /// Name of the server's shared memory object, e.g. "/ramcloud-foo"
+    /// (empty string if this isn't a server).
+    string shmName;
+
+    /// The server's shared memory region, or NULL if this instance is not
+    /// a server.
+    Region* region;
+
+    /// The server's private information about each channel of region.
+    ServerChannel serverChannels[NUM_CHANNELS];
+
+    /// The value of region->channelEvents the last time the server
+    /// scanned the channel states.
+    uint32_t lastChannelEvents;
+
+    /// Cycles::rdtsc() time at which the server should next check that the
+    /// clients of its open channels are alive.
+    uint64_t nextLivenessCheck;
+
+    /// Client sessions that are open; the poller checks each of their
+    /// response rings.
+    INTRUSIVE_LIST_TYPEDEF(ShmSession, sessionEntries) SessionList;
+    SessionList sessions;
+
+    /// Pool allocator for our ServerRpc objects.
+    ServerRpcPool<ShmServerRpc> serverRpcPool;
+
+    /// Pool allocator for ShmClientRpc objects.
+    ObjectPool<ShmClientRpc> clientRpcPool;
+
+    /// Used to poll the rings from the dispatch thread.
+    Poller poller;
+
+    DISALLOW_COPY_AND_ASSIGN(ShmTransport);
+};
+
+}  // namespace RAMCloud
+
+#endif  // RAMCLOUD_SHMTRANSPORT_H
@@ -0,0 +1,385 @@
+/* Copyright (c) 2013 Stanford University
+ *
+ * Permission to use, copy, modify, and distribute this software for any purpose
+ * with or without fee is hereby granted, provided that the above copyright
+ * notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR(S) DISCLAIM ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL AUTHORS BE LIABLE FOR ANY
+ * SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER
+ * RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF
+ * CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+ * CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "TestUtil.h"
+#include "MockWrapper.h"
+#include "ServiceManager.h"
+#include "ShmTransport.h"
+
+namespace RAMCloud {
+
+class ShmTransportTest : public ::testing::Test {
+  public:
+    Context context;
+    ServiceManager* serviceManager;
+    ServiceLocator locator;
+    TestLog::Enable logEnabler;
+    ShmTransport server;
+    ShmTransport client;
+
+    ShmTransportTest()
+            : context()
+            , serviceManager(context.serviceManager)
+            , locator(format("shm: name=test%d", getpid()))
+            , logEnabler()
+            , server(&context, &locator)
+            , client(&context)
+    {
+    }
+
+    string catchGetSession(const char* locatorString) {
+        string message("no exception");
+        try {
+            client.getSession(ServiceLocator(locatorString));
+        } catch (TransportException& e) {
+            message = e.message;
+        }
+        return message;
+    }
+
+    // Run the dispatcher until the server has noticed all channel
+    // changes made by clients.
+    void pollServer()
+    {
+        for (int i = 0; i < 3; i++)
+            context.dispatch->poll();
+    }
+
+    DISALLOW_COPY_AND_ASSIGN(ShmTransportTest);
+};
+
+TEST_F(ShmTransportTest, sanityCheck) {
+    Transport::SessionRef session = client.getSession(locator);
+
+    // Send two requests from the client.
+    MockWrapper rpc1("request1");
+    session->sendRequest(&rpc1.request, &rpc1.response, &rpc1);
+    MockWrapper rpc2("request2");
+    session->sendRequest(&rpc2.request, &rpc2.response, &rpc2);
+
+    // Receive the two requests on the server.
+    Transport::ServerRpc* serverRpc1 = serviceManager->waitForRpc(1.0);
+    ASSERT_TRUE(serverRpc1 != NULL);
+    EXPECT_EQ("request1", TestUtil::toString(&serverRpc1->requestPayload));
+    Transport::ServerRpc* serverRpc2 = serviceManager->waitForRpc(1.0);
+    ASSERT_TRUE(serverRpc2 != NULL);
+    EXPECT_EQ("request2", TestUtil::toString(&serverRpc2->requestPayload));
+
+    // Reply to the requests in backwards order.
+    serverRpc2->replyPayload.fillFromString("response2");
+    serverRpc2->sendReply();
+    serverRpc1->replyPayload.fillFromString("response1");
+    serverRpc1->sendReply();
+
+    // Receive the responses in the client.
+    EXPECT_STREQ("completed: 0, failed: 0", rpc1.getState());
+    EXPECT_STREQ("completed: 0, failed: 0", rpc2.getState());
+    EXPECT_TRUE(TestUtil::waitForRpc(&context, rpc1));
+    EXPECT_STREQ("completed: 1, failed: 0", rpc1.getState());
+    EXPECT_STREQ("completed: 1, failed: 0", rpc2.getState());
+    EXPECT_EQ("response1/0", TestUtil::toString(&rpc1.response));
+    EXPECT_EQ("response2/0", TestUtil::toString(&rpc2.response));
+}
+
+TEST_F(ShmTransportTest, constructor_regionInUse) {
+    string message("no exception");
+    try {
+        ShmTransport server2(&context, &locator);
+    } catch (TransportException& e) {
+        message = e.message;
+    }
+    EXPECT_EQ(format("ShmTransport couldn't create '/ramcloud-test%d': "
+            "another server is using it", getpid()), message);
+}
+
+TEST_F(ShmTransportTest, constructor_reclaimStaleRegion) {
+    ServiceLocator locator2(format("shm: name=stale%d", getpid()));
+    Tub<ShmTransport> server1;
+    server1.construct(&context, &locator2);
+
+    // Pretend that the first server crashed without removing its region.
+    ShmTransport::Region* region = server1->region;
+    server1->region = NULL;
+    region->serverPid = 0x7fffffff;
+
+    ShmTransport server2(&context, &locator2);
+    EXPECT_NE(0x7fffffffU, server2.region->serverPid);
+    munmap(region, sizeof(ShmTransport::Region));
+}
+
+TEST_F(ShmTransportTest, destructor_removesRegion) {
+    ServiceLocator locator2(format("shm: name=gone%d", getpid()));
+    {
+        ShmTransport server2(&context, &locator2);
+        EXPECT_EQ("no exception", catchGetSession(
+                locator2.getOriginalString().c_str()));
+    }
+    EXPECT_EQ(format("ShmTransport couldn't open '/ramcloud-gone%d': "
+            "No such file or directory", getpid()), catchGetSession(
+            locator2.getOriginalString().c_str()));
+}
+
+TEST_F(ShmTransportTest, writeMessage_fragmentsAndWraps) {
+    uint32_t maxFragment = ShmTransport::MAX_FRAGMENT_BYTES;
+    ShmTransport::Ring* ring = &server.region->channels[0].responses;
+    ring->head.store(ShmTransport::RING_BYTES - 100);
+    ring->tail.store(ShmTransport::RING_BYTES - 100);
+    Buffer message;
+    TestUtil::fillLargeBuffer(&message, maxFragment + 10);
+    uint32_t bytesSent = 0;
+    EXPECT_TRUE(ShmTransport::writeMessage(ring, 99, &message, &bytesSent));
+    EXPECT_EQ(message.getTotalLength(), bytesSent);
+
+    // The first fragment didn't fit at the end of the ring.
+    ShmTransport::Header* header = reinterpret_cast<ShmTransport::Header*>(
+            &ring->data[ShmTransport::RING_BYTES - 100]);
+    EXPECT_EQ(0U, header->nonce);
+    header = reinterpret_cast<ShmTransport::Header*>(&ring->data[0]);
+    EXPECT_EQ(99U, header->nonce);
+    EXPECT_EQ(0U, header->offset);
+    EXPECT_EQ(maxFragment, header->length);
+    header = reinterpret_cast<ShmTransport::Header*>(&ring->data[
+            ShmTransport::fragmentBytes(maxFragment)]);
+    EXPECT_EQ(maxFragment, header->offset);
+    EXPECT_EQ(10U, header->length);
+    EXPECT_EQ(ShmTransport::RING_BYTES + ShmTransport::fragmentBytes(
+            maxFragment) + ShmTransport::fragmentBytes(10),
+            ring->head.load());
+    ring->head.store(0);
+    ring->tail.store(0);
+}
+
+TEST_F(ShmTransportTest, writeMessage_ringFull) {
+    uint32_t ringBytes = ShmTransport::RING_BYTES;
+    ShmTransport::Ring* ring = &server.region->channels[0].responses;
+    Buffer message;
+    TestUtil::fillLargeBuffer(&message, ringBytes);
+    uint32_t bytesSent = 0;
+    EXPECT_FALSE(ShmTransport::writeMessage(ring, 99, &message, &bytesSent));
+    EXPECT_EQ(3 * ShmTransport::MAX_FRAGMENT_BYTES, bytesSent);
+
+    // Once the consumer frees space, the rest of the message goes out.
+    ring->tail.store(ring->head.load());
+    EXPECT_TRUE(ShmTransport::writeMessage(ring, 99, &message, &bytesSent));
+    EXPECT_EQ(ringBytes, bytesSent);
+    ring->head.store(0);
+    ring->tail.store(0);
+}
+
+TEST_F(ShmTransportTest, readRequests_zeroCopy) {
+    Transport::SessionRef session = client.getSession(locator);
+    MockWrapper rpc1("request1");
+    session->sendRequest(&rpc1.request, &rpc1.response, &rpc1);
+    MockWrapper rpc2("request2");
+    session->sendRequest(&rpc2.request, &rpc2.response, &rpc2);
+    Transport::ServerRpc* serverRpc1 = serviceManager->waitForRpc(1.0);
+    Transport::ServerRpc* serverRpc2 = serviceManager->waitForRpc(1.0);
+    ASSERT_TRUE(serverRpc2 != NULL);
+
+    // The requests refer directly to the ring, which isn't released
+    // until both RPCs are done.
+    ShmTransport::Ring& ring = server.region->channels[0].requests;
+    EXPECT_EQ(&ring.data[sizeof(ShmTransport::Header)],
+            serverRpc1->requestPayload.getRange(0, 8));
+    uint64_t end = ring.head.load();
+    EXPECT_EQ(0U, ring.tail.load());
+    serverRpc2->sendReply();
+    EXPECT_EQ(0U, ring.tail.load());
+    serverRpc1->sendReply();
+    EXPECT_EQ(end, ring.tail.load());
+    EXPECT_EQ(0U, server.serverChannels[0].consumed.size());
+}
+
+TEST_F(ShmTransportTest, readRequests_malformedFragment) {
+    Transport::SessionRef session = client.getSession(locator);
+    pollServer();
+    ShmTransport::Ring& ring = server.region->channels[0].requests;
+    ShmTransport::Header* header =
+            reinterpret_cast<ShmTransport::Header*>(&ring.data[0]);
+    header->nonce = 1;
+    header->totalLength = 10;
+    header->offset = 5;
+    header->length = 10;
+    ring.head.store(ShmTransport::fragmentBytes(10));
+    TestLog::reset();
+    server.readRequests(0);
+    EXPECT_EQ("readRequests: ShmTransport closing channel 0: "
+            "malformed request fragment", TestLog::get());
+    EXPECT_TRUE(server.serverChannels[0].closing);
+}
+
+TEST_F(ShmTransportTest, largeMessages) {
+    Transport::SessionRef session = client.getSession(locator);
+    MockWrapper rpc;
+    TestUtil::fillLargeBuffer(&rpc.request, 600000);
+    session->sendRequest(&rpc.request, &rpc.response, &rpc);
+    Transport::ServerRpc* serverRpc = serviceManager->waitForRpc(1.0);
+    ASSERT_TRUE(serverRpc != NULL);
+    EXPECT_EQ("ok", TestUtil::checkLargeBuffer(&serverRpc->requestPayload,
+            600000));
+
+    // The response is larger than the ring, so the server has to wait
+    // for the client to drain it.
+    TestUtil::fillLargeBuffer(&serverRpc->replyPayload, 3000000);
+    serverRpc->sendReply();
+    EXPECT_EQ(1U, server.serverChannels[0].repliesWaiting.size());
+    EXPECT_TRUE(TestUtil::waitForRpc(&context, rpc));
+    EXPECT_STREQ("completed: 1, failed: 0", rpc.getState());
+    EXPECT_EQ("ok", TestUtil::checkLargeBuffer(&rpc.response, 3000000));
+    EXPECT_EQ(0U, server.serverChannels[0].repliesWaiting.size());
+}
+
+TEST_F(ShmTransportTest, manyMessagesWrapRing) {
+    Transport::SessionRef session = client.getSession(locator);
+    for (int i = 0; i < 30; i++) {
+        MockWrapper rpc;
+        TestUtil::fillLargeBuffer(&rpc.request, 100000 + i);
+        session->sendRequest(&rpc.request, &rpc.response, &rpc);
+        Transport::ServerRpc* serverRpc = serviceManager->waitForRpc(1.0);
+        ASSERT_TRUE(serverRpc != NULL);
+        EXPECT_EQ("ok", TestUtil::checkLargeBuffer(
+                &serverRpc->requestPayload, 100000 + i));
+        serverRpc->replyPayload.fillFromString(
+                format("response%d", i).c_str());
+        serverRpc->sendReply();
+        EXPECT_TRUE(TestUtil::waitForRpc(&context, rpc));
+        EXPECT_EQ(format("response%d/0", i),
+                TestUtil::toString(&rpc.response));
+    }
+    uint64_t ringBytes = ShmTransport::RING_BYTES;
+    EXPECT_GT(server.region->channels[0].requests.head.load(), ringBytes);
+}
+
+TEST_F(ShmTransportTest, scanChannels_clientDied) {
+    Transport::SessionRef session = client.getSession(locator);
+    MockWrapper rpc("request");
+    session->sendRequest(&rpc.request, &rpc.response, &rpc);
+    Transport::ServerRpc* serverRpc = serviceManager->waitForRpc(1.0);
+    ASSERT_TRUE(serverRpc != NULL);
+    EXPECT_TRUE(server.serverChannels[0].active);
+
+    server.serverChannels[0].clientPid = 0x7fffffff;
+    server.nextLivenessCheck = 0;
+    TestLog::reset();
+    server.scanChannels();
+    EXPECT_EQ("scanChannels: ShmTransport closing channel 0: client process "
+            "2147483647 has exited", TestLog::get());
+    EXPECT_TRUE(server.serverChannels[0].closing);
+
+    // The channel isn't reused until the server is done with the request.
+    pollServer();
+    EXPECT_EQ(downCast<uint32_t>(ShmTransport::OPEN),
+            server.region->channels[0].state.load());
+    serverRpc->sendReply();
+    pollServer();
+    EXPECT_EQ(downCast<uint32_t>(ShmTransport::FREE),
+            server.region->channels[0].state.load());
+    EXPECT_FALSE(server.serverChannels[0].active);
+}
+
+TEST_F(ShmTransportTest, sessionConstructor_wrongHost) {
+    EXPECT_EQ(format("ShmTransport can't reach shm: name=test%d,"
+            "host=no.such.host from this host", getpid()),
+            catchGetSession(format("shm: name=test%d,host=no.such.host",
+            getpid()).c_str()));
+}
+
+TEST_F(ShmTransportTest, sessionConstructor_noServer) {
+    server.region->magic = 0;
+    EXPECT_EQ(format("ShmTransport found no server for shm: name=test%d",
+            getpid()), catchGetSession(locator.getOriginalString().c_str()));
+    server.region->magic = ShmTransport::REGION_MAGIC;
+}
+
+TEST_F(ShmTransportTest, sessionConstructor_noFreeChannels) {
+    std::vector<Transport::SessionRef> sessions;
+    for (uint32_t i = 0; i < ShmTransport::NUM_CHANNELS; i++)
+        sessions.push_back(client.getSession(locator));
+    EXPECT_EQ(format("ShmTransport has no free channels for "
+            "shm: name=test%d", getpid()),
+            catchGetSession(locator.getOriginalString().c_str()));
+}
+
+TEST_F(ShmTransportTest, sessionClose_channelReused) {
+    Transport::SessionRef session = client.getSession(locator);
+    pollServer();
+    EXPECT_TRUE(server.serverChannels[0].active);
+    session->abort();
+    EXPECT_EQ(downCast<uint32_t>(ShmTransport::CLOSED),
+            server.region->channels[0].state.load());
+    pollServer();
+    EXPECT_EQ(downCast<uint32_t>(ShmTransport::FREE),
+            server.region->channels[0].state.load());
+
+    Transport::SessionRef session2 = client.getSession(locator);
+    EXPECT_EQ(downCast<uint32_t>(ShmTransport::OPEN),
+            server.region->channels[0].state.load());
+}
+
+TEST_F(ShmTransportTest, ShmSession_abort) {
+    Transport::SessionRef session = client.getSession(locator);
+    MockWrapper rpc("request");
+    session->sendRequest(&rpc.request, &rpc.response, &rpc);
+    session->abort();
+    EXPECT_STREQ("completed: 0, failed: 1", rpc.getState());
+    MockWrapper rpc2("request2");
+    session->sendRequest(&rpc2.request, &rpc2.response, &rpc2);
+    EXPECT_STREQ("completed: 0, failed: 1", rpc2.getState());
+}
+
+TEST_F(ShmTransportTest, ShmSession_cancelRequest) {
+    Transport::SessionRef session = client.getSession(locator);
+    MockWrapper rpc1("request1");
+    session->sendRequest(&rpc1.request, &rpc1.response, &rpc1);
+    MockWrapper rpc2("request2");
+    session->sendRequest(&rpc2.request, &rpc2.response, &rpc2);
+    session->cancelRequest(&rpc1);
+    Transport::ServerRpc* serverRpc1 = serviceManager->waitForRpc(1.0);
+    Transport::ServerRpc* serverRpc2 = serviceManager->waitForRpc(1.0);
+    ASSERT_TRUE(serverRpc2 != NULL);
+
+    // The response to the canceled RPC is discarded.
+    serverRpc1->replyPayload.fillFromString("response1");
+    serverRpc1->sendReply();
+    serverRpc2->replyPayload.fillFromString("response2");
+    serverRpc2->sendReply();
+    EXPECT_TRUE(TestUtil::waitForRpc(&context, rpc2));
+    EXPECT_STREQ("completed: 0, failed: 0", rpc1.getState());
+    EXPECT_EQ("response2/0", TestUtil::toString(&rpc2.response));
+}
+
+TEST_F(ShmTransportTest, ShmSession_getRpcInfo) {
+    Transport::SessionRef session = client.getSession(locator);
+    EXPECT_EQ(format("no active RPCs to server at shm: name=test%d",
+            getpid()), session->getRpcInfo());
+    MockWrapper rpc1;
+    rpc1.setOpcode(WireFormat::READ);
+    session->sendRequest(&rpc1.request, &rpc1.response, &rpc1);
+    EXPECT_EQ(format("READ to server at shm: name=test%d", getpid()),
+            session->getRpcInfo());
+}
+
+TEST_F(ShmTransportTest, ShmServerRpc_getClientServiceLocator) {
+    Transport::SessionRef session = client.getSession(locator);
+    MockWrapper rpc("request");
+    session->sendRequest(&rpc.request, &rpc.response, &rpc);
+    Transport::ServerRpc* serverRpc = serviceManager->waitForRpc(1.0);
+    ASSERT_TRUE(serverRpc != NULL);
+    EXPECT_EQ(format("shm:pid=%d", getpid()),
+            serverRpc->getClientServiceLocator());
+    serverRpc->sendReply();
+}
+
+}  // namespace RAMCloud
@@ -66,7 +66,7 @@ TEST_F(TableEnumeratorTest, basics) {
 
     // First object.
     Object object1(buffer, size);
-    EXPECT_EQ(33U, size);                                       // size
+    EXPECT_EQ(43U, size);                                       // size
     EXPECT_EQ(tableId1, object1.getTableId());                  // table ID
     EXPECT_EQ(1U, object1.getKeyLength());                      // key length
     EXPECT_EQ(version0, object1.getVersion());                  // version
@@ -79,7 +79,7 @@ TEST_F(TableEnumeratorTest, basics) {
 
     // Second object.
     Object object2(buffer, size);
-    EXPECT_EQ(33U, size);                                       // size
+    EXPECT_EQ(43U, size);                                       // size
     EXPECT_EQ(tableId1, object2.getTableId());                  // table ID
     EXPECT_EQ(1U, object2.getKeyLength());                      // key length
     EXPECT_EQ(version4, object2.getVersion());                  // version
@@ -92,7 +92,7 @@ TEST_F(TableEnumeratorTest, basics) {
 
     // Third object.
     Object object3(buffer, size);
-    EXPECT_EQ(33U, size);                                       // size
+    EXPECT_EQ(43U, size);                                       // size
     EXPECT_EQ(tableId1, object3.getTableId());                  // table ID
     EXPECT_EQ(1U, object3.getKeyLength());                      // key length
     EXPECT_EQ(version2, object3.getVersion());                  // version
@@ -105,7 +105,7 @@ TEST_F(TableEnumeratorTest, basics) {
 
     // Fourth object.
     Object object4(buffer, size);
-    EXPECT_EQ(33U, size);                                       // size
+    EXPECT_EQ(43U, size);                                       // size
     EXPECT_EQ(tableId1, object4.getTableId());                  // table ID
     EXPECT_EQ(1U, object4.getKeyLength());                      // key length
     EXPECT_EQ(version1, object4.getVersion());                  // version
@@ -118,7 +118,7 @@ TEST_F(TableEnumeratorTest, basics) {
 
     // Fifth object.
     Object object5(buffer, size);
-    EXPECT_EQ(33U, size);                                       // size
+    EXPECT_EQ(43U, size);                                       // size
     EXPECT_EQ(tableId1, object5.getTableId());                  // table ID
     EXPECT_EQ(1U, object5.getKeyLength());                      // key length
     EXPECT_EQ(version3, object5.getVersion());                  // version
@@ -269,6 +269,39 @@ TableManager::splitTablet(const char* name,
     SplitTablet(*this, lock, name, splitKeyHash).execute();
 }
 
+/**
+ * Split a tablet of a crashed master, so that the two halves can be
+ * recovered by different recovery masters. Unlike splitTablet(), the
+ * owning master isn't contacted (it is dead). If the split already exists
+ * then this does nothing.
+ *
+ * \param tableId
+ *      Id of the table that contains the tablet to be split.
+ * \param splitKeyHash
+ *      Key hash to used to partition the tablet into two. Keys less than
+ *      \a splitKeyHash belong to one Tablet, keys greater than or equal to
+ *      \a splitKeyHash belong to the other.
+ *
+ * \throw NoSuchTable
+ *      If tableId does not identify a table currently in the tables.
+ */
+void
+TableManager::splitRecoveringTablet(uint64_t tableId,
+                                    uint64_t splitKeyHash)
+{
+    Lock lock(mutex);
+    string name;
+    foreach (const Tables::value_type& table, tables) {
+        if (table.second == tableId) {
+            name = table.first;
+            break;
+        }
+    }
+    if (name.empty())
+        throw NoSuchTable(HERE);
+    SplitTablet(*this, lock, name.c_str(), splitKeyHash, false).execute();
+}
+
 /**
  * Used by MasterRecoveryManager after recovery for a tablet has successfully
  * completed to inform coordinator about the new master for the tablet.
@@ -424,7 +457,8 @@ TableManager::recoverSplitTablet(
     LOG(DEBUG, "TableManager::recoverSplitTablet()");
     SplitTablet(*this, lock,
                 state->name().c_str(),
-                state->split_key_hash()).complete(entryId);
+                state->split_key_hash(),
+                state->notify_master()).complete(entryId);
 }
 
 /**
@@ -731,6 +765,7 @@ TableManager::SplitTablet::execute()
     state.set_entry_type("SplitTablet");
     state.set_name(name);
     state.set_split_key_hash(splitKeyHash);
+    state.set_notify_master(notifyMaster);
 
     CoordinatorService *coordService = tm.context->coordinatorService;
     RuntimeOptions *runtimeOptions = NULL;
@@ -770,8 +805,11 @@ TableManager::SplitTablet::complete(EntryId entryId)
         tm.map.push_back(newTablet);
 
         // Tell the master to split the tablet
-        MasterClient::splitMasterTablet(tm.context, originalTablet.serverId,
-                                        tableId, splitKeyHash);
+        if (notifyMaster) {
+            MasterClient::splitMasterTablet(tm.context,
+                                            originalTablet.serverId,
+                                            tableId, splitKeyHash);
+        }
 
         // Now append the new table information to LogCabin and invalidate
         // the older table information and split tablet operation information.
@@ -90,6 +90,8 @@ class TableManager {
                    ProtoBuf::Tablets* tablets) const;
     void splitTablet(const char* name,
                      uint64_t splitKeyHash);
+    void splitRecoveringTablet(uint64_t tableId,
+                               uint64_t splitKeyHash);
     void tabletRecovered(uint64_t tableId,
                          uint64_t startKeyHash,
                          uint64_t endKeyHash,
@@ -207,10 +209,12 @@ class TableManager {
         SplitTablet(TableManager &tm,
                     const Lock& lock,
                     const char* name,
-                    uint64_t splitKeyHash)
+                    uint64_t splitKeyHash,
+                    bool notifyMaster = true)
             : tm(tm), lock(lock),
               name(name),
-              splitKeyHash(splitKeyHash) {}
+              splitKeyHash(splitKeyHash),
+              notifyMaster(notifyMaster) {}
         void execute();
         void complete(EntryId entryId);
 
@@ -233,6 +237,11 @@ class TableManager {
          * \a splitKeyHash belong to the other.
          */
         uint64_t splitKeyHash;
+        /**
+         * Whether to tell the master that owns the tablet about the split.
+         * False when the owner has crashed and the tablet is recovering.
+         */
+        bool notifyMaster;
         DISALLOW_COPY_AND_ASSIGN(SplitTablet);
     };
 
@@ -518,7 +518,8 @@ TEST_F(TableManagerTest, splitTablet_LogCabin) {
             entriesRead[findEntryId(searchString)], splitTablet);
     EXPECT_EQ("entry_type: \"SplitTablet\"\n"
               "name: \"foo\"\n"
-              "split_key_hash: 9223372036854775807\n",
+              "split_key_hash: 9223372036854775807\n"
+              "notify_master: true\n",
                splitTablet.DebugString());
 
     ProtoBuf::TableInformation aliveTableNew;
@@ -537,6 +538,38 @@ TEST_F(TableManagerTest, splitTablet_LogCabin) {
               aliveTableNew.DebugString());
 }
 
+TEST_F(TableManagerTest, splitRecoveringTablet) {
+    enlistMaster();
+
+    tableManager->createTable("foo", 1);
+    tableManager->markAllTabletsRecovering(masterServerId);
+
+    TestLog::Enable _;
+    tableManager->splitRecoveringTablet(1, ~0lu / 2);
+    EXPECT_EQ("Tablet { tableId: 1 startKeyHash: 0 "
+              "endKeyHash: 9223372036854775806 "
+              "serverId: 1.0 status: RECOVERING "
+              "ctime: 0, 0 } "
+              "Tablet { tableId: 1 "
+              "startKeyHash: 9223372036854775807 "
+              "endKeyHash: 18446744073709551615 "
+              "serverId: 1.0 status: RECOVERING "
+              "ctime: 0, 0 }",
+              tableManager->debugString());
+
+    // The (crashed) master isn't told about the split.
+    vector<Entry> entriesRead = logCabinLog->read(0);
+    ProtoBuf::SplitTablet splitTablet;
+    string searchString = "execute: LogCabin: SplitTablet entryId: ";
+    ASSERT_NO_THROW(findEntryId(searchString));
+    logCabinHelper->parseProtoBufFromEntry(
+            entriesRead[findEntryId(searchString)], splitTablet);
+    EXPECT_FALSE(splitTablet.notify_master());
+
+    EXPECT_THROW(tableManager->splitRecoveringTablet(2, ~0ul / 2),
+                 TableManager::NoSuchTable);
+}
+
 TEST_F(TableManagerTest, tabletRecovered_LogCabin) {
     // Enlist master
     enlistMaster();
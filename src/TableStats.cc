@@ -15,6 +15,7 @@
 
 #include "TableStats.h"
 #include "MasterTableMetadata.h"
+#include "Tablet.h"
 
 namespace RAMCloud {
 
@@ -131,6 +132,68 @@ serialize(Buffer *buf, MasterTableMetadata *mtm)
     }
 }
 
+/**
+ * Construct an Estimator for the tablets of a crashed master.
+ *
+ * \param digest
+ *      Table stats recovered from the head of the crashed master's log.
+ *      Must not be NULL.
+ * \param tablets
+ *      All of the tablets that the crashed master owned.
+ */
+Estimator::Estimator(const Digest* digest, const std::vector<Tablet>& tablets)
+    : tables()
+    , otherByteCount(digest->header.otherByteCount)
+    , otherRecordCount(digest->header.otherRecordCount)
+    , otherSpan(0)
+{
+    for (uint64_t i = 0; i < digest->header.entryCount; i++) {
+        const DigestEntry& entry = digest->entries[i];
+        tables[entry.tableId] = {entry.byteCount, entry.recordCount, 0};
+    }
+
+    foreach (const Tablet& tablet, tablets) {
+        TableMap::iterator it = tables.find(tablet.tableId);
+        if (it != tables.end())
+            it->second.span += span(tablet);
+        else
+            otherSpan += span(tablet);
+    }
+}
+
+/**
+ * Return the estimated number of bytes and records of a tablet. The tablet
+ * must be one of those passed to the constructor, or a piece of one.
+ */
+Estimator::Estimate
+Estimator::estimate(const Tablet& tablet) const
+{
+    uint64_t byteCount = otherByteCount;
+    uint64_t recordCount = otherRecordCount;
+    double total = otherSpan;
+    TableMap::const_iterator it = tables.find(tablet.tableId);
+    if (it != tables.end()) {
+        byteCount = it->second.byteCount;
+        recordCount = it->second.recordCount;
+        total = it->second.span;
+    }
+    if (total == 0)
+        return {0, 0};
+
+    double fraction = std::min(span(tablet) / total, 1.0);
+    return {static_cast<uint64_t>(static_cast<double>(byteCount) * fraction),
+            static_cast<uint64_t>(static_cast<double>(recordCount) * fraction)};
+}
+
+/**
+ * Return the number of key hashes covered by a tablet.
+ */
+double
+Estimator::span(const Tablet& tablet)
+{
+    return static_cast<double>(tablet.endKeyHash - tablet.startKeyHash) + 1;
+}
+
 } // namespace TableStats
 
 } // namespace RAMCloud
@@ -16,6 +16,8 @@
 #ifndef RAMCLOUD_TABLESTATS_H
 #define RAMCLOUD_TABLESTATS_H
 
+#include <unordered_map>
+
 #include "Common.h"
 #include "SpinLock.h"
 #include "Buffer.h"
@@ -28,6 +30,7 @@ namespace RAMCloud {
  * include since MasterTableMetadata.h includes this header file.
  */
 class MasterTableMetadata;
+struct Tablet;
 
 /**
  * This namespace holds all relevant methods and structures to collect,
@@ -141,6 +144,48 @@ struct Digest {
     DigestEntry entries[0];
 } __attribute__((__packed__));
 
+/**
+ * Estimates the size of each of a crashed master's tablets from the Digest
+ * found in its log head, for use when partitioning the tablets for recovery.
+ * The Digest only records stats per table (and lumps small tables together),
+ * so each tablet is assumed to hold a share of its table's data in
+ * proportion to the fraction of the key hash space that it covers.
+ */
+class Estimator {
+  public:
+    /// Estimated size of a tablet.
+    struct Estimate {
+        uint64_t byteCount;
+        uint64_t recordCount;
+    };
+
+    Estimator(const Digest* digest, const std::vector<Tablet>& tablets);
+    Estimate estimate(const Tablet& tablet) const;
+
+  PRIVATE:
+    /// Stats for one table listed in the digest, along with the fraction
+    /// of the table's key hash space that the crashed master owned.
+    struct TableEntry {
+        uint64_t byteCount;
+        uint64_t recordCount;
+        double span;
+    };
+    typedef std::unordered_map<uint64_t, TableEntry> TableMap;
+
+    /// Tables listed separately in the digest, keyed by table id.
+    TableMap tables;
+
+    /// Aggregate stats for all tables that fell below the threshold.
+    uint64_t otherByteCount;
+    uint64_t otherRecordCount;
+
+    /// Sum of the spans of all the tablets whose tables aren't listed
+    /// separately; #otherByteCount is divided among them by span.
+    double otherSpan;
+
+    static double span(const Tablet& tablet);
+};
+
 } // namespace TableStats
 
 } // namespace RAMCloud
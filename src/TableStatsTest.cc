@@ -16,6 +16,7 @@
 #include "TestUtil.h"
 #include "TableStats.h"
 #include "MasterTableMetadata.h"
+#include "Tablet.h"
 
 namespace RAMCloud {
 
@@ -153,4 +154,51 @@ TEST_F(TabletStatsEstimatorTest, serializeTableStats) {
 
 }
 
+TEST_F(TabletStatsEstimatorTest, estimator) {
+    fillMtm();
+    Buffer buffer;
+    TableStats::serialize(&buffer, &mtm);
+    const TableStats::Digest* digest =
+        static_cast<const TableStats::Digest*>(
+            buffer.getRange(0, buffer.getTotalLength()));
+
+    // Table 64 is listed separately; tables 1 and 2 are lumped together.
+    std::vector<Tablet> tablets;
+    tablets.push_back({64, 0, 99, {}, Tablet::RECOVERING, {}});
+    tablets.push_back({64, 200, 499, {}, Tablet::RECOVERING, {}});
+    tablets.push_back({1, 0, 9, {}, Tablet::RECOVERING, {}});
+    tablets.push_back({2, 0, 29, {}, Tablet::RECOVERING, {}});
+    TableStats::Estimator estimator(digest, tablets);
+
+    TableStats::Estimator::Estimate estimate;
+    estimate = estimator.estimate(tablets[0]);
+    EXPECT_EQ(TableStats::threshold / 4, estimate.byteCount);
+    EXPECT_EQ(16000u, estimate.recordCount);
+    estimate = estimator.estimate(tablets[1]);
+    EXPECT_EQ(TableStats::threshold * 3 / 4, estimate.byteCount);
+    EXPECT_EQ(48000u, estimate.recordCount);
+
+    // A piece of a tablet gets its share of the tablet's estimate.
+    estimate = estimator.estimate({64, 0, 49, {}, Tablet::RECOVERING, {}});
+    EXPECT_EQ(TableStats::threshold / 8, estimate.byteCount);
+
+    uint64_t otherBytes = TableStats::threshold - 1 + 11 + 22;
+    estimate = estimator.estimate(tablets[2]);
+    EXPECT_EQ(otherBytes / 4, estimate.byteCount);
+    EXPECT_EQ(63333u / 4, estimate.recordCount);
+    estimate = estimator.estimate(tablets[3]);
+    EXPECT_EQ(otherBytes * 3 / 4, estimate.byteCount);
+}
+
+TEST_F(TabletStatsEstimatorTest, estimator_noTablets) {
+    TableStats::Digest digest;
+    digest.header = {100, 10, 0};
+    std::vector<Tablet> tablets;
+    TableStats::Estimator estimator(&digest, tablets);
+    TableStats::Estimator::Estimate estimate =
+        estimator.estimate({1, 0, 9, {}, Tablet::RECOVERING, {}});
+    EXPECT_EQ(0u, estimate.byteCount);
+    EXPECT_EQ(0u, estimate.recordCount);
+}
+
 } // namespace RAMCloud
@@ -21,6 +21,7 @@ namespace RAMCloud {
 TabletManager::TabletManager()
     : tabletMap()
     , lock("TabletManager::lock")
+    , expiryPoliciesSet(false)
 {
 }
 
@@ -234,8 +235,10 @@ TabletManager::splitTablet(uint64_t tableId,
     // So to make it idempotent, check for this condition before you
     // decide to do the split
     if (splitKeyHash != t->startKeyHash) {
-        tabletMap.emplace(tableId,
-                          tableId, splitKeyHash, t->endKeyHash, t->state);
+        TabletMap::iterator newIt = tabletMap.emplace(tableId,
+            tableId, splitKeyHash, t->endKeyHash, t->state);
+        newIt->second.ttl = t->ttl;
+        newIt->second.evictable = t->evictable;
         t->endKeyHash = splitKeyHash - 1;
 
         // It's unclear what to do with the counts when splitting. The old
@@ -292,6 +295,53 @@ TabletManager::changeState(uint64_t tableId,
     return true;
 }
 
+/**
+ * Set the expiry policy of the tablet containing a given key hash. Objects
+ * in the tablet that are older than the ttl are treated as nonexistent and
+ * discarded by the cleaner; live objects in evictable tablets may also be
+ * discarded by the cleaner when memory runs short (see ObjectManager).
+ *
+ * Policies belong to the tablets on this master only: they are carried
+ * across splits, but not across migration or recovery.
+ *
+ * \param tableId
+ *      Table identifier corresponding to the tablet to update.
+ * \param keyHash
+ *      Any key hash value within the tablet to update.
+ * \param ttl
+ *      Number of seconds after which objects expire, or 0 if they should
+ *      never expire.
+ * \param evictable
+ *      Whether live objects may be evicted under memory pressure.
+ * \param outTablet
+ *      Optional pointer to a Tablet object that will be filled with the
+ *      updated tablet's data.
+ * \return
+ *      True if the tablet was found, otherwise false.
+ */
+bool
+TabletManager::setExpiryPolicy(uint64_t tableId,
+                               uint64_t keyHash,
+                               uint32_t ttl,
+                               bool evictable,
+                               Tablet* outTablet)
+{
+    Lock guard(lock);
+
+    TabletMap::iterator it = lookup(tableId, keyHash, guard);
+    if (it == tabletMap.end())
+        return false;
+
+    Tablet* t = &it->second;
+    t->ttl = ttl;
+    t->evictable = evictable;
+    if (ttl != 0 || evictable)
+        expiryPoliciesSet = true;
+    if (outTablet != NULL)
+        *outTablet = *t;
+    return true;
+}
+
 /**
  * Increment the object read counter on the tablet associated with the given
  * key.
@@ -16,6 +16,7 @@
 #ifndef RAMCLOUD_TABLETMANAGER_H
 #define RAMCLOUD_TABLETMANAGER_H
 
+#include <atomic>
 #include <boost/unordered_map.hpp>
 
 #include "Common.h"
@@ -78,6 +79,8 @@ class TabletManager {
             , state(RECOVERING)
             , readCount(-1)
             , writeCount(-1)
+            , ttl(0)
+            , evictable(false)
         {
         }
 
@@ -91,6 +94,8 @@ class TabletManager {
             , state(state)
             , readCount(0)
             , writeCount(0)
+            , ttl(0)
+            , evictable(false)
         {
         }
 
@@ -111,6 +116,14 @@ class TabletManager {
 
         /// The number of write operations performed on objects in this tablet.
         uint64_t writeCount;
+
+        /// Objects in this tablet expire this many seconds after they were
+        /// written; 0 means they never expire. See ObjectManager.
+        uint32_t ttl;
+
+        /// If true, the cleaner may drop live objects in this tablet rather
+        /// than relocate them when the master is low on memory.
+        bool evictable;
     };
 
     TabletManager();
@@ -138,6 +151,14 @@ class TabletManager {
                      uint64_t endKeyHash,
                      TabletState oldState,
                      TabletState newState);
+    bool setExpiryPolicy(uint64_t tableId,
+                         uint64_t keyHash,
+                         uint32_t ttl,
+                         bool evictable,
+                         Tablet* outTablet = NULL);
+    /// Returns true once any tablet has been given a ttl or made evictable.
+    /// Lets hot paths avoid looking up tablets when no policies are in use.
+    bool anyExpiryPolicies() { return expiryPoliciesSet; }
     void incrementReadCount(Key& key);
     void incrementWriteCount(Key& key);
     void getStatistics(ProtoBuf::ServerStatistics* serverStatistics);
@@ -165,6 +186,9 @@ class TabletManager {
     /// Monitor spinlock used to protect the tabletMap from concurrent access.
     SpinLock lock;
 
+    /// Set by setExpiryPolicy(); see anyExpiryPolicies().
+    std::atomic<bool> expiryPoliciesSet;
+
     DISALLOW_COPY_AND_ASSIGN(TabletManager);
 };
 
@@ -156,6 +156,42 @@ TEST_F(TabletManagerTest, splitTablet) {
     EXPECT_EQ(TabletManager::NORMAL, tablet.state);
 }
 
+TEST_F(TabletManagerTest, splitTablet_expiryPolicy) {
+    EXPECT_TRUE(tm.addTablet(0, 50, 100, TabletManager::NORMAL));
+    EXPECT_TRUE(tm.setExpiryPolicy(0, 60, 30, true));
+    EXPECT_TRUE(tm.splitTablet(0, 75));
+
+    TabletManager::Tablet tablet;
+    EXPECT_TRUE(tm.getTablet(0, 50, &tablet));
+    EXPECT_EQ(30U, tablet.ttl);
+    EXPECT_TRUE(tablet.evictable);
+    EXPECT_TRUE(tm.getTablet(0, 75, &tablet));
+    EXPECT_EQ(30U, tablet.ttl);
+    EXPECT_TRUE(tablet.evictable);
+}
+
+TEST_F(TabletManagerTest, setExpiryPolicy) {
+    EXPECT_TRUE(tm.addTablet(0, 10, 20, TabletManager::NORMAL));
+    EXPECT_TRUE(tm.addTablet(0, 21, 30, TabletManager::NORMAL));
+    EXPECT_FALSE(tm.anyExpiryPolicies());
+
+    EXPECT_FALSE(tm.setExpiryPolicy(0, 31, 5, false));
+    EXPECT_FALSE(tm.setExpiryPolicy(1, 10, 5, false));
+    EXPECT_TRUE(tm.setExpiryPolicy(0, 10, 0, false));
+    EXPECT_FALSE(tm.anyExpiryPolicies());
+
+    TabletManager::Tablet tablet;
+    EXPECT_TRUE(tm.setExpiryPolicy(0, 15, 5, false, &tablet));
+    EXPECT_TRUE(tm.anyExpiryPolicies());
+    EXPECT_EQ(10U, tablet.startKeyHash);
+    EXPECT_EQ(5U, tablet.ttl);
+    EXPECT_FALSE(tablet.evictable);
+
+    EXPECT_TRUE(tm.getTablet(0, 21, &tablet));
+    EXPECT_EQ(0U, tablet.ttl);
+    EXPECT_FALSE(tablet.evictable);
+}
+
 TEST_F(TabletManagerTest, changeState) {
     EXPECT_TRUE(tm.addTablet(0, 10, 20, TabletManager::RECOVERING));
 
@@ -30,6 +30,7 @@ namespace RAMCloud {
 Task::Task(TaskQueue& taskQueue)
     : taskQueue(taskQueue)
     , scheduled(false)
+    , nextInList(NULL)
 {
 }
 
@@ -78,35 +79,122 @@ Task::schedule()
     taskQueue.schedule(this);
 }
 
+// --- TaskQueue::TaskList ---
+
+/**
+ * Create an empty TaskList.
+ *
+ * \param taskQueue
+ *      The TaskQueue this list belongs to.
+ */
+TaskQueue::TaskList::TaskList(TaskQueue& taskQueue)
+    : popLock("TaskQueue::TaskList")
+    , stub(taskQueue)
+    , head(&stub)
+    , tail(&stub)
+{
+}
+
+/**
+ * Remove and return the oldest task on the list.  The caller must hold
+ * #popLock.
+ *
+ * \return
+ *      The task, or NULL if the list is empty.  NULL may also be returned
+ *      (briefly) while another thread is in the middle of pushing the only
+ *      task on the list.
+ */
+Task*
+TaskQueue::TaskList::pop()
+{
+    Task* oldest = tail;
+    Task* next = oldest->nextInList.load();
+    if (oldest == &stub) {
+        if (next == NULL)
+            return NULL;
+        tail = next;
+        oldest = next;
+        next = next->nextInList.load();
+    }
+    if (next != NULL) {
+        tail = next;
+        return oldest;
+    }
+
+    // The oldest task is also the newest. Producers link new tasks onto the
+    // newest one, so put the stub behind it before handing it out.
+    if (oldest != head.load())
+        return NULL;
+    push(&stub);
+    next = oldest->nextInList.load();
+    if (next != NULL) {
+        tail = next;
+        return oldest;
+    }
+    return NULL;
+}
+
+/**
+ * Return the oldest task on the list without removing it, or NULL if the
+ * list is empty.  The caller must hold #popLock.
+ */
+Task*
+TaskQueue::TaskList::front()
+{
+    if (tail == &stub)
+        return stub.nextInList.load();
+    return tail;
+}
+
+/**
+ * Add a task to the end of the list.  Safe to call from any number of
+ * threads at once; never blocks.
+ */
+void
+TaskQueue::TaskList::push(Task* task)
+{
+    task->nextInList.store(NULL);
+    Task* previous = head.exchange(task);
+    previous->nextInList.store(task);
+}
+
 // --- TaskQueue ---
 
+__thread TaskQueue::Worker* TaskQueue::currentWorker = NULL;
+
 /// Create a TaskQueue.
 TaskQueue::TaskQueue()
     : mutex()
     , taskAdded()
     , running(true)
-    , tasks()
+    , sleepers(0)
+    , queuedTasks(0)
+    , tasks(*this)
+    , workers()
 {
 }
 
+/// Stops any workers (see stopWorkers()).
 TaskQueue::~TaskQueue()
 {
+    stopWorkers();
 }
 
 /// Returns true if no tasks are waiting to run.
 bool
 TaskQueue::isIdle()
 {
-    Lock _(mutex);
-    return tasks.size() == 0;
+    return outstandingTasks() == 0;
 }
 
 /// Returns number of tasks waiting to run.
 size_t
 TaskQueue::outstandingTasks()
 {
-    Lock _(mutex);
-    return tasks.size();
+    int count = queuedTasks.load();
+    foreach (Worker* worker, workers)
+        count += worker->handoffCount.load();
+    return downCast<size_t>(count);
 }
 
 /**
@@ -124,7 +212,8 @@ TaskQueue::outstandingTasks()
  * performTask(), and performTasksUntilHalt() are safe. Keep in mind that
  * having multiple threads calling performTask() (and/or
  * performTasksUntilHalt()) means any shared state between tasks will have
- * to have synchronized access.
+ * to have synchronized access. This method should not be used on a queue
+ * that has workers (see startWorkers()).
  *
  * \return
  *      True if a task was performed, false if no task was performed.
@@ -156,7 +245,8 @@ TaskQueue::performTask()
  * performTask(), and performTasksUntilHalt() are safe. Keep in mind that
  * having multiple threads calling performTask() (and/or
  * performTasksUntilHalt()) means any shared state between tasks will have
- * to have synchronized access.
+ * to have synchronized access. This method should not be used on a queue
+ * that has workers (see startWorkers()).
  */
 void
 TaskQueue::performTasksUntilHalt()
@@ -170,40 +260,128 @@ TaskQueue::performTasksUntilHalt()
 }
 
 /**
- * Notify any executing calls to performTaskUntilHalt() that they should
- * exit as soon as they finish executing any currently executing task, if
- * any.
+ * Notify any executing calls to performTaskUntilHalt() and any workers
+ * that they should exit as soon as they finish executing any currently
+ * executing task, if any. This may be called from within a task.
  */
 void
 TaskQueue::halt()
 {
-    Lock _(mutex);
     running = false;
-    taskAdded.notify_one();
+    Lock _(mutex);
+    taskAdded.notify_all();
 }
 
-// -- private --
-
 /**
- * Queue \a task for execution on future calls to performTask (or
- * performTasksUntilHalt()).
- * Only called by Task::schedule().
- * TaskQueue is thread-safe so simultaneous calls to schedule(),
- * performTask(), and performTasksUntilHalt() are safe.
+ * Start threads that perform this queue's tasks from now on, so that
+ * independent tasks can run in parallel. No other thread should call
+ * performTask() or performTasksUntilHalt() on this queue afterwards.
  *
- * \param task
- *      Asynchronous job to be executed by the TaskQueue in the future.
+ * \param count
+ *      Number of worker threads to start.
  */
 void
-TaskQueue::schedule(Task* task)
+TaskQueue::startWorkers(uint32_t count)
 {
-    Lock _(mutex);
-    if (task->scheduled)
+    assert(workers.empty());
+    for (uint32_t i = 0; i < count; i++)
+        workers.push_back(new Worker(*this, i));
+    foreach (Worker* worker, workers)
+        worker->thread.construct(workerMain, this, worker);
+}
+
+/**
+ * Halt the queue (see halt()) and wait for all of the threads started by
+ * startWorkers() to finish their current tasks and exit. Must not be
+ * called from within a task. A no-op if there are no workers.
+ */
+void
+TaskQueue::stopWorkers()
+{
+    if (workers.empty())
         return;
-    task->scheduled = true;
-    tasks.push(task);
-    taskAdded.notify_one();
-    TEST_LOG("scheduled");
+    halt();
+    foreach (Worker* worker, workers)
+        worker->thread->join();
+    foreach (Worker* worker, workers)
+        delete worker;
+    workers.clear();
+}
+
+// -- private --
+
+/**
+ * Return the next task a worker should run, sleeping until there is one.
+ * The worker's own tasks come first, then tasks scheduled from outside
+ * the workers, then tasks stolen from other workers.
+ *
+ * \param worker
+ *      The worker looking for work.
+ * \return
+ *      The next task to run, or NULL if the queue has been halted.
+ */
+Task*
+TaskQueue::findTask(Worker* worker)
+{
+    uint32_t numWorkers = downCast<uint32_t>(workers.size());
+    while (running) {
+        Task* task = NULL;
+        if (worker->handoffCount > 0) {
+            std::lock_guard<SpinLock> _(worker->handoffs.popLock);
+            task = worker->handoffs.pop();
+            if (task != NULL) {
+                worker->handoffCount--;
+                return task;
+            }
+            continue;
+        }
+
+        {
+            std::lock_guard<SpinLock> _(worker->tasks.popLock);
+            task = worker->tasks.pop();
+        }
+        if (task == NULL) {
+            std::lock_guard<SpinLock> _(tasks.popLock);
+            task = tasks.pop();
+        }
+        for (uint32_t i = 1; (task == NULL) && (i < numWorkers); i++) {
+            // Don't wait for a victim that's busy with its list; someone
+            // else is already taking care of it.
+            Worker* victim = workers[(worker->index + i) % numWorkers];
+            if (victim->tasks.popLock.try_lock()) {
+                task = victim->tasks.pop();
+                victim->tasks.popLock.unlock();
+            }
+        }
+
+        if (task != NULL) {
+            queuedTasks--;
+
+            // The task may have been rescheduled while another worker is
+            // still running it; in that case that worker runs it again
+            // when it's done, so the task never runs in parallel with
+            // itself.
+            Worker* runningOn = NULL;
+            foreach (Worker* other, workers) {
+                if ((other != worker) && (other->currentTask == task))
+                    runningOn = other;
+            }
+            if (runningOn == NULL)
+                return task;
+            runningOn->handoffs.push(task);
+            runningOn->handoffCount++;
+            if (sleepers > 0)
+                wakeWorkers(true);
+            continue;
+        }
+
+        Lock lock(mutex);
+        sleepers++;
+        while (running && (queuedTasks == 0) && (worker->handoffCount == 0))
+            taskAdded.wait(lock);
+        sleepers--;
+    }
+    return NULL;
 }
 
 /**
@@ -222,20 +400,107 @@ TaskQueue::schedule(Task* task)
 Task*
 TaskQueue::getNextTask(bool sleepIfIdle)
 {
-    Lock lock(mutex);
     while (true) {
         if (!running)
             return NULL;
-        if (!sleepIfIdle || !tasks.empty())
+        Task* task;
+        {
+            std::lock_guard<SpinLock> _(tasks.popLock);
+            task = tasks.pop();
+        }
+        if (task != NULL) {
+            queuedTasks--;
+            task->scheduled = false;
+            return task;
+        }
+        if (!sleepIfIdle)
+            return NULL;
+
+        // If a task is being pushed right now queuedTasks is already
+        // nonzero; just try again.
+        Lock lock(mutex);
+        sleepers++;
+        while (running && (queuedTasks == 0))
+            taskAdded.wait(lock);
+        sleepers--;
+    }
+}
+
+/**
+ * Queue \a task for execution on future calls to performTask (or
+ * performTasksUntilHalt(), or by a worker).
+ * Only called by Task::schedule().
+ * TaskQueue is thread-safe so simultaneous calls to schedule(),
+ * performTask(), and performTasksUntilHalt() are safe.
+ *
+ * \param task
+ *      Asynchronous job to be executed by the TaskQueue in the future.
+ */
+void
+TaskQueue::schedule(Task* task)
+{
+    if (task->scheduled.exchange(true))
+        return;
+    queuedTasks++;
+    Worker* worker = currentWorker;
+    if ((worker != NULL) && (worker->owner == this))
+        worker->tasks.push(task);
+    else
+        tasks.push(task);
+
+    // This check races with a thread going to sleep; it's safe because each
+    // side updates its own counter before checking the other's.
+    if (sleepers > 0)
+        wakeWorkers(false);
+    TEST_LOG("scheduled");
+}
+
+/**
+ * Wake threads sleeping in findTask() or getNextTask().
+ *
+ * \param all
+ *      True means wake all of them (needed when the work is meant for a
+ *      particular worker); false means one is enough.
+ */
+void
+TaskQueue::wakeWorkers(bool all)
+{
+    Lock _(mutex);
+    if (all)
+        taskAdded.notify_all();
+    else
+        taskAdded.notify_one();
+}
+
+/**
+ * Top-level method for threads started by startWorkers(): repeatedly
+ * find a task and perform it, until the queue is halted.
+ *
+ * \param taskQueue
+ *      The queue whose tasks to perform.
+ * \param worker
+ *      State for this thread.
+ */
+void
+TaskQueue::workerMain(TaskQueue* taskQueue, Worker* worker)
+try {
+    currentWorker = worker;
+    while (true) {
+        Task* task = taskQueue->findTask(worker);
+        if (task == NULL)
             break;
-        taskAdded.wait(lock);
+        worker->currentTask = task;
+        task->scheduled = false;
+        task->performTask();
+        worker->currentTask = NULL;
     }
-    if (tasks.empty())
-        return NULL;
-    Task* task = tasks.front();
-    tasks.pop();
-    task->scheduled = false;
-    return task;
+    currentWorker = NULL;
+} catch (const std::exception& e) {
+    LOG(ERROR, "Fatal error in TaskQueue worker: %s", e.what());
+    throw;
+} catch (...) {
+    LOG(ERROR, "Unknown fatal error in TaskQueue worker.");
+    throw;
 }
 
 } // namespace RAMCloud
@@ -16,11 +16,18 @@
 #ifndef RAMCLOUD_TASKQUEUE_H
 #define RAMCLOUD_TASKQUEUE_H
 
+#if __GNUC__ >= 4 && __GNUC_MINOR__ >= 5
+#include <atomic>
+#else
+#include <cstdatomic>
+#endif
 #include <condition_variable>
 #include <mutex>
-#include <queue>
+#include <thread>
 
 #include "Common.h"
+#include "SpinLock.h"
+#include "Tub.h"
 
 namespace RAMCloud {
 
@@ -62,7 +69,10 @@ class Task {
 
   PRIVATE:
     /// True if performTask() will be run on the next taskQueue.performTask().
-    bool scheduled;
+    std::atomic<bool> scheduled;
+
+    /// Next task in the TaskQueue::TaskList this task is on, if any.
+    std::atomic<Task*> nextInList;
 
     friend class TaskQueue;
 };
@@ -72,6 +82,17 @@ class Task {
  * quickly schedule asynchronous jobs which are periodically checked for
  * completeness out of a performance sensitive context.
  * See Task for details on how to create tasks and related gotchas.
+ *
+ * Scheduling a task never blocks: tasks are kept on lock-free lists, so
+ * many threads can schedule tasks at once without contending for a lock.
+ * Tasks are performed either by threads that call performTask() or
+ * performTasksUntilHalt(), or by a pool of worker threads owned by the
+ * queue (see startWorkers()).  In the latter case each worker keeps its
+ * own list of the tasks scheduled by the tasks it runs, and idle workers
+ * steal from the lists of busy ones, so independent tasks run in parallel.
+ * Workers never run a task concurrently with itself, even if it is
+ * rescheduled while it is running, so tasks written for a single-threaded
+ * queue need no extra synchronization of their own state.
  */
 class TaskQueue {
   PUBLIC:
@@ -82,38 +103,138 @@ class TaskQueue {
     bool performTask();
     void performTasksUntilHalt();
     void halt();
+    void startWorkers(uint32_t count);
+    void stopWorkers();
 
   PRIVATE:
-    void schedule(Task* task);
+    /**
+     * A FIFO list of scheduled tasks, linked through Task::nextInList.
+     * Any number of threads may push() at once without locking (this is
+     * Dmitry Vyukov's intrusive multi-producer queue); pop() must be called
+     * with #popLock held.
+     */
+    class TaskList {
+      public:
+        explicit TaskList(TaskQueue& taskQueue);
+        Task* front();
+        Task* pop();
+        void push(Task* task);
+
+        /// Serializes calls to pop().
+        SpinLock popLock;
+
+      private:
+        /// Placeholder that keeps the list from ever becoming truly empty,
+        /// so producers and the consumer never touch the same task.
+        class Stub : public Task {
+          public:
+            explicit Stub(TaskQueue& taskQueue) : Task(taskQueue) {}
+            void performTask() {}
+        } stub;
+
+        /// Most recently pushed task; producers swap themselves in here.
+        std::atomic<Task*> head;
+
+        /// Oldest task in the list (or #stub); only touched by pop().
+        Task* tail;
+
+        DISALLOW_COPY_AND_ASSIGN(TaskList);
+    };
+
+    /**
+     * State for one of the threads started by startWorkers().
+     */
+    struct Worker {
+        Worker(TaskQueue& taskQueue, uint32_t index)
+            : owner(&taskQueue)
+            , index(index)
+            , tasks(taskQueue)
+            , handoffs(taskQueue)
+            , handoffCount(0)
+            , currentTask(NULL)
+            , thread()
+        {}
+
+        /// The TaskQueue whose tasks this worker runs.
+        TaskQueue* owner;
+
+        /// Position of this worker in #workers.
+        uint32_t index;
+
+        /// Tasks scheduled while this worker was running a task (the new
+        /// task likely uses data that is hot in this worker's cache).
+        /// Other workers steal from here when they run out of work.
+        TaskList tasks;
+
+        /// Tasks that were rescheduled while this worker was running them;
+        /// only this worker runs them, once it finishes its current task.
+        TaskList handoffs;
+
+        /// Number of tasks in #handoffs.
+        std::atomic<int> handoffCount;
+
+        /// The task this worker is running, or NULL.
+        std::atomic<Task*> currentTask;
+
+        /// Executes workerMain().
+        Tub<std::thread> thread;
+
+        DISALLOW_COPY_AND_ASSIGN(Worker);
+    };
+
+    Task* findTask(Worker* worker);
     Task* getNextTask(bool sleepIfIdle);
+    void schedule(Task* task);
+    void wakeWorkers(bool all);
+    static void workerMain(TaskQueue* taskQueue, Worker* worker);
 
     /**
-     * Protects all modifications to #tasks and #running; used to allow
-     * safe concurrent calls to schedule(), performTask(), and
-     * performTasksUntilHalt().
+     * Used only for sleeping: threads with nothing to do wait on
+     * #taskAdded while holding this lock.
      */
     std::mutex mutex;
     typedef std::unique_lock<std::mutex> Lock;
 
     /**
-     * Waited on during performTasksUntilHalt() if there are no tasks to run.
-     * Notified on schedule() or halt().
+     * Waited on during performTasksUntilHalt() and by workers if there are
+     * no tasks to run.  Notified on schedule() (if anyone is waiting) or
+     * halt().
      */
     std::condition_variable taskAdded;
 
     /**
-     * Used to tell performTasksUntilHalt() to return after the completion of
-     * any currently running task.
+     * Used to tell performTasksUntilHalt() and workers to return after the
+     * completion of any currently running task.
      */
-    bool running;
+    std::atomic<bool> running;
 
     /**
-     * Points to tasks which should be executed.
-     * Provides FIFO order for task scheduling.
+     * Number of threads waiting on #taskAdded; lets schedule() skip
+     * #mutex entirely when nobody is asleep.
      */
-    std::queue<Task*> tasks;
+    std::atomic<int> sleepers;
+
+    /**
+     * Number of tasks on #tasks and on the #tasks lists of all workers
+     * (tasks in the process of being pushed are included).
+     */
+    std::atomic<int> queuedTasks;
+
+    /**
+     * Points to tasks which should be executed.  Provides FIFO order for
+     * tasks scheduled from outside of this queue's workers.
+     */
+    TaskList tasks;
+
+    /// Threads started by startWorkers(); empty if there are none.
+    std::vector<Worker*> workers;
+
+    /// The Worker running on the calling thread, or NULL if it isn't a
+    /// worker (of any TaskQueue).
+    static __thread Worker* currentWorker;
 
     friend class Task;
+    DISALLOW_COPY_AND_ASSIGN(TaskQueue);
 };
 
 } // namespace RAMCloud
@@ -121,9 +121,9 @@ TEST_F(TaskQueueTest, schedule)
     task1.schedule();
     ASSERT_TRUE(task1.isScheduled());
     task1.schedule(); // check to make sure double schedules don't happen
-    ASSERT_EQ(1u, taskQueue.tasks.size());
-    EXPECT_EQ(&task1, taskQueue.tasks.front());
-    taskQueue.performTask(); // clear out task queue
+    ASSERT_EQ(1u, taskQueue.outstandingTasks());
+    EXPECT_EQ(&task1, taskQueue.getNextTask(false));
+    EXPECT_EQ(0u, taskQueue.outstandingTasks());
 }
 
 TEST_F(TaskQueueTest, scheduleNested)
@@ -131,15 +131,14 @@ TEST_F(TaskQueueTest, scheduleNested)
     ReschedulingMockTask task(taskQueue);
     task.schedule();
     ASSERT_TRUE(task.isScheduled());
-    ASSERT_EQ(1u, taskQueue.tasks.size());
-    EXPECT_EQ(&task, taskQueue.tasks.front());
+    ASSERT_EQ(1u, taskQueue.outstandingTasks());
     taskQueue.performTask();
     EXPECT_EQ(1, task.count);
     ASSERT_TRUE(task.isScheduled());
-    ASSERT_EQ(1u, taskQueue.tasks.size());
-    EXPECT_EQ(&task, taskQueue.tasks.front());
+    ASSERT_EQ(1u, taskQueue.outstandingTasks());
     taskQueue.performTask(); // clear out task queue
     EXPECT_EQ(2, task.count);
+    EXPECT_EQ(0u, taskQueue.outstandingTasks());
 }
 
 TEST_F(TaskQueueTest, getNextTask)
@@ -153,4 +152,156 @@ TEST_F(TaskQueueTest, getNextTask)
     EXPECT_EQ(static_cast<Task*>(NULL), taskQueue.getNextTask(true));
 }
 
+TEST_F(TaskQueueTest, TaskList_pushAndPop)
+{
+    TaskQueue::TaskList list(taskQueue);
+    MockTask task3(taskQueue);
+    EXPECT_EQ(static_cast<Task*>(NULL), list.front());
+    EXPECT_EQ(static_cast<Task*>(NULL), list.pop());
+    list.push(&task1);
+    EXPECT_EQ(&task1, list.front());
+    EXPECT_EQ(&task1, list.pop());
+    EXPECT_EQ(static_cast<Task*>(NULL), list.pop());
+
+    list.push(&task1);
+    list.push(&task2);
+    list.push(&task3);
+    EXPECT_EQ(&task1, list.pop());
+    list.push(&task1);
+    EXPECT_EQ(&task2, list.front());
+    EXPECT_EQ(&task2, list.pop());
+    EXPECT_EQ(&task3, list.pop());
+    EXPECT_EQ(&task1, list.pop());
+    EXPECT_EQ(static_cast<Task*>(NULL), list.pop());
+}
+
+namespace {
+// Reschedules itself a given number of times, noting whether it ever
+// runs concurrently with itself.
+struct CountingTask : Task {
+    explicit CountingTask(TaskQueue& taskQueue, int limit)
+        : Task(taskQueue)
+        , limit(limit)
+        , count(0)
+        , active(0)
+        , overlapped(false)
+        , done(0)
+    {
+    }
+
+    void
+    performTask()
+    {
+        if (active.exchange(1) != 0)
+            overlapped = true;
+        if (++count < limit) {
+            schedule();
+            // Give other workers a chance to pick up the rescheduled task.
+            usleep(10);
+        } else {
+            done = 1;
+        }
+        active.store(0);
+    }
+
+    int limit;
+    int count;
+    Atomic<int> active;
+    bool overlapped;
+    Atomic<int> done;
+};
+
+void
+waitForTasks(std::vector<CountingTask*>& tasks)
+{
+    for (int i = 0; i < 10000; i++) {
+        bool allDone = true;
+        foreach (CountingTask* task, tasks)
+            allDone = allDone && task->done.load();
+        if (allDone)
+            return;
+        usleep(100);
+    }
+}
+}
+
+TEST_F(TaskQueueTest, startWorkers)
+{
+    taskQueue.startWorkers(4);
+    std::vector<CountingTask*> tasks;
+    for (int i = 0; i < 20; i++) {
+        tasks.push_back(new CountingTask(taskQueue, 100));
+        tasks.back()->schedule();
+    }
+    waitForTasks(tasks);
+    foreach (CountingTask* task, tasks) {
+        EXPECT_EQ(100, task->count);
+        EXPECT_FALSE(task->overlapped);
+    }
+    EXPECT_TRUE(taskQueue.isIdle());
+    taskQueue.stopWorkers();
+    foreach (CountingTask* task, tasks)
+        delete task;
+}
+
+TEST_F(TaskQueueTest, findTask_handoffWhileRunning)
+{
+    // Pretend worker 0 is running task1; whoever finds task1 in the
+    // meantime must give it back to worker 0.
+    TaskQueue::Worker worker0(taskQueue, 0);
+    TaskQueue::Worker worker1(taskQueue, 1);
+    taskQueue.workers.push_back(&worker0);
+    taskQueue.workers.push_back(&worker1);
+    worker0.currentTask = &task1;
+    task1.schedule();
+    task2.schedule();
+    EXPECT_EQ(&task2, taskQueue.findTask(&worker1));
+    EXPECT_EQ(1, worker0.handoffCount.load());
+    EXPECT_EQ(1u, taskQueue.outstandingTasks());
+
+    worker0.currentTask = NULL;
+    EXPECT_EQ(&task1, taskQueue.findTask(&worker0));
+    EXPECT_EQ(0, worker0.handoffCount.load());
+    EXPECT_EQ(0u, taskQueue.outstandingTasks());
+    taskQueue.workers.clear();
+}
+
+TEST_F(TaskQueueTest, findTask_order)
+{
+    TaskQueue::Worker worker0(taskQueue, 0);
+    TaskQueue::Worker worker1(taskQueue, 1);
+    taskQueue.workers.push_back(&worker0);
+    taskQueue.workers.push_back(&worker1);
+    MockTask task3(taskQueue);
+
+    // Own tasks first, then shared ones, then stolen ones.
+    task1.schedule();
+    task2.scheduled = true;
+    worker1.tasks.push(&task2);
+    task3.scheduled = true;
+    worker0.tasks.push(&task3);
+    taskQueue.queuedTasks += 2;
+    EXPECT_EQ(&task3, taskQueue.findTask(&worker0));
+    EXPECT_EQ(&task1, taskQueue.findTask(&worker0));
+    EXPECT_EQ(&task2, taskQueue.findTask(&worker0));
+    EXPECT_EQ(0u, taskQueue.outstandingTasks());
+
+    taskQueue.halt();
+    EXPECT_EQ(static_cast<Task*>(NULL), taskQueue.findTask(&worker0));
+    taskQueue.workers.clear();
+}
+
+TEST_F(TaskQueueTest, stopWorkers)
+{
+    taskQueue.stopWorkers();
+    taskQueue.startWorkers(2);
+    taskQueue.stopWorkers();
+    EXPECT_TRUE(taskQueue.workers.empty());
+
+    // Tasks scheduled after the queue halted stay queued.
+    task1.schedule();
+    EXPECT_EQ(1u, taskQueue.outstandingTasks());
+    EXPECT_EQ(static_cast<Task*>(NULL), taskQueue.getNextTask(false));
+}
+
 } // namespace RAMCloud
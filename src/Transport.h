@@ -72,6 +72,7 @@ class Transport {
             : requestPayload(),
               replyPayload(),
               epoch(INVALID_EPOCH),
+              receiveTime(0),
               outstandingRpcListHook() {}
 
         /**
@@ -137,6 +138,13 @@ class Transport {
          */
         uint64_t epoch;
 
+        /**
+         * Cycles::rdtsc() when ServiceManager received this RPC from its
+         * transport, or 0 if it hasn't yet. Used to measure how long RPCs
+         * wait for a worker thread (see LatencyMetrics).
+         */
+        uint64_t receiveTime;
+
         /**
          * Hook for the list of active server RPCs that the ServerRpcPool class
          * maintains. RPCs are added when ServerRpc-derived classes are
@@ -28,7 +28,7 @@ using namespace RAMCloud;
 
 void
 bench(RamCloud& client,
-      const uint32_t table,
+      const uint64_t table,
       const bool mcp,
       const uint64_t count,
       const uint64_t size,
@@ -45,11 +45,11 @@ bench(RamCloud& client,
              << " objects to store of " << size << " bytes"
              << endl;
         if (uncached) {
-            master.fillWithTestData(0, "abc", 3, downCast<uint32_t>(insCount),
-                                    downCast<uint32_t>(size));
+            client.testingFill(table, "0", 1, downCast<uint32_t>(insCount),
+                               downCast<uint32_t>(size));
         }
         // make sure to write 0 last to trigger master metrics
-        client.write(table, 0,
+        client.write(table, "0", 1,
                      &buf[0], downCast<uint32_t>(size));
     }
 
@@ -61,7 +61,7 @@ bench(RamCloud& client,
     for (;;) {
         try {
             // warm up caches and sync metrics on drones
-            client.read(table, 0, &response);
+            client.read(table, "0", 1, &response);
             break;
         } catch (ObjectDoesntExistException& e) {
         }
@@ -70,8 +70,9 @@ bench(RamCloud& client,
     CycleCounter<> counter;
     for (uint64_t i = 0; !mcp || i < count; ++i) {
         try {
-            uint64_t k = generateRandom() % insCount;
-            client.read(table, k, &response);
+            string key = format("%lu", generateRandom() % insCount);
+            client.read(table, key.c_str(), downCast<uint16_t>(key.length()),
+                        &response);
             ++readCount;
         } catch (ObjectDoesntExistException& e) {
             if (mcp)
@@ -85,8 +86,7 @@ bench(RamCloud& client,
     if (mcp) {
         RejectRules rr;
         rr.exists = false;
-        uint64_t version = 0;
-        client.remove(table, 0, &rr, &version);
+        client.remove(table, "0", 1, &rr);
     }
 
     uint64_t ns = Cycles::toNanoseconds(recoveryTicks);
@@ -138,8 +138,7 @@ try
     RamCloud client(optionParser.options.getCoordinatorLocator().c_str());
 
     client.createTable("TransportBench");
-    auto table = client.getTableId("TransportBench");
-    assert(table == 0);
+    uint64_t table = client.getTableId("TransportBench");
 
     bench(client, table, mcp, count, size, uncached);
 } catch (ClientException& e) {
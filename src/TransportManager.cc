@@ -21,6 +21,7 @@
 #include "TransportManager.h"
 #include "TransportFactory.h"
 #include "TcpTransport.h"
+#include "ShmTransport.h"
 #include "FastTransport.h"
 #include "UdpDriver.h"
 #include "FailSession.h"
@@ -42,6 +43,15 @@ static struct TcpTransportFactory : public TransportFactory {
     }
 } tcpTransportFactory;
 
+static struct ShmTransportFactory : public TransportFactory {
+    ShmTransportFactory()
+        : TransportFactory("shm") {}
+    Transport* createTransport(Context* context,
+            const ServiceLocator* localServiceLocator) {
+        return new ShmTransport(context, localServiceLocator);
+    }
+} shmTransportFactory;
+
 static struct FastUdpTransportFactory : public TransportFactory {
     FastUdpTransportFactory()
         : TransportFactory("fast+kernelUdp", "fast+udp") {}
@@ -85,7 +95,7 @@ static struct InfRcTransportFactory : public TransportFactory {
 
 TransportManager::TransportManager(Context* context)
     : context(context)
-    , isServer(false)
+    , multiThreaded(false)
     , transportFactories()
     , transports()
     , listeningLocators()
@@ -93,10 +103,12 @@ TransportManager::TransportManager(Context* context)
     , registeredBases()
     , registeredSizes()
     , mutex("TransportManager::mutex")
+    , sendQueue()
     , sessionTimeoutMs(0)
     , mockRegistrations(0)
 {
     transportFactories.push_back(&tcpTransportFactory);
+    transportFactories.push_back(&shmTransportFactory);
     transportFactories.push_back(&fastUdpTransportFactory);
 #ifdef INFINIBAND
     transportFactories.push_back(&fastInfUdTransportFactory);
@@ -111,6 +123,7 @@ TransportManager::~TransportManager()
     // Must clear the cache and destroy sessionRefs before the
     // transports are destroyed.
     sessionCache.clear();
+    sendQueue.destroy();
 
     // Delete any mockRegistrations
 #if TESTING
@@ -121,6 +134,22 @@ TransportManager::~TransportManager()
         delete transport;
 }
 
+/**
+ * This method is invoked on clients that issue RPCs from many threads
+ * through a single context, while a separate thread polls the context's
+ * dispatcher (see RamCloud's multiThreaded option).  After this call
+ * sessions returned by this TransportManager may be used from any thread;
+ * requests sent from threads other than the dispatch thread are handed to
+ * the dispatch thread without locking it.  Must be called in the dispatch
+ * thread before any sessions are opened.
+ */
+void
+TransportManager::enableClientThreads()
+{
+    multiThreaded = true;
+    sendQueue.construct(context->dispatch);
+}
+
 /**
  * This method is invoked only on servers; it creates transport(s) that will be
  * used to receive RPC requests.  These transports can also be used for outgoing
@@ -134,7 +163,7 @@ TransportManager::~TransportManager()
 void
 TransportManager::initialize(const char* localServiceLocator)
 {
-    isServer = true;
+    multiThreaded = true;
     Dispatch::Lock lock(context->dispatch);
     std::vector<ServiceLocator> locators =
             ServiceLocator::parseServiceLocators(localServiceLocator);
@@ -234,7 +263,7 @@ TransportManager::getSession(const char* serviceLocator)
     // If we're running on a server (i.e., multithreaded) must exclude
     // other threads.
     Tub<std::lock_guard<SpinLock>> lock;
-    if (isServer) {
+    if (multiThreaded) {
         lock.construct(mutex);
     }
 
@@ -285,7 +314,7 @@ TransportManager::openSession(const char* serviceLocator)
     // If we're running on a server (i.e., multithreaded) must exclude
     // other threads.
     Tub<std::lock_guard<SpinLock>> lock;
-    if (isServer) {
+    if (multiThreaded) {
         lock.construct(mutex);
     }
     return openSessionInternal(serviceLocator);
@@ -342,8 +371,9 @@ TransportManager::openSessionInternal(const char* serviceLocator)
             try {
                 Transport::SessionRef session = transports[i]->getSession(
                         locator, sessionTimeoutMs);
-                if (isServer) {
-                    return new WorkerSession(context, session);
+                if (multiThreaded) {
+                    return new WorkerSession(context, session,
+                            sendQueue ? sendQueue.get() : NULL);
                 }
                 return session;
             } catch (TransportException& e) {
@@ -27,6 +27,7 @@
 #include "ServerList.h"
 #include "SpinLock.h"
 #include "Transport.h"
+#include "WorkerSession.h"
 
 namespace RAMCloud {
 
@@ -41,12 +42,16 @@ class TransportFactory;
  *
  * Servers should first use #transportManager's #initialize(). Then, they may
  * use #getSession().
+ *
+ * Clients that share one context among many threads (with a separate thread
+ * running the dispatcher) should call #enableClientThreads() first.
  */
 class TransportManager {
   public:
     explicit TransportManager(Context* context);
     ~TransportManager();
     void initialize(const char* serviceLocator);
+    void enableClientThreads();
     void flushSession(const char* serviceLocator);
     Transport::SessionRef getSession(const char* serviceLocator);
     string getListeningLocatorsString();
@@ -111,9 +116,11 @@ class TransportManager {
     Context* context;
 
     /**
-     * True means this is a server application, false means this is a client only.
+     * True means sessions may be used by threads other than the dispatch
+     * thread (a server application, or a client shared among threads);
+     * false means only the dispatch thread uses this TransportManager.
      */
-    bool isServer;
+    bool multiThreaded;
 
     /**
      * Factories to create all possible transports.  The order in this vector
@@ -160,6 +167,12 @@ class TransportManager {
      */
     SpinLock mutex;
 
+    /**
+     * Passes requests from client threads to the dispatch thread; only
+     * constructed by #enableClientThreads().
+     */
+    Tub<WorkerSession::SendQueue> sendQueue;
+
     /**
      * Used for detecting dead servers: if we can't get any response out
      * a server in this many milliseconds, the session gets aborted.  0
@@ -59,7 +59,7 @@ TEST_F(TransportManagerTest, initialize) {
     manager.transports.resize(3, NULL);
     manager.initialize("foo:; mock:; bar:; mock:x=14");
     EXPECT_EQ("foo:;mock:;mock:x=14", manager.listeningLocators);
-    EXPECT_TRUE(manager.isServer);
+    EXPECT_TRUE(manager.multiThreaded);
     EXPECT_EQ(4U, manager.transports.size());
     Transport* t = manager.transports[3];
     EXPECT_EQ("mock:x=14", t->getServiceLocator());
@@ -150,6 +150,17 @@ TEST_F(TransportManagerTest, getSession_ignoreTransportCreateError) {
     EXPECT_EQ("createTransport: exception thrown", TestLog::get());
 }
 
+TEST_F(TransportManagerTest, enableClientThreads) {
+    manager.registerMock(NULL);
+    manager.enableClientThreads();
+    EXPECT_TRUE(manager.multiThreaded);
+    Transport::SessionRef session(manager.getSession("mock:"));
+    WorkerSession* workerSession =
+            dynamic_cast<WorkerSession*>(session.get());
+    ASSERT_TRUE(workerSession != NULL);
+    EXPECT_EQ(manager.sendQueue.get(), workerSession->sendQueue);
+}
+
 TEST_F(TransportManagerTest, getSession_createWorkerSession) {
     TestLog::Enable _;
     manager.registerMock(NULL);
@@ -161,7 +172,7 @@ TEST_F(TransportManagerTest, getSession_createWorkerSession) {
 
     // Second session: need a WorkerSession.
     manager.sessionCache.clear();
-    manager.isServer = true;
+    manager.multiThreaded = true;
     Transport::SessionRef session2(manager.getSession("mock:"));
     EXPECT_TRUE(session2.get() != NULL);
     EXPECT_EQ("WorkerSession: created", TestLog::get());
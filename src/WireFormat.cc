@@ -97,6 +97,9 @@ opcodeSymbol(uint32_t opcode)
         case VERIFY_MEMBERSHIP:          return "VERIFY_MEMBERSHIP";
         case GET_RUNTIME_OPTION:         return "GET_RUNTIME_OPTION";
         case SERVER_CONTROL:             return "SERVER_CONTROL";
+        case LOOKUP_INDEX_KEYS:          return "LOOKUP_INDEX_KEYS";
+        case SET_TABLE_EXPIRY:           return "SET_TABLE_EXPIRY";
+        case TRANSACTION:                return "TRANSACTION";
         case ILLEGAL_RPC_TYPE:           return "ILLEGAL_RPC_TYPE";
     }
 
@@ -111,7 +111,10 @@ enum Opcode {
     VERIFY_MEMBERSHIP         = 55,
     GET_RUNTIME_OPTION        = 56,
     SERVER_CONTROL            = 57,
-    ILLEGAL_RPC_TYPE          = 58,  // 1 + the highest legitimate Opcode
+    LOOKUP_INDEX_KEYS         = 58,
+    SET_TABLE_EXPIRY          = 59,
+    TRANSACTION               = 60,
+    ILLEGAL_RPC_TYPE          = 61,  // 1 + the highest legitimate Opcode
 };
 
 /**
@@ -123,6 +126,9 @@ enum ControlOp {
     START_DISPATCH_PROFILER     = 1000,
     STOP_DISPATCH_PROFILER      = 1001,
     DUMP_DISPATCH_PROFILE       = 1002,
+    GET_LATENCY_METRICS         = 1003,
+    RESET_LATENCY_METRICS       = 1004,
+    SET_CLEANER_OPTION          = 1005,
 };
 
 /**
@@ -155,6 +161,21 @@ struct ResponseCommon {
                                   // succeeded; if not, it explains why.
 } __attribute__((packed));
 
+/**
+ * Every response with STATUS_RETRY has exactly this format (see
+ * Service::prepareRetryResponse), regardless of the RPC's usual response
+ * header. It tells the client how long to wait before trying again; the
+ * client picks a random delay in the given range so that clients turned
+ * away at the same time don't all come back at once.
+ */
+struct RetryResponse {
+    ResponseCommon common;
+    uint32_t minDelayMicros;      // Lower bound on the retry delay. 0 for
+                                  // both bounds means the server has no
+                                  // opinion; use the client's default.
+    uint32_t maxDelayMicros;      // Upper bound on the retry delay.
+} __attribute__((packed));
+
 
 // For each RPC there is a structure below, which contains the following:
 //   * A field "opcode" defining the Opcode used in requests.
@@ -290,16 +311,16 @@ struct BackupStartReadingData {
                                        ///< inconsistent. If it might've been
                                        ///< this digest will be discarded
                                        ///< by the coordinator for safety.
-        uint32_t tabletMetricsLen;     ///< Byte length of TabletMetrics that
-                                       ///< go after the LogDigest
+        uint32_t tabletMetricsLen;     ///< Byte length of the table stats
+                                       ///< that go after the LogDigest.
         // An array of segmentIdCount replicas follows.
         // Each entry is a Replica (see below).
         //
         // If logDigestBytes != 0, then a serialised LogDigest follows
         // immediately after the replica list.
 
-        // TODO(syang0) TabletMetrics follows. The exact
-        // format has not been determined yet.
+        // If tabletMetricsLen != 0, then a TableStats::Digest taken
+        // from the same replica as the LogDigest follows it.
     } __attribute__((packed));
     /// Used in the Response to report which replicas the backup has.
     struct Replica {
@@ -726,6 +747,53 @@ struct Kill {
     } __attribute__((packed));
 };
 
+struct LookupIndexKeys {
+    static const Opcode opcode = LOOKUP_INDEX_KEYS;
+    static const ServiceType service = MASTER_SERVICE;
+    struct Request {
+        RequestCommon common;
+        uint64_t tableId;
+        uint64_t tabletFirstHash;     // Identifies the tablet whose objects
+                                      // are to be searched, as in Enumerate.
+        uint8_t indexId;              // Index to search within the table.
+        uint8_t returnObjects;        // If non-zero, each result carries the
+                                      // object's value as well as its key.
+        uint32_t maxResults;          // Maximum number of results to return.
+        uint16_t firstKeyLength;      // Length of the smallest secondary key
+                                      // to return. The key itself follows
+                                      // immediately after this header.
+        uint16_t firstPrimaryKeyLength; // Length of a primary key following
+                                      // the first key; entries for the first
+                                      // key with smaller primary keys are
+                                      // skipped. Used to resume a lookup.
+        uint16_t lastKeyLength;       // Length of the largest secondary key
+                                      // to return, which follows the first
+                                      // primary key.
+    } __attribute__((packed));
+    struct Response {
+        ResponseCommon common;
+        uint64_t tabletFirstHash;     // First key hash of the next tablet
+                                      // to search, or 0 if this was the
+                                      // last tablet in the table.
+        uint32_t numResults;          // Number of Result structures that
+                                      // follow this header.
+        uint8_t haveNext;             // Non-zero if this tablet has more
+                                      // results; the lookup should continue
+                                      // from nextKey/nextPrimaryKey, which
+                                      // follow the results.
+        uint16_t nextKeyLength;
+        uint16_t nextPrimaryKeyLength;
+    } __attribute__((packed));
+    /// Each result is one of these, followed by the object's secondary key,
+    /// primary key, and (if requested) value.
+    struct Result {
+        uint64_t version;
+        uint16_t indexKeyLength;
+        uint16_t primaryKeyLength;
+        uint32_t valueLength;
+    } __attribute__((packed));
+};
+
 struct MigrateTablet {
     static const Opcode opcode = MIGRATE_TABLET;
     static const ServiceType service = MASTER_SERVICE;
@@ -909,7 +977,15 @@ struct Read {
         uint16_t keyLength;           // Length of the key in bytes.
                                       // The actual key follows
                                       // immediately after this header.
+        uint64_t keyHash;             // Key::getHash() of the table and key,
+                                      // as computed by the client to find the
+                                      // master; saves the master rehashing.
         RejectRules rejectRules;
+        uint32_t deadlineMicros;      // If nonzero, the master may reject
+                                      // the read with STATUS_TIMEOUT rather
+                                      // than start it if it has waited this
+                                      // long for a worker thread (measured
+                                      // from arrival at the master).
     } __attribute__((packed));
     struct Response {
         ResponseCommon common;
@@ -1097,6 +1173,28 @@ struct SetRuntimeOption {
     } __attribute__((packed));
 };
 
+struct SetTableExpiry {
+    static const Opcode opcode = SET_TABLE_EXPIRY;
+    static const ServiceType service = MASTER_SERVICE;
+    struct Request {
+        RequestCommon common;
+        uint64_t tableId;
+        uint64_t tabletFirstHash;     // Identifies the tablet whose policy
+                                      // is to be set, as in Enumerate.
+        uint32_t ttl;                 // Objects expire this many seconds
+                                      // after they are written; 0 means
+                                      // they never expire.
+        uint8_t evictable;            // If non-zero, objects may be evicted
+                                      // when the master runs short of memory.
+    } __attribute__((packed));
+    struct Response {
+        ResponseCommon common;
+        uint64_t tabletFirstHash;     // First key hash of the next tablet
+                                      // of the table, or 0 if this was the
+                                      // last one.
+    } __attribute__((packed));
+};
+
 struct SplitMasterTablet {
     static const Opcode opcode = SPLIT_TABLET;
     static const ServiceType service = MASTER_SERVICE;
@@ -1145,6 +1243,61 @@ struct TakeTabletOwnership {
     } __attribute__((packed));
 };
 
+struct Transaction {
+    static const Opcode opcode = TRANSACTION;
+    static const ServiceType service = MASTER_SERVICE;
+
+    /// What a transaction does with each of its objects.
+    enum OpType {
+        CHECK,                        // Only check the reject rules.
+        WRITE,
+        REMOVE,
+    };
+
+    struct Request {
+        RequestCommon common;
+        uint32_t count;               // Number of Part structures following
+                                      // this. All of the keys must be
+                                      // distinct and owned by this master.
+
+        struct Part {
+            uint8_t type;             // An OpType.
+            uint64_t tableId;
+            uint16_t keyLength;
+            uint32_t valueLength;     // Length of the new value (WRITE only).
+            RejectRules rejectRules;  // The whole transaction aborts if these
+                                      // reject the current version.
+
+            // In buffer: The actual key and value for this part
+            // follow immediately after this.
+            Part(uint8_t type, uint64_t tableId, uint16_t keyLength,
+                 uint32_t valueLength, RejectRules rejectRules)
+                : type(type)
+                , tableId(tableId)
+                , keyLength(keyLength)
+                , valueLength(valueLength)
+                , rejectRules(rejectRules)
+            {
+            }
+        } __attribute__((packed));
+    } __attribute__((packed));
+    struct Response {
+        // If common.status is STATUS_OK then count Parts follow, one for
+        // each in the request, and the transaction committed only if every
+        // one of them has STATUS_OK.
+        ResponseCommon common;
+        uint32_t count;
+
+        struct Part {
+            Status status;            // Result of checking the reject rules
+                                      // for this part.
+            uint64_t version;         // New version of the object if the
+                                      // transaction committed; otherwise
+                                      // its current version.
+        } __attribute__((packed));
+    } __attribute__((packed));
+};
+
 struct UpdateServerList {
     static const Opcode opcode = UPDATE_SERVER_LIST;
     static const ServiceType service = MEMBERSHIP_SERVICE;
@@ -1184,9 +1337,15 @@ struct Write {
         uint16_t keyLength;           // Length of the key in bytes.
                                       // The actual bytes of the key follow
                                       // immediately after this header.
+        uint64_t keyHash;             // Key::getHash() of the table and key,
+                                      // as computed by the client to find the
+                                      // master; saves the master rehashing.
         uint32_t length;              // Length of the object's value in bytes.
                                       // The actual bytes of the object follow
                                       // immediately after the key.
+        uint16_t secondaryKeysLength; // Length of the object's secondary keys
+                                      // (see IndexKey), which follow the
+                                      // value. 0 if the object has none.
         RejectRules rejectRules;
         uint8_t async;
     } __attribute__((packed));
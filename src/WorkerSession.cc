@@ -26,11 +26,16 @@ namespace RAMCloud {
  * \param wrapped
  *      Another Session object, to which #sendRequest and other methods
  *      will be forwarded.
+ * \param sendQueue
+ *      If non-NULL, sendRequest calls from threads other than the dispatch
+ *      thread are handed to the dispatch thread through this queue rather
+ *      than locking the dispatch thread.
  */
 WorkerSession::WorkerSession(Context* context,
-        Transport::SessionRef wrapped)
+        Transport::SessionRef wrapped, SendQueue* sendQueue)
     : context(context)
     , wrapped(wrapped)
+    , sendQueue(sendQueue)
 {
     setServiceLocator(wrapped->getServiceLocator());
     RAMCLOUD_TEST_LOG("created");
@@ -52,8 +57,11 @@ void
 WorkerSession::abort()
 {
     // Must make sure that the dispatch thread isn't running when we
-    // invoke the real abort.
+    // invoke the real abort.  Requests still in sendQueue are sent first
+    // so that they get aborted too.
     Dispatch::Lock lock(context->dispatch);
+    if (sendQueue != NULL)
+        sendQueue->poll();
     return wrapped->abort();
 }
 
@@ -62,8 +70,11 @@ void
 WorkerSession::cancelRequest(Transport::RpcNotifier* notifier)
 {
     // Must make sure that the dispatch thread isn't running when we
-    // invoke the real cancelRequest.
+    // invoke the real cancelRequest.  The request may still be in
+    // sendQueue; send it first so that the transport knows about it.
     Dispatch::Lock lock(context->dispatch);
+    if (sendQueue != NULL)
+        sendQueue->poll();
     return wrapped->cancelRequest(notifier);
 }
 
@@ -82,10 +93,88 @@ void
 WorkerSession::sendRequest(Buffer* request, Buffer* response,
         Transport::RpcNotifier* notifier)
 {
+    if (sendQueue != NULL && !context->dispatch->isDispatchThread()) {
+        sendQueue->push(wrapped, request, response, notifier);
+        return;
+    }
+
     // Must make sure that the dispatch thread isn't running when we
     // invoke the real sendRequest.
     Dispatch::Lock lock(context->dispatch);
     wrapped->sendRequest(request, response, notifier);
 }
 
+/**
+ * Construct a SendQueue.
+ *
+ * \param dispatch
+ *      Dispatcher whose thread will send the queued requests.  Must be
+ *      called in that thread (or with a Dispatch::Lock).
+ */
+WorkerSession::SendQueue::SendQueue(Dispatch* dispatch)
+    : Dispatch::Poller(*dispatch, "WorkerSession::SendQueue")
+    , newest(NULL)
+{
+}
+
+/**
+ * Destructor for SendQueues. Any requests that are still waiting are
+ * dropped without being sent.
+ */
+WorkerSession::SendQueue::~SendQueue()
+{
+    Request* request = newest.exchange(NULL);
+    while (request != NULL) {
+        Request* next = request->next;
+        delete request;
+        request = next;
+    }
+}
+
+/**
+ * Send all of the requests that are waiting, oldest first. Invoked by
+ * the dispatcher; other threads may also invoke it as long as they hold
+ * a Dispatch::Lock.
+ */
+void
+WorkerSession::SendQueue::poll()
+{
+    Request* request = newest.exchange(NULL);
+    if (request == NULL)
+        return;
+
+    // Reverse the list so that requests are sent in the order they were
+    // pushed.
+    Request* oldest = NULL;
+    while (request != NULL) {
+        Request* next = request->next;
+        request->next = oldest;
+        oldest = request;
+        request = next;
+    }
+    while (oldest != NULL) {
+        Request* next = oldest->next;
+        oldest->session->sendRequest(oldest->request, oldest->response,
+                oldest->notifier);
+        delete oldest;
+        oldest = next;
+    }
+}
+
+/**
+ * Queue a request for the dispatch thread to send. This method is
+ * thread-safe and never blocks.  The arguments are the same as for
+ * Transport::Session::sendRequest, plus the session to send on.
+ */
+void
+WorkerSession::SendQueue::push(Transport::SessionRef session,
+        Buffer* request, Buffer* response, Transport::RpcNotifier* notifier)
+{
+    Request* entry = new Request(session, request, response, notifier);
+    Request* head = newest.load();
+    do {
+        entry->next = head;
+    } while (!newest.compare_exchange_weak(head, entry));
+}
+
 } // namespace RAMCloud
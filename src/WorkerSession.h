@@ -17,6 +17,11 @@
 #define RAMCLOUD_WORKERSESSION_H
 
 #include <boost/intrusive_ptr.hpp>
+#if __GNUC__ >= 4 && __GNUC_MINOR__ >= 5
+#include <atomic>
+#else
+#include <cstdatomic>
+#endif
 
 #include "Atomic.h"
 #include "Dispatch.h"
@@ -31,11 +36,20 @@ namespace RAMCloud {
  * WorkerSession objects forward methods to the actual Session object after
  * synchronizing appropriately with the dispatch thread. In addition,
  * WorkerSessions (and SessionRefs referring to them) are thread-safe.
+ *
+ * By default each method locks the dispatch thread.  If a SendQueue is
+ * provided, sendRequest instead hands requests to the dispatch thread
+ * through the queue, so threads sending RPCs never wait for the dispatch
+ * thread or for each other (this is what lets many client threads share
+ * one RamCloud object; see TransportManager::enableClientThreads).
  */
 class WorkerSession : public Transport::Session {
   public:
+    class SendQueue;
+
     explicit WorkerSession(Context* context,
-            Transport::SessionRef wrapped);
+            Transport::SessionRef wrapped,
+            SendQueue* sendQueue = NULL);
     ~WorkerSession();
     void abort();
     void cancelRequest(Transport::RpcNotifier* notifier);
@@ -45,9 +59,54 @@ class WorkerSession : public Transport::Session {
   PRIVATE:
     Context* context;              /// Global RAMCloud state.
     Transport::SessionRef wrapped; /// Methods are forwarded to this object.
+    SendQueue* sendQueue;          /// If non-NULL, used by sendRequest.
     DISALLOW_COPY_AND_ASSIGN(WorkerSession);
 };
 
+/**
+ * Carries requests from threads other than the dispatch thread to the
+ * dispatch thread, which passes them on to their transports the next time
+ * it polls.  Any number of threads may push requests concurrently without
+ * locking; the dispatch thread takes all of the queued requests at once
+ * with a single atomic exchange.
+ */
+class WorkerSession::SendQueue : public Dispatch::Poller {
+  public:
+    explicit SendQueue(Dispatch* dispatch);
+    ~SendQueue();
+    void poll();
+    void push(Transport::SessionRef session, Buffer* request,
+            Buffer* response, Transport::RpcNotifier* notifier);
+
+  PRIVATE:
+    /// One request waiting to be sent; the arguments to sendRequest.
+    struct Request {
+        Request(Transport::SessionRef session, Buffer* request,
+                Buffer* response, Transport::RpcNotifier* notifier)
+            : session(session)
+            , request(request)
+            , response(response)
+            , notifier(notifier)
+            , next(NULL)
+        {}
+        Transport::SessionRef session;
+        Buffer* request;
+        Buffer* response;
+        Transport::RpcNotifier* notifier;
+
+        /// The request pushed just before this one, if it was still
+        /// waiting when this one was pushed.
+        Request* next;
+        DISALLOW_COPY_AND_ASSIGN(Request);
+    };
+
+    /// The most recently pushed request that hasn't been sent yet; older
+    /// ones follow it through Request::next.  NULL means none are waiting.
+    std::atomic<Request*> newest;
+
+    DISALLOW_COPY_AND_ASSIGN(SendQueue);
+};
+
 }  // namespace RAMCloud
 
 #endif  // RAMCLOUD_WORKERSESSION_H
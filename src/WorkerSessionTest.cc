@@ -120,4 +120,62 @@ TEST_F(WorkerSessionTest, sendRequest_syncWithDispatchThread) {
     child.join();
 }
 
+TEST_F(WorkerSessionTest, sendRequest_sendQueue) {
+    Context context(true);
+    MockTransport transport(&context);
+    WorkerSession::SendQueue sendQueue(context.dispatch);
+    MockWrapper rpc1("first");
+    MockWrapper rpc2("second");
+    WorkerSession session(&context, transport.getSession(), &sendQueue);
+
+    // Requests from other threads wait in the queue for the dispatcher,
+    // and are sent in order.
+    std::thread child1(testDispatchSync, &context, &rpc1, &session);
+    child1.join();
+    std::thread child2(testDispatchSync, &context, &rpc2, &session);
+    child2.join();
+    EXPECT_STREQ("", transport.outputLog.c_str());
+    context.dispatch->poll();
+    EXPECT_STREQ("sendRequest: first | sendRequest: second",
+            transport.outputLog.c_str());
+
+    // The dispatch thread sends directly.
+    transport.outputLog.clear();
+    session.sendRequest(&rpc.request, &rpc.response, &rpc);
+    EXPECT_STREQ("sendRequest: abcdefg", transport.outputLog.c_str());
+}
+
+TEST_F(WorkerSessionTest, cancelRequest_sendQueue) {
+    Context context(true);
+    MockTransport transport(&context);
+    WorkerSession::SendQueue sendQueue(context.dispatch);
+    WorkerSession session(&context, transport.getSession(), &sendQueue);
+
+    std::thread child(testDispatchSync, &context, &rpc, &session);
+    child.join();
+    session.cancelRequest(&rpc);
+    EXPECT_STREQ("sendRequest: abcdefg | cancel: ",
+            transport.outputLog.c_str());
+}
+
+TEST_F(WorkerSessionTest, SendQueue_destructor) {
+    Context context(true);
+    MockTransport transport(&context);
+    MockTransport::sessionDeleteCount = 0;
+    Tub<WorkerSession::SendQueue> sendQueue;
+    sendQueue.construct(context.dispatch);
+    {
+        WorkerSession session(&context, transport.getSession(),
+                sendQueue.get());
+        std::thread child(testDispatchSync, &context, &rpc, &session);
+        child.join();
+    }
+
+    // The queued request holds the last reference to the session.
+    EXPECT_EQ(0U, MockTransport::sessionDeleteCount);
+    sendQueue.destroy();
+    EXPECT_EQ(1U, MockTransport::sessionDeleteCount);
+    EXPECT_STREQ("", transport.outputLog.c_str());
+}
+
 } // namespace RAMCloud